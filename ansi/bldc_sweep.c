@@ -0,0 +1,862 @@
+/* bldc_sweep.c - batched BLDC parameter sweep over hall / sensorless / FOC
+ *
+ * Build:  cc -O3 -march=native -std=c99 -Wall -Wextra -pthread -o bldc_sweep bldc_sweep.c -lm
+ *
+ * Runs many independent instances of the bldc_sim19 plant and controllers at
+ * once and prints one CSV row of summary metrics per instance instead of a
+ * trace.  Use bldc_sim19 to look at the waveforms of a single interesting run.
+ *
+ * Sweep spec (axes combine as a Cartesian product, mode outermost):
+ *   --mode=hall,sensorless,foc   modes to run (default hall)
+ *   --grid=KEY=v1,v2,...         explicit values
+ *   --grid=KEY=lo:hi:n[:log]     n points, linearly or log spaced
+ *   --rand=KEY=lo:hi[:log]       uniform (or log-uniform) draw per instance
+ *   --samples=1 --seed=1         random draws per grid point
+ *   --KEY=value                  fixed value
+ * KEY is any plant/controller option of bldc_sim19:
+ *   rpm vdc load ilim pp R L Ke Kt J B
+ *   align ramp f1 d_align d_ramp blank handover
+ *   Kp_spd Ki_spd Kp_id Ki_id Kp_iq Ki_iq idref iqmax
+ *
+ * Engine:  --t=1.0 --dt=0.00005 --threads=<ncpu> --band=0.02 --win=0.2
+ *
+ * CSV columns:
+ *   id,mode,<swept keys>,settle_s,overshoot_pct,rpm_mean,rpm_ripple,Te_mean,Te_ripple_pct,ipk
+ *   settle_s       time after which rpm stays within +-band*rpm (-1: never settled)
+ *   overshoot_pct  peak rpm above target, in % of target
+ *   rpm_*, Te_*    mean and peak-to-peak over the last win*t seconds
+ *   ipk            peak phase current magnitude over the whole run
+ * Throughput (simulated motor-seconds per wall-second) is reported on stderr.
+ *
+ * Notes:
+ * - Same average-voltage model, startup sequence and PI anti-windup as
+ *   bldc_sim19; the electrical angle is carried as state instead of pp*theta_m.
+ * - Instances are simulated in blocks of BLK of a single mode, with state kept
+ *   structure-of-arrays.  The electromechanical update for a block is one
+ *   branch-free loop the compiler vectorizes; blocks are handed to threads.
+ */
+
+#if 0
+
+cc -O3 -march=native -std=c99 -Wall -Wextra -pthread -o bldc_sweep bldc_sweep.c -lm
+
+#(1) Speed loop gain map for all three modes, 3 x 8 x 8 instances:
+./bldc_sweep --mode=hall,sensorless,foc --grid=Kp_spd=0.0005:0.01:8:log \
+  --grid=Ki_spd=0.1:10:8:log > gains.csv
+
+#(2) Monte Carlo over motor tolerances, 10000 FOC instances:
+./bldc_sweep --mode=foc --rand=R=0.4:0.6 --rand=L=0.00015:0.00025 \
+  --rand=J=5e-5:2e-4:log --samples=10000 > mc.csv
+
+#endif
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TWO_PI (2.0 * M_PI)
+#define RPM_PER_RADS (60.0 / TWO_PI)
+#define BLK 256 /* instances per block; ~100 KB of lanes, stays in L2 */
+
+/* ---------- sweep parameters ---------- */
+enum
+{
+    MODE_HALL,
+    MODE_SENSORLESS,
+    MODE_FOC,
+    NMODE
+};
+static const char *mode_name[NMODE] = {"hall", "sensorless", "foc"};
+
+enum
+{
+    P_RPM, P_VDC, P_LOAD, P_ILIM,
+    P_PP, P_R, P_L, P_KE, P_KT, P_J, P_B,
+    P_ALIGN, P_RAMP, P_F1, P_DALIGN, P_DRAMP, P_BLANK, P_HANDOVER,
+    P_KPSPD, P_KISPD, P_KPID, P_KIID, P_KPIQ, P_KIIQ, P_IDREF, P_IQMAX,
+    NPARAM
+};
+
+/* keys and defaults match bldc_sim19 */
+static const struct
+{
+    const char *key;
+    double def;
+} ptab[NPARAM] = {
+    {"rpm", 1500.0}, {"vdc", 24.0}, {"load", 0.05}, {"ilim", 0.0},
+    {"pp", 4.0}, {"R", 0.5}, {"L", 0.0002}, {"Ke", 0.06}, {"Kt", 0.06}, {"J", 1e-4}, {"B", 1e-4},
+    {"align", 0.06}, {"ramp", 0.30}, {"f1", 400.0}, {"d_align", 0.25}, {"d_ramp", 0.45},
+    {"blank", 0.0002}, {"handover", 200.0},
+    {"Kp_spd", 0.003}, {"Ki_spd", 1.0}, {"Kp_id", 8.0}, {"Ki_id", 200.0},
+    {"Kp_iq", 8.0}, {"Ki_iq", 200.0}, {"idref", 0.0}, {"iqmax", 30.0},
+};
+
+typedef struct
+{
+    int key, n;
+    double *v;
+} Axis;
+
+typedef struct
+{
+    int key, logscale;
+    double lo, hi;
+} Draw;
+
+typedef struct
+{
+    double base[NPARAM];
+    int mode[NMODE], nmode;
+    Axis axis[NPARAM];
+    int naxis;
+    Draw draw[NPARAM];
+    int ndraw;
+    long samples;
+    uint64_t seed;
+    long per_mode; /* grid points * samples */
+    double sim_t, dt, band, win;
+} Spec;
+
+static uint64_t splitmix64(uint64_t *s)
+{
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* Parameters of instance id.  Random draws are seeded from (seed, id) so a
+   run is reproducible whatever the thread count. */
+static int instance_params(const Spec *sp, long id, double *p)
+{
+    long g = (id % sp->per_mode) / sp->samples;
+    memcpy(p, sp->base, sizeof sp->base);
+    for (int a = sp->naxis - 1; a >= 0; a--)
+    {
+        const Axis *ax = &sp->axis[a];
+        p[ax->key] = ax->v[g % ax->n];
+        g /= ax->n;
+    }
+    uint64_t s = sp->seed ^ ((uint64_t)id * 0xD1B54A32D192ED03ull);
+    for (int d = 0; d < sp->ndraw; d++)
+    {
+        const Draw *dr = &sp->draw[d];
+        double u = (double)(splitmix64(&s) >> 11) * (1.0 / 9007199254740992.0);
+        p[dr->key] = dr->logscale ? dr->lo * pow(dr->hi / dr->lo, u)
+                                  : dr->lo + (dr->hi - dr->lo) * u;
+    }
+    p[P_PP] = (double)(int)p[P_PP];
+    return sp->mode[id / sp->per_mode];
+}
+
+/* ---------- helpers ---------- */
+static double clamp(double x, double lo, double hi) { return x < lo ? lo : (x > hi ? hi : x); }
+static double abs3max(double a, double b, double c)
+{
+    a = fabs(a);
+    b = fabs(b);
+    c = fabs(c);
+    a = a > b ? a : b;
+    return a > c ? a : c;
+}
+
+/* 120° trap in [-1,1] by electrical angle in [-2π/3, 8π/3); the branch-free
+   form of bldc_sim19's trap120: a triangle around 90° clipped at ±1. */
+static inline double trap120(double theta)
+{
+    double x = theta - 0.5 * M_PI;
+    x = x >= M_PI ? x - TWO_PI : x;
+    x = x < -M_PI ? x + TWO_PI : x;
+    double f = (0.5 * M_PI - fabs(x)) * (6.0 / M_PI);
+    return f > 1.0 ? 1.0 : (f < -1.0 ? -1.0 : f);
+}
+
+/* 0-based 60° sector of theta_e in [0,2π) */
+static inline int sector0(double theta_e)
+{
+    int s = (int)(theta_e * (3.0 / M_PI));
+    return s > 5 ? 5 : s;
+}
+
+/* 6-step drive pattern and floating phase per 0-based sector */
+static const double six_a[6] = {+1, +1, 0, -1, -1, 0};
+static const double six_b[6] = {-1, 0, +1, +1, 0, -1};
+static const double six_c[6] = {0, -1, -1, 0, +1, +1};
+static const int float_phase[6] = {2, 1, 0, 2, 1, 0};
+
+static double pi_step(double kp, double ki, double *integ,
+                      double err, double out_min, double out_max, double dt)
+{
+    double u = kp * err + *integ;
+    double out = clamp(u, out_min, out_max);
+    if (!((u > out_max && err > 0) || (u < out_min && err < 0)))
+        *integ += ki * err * dt;
+    return out;
+}
+
+/* ---------- lanes: one block of instances, structure-of-arrays ---------- */
+enum
+{
+    S_IA, S_IB, S_IC, S_OM, S_TH,    /* plant; S_TH is electrical angle */
+    S_FA, S_FB, S_FC,                /* trap120 shape at S_TH */
+    S_VA, S_VB, S_VC,                /* controller output */
+    S_ISPD, S_IID, S_IIQ,            /* PI integrators */
+    S_FTH, S_BLANK, S_LASTZC, S_DUE, /* sensorless */
+    M_RPMMAX, M_TOUT, M_IPK,         /* metrics */
+    M_WRMIN, M_WRMAX, M_WRSUM, M_WTMIN, M_WTMAX, M_WTSUM,
+    NSTATE
+};
+
+enum
+{
+    ZC_START_ALIGN,
+    ZC_START_RAMP,
+    ZC_CLOSED
+};
+
+/* Fixed-size rows of one object, so the compiler can see the lanes don't alias. */
+typedef struct
+{
+    double p[NPARAM][BLK];
+    double s[NSTATE][BLK];
+    int sec[BLK], zph[BLK], lsign[BLK]; /* sensorless */
+} Lanes;
+
+typedef struct
+{
+    double settle, overshoot, rpm_mean, rpm_pp, te_mean, te_pp, ipk;
+} Metrics;
+
+/* ---------- controllers: fill S_VA..S_VC from the pre-step state ---------- */
+static void ctrl_hall(Lanes *ln, int n, double dt)
+{
+    double *ia = ln->s[S_IA], *ib = ln->s[S_IB], *ic = ln->s[S_IC];
+    double *om = ln->s[S_OM], *th = ln->s[S_TH];
+    double *va = ln->s[S_VA], *vb = ln->s[S_VB], *vc = ln->s[S_VC];
+    double *ispd = ln->s[S_ISPD];
+    double (*p)[BLK] = ln->p;
+
+    for (int i = 0; i < n; i++)
+    {
+        double e_rpm = p[P_RPM][i] - om[i] * RPM_PER_RADS;
+        double duty = pi_step(p[P_KPSPD][i], p[P_KISPD][i], &ispd[i], e_rpm, 0.0, 1.0, dt);
+        double ilim = p[P_ILIM][i];
+        if (ilim > 0.0)
+        {
+            double imax = abs3max(ia[i], ib[i], ic[i]);
+            if (imax > ilim)
+                duty *= ilim / (imax + 1e-9);
+        }
+        int s = sector0(th[i]);
+        double v = 0.5 * p[P_VDC][i] * duty;
+        va[i] = v * six_a[s];
+        vb[i] = v * six_b[s];
+        vc[i] = v * six_c[s];
+    }
+}
+
+static void ctrl_sensorless(Lanes *ln, int n, double t, double dt)
+{
+    double *ia = ln->s[S_IA], *ib = ln->s[S_IB], *ic = ln->s[S_IC];
+    double *om = ln->s[S_OM];
+    double *fa = ln->s[S_FA], *fb = ln->s[S_FB], *fc = ln->s[S_FC];
+    double *va = ln->s[S_VA], *vb = ln->s[S_VB], *vc = ln->s[S_VC];
+    double *ispd = ln->s[S_ISPD], *fth = ln->s[S_FTH];
+    double *blank_until = ln->s[S_BLANK], *last_zc = ln->s[S_LASTZC];
+    double *due = ln->s[S_DUE];
+    int *sec = ln->sec, *zph = ln->zph, *lsign = ln->lsign;
+    double (*p)[BLK] = ln->p;
+
+    for (int i = 0; i < n; i++)
+    {
+        double rpm = om[i] * RPM_PER_RADS;
+        double duty;
+        const double f[3] = {fa[i], fb[i], fc[i]};
+        if (zph[i] == ZC_START_ALIGN)
+        {
+            duty = clamp(p[P_DALIGN][i], 0.0, 1.0);
+            sec[i] = 0;
+            if (t >= p[P_ALIGN][i])
+            {
+                zph[i] = ZC_START_RAMP;
+                fth[i] = 0.0;
+            }
+        }
+        else if (zph[i] == ZC_START_RAMP)
+        {
+            double alpha = clamp((t - p[P_ALIGN][i]) / fmax(1e-9, p[P_RAMP][i]), 0.0, 1.0);
+            double x = fth[i] + TWO_PI * p[P_F1][i] * alpha * dt;
+            fth[i] = x >= TWO_PI ? x - TWO_PI : x;
+            sec[i] = sector0(fth[i]);
+            duty = clamp(p[P_DALIGN][i] + (p[P_DRAMP][i] - p[P_DALIGN][i]) * alpha, 0.0, 1.0);
+            if (rpm >= p[P_HANDOVER][i])
+            {
+                double ef = f[float_phase[sec[i]]] * p[P_KE][i] * om[i];
+                lsign[i] = ef >= 0 ? +1 : -1;
+                last_zc[i] = -1.0;
+                due[i] = -1.0;
+                blank_until[i] = t + p[P_BLANK][i];
+                zph[i] = ZC_CLOSED;
+            }
+        }
+        else
+        {
+            duty = pi_step(p[P_KPSPD][i], p[P_KISPD][i], &ispd[i],
+                           p[P_RPM][i] - rpm, 0.0, 1.0, dt);
+            double ilim = p[P_ILIM][i];
+            if (ilim > 0.0)
+            {
+                double imax = abs3max(ia[i], ib[i], ic[i]);
+                if (imax > ilim)
+                    duty *= ilim / (imax + 1e-9);
+            }
+
+            /* ZC on the floating phase, commutate 30° later */
+            double ef = f[float_phase[sec[i]]] * p[P_KE][i] * om[i];
+            int sign = ef >= 0 ? +1 : -1;
+            if (t > blank_until[i] && sign != lsign[i])
+            {
+                if (last_zc[i] >= 0.0)
+                    due[i] = t + (t - last_zc[i]) / 6.0;
+                else
+                    due[i] = t + (M_PI / 6.0) / fmax(1e-6, p[P_PP][i] * om[i]);
+                last_zc[i] = t;
+                lsign[i] = sign;
+            }
+            if (due[i] >= 0.0 && t >= due[i])
+            {
+                sec[i] = sec[i] == 5 ? 0 : sec[i] + 1;
+                due[i] = -1.0;
+                blank_until[i] = t + p[P_BLANK][i];
+                double ef2 = f[float_phase[sec[i]]] * p[P_KE][i] * om[i];
+                lsign[i] = ef2 >= 0 ? +1 : -1;
+            }
+        }
+        double v = 0.5 * p[P_VDC][i] * duty;
+        va[i] = v * six_a[sec[i]];
+        vb[i] = v * six_b[sec[i]];
+        vc[i] = v * six_c[sec[i]];
+    }
+}
+
+static void ctrl_foc(Lanes *ln, int n, double dt)
+{
+    double *ia = ln->s[S_IA], *ib = ln->s[S_IB], *ic = ln->s[S_IC];
+    double *om = ln->s[S_OM], *th = ln->s[S_TH];
+    double *va = ln->s[S_VA], *vb = ln->s[S_VB], *vc = ln->s[S_VC];
+    double *ispd = ln->s[S_ISPD], *iid = ln->s[S_IID], *iiq = ln->s[S_IIQ];
+    double (*p)[BLK] = ln->p;
+    const double sqrt3 = sqrt(3.0);
+
+    for (int i = 0; i < n; i++)
+    {
+        double Vdc = p[P_VDC][i];
+
+        /* Clarke + Park on the true angle */
+        double i_alpha = ia[i];
+        double i_beta = (ia[i] + 2.0 * ib[i]) / sqrt3;
+        double ce = cos(th[i]), se = sin(th[i]);
+        double i_d = ce * i_alpha + se * i_beta;
+        double i_q = -se * i_alpha + ce * i_beta;
+
+        double iq_max = p[P_IQMAX][i];
+        double e_rpm = p[P_RPM][i] - om[i] * RPM_PER_RADS;
+        double iq_ref = pi_step(p[P_KPSPD][i], p[P_KISPD][i], &ispd[i], e_rpm, 0.0, 1.0, dt) * iq_max;
+        iq_ref = clamp(iq_ref, -iq_max, iq_max);
+
+        double vd = pi_step(p[P_KPID][i], p[P_KIID][i], &iid[i], p[P_IDREF][i] - i_d, -1e9, 1e9, dt);
+        double vq = pi_step(p[P_KPIQ][i], p[P_KIIQ][i], &iiq[i], iq_ref - i_q, -1e9, 1e9, dt);
+
+        double Vmax = Vdc / sqrt3;
+        double Vmag = hypot(vd, vq);
+        if (Vmag > Vmax)
+        {
+            double scale = Vmax / (Vmag + 1e-12);
+            vd *= scale;
+            vq *= scale;
+        }
+
+        double v_alpha = ce * vd - se * vq;
+        double v_beta = se * vd + ce * vq;
+        double da = clamp(0.5 + v_alpha / Vdc, 0.0, 1.0);
+        double db = clamp(0.5 + (-0.5 * v_alpha + 0.5 * sqrt3 * v_beta) / Vdc, 0.0, 1.0);
+        double dc = clamp(0.5 + (-0.5 * v_alpha - 0.5 * sqrt3 * v_beta) / Vdc, 0.0, 1.0);
+
+        double ilim = p[P_ILIM][i];
+        if (ilim > 0.0)
+        {
+            double imax = abs3max(ia[i], ib[i], ic[i]);
+            if (imax > ilim)
+            {
+                double sc = ilim / (imax + 1e-9);
+                da = 0.5 + (da - 0.5) * sc;
+                db = 0.5 + (db - 0.5) * sc;
+                dc = 0.5 + (dc - 0.5) * sc;
+            }
+        }
+
+        double davg = (da + db + dc) / 3.0;
+        va[i] = Vdc * (da - davg);
+        vb[i] = Vdc * (db - davg);
+        vc[i] = Vdc * (dc - davg);
+    }
+}
+
+/* ---------- plant: one Euler step for every lane, plus running metrics ---------- */
+static void plant_step(Lanes *ln, int n, double dt, double t1, double band, int in_win)
+{
+    /* Rows are indexed straight off ln rather than through pointer copies:
+       GCC can then prove they are disjoint even after inlining. */
+    double (*s)[BLK] = ln->s, (*p)[BLK] = ln->p;
+
+    for (int i = 0; i < n; i++)
+    {
+        double w = s[S_OM][i];
+        double fa = s[S_FA][i], fb = s[S_FB][i], fc = s[S_FC][i];
+        double a = s[S_IA][i], b = s[S_IB][i], c = s[S_IC][i];
+        double R = p[P_R][i], L = p[P_L][i], kw = p[P_KE][i] * w;
+        a += (s[S_VA][i] - R * a - kw * fa) / L * dt;
+        b += (s[S_VB][i] - R * b - kw * fb) / L * dt;
+        c += (s[S_VC][i] - R * c - kw * fc) / L * dt;
+        /* a floating phase decays geometrically; keep it out of subnormals,
+           which cost ~100x per operation and stall the whole block */
+        a = fabs(a) < 1e-200 ? 0.0 : a;
+        b = fabs(b) < 1e-200 ? 0.0 : b;
+        c = fabs(c) < 1e-200 ? 0.0 : c;
+
+        double Te = p[P_KT][i] * (fa * a + fb * b + fc * c) / 1.5;
+        w += (Te - p[P_B][i] * w - p[P_LOAD][i]) / p[P_J][i] * dt;
+        w = w < 0.0 ? 0.0 : w;
+
+        double x = s[S_TH][i] + p[P_PP][i] * w * dt;
+        x -= TWO_PI * (double)(int)(x * (1.0 / TWO_PI));
+        s[S_IA][i] = a;
+        s[S_IB][i] = b;
+        s[S_IC][i] = c;
+        s[S_OM][i] = w;
+        s[S_TH][i] = x;
+        s[S_FA][i] = trap120(x);
+        s[S_FB][i] = trap120(x - TWO_PI / 3.0);
+        s[S_FC][i] = trap120(x + TWO_PI / 3.0);
+
+        double rpm = w * RPM_PER_RADS, ref = p[P_RPM][i];
+        double im = abs3max(a, b, c);
+        s[M_RPMMAX][i] = rpm > s[M_RPMMAX][i] ? rpm : s[M_RPMMAX][i];
+        s[M_IPK][i] = im > s[M_IPK][i] ? im : s[M_IPK][i];
+        s[M_TOUT][i] = fabs(rpm - ref) > band * ref ? t1 : s[M_TOUT][i];
+        if (in_win)
+        {
+            s[M_WRMIN][i] = rpm < s[M_WRMIN][i] ? rpm : s[M_WRMIN][i];
+            s[M_WRMAX][i] = rpm > s[M_WRMAX][i] ? rpm : s[M_WRMAX][i];
+            s[M_WRSUM][i] += rpm;
+            s[M_WTMIN][i] = Te < s[M_WTMIN][i] ? Te : s[M_WTMIN][i];
+            s[M_WTMAX][i] = Te > s[M_WTMAX][i] ? Te : s[M_WTMAX][i];
+            s[M_WTSUM][i] += Te;
+        }
+    }
+}
+
+/* ---------- block runner ---------- */
+static void run_block(const Spec *sp, Lanes *ln, long id0, int n, Metrics *out)
+{
+    double p[NPARAM];
+    int mode = MODE_HALL;
+    for (int i = 0; i < n; i++)
+    {
+        mode = instance_params(sp, id0 + i, p);
+        for (int k = 0; k < NPARAM; k++)
+            ln->p[k][i] = p[k];
+    }
+    for (int k = 0; k < NSTATE; k++)
+        memset(ln->s[k], 0, sizeof ln->s[k]);
+    for (int i = 0; i < n; i++)
+    {
+        ln->s[S_FA][i] = trap120(0.0);
+        ln->s[S_FB][i] = trap120(-TWO_PI / 3.0);
+        ln->s[S_FC][i] = trap120(TWO_PI / 3.0);
+        ln->s[S_LASTZC][i] = -1.0;
+        ln->s[S_DUE][i] = -1.0;
+        ln->s[M_WRMIN][i] = ln->s[M_WTMIN][i] = HUGE_VAL;
+        ln->s[M_WRMAX][i] = ln->s[M_WTMAX][i] = -HUGE_VAL;
+        ln->sec[i] = 0;
+        ln->zph[i] = ZC_START_ALIGN;
+        ln->lsign[i] = 0;
+    }
+
+    double dt = sp->dt;
+    long nstep = (long)ceil(sp->sim_t / dt - 1e-9);
+    long win0 = (long)((1.0 - sp->win) * nstep);
+    if (win0 >= nstep)
+        win0 = nstep - 1;
+    for (long k = 0; k < nstep; k++)
+    {
+        double t = k * dt;
+        switch (mode)
+        {
+        case MODE_HALL:
+            ctrl_hall(ln, n, dt);
+            break;
+        case MODE_SENSORLESS:
+            ctrl_sensorless(ln, n, t, dt);
+            break;
+        default:
+            ctrl_foc(ln, n, dt);
+            break;
+        }
+        plant_step(ln, n, dt, (k + 1) * dt, sp->band, k >= win0);
+    }
+
+    double t_end = nstep * dt, nwin = (double)(nstep - win0);
+    for (int i = 0; i < n; i++)
+    {
+        Metrics *m = &out[i];
+        double ref = ln->p[P_RPM][i];
+        double te_mean = ln->s[M_WTSUM][i] / nwin;
+        m->settle = ln->s[M_TOUT][i] >= t_end ? -1.0 : ln->s[M_TOUT][i];
+        m->overshoot = fmax(0.0, ln->s[M_RPMMAX][i] - ref) * 100.0 / ref;
+        m->rpm_mean = ln->s[M_WRSUM][i] / nwin;
+        m->rpm_pp = ln->s[M_WRMAX][i] - ln->s[M_WRMIN][i];
+        m->te_mean = te_mean;
+        m->te_pp = (ln->s[M_WTMAX][i] - ln->s[M_WTMIN][i]) * 100.0 / fmax(1e-12, fabs(te_mean));
+        m->ipk = ln->s[M_IPK][i];
+    }
+}
+
+/* ---------- thread pool: workers pull blocks off a shared counter ---------- */
+typedef struct
+{
+    const Spec *sp;
+    Metrics *res;
+    long blocks_per_mode, nblock, next;
+    pthread_mutex_t mu;
+} Pool;
+
+static void *worker(void *arg)
+{
+    Pool *pl = arg;
+    const Spec *sp = pl->sp;
+    Lanes *ln = malloc(sizeof *ln);
+    if (!ln)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (;;)
+    {
+        pthread_mutex_lock(&pl->mu);
+        long b = pl->next++;
+        pthread_mutex_unlock(&pl->mu);
+        if (b >= pl->nblock)
+            break;
+        long start = (b % pl->blocks_per_mode) * BLK;
+        long id0 = (b / pl->blocks_per_mode) * sp->per_mode + start;
+        long n = sp->per_mode - start;
+        run_block(sp, ln, id0, n < BLK ? (int)n : BLK, pl->res + id0);
+    }
+    free(ln);
+    return NULL;
+}
+
+/* ---------- CLI ---------- */
+static int argd(const char *a, const char *key, double *out)
+{
+    size_t n = strlen(key);
+    if (strncmp(a, key, n) == 0 && a[n] == '=')
+    {
+        *out = atof(a + n + 1);
+        return 1;
+    }
+    return 0;
+}
+static int args(const char *a, const char *key, const char **out)
+{
+    size_t n = strlen(key);
+    if (strncmp(a, key, n) == 0 && a[n] == '=')
+    {
+        *out = a + n + 1;
+        return 1;
+    }
+    return 0;
+}
+static void usage(const char *p)
+{
+    fprintf(stderr,
+            "Usage: %s [--mode=hall,sensorless,foc] [sweep] [--KEY=value...] [engine]\n"
+            "Sweep:\n"
+            "  --grid=KEY=v1,v2,...  --grid=KEY=lo:hi:n[:log]\n"
+            "  --rand=KEY=lo:hi[:log] --samples=1 --seed=1\n"
+            "Engine:\n"
+            "  --t=1.0 --dt=0.00005 --threads=<ncpu> --band=0.02 --win=0.2\n"
+            "KEY (defaults as bldc_sim19):\n"
+            "  rpm vdc load ilim pp R L Ke Kt J B\n"
+            "  align ramp f1 d_align d_ramp blank handover\n"
+            "  Kp_spd Ki_spd Kp_id Ki_id Kp_iq Ki_iq idref iqmax\n",
+            p);
+}
+
+static int param_key(const char *s, size_t n)
+{
+    for (int k = 0; k < NPARAM; k++)
+        if (strlen(ptab[k].key) == n && !strncmp(s, ptab[k].key, n))
+            return k;
+    return -1;
+}
+
+static int swept(const Spec *sp, int key)
+{
+    for (int a = 0; a < sp->naxis; a++)
+        if (sp->axis[a].key == key)
+            return 1;
+    for (int d = 0; d < sp->ndraw; d++)
+        if (sp->draw[d].key == key)
+            return 1;
+    return 0;
+}
+
+/* KEY=... prefix of a --grid/--rand spec; returns the text after '=' */
+static const char *sweep_key(const Spec *sp, const char *s, int *key)
+{
+    const char *eq = strchr(s, '=');
+    if (!eq || (*key = param_key(s, (size_t)(eq - s))) < 0)
+    {
+        fprintf(stderr, "Bad sweep key in '%s'\n", s);
+        return NULL;
+    }
+    if (swept(sp, *key))
+    {
+        fprintf(stderr, "'%s' is swept twice\n", ptab[*key].key);
+        return NULL;
+    }
+    return eq + 1;
+}
+
+static int parse_grid(Spec *sp, const char *s)
+{
+    Axis *ax = &sp->axis[sp->naxis];
+    if (!(s = sweep_key(sp, s, &ax->key)))
+        return -1;
+    if (strchr(s, ':'))
+    {
+        double lo, hi;
+        int n, used = 0;
+        if (sscanf(s, "%lf:%lf:%d%n", &lo, &hi, &n, &used) != 3 || n < 1 ||
+            (s[used] && strcmp(s + used, ":log")))
+        {
+            fprintf(stderr, "Bad grid '%s' (want lo:hi:n[:log])\n", s);
+            return -1;
+        }
+        int lg = s[used] != 0;
+        if (lg && (lo <= 0 || hi <= 0))
+        {
+            fprintf(stderr, "Log grid needs positive bounds: '%s'\n", s);
+            return -1;
+        }
+        ax->n = n;
+        ax->v = malloc(sizeof(double) * n);
+        for (int i = 0; i < n; i++)
+        {
+            double u = n > 1 ? (double)i / (n - 1) : 0.0;
+            ax->v[i] = lg ? lo * pow(hi / lo, u) : lo + (hi - lo) * u;
+        }
+    }
+    else
+    {
+        ax->n = 1;
+        for (const char *c = s; *c; c++)
+            ax->n += *c == ',';
+        ax->v = malloc(sizeof(double) * ax->n);
+        for (int i = 0; i < ax->n; i++)
+        {
+            char *end;
+            ax->v[i] = strtod(s, &end);
+            if (end == s || (*end && *end != ','))
+            {
+                fprintf(stderr, "Bad grid value list '%s'\n", s);
+                free(ax->v);
+                return -1;
+            }
+            s = end + (*end == ',');
+        }
+    }
+    sp->naxis++;
+    return 0;
+}
+
+static int parse_rand(Spec *sp, const char *s)
+{
+    Draw *dr = &sp->draw[sp->ndraw];
+    int used = 0;
+    if (!(s = sweep_key(sp, s, &dr->key)))
+        return -1;
+    if (sscanf(s, "%lf:%lf%n", &dr->lo, &dr->hi, &used) != 2 ||
+        (s[used] && strcmp(s + used, ":log")))
+    {
+        fprintf(stderr, "Bad rand '%s' (want lo:hi[:log])\n", s);
+        return -1;
+    }
+    dr->logscale = s[used] != 0;
+    if (dr->logscale && (dr->lo <= 0 || dr->hi <= 0))
+    {
+        fprintf(stderr, "Log rand needs positive bounds: '%s'\n", s);
+        return -1;
+    }
+    sp->ndraw++;
+    return 0;
+}
+
+static int parse_modes(Spec *sp, const char *s)
+{
+    sp->nmode = 0;
+    while (*s)
+    {
+        size_t n = strcspn(s, ",");
+        int m;
+        for (m = 0; m < NMODE; m++)
+            if (strlen(mode_name[m]) == n && !strncmp(s, mode_name[m], n))
+                break;
+        if (m == NMODE || sp->nmode == NMODE)
+        {
+            fprintf(stderr, "Unknown mode in '%s'\n", s);
+            return -1;
+        }
+        sp->mode[sp->nmode++] = m;
+        s += n + (s[n] == ',');
+    }
+    return sp->nmode ? 0 : -1;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ---------- main ---------- */
+int main(int argc, char **argv)
+{
+    static Spec sp;
+    for (int k = 0; k < NPARAM; k++)
+        sp.base[k] = ptab[k].def;
+    sp.mode[0] = MODE_HALL;
+    sp.nmode = 1;
+    sp.samples = 1;
+    sp.seed = 1;
+    sp.sim_t = 1.0;
+    sp.dt = 0.00005;
+    sp.band = 0.02;
+    sp.win = 0.2;
+    double nthreads = (double)sysconf(_SC_NPROCESSORS_ONLN), samples = 1, seed = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *a = argv[i], *s;
+        int rc = 0, k;
+        if (!strcmp(a, "--help"))
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        else if (args(a, "--mode", &s))
+            rc = parse_modes(&sp, s);
+        else if (args(a, "--grid", &s))
+            rc = parse_grid(&sp, s);
+        else if (args(a, "--rand", &s))
+            rc = parse_rand(&sp, s);
+        else if (argd(a, "--samples", &samples) || argd(a, "--seed", &seed) ||
+                 argd(a, "--threads", &nthreads) || argd(a, "--t", &sp.sim_t) ||
+                 argd(a, "--dt", &sp.dt) || argd(a, "--band", &sp.band) ||
+                 argd(a, "--win", &sp.win))
+        {
+        }
+        else if (!strncmp(a, "--", 2) && strchr(a, '=') &&
+                 (k = param_key(a + 2, (size_t)(strchr(a, '=') - a - 2))) >= 0)
+            sp.base[k] = atof(strchr(a, '=') + 1);
+        else
+            rc = -1;
+        if (rc < 0)
+        {
+            fprintf(stderr, "Bad arg: %s\n", a);
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (sp.sim_t <= 0 || sp.dt <= 0 || sp.dt > sp.sim_t || samples < 1 ||
+        sp.win <= 0 || sp.win > 1 || sp.band <= 0)
+    {
+        fprintf(stderr, "Need t >= dt > 0, samples >= 1, 0 < win <= 1, band > 0\n");
+        return 1;
+    }
+    sp.samples = (long)samples;
+    sp.seed = (uint64_t)seed;
+    sp.per_mode = sp.samples;
+    for (int a = 0; a < sp.naxis; a++)
+        sp.per_mode *= sp.axis[a].n;
+    long total = sp.per_mode * sp.nmode;
+
+    Pool pl = {.sp = &sp, .next = 0};
+    pl.blocks_per_mode = (sp.per_mode + BLK - 1) / BLK;
+    pl.nblock = pl.blocks_per_mode * sp.nmode;
+    pl.res = malloc(sizeof(Metrics) * total);
+    int nth = nthreads < 1 ? 1 : (int)nthreads;
+    if (nth > pl.nblock)
+        nth = (int)pl.nblock;
+    pthread_t *th = malloc(sizeof(pthread_t) * nth);
+    if (!pl.res || !th)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    pthread_mutex_init(&pl.mu, NULL);
+
+    double t0 = now_s();
+    for (int i = 0; i < nth; i++)
+        pthread_create(&th[i], NULL, worker, &pl);
+    for (int i = 0; i < nth; i++)
+        pthread_join(th[i], NULL);
+    double wall = now_s() - t0;
+
+    /* CSV */
+    printf("# id,mode");
+    for (int a = 0; a < sp.naxis; a++)
+        printf(",%s", ptab[sp.axis[a].key].key);
+    for (int d = 0; d < sp.ndraw; d++)
+        printf(",%s", ptab[sp.draw[d].key].key);
+    printf(",settle_s,overshoot_pct,rpm_mean,rpm_ripple,Te_mean,Te_ripple_pct,ipk\n");
+    for (long id = 0; id < total; id++)
+    {
+        double p[NPARAM];
+        const Metrics *m = &pl.res[id];
+        int mode = instance_params(&sp, id, p);
+        printf("%ld,%s", id, mode_name[mode]);
+        for (int a = 0; a < sp.naxis; a++)
+            printf(",%.6g", p[sp.axis[a].key]);
+        for (int d = 0; d < sp.ndraw; d++)
+            printf(",%.6g", p[sp.draw[d].key]);
+        printf(",%.5f,%.3f,%.2f,%.3f,%.5f,%.2f,%.3f\n",
+               m->settle, m->overshoot, m->rpm_mean, m->rpm_pp,
+               m->te_mean, m->te_pp, m->ipk);
+    }
+
+    double motor_s = total * ceil(sp.sim_t / sp.dt - 1e-9) * sp.dt;
+    fprintf(stderr, "%ld instances x %g s on %d threads: %.3f s wall, "
+                    "%.1f motor-s/s (%.3g instance-steps/s)\n",
+            total, sp.sim_t, nth, wall, motor_s / wall, motor_s / sp.dt / wall);
+
+    for (int a = 0; a < sp.naxis; a++)
+        free(sp.axis[a].v);
+    free(pl.res);
+    free(th);
+    pthread_mutex_destroy(&pl.mu);
+    return 0;
+}
@@ -4,10 +4,17 @@
  *  - Cursor movement, scrolling, Home/End, PageUp/Down
  *  - Status & message bars, dirty flag with “press Ctrl-Q again” guard
  *  - Simple forward search (Ctrl-F), repeat with Enter, cancel with ESC
+ *  - Large files: the file is mmap'd and edited through a piece table, so
+ *    opening costs one newline-indexing pass and no copies; rows are only
+ *    materialised for the visible window; saves stream the pieces with
+ *    writev(); search runs memmem() over the pieces
  *
  * Works on Linux/macOS/BSD terminals (and on Windows via WSL/MSYS2).
  *
  * Build: gcc -std=c99 -Wall -Wextra -O2 -pedantic edit.c -o edit
+ *
+ * `edit --bench FILE` times open, redraws, edits, search and save on FILE
+ * without touching the terminal.
  */
 
 /*
@@ -26,6 +33,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -34,6 +42,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
@@ -41,6 +53,11 @@
 /* ---- Config ---- */
 #define TAB_STOP 4
 #define MINI_VERSION "0.1"
+#define LINE_CKPT 64  /* newline index keeps every LINE_CKPT-th line start */
+#define ROW_CACHE 256 /* materialised rows kept (> any screen height) */
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
 
 /* ---- Key codes ---- */
 #define CTRL_KEY(k) ((k) & 0x1f)
@@ -57,9 +74,57 @@ enum
     KEY_PAGE_DOWN
 };
 
-/* ---- Row model ---- */
+/* ---- Text model ----
+ * The document is a piece table: a sequence of slices of either the
+ * original file (mmap'd read-only, never copied) or an append-only buffer
+ * of typed text. Each piece knows how many newlines it holds, so an edit
+ * only splits or trims the pieces at the cursor and a line lookup skips
+ * whole pieces. The text is the rows joined by '\n' (a file's final
+ * newline is left out of the pieces and written back by save), so an
+ * empty last row survives a round trip. Newlines of the original are
+ * indexed once at open, keeping the start of every LINE_CKPT-th line;
+ * within a piece of the original a lookup jumps to the nearest checkpoint
+ * and memchr()s the rest.
+ */
+enum
+{
+    SRC_ORIG,
+    SRC_ADD
+};
+
 typedef struct
 {
+    int src;    /* SRC_ORIG or SRC_ADD */
+    size_t off; /* start in the source buffer */
+    size_t len; /* bytes, never 0 */
+    size_t nl;  /* newlines in the slice */
+} piece;
+
+struct textbuf
+{
+    const char *orig; /* original file contents */
+    size_t orig_len;
+    int orig_mapped; /* orig is an mmap (else malloc'd) */
+    size_t *ckpt;    /* ckpt[k] = orig offset where line k*LINE_CKPT starts */
+    size_t nckpt;
+    char *add; /* typed text, append-only */
+    size_t add_len, add_cap;
+    piece *pc;
+    int npc, cappc;
+    size_t len, nl;  /* document bytes and newlines */
+    int has_rows;    /* at least one row, if only an empty one */
+    unsigned gen;    /* bumped on every edit */
+    int hint_i;      /* lookup hint: piece hint_i starts at document */
+    size_t hint_pos; /* offset hint_pos, after hint_nl newlines */
+    size_t hint_nl;
+};
+
+/* A row materialised from the text, for the rows on screen */
+typedef struct
+{
+    int idx;      /* file row held */
+    unsigned gen; /* textbuf generation it was built from */
+    int crlf;     /* line ended in \r\n (the \r is not in chars) */
     int size;     /* chars length */
     int rsize;    /* render length (tabs expanded) */
     char *chars;  /* raw bytes */
@@ -76,7 +141,8 @@ struct editorConfig
     int screenrows;
     int screencols;
     int numrows;
-    erow *row;
+    struct textbuf tb;
+    erow rowcache[ROW_CACHE];
     int dirty;
     char *filename;
     char statusmsg[80];
@@ -241,6 +307,365 @@ static int getWindowSize(int *rows, int *cols)
     }
 }
 
+/* ---- Text buffer ---- */
+static size_t countNl(const char *s, size_t n)
+{
+    size_t c = 0;
+    const char *end = s + n;
+    while (s < end && (s = memchr(s, '\n', (size_t)(end - s))) != NULL)
+    {
+        c++;
+        s++;
+    }
+    return c;
+}
+
+static const char *pieceText(const piece *p)
+{
+    return (p->src == SRC_ORIG ? E.tb.orig : E.tb.add) + p->off;
+}
+
+/* Newlines in orig[0, x) */
+static size_t origRank(size_t x)
+{
+    const struct textbuf *tb = &E.tb;
+    size_t lo = 0, hi = tb->nckpt;
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (tb->ckpt[mid] <= x)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo * LINE_CKPT + countNl(tb->orig + tb->ckpt[lo], x - tb->ckpt[lo]);
+}
+
+/* Newlines in bytes [a, b) of a piece */
+static size_t pieceCountNl(const piece *p, size_t a, size_t b)
+{
+    if (p->src == SRC_ORIG && b - a > 4096)
+        return origRank(p->off + b) - origRank(p->off + a);
+    return countNl(pieceText(p) + a, b - a);
+}
+
+/* Offset within a piece just past its k-th newline (1 <= k <= p->nl) */
+static size_t pieceSkipLines(const piece *p, size_t k)
+{
+    const char *s = pieceText(p);
+    size_t i = 0;
+    if (p->src == SRC_ORIG && k > LINE_CKPT)
+    {
+        size_t line = origRank(p->off) + k;
+        size_t at = E.tb.ckpt[line / LINE_CKPT];
+        if (at >= p->off)
+        {
+            i = at - p->off;
+            k = line % LINE_CKPT;
+        }
+    }
+    while (k--)
+        i = (size_t)((const char *)memchr(s + i, '\n', p->len - i) - s) + 1;
+    return i;
+}
+
+/* Piece holding document offset pos (npc if pos == len); *off = offset in it */
+static int tbFind(size_t pos, size_t *off)
+{
+    struct textbuf *tb = &E.tb;
+    int i = 0;
+    size_t start = 0;
+    if (tb->hint_i < tb->npc && tb->hint_pos <= pos)
+    {
+        i = tb->hint_i;
+        start = tb->hint_pos;
+    }
+    while (i < tb->npc && start + tb->pc[i].len <= pos)
+        start += tb->pc[i++].len;
+    *off = pos - start;
+    return i;
+}
+
+/* Document offset where line `line` starts (len for lines past the end) */
+static size_t tbLineStart(int line)
+{
+    struct textbuf *tb = &E.tb;
+    size_t want = (size_t)line;
+    if (line <= 0)
+        return 0;
+    if (want > tb->nl)
+        return tb->len;
+    int i = 0;
+    size_t pos = 0, nl = 0;
+    if (tb->hint_i < tb->npc && tb->hint_nl < want)
+    {
+        i = tb->hint_i;
+        pos = tb->hint_pos;
+        nl = tb->hint_nl;
+    }
+    for (; i < tb->npc; i++)
+    {
+        const piece *p = &tb->pc[i];
+        if (nl + p->nl >= want)
+        {
+            tb->hint_i = i;
+            tb->hint_pos = pos;
+            tb->hint_nl = nl;
+            return pos + pieceSkipLines(p, want - nl);
+        }
+        pos += p->len;
+        nl += p->nl;
+    }
+    return tb->len;
+}
+
+/* Line holding document offset pos */
+static int tbLineOf(size_t pos)
+{
+    const struct textbuf *tb = &E.tb;
+    size_t start = 0, nl = 0;
+    for (int i = 0; i < tb->npc; i++)
+    {
+        const piece *p = &tb->pc[i];
+        if (pos < start + p->len)
+            return (int)(nl + pieceCountNl(p, 0, pos - start));
+        start += p->len;
+        nl += p->nl;
+    }
+    return (int)nl;
+}
+
+/* First '\n' at or after pos, or len */
+static size_t tbLineEnd(size_t pos)
+{
+    size_t off;
+    for (int i = tbFind(pos, &off); i < E.tb.npc; i++, off = 0)
+    {
+        const piece *p = &E.tb.pc[i];
+        const char *s = pieceText(p);
+        const char *q = memchr(s + off, '\n', p->len - off);
+        if (q)
+            return pos + (size_t)(q - (s + off));
+        pos += p->len - off;
+    }
+    return E.tb.len;
+}
+
+static void tbCopy(size_t pos, size_t n, char *dst)
+{
+    size_t off;
+    for (int i = tbFind(pos, &off); n > 0 && i < E.tb.npc; i++, off = 0)
+    {
+        const piece *p = &E.tb.pc[i];
+        size_t k = p->len - off < n ? p->len - off : n;
+        memcpy(dst, pieceText(p) + off, k);
+        dst += k;
+        n -= k;
+    }
+}
+
+/* Does q[0..n) occur at document offset pos? */
+static int tbMatchAt(size_t pos, const char *q, size_t n)
+{
+    size_t off;
+    for (int i = tbFind(pos, &off); n > 0; i++, off = 0)
+    {
+        if (i >= E.tb.npc)
+            return 0;
+        const piece *p = &E.tb.pc[i];
+        size_t k = p->len - off < n ? p->len - off : n;
+        if (memcmp(pieceText(p) + off, q, k) != 0)
+            return 0;
+        q += k;
+        n -= k;
+    }
+    return 1;
+}
+
+/* First match of q[0..n) starting in [from, to), or (size_t)-1. memmem()
+   finds matches inside a piece; only starts in a piece's last n-1 bytes
+   are checked across the boundary. */
+static size_t tbSearchForward(const char *q, size_t n, size_t from, size_t to)
+{
+    size_t off;
+    size_t start = from;
+    for (int i = tbFind(from, &off); i < E.tb.npc && start < to; i++, off = 0)
+    {
+        const piece *p = &E.tb.pc[i];
+        const char *s = pieceText(p);
+        size_t end = start - off + p->len; /* document offset of piece end */
+        if (p->len - off >= n)
+        {
+            const char *m = memmem(s + off, p->len - off, q, n);
+            if (m)
+            {
+                size_t at = start + (size_t)(m - (s + off));
+                return at < to ? at : (size_t)-1;
+            }
+        }
+        size_t tail = end - start < n - 1 ? start : end - (n - 1);
+        for (size_t at = tail; at < end && at < to; at++)
+            if (s[off + (at - start)] == q[0] && tbMatchAt(at, q, n))
+                return at;
+        start = end;
+    }
+    return (size_t)-1;
+}
+
+/* Last match of q[0..n) starting in [from, to), or (size_t)-1 */
+static size_t tbSearchBackward(const char *q, size_t n, size_t from, size_t to)
+{
+    if (to <= from)
+        return (size_t)-1;
+    size_t off;
+    int i = tbFind(to - 1, &off);
+    size_t start = to - 1 - off; /* document offset of piece i */
+    for (; i >= 0; i--)
+    {
+        const char *s = pieceText(&E.tb.pc[i]);
+        size_t hi = to - start; /* scan piece bytes [lo, hi) */
+        size_t lo = from > start ? from - start : 0;
+        for (size_t j = hi; j-- > lo;)
+            if (s[j] == q[0] && tbMatchAt(start + j, q, n))
+                return start + j;
+        if (start <= from || i == 0)
+            break;
+        to = start;
+        start -= E.tb.pc[i - 1].len;
+    }
+    return (size_t)-1;
+}
+
+static void tbEdited(void)
+{
+    struct textbuf *tb = &E.tb;
+    tb->gen++;
+    tb->hint_i = 0;
+    tb->hint_pos = tb->hint_nl = 0;
+    E.numrows = (tb->len > 0 || tb->has_rows) ? (int)tb->nl + 1 : 0;
+    E.dirty++;
+}
+
+/* Open a gap of n pieces at index at */
+static void tbOpenPieces(int at, int n)
+{
+    struct textbuf *tb = &E.tb;
+    if (tb->npc + n > tb->cappc)
+    {
+        tb->cappc = tb->cappc ? tb->cappc * 2 : 64;
+        if (tb->cappc < tb->npc + n)
+            tb->cappc = tb->npc + n;
+        tb->pc = realloc(tb->pc, sizeof(piece) * tb->cappc);
+        if (!tb->pc)
+            die("realloc");
+    }
+    memmove(&tb->pc[at + n], &tb->pc[at], sizeof(piece) * (tb->npc - at));
+    tb->npc += n;
+}
+
+static void tbInsert(size_t pos, const char *s, size_t n)
+{
+    struct textbuf *tb = &E.tb;
+    if (n == 0)
+        return;
+    if (tb->add_len + n > tb->add_cap)
+    {
+        tb->add_cap = tb->add_cap ? tb->add_cap * 2 : 4096;
+        if (tb->add_cap < tb->add_len + n)
+            tb->add_cap = tb->add_len + n;
+        tb->add = realloc(tb->add, tb->add_cap);
+        if (!tb->add)
+            die("realloc");
+    }
+    piece ins = {SRC_ADD, tb->add_len, n, countNl(s, n)};
+    memcpy(tb->add + tb->add_len, s, n);
+    tb->add_len += n;
+
+    size_t off;
+    int i = tbFind(pos, &off);
+    if (off == 0)
+    {
+        piece *prev = i > 0 ? &tb->pc[i - 1] : NULL;
+        if (prev && prev->src == SRC_ADD && prev->off + prev->len == ins.off)
+        { /* typing on: grow the previous piece */
+            prev->len += n;
+            prev->nl += ins.nl;
+        }
+        else
+        {
+            tbOpenPieces(i, 1);
+            tb->pc[i] = ins;
+        }
+    }
+    else
+    { /* split piece i around the insertion */
+        piece left = tb->pc[i], right = left;
+        left.len = off;
+        left.nl = pieceCountNl(&left, 0, off);
+        right.off += off;
+        right.len -= off;
+        right.nl -= left.nl;
+        tbOpenPieces(i + 1, 2);
+        tb->pc[i] = left;
+        tb->pc[i + 1] = ins;
+        tb->pc[i + 2] = right;
+    }
+    tb->len += n;
+    tb->nl += ins.nl;
+    tbEdited();
+}
+
+static void tbDelete(size_t pos, size_t n)
+{
+    struct textbuf *tb = &E.tb;
+    while (n > 0)
+    {
+        size_t off;
+        int i = tbFind(pos, &off);
+        if (i >= tb->npc)
+            break;
+        piece *p = &tb->pc[i];
+        size_t k = p->len - off < n ? p->len - off : n;
+        size_t gone = pieceCountNl(p, off, off + k);
+        if (p->src == SRC_ADD && off + k == p->len && p->off + p->len == tb->add_len)
+            tb->add_len -= k; /* backspace over fresh typing reuses the space */
+        if (k == p->len)
+        {
+            memmove(p, p + 1, sizeof(piece) * (tb->npc - i - 1));
+            tb->npc--;
+        }
+        else if (off == 0)
+        {
+            p->off += k;
+            p->len -= k;
+            p->nl -= gone;
+        }
+        else if (off + k == p->len)
+        {
+            p->len -= k;
+            p->nl -= gone;
+        }
+        else
+        { /* cut from the middle: split in two */
+            piece left = *p, right = *p;
+            left.len = off;
+            left.nl = pieceCountNl(&left, 0, off);
+            right.off += off + k;
+            right.len -= off + k;
+            right.nl -= left.nl + gone;
+            tbOpenPieces(i + 1, 1);
+            tb->pc[i] = left;
+            tb->pc[i + 1] = right;
+        }
+        tb->len -= k;
+        tb->nl -= gone;
+        n -= k;
+        tb->hint_i = 0; /* pieces moved */
+        tb->hint_pos = tb->hint_nl = 0;
+    }
+    tbEdited();
+}
+
 /* ---- Row ops ---- */
 static int editorRowCxToRx(erow *row, int cx)
 {
@@ -255,22 +680,6 @@ static int editorRowCxToRx(erow *row, int cx)
     return rx;
 }
 
-static int editorRowRxToCx(erow *row, int rx)
-{
-    int cur_rx = 0;
-    int cx;
-    for (cx = 0; cx < row->size; cx++)
-    {
-        if (row->chars[cx] == '\t')
-            cur_rx += (TAB_STOP - 1) - (cur_rx % TAB_STOP) + 1;
-        else
-            cur_rx++;
-        if (cur_rx > rx)
-            return cx;
-    }
-    return cx;
-}
-
 static void editorUpdateRow(erow *row)
 {
     int tabs = 0;
@@ -301,105 +710,71 @@ static void editorUpdateRow(erow *row)
     row->rsize = idx;
 }
 
-static void editorInsertRow(int at, const char *s, int len)
+/* Row y built from the text on first use, or NULL past the end. Rows are
+   cached by number; a pointer stays valid until the next edit or until a
+   row ROW_CACHE away is fetched. */
+static erow *editorRow(int y)
 {
-    if (at < 0 || at > E.numrows)
-        return;
-    E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
-    if (!E.row)
-        die("realloc");
-    memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
-    E.row[at].size = len;
-    E.row[at].chars = malloc(len + 1);
-    if (!E.row[at].chars)
-        die("malloc");
-    memcpy(E.row[at].chars, s, len);
-    E.row[at].chars[len] = '\0';
-    E.row[at].render = NULL;
-    E.row[at].rsize = 0;
-    editorUpdateRow(&E.row[at]);
-    E.numrows++;
-    E.dirty++;
-}
-
-static void editorFreeRow(erow *row)
-{
-    free(row->render);
+    if (y < 0 || y >= E.numrows)
+        return NULL;
+    erow *row = &E.rowcache[y % ROW_CACHE];
+    if (row->idx == y && row->gen == E.tb.gen)
+        return row;
+
+    size_t start = tbLineStart(y);
+    size_t n = tbLineEnd(start) - start;
     free(row->chars);
-}
-
-static void editorDelRow(int at)
-{
-    if (at < 0 || at >= E.numrows)
-        return;
-    editorFreeRow(&E.row[at]);
-    memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
-    E.numrows--;
-    E.dirty++;
-}
-
-static void editorRowInsertChar(erow *row, int at, int c)
-{
-    if (at < 0 || at > row->size)
-        at = row->size;
-    row->chars = realloc(row->chars, row->size + 2);
+    row->chars = malloc(n + 1);
     if (!row->chars)
-        die("realloc");
-    memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
-    row->size++;
-    row->chars[at] = c;
+        die("malloc");
+    tbCopy(start, n, row->chars);
+    row->crlf = n > 0 && row->chars[n - 1] == '\r';
+    if (row->crlf)
+        n--;
+    row->chars[n] = '\0';
+    row->size = (int)n;
+    row->idx = y;
+    row->gen = E.tb.gen;
     editorUpdateRow(row);
-    E.dirty++;
+    return row;
 }
 
-static void editorRowAppendString(erow *row, const char *s, int len)
+static size_t editorOffset(int y, int x)
 {
-    row->chars = realloc(row->chars, row->size + len + 1);
-    if (!row->chars)
-        die("realloc");
-    memcpy(&row->chars[row->size], s, len);
-    row->size += len;
-    row->chars[row->size] = '\0';
-    editorUpdateRow(row);
-    E.dirty++;
+    return tbLineStart(y) + (size_t)x;
 }
 
-static void editorRowDelChar(erow *row, int at)
+/* Append an empty row, for typing on the row past the end */
+static void editorAppendRow(void)
 {
-    if (at < 0 || at >= row->size)
-        return;
-    memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-    row->size--;
-    editorUpdateRow(row);
-    E.dirty++;
+    if (E.numrows > 0)
+        tbInsert(E.tb.len, "\n", 1);
+    else
+    {
+        E.tb.has_rows = 1;
+        tbEdited();
+    }
 }
 
 /* ---- Editor ops ---- */
 static void editorInsertChar(int c)
 {
+    char ch = (char)c;
     if (E.cy == E.numrows)
-    {
-        editorInsertRow(E.numrows, "", 0);
-    }
-    editorRowInsertChar(&E.row[E.cy], E.cx, c);
+        editorAppendRow();
+    tbInsert(editorOffset(E.cy, E.cx), &ch, 1);
     E.cx++;
 }
 
 static void editorInsertNewline(void)
 {
-    if (E.cx == 0)
-    {
-        editorInsertRow(E.cy, "", 0);
-    }
+    erow *row = editorRow(E.cy);
+    if (!row)
+        editorAppendRow();
+    else if (row->crlf) /* split keeps the line ending style */
+        tbInsert(editorOffset(E.cy, E.cx), "\r\n", 2);
     else
-    {
-        erow *row = &E.row[E.cy];
-        editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
-        row = &E.row[E.cy];
-        row->size = E.cx;
-        row->chars[row->size] = '\0';
-        editorUpdateRow(row);
-    }
+        tbInsert(editorOffset(E.cy, E.cx), "\n", 1);
     E.cy++;
     E.cx = 0;
 }
@@ -411,17 +786,17 @@ static void editorDelChar(void)
     if (E.cx == 0 && E.cy == 0)
         return;
 
-    erow *row = &E.row[E.cy];
     if (E.cx > 0)
     {
-        editorRowDelChar(row, E.cx - 1);
+        tbDelete(editorOffset(E.cy, E.cx) - 1, 1);
         E.cx--;
     }
     else
-    {
-        E.cx = E.row[E.cy - 1].size;
-        editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
-        editorDelRow(E.cy);
+    { /* join with the previous row: drop its line ending */
+        erow *prev = editorRow(E.cy - 1);
+        size_t eol = prev->crlf ? 2 : 1;
+        E.cx = prev->size;
+        tbDelete(editorOffset(E.cy, 0) - eol, eol);
         E.cy--;
     }
 }
@@ -444,78 +819,171 @@ static void abAppend(struct abuf *ab, const char *s, int len)
 }
 static void abFree(struct abuf *ab) { free(ab->b); }
 
-static char *editorRowsToString(int *buflen)
+/* Whole file, for inputs that cannot be mapped (pipes, devices) */
+static char *readAll(int fd, size_t *len)
 {
-    int totlen = 0;
-    for (int j = 0; j < E.numrows; j++)
-        totlen += E.row[j].size + 1;
-    *buflen = totlen;
-
-    char *buf = malloc(totlen);
+    size_t cap = 1 << 16, n = 0;
+    char *buf = malloc(cap);
     if (!buf)
         die("malloc");
-    int p = 0;
-    for (int j = 0; j < E.numrows; j++)
+    ssize_t r;
+    while ((r = read(fd, buf + n, cap - n)) > 0)
     {
-        memcpy(&buf[p], E.row[j].chars, E.row[j].size);
-        p += E.row[j].size;
-        buf[p++] = '\n';
+        n += (size_t)r;
+        if (n == cap)
+        {
+            buf = realloc(buf, cap *= 2);
+            if (!buf)
+                die("realloc");
+        }
     }
+    *len = n;
     return buf;
 }
 
 static void editorOpen(const char *filename)
 {
+    struct textbuf *tb = &E.tb;
     free(E.filename);
     E.filename = strdup(filename);
 
-    FILE *fp = fopen(filename, "rb");
-    if (!fp)
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
     { /* new file */
         E.dirty = 0;
         return;
     }
 
-    char *line = NULL;
-    size_t cap = 0;
-    ssize_t len;
-    while ((len = getline(&line, &cap, fp)) != -1)
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED)
+        {
+            tb->orig = m;
+            tb->orig_len = (size_t)st.st_size;
+            tb->orig_mapped = 1;
+        }
+    }
+    if (!tb->orig)
+        tb->orig = readAll(fd, &tb->orig_len);
+    close(fd);
+
+    /* one pass over the file: count newlines, keep checkpoints */
+    size_t cap = 64, nl = 0;
+    tb->ckpt = malloc(sizeof(size_t) * cap);
+    if (!tb->ckpt)
+        die("malloc");
+    tb->ckpt[0] = 0;
+    tb->nckpt = 1;
+    const char *s = tb->orig, *end = tb->orig + tb->orig_len;
+    while (s < end && (s = memchr(s, '\n', (size_t)(end - s))) != NULL)
+    {
+        s++;
+        if (++nl % LINE_CKPT == 0)
+        {
+            if (tb->nckpt == cap)
+            {
+                tb->ckpt = realloc(tb->ckpt, sizeof(size_t) * (cap *= 2));
+                if (!tb->ckpt)
+                    die("realloc");
+            }
+            tb->ckpt[tb->nckpt++] = (size_t)(s - tb->orig);
+        }
+    }
+
+    if (tb->orig_len > 0)
     {
-        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        size_t len = tb->orig_len;
+        if (tb->orig[len - 1] == '\n')
+        {
             len--;
-        editorInsertRow(E.numrows, line, (int)len);
+            nl--;
+        }
+        if (len > 0)
+        {
+            tbOpenPieces(0, 1);
+            tb->pc[0] = (piece){SRC_ORIG, 0, len, nl};
+        }
+        tb->len = len;
+        tb->nl = nl;
+        tb->has_rows = 1;
     }
-    free(line);
-    fclose(fp);
+    tbEdited();
     E.dirty = 0;
 }
 
+/* writev() every iovec, resuming after short writes */
+static int writeAll(int fd, struct iovec *iov, int cnt)
+{
+    while (cnt > 0)
+    {
+        ssize_t w = writev(fd, iov, cnt > IOV_MAX ? IOV_MAX : cnt);
+        if (w < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        while (cnt > 0 && (size_t)w >= iov->iov_len)
+        {
+            w -= (ssize_t)iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + w;
+            iov->iov_len -= (size_t)w;
+        }
+    }
+    return 0;
+}
+
+/* Streams the pieces straight from the mapping and the add buffer. Pieces
+   may still point into the mapped original, so the text goes to a sibling
+   temporary that is then renamed over the file. */
 static void editorSave(void)
 {
+    struct textbuf *tb = &E.tb;
     if (E.filename == NULL)
         return;
 
-    int len;
-    char *buf = editorRowsToString(&len);
-
-    int fd = open(E.filename, O_RDWR | O_CREAT, 0644);
+    size_t len = tb->len + (E.numrows > 0);
+    struct iovec *iov = malloc(sizeof(struct iovec) * (tb->npc + 1));
+    size_t tmplen = strlen(E.filename) + 8;
+    char *tmp = malloc(tmplen);
+    if (!iov || !tmp)
+        die("malloc");
+    int cnt = 0;
+    for (int i = 0; i < tb->npc; i++)
+        iov[cnt++] = (struct iovec){(void *)pieceText(&tb->pc[i]), tb->pc[i].len};
+    if (E.numrows > 0)
+        iov[cnt++] = (struct iovec){"\n", 1};
+    snprintf(tmp, tmplen, "%s.XXXXXX", E.filename);
+
+    struct stat st;
+    mode_t mode = stat(E.filename, &st) == 0 ? (st.st_mode & 07777) : 0644;
+    int fd = mkstemp(tmp);
     if (fd != -1)
     {
-        if (ftruncate(fd, len) != -1)
+        if (fchmod(fd, mode) != -1 && writeAll(fd, iov, cnt) != -1 &&
+            close(fd) != -1 && rename(tmp, E.filename) != -1)
         {
-            if (write(fd, buf, len) == len)
-            {
-                close(fd);
-                free(buf);
-                E.dirty = 0;
-                snprintf(E.statusmsg, sizeof(E.statusmsg), "\"%s\" (%d bytes) written", E.filename, len);
-                E.statusmsg_time = time(NULL);
-                return;
-            }
+            free(iov);
+            free(tmp);
+            E.dirty = 0;
+            snprintf(E.statusmsg, sizeof(E.statusmsg), "\"%s\" (%zu bytes) written", E.filename, len);
+            E.statusmsg_time = time(NULL);
+            return;
         }
+        int saved = errno;
         close(fd);
+        unlink(tmp);
+        errno = saved;
     }
-    free(buf);
+    free(iov);
+    free(tmp);
     snprintf(E.statusmsg, sizeof(E.statusmsg), "Can't save! I/O error: %s", strerror(errno));
     E.statusmsg_time = time(NULL);
 }
@@ -539,28 +1007,39 @@ static void editorFindCallback(const char *query, int key, int *last_match_row,
         E.cy = 0;
         E.cx = 0;
     }
+    if (!query || !*query)
+        return;
 
-    int current = *last_match_row;
-    int start = current == -1 ? 0 : current;
-    for (int i = 0; i < E.numrows; i++)
+    /* arrows and Enter step past the current match; an edited query is
+       tried again at the current match first */
+    size_t n = strlen(query), len = E.tb.len;
+    size_t from = 0, match;
+    int step = key == '\r' || key == KEY_ARROW_RIGHT || key == KEY_ARROW_DOWN ||
+               key == KEY_ARROW_LEFT || key == KEY_ARROW_UP;
+    if (*last_match_row != -1)
+        from = editorOffset(*last_match_row, *last_match_off) + (direction > 0 && step);
+    if (from > len)
+        from = len;
+    if (direction > 0)
+    {
+        match = tbSearchForward(query, n, from, len);
+        if (match == (size_t)-1)
+            match = tbSearchForward(query, n, 0, from);
+    }
+    else
     {
-        current += direction;
-        if (current == -1)
-            current = E.numrows - 1;
-        if (current == E.numrows)
-            current = 0;
+        match = tbSearchBackward(query, n, 0, from);
+        if (match == (size_t)-1)
+            match = tbSearchBackward(query, n, from, len);
+    }
 
-        erow *row = &E.row[current];
-        char *match = query && *query ? strstr(row->render, query) : NULL;
-        if (match)
-        {
-            *last_match_row = current;
-            *last_match_off = (int)(match - row->render);
-            E.cy = current;
-            E.cx = editorRowRxToCx(row, *last_match_off);
-            E.rowoff = E.numrows; /* force scroll to center on refresh */
-            break;
-        }
+    if (match != (size_t)-1)
+    {
+        *last_match_row = tbLineOf(match);
+        *last_match_off = (int)(match - tbLineStart(*last_match_row));
+        E.cy = *last_match_row;
+        E.cx = *last_match_off;
+        E.rowoff = E.numrows; /* force scroll to center on refresh */
     }
 }
 
@@ -645,8 +1124,9 @@ static void editorFind(void)
 static void editorScroll(void)
 {
     E.rx = 0;
-    if (E.cy < E.numrows)
-        E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
+    erow *row = editorRow(E.cy);
+    if (row)
+        E.rx = editorRowCxToRx(row, E.cx);
 
     if (E.cy < E.rowoff)
         E.rowoff = E.cy;
@@ -690,12 +1170,13 @@ static void editorDrawRows(struct abuf *ab)
         }
         else
         {
-            int len = E.row[filerow].rsize - E.coloff;
+            erow *row = editorRow(filerow);
+            int len = row->rsize - E.coloff;
             if (len < 0)
                 len = 0;
             if (len > E.screencols)
                 len = E.screencols;
-            abAppend(ab, &E.row[filerow].render[E.coloff], len);
+            abAppend(ab, &row->render[E.coloff], len);
         }
 
         abAppend(ab, "\x1b[K", 3); /* clear line right */
@@ -772,7 +1253,7 @@ static void editorSetStatusMessage(const char *fmt, ...)
 /* ---- Input ---- */
 static void editorMoveCursor(int key)
 {
-    erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+    erow *row = editorRow(E.cy);
 
     switch (key)
     {
@@ -782,7 +1263,7 @@ static void editorMoveCursor(int key)
         else if (E.cy > 0)
         {
             E.cy--;
-            E.cx = E.row[E.cy].size;
+            E.cx = editorRow(E.cy)->size;
         }
         break;
     case KEY_ARROW_RIGHT:
@@ -804,7 +1285,7 @@ static void editorMoveCursor(int key)
         break;
     }
 
-    row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+    row = editorRow(E.cy);
     int rowlen = row ? row->size : 0;
     if (E.cx > rowlen)
         E.cx = rowlen;
@@ -862,7 +1343,7 @@ static void editorProcessKeypress(void)
 
     case KEY_END:
         if (E.cy < E.numrows)
-            E.cx = E.row[E.cy].size;
+            E.cx = editorRow(E.cy)->size;
         break;
 
     case CTRL_KEY('l'):
@@ -904,7 +1385,7 @@ static void editorProcessKeypress(void)
 
     case CTRL_KEY('e'):
         if (E.cy < E.numrows)
-            E.cx = E.row[E.cy].size;
+            E.cx = editorRow(E.cy)->size;
         break;
 
     default:
@@ -921,7 +1402,9 @@ static void initEditor(void)
     E.cx = E.cy = E.rx = 0;
     E.rowoff = E.coloff = 0;
     E.numrows = 0;
-    E.row = NULL;
+    E.tb.gen = 1;
+    for (int i = 0; i < ROW_CACHE; i++)
+        E.rowcache[i].idx = -1;
     E.dirty = 0;
     E.filename = NULL;
 
@@ -932,9 +1415,91 @@ static void initEditor(void)
     editorSetStatusMessage("HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find");
 }
 
+/* ---- Bench ---- */
+static double nowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Open FILE, redraw at random places, type and delete on random rows,
+   search for an absent string and save a copy, timing each step */
+static int editorBench(const char *path)
+{
+    E.screenrows = 48;
+    E.screencols = 120;
+    E.tb.gen = 1;
+    for (int i = 0; i < ROW_CACHE; i++)
+        E.rowcache[i].idx = -1;
+
+    double t0 = nowSec();
+    editorOpen(path);
+    double t_open = nowSec() - t0;
+    if (E.numrows == 0)
+    {
+        fprintf(stderr, "%s: empty or unreadable\n", path);
+        return 1;
+    }
+
+    unsigned seed = 12345;
+    const int draws = 2000, edits = 20000;
+    t0 = nowSec();
+    for (int k = 0; k < draws; k++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        E.cy = (int)((seed >> 8) % (unsigned)E.numrows);
+        E.cx = 0;
+        struct abuf ab = ABUF_INIT;
+        editorScroll();
+        editorDrawRows(&ab);
+        abFree(&ab);
+    }
+    double t_draw = nowSec() - t0;
+
+    t0 = nowSec();
+    for (int k = 0; k < edits; k++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        E.cy = (int)((seed >> 8) % (unsigned)E.numrows);
+        E.cx = editorRow(E.cy)->size / 2;
+        editorInsertChar('x');
+        editorDelChar();
+        editorInsertChar('#');
+    }
+    double t_edit = nowSec() - t0;
+
+    t0 = nowSec();
+    size_t hit = tbSearchForward("\x01no such text\x02", 14, 0, E.tb.len);
+    double t_find = nowSec() - t0;
+
+    char *copy = malloc(strlen(path) + 7);
+    if (!copy)
+        die("malloc");
+    sprintf(copy, "%s.bench", path);
+    free(E.filename);
+    E.filename = copy;
+    t0 = nowSec();
+    editorSave();
+    double t_save = nowSec() - t0;
+    unlink(copy);
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("%zu bytes, %d lines, %d pieces%s\n", E.tb.len, E.numrows, E.tb.npc,
+           hit == (size_t)-1 ? "" : " (search hit?)");
+    printf("open %.1f ms, redraw %.1f us, edit %.2f us, search %.1f ms, save %.1f ms\n",
+           t_open * 1e3, t_draw * 1e6 / draws, t_edit * 1e6 / (3 * edits), t_find * 1e3, t_save * 1e3);
+    printf("max RSS %ld KiB: %s\n", (long)ru.ru_maxrss, E.statusmsg);
+    return 0;
+}
+
 /* ---- Main ---- */
 int main(int argc, char *argv[])
 {
+    if (argc >= 3 && strcmp(argv[1], "--bench") == 0)
+        return editorBench(argv[2]);
+
     enableRawMode();
     initEditor();
     if (argc >= 2)
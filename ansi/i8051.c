@@ -9,8 +9,16 @@
  * Not a full 8051: no interrupts/timers/serial yet (easy to add later).
  * Instruction timings approximate classic 12 clocks/machine cycle parts.
  *
+ * Two cores share the instruction semantics: step() decodes and executes
+ * one instruction (used for --trace and --slow), and run_blocks() executes
+ * pre-decoded basic blocks from a cache over the code space with
+ * computed-goto dispatch. run_cycles() is the batched API for long
+ * regression runs; it checks its budget only at block boundaries, which
+ * is also where timers and interrupts belong once they exist.
+ *
  * Build:   gcc -std=c99 -O2 -Wall -Wextra i8051.c -o i8051
  * Example: ./i8051 --steps 2000 --mhz 12
+ *          ./i8051 --bench 50000000
  */
 
 #include <stdio.h>
@@ -20,6 +28,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdarg.h>
+#include <time.h>
 
 /* -------- 8051 core state -------- */
 typedef struct
@@ -40,6 +49,7 @@ typedef struct
     uint64_t instrs; /* instruction count */
     uint64_t clocks; /* clock cycles (12 per machine cycle default) */
     bool trace;
+    bool quiet; /* no PORT change lines (--bench) */
     double mhz;
 } Mcu;
 
@@ -93,7 +103,7 @@ static inline void write_data(Mcu *m, uint8_t addr, uint8_t v)
             m->SP = v;
 
         /* Print GPIO changes */
-        if ((addr == SFR_P0 || addr == SFR_P1 || addr == SFR_P2 || addr == SFR_P3) && old != v)
+        if ((addr == SFR_P0 || addr == SFR_P1 || addr == SFR_P2 || addr == SFR_P3) && old != v && !m->quiet)
         {
             int port = (addr - 0x80) / 8; /* rough id */
             fprintf(stderr, "PORT change: P%d = 0x%02X\n",
@@ -155,10 +165,10 @@ static inline uint16_t fetch16(Mcu *m)
 static inline void set_parity(Mcu *m)
 {
     uint8_t a = m->A;
-    int ones = 0;
-    for (int i = 0; i < 8; i++)
-        ones += ((a >> i) & 1);
-    if (ones & 1)
+    a ^= a >> 4;
+    a ^= a >> 2;
+    a ^= a >> 1;
+    if (a & 1)
         m->PSW |= PSW_P;
     else
         m->PSW &= ~PSW_P;
@@ -227,6 +237,256 @@ static int cycles_lookup(uint8_t op)
     }
 }
 
+/* -------- Pre-decoded block cache --------
+ *
+ * Code is decoded once into basic blocks: straight-line runs that end at a
+ * jump, branch, call or return, at an unimplemented opcode, or after
+ * BLK_MAX instructions. Each Dec holds the handler, length, machine cycles
+ * (cycles_lookup() once, not per instruction) and operands, with relative
+ * branches already resolved to absolute targets; each Blk holds the
+ * instruction count, cycle total and fall-through address of the block
+ * starting at that address.
+ *
+ * Code is ROM to the CPU, so nothing in the instruction set invalidates the
+ * cache. Hosts that patch code must use code_write(); a write to a byte
+ * that has been decoded drops the whole cache (bumping gen makes every Blk
+ * stale at once).
+ */
+
+#define BLK_MAX 64
+
+#define I51_OPS(X)                                   \
+    X(NOP)                                           \
+    X(LJMP)        /* PC = t */                      \
+    X(LCALL)       /* push return address, PC = t */ \
+    X(RET)         /* RET and RETI */                \
+    X(SJMP)        /* PC = t */                      \
+    X(MOV_DPTR)    /* DPTR = t */                    \
+    X(MOV_A_IMM)   /* A = a */                       \
+    X(MOV_DIR_IMM) /* [a] = b */                     \
+    X(MOV_RN_IMM)  /* Ra = b */                      \
+    X(MOV_A_DIR)   /* A = [a] */                     \
+    X(MOV_DIR_A)   /* [a] = A */                     \
+    X(INC_A)                                         \
+    X(DEC_A)                                         \
+    X(INC_DIR)     /* [a]++ */                       \
+    X(DEC_DIR)     /* [a]-- */                       \
+    X(DJNZ_DIR)    /* if --[a] PC = t */             \
+    X(DJNZ_RN)     /* if --Ra PC = t */              \
+    X(ADD_A_IMM)   /* A += a */                      \
+    X(SUBB_A_IMM)  /* A -= a + CY */                 \
+    X(CLR_A)                                         \
+    X(CPL_A)                                         \
+    X(CLR_BIT)     /* [a] &= ~b */                   \
+    X(SETB_BIT)    /* [a] |= b */                    \
+    X(CPL_BIT)     /* [a] ^= b */                    \
+    X(JB)          /* if [a] & b PC = t */           \
+    X(JNB)         /* if !([a] & b) PC = t */        \
+    X(UNIMPL)
+
+#define I51_OP_ENUM(o) H_##o,
+enum
+{
+    I51_OPS(I51_OP_ENUM) H_COUNT
+};
+#undef I51_OP_ENUM
+
+typedef struct
+{
+    uint8_t h;   /* handler, H_* */
+    uint8_t len; /* bytes */
+    uint8_t cyc; /* machine cycles */
+    uint8_t a;   /* direct/bit byte address, register or immediate */
+    uint8_t b;   /* immediate or bit mask */
+    uint16_t t;  /* imm16 or absolute branch target */
+} Dec;
+
+typedef struct
+{
+    uint32_t gen;  /* valid while equal to the cache's gen */
+    uint16_t n;    /* instructions */
+    uint16_t next; /* address after the last one */
+    uint32_t cyc;  /* machine cycles of all n */
+    bool stop;     /* next holds an unimplemented opcode */
+} Blk;
+
+typedef struct
+{
+    Dec dec[65536];
+    Blk blk[65536];
+    uint8_t covered[65536 / 8]; /* code bytes some Dec was built from */
+    uint32_t gen;
+    const Mcu *owner;
+} BlockCache;
+
+static BlockCache g_bc;
+
+static void bc_flush(BlockCache *bc, const Mcu *owner)
+{
+    bc->gen++;
+    if (bc->gen == 0)
+    { /* wrapped: stale entries could look valid again */
+        memset(bc->blk, 0, sizeof bc->blk);
+        bc->gen = 1;
+    }
+    memset(bc->covered, 0, sizeof bc->covered);
+    bc->owner = owner;
+}
+
+/* Host write to code memory; keeps the block cache honest */
+static void code_write(Mcu *m, uint16_t addr, uint8_t v)
+{
+    if (m->code[addr] == v)
+        return;
+    m->code[addr] = v;
+    if (g_bc.owner == m && (g_bc.covered[addr >> 3] & (1u << (addr & 7))))
+        bc_flush(&g_bc, m);
+}
+
+/* Decode the instruction at pc; true if it ends a basic block */
+static bool decode_one(const Mcu *m, uint16_t pc, Dec *d)
+{
+    uint8_t op = m->code[pc];
+    uint8_t o1 = m->code[(uint16_t)(pc + 1)];
+    uint8_t o2 = m->code[(uint16_t)(pc + 2)];
+    d->cyc = (uint8_t)cycles_lookup(op);
+    d->len = 1;
+    d->a = 0;
+    d->b = 0;
+    d->t = 0;
+
+    switch (op)
+    {
+    case 0x00:
+        d->h = H_NOP;
+        return false;
+    case 0x02:
+    case 0x12:
+        d->h = (op == 0x02) ? H_LJMP : H_LCALL;
+        d->len = 3;
+        d->t = (uint16_t)((o1 << 8) | o2);
+        return true;
+    case 0x22:
+    case 0x32:
+        d->h = H_RET;
+        return true;
+    case 0x80:
+        d->h = H_SJMP;
+        d->len = 2;
+        d->t = (uint16_t)(pc + 2 + (int8_t)o1);
+        return true;
+    case 0x90:
+        d->h = H_MOV_DPTR;
+        d->len = 3;
+        d->t = (uint16_t)((o1 << 8) | o2);
+        return false;
+    case 0x74:
+    case 0x24:
+    case 0x94:
+        d->h = (op == 0x74) ? H_MOV_A_IMM : (op == 0x24) ? H_ADD_A_IMM : H_SUBB_A_IMM;
+        d->len = 2;
+        d->a = o1;
+        return false;
+    case 0x75:
+        d->h = H_MOV_DIR_IMM;
+        d->len = 3;
+        d->a = o1;
+        d->b = o2;
+        return false;
+    case 0x78 ... 0x7F:
+        d->h = H_MOV_RN_IMM;
+        d->len = 2;
+        d->a = op & 7;
+        d->b = o1;
+        return false;
+    case 0xE5:
+    case 0xF5:
+    case 0x05:
+    case 0x15:
+        d->h = (op == 0xE5) ? H_MOV_A_DIR : (op == 0xF5) ? H_MOV_DIR_A : (op == 0x05) ? H_INC_DIR : H_DEC_DIR;
+        d->len = 2;
+        d->a = o1;
+        return false;
+    case 0x04:
+        d->h = H_INC_A;
+        return false;
+    case 0x14:
+        d->h = H_DEC_A;
+        return false;
+    case 0xE4:
+        d->h = H_CLR_A;
+        return false;
+    case 0xF4:
+        d->h = H_CPL_A;
+        return false;
+    case 0xD5:
+        d->h = H_DJNZ_DIR;
+        d->len = 3;
+        d->a = o1;
+        d->t = (uint16_t)(pc + 3 + (int8_t)o2);
+        return true;
+    case 0xD8 ... 0xDF:
+        d->h = H_DJNZ_RN;
+        d->len = 2;
+        d->a = op & 7;
+        d->t = (uint16_t)(pc + 2 + (int8_t)o1);
+        return true;
+    case 0xC2:
+    case 0xD2:
+    case 0xB2:
+        /* Same byte/bit split as step(), including its IRAM bit addresses */
+        d->h = (op == 0xC2) ? H_CLR_BIT : (op == 0xD2) ? H_SETB_BIT : H_CPL_BIT;
+        d->len = 2;
+        d->a = o1 & 0xF8;
+        d->b = (uint8_t)(1u << (o1 & 7));
+        return false;
+    case 0x20:
+    case 0x30:
+        d->h = (op == 0x20) ? H_JB : H_JNB;
+        d->len = 3;
+        d->a = o1 & 0xF8;
+        d->b = (uint8_t)(1u << (o1 & 7));
+        d->t = (uint16_t)(pc + 3 + (int8_t)o2);
+        return true;
+    default:
+        d->h = H_UNIMPL;
+        return true;
+    }
+}
+
+static Blk *decode_block(BlockCache *bc, const Mcu *m, uint16_t start)
+{
+    Blk *b = &bc->blk[start];
+    uint32_t pc = start;
+    b->n = 0;
+    b->cyc = 0;
+    b->stop = false;
+    for (;;)
+    {
+        Dec *d = &bc->dec[pc];
+        bool end = decode_one(m, (uint16_t)pc, d);
+        for (uint32_t i = 0; i < d->len; i++)
+        {
+            uint16_t a = (uint16_t)(pc + i);
+            bc->covered[a >> 3] |= (uint8_t)(1u << (a & 7));
+        }
+        if (d->h == H_UNIMPL)
+        {
+            b->stop = true;
+            break;
+        }
+        b->n++;
+        b->cyc += d->cyc;
+        pc += d->len;
+        /* Dec entries are walked by address, so a block never wraps */
+        if (end || b->n == BLK_MAX || pc > 0xFFFF)
+            break;
+    }
+    b->next = (uint16_t)pc;
+    b->gen = bc->gen;
+    return b;
+}
+
 /* Intel HEX loader (very small; supports types 00,01,04) */
 static bool load_hex(Mcu *m, const char *path)
 {
@@ -255,7 +515,7 @@ static bool load_hex(Mcu *m, const char *path)
             pos += 2;
             uint32_t a = base + addr + i;
             if (a < 65536)
-                m->code[a] = (uint8_t)byte;
+                code_write(m, (uint16_t)a, (uint8_t)byte);
             chk += byte;
         }
         unsigned filechk;
@@ -550,6 +810,255 @@ static bool step(Mcu *m)
     return true;
 }
 
+/* Block core. Registers and their SFR mirrors are coherent between
+   instructions (step() gets there with sync_from_sfr/sync_to_sfr); each
+   handler refreshes the mirrors of the registers it changed directly, and
+   write_data() already keeps the rest in step, so the two cores can be
+   mixed freely. */
+#define MIRROR_A() (m->sfr[SFR_ACC - 0x80] = m->A)
+#define MIRROR_PSW() (m->sfr[SFR_PSW - 0x80] = m->PSW)
+#define MIRROR_SP() (m->sfr[SFR_SP - 0x80] = m->SP)
+#define MIRROR_DPTR() (m->sfr[SFR_DPL - 0x80] = (uint8_t)(m->DPTR & 0xFF), m->sfr[SFR_DPH - 0x80] = (uint8_t)(m->DPTR >> 8))
+
+/* Run at most max_instrs instructions, stopping at the first block boundary
+   where clocks >= max_clocks. A block that would overrun max_instrs is
+   finished with step(), so instruction counts are exact; the clock limit
+   may be overshot by up to one block. Returns false on an unimplemented
+   opcode, like step(). */
+static bool run_blocks(Mcu *m, uint64_t max_instrs, uint64_t max_clocks)
+{
+    uint64_t end = (max_instrs > UINT64_MAX - m->instrs) ? UINT64_MAX : m->instrs + max_instrs;
+    if (m->trace)
+    {
+        while (m->instrs < end && m->clocks < max_clocks)
+            if (!step(m))
+                return false;
+        return true;
+    }
+
+    BlockCache *bc = &g_bc;
+    if (bc->owner != m || bc->gen == 0)
+        bc_flush(bc, m);
+
+#ifdef __GNUC__
+#define I51_LABEL(o) &&L_##o,
+    static const void *const labels[] = {I51_OPS(I51_LABEL)};
+#undef I51_LABEL
+#define CASE(o) L_##o
+#define DISPATCH() goto *labels[d->h]
+#else
+#define CASE(o) case H_##o
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT()               \
+    do                       \
+    {                        \
+        if (--left == 0)     \
+            goto block_done; \
+        d += d->len;         \
+        DISPATCH();          \
+    } while (0)
+
+    while (m->instrs < end && m->clocks < max_clocks)
+    {
+        Blk *b = &bc->blk[m->PC];
+        if (b->gen != bc->gen)
+            b = decode_block(bc, m, m->PC);
+        if (b->n > end - m->instrs)
+        {
+            while (m->instrs < end)
+                if (!step(m))
+                    return false;
+            break;
+        }
+        const Dec *d = &bc->dec[m->PC];
+        uint32_t left = b->n;
+        m->instrs += b->n;
+        m->clocks += (uint64_t)b->cyc * 12;
+        m->PC = b->next; /* branches overwrite it; LCALL pushes it */
+        if (left == 0)
+            goto block_done;
+        DISPATCH();
+#ifndef __GNUC__
+    dispatch:
+        switch (d->h)
+#endif
+        {
+        CASE(NOP):
+            NEXT();
+        CASE(LJMP):
+            m->PC = d->t;
+            NEXT();
+        CASE(LCALL):
+            push(m, (uint8_t)((m->PC >> 8) & 0xFF));
+            push(m, (uint8_t)(m->PC & 0xFF));
+            MIRROR_SP();
+            m->PC = d->t;
+            NEXT();
+        CASE(RET):
+        {
+            uint8_t lo = pop(m), hi = pop(m);
+            MIRROR_SP();
+            m->PC = ((uint16_t)hi << 8) | lo;
+            NEXT();
+        }
+        CASE(SJMP):
+            m->PC = d->t;
+            NEXT();
+        CASE(MOV_DPTR):
+            m->DPTR = d->t;
+            MIRROR_DPTR();
+            NEXT();
+        CASE(MOV_A_IMM):
+            m->A = d->a;
+            set_parity(m);
+            MIRROR_A();
+            MIRROR_PSW();
+            NEXT();
+        CASE(MOV_DIR_IMM):
+            write_data(m, d->a, d->b);
+            NEXT();
+        CASE(MOV_RN_IMM):
+            *reg_ptr(m, d->a) = d->b;
+            NEXT();
+        CASE(MOV_A_DIR):
+            m->A = read_data(m, d->a);
+            set_parity(m);
+            MIRROR_A();
+            MIRROR_PSW();
+            NEXT();
+        CASE(MOV_DIR_A):
+            write_data(m, d->a, m->A);
+            NEXT();
+        CASE(INC_A):
+            m->A++;
+            set_parity(m);
+            MIRROR_A();
+            MIRROR_PSW();
+            NEXT();
+        CASE(DEC_A):
+            m->A--;
+            set_parity(m);
+            MIRROR_A();
+            MIRROR_PSW();
+            NEXT();
+        CASE(INC_DIR):
+            write_data(m, d->a, (uint8_t)(read_data(m, d->a) + 1));
+            NEXT();
+        CASE(DEC_DIR):
+            write_data(m, d->a, (uint8_t)(read_data(m, d->a) - 1));
+            NEXT();
+        CASE(DJNZ_DIR):
+        {
+            uint8_t v = read_data(m, d->a) - 1;
+            write_data(m, d->a, v);
+            if (v != 0)
+                m->PC = d->t;
+            NEXT();
+        }
+        CASE(DJNZ_RN):
+        {
+            uint8_t *pr = reg_ptr(m, d->a);
+            if (--(*pr) != 0)
+                m->PC = d->t;
+            NEXT();
+        }
+        CASE(ADD_A_IMM):
+        {
+            uint8_t imm = d->a;
+            uint16_t sum = (uint16_t)m->A + imm;
+            m->PSW = (m->PSW & ~(PSW_CY | PSW_AC | PSW_OV));
+            if (((m->A & 0x0F) + (imm & 0x0F)) > 0x0F)
+                m->PSW |= PSW_AC;
+            if (sum & 0x100)
+                m->PSW |= PSW_CY;
+            uint8_t res = (uint8_t)sum;
+            if (((m->A ^ imm ^ 0x80) & (m->A ^ res) & 0x80))
+                m->PSW |= PSW_OV;
+            m->A = res;
+            set_parity(m);
+            MIRROR_A();
+            MIRROR_PSW();
+            NEXT();
+        }
+        CASE(SUBB_A_IMM):
+        {
+            uint8_t imm = d->a;
+            uint8_t cy = (m->PSW & PSW_CY) ? 1 : 0;
+            uint16_t diff = (uint16_t)m->A - imm - cy;
+            m->PSW &= ~(PSW_CY | PSW_AC | PSW_OV);
+            if (((m->A & 0x0F) - (imm & 0x0F) - cy) & 0x10)
+                m->PSW |= PSW_AC;
+            if (diff & 0x100)
+                m->PSW |= PSW_CY;
+            uint8_t res = (uint8_t)diff;
+            if (((m->A ^ imm) & (m->A ^ res) & 0x80))
+                m->PSW |= PSW_OV;
+            m->A = res;
+            set_parity(m);
+            MIRROR_A();
+            MIRROR_PSW();
+            NEXT();
+        }
+        CASE(CLR_A):
+            m->A = 0;
+            set_parity(m);
+            MIRROR_A();
+            MIRROR_PSW();
+            NEXT();
+        CASE(CPL_A):
+            m->A = ~m->A;
+            set_parity(m);
+            MIRROR_A();
+            MIRROR_PSW();
+            NEXT();
+        CASE(CLR_BIT):
+            write_data(m, d->a, read_data(m, d->a) & (uint8_t)~d->b);
+            NEXT();
+        CASE(SETB_BIT):
+            write_data(m, d->a, read_data(m, d->a) | d->b);
+            NEXT();
+        CASE(CPL_BIT):
+            write_data(m, d->a, read_data(m, d->a) ^ d->b);
+            NEXT();
+        CASE(JB):
+            if (read_data(m, d->a) & d->b)
+                m->PC = d->t;
+            NEXT();
+        CASE(JNB):
+            if (!(read_data(m, d->a) & d->b))
+                m->PC = d->t;
+            NEXT();
+        CASE(UNIMPL):
+            /* never inside a block; decode_block() ends them with stop */
+            goto block_done;
+#ifndef __GNUC__
+        default:
+            goto block_done;
+#endif
+        }
+    block_done:
+        if (b->stop && m->instrs < end)
+        {
+            uint16_t at = b->next;
+            fprintf(stderr, "Unimplemented opcode 0x%02X at 0x%04X\n", m->code[at], at);
+            m->PC = (uint16_t)(at + 1);
+            return false;
+        }
+    }
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+    return true;
+}
+
+/* Batched run for regression use: at least n machine cycles (finishing the
+   block in progress); false on an unimplemented opcode */
+static bool run_cycles(Mcu *m, uint64_t n)
+{
+    return run_blocks(m, UINT64_MAX, m->clocks + n * 12);
+}
+
 /* Initialize reset state */
 static void reset(Mcu *m)
 {
@@ -586,12 +1095,126 @@ static void load_builtin_blink(Mcu *m)
     memcpy(m->code, prog, sizeof prog);
 }
 
+/* Built-in --bench workload: nested DJNZ loops around a subroutine that
+   exercises the ALU, direct memory and bit branches; toggles P1.0 every
+   8192 calls.
+        MOV  SP,#30h
+        MOV  P1,#0FFh
+        MOV  DPTR,#1234h
+   L1:  CPL  P1.0
+        MOV  R7,#32
+   L2:  MOV  R6,#0
+   L3:  LCALL WORK
+        DJNZ R6,L3
+        DJNZ R7,L2
+        INC  40h
+        SJMP L1
+   WORK (0020h):
+        MOV  A,41h
+        ADD  A,#7
+        MOV  41h,A
+        SUBB A,#3
+        JB   ACC.0,W1
+        SETB F0
+   W1:  INC  A
+        CPL  A
+        MOV  42h,A
+        JNB  ACC.7,W2
+        NOP
+   W2:  DEC  43h
+        RET
+*/
+static void load_bench_program(Mcu *m)
+{
+    static const uint8_t main_loop[] = {
+        0x75, 0x81, 0x30, /* 0000 MOV SP,#30h */
+        0x75, 0x90, 0xFF, /* 0003 MOV P1,#0FFh */
+        0x90, 0x12, 0x34, /* 0006 MOV DPTR,#1234h */
+        0xB2, 0x90,       /* 0009 L1: CPL P1.0 */
+        0x7F, 32,         /* 000B MOV R7,#32 */
+        0x7E, 0,          /* 000D L2: MOV R6,#0 */
+        0x12, 0x00, 0x20, /* 000F L3: LCALL WORK */
+        0xDE, 0xFB,       /* 0012 DJNZ R6,L3 */
+        0xDF, 0xF7,       /* 0014 DJNZ R7,L2 */
+        0x05, 0x40,       /* 0016 INC 40h */
+        0x80, 0xEF        /* 0018 SJMP L1 */
+    };
+    static const uint8_t work[] = {
+        0xE5, 0x41,       /* 0020 MOV A,41h */
+        0x24, 0x07,       /* 0022 ADD A,#7 */
+        0xF5, 0x41,       /* 0024 MOV 41h,A */
+        0x94, 0x03,       /* 0026 SUBB A,#3 */
+        0x20, 0xE0, 0x02, /* 0028 JB ACC.0,W1 */
+        0xD2, 0xD5,       /* 002B SETB F0 */
+        0x04,             /* 002D W1: INC A */
+        0xF4,             /* 002E CPL A */
+        0xF5, 0x42,       /* 002F MOV 42h,A */
+        0x30, 0xE7, 0x01, /* 0031 JNB ACC.7,W2 */
+        0x00,             /* 0034 NOP */
+        0x15, 0x43,       /* 0035 W2: DEC 43h */
+        0x22              /* 0037 RET */
+    };
+    for (size_t i = 0; i < sizeof main_loop; i++)
+        code_write(m, (uint16_t)i, main_loop[i]);
+    for (size_t i = 0; i < sizeof work; i++)
+        code_write(m, (uint16_t)(0x20 + i), work[i]);
+}
+
+/* --bench: the loaded program for n instructions on step() and on the
+   block core, from the same state; reports emulated MIPS and checks that
+   both cores end in the same state */
+static bool same_state(const Mcu *a, const Mcu *b)
+{
+    return a->PC == b->PC && a->A == b->A && a->B == b->B && a->PSW == b->PSW && a->SP == b->SP &&
+           a->DPTR == b->DPTR && a->instrs == b->instrs && a->clocks == b->clocks &&
+           !memcmp(a->iram, b->iram, sizeof a->iram) && !memcmp(a->sfr, b->sfr, sizeof a->sfr);
+}
+
+static int bench(const Mcu *init, uint64_t n)
+{
+    static Mcu run[2];
+    double sec[2];
+    for (int e = 0; e < 2; e++)
+    {
+        Mcu *m = &run[e];
+        *m = *init;
+        m->quiet = true;
+        clock_t t0 = clock();
+        if (e == 0)
+        {
+            for (uint64_t i = 0; i < n; i++)
+                if (!step(m))
+                    break;
+        }
+        else
+            (void)run_blocks(m, n, UINT64_MAX);
+        sec[e] = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    }
+    static const char *const names[2] = {"step()", "blocks"};
+    printf("%-8s %12s %14s %9s %9s %10s\n", "core", "instrs", "clocks", "cpu s", "MIPS", "x realtime");
+    for (int e = 0; e < 2; e++)
+    {
+        double emu = run[e].clocks / (run[e].mhz * 1e6);
+        double s = sec[e] > 0.0 ? sec[e] : 1e-9;
+        printf("%-8s %12llu %14llu %9.3f %9.1f %10.1f\n", names[e], (unsigned long long)run[e].instrs,
+               (unsigned long long)run[e].clocks, sec[e], run[e].instrs / s / 1e6, emu / s);
+    }
+    bool same = same_state(&run[0], &run[1]);
+    printf("speedup %.1fx%s\n", sec[1] > 0.0 ? sec[0] / sec[1] : 0.0, same ? "" : "  MISMATCH");
+    return same ? 0 : 1;
+}
+
 /* CLI */
 static void usage(const char *p)
 {
     fprintf(stderr,
-            "Usage: %s [--hex file.hex] [--steps N] [--mhz F] [--trace]\n"
-            "If no --hex provided, runs a built-in P1.0 blink program.\n",
+            "Usage: %s [--hex file.hex] [--steps N] [--cycles N] [--mhz F] [--trace] [--slow]\n"
+            "       %s [--hex file.hex] --bench [N]\n"
+            "If no --hex provided, runs a built-in P1.0 blink program.\n"
+            "  --cycles N  run N machine cycles in batches (ends on a block boundary)\n"
+            "  --slow      execute with step() instead of the block cache\n"
+            "  --bench N   time N instructions on step() vs. the block cache\n",
+            p,
             p);
 }
 
@@ -601,13 +1224,27 @@ int main(int argc, char **argv)
     reset(&m);
     const char *hex = NULL;
     uint64_t steps = 2000;
+    uint64_t cycles = 0;
+    uint64_t bench_n = 0;
+    bool steps_given = false;
+    bool slow = false;
 
     for (int i = 1; i < argc; i++)
     {
         if (!strcmp(argv[i], "--hex") && i + 1 < argc)
             hex = argv[++i];
         else if (!strcmp(argv[i], "--steps") && i + 1 < argc)
+        {
             steps = strtoull(argv[++i], NULL, 0);
+            steps_given = true;
+        }
+        else if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            cycles = strtoull(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--slow"))
+            slow = true;
+        else if (!strcmp(argv[i], "--bench"))
+            bench_n = (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) ? strtoull(argv[++i], NULL, 0)
+                                                                            : 50000000u;
         else if (!strcmp(argv[i], "--mhz") && i + 1 < argc)
             m.mhz = atof(argv[++i]);
         else if (!strcmp(argv[i], "--trace"))
@@ -634,6 +1271,11 @@ int main(int argc, char **argv)
         }
         fprintf(stderr, "Loaded HEX: %s\n", hex);
     }
+    else if (bench_n)
+    {
+        load_bench_program(&m);
+        fprintf(stderr, "No HEX given; timing the built-in bench program.\n");
+    }
     else
     {
         load_builtin_blink(&m);
@@ -648,11 +1290,23 @@ int main(int argc, char **argv)
     write_data(&m, SFR_ACC, m.A);
     write_data(&m, SFR_B, m.B);
 
-    for (uint64_t i = 0; i < steps; i++)
+    if (bench_n)
+        return bench(&m, bench_n);
+
+    if (cycles && !steps_given)
+        steps = UINT64_MAX;
+    if (slow)
     {
-        if (!step(&m))
-            break;
+        for (uint64_t i = 0; i < steps; i++)
+        {
+            if (!step(&m) || (cycles && m.clocks >= cycles * 12))
+                break;
+        }
     }
+    else if (cycles && !steps_given)
+        (void)run_cycles(&m, cycles);
+    else
+        (void)run_blocks(&m, steps, cycles ? cycles * 12 : UINT64_MAX);
 
     double seconds = (m.clocks / (m.mhz * 1e6));
     fprintf(stderr, "Executed %llu instructions, ~%llu clocks (%.6f s @ %.3f MHz)\n",
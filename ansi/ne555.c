@@ -1,7 +1,8 @@
 /* ne555.c  —  NE555 timer simulator (astable & monostable)
  *
  * - Exact event-driven thresholds at 1/3 and 2/3 VCC (configurable).
- * - Emits uniform CSV samples (time, Vcap, Vout, state, discharge_on).
+ * - Emits uniform CSV samples (time, Vcap, Vout, state, discharge_on),
+ *   or, for long runs, only the edges, per-bucket min/max, or float32 binary.
  * - Prints analytic timing (period, duty, pulse width) to stderr.
  *
  * Compile:  gcc -std=c99 -O2 -lm ne555.c -o ne555
@@ -10,16 +11,38 @@
  *   ./ne555 --mode astable --vcc 5 --ra 1000 --rb 1000 --c 1e-7 --T 0.005 --dt 2e-6 > astable.csv
  *   ./ne555 --mode mono    --r 10000 --c 1e-5 --vcc 5 --trig 0.001 --trigw 1e-4 --T 0.06 --dt 1e-4 > mono.csv
  *
+ *   ./ne555 --mode astable --ra 1000 --rb 1000 --c 1e-7 --T 3600 --out events > edges.csv
+ *   ./ne555 --mode astable --ra 1000 --rb 1000 --c 1e-7 --T 3600 --out minmax --bucket 0.01 --bin > env.bin
+ *
+ * Output (--out):
+ *   samples  (default) one row per dt: time_s,vcap_v,vout_v,state,discharge_on
+ *   events   one row per output transition, same columns, time printed to full
+ *            double precision; plus a row for the initial state at t=0 and one
+ *            at T.  Cost is per edge, independent of dt.
+ *   minmax   one row per --bucket seconds (default T/1000):
+ *            t_start,vcap_min,vcap_max,vout_min,vout_max; exact, since Vcap is
+ *            monotonic between edges.  Cost is per edge plus per bucket.
+ *   --bin writes the same rows as a binary stream instead of text: a 48-byte
+ *   BinHeader (below) followed by nrows x ncols values in host byte order.
+ *   samples/minmax rows are float32 with time implicit (t0 + row*step) and
+ *   omit the time, state and discharge_on columns (state == vout > 0);
+ *   events rows are float64 time,vcap,vout.
+ *
  * Notes:
  * - Default thresholds are 1/3 and 2/3 VCC; override via --lofrac / --hifrac.
  * - Output HIGH ~ VCC, LOW ~ 0V. Monostable discharge is clamped to 0V (idealized).
  * - For astable, initial state is HIGH charging from 1/3 VCC by default.
  * - CSV header: time_s,vcap_v,vout_v,state(discrete),discharge_on(0/1)
+ * - Between edges Vcap is evaluated in closed form from the start of its
+ *   charge/discharge segment; edge times are summed with compensation so
+ *   they do not drift over hours of simulated time.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <math.h>
 #include <stdbool.h>
 
@@ -29,6 +52,13 @@ typedef enum
     MODE_MONO
 } Mode;
 
+typedef enum
+{
+    OUT_SAMPLES,
+    OUT_EVENTS,
+    OUT_MINMAX
+} OutKind;
+
 typedef struct
 {
     Mode mode;
@@ -55,8 +85,25 @@ typedef struct
     double trig_time;  /* seconds */
     double trig_width; /* seconds */
 
+    /* Output */
+    OutKind out;
+    int binary;
+    double bucket; /* minmax bucket width, seconds */
+
 } SimCfg;
 
+/* --bin stream header; host byte order */
+typedef struct
+{
+    char magic[8];     /* "NE555BIN" */
+    uint32_t version;  /* 1 */
+    uint32_t kind;     /* OutKind */
+    uint32_t ncols;    /* values per row */
+    uint32_t elem;     /* bytes per value: 4 (float32) or 8 (float64) */
+    double t0, step;   /* time of row i is t0 + i*step; step 0 for events */
+    uint64_t nrows;    /* 0 when not known up front (events) */
+} BinHeader;
+
 /* ------------ helpers ------------- */
 
 static void usage(const char *prog)
@@ -67,11 +114,13 @@ static void usage(const char *prog)
             "       [--vcinit V0] [--starthigh 0|1]\n"
             "  %s --mode mono    [--vcc V] --r R --c C --T T --dt dt [--lofrac a --hifrac b]\n"
             "       [--trig t0] [--trigw tw]\n"
+            "  output: [--out samples|events|minmax] [--bucket s] [--bin]\n"
             "\n"
             "Defaults:\n"
             "  --mode astable, --vcc 5.0, --lofrac 0.3333333333, --hifrac 0.6666666667\n"
             "  Astable: RA=1e4, RB=1e5,  C=1e-6,  T=0.02, dt=1e-5, Vcinit=VCC/3, starthigh=1\n"
             "  Mono   : R =1e4,  C =1e-5, T=0.05, dt=1e-4, trig=0.001, trigw=0.0001\n"
+            "  --out samples, --bucket T/1000\n"
             "\n",
             prog, prog);
 }
@@ -93,6 +142,9 @@ static int parse_args(int argc, char **argv, SimCfg *cfg)
     cfg->start_high = 1;
     cfg->trig_time = 0.001;
     cfg->trig_width = 1e-4;
+    cfg->out = OUT_SAMPLES;
+    cfg->binary = 0;
+    cfg->bucket = -1.0; /* means auto */
 
     for (int i = 1; i < argc; i++)
     {
@@ -135,6 +187,25 @@ static int parse_args(int argc, char **argv, SimCfg *cfg)
             cfg->trig_time = strtod(argv[++i], NULL);
         else if (!strcmp(argv[i], "--trigw") && i + 1 < argc)
             cfg->trig_width = strtod(argv[++i], NULL);
+        else if (!strcmp(argv[i], "--out") && i + 1 < argc)
+        {
+            i++;
+            if (!strcmp(argv[i], "samples"))
+                cfg->out = OUT_SAMPLES;
+            else if (!strcmp(argv[i], "events"))
+                cfg->out = OUT_EVENTS;
+            else if (!strcmp(argv[i], "minmax"))
+                cfg->out = OUT_MINMAX;
+            else
+            {
+                fprintf(stderr, "Unknown output %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[i], "--bucket") && i + 1 < argc)
+            cfg->bucket = strtod(argv[++i], NULL);
+        else if (!strcmp(argv[i], "--bin"))
+            cfg->binary = 1;
         else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h"))
         {
             usage(argv[0]);
@@ -157,6 +228,13 @@ static int parse_args(int argc, char **argv, SimCfg *cfg)
         fprintf(stderr, "Require positive VCC, C, dt, T.\n");
         return -1;
     }
+    if (cfg->bucket < 0)
+        cfg->bucket = cfg->T_end / 1000.0;
+    if (cfg->bucket <= 0)
+    {
+        fprintf(stderr, "Require positive bucket.\n");
+        return -1;
+    }
     return 0;
 }
 
@@ -198,198 +276,315 @@ static double clamp0(double x) { return (x < 0 && x > -1e-15) ? 0.0 : x; }
 
 /* ------------ simulation ------------- */
 
-static void simulate_astable(const SimCfg *cfg)
+/* The circuit as a chain of segments between output edges.  Within a segment
+   Vc(t) = Vinf + (V0 - Vinf) * exp(-(t - t0) / RC), or V0 if RC == 0. */
+typedef struct
+{
+    const SimCfg *cfg;
+    double Vhi, Vlo;
+    double RCchg, RCdis;     /* mono: RCchg = R*C */
+    double Tchg, Tdis;       /* astable: Vlo->Vhi and Vhi->Vlo, fixed after the first edge */
+    double t0, tc;           /* segment start, compensation term of the running sum */
+    double t1, dur;          /* next edge (INFINITY if none) and t1 - t0 before rounding */
+    double V0, Vinf, RC;
+    int out_high, discharge_on;
+    long edges;
+} Sim;
+
+static void seg_start(Sim *s, double V0, double Vinf, double RC, double dur)
+{
+    s->V0 = V0;
+    s->Vinf = Vinf;
+    s->RC = RC;
+    s->dur = dur;
+    s->t1 = s->t0 + dur;
+}
+
+static void sim_init(Sim *s, const SimCfg *cfg)
+{
+    memset(s, 0, sizeof *s);
+    s->cfg = cfg;
+    s->Vhi = cfg->hifrac * cfg->Vcc;
+    s->Vlo = cfg->lofrac * cfg->Vcc;
+    if (cfg->mode == MODE_ASTABLE)
+    {
+        s->RCchg = (cfg->RA + cfg->RB) * cfg->C;
+        s->RCdis = cfg->RB * cfg->C;
+        s->Tchg = t_to_reach_charge(s->Vlo, s->Vhi, cfg->Vcc, s->RCchg);
+        s->Tdis = t_to_reach_discharge(s->Vhi, s->Vlo, s->RCdis);
+        double Vc = (cfg->Vc_init >= 0 ? cfg->Vc_init : s->Vlo); /* default start at 1/3 VCC */
+        s->out_high = cfg->start_high ? 1 : 0;                    /* HIGH -> charging, LOW -> discharging */
+        s->discharge_on = !s->out_high;
+        if (s->out_high)
+            seg_start(s, Vc, cfg->Vcc, s->RCchg, t_to_reach_charge(Vc, s->Vhi, cfg->Vcc, s->RCchg));
+        else
+            seg_start(s, Vc, 0.0, s->RCdis, t_to_reach_discharge(Vc, s->Vlo, s->RCdis));
+    }
+    else
+    {
+        /* LOW with the cap clamped at 0 until the trigger */
+        s->RCchg = cfg->R * cfg->C;
+        s->discharge_on = 1;
+        seg_start(s, 0.0, 0.0, 0.0, cfg->trig_time > 0 ? cfg->trig_time : INFINITY);
+    }
+}
+
+/* take the edge at t1 and start the following segment */
+static void sim_next(Sim *s)
+{
+    const SimCfg *cfg = s->cfg;
+    double y = s->dur - s->tc, t = s->t0 + y;
+    s->tc = (t - s->t0) - y;
+    s->t0 = t;
+    s->edges++;
+    s->out_high = !s->out_high;
+    s->discharge_on = !s->out_high;
+    if (cfg->mode == MODE_ASTABLE)
+    {
+        if (s->out_high)
+            seg_start(s, s->Vlo, cfg->Vcc, s->RCchg, s->Tchg);
+        else
+            seg_start(s, s->Vhi, 0.0, s->RCdis, s->Tdis);
+    }
+    else if (s->out_high)
+    {
+        /* trigger: release the clamp, charge from 0 to Vhi */
+        seg_start(s, 0.0, cfg->Vcc, s->RCchg, t_to_reach_charge(0.0, s->Vhi, cfg->Vcc, s->RCchg));
+    }
+    else
+    {
+        /* end of pulse: idealized fast discharge, single trigger only */
+        seg_start(s, 0.0, 0.0, 0.0, INFINITY);
+    }
+}
+
+/* Vc at t in [t0, t1], clamped to the rails for numeric safety */
+static double sim_vc(const Sim *s, double t)
+{
+    double Vc = s->RC > 0 ? s->Vinf + (s->V0 - s->Vinf) * exp(-(t - s->t0) / s->RC) : s->V0;
+    if (Vc < 0)
+        Vc = 0;
+    if (Vc > s->cfg->Vcc)
+        Vc = s->cfg->Vcc;
+    return Vc;
+}
+
+static void print_expected(const SimCfg *cfg)
 {
     double Vhi = cfg->hifrac * cfg->Vcc;
     double Vlo = cfg->lofrac * cfg->Vcc;
-    double RCchg = (cfg->RA + cfg->RB) * cfg->C;
-    double RCdis = (cfg->RB) * cfg->C;
-
-    /* Analytic timing */
-    double Thigh = (log((cfg->Vcc - Vlo) / (cfg->Vcc - Vhi))) * RCchg; /* == ln(2)*(RA+RB)C at 1/3..2/3 */
-    double Tlow = (log(Vhi / Vlo)) * RCdis;                            /* == ln(2)*RB*C */
-    double Tper = Thigh + Tlow;
-    double duty = Thigh / Tper;
-    fprintf(stderr,
-            "[astable] expected: Thigh=%.9g s, Tlow=%.9g s, T=%.9g s, f=%.9g Hz, duty=%.4f\n",
-            Thigh, Tlow, Tper, (Tper > 0 ? 1.0 / Tper : 0.0), duty);
+    if (cfg->mode == MODE_ASTABLE)
+    {
+        double RCchg = (cfg->RA + cfg->RB) * cfg->C;
+        double RCdis = (cfg->RB) * cfg->C;
+        double Thigh = (log((cfg->Vcc - Vlo) / (cfg->Vcc - Vhi))) * RCchg; /* == ln(2)*(RA+RB)C at 1/3..2/3 */
+        double Tlow = (log(Vhi / Vlo)) * RCdis;                            /* == ln(2)*RB*C */
+        double Tper = Thigh + Tlow;
+        double duty = Thigh / Tper;
+        fprintf(stderr,
+                "[astable] expected: Thigh=%.9g s, Tlow=%.9g s, T=%.9g s, f=%.9g Hz, duty=%.4f\n",
+                Thigh, Tlow, Tper, (Tper > 0 ? 1.0 / Tper : 0.0), duty);
+    }
+    else
+    {
+        /* Analytic pulse width for step from 0 -> 2/3 VCC is ln(3)*R*C */
+        double Tpulse = log((cfg->Vcc) / (cfg->Vcc - Vhi)) * cfg->R * cfg->C; /* = ln(3) RC if hi=2/3 Vcc */
+        fprintf(stderr, "[monostable] expected pulse width: %.9g s (≈ ln(3)*R*C)\n", Tpulse);
+    }
+}
 
-    double Vc = (cfg->Vc_init >= 0 ? cfg->Vc_init : Vlo); /* default start at 1/3 VCC */
-    int out_high = cfg->start_high ? 1 : 0;               /* HIGH -> charging, LOW -> discharging */
-    int discharge_on = out_high ? 0 : 1;
+/* ------------ output ------------- */
 
-    printf("time_s,vcap_v,vout_v,state,discharge_on\n");
+/* Rows are collected here and handed to stdio in 1 MiB blocks. */
+#define OUTBUF_SIZE (1u << 20)
 
-    double t = 0.0;
-    for (double t_out = 0.0; t_out <= cfg->T_end + 1e-12; t_out += cfg->dt)
-    {
-        /* advance internal state from t to t_out, processing any threshold events exactly */
-        double remaining = t_out - t;
-        while (remaining > 1e-15)
-        {
-            if (out_high)
-            {
-                /* charging toward Vcc with RA+RB until Vhi */
-                double t_event = t_to_reach_charge(Vc, Vhi, cfg->Vcc, RCchg);
-                if (t_event > remaining)
-                {
-                    /* no event within this slice: evolve */
-                    double alpha = exp(-remaining / RCchg);
-                    Vc = cfg->Vcc + (Vc - cfg->Vcc) * alpha;
-                    t += remaining;
-                    remaining = 0.0;
-                }
-                else
-                {
-                    /* jump to event exactly, flip state */
-                    if (isfinite(t_event))
-                    {
-                        Vc = Vhi;
-                        t += t_event;
-                        remaining -= t_event;
-                    }
-                    else
-                    {
-                        /* should not happen; break to avoid loop */
-                        t += remaining;
-                        remaining = 0.0;
-                    }
-                    out_high = 0;
-                    discharge_on = 1; /* go LOW, start discharging */
-                }
-            }
-            else
-            {
-                /* discharging toward 0 through RB until Vlo */
-                double t_event = t_to_reach_discharge(Vc, Vlo, RCdis);
-                if (t_event > remaining)
-                {
-                    double alpha = exp(-remaining / RCdis);
-                    Vc = Vc * alpha;
-                    t += remaining;
-                    remaining = 0.0;
-                }
-                else
-                {
-                    if (isfinite(t_event))
-                    {
-                        Vc = Vlo;
-                        t += t_event;
-                        remaining -= t_event;
-                    }
-                    else
-                    {
-                        t += remaining;
-                        remaining = 0.0;
-                    }
-                    out_high = 1;
-                    discharge_on = 0; /* go HIGH, start charging */
-                }
-            }
-        }
+typedef struct
+{
+    size_t n;
+    char buf[OUTBUF_SIZE];
+} OutBuf;
 
-        double Vout = out_high ? cfg->Vcc : 0.0;
-        if (Vc < 0)
-            Vc = 0;
-        if (Vc > cfg->Vcc)
-            Vc = cfg->Vcc; /* numeric safety */
-        printf("%.10g,%.10g,%.10g,%d,%d\n", t_out, Vc, Vout, out_high, discharge_on);
+static void ob_flush(OutBuf *o)
+{
+    if (o->n && fwrite(o->buf, 1, o->n, stdout) != o->n)
+    {
+        perror("write");
+        exit(1);
     }
+    o->n = 0;
 }
 
-static void simulate_mono(const SimCfg *cfg)
+static void ob_write(OutBuf *o, const void *p, size_t len)
 {
-    double Vhi = cfg->hifrac * cfg->Vcc;
-    double Vlo = cfg->lofrac * cfg->Vcc;
-    (void)Vlo; /* not used in ideal mono run */
-    double RC = cfg->R * cfg->C;
+    if (o->n + len > OUTBUF_SIZE)
+        ob_flush(o);
+    memcpy(o->buf + o->n, p, len);
+    o->n += len;
+}
+
+static void ob_printf(OutBuf *o, const char *fmt, ...)
+{
+    va_list ap;
+    if (OUTBUF_SIZE - o->n < 256)
+        ob_flush(o);
+    va_start(ap, fmt);
+    int len = vsnprintf(o->buf + o->n, OUTBUF_SIZE - o->n, fmt, ap);
+    va_end(ap);
+    if (len > 0)
+        o->n += (size_t)len;
+}
+
+static void ob_header(OutBuf *o, OutKind kind, uint32_t ncols, uint32_t elem,
+                      double step, uint64_t nrows)
+{
+    BinHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, "NE555BIN", 8);
+    h.version = 1;
+    h.kind = (uint32_t)kind;
+    h.ncols = ncols;
+    h.elem = elem;
+    h.t0 = 0.0;
+    h.step = step;
+    h.nrows = nrows;
+    ob_write(o, &h, sizeof h);
+}
 
-    /* Analytic pulse width for step from 0 -> 2/3 VCC is ln(3)*R*C */
-    double Tpulse = log((cfg->Vcc) / (cfg->Vcc - Vhi)) * RC; /* = ln(3) RC if hi=2/3 Vcc */
-    fprintf(stderr, "[monostable] expected pulse width: %.9g s (≈ ln(3)*R*C)\n", Tpulse);
+static void put_f32(OutBuf *o, double v)
+{
+    float f = (float)v;
+    ob_write(o, &f, sizeof f);
+}
 
-    /* States */
-    double Vc = 0.0;
-    int out_high = 0;
-    int discharge_on = 1; /* holds cap at ~0 before trigger */
+static void put_f64(OutBuf *o, double v) { ob_write(o, &v, sizeof v); }
 
-    printf("time_s,vcap_v,vout_v,state,discharge_on\n");
+static void emit_row(OutBuf *o, const Sim *s, double t, double Vc)
+{
+    ob_printf(o, "%.10g,%.10g,%.10g,%d,%d\n", t, Vc,
+              s->out_high ? s->cfg->Vcc : 0.0, s->out_high, s->discharge_on);
+}
 
-    double t = 0.0;
-    for (double t_out = 0.0; t_out <= cfg->T_end + 1e-12; t_out += cfg->dt)
+static void out_samples(const SimCfg *cfg, Sim *s, OutBuf *o)
+{
+    if (cfg->binary)
     {
-        double remaining = t_out - t;
-        while (remaining > 1e-15)
+        /* t = k*dt rather than a running sum, so long runs stay on the grid */
+        uint64_t n = (uint64_t)floor((cfg->T_end + 1e-12) / cfg->dt) + 1;
+        ob_header(o, OUT_SAMPLES, 2, 4, cfg->dt, n);
+        for (uint64_t k = 0; k < n; k++)
         {
-            /* Trigger handling: when within this slice and currently LOW -> set HIGH */
-            double t_to_trig = INFINITY, t_to_trig_end = INFINITY;
-            if (!out_high)
-            {
-                if (t < cfg->trig_time && t + remaining >= cfg->trig_time)
-                {
-                    t_to_trig = cfg->trig_time - t;
-                }
-                if (t < cfg->trig_time + cfg->trig_width && t + remaining >= cfg->trig_time + cfg->trig_width)
-                {
-                    t_to_trig_end = cfg->trig_time + cfg->trig_width - t;
-                }
-            }
+            double t_out = (double)k * cfg->dt;
+            while (s->t1 <= t_out)
+                sim_next(s);
+            put_f32(o, sim_vc(s, t_out));
+            put_f32(o, s->out_high ? cfg->Vcc : 0.0);
+        }
+        return;
+    }
+    ob_printf(o, "time_s,vcap_v,vout_v,state,discharge_on\n");
+    for (double t_out = 0.0; t_out <= cfg->T_end + 1e-12; t_out += cfg->dt)
+    {
+        while (s->t1 <= t_out)
+            sim_next(s);
+        emit_row(o, s, t_out, sim_vc(s, t_out));
+    }
+}
 
-            if (out_high)
-            {
-                /* charging toward Vcc until Vhi */
-                double t_event = t_to_reach_charge(Vc, Vhi, cfg->Vcc, RC);
-                if (t_event > remaining)
-                {
-                    double alpha = exp(-remaining / RC);
-                    Vc = cfg->Vcc + (Vc - cfg->Vcc) * alpha;
-                    t += remaining;
-                    remaining = 0.0;
-                }
-                else
-                {
-                    if (isfinite(t_event))
-                    {
-                        Vc = Vhi;
-                        t += t_event;
-                        remaining -= t_event;
-                    }
-                    else
-                    {
-                        t += remaining;
-                        remaining = 0.0;
-                    }
-                    out_high = 0;
-                    discharge_on = 1; /* output LOW, discharge clamps */
-                    Vc = 0.0;         /* idealized fast discharge */
-                }
-            }
-            else
-            {
-                /* Output LOW: cap clamped to ~0. Just wait for trigger or time to pass */
-                double advance = remaining;
-                if (isfinite(t_to_trig) && t_to_trig >= 0 && t_to_trig < advance)
-                    advance = t_to_trig;
-                /* (We don't need t_to_trig_end for idealized level-trigger: falling edge irrelevant) */
-                t += advance;
-                remaining -= advance;
-                if (advance == t_to_trig)
-                {
-                    /* Trigger event: go HIGH, release clamp, start charging from ~0V */
-                    out_high = 1;
-                    discharge_on = 0;
-                    Vc = 0.0;
-                }
-            }
+static void out_event(const SimCfg *cfg, const Sim *s, OutBuf *o, double t, double Vc)
+{
+    if (cfg->binary)
+    {
+        put_f64(o, t);
+        put_f64(o, Vc);
+        put_f64(o, s->out_high ? cfg->Vcc : 0.0);
+    }
+    else
+        ob_printf(o, "%.17g,%.10g,%.10g,%d,%d\n", t, Vc,
+                  s->out_high ? cfg->Vcc : 0.0, s->out_high, s->discharge_on);
+}
+
+static void out_events(const SimCfg *cfg, Sim *s, OutBuf *o)
+{
+    if (cfg->binary)
+        ob_header(o, OUT_EVENTS, 3, 8, 0.0, 0);
+    else
+        ob_printf(o, "time_s,vcap_v,vout_v,state,discharge_on\n");
+    out_event(cfg, s, o, 0.0, sim_vc(s, 0.0));
+    while (s->t1 <= cfg->T_end)
+    {
+        sim_next(s);
+        out_event(cfg, s, o, s->t0, sim_vc(s, s->t0));
+    }
+    out_event(cfg, s, o, cfg->T_end, sim_vc(s, cfg->T_end));
+}
+
+static void out_minmax(const SimCfg *cfg, Sim *s, OutBuf *o)
+{
+    uint64_t nb = (uint64_t)ceil(cfg->T_end / cfg->bucket - 1e-9);
+    if (nb == 0)
+        nb = 1;
+    if (cfg->binary)
+        ob_header(o, OUT_MINMAX, 4, 4, cfg->bucket, nb);
+    else
+        ob_printf(o, "t_start,vcap_min,vcap_max,vout_min,vout_max\n");
+
+    for (uint64_t b = 0; b < nb; b++)
+    {
+        double ta = (double)b * cfg->bucket;
+        double tb = b + 1 < nb ? (double)(b + 1) * cfg->bucket : cfg->T_end;
+        /* Vc is monotonic inside a segment: extremes sit at the bucket ends
+           and on either side of each edge */
+        double v = sim_vc(s, ta), vmin = v, vmax = v;
+        int hi = s->out_high, lo = s->out_high;
+        while (s->t1 <= tb)
+        {
+            v = sim_vc(s, s->t1);
+            vmin = fmin(vmin, v);
+            vmax = fmax(vmax, v);
+            sim_next(s);
+            v = sim_vc(s, s->t0);
+            vmin = fmin(vmin, v);
+            vmax = fmax(vmax, v);
+            hi |= s->out_high;
+            lo &= s->out_high;
         }
+        v = sim_vc(s, tb);
+        vmin = fmin(vmin, v);
+        vmax = fmax(vmax, v);
+        double omin = lo ? cfg->Vcc : 0.0, omax = hi ? cfg->Vcc : 0.0;
+        if (cfg->binary)
+        {
+            put_f32(o, vmin);
+            put_f32(o, vmax);
+            put_f32(o, omin);
+            put_f32(o, omax);
+        }
+        else
+            ob_printf(o, "%.10g,%.10g,%.10g,%.10g,%.10g\n", ta, vmin, vmax, omin, omax);
+    }
+}
 
-        double Vout = out_high ? cfg->Vcc : 0.0;
-        if (Vc < 0)
-            Vc = 0;
-        if (Vc > cfg->Vcc)
-            Vc = cfg->Vcc;
-        printf("%.10g,%.10g,%.10g,%d,%d\n", t_out, Vc, Vout, out_high, discharge_on);
+static void simulate(const SimCfg *cfg)
+{
+    static OutBuf ob;
+    Sim s;
+    print_expected(cfg);
+    sim_init(&s, cfg);
+    switch (cfg->out)
+    {
+    case OUT_EVENTS:
+        out_events(cfg, &s, &ob);
+        break;
+    case OUT_MINMAX:
+        out_minmax(cfg, &s, &ob);
+        break;
+    default:
+        out_samples(cfg, &s, &ob);
+        break;
     }
+    ob_flush(&ob);
+    if (cfg->out != OUT_SAMPLES)
+        fprintf(stderr, "[out] %ld edges in %.9g s\n", s.edges, cfg->T_end);
 }
 
 /* --------------- main ---------------- */
@@ -412,7 +607,7 @@ int main(int argc, char **argv)
             fprintf(stderr, "RA and RB must be > 0\n");
             return 1;
         }
-        simulate_astable(&cfg);
+        simulate(&cfg);
     }
     else
     {
@@ -421,7 +616,7 @@ int main(int argc, char **argv)
             fprintf(stderr, "R must be > 0\n");
             return 1;
         }
-        simulate_mono(&cfg);
+        simulate(&cfg);
     }
     return 0;
 }
@@ -2,16 +2,23 @@
  *
  * Features
  *  - Tables with INT and TEXT(<=255) columns, optional INT PRIMARY KEY (hash index)
- *  - CREATE TABLE, INSERT, SELECT (WHERE), DELETE (WHERE), DROP TABLE
- *  - SAVE/LOAD binary format (portable enough for this demo)
- *  - .tables, .schema [name], .quit
+ *  - CREATE TABLE, CREATE INDEX, INSERT, SELECT (WHERE), DELETE (WHERE), DROP TABLE
+ *  - COPY t FROM 'file.csv' bulk load; TEXT cells live in a per-table arena,
+ *    interned while a column has few distinct values
+ *  - B+tree secondary indexes on INT/TEXT columns, used for WHERE =, <, <=, >, >=
+ *  - SAVE/LOAD paged binary format: LOAD mmaps column pages, SAVE appends only
+ *    the pages changed since the last SAVE/LOAD (see save/load below)
+ *  - Block-at-a-time WHERE scans on INT columns (SSE2/AVX2/NEON, scalar fallback)
+ *  - Optional write-ahead log with group commit for INSERT/DELETE/DDL (.wal)
+ *  - COUNT/SUM/MIN/MAX/AVG with optional GROUP BY (INT), run on a worker pool
+ *  - .tables, .schema [name], .wal, .threads [N], .bench [copy|agg] [rows], .quit
  *
  * Limitations
  *  - TEXT compare only for = and != in WHERE
  *  - No JOIN/UPDATE/ORDER BY; numeric ops only for INT
  *  - Naive parser; keep queries simple (quotes for TEXT)
  *
- * Build: gcc -std=c99 -O2 -Wall -Wextra rdb.c -o rdb
+ * Build: gcc -std=c99 -O2 -Wall -Wextra -pthread rdb.c -o rdb
  */
 
 #if 0
@@ -30,12 +37,29 @@ db> SAVE mydb.bin
 db> .quit
 #endif
 
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 /* ------------------------- utils ------------------------- */
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -69,6 +93,38 @@ static char *xstrdup(const char *s)
     return p;
 }
 
+/* growable byte buffer (file images, WAL records) */
+typedef struct
+{
+    char *p;
+    size_t n, cap;
+} Buf;
+
+static void buf_put(Buf *b, const void *src, size_t n)
+{
+    if (b->n + n > b->cap)
+    {
+        b->cap = MAX(b->cap * 2, b->n + n + 256);
+        b->p = xrealloc(b->p, b->cap);
+    }
+    memcpy(b->p + b->n, src, n);
+    b->n += n;
+}
+static void buf_u8(Buf *b, uint8_t v) { buf_put(b, &v, 1); }
+static void buf_u16(Buf *b, uint16_t v) { buf_put(b, &v, 2); }
+static void buf_u32(Buf *b, uint32_t v) { buf_put(b, &v, 4); }
+static void buf_str(Buf *b, const char *s)
+{
+    buf_u16(b, (uint16_t)strlen(s));
+    buf_put(b, s, strlen(s));
+}
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
 static void trim(char *s)
 {
     size_t n = strlen(s);
@@ -95,18 +151,97 @@ typedef struct
     bool primary_key; /* only allowed on INT */
 } Column;
 
+/* On-disk placement of a column or string heap: runs of consecutive pages */
+#define RDB_PAGE 4096
+
 typedef struct
 {
-    int32_t *i; /* valid when column type is INT */
-    char **s;   /* valid when TEXT: malloced strings */
+    uint32_t first, count;
+} PageRun;
+
+typedef struct
+{
+    uint32_t npages;
+    int nruns;
+    PageRun *runs;
+} Segment;
+
+/* TEXT cells are carved out of a per-table arena and never freed one by one.
+   Low-cardinality columns are interned, so a repeated value is one copy. */
+#define ARENA_CHUNK (64 * 1024)
+
+typedef struct ArenaChunk
+{
+    struct ArenaChunk *next;
+    size_t used, cap;
+    char data[];
+} ArenaChunk;
+
+typedef struct
+{
+    ArenaChunk *head;
+    size_t bytes; /* handed out so far */
+    size_t dead;  /* of which deleted and not shared (estimate) */
+} Arena;
+
+typedef struct
+{
+    char **slot; /* open addressing on hash_str; NULL = empty */
+    uint32_t nslots;
+    uint32_t n;    /* distinct values */
+    uint32_t seen; /* values looked up */
+    bool off;      /* column turned out high-cardinality: stop interning */
+} Intern;
+
+typedef struct
+{
+    int32_t *i;     /* valid when column type is INT */
+    char **s;       /* valid when TEXT: pointers into the table arena or the mapped heap */
+    Intern dict;    /* TEXT: distinct values seen so far */
+    size_t map_len; /* >0: i points into a private file mapping of this many bytes */
+    Segment seg;    /* pages holding this column in the file we came from */
 } ColData;
 
-typedef struct IndexEntry
+typedef struct
+{
+    int32_t key; /* INT primary key */
+    int32_t row; /* row index; -1 marks an empty slot */
+} PkSlot;
+
+/* ------------------------- B+tree secondary index ------------------------- */
+/* Keys are (value, row) pairs, so duplicate values are totally ordered and every
+   entry has exactly one home leaf. Leaves are chained for range scans. DELETE
+   drops entries in place without merging nodes (separators stay valid bounds)
+   and the tree is bulk-rebuilt once it gets sparse. */
+#define BT_MAX 32
+
+typedef struct
+{
+    union
+    {
+        int32_t i;
+        const char *s; /* leaves borrow the table cell; inner nodes own a copy */
+    } v;
+    int32_t row;
+} BtKey;
+
+typedef struct BtNode
+{
+    bool leaf;
+    int n; /* keys in use */
+    BtKey key[BT_MAX];
+    struct BtNode *child[BT_MAX + 1]; /* inner nodes only */
+    struct BtNode *next;              /* leaf chain */
+} BtNode;
+
+typedef struct
 {
-    int key; /* INT primary key */
-    int row; /* row index */
-    struct IndexEntry *next;
-} IndexEntry;
+    char *name;
+    int col;
+    bool text;
+    BtNode *root;
+    int count; /* live entries */
+} Index;
 
 typedef struct
 {
@@ -117,15 +252,42 @@ typedef struct
     int cap;       /* capacity */
     ColData *data; /* array size ncols: column-major storage */
     int pk_col;    /* -1 if none; otherwise column index */
-    /* Hash index for primary key (separate chaining) */
-    int idx_buckets;
-    IndexEntry **index;
+    /* Hash index for primary key (open addressing, linear probing) */
+    int idx_slots;
+    PkSlot *index;
+    /* Secondary B+tree indexes (CREATE INDEX) */
+    int nindexes;
+    Index **indexes;
+    /* Paged storage: rows below clean_rows are unchanged since SAVE/LOAD */
+    int clean_rows;
+    Segment heap;
+    char *heap_map; /* mapped string heap (LOAD); TEXT cells may point here */
+    size_t heap_map_len;
+    bool heap_valid; /* heap_map offsets still match heap */
+    Arena arena;     /* storage of all other TEXT cells */
 } Table;
 
+typedef struct
+{
+    bool on;
+    int fd;      /* <path>.wal, -1 when closed */
+    int sync_n;  /* group commit: fdatasync after this many records ... */
+    int sync_ms; /* ... or once the oldest unsynced record is this old */
+    Buf buf;     /* records not yet written */
+    int pending;
+    double oldest;
+    long records, commits;
+} Wal;
+
 typedef struct
 {
     int ntables;
     Table **tables;
+    char *path;          /* file last loaded/saved in paged format */
+    uint64_t generation; /* header generation of that file */
+    Wal wal;
+    bool replaying; /* applying WAL records: do not log, stay quiet */
+    bool unlogged;  /* changes since the last checkpoint that the WAL lacks */
 } Database;
 
 /* ------------------------- hashing ------------------------- */
@@ -140,6 +302,375 @@ static uint32_t hash_u32(uint32_t x)
     return x;
 }
 
+static uint32_t hash_str(const char *s, size_t n)
+{
+    uint32_t h = 2166136261u; /* FNV-1a */
+    for (size_t i = 0; i < n; i++)
+        h = (h ^ (uint8_t)s[i]) * 16777619u;
+    return h;
+}
+
+/* ------------------------- B+tree ------------------------- */
+static int bt_cmp(const Index *ix, const BtKey *a, const BtKey *b)
+{
+    if (ix->text)
+    {
+        int c = strcmp(a->v.s, b->v.s);
+        if (c)
+            return c;
+    }
+    else if (a->v.i != b->v.i)
+        return a->v.i < b->v.i ? -1 : 1;
+    return (a->row > b->row) - (a->row < b->row);
+}
+
+static BtNode *bt_node_new(bool leaf)
+{
+    BtNode *nd = xmalloc(sizeof *nd);
+    nd->leaf = leaf;
+    nd->n = 0;
+    nd->next = NULL;
+    return nd;
+}
+
+static BtKey bt_key_own(const Index *ix, BtKey k)
+{
+    if (ix->text)
+        k.v.s = xstrdup(k.v.s);
+    return k;
+}
+
+static void bt_free(const Index *ix, BtNode *nd)
+{
+    if (!nd)
+        return;
+    if (!nd->leaf)
+    {
+        for (int i = 0; i <= nd->n; i++)
+            bt_free(ix, nd->child[i]);
+        if (ix->text)
+            for (int i = 0; i < nd->n; i++)
+                free((char *)nd->key[i].v.s);
+    }
+    free(nd);
+}
+
+/* inner: child to descend into (number of separators <= k) */
+static int bt_inner_pos(const Index *ix, const BtNode *nd, const BtKey *k)
+{
+    int lo = 0, hi = nd->n;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (bt_cmp(ix, &nd->key[mid], k) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* leaf: first slot with key >= k */
+static int bt_leaf_pos(const Index *ix, const BtNode *nd, const BtKey *k)
+{
+    int lo = 0, hi = nd->n;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (bt_cmp(ix, &nd->key[mid], k) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Insert k below nd. On split returns the new right sibling and stores the
+   separator (owned) in *sep. */
+static BtNode *bt_insert_rec(const Index *ix, BtNode *nd, const BtKey *k, BtKey *sep)
+{
+    if (nd->leaf)
+    {
+        BtNode *dst = nd, *right = NULL;
+        if (nd->n == BT_MAX)
+        {
+            right = bt_node_new(true);
+            int h = BT_MAX / 2;
+            right->n = BT_MAX - h;
+            memcpy(right->key, nd->key + h, sizeof(BtKey) * right->n);
+            nd->n = h;
+            right->next = nd->next;
+            nd->next = right;
+            if (bt_cmp(ix, k, &right->key[0]) >= 0)
+                dst = right;
+        }
+        int pos = bt_leaf_pos(ix, dst, k);
+        memmove(dst->key + pos + 1, dst->key + pos, sizeof(BtKey) * (dst->n - pos));
+        dst->key[pos] = *k;
+        dst->n++;
+        if (right)
+            *sep = bt_key_own(ix, right->key[0]);
+        return right;
+    }
+
+    int ci = bt_inner_pos(ix, nd, k);
+    BtKey up;
+    BtNode *split = bt_insert_rec(ix, nd->child[ci], k, &up);
+    if (!split)
+        return NULL;
+    if (nd->n < BT_MAX)
+    {
+        memmove(nd->key + ci + 1, nd->key + ci, sizeof(BtKey) * (nd->n - ci));
+        memmove(nd->child + ci + 2, nd->child + ci + 1, sizeof(BtNode *) * (nd->n - ci));
+        nd->key[ci] = up;
+        nd->child[ci + 1] = split;
+        nd->n++;
+        return NULL;
+    }
+    /* full inner node: merge into scratch, promote the middle separator */
+    BtKey keys[BT_MAX + 1];
+    BtNode *kids[BT_MAX + 2];
+    memcpy(keys, nd->key, sizeof(BtKey) * ci);
+    keys[ci] = up;
+    memcpy(keys + ci + 1, nd->key + ci, sizeof(BtKey) * (BT_MAX - ci));
+    memcpy(kids, nd->child, sizeof(BtNode *) * (ci + 1));
+    kids[ci + 1] = split;
+    memcpy(kids + ci + 2, nd->child + ci + 1, sizeof(BtNode *) * (BT_MAX - ci));
+    int h = (BT_MAX + 1) / 2;
+    BtNode *right = bt_node_new(false);
+    nd->n = h;
+    memcpy(nd->key, keys, sizeof(BtKey) * h);
+    memcpy(nd->child, kids, sizeof(BtNode *) * (h + 1));
+    *sep = keys[h];
+    right->n = BT_MAX - h;
+    memcpy(right->key, keys + h + 1, sizeof(BtKey) * right->n);
+    memcpy(right->child, kids + h + 1, sizeof(BtNode *) * (right->n + 1));
+    return right;
+}
+
+static void bt_insert(Index *ix, BtKey k)
+{
+    BtKey sep;
+    BtNode *right = bt_insert_rec(ix, ix->root, &k, &sep);
+    if (right)
+    {
+        BtNode *root = bt_node_new(false);
+        root->n = 1;
+        root->key[0] = sep;
+        root->child[0] = ix->root;
+        root->child[1] = right;
+        ix->root = root;
+    }
+    ix->count++;
+}
+
+static bool bt_sort_text; /* qsort has no context argument */
+static int bt_entry_cmp(const void *a, const void *b)
+{
+    const BtKey *x = a, *y = b;
+    if (bt_sort_text)
+    {
+        int c = strcmp(x->v.s, y->v.s);
+        if (c)
+            return c;
+    }
+    else if (x->v.i != y->v.i)
+        return x->v.i < y->v.i ? -1 : 1;
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+/* Bulk load from n entries (sorted here). Leaves are filled to 3/4 so the
+   next few inserts do not split every leaf. */
+static void bt_build(Index *ix, BtKey *e, int n)
+{
+    bt_free(ix, ix->root);
+    bt_sort_text = ix->text;
+    qsort(e, (size_t)n, sizeof(BtKey), bt_entry_cmp);
+    const int fill = BT_MAX - BT_MAX / 4;
+    int nodes = n ? (n + fill - 1) / fill : 1;
+    BtNode **level = xmalloc(sizeof(BtNode *) * nodes);
+    BtKey *low = xmalloc(sizeof(BtKey) * nodes); /* smallest key under each node */
+    BtNode *prev = NULL;
+    for (int i = 0; i < nodes; i++)
+    {
+        BtNode *lf = bt_node_new(true);
+        int off = i * fill;
+        lf->n = MIN(fill, n - off);
+        if (lf->n > 0)
+        {
+            memcpy(lf->key, e + off, sizeof(BtKey) * lf->n);
+            low[i] = e[off];
+        }
+        if (prev)
+            prev->next = lf;
+        prev = lf;
+        level[i] = lf;
+    }
+    while (nodes > 1)
+    {
+        int up = (nodes + BT_MAX) / (BT_MAX + 1);
+        int c = 0;
+        for (int i = 0; i < up; i++)
+        {
+            int take = (nodes - c) / (up - i); /* spread children evenly */
+            BtNode *nd = bt_node_new(false);
+            BtKey lo = low[c];
+            for (int j = 0; j < take; j++)
+            {
+                nd->child[j] = level[c + j];
+                if (j)
+                    nd->key[j - 1] = bt_key_own(ix, low[c + j]);
+            }
+            nd->n = take - 1;
+            level[i] = nd;
+            low[i] = lo;
+            c += take;
+        }
+        nodes = up;
+    }
+    ix->root = level[0];
+    ix->count = n;
+    free(level);
+    free(low);
+}
+
+/* Position of the first entry >= k, skipping empty leaves. */
+static BtNode *bt_seek(const Index *ix, const BtKey *k, int *pos)
+{
+    BtNode *nd = ix->root;
+    while (!nd->leaf)
+        nd = nd->child[bt_inner_pos(ix, nd, k)];
+    int p = bt_leaf_pos(ix, nd, k);
+    while (nd && p >= nd->n)
+    {
+        nd = nd->next;
+        p = 0;
+    }
+    *pos = p;
+    return nd;
+}
+
+/* Apply a DELETE compaction: remap[r] >= 0 is the new row of a kept row,
+   remap[r] = -k-1 for a deleted row that had k kept rows before it. Kept
+   rows keep their relative order, so the tree shape stays valid. */
+static void bt_remap(Index *ix, BtNode *nd, const int *remap, int *leaves)
+{
+    if (nd->leaf)
+    {
+        int j = 0;
+        for (int i = 0; i < nd->n; i++)
+        {
+            int r = remap[nd->key[i].row];
+            if (r < 0)
+                continue;
+            nd->key[j] = nd->key[i];
+            nd->key[j++].row = r;
+        }
+        ix->count -= nd->n - j;
+        nd->n = j;
+        (*leaves)++;
+        return;
+    }
+    for (int i = 0; i < nd->n; i++)
+    {
+        int r = remap[nd->key[i].row];
+        nd->key[i].row = r >= 0 ? r : -r - 1;
+    }
+    for (int i = 0; i <= nd->n; i++)
+        bt_remap(ix, nd->child[i], remap, leaves);
+}
+
+/* ------------------------- string arena ------------------------- */
+static char *arena_alloc(Arena *a, size_t n)
+{
+    if (!a->head || a->head->cap - a->head->used < n)
+    {
+        size_t cap = MAX((size_t)ARENA_CHUNK, n);
+        ArenaChunk *ch = xmalloc(sizeof *ch + cap);
+        ch->next = a->head;
+        ch->used = 0;
+        ch->cap = cap;
+        a->head = ch;
+    }
+    char *p = a->head->data + a->head->used;
+    a->head->used += n;
+    a->bytes += n;
+    return p;
+}
+
+static void arena_free(Arena *a)
+{
+    while (a->head)
+    {
+        ArenaChunk *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+    a->bytes = a->dead = 0;
+}
+
+/* Interning pays off while a column repeats itself: after a warm-up sample,
+   give up once more than a quarter of the values looked up were new. */
+#define INTERN_SAMPLE 4096
+#define INTERN_MAX (1 << 16)
+
+static void intern_free(Intern *d)
+{
+    free(d->slot);
+    memset(d, 0, sizeof *d);
+}
+
+static void intern_grow(Intern *d)
+{
+    uint32_t nslots = d->nslots ? d->nslots * 2 : 64;
+    char **slot = xmalloc(sizeof(char *) * nslots);
+    memset(slot, 0, sizeof(char *) * nslots);
+    for (uint32_t i = 0; i < d->nslots; i++)
+    {
+        char *v = d->slot[i];
+        if (!v)
+            continue;
+        uint32_t h = hash_str(v, strlen(v)) & (nslots - 1);
+        while (slot[h])
+            h = (h + 1) & (nslots - 1);
+        slot[h] = v;
+    }
+    free(d->slot);
+    d->slot = slot;
+    d->nslots = nslots;
+}
+
+/* Copy n bytes of s into column c's storage (NUL added); shares an existing copy when interned. */
+static char *table_str(Table *t, int c, const char *s, size_t n)
+{
+    Intern *d = &t->data[c].dict;
+    uint32_t h = 0;
+    if (!d->off)
+    {
+        if (d->n * 2 >= d->nslots)
+            intern_grow(d);
+        d->seen++;
+        h = hash_str(s, n) & (d->nslots - 1);
+        for (char *v; (v = d->slot[h]); h = (h + 1) & (d->nslots - 1))
+            if (memcmp(v, s, n) == 0 && v[n] == 0)
+                return v;
+    }
+    char *v = arena_alloc(&t->arena, n + 1);
+    memcpy(v, s, n);
+    v[n] = 0;
+    if (!d->off)
+    {
+        d->slot[h] = v;
+        d->n++;
+        if (d->n >= INTERN_MAX || (d->seen >= INTERN_SAMPLE && d->n * 4 > d->seen))
+        {
+            intern_free(d);
+            d->off = true;
+        }
+    }
+    return v;
+}
+
 /* ------------------------- table helpers ------------------------- */
 static Table *table_create(const char *name, int ncols)
 {
@@ -151,17 +682,26 @@ static Table *table_create(const char *name, int ncols)
     t->rows = 0;
     t->cap = 16;
     t->data = xmalloc(sizeof(ColData) * ncols);
-    for (int c = 0; c < ncols; c++)
-    {
-        t->data[c].i = NULL;
-        t->data[c].s = NULL;
-    }
+    memset(t->data, 0, sizeof(ColData) * ncols);
     t->pk_col = -1;
-    t->idx_buckets = 0;
+    t->idx_slots = 0;
     t->index = NULL;
+    t->nindexes = 0;
+    t->indexes = NULL;
+    t->clean_rows = 0;
+    memset(&t->heap, 0, sizeof t->heap);
+    t->heap_map = NULL;
+    t->heap_map_len = 0;
+    t->heap_valid = false;
+    memset(&t->arena, 0, sizeof t->arena);
     return t;
 }
 
+static bool in_heap(const Table *t, const char *s)
+{
+    return t->heap_map && s >= t->heap_map && s < t->heap_map + t->heap_map_len;
+}
+
 static void table_free(Table *t)
 {
     if (!t)
@@ -169,31 +709,34 @@ static void table_free(Table *t)
     for (int c = 0; c < t->ncols; c++)
     {
         free(t->cols[c].name);
-        if (t->cols[c].type == T_TEXT && t->data[c].s)
+        if (t->cols[c].type == T_TEXT)
         {
-            for (int r = 0; r < t->rows; r++)
-                free(t->data[c].s[r]);
             free(t->data[c].s);
+            intern_free(&t->data[c].dict);
         }
         if (t->cols[c].type == T_INT)
-            free(t->data[c].i);
+        {
+            if (t->data[c].map_len)
+                munmap(t->data[c].i, t->data[c].map_len);
+            else
+                free(t->data[c].i);
+        }
+        free(t->data[c].seg.runs);
     }
+    if (t->heap_map)
+        munmap(t->heap_map, t->heap_map_len);
+    free(t->heap.runs);
+    arena_free(&t->arena);
     free(t->cols);
-    /* free index */
-    if (t->index)
+    /* free indexes */
+    free(t->index);
+    for (int i = 0; i < t->nindexes; i++)
     {
-        for (int b = 0; b < t->idx_buckets; b++)
-        {
-            IndexEntry *e = t->index[b];
-            while (e)
-            {
-                IndexEntry *n = e->next;
-                free(e);
-                e = n;
-            }
-        }
-        free(t->index);
+        bt_free(t->indexes[i], t->indexes[i]->root);
+        free(t->indexes[i]->name);
+        free(t->indexes[i]);
     }
+    free(t->indexes);
     free(t->data);
     free(t->name);
     free(t);
@@ -206,7 +749,18 @@ static void table_prepare_storage(Table *t)
     {
         if (t->cols[c].type == T_INT)
         {
-            if (!t->data[c].i)
+            if (t->data[c].map_len)
+            {
+                /* mapped column: grow in place until the reservation runs out */
+                if (sizeof(int32_t) * t->cap <= t->data[c].map_len)
+                    continue;
+                int32_t *heap = xmalloc(sizeof(int32_t) * t->cap);
+                memcpy(heap, t->data[c].i, sizeof(int32_t) * t->rows);
+                munmap(t->data[c].i, t->data[c].map_len);
+                t->data[c].i = heap;
+                t->data[c].map_len = 0;
+            }
+            else if (!t->data[c].i)
             {
                 t->data[c].i = xmalloc(sizeof(int32_t) * t->cap);
             }
@@ -242,59 +796,134 @@ static void table_grow_if_needed(Table *t)
     table_prepare_storage(t);
 }
 
-/* Build PK hash index */
+static void pk_put(Table *t, int key, int row)
+{
+    uint32_t mask = (uint32_t)t->idx_slots - 1;
+    uint32_t h = hash_u32((uint32_t)key) & mask;
+    while (t->index[h].row >= 0)
+        h = (h + 1) & mask;
+    t->index[h].key = key;
+    t->index[h].row = row;
+}
+
+/* Build PK hash index (load factor <= 1/2) */
 static void table_build_index(Table *t)
 {
     if (t->pk_col < 0)
         return;
-    /* free old */
-    if (t->index)
+    free(t->index);
+    t->idx_slots = 1;
+    while (t->idx_slots < (t->rows * 2 + 1))
+        t->idx_slots <<= 1;
+    if (t->idx_slots < 16)
+        t->idx_slots = 16;
+    t->index = xmalloc(sizeof(PkSlot) * t->idx_slots);
+    for (int i = 0; i < t->idx_slots; i++)
+        t->index[i].row = -1;
+
+    for (int r = 0; r < t->rows; r++)
+        pk_put(t, t->data[t->pk_col].i[r], r);
+}
+
+static int table_find_pk(Table *t, int key)
+{
+    if (t->pk_col < 0)
+        return -1;
+    if (!t->index)
+        table_build_index(t); /* built on first use after LOAD */
+    uint32_t mask = (uint32_t)t->idx_slots - 1;
+    for (uint32_t h = hash_u32((uint32_t)key) & mask; t->index[h].row >= 0; h = (h + 1) & mask)
     {
-        for (int b = 0; b < t->idx_buckets; b++)
-        {
-            IndexEntry *e = t->index[b];
-            while (e)
-            {
-                IndexEntry *n = e->next;
-                free(e);
-                e = n;
-            }
-        }
-        free(t->index);
-        t->index = NULL;
+        if (t->index[h].key == key)
+            return t->index[h].row;
     }
-    t->idx_buckets = 1;
-    while (t->idx_buckets < (t->rows * 2 + 1))
-        t->idx_buckets <<= 1;
-    if (t->idx_buckets < 16)
-        t->idx_buckets = 16;
-    t->index = xmalloc(sizeof(IndexEntry *) * t->idx_buckets);
-    for (int i = 0; i < t->idx_buckets; i++)
-        t->index[i] = NULL;
+    return -1;
+}
+
+/* Secondary index helpers */
+static BtKey index_key(Table *t, const Index *ix, int row)
+{
+    BtKey k;
+    if (ix->text)
+        k.v.s = t->data[ix->col].s[row] ? t->data[ix->col].s[row] : "";
+    else
+        k.v.i = t->data[ix->col].i[row];
+    k.row = row;
+    return k;
+}
 
+static void index_rebuild(Table *t, Index *ix)
+{
+    BtKey *e = xmalloc(sizeof(BtKey) * (t->rows ? t->rows : 1));
     for (int r = 0; r < t->rows; r++)
+        e[r] = index_key(t, ix, r);
+    bt_build(ix, e, t->rows);
+    free(e);
+}
+
+/* build=false defers the bulk load until a query needs the tree (LOAD) */
+static Index *table_add_index(Table *t, const char *name, int col, bool build)
+{
+    Index *ix = xmalloc(sizeof *ix);
+    ix->name = xstrdup(name);
+    ix->col = col;
+    ix->text = (t->cols[col].type == T_TEXT);
+    ix->root = NULL;
+    ix->count = 0;
+    if (build)
+        index_rebuild(t, ix);
+    t->indexes = xrealloc(t->indexes, sizeof(Index *) * (t->nindexes + 1));
+    t->indexes[t->nindexes++] = ix;
+    return ix;
+}
+
+static Index *table_find_index(Table *t, int col)
+{
+    for (int i = 0; i < t->nindexes; i++)
+        if (t->indexes[i]->col == col)
+            return t->indexes[i];
+    return NULL;
+}
+
+/* After DELETE compaction (see bt_remap for the remap encoding) */
+static void table_remap_indexes(Table *t, const int *remap)
+{
+    for (int i = 0; i < t->nindexes; i++)
     {
-        int key = t->data[t->pk_col].i[r];
-        uint32_t h = hash_u32((uint32_t)key) & (t->idx_buckets - 1);
-        IndexEntry *e = xmalloc(sizeof *e);
-        e->key = key;
-        e->row = r;
-        e->next = t->index[h];
-        t->index[h] = e;
+        Index *ix = t->indexes[i];
+        int leaves = 0;
+        if (!ix->root)
+            continue;
+        bt_remap(ix, ix->root, remap, &leaves);
+        if (ix->count < leaves * (BT_MAX / 8))
+            index_rebuild(t, ix); /* mostly empty leaves: repack */
     }
 }
 
-static int table_find_pk(Table *t, int key)
+/* Copy live TEXT cells into a fresh arena once deletes left it mostly dead. */
+static void table_compact_text(Table *t)
 {
-    if (t->pk_col < 0 || !t->index)
-        return -1;
-    uint32_t h = hash_u32((uint32_t)key) & (t->idx_buckets - 1);
-    for (IndexEntry *e = t->index[h]; e; e = e->next)
+    Arena old = t->arena;
+    memset(&t->arena, 0, sizeof t->arena);
+    for (int c = 0; c < t->ncols; c++)
     {
-        if (e->key == key)
-            return e->row;
+        if (t->cols[c].type != T_TEXT)
+            continue;
+        bool off = t->data[c].dict.off;
+        intern_free(&t->data[c].dict);
+        t->data[c].dict.off = off;
+        for (int r = 0; r < t->rows; r++)
+        {
+            char *v = t->data[c].s[r];
+            if (v && !in_heap(t, v))
+                t->data[c].s[r] = table_str(t, c, v, strlen(v));
+        }
     }
-    return -1;
+    arena_free(&old);
+    /* leaves borrow cell pointers */
+    for (int i = 0; i < t->nindexes; i++)
+        if (t->indexes[i]->text && t->indexes[i]->root)
+            index_rebuild(t, t->indexes[i]);
 }
 
 /* ------------------------- database container ------------------------- */
@@ -303,6 +932,12 @@ static Database *db_create(void)
     Database *db = xmalloc(sizeof *db);
     db->ntables = 0;
     db->tables = NULL;
+    db->path = NULL;
+    db->generation = 0;
+    memset(&db->wal, 0, sizeof db->wal);
+    db->wal.fd = -1;
+    db->replaying = false;
+    db->unlogged = false;
     return db;
 }
 
@@ -313,6 +948,8 @@ static void db_free(Database *db)
     for (int i = 0; i < db->ntables; i++)
         table_free(db->tables[i]);
     free(db->tables);
+    free(db->path);
+    free(db->wal.buf.p);
     free(db);
 }
 
@@ -336,13 +973,14 @@ typedef enum
     TK_COMMA = ',',
     TK_STAR = '*',
     TK_EQ = '=',
-    TK_NE,
     TK_LT = '<',
-    TK_LE,
     TK_GT = '>',
-    TK_GE,
     TK_SEMI = ';',
     TK_DOT = '.',
+    /* multi-char operators and keywords live above the single-char range */
+    TK_NE = 256,
+    TK_LE,
+    TK_GE,
     TK_KW_CREATE,
     TK_KW_TABLE,
     TK_KW_INT,
@@ -358,7 +996,12 @@ typedef enum
     TK_KW_DELETE,
     TK_KW_DROP,
     TK_KW_SAVE,
-    TK_KW_LOAD
+    TK_KW_LOAD,
+    TK_KW_INDEX,
+    TK_KW_ON,
+    TK_KW_COPY,
+    TK_KW_GROUP,
+    TK_KW_BY
 } TokKind;
 
 typedef struct
@@ -410,6 +1053,11 @@ static TokKind kw_lookup(const char *id)
         {"DROP", TK_KW_DROP},
         {"SAVE", TK_KW_SAVE},
         {"LOAD", TK_KW_LOAD},
+        {"INDEX", TK_KW_INDEX},
+        {"ON", TK_KW_ON},
+        {"COPY", TK_KW_COPY},
+        {"GROUP", TK_KW_GROUP},
+        {"BY", TK_KW_BY},
     };
     for (size_t i = 0; i < sizeof(kws) / sizeof(kws[0]); i++)
         if (strcasecmp(id, kws[i].s) == 0)
@@ -486,19 +1134,21 @@ static void lex_next(Lexer *L)
         while (is_ident((unsigned char)s[p]))
             p++;
         size_t len = p - start;
-        char *id = xmalloc(len + 1);
-        memcpy(id, s + start, len);
-        id[len] = 0;
-        TokKind k = kw_lookup(id);
-        if (k == TK_IDENT)
+        /* keywords are short: only identifiers need a heap copy */
+        char kw[16];
+        TokKind k = TK_IDENT;
+        if (len < sizeof kw)
         {
-            L->cur.kind = TK_IDENT;
-            L->cur.lex = id;
+            memcpy(kw, s + start, len);
+            kw[len] = 0;
+            k = kw_lookup(kw);
         }
-        else
+        L->cur.kind = k;
+        if (k == TK_IDENT)
         {
-            L->cur.kind = k;
-            free(id);
+            L->cur.lex = xmalloc(len + 1);
+            memcpy(L->cur.lex, s + start, len);
+            L->cur.lex[len] = 0;
         }
         L->pos = p;
         return;
@@ -589,8 +1239,22 @@ typedef struct
     bool is_int;
     int ival;
     char *sval;
+    Index *ix; /* set when a secondary index can answer the predicate */
 } Where;
 
+/* access path: INT ranges and TEXT equality can go through a B+tree */
+static void where_pick_index(Table *t, Where *w)
+{
+    w->ix = NULL;
+    Index *ix = table_find_index(t, w->col);
+    if (ix && w->op != OP_NE && (ix->text ? (!w->is_int && w->op == OP_EQ) : w->is_int))
+    {
+        if (!ix->root)
+            index_rebuild(t, ix);
+        w->ix = ix;
+    }
+}
+
 static bool parse_where(Lexer *L, Table *t, Where *w)
 {
     if (!accept(L, TK_KW_WHERE))
@@ -663,9 +1327,73 @@ static bool parse_where(Lexer *L, Table *t, Where *w)
     w->is_int = is_int;
     w->ival = ival;
     w->sval = sval;
+    where_pick_index(t, w);
     return true;
 }
 
+static int cmp_int(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/* Rows matching w via w->ix, ascending (same order as a full scan).
+   Returns a malloced array; *count receives its length. */
+static int *index_scan(const Where *w, int *count)
+{
+    const Index *ix = w->ix;
+    BtKey lo, hi;
+    if (ix->text)
+        lo.v.s = hi.v.s = w->sval;
+    else
+        lo.v.i = hi.v.i = w->ival;
+    lo.row = INT32_MIN;
+    hi.row = INT32_MAX;
+
+    int pos = 0;
+    BtNode *nd;
+    switch (w->op)
+    {
+    case OP_GT:
+        nd = bt_seek(ix, &hi, &pos);
+        break;
+    case OP_LT:
+    case OP_LE:
+        lo.v.i = INT32_MIN;
+        /* fall through */
+    default:
+        nd = bt_seek(ix, &lo, &pos);
+        break;
+    }
+    int n = 0, cap = 64;
+    int *rows = xmalloc(sizeof(int) * cap);
+    for (; nd; nd = nd->next, pos = 0)
+    {
+        for (int i = pos; i < nd->n; i++)
+        {
+            const BtKey *k = &nd->key[i];
+            bool stop;
+            if (ix->text)
+                stop = strcmp(k->v.s, w->sval) != 0;
+            else if (w->op == OP_EQ || w->op == OP_LE)
+                stop = k->v.i > w->ival;
+            else if (w->op == OP_LT)
+                stop = k->v.i >= w->ival;
+            else
+                stop = false; /* > and >= run to the end */
+            if (stop)
+                goto done;
+            if (n == cap)
+                rows = xrealloc(rows, sizeof(int) * (cap *= 2));
+            rows[n++] = k->row;
+        }
+    }
+done:
+    qsort(rows, (size_t)n, sizeof(int), cmp_int);
+    *count = n;
+    return rows;
+}
+
 static bool eval_where(Table *t, const Where *w, int row)
 {
     if (w->is_int)
@@ -706,24 +1434,447 @@ static bool eval_where(Table *t, const Where *w, int row)
     return false;
 }
 
-/* CREATE TABLE name (col TYPE [PRIMARY KEY], ...) */
-static bool cmd_create(Database *db, Lexer *L)
+/* ------------------------- batch scan ------------------------- */
+/* WHERE on an INT column is evaluated SCAN_BLOCK rows at a time into a
+   selection vector (ascending row ids). The compare runs over the column
+   array with SIMD where available; the row ids are appended branch-free
+   from the lane mask. Anything else falls back to eval_where per row. */
+#define SCAN_BLOCK 1024
+
+static int scan_int_scalar(const int32_t *v, int base, int n, Op op, int32_t k, int *sel)
 {
-    if (!expect(L, TK_KW_TABLE, "TABLE"))
-        return false;
-    if (L->cur.kind != TK_IDENT)
+    int m = 0;
+#define SCAN_LOOP(cond)              \
+    for (int i = 0; i < n; i++)      \
+    {                                \
+        sel[m] = base + i;           \
+        m += (cond);                 \
+    }                                \
+    break
+    switch (op)
     {
-        fprintf(stderr, "CREATE: need table name\n");
-        return false;
+    case OP_EQ:
+        SCAN_LOOP(v[base + i] == k);
+    case OP_NE:
+        SCAN_LOOP(v[base + i] != k);
+    case OP_LT:
+        SCAN_LOOP(v[base + i] < k);
+    case OP_LE:
+        SCAN_LOOP(v[base + i] <= k);
+    case OP_GT:
+        SCAN_LOOP(v[base + i] > k);
+    case OP_GE:
+        SCAN_LOOP(v[base + i] >= k);
     }
-    char *tname = xstrdup(L->cur.lex);
-    lex_next(L);
+#undef SCAN_LOOP
+    return m;
+}
 
-    if (db_find_table(db, tname))
+static int scan_int_block(const int32_t *v, int base, int n, Op op, int32_t k, int *sel)
+{
+    int m = 0, i = 0;
+    /* LE/GE/NE are the negation of GT/LT/EQ: compute those and flip the mask */
+    bool negate = (op == OP_NE || op == OP_LE || op == OP_GE);
+#if defined(__AVX2__)
+    const __m256i kk = _mm256_set1_epi32(k);
+    for (; i + 8 <= n; i += 8)
     {
-        fprintf(stderr, "Table exists\n");
-        free(tname);
-        return false;
+        __m256i x = _mm256_loadu_si256((const __m256i *)(v + base + i));
+        __m256i c;
+        if (op == OP_EQ || op == OP_NE)
+            c = _mm256_cmpeq_epi32(x, kk);
+        else if (op == OP_GT || op == OP_LE)
+            c = _mm256_cmpgt_epi32(x, kk);
+        else
+            c = _mm256_cmpgt_epi32(kk, x);
+        unsigned bits = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(c));
+        if (negate)
+            bits ^= 0xFFu;
+        if (!bits)
+            continue; /* selective predicates: most lanes miss */
+        for (int j = 0; j < 8; j++)
+        {
+            sel[m] = base + i + j;
+            m += (bits >> j) & 1u;
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i kk = _mm_set1_epi32(k);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(v + base + i));
+        __m128i c;
+        if (op == OP_EQ || op == OP_NE)
+            c = _mm_cmpeq_epi32(x, kk);
+        else if (op == OP_GT || op == OP_LE)
+            c = _mm_cmpgt_epi32(x, kk);
+        else
+            c = _mm_cmplt_epi32(x, kk);
+        unsigned bits = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(c));
+        if (negate)
+            bits ^= 0xFu;
+        if (!bits)
+            continue; /* selective predicates: most lanes miss */
+        for (int j = 0; j < 4; j++)
+        {
+            sel[m] = base + i + j;
+            m += (bits >> j) & 1u;
+        }
+    }
+#elif defined(__ARM_NEON)
+    const int32x4_t kk = vdupq_n_s32(k);
+    const uint32x4_t lane_bit = {1, 2, 4, 8};
+    for (; i + 4 <= n; i += 4)
+    {
+        int32x4_t x = vld1q_s32(v + base + i);
+        uint32x4_t c;
+        if (op == OP_EQ || op == OP_NE)
+            c = vceqq_s32(x, kk);
+        else if (op == OP_GT || op == OP_LE)
+            c = vcgtq_s32(x, kk);
+        else
+            c = vcltq_s32(x, kk);
+        uint32x4_t b = vandq_u32(c, lane_bit);
+        unsigned bits = vgetq_lane_u32(b, 0) | vgetq_lane_u32(b, 1) |
+                        vgetq_lane_u32(b, 2) | vgetq_lane_u32(b, 3);
+        if (negate)
+            bits ^= 0xFu;
+        if (!bits)
+            continue; /* selective predicates: most lanes miss */
+        for (int j = 0; j < 4; j++)
+        {
+            sel[m] = base + i + j;
+            m += (bits >> j) & 1u;
+        }
+    }
+#endif
+    (void)negate;
+    if (i < n)
+        m += scan_int_scalar(v, base + i, n - i, op, k, sel + m);
+    return m;
+}
+
+/* Fill sel with the rows in [base, base+n) matching w (all rows if w is NULL).
+   n must not exceed SCAN_BLOCK. Returns the number of selected rows. */
+static int scan_where(Table *t, const Where *w, int base, int n, int *sel)
+{
+    int m = 0;
+    if (!w)
+    {
+        for (int i = 0; i < n; i++)
+            sel[m++] = base + i;
+        return m;
+    }
+    if (w->is_int && t->cols[w->col].type == T_INT)
+        return scan_int_block(t->data[w->col].i, base, n, w->op, w->ival, sel);
+    for (int r = base; r < base + n; r++)
+        if (eval_where(t, w, r))
+            sel[m++] = r;
+    return m;
+}
+
+/* ------------------------- write-ahead log ------------------------- */
+/* With .wal on, every INSERT/DELETE (and DDL, as statement text) is appended
+   to <file>.wal next to the paged database file:
+
+     header: magic[8]="RDBWAL01", u64 generation of the checkpoint it extends
+     record: u32 len, u32 crc32(type+payload), u8 type, payload[len-1]
+       WAL_INSERT: table, then per column i32 | u16 len + bytes
+       WAL_DELETE: table, u8 has_where [u16 col, u8 op, u8 is_int, i32 | str]
+       WAL_SQL   : statement text
+     (table = u16 len + name)
+
+   Records are buffered and made durable in groups: one write + fdatasync
+   after sync_n records, after sync_ms since the oldest unsynced record, or
+   when the REPL runs out of input. A statement is acknowledged before its
+   group is synced unless sync_n is 1. SAVE to the log's file is the
+   checkpoint and restarts the log; LOAD replays a log whose generation
+   matches the file and cuts off a torn tail. */
+enum
+{
+    WAL_INSERT = 1,
+    WAL_DELETE = 2,
+    WAL_SQL = 3
+};
+
+static uint32_t crc32_buf(uint32_t crc, const void *p, size_t n)
+{
+    static uint32_t tab[256];
+    if (!tab[1])
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            tab[i] = c;
+        }
+    const uint8_t *b = p;
+    crc = ~crc;
+    while (n--)
+        crc = tab[(crc ^ *b++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static char *wal_path(const char *db_path)
+{
+    char *p = xmalloc(strlen(db_path) + 5);
+    sprintf(p, "%s.wal", db_path);
+    return p;
+}
+
+static bool wal_commit(Database *db)
+{
+    Wal *wl = &db->wal;
+    if (!wl->pending)
+        return true;
+    bool ok = true;
+    for (size_t off = 0; off < wl->buf.n;)
+    {
+        ssize_t w = write(wl->fd, wl->buf.p + off, wl->buf.n - off);
+        if (w < 0)
+        {
+            ok = false;
+            break;
+        }
+        off += (size_t)w;
+    }
+    ok = ok && fdatasync(wl->fd) == 0;
+    wl->buf.n = 0;
+    wl->pending = 0;
+    wl->commits++;
+    if (!ok)
+    {
+        perror("WAL");
+        fprintf(stderr, "WAL disabled; SAVE to make changes durable\n");
+        close(wl->fd);
+        wl->fd = -1;
+        wl->on = false;
+    }
+    return ok;
+}
+
+static void wal_close(Database *db)
+{
+    if (db->wal.fd >= 0)
+    {
+        wal_commit(db);
+        close(db->wal.fd);
+        db->wal.fd = -1;
+    }
+}
+
+/* Start a fresh log for the checkpoint db->path / db->generation. */
+static bool wal_restart(Database *db)
+{
+    wal_close(db);
+    db->wal.buf.n = 0;
+    db->wal.pending = 0;
+    char *p = wal_path(db->path);
+    int fd = open(p, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    free(p);
+    if (fd < 0)
+    {
+        perror("WAL");
+        return false;
+    }
+    char hdr[16];
+    memcpy(hdr, "RDBWAL01", 8);
+    memcpy(hdr + 8, &db->generation, 8);
+    if (write(fd, hdr, sizeof hdr) != (ssize_t)sizeof hdr || fdatasync(fd) != 0)
+    {
+        perror("WAL");
+        close(fd);
+        return false;
+    }
+    db->wal.fd = fd;
+    return true;
+}
+
+/* Continue the existing log if it belongs to this checkpoint. */
+static bool wal_reopen(Database *db)
+{
+    wal_close(db);
+    char *p = wal_path(db->path);
+    int fd = open(p, O_WRONLY | O_APPEND);
+    free(p);
+    char hdr[16];
+    if (fd >= 0 && pread(fd, hdr, sizeof hdr, 0) == (ssize_t)sizeof hdr && memcmp(hdr, "RDBWAL01", 8) == 0 &&
+        memcmp(hdr + 8, &db->generation, 8) == 0)
+    {
+        db->wal.fd = fd;
+        return true;
+    }
+    if (fd >= 0)
+        close(fd);
+    return wal_restart(db);
+}
+
+static void wal_append(Database *db, uint8_t type, const Buf *payload)
+{
+    Wal *wl = &db->wal;
+    uint32_t len = (uint32_t)payload->n + 1;
+    uint32_t crc = crc32_buf(crc32_buf(0, &type, 1), payload->p, payload->n);
+    buf_u32(&wl->buf, len);
+    buf_u32(&wl->buf, crc);
+    buf_u8(&wl->buf, type);
+    buf_put(&wl->buf, payload->p, payload->n);
+    double now = now_sec();
+    if (!wl->pending)
+        wl->oldest = now;
+    wl->pending++;
+    wl->records++;
+    if (wl->pending >= wl->sync_n || (now - wl->oldest) * 1000.0 >= wl->sync_ms)
+        wal_commit(db);
+}
+
+/* false when the statement should not be logged; remembers unlogged changes */
+static bool wal_wanted(Database *db)
+{
+    if (db->replaying)
+        return false;
+    if (!db->wal.on || db->wal.fd < 0)
+    {
+        db->unlogged = true;
+        return false;
+    }
+    return true;
+}
+
+static void wal_log_insert(Database *db, Table *t, int r)
+{
+    if (!wal_wanted(db))
+        return;
+    Buf b = {0};
+    buf_str(&b, t->name);
+    for (int c = 0; c < t->ncols; c++)
+    {
+        if (t->cols[c].type == T_INT)
+            buf_u32(&b, (uint32_t)t->data[c].i[r]);
+        else
+            buf_str(&b, t->data[c].s[r] ? t->data[c].s[r] : "");
+    }
+    wal_append(db, WAL_INSERT, &b);
+    free(b.p);
+}
+
+static void wal_log_delete(Database *db, Table *t, const Where *w)
+{
+    if (!wal_wanted(db))
+        return;
+    Buf b = {0};
+    buf_str(&b, t->name);
+    buf_u8(&b, w != NULL);
+    if (w)
+    {
+        buf_u16(&b, (uint16_t)w->col);
+        buf_u8(&b, (uint8_t)w->op);
+        buf_u8(&b, w->is_int);
+        if (w->is_int)
+            buf_u32(&b, (uint32_t)w->ival);
+        else
+            buf_str(&b, w->sval);
+    }
+    wal_append(db, WAL_DELETE, &b);
+    free(b.p);
+}
+
+static void wal_log_sql(Database *db, const char *stmt)
+{
+    if (!wal_wanted(db))
+        return;
+    Buf b = {0};
+    buf_put(&b, stmt, strlen(stmt));
+    wal_append(db, WAL_SQL, &b);
+    free(b.p);
+}
+
+/* CREATE INDEX name ON table (col) */
+static bool cmd_create_index(Database *db, Lexer *L)
+{
+    if (L->cur.kind != TK_IDENT)
+    {
+        fprintf(stderr, "CREATE INDEX: need index name\n");
+        return false;
+    }
+    char *iname = xstrdup(L->cur.lex);
+    lex_next(L);
+    for (int i = 0; i < db->ntables; i++)
+        for (int j = 0; j < db->tables[i]->nindexes; j++)
+            if (strcasecmp(db->tables[i]->indexes[j]->name, iname) == 0)
+            {
+                fprintf(stderr, "Index exists\n");
+                free(iname);
+                return false;
+            }
+    if (!expect(L, TK_KW_ON, "ON") || L->cur.kind != TK_IDENT)
+    {
+        fprintf(stderr, "CREATE INDEX: need table name\n");
+        free(iname);
+        return false;
+    }
+    Table *t = db_find_table(db, L->cur.lex);
+    lex_next(L);
+    if (!t)
+    {
+        fprintf(stderr, "No such table\n");
+        free(iname);
+        return false;
+    }
+    if (!expect(L, TK_LP, "(") || L->cur.kind != TK_IDENT)
+    {
+        fprintf(stderr, "CREATE INDEX: need column name\n");
+        free(iname);
+        return false;
+    }
+    int col = -1;
+    for (int c = 0; c < t->ncols; c++)
+        if (strcasecmp(t->cols[c].name, L->cur.lex) == 0)
+            col = c;
+    lex_next(L);
+    if (col < 0)
+    {
+        fprintf(stderr, "CREATE INDEX: unknown column\n");
+        free(iname);
+        return false;
+    }
+    if (!expect(L, TK_RP, ")"))
+    {
+        free(iname);
+        return false;
+    }
+    if (table_find_index(t, col))
+    {
+        fprintf(stderr, "Column '%s' is already indexed\n", t->cols[col].name);
+        free(iname);
+        return false;
+    }
+    table_add_index(t, iname, col, true);
+    if (!db->replaying)
+        printf("Index '%s' created on %s(%s).\n", iname, t->name, t->cols[col].name);
+    free(iname);
+    return true;
+}
+
+/* CREATE TABLE name (col TYPE [PRIMARY KEY], ...) */
+static bool cmd_create(Database *db, Lexer *L)
+{
+    if (accept(L, TK_KW_INDEX))
+        return cmd_create_index(db, L);
+    if (!expect(L, TK_KW_TABLE, "TABLE"))
+        return false;
+    if (L->cur.kind != TK_IDENT)
+    {
+        fprintf(stderr, "CREATE: need table name\n");
+        return false;
+    }
+    char *tname = xstrdup(L->cur.lex);
+    lex_next(L);
+
+    if (db_find_table(db, tname))
+    {
+        fprintf(stderr, "Table exists\n");
+        free(tname);
+        return false;
     }
 
     if (!expect(L, TK_LP, "("))
@@ -810,12 +1961,53 @@ static bool cmd_create(Database *db, Lexer *L)
     db->tables = xrealloc(db->tables, sizeof(Table *) * (db->ntables + 1));
     db->tables[db->ntables++] = t;
 
-    printf("Table '%s' created with %d column(s)%s.\n", t->name, t->ncols,
-           t->pk_col >= 0 ? " (PRIMARY KEY indexed)" : "");
+    if (!db->replaying)
+        printf("Table '%s' created with %d column(s)%s.\n", t->name, t->ncols,
+               t->pk_col >= 0 ? " (PRIMARY KEY indexed)" : "");
     free(tname);
     return true;
 }
 
+/* Append one row; TEXT values in svals must already be in t (table_str). */
+static bool table_insert_row(Table *t, const int32_t *ivals, char *const *svals)
+{
+    /* primary key uniqueness check */
+    if (t->pk_col >= 0)
+    {
+        int key = (t->cols[t->pk_col].type == T_INT) ? ivals[t->pk_col] : 0;
+        int exists = table_find_pk(t, key);
+        if (exists >= 0)
+        {
+            fprintf(stderr, "PRIMARY KEY duplicate: %d\n", key);
+            return false;
+        }
+    }
+
+    table_grow_if_needed(t);
+    int r = t->rows;
+    for (int c = 0; c < t->ncols; c++)
+    {
+        if (t->cols[c].type == T_INT)
+            t->data[c].i[r] = ivals[c];
+        else
+            t->data[c].s[r] = svals[c];
+    }
+    t->rows++;
+
+    /* update indexes */
+    if (t->pk_col >= 0)
+    {
+        if (!t->index || t->rows * 2 > t->idx_slots)
+            table_build_index(t); /* grows the table, includes row r */
+        else
+            pk_put(t, t->data[t->pk_col].i[r], r);
+    }
+    for (int i = 0; i < t->nindexes; i++)
+        if (t->indexes[i]->root)
+            bt_insert(t->indexes[i], index_key(t, t->indexes[i], r));
+    return true;
+}
+
 /* INSERT INTO name VALUES ( ... ) */
 static bool cmd_insert(Database *db, Lexer *L)
 {
@@ -840,19 +2032,12 @@ static bool cmd_insert(Database *db, Lexer *L)
 
     int32_t ivals[128];
     char *svals[128];
-    bool is_str[128];
     if (t->ncols > 128)
     {
         fprintf(stderr, "Too many columns\n");
         return false;
     }
 
-    for (int c = 0; c < t->ncols; c++)
-    {
-        svals[c] = NULL;
-        is_str[c] = false;
-    }
-
     for (int c = 0; c < t->ncols; c++)
     {
         if (t->cols[c].type == T_INT)
@@ -860,7 +2045,7 @@ static bool cmd_insert(Database *db, Lexer *L)
             if (L->cur.kind != TK_NUMBER)
             {
                 fprintf(stderr, "INSERT: INT expected at column %d\n", c + 1);
-                goto fail;
+                return false;
             }
             ivals[c] = L->cur.number;
             lex_next(L);
@@ -870,93 +2055,675 @@ static bool cmd_insert(Database *db, Lexer *L)
             if (L->cur.kind != TK_STRING)
             {
                 fprintf(stderr, "INSERT: TEXT (quoted) expected at column %d\n", c + 1);
-                goto fail;
+                return false;
             }
-            svals[c] = xstrdup(L->cur.lex);
-            is_str[c] = true;
+            svals[c] = table_str(t, c, L->cur.lex, strlen(L->cur.lex));
             lex_next(L);
         }
         if (c < t->ncols - 1)
         {
             if (!expect(L, TK_COMMA, ","))
-                goto fail;
+                return false;
         }
     }
+    /* a rejected row leaves its few TEXT bytes behind in the arena */
     if (!expect(L, TK_RP, ")"))
-        goto fail;
+        return false;
+    if (!table_insert_row(t, ivals, svals))
+        return false;
+    wal_log_insert(db, t, t->rows - 1);
+    if (!db->replaying)
+        printf("Inserted 1 row.\n");
+    return true;
+}
 
-    /* primary key uniqueness check */
-    if (t->pk_col >= 0)
+static bool parse_i32(const char *s, size_t n, int32_t *out)
+{
+    while (n && isspace((unsigned char)*s))
+        s++, n--;
+    while (n && isspace((unsigned char)s[n - 1]))
+        n--;
+    bool neg = n && (*s == '-' || *s == '+') ? (n--, *s++ == '-') : false;
+    if (!n)
+        return false;
+    int64_t v = 0;
+    for (; n; s++, n--)
     {
-        int key = (t->cols[t->pk_col].type == T_INT) ? ivals[t->pk_col] : 0;
-        int exists = table_find_pk(t, key);
-        if (exists >= 0)
-        {
-            fprintf(stderr, "PRIMARY KEY duplicate: %d\n", key);
-            goto fail;
-        }
+        if (!isdigit((unsigned char)*s) || (v = v * 10 + (*s - '0')) > (int64_t)INT32_MAX + 1)
+            return false;
     }
+    v = neg ? -v : v;
+    if (v > INT32_MAX)
+        return false;
+    *out = (int32_t)v;
+    return true;
+}
 
-    table_grow_if_needed(t);
-    int r = t->rows;
-    for (int c = 0; c < t->ncols; c++)
+/* COPY name FROM 'file.csv': bulk append straight into the column arrays.
+   Comma separated, "..." quotes with "" for a quote, optional header line
+   naming the columns. Bad lines are reported and skipped. */
+static bool cmd_copy(Database *db, Lexer *L)
+{
+    if (L->cur.kind != TK_IDENT)
     {
-        if (t->cols[c].type == T_INT)
-            t->data[c].i[r] = ivals[c];
-        else
-            t->data[c].s[r] = svals[c], svals[c] = NULL; /* take ownership */
+        fprintf(stderr, "COPY: need table name\n");
+        return false;
     }
-    t->rows++;
-
-    /* update index if needed */
-    if (t->pk_col >= 0)
+    Table *t = db_find_table(db, L->cur.lex);
+    lex_next(L);
+    if (!t)
     {
-        if (!t->index)
-        {
-            t->idx_buckets = 0;
-            table_build_index(t);
-        }
-        int key = t->data[t->pk_col].i[r];
-        uint32_t h = hash_u32((uint32_t)key) & (t->idx_buckets - 1);
-        IndexEntry *e = xmalloc(sizeof *e);
-        e->key = key;
-        e->row = r;
-        e->next = t->index[h];
-        t->index[h] = e;
+        fprintf(stderr, "No such table\n");
+        return false;
     }
-
-    printf("Inserted 1 row.\n");
-    return true;
-
-fail:
-    for (int c = 0; c < t->ncols; c++)
-        if (is_str[c] && svals[c])
-            free(svals[c]);
-    return false;
-}
-
-/* SELECT collist FROM name [WHERE ...] */
-static bool cmd_select(Database *db, Lexer *L)
-{
-    /* parse select list (either * or a set of identifiers) */
-    int sel_all = 0;
-    char *cols[128];
-    int nsel = 0;
-    if (accept(L, TK_STAR))
+    if (!expect(L, TK_KW_FROM, "FROM"))
+        return false;
+    if (L->cur.kind != TK_IDENT && L->cur.kind != TK_STRING)
     {
-        sel_all = 1;
+        fprintf(stderr, "COPY: need filename\n");
+        return false;
     }
-    else
+    if (t->ncols > 128)
     {
-        while (1)
-        {
-            if (L->cur.kind != TK_IDENT)
+        fprintf(stderr, "Too many columns\n");
+        return false;
+    }
+    const char *path = L->cur.lex;
+    FILE *f = fopen(path, "rb");
+    struct stat st;
+    if (!f || fstat(fileno(f), &st) != 0)
+    {
+        perror("open");
+        if (f)
+            fclose(f);
+        return false;
+    }
+    size_t n = (size_t)st.st_size;
+    char *text = xmalloc(n + 1); /* quoted fields are unescaped in place */
+    n = fread(text, 1, n, f);
+    text[n] = 0;
+    fclose(f);
+
+    double t0 = now_sec();
+    /* size every column once, and leave the B+trees to a bulk rebuild */
+    size_t lines = 1;
+    for (const char *q = text; (q = memchr(q, '\n', (size_t)(text + n - q))); q++)
+        lines++;
+    if ((size_t)t->cap < (size_t)t->rows + lines && (size_t)t->rows + lines < (size_t)INT32_MAX / 2)
+    {
+        while ((size_t)t->cap < (size_t)t->rows + lines)
+            t->cap = t->cap * 2 + 8;
+        table_prepare_storage(t);
+    }
+    if (lines * 4 > (size_t)t->rows)
+        for (int i = 0; i < t->nindexes; i++)
+        {
+            bt_free(t->indexes[i], t->indexes[i]->root);
+            t->indexes[i]->root = NULL; /* rebuilt on first use, as after LOAD */
+            t->indexes[i]->count = 0;
+        }
+
+    int32_t ivals[128];
+    char *svals[128], *fs[128];
+    size_t fl[128];
+    long line = 1, copied = 0, skipped = 0;
+    char *p = text, *end = text + n;
+    while (p < end)
+    {
+        long at = line;
+        int nf = 0;
+        bool quoted = false, junk = false;
+        for (;;)
+        {
+            char *start = p, *w = p;
+            if (*p == '"')
+            {
+                quoted = true;
+                start = w = ++p;
+                while (p < end && !(*p == '"' && (p + 1 >= end || p[1] != '"')))
+                {
+                    line += *p == '\n';
+                    if (*p == '"')
+                        p++; /* "" */
+                    *w++ = *p++;
+                }
+                p += p < end;
+                while (p < end && *p != ',' && *p != '\n')
+                    junk |= *p++ != '\r';
+            }
+            else
+            {
+                while (p < end && *p != ',' && *p != '\n')
+                    p++;
+                w = p;
+                if (w > start && w[-1] == '\r')
+                    w--;
+            }
+            if (nf < 128)
+                fs[nf] = start, fl[nf] = (size_t)(w - start);
+            nf++;
+            if (p < end && *p == ',')
+            {
+                p++;
+                continue;
+            }
+            if (p < end)
+                p++, line++;
+            break;
+        }
+
+        const char *why = NULL;
+        if (nf == 1 && !fl[0] && !quoted)
+            continue; /* blank line */
+        if (at == 1 && nf == t->ncols)
+        {
+            int c = 0;
+            while (c < nf && strlen(t->cols[c].name) == fl[c] && strncasecmp(t->cols[c].name, fs[c], fl[c]) == 0)
+                c++;
+            if (c == nf)
+                continue; /* header */
+        }
+        if (junk)
+            why = "text after closing quote";
+        else if (nf != t->ncols)
+            why = "wrong number of fields";
+        for (int c = 0; !why && c < t->ncols; c++)
+            if (t->cols[c].type == T_INT && !parse_i32(fs[c], fl[c], &ivals[c]))
+                why = "INT expected";
+        if (!why && t->pk_col >= 0 && table_find_pk(t, ivals[t->pk_col]) >= 0)
+            why = "PRIMARY KEY duplicate";
+        if (!why)
+        {
+            for (int c = 0; c < t->ncols; c++)
+                if (t->cols[c].type == T_TEXT)
+                    svals[c] = table_str(t, c, fs[c], fl[c]);
+            if (table_insert_row(t, ivals, svals))
+            {
+                wal_log_insert(db, t, t->rows - 1);
+                copied++;
+                continue;
+            }
+            why = "insert failed";
+        }
+        if (++skipped <= 5)
+            fprintf(stderr, "COPY %s line %ld: %s\n", path, at, why);
+    }
+    free(text);
+    double dt = now_sec() - t0;
+    if (skipped)
+        fprintf(stderr, "COPY: %ld line(s) skipped\n", skipped);
+    if (!db->replaying)
+        printf("Copied %ld row(s) into %s in %.3f s (%.0f rows/s).\n", copied, t->name, dt,
+               dt > 0 ? copied / dt : 0.0);
+    return skipped == 0;
+}
+
+static void print_row(Table *t, const int *sel_idx, int nsel, int r)
+{
+    for (int i = 0; i < nsel; i++)
+    {
+        int c = sel_idx[i];
+        if (i)
+            printf(" | ");
+        if (t->cols[c].type == T_INT)
+            printf("%d", t->data[c].i[r]);
+        else
+            printf("%s", t->data[c].s[r] ? t->data[c].s[r] : "");
+    }
+    printf("\n");
+}
+
+/* SELECT collist FROM name [WHERE ...] */
+/* ------------------------- worker pool ------------------------- */
+/* Morsel-driven parallelism: a job is cut into nmorsels pieces that the
+   calling thread and the pool threads claim one at a time, so a slow
+   morsel never leaves the other workers idle. Workers are numbered
+   0 (the caller) .. nthreads-1 and keep their own partial state. */
+#define MORSEL_ROWS (16 * SCAN_BLOCK)
+#define POOL_MAX 64
+
+typedef void (*MorselFn)(void *arg, int worker, int morsel);
+
+typedef struct
+{
+    pthread_mutex_t mu;
+    pthread_cond_t wake, idle;
+    pthread_t th[POOL_MAX];
+    int nthreads; /* workers per job including the caller; 0 = not chosen yet */
+    int started;  /* pool threads running (ids 1..started) */
+    unsigned job; /* bumped by every pool_run */
+    MorselFn fn;
+    void *arg;
+    int nmorsels, next, busy;
+} Pool;
+
+static Pool pool = {.mu = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER, .idle = PTHREAD_COND_INITIALIZER};
+
+static int pool_threads(void)
+{
+    if (!pool.nthreads)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        pool.nthreads = (int)MAX(1, MIN(n, POOL_MAX));
+    }
+    return pool.nthreads;
+}
+
+/* Called and returns with pool.mu held. */
+static void pool_work(int worker)
+{
+    while (pool.next < pool.nmorsels)
+    {
+        int m = pool.next++;
+        pthread_mutex_unlock(&pool.mu);
+        pool.fn(pool.arg, worker, m);
+        pthread_mutex_lock(&pool.mu);
+    }
+}
+
+static void *pool_main(void *p)
+{
+    int worker = (int)(intptr_t)p;
+    unsigned seen = 0;
+    pthread_mutex_lock(&pool.mu);
+    for (;;)
+    {
+        while (pool.job == seen)
+            pthread_cond_wait(&pool.wake, &pool.mu);
+        seen = pool.job;
+        if (worker >= pool.nthreads)
+            continue; /* pool was shrunk with .threads */
+        pool.busy++;
+        pool_work(worker);
+        if (--pool.busy == 0)
+            pthread_cond_signal(&pool.idle);
+    }
+    return NULL;
+}
+
+static void pool_run(MorselFn fn, void *arg, int nmorsels)
+{
+    if (pool_threads() == 1 || nmorsels <= 1)
+    {
+        for (int m = 0; m < nmorsels; m++)
+            fn(arg, 0, m);
+        return;
+    }
+    pthread_mutex_lock(&pool.mu);
+    while (pool.started < pool.nthreads - 1)
+    {
+        if (pthread_create(&pool.th[pool.started], NULL, pool_main, (void *)(intptr_t)(pool.started + 1)) != 0)
+        {
+            fprintf(stderr, "pool: only %d thread(s) available\n", pool.started + 1);
+            pool.nthreads = pool.started + 1;
+            break;
+        }
+        pool.started++;
+    }
+    pool.fn = fn;
+    pool.arg = arg;
+    pool.nmorsels = nmorsels;
+    pool.next = 0;
+    pool.job++;
+    pthread_cond_broadcast(&pool.wake);
+    pool.busy++;
+    pool_work(0);
+    pool.busy--;
+    while (pool.busy > 0)
+        pthread_cond_wait(&pool.idle, &pool.mu);
+    pthread_mutex_unlock(&pool.mu);
+}
+
+/* ------------------------- aggregates ------------------------- */
+/* COUNT/SUM/MIN/MAX/AVG over INT columns, optionally GROUP BY one INT column.
+   Every worker folds its morsels into a private AggTab; the tables are
+   merged once all morsels are done. */
+typedef enum
+{
+    AGG_NONE, /* plain column: the GROUP BY key */
+    AGG_COUNT,
+    AGG_SUM,
+    AGG_MIN,
+    AGG_MAX,
+    AGG_AVG
+} AggFn;
+
+typedef struct
+{
+    AggFn fn;
+    int col; /* -1 for COUNT(*) */
+} AggItem;
+
+/* Per group: acc[0] = rows, acc[1 + i] = accumulator of item i. */
+typedef struct
+{
+    int stride;
+    int ngroups, cap;
+    int32_t *keys;
+    int64_t *acc;
+    int32_t *slot; /* hash of key -> group, -1 empty */
+    uint32_t nslots;
+} AggTab;
+
+typedef struct
+{
+    Table *t;
+    const Where *w;  /* NULL: every row */
+    const int *hits; /* rows to visit (index or PK lookup), or NULL: scan */
+    int nrows;       /* rows, or hits, to cover */
+    const AggItem *items;
+    int nitems;
+    int group_col; /* -1: a single group */
+    AggTab *part;  /* one per worker */
+} AggJob;
+
+static AggFn agg_lookup(const char *name)
+{
+    static const char *names[] = {"COUNT", "SUM", "MIN", "MAX", "AVG"};
+    for (int i = 0; i < 5; i++)
+        if (strcasecmp(name, names[i]) == 0)
+            return (AggFn)(AGG_COUNT + i);
+    return AGG_NONE;
+}
+
+static void agg_tab_init(AggTab *g, int nitems)
+{
+    memset(g, 0, sizeof *g);
+    g->stride = 1 + nitems;
+}
+
+static void agg_tab_free(AggTab *g)
+{
+    free(g->keys);
+    free(g->acc);
+    free(g->slot);
+}
+
+static void agg_tab_rehash(AggTab *g, uint32_t nslots)
+{
+    free(g->slot);
+    g->slot = xmalloc(sizeof(int32_t) * nslots);
+    g->nslots = nslots;
+    for (uint32_t i = 0; i < nslots; i++)
+        g->slot[i] = -1;
+    for (int k = 0; k < g->ngroups; k++)
+    {
+        uint32_t h = hash_u32((uint32_t)g->keys[k]) & (nslots - 1);
+        while (g->slot[h] >= 0)
+            h = (h + 1) & (nslots - 1);
+        g->slot[h] = k;
+    }
+}
+
+/* Accumulators of group key, created empty on first sight. */
+static int64_t *agg_group(AggTab *g, const AggItem *items, int32_t key)
+{
+    if (!g->nslots)
+        agg_tab_rehash(g, 64);
+    uint32_t mask = g->nslots - 1;
+    uint32_t h = hash_u32((uint32_t)key) & mask;
+    for (int k; (k = g->slot[h]) >= 0; h = (h + 1) & mask)
+        if (g->keys[k] == key)
+            return g->acc + (size_t)k * g->stride;
+    if (g->ngroups == g->cap)
+    {
+        g->cap = g->cap * 2 + 16;
+        g->keys = xrealloc(g->keys, sizeof(int32_t) * g->cap);
+        g->acc = xrealloc(g->acc, sizeof(int64_t) * g->cap * g->stride);
+    }
+    int k = g->ngroups++;
+    g->keys[k] = key;
+    g->slot[h] = k;
+    int64_t *a = g->acc + (size_t)k * g->stride;
+    a[0] = 0;
+    for (int i = 0; i + 1 < g->stride; i++)
+        a[1 + i] = items[i].fn == AGG_MIN ? INT64_MAX : items[i].fn == AGG_MAX ? INT64_MIN : 0;
+    if ((uint32_t)g->ngroups * 2 > g->nslots)
+    {
+        agg_tab_rehash(g, g->nslots * 2);
+        return g->acc + (size_t)k * g->stride;
+    }
+    return a;
+}
+
+/* Fold k rows (rows[], or base.. when rows is NULL) into g. */
+static void agg_block(const AggJob *j, AggTab *g, int base, const int *rows, int k)
+{
+    Table *t = j->t;
+    if (j->group_col >= 0)
+    {
+        const int32_t *gv = t->data[j->group_col].i;
+        int64_t *a = NULL;
+        int32_t last = 0;
+        for (int r = 0; r < k; r++)
+        {
+            int row = rows ? rows[r] : base + r;
+            if (!a || gv[row] != last) /* runs of one key are common */
+                a = agg_group(g, j->items, last = gv[row]);
+            a[0]++;
+            for (int i = 0; i < j->nitems; i++)
+            {
+                if (j->items[i].col < 0 || j->items[i].fn == AGG_COUNT || j->items[i].fn == AGG_NONE)
+                    continue;
+                int64_t v = t->data[j->items[i].col].i[row];
+                int64_t *x = &a[1 + i];
+                if (j->items[i].fn == AGG_MIN)
+                    *x = MIN(*x, v);
+                else if (j->items[i].fn == AGG_MAX)
+                    *x = MAX(*x, v);
+                else
+                    *x += v;
+            }
+        }
+        return;
+    }
+
+    int64_t *a = g->acc; /* the single group */
+    a[0] += k;
+    for (int i = 0; i < j->nitems; i++)
+    {
+        AggFn fn = j->items[i].fn;
+        if (j->items[i].col < 0 || fn == AGG_COUNT || fn == AGG_NONE)
+            continue;
+        const int32_t *v = t->data[j->items[i].col].i;
+        int64_t sum = 0;
+        int32_t lo = INT32_MAX, hi = INT32_MIN;
+        if (rows)
+            for (int r = 0; r < k; r++)
+            {
+                int32_t x = v[rows[r]];
+                sum += x;
+                lo = MIN(lo, x);
+                hi = MAX(hi, x);
+            }
+        else
+            for (int r = 0; r < k; r++) /* contiguous: vectorizes */
+            {
+                int32_t x = v[base + r];
+                sum += x;
+                lo = MIN(lo, x);
+                hi = MAX(hi, x);
+            }
+        if (!k)
+            continue;
+        if (fn == AGG_MIN)
+            a[1 + i] = MIN(a[1 + i], lo);
+        else if (fn == AGG_MAX)
+            a[1 + i] = MAX(a[1 + i], hi);
+        else
+            a[1 + i] += sum;
+    }
+}
+
+static void agg_morsel(void *arg, int worker, int m)
+{
+    AggJob *j = arg;
+    AggTab *g = &j->part[worker];
+    if (j->group_col < 0 && !g->nslots)
+        agg_group(g, j->items, 0);
+    int sel[SCAN_BLOCK];
+    int lo = m * MORSEL_ROWS, hi = MIN(lo + MORSEL_ROWS, j->nrows);
+    for (int base = lo; base < hi; base += SCAN_BLOCK)
+    {
+        int n = MIN(SCAN_BLOCK, hi - base);
+        if (j->hits)
+            agg_block(j, g, 0, j->hits + base, n);
+        else if (!j->w)
+            agg_block(j, g, base, NULL, n);
+        else
+            agg_block(j, g, 0, sel, scan_where(j->t, j->w, base, n, sel));
+    }
+}
+
+static void agg_merge(AggTab *dst, const AggTab *src, const AggItem *items)
+{
+    for (int k = 0; k < src->ngroups; k++)
+    {
+        const int64_t *s = src->acc + (size_t)k * src->stride;
+        int64_t *a = agg_group(dst, items, src->keys[k]);
+        a[0] += s[0];
+        for (int i = 0; i + 1 < dst->stride; i++)
+        {
+            if (items[i].fn == AGG_MIN)
+                a[1 + i] = MIN(a[1 + i], s[1 + i]);
+            else if (items[i].fn == AGG_MAX)
+                a[1 + i] = MAX(a[1 + i], s[1 + i]);
+            else
+                a[1 + i] += s[1 + i];
+        }
+    }
+}
+
+/* Evaluate the aggregates of rows matching w (NULL: all) into out. */
+static void agg_run(Table *t, const Where *w, const AggItem *items, int nitems, int group_col, AggTab *out)
+{
+    AggJob j = {.t = t, .w = w, .items = items, .nitems = nitems, .group_col = group_col};
+    int *hits = NULL, one;
+    j.nrows = t->rows;
+    if (w && t->pk_col >= 0 && w->is_int && w->col == t->pk_col && w->op == OP_EQ)
+    {
+        one = table_find_pk(t, w->ival);
+        j.hits = &one;
+        j.nrows = one >= 0;
+    }
+    else if (w && w->ix)
+    {
+        j.hits = hits = index_scan(w, &j.nrows);
+    }
+    int nw = pool_threads();
+    j.part = xmalloc(sizeof(AggTab) * nw);
+    for (int i = 0; i < nw; i++)
+        agg_tab_init(&j.part[i], nitems);
+    pool_run(agg_morsel, &j, (j.nrows + MORSEL_ROWS - 1) / MORSEL_ROWS);
+
+    agg_tab_init(out, nitems);
+    if (group_col < 0)
+        agg_group(out, items, 0); /* one row even for no input */
+    for (int i = 0; i < nw; i++)
+    {
+        agg_merge(out, &j.part[i], items);
+        agg_tab_free(&j.part[i]);
+    }
+    free(j.part);
+    free(hits);
+}
+
+static int agg_key_cmp(const void *a, const void *b)
+{
+    int32_t x = ((const int32_t *)a)[0], y = ((const int32_t *)b)[0];
+    return (x > y) - (x < y);
+}
+
+static void agg_print(Table *t, const AggTab *g, const AggItem *items, int nitems)
+{
+    for (int i = 0; i < nitems; i++)
+    {
+        static const char *fname[] = {"", "COUNT", "SUM", "MIN", "MAX", "AVG"};
+        const char *cname = items[i].col >= 0 ? t->cols[items[i].col].name : "*";
+        if (items[i].fn == AGG_NONE)
+            printf("%s%s", i ? " | " : "", cname);
+        else
+            printf("%s%s(%s)", i ? " | " : "", fname[items[i].fn], cname);
+    }
+    printf("\n");
+    /* groups in key order: (key, group) pairs */
+    int32_t *order = xmalloc(sizeof(int32_t) * 2 * (g->ngroups ? g->ngroups : 1));
+    for (int k = 0; k < g->ngroups; k++)
+        order[2 * k] = g->keys[k], order[2 * k + 1] = k;
+    qsort(order, g->ngroups, 2 * sizeof(int32_t), agg_key_cmp);
+    for (int o = 0; o < g->ngroups; o++)
+    {
+        int k = order[2 * o + 1];
+        const int64_t *a = g->acc + (size_t)k * g->stride;
+        for (int i = 0; i < nitems; i++)
+        {
+            const char *sep = i ? " | " : "";
+            int64_t x = a[1 + i];
+            if (items[i].fn == AGG_NONE)
+                printf("%s%d", sep, g->keys[k]);
+            else if (items[i].fn == AGG_COUNT)
+                printf("%s%lld", sep, (long long)a[0]);
+            else if (!a[0])
+                printf("%sNULL", sep);
+            else if (items[i].fn == AGG_AVG)
+                printf("%s%.2f", sep, (double)x / (double)a[0]);
+            else
+                printf("%s%lld", sep, (long long)x);
+        }
+        printf("\n");
+    }
+    free(order);
+}
+
+static bool cmd_select(Database *db, Lexer *L)
+{
+    /* parse select list (either * or columns and aggregates like SUM(col)) */
+    int sel_all = 0;
+    char *cols[128]; /* NULL for COUNT(*) */
+    AggItem items[128];
+    int nsel = 0, naggs = 0;
+    if (accept(L, TK_STAR))
+    {
+        sel_all = 1;
+    }
+    else
+    {
+        while (1)
+        {
+            if (L->cur.kind != TK_IDENT || nsel == 128)
             {
                 fprintf(stderr, "SELECT: need column name or *\n");
                 goto fail;
             }
-            cols[nsel++] = xstrdup(L->cur.lex);
+            cols[nsel] = xstrdup(L->cur.lex);
+            items[nsel].fn = AGG_NONE;
+            nsel++;
             lex_next(L);
+            if (accept(L, TK_LP))
+            {
+                AggFn fn = agg_lookup(cols[nsel - 1]);
+                if (!fn)
+                {
+                    fprintf(stderr, "Unknown function '%s'\n", cols[nsel - 1]);
+                    goto fail;
+                }
+                free(cols[nsel - 1]);
+                cols[nsel - 1] = NULL;
+                items[nsel - 1].fn = fn;
+                naggs++;
+                if (L->cur.kind == TK_IDENT)
+                {
+                    cols[nsel - 1] = xstrdup(L->cur.lex);
+                    lex_next(L);
+                }
+                else if (fn != AGG_COUNT || !accept(L, TK_STAR))
+                {
+                    fprintf(stderr, "SELECT: need column name in aggregate\n");
+                    goto fail;
+                }
+                if (!expect(L, TK_RP, ")"))
+                    goto fail;
+            }
             if (accept(L, TK_COMMA))
                 continue;
             break;
@@ -979,7 +2746,25 @@ static bool cmd_select(Database *db, Lexer *L)
 
     Where w;
     memset(&w, 0, sizeof w);
-    bool has_where = parse_where(L, t, &w);
+    bool has_where = (L->cur.kind == TK_KW_WHERE);
+    if (has_where && !parse_where(L, t, &w))
+        goto fail;
+
+    int group_col = -1;
+    if (accept(L, TK_KW_GROUP))
+    {
+        if (!expect(L, TK_KW_BY, "BY"))
+            goto fail_where;
+        for (int j = 0; L->cur.kind == TK_IDENT && j < t->ncols; j++)
+            if (strcasecmp(L->cur.lex, t->cols[j].name) == 0)
+                group_col = j;
+        if (group_col < 0 || t->cols[group_col].type != T_INT)
+        {
+            fprintf(stderr, "GROUP BY: need an INT column\n");
+            goto fail_where;
+        }
+        lex_next(L);
+    }
 
     /* map select cols */
     int sel_idx[128];
@@ -994,23 +2779,48 @@ static bool cmd_select(Database *db, Lexer *L)
         for (int i = 0; i < nsel; i++)
         {
             int c = -1;
-            for (int j = 0; j < t->ncols; j++)
+            for (int j = 0; cols[i] && j < t->ncols; j++)
                 if (strcasecmp(cols[i], t->cols[j].name) == 0)
                 {
                     c = j;
                     break;
                 }
-            if (c < 0)
+            if (c < 0 && cols[i])
             {
                 fprintf(stderr, "Unknown column '%s'\n", cols[i]);
-                if (has_where && w.sval)
-                    free(w.sval);
-                goto fail;
+                goto fail_where;
             }
             sel_idx[i] = c;
+            items[i].col = c;
         }
     }
 
+    if (naggs || group_col >= 0)
+    {
+        for (int i = 0; i < nsel; i++)
+        {
+            AggFn fn = items[i].fn;
+            const char *why = NULL;
+            if (sel_all || (fn == AGG_NONE && items[i].col != group_col))
+                why = "plain columns must be the GROUP BY column";
+            else if (fn != AGG_NONE && fn != AGG_COUNT && t->cols[items[i].col].type != T_INT)
+                why = "SUM/MIN/MAX/AVG need an INT column";
+            if (why)
+            {
+                fprintf(stderr, "SELECT: %s\n", why);
+                goto fail_where;
+            }
+        }
+        AggTab g;
+        agg_run(t, has_where ? &w : NULL, items, nsel, group_col, &g);
+        agg_print(t, &g, items, nsel);
+        agg_tab_free(&g);
+        free(w.sval);
+        for (int i = 0; i < nsel; i++)
+            free(cols[i]);
+        return true;
+    }
+
     /* print header */
     for (int i = 0; i < nsel; i++)
     {
@@ -1037,25 +2847,23 @@ static bool cmd_select(Database *db, Lexer *L)
         } /* nothing to print */
     }
 
-    for (int r = start_row; r < end_row; r++)
+    if (only_row < 0 && has_where && w.ix)
     {
-        if (has_where)
-        {
-            if (!eval_where(t, &w, r))
-                continue;
-        }
-        /* print row */
-        for (int i = 0; i < nsel; i++)
-        {
-            int c = sel_idx[i];
-            if (i)
-                printf(" | ");
-            if (t->cols[c].type == T_INT)
-                printf("%d", t->data[c].i[r]);
-            else
-                printf("%s", t->data[c].s[r] ? t->data[c].s[r] : "");
-        }
-        printf("\n");
+        /* secondary index range/equality scan */
+        int nhits = 0;
+        int *hits = index_scan(&w, &nhits);
+        for (int k = 0; k < nhits; k++)
+            print_row(t, sel_idx, nsel, hits[k]);
+        free(hits);
+        start_row = end_row = 0;
+    }
+
+    int sel[SCAN_BLOCK];
+    for (int base = start_row; base < end_row; base += SCAN_BLOCK)
+    {
+        int m = scan_where(t, has_where ? &w : NULL, base, MIN(SCAN_BLOCK, end_row - base), sel);
+        for (int k = 0; k < m; k++)
+            print_row(t, sel_idx, nsel, sel[k]);
     }
     if (has_where && w.sval)
         free(w.sval);
@@ -1063,12 +2871,87 @@ static bool cmd_select(Database *db, Lexer *L)
         free(cols[i]);
     return true;
 
+fail_where:
+    free(w.sval);
 fail:
     for (int i = 0; i < nsel && !sel_all; i++)
         free(cols[i]);
     return false;
 }
 
+/* Delete the rows matching w (all rows if NULL); returns how many went. */
+static int table_delete_where(Table *t, const Where *w)
+{
+    int *hits = NULL, nhits = 0, hk = 0;
+    if (w && w->ix)
+        hits = index_scan(w, &nhits);
+    int *remap = t->nindexes ? xmalloc(sizeof(int) * (t->rows ? t->rows : 1)) : NULL;
+
+    int kept = 0;
+    int sel[SCAN_BLOCK];
+    for (int base = 0; base < t->rows; base += SCAN_BLOCK)
+    {
+        int n = MIN(SCAN_BLOCK, t->rows - base);
+        int m = 0;
+        if (hits)
+            while (hk < nhits && hits[hk] < base + n)
+                sel[m++] = hits[hk++];
+        else
+            m = scan_where(t, w, base, n, sel);
+        int k = 0;
+        for (int r = base; r < base + n; r++)
+        {
+            if (k < m && sel[k] == r)
+            {
+                k++;
+                if (remap)
+                    remap[r] = -kept - 1;
+                if (r < t->clean_rows)
+                    t->clean_rows = r; /* everything from here on moves */
+                /* interned cells may be shared: only count the others as dead */
+                for (int c = 0; c < t->ncols; c++)
+                    if (t->cols[c].type == T_TEXT && t->data[c].s[r])
+                    {
+                        if (t->data[c].dict.off && !in_heap(t, t->data[c].s[r]))
+                            t->arena.dead += strlen(t->data[c].s[r]) + 1;
+                        t->data[c].s[r] = NULL;
+                    }
+                continue; /* drop row r */
+            }
+            if (kept != r)
+            {
+                /* move row r -> kept */
+                for (int c = 0; c < t->ncols; c++)
+                {
+                    if (t->cols[c].type == T_INT)
+                        t->data[c].i[kept] = t->data[c].i[r];
+                    else
+                    {
+                        t->data[c].s[kept] = t->data[c].s[r];
+                        t->data[c].s[r] = NULL;
+                    }
+                }
+            }
+            if (remap)
+                remap[r] = kept;
+            kept++;
+        }
+    }
+    int deleted = t->rows - kept;
+    t->rows = kept;
+
+    /* row ids shifted: rebuild the PK hash, remap the B+trees in place */
+    if (t->pk_col >= 0)
+        table_build_index(t);
+    if (remap)
+        table_remap_indexes(t, remap);
+    if (t->arena.dead > ARENA_CHUNK * 16 && t->arena.dead * 2 > t->arena.bytes)
+        table_compact_text(t);
+    free(remap);
+    free(hits);
+    return deleted;
+}
+
 /* DELETE FROM name [WHERE ...] */
 static bool cmd_delete(Database *db, Lexer *L)
 {
@@ -1086,203 +2969,733 @@ static bool cmd_delete(Database *db, Lexer *L)
         fprintf(stderr, "No such table\n");
         return false;
     }
-
+
+    Where w;
+    memset(&w, 0, sizeof w);
+    bool has_where = (L->cur.kind == TK_KW_WHERE);
+    if (has_where && !parse_where(L, t, &w))
+        return false;
+
+    int deleted = table_delete_where(t, has_where ? &w : NULL);
+    if (deleted)
+        wal_log_delete(db, t, has_where ? &w : NULL);
+    if (has_where && w.sval)
+        free(w.sval);
+    printf("Deleted %d row(s).\n", deleted);
+    return true;
+}
+
+/* DROP TABLE name */
+static bool cmd_drop(Database *db, Lexer *L)
+{
+    if (!expect(L, TK_KW_TABLE, "TABLE"))
+        return false;
+    if (L->cur.kind != TK_IDENT)
+    {
+        fprintf(stderr, "DROP: need table name\n");
+        return false;
+    }
+    char *name = xstrdup(L->cur.lex);
+    lex_next(L);
+    int idx = -1;
+    for (int i = 0; i < db->ntables; i++)
+        if (strcasecmp(db->tables[i]->name, name) == 0)
+        {
+            idx = i;
+            break;
+        }
+    if (idx < 0)
+    {
+        fprintf(stderr, "No such table\n");
+        free(name);
+        return false;
+    }
+    table_free(db->tables[idx]);
+    for (int i = idx + 1; i < db->ntables; i++)
+        db->tables[i - 1] = db->tables[i];
+    db->ntables--;
+    if (!db->replaying)
+        printf("Dropped table '%s'.\n", name);
+    free(name);
+    return true;
+}
+
+/* ------------------------- save/load ------------------------- */
+/* Paged format (RRRRDB03), written by SAVE. The file is an array of RDB_PAGE
+   byte pages:
+
+   page 0: header
+     magic[8]="RRRRDB03", u32 page_size, u32 npages (file length in pages),
+     u64 generation, u32 catalog_page, u32 catalog_len
+   data pages:
+     INT column : RDB_PAGE/4 x i32 per page
+     TEXT column: RDB_PAGE/4 x u32 offsets into the table's string heap
+     string heap: NUL-terminated bytes
+   catalog (contiguous pages, rewritten on every SAVE):
+     u32 ntables
+     For each table:
+       u16 name_len, bytes name, u16 ncols
+       For each column: u16 colname_len, bytes colname, u8 type, u8 primary_key,
+                        segment
+       u32 rows, heap segment
+       u16 nindexes, each: u16 name_len, bytes name, u16 column
+     segment = u32 npages, u32 nruns, nruns x (u32 first_page, u32 count)
+
+   Pages are never overwritten: SAVE back to the loaded file appends the pages
+   at or after each table's first modified row plus a new catalog, then flips
+   the header. LOAD mmaps each segment privately (INT columns are paged in on
+   first touch) and resolves TEXT cells to pointers into the mapped heap.
+   Once dead pages outnumber live ones the file is compacted by writing a
+   fresh copy and renaming it over the old one.
+
+   The older stream formats RRRRDB01/02 can still be loaded:
+   magic[8], u32 ntables, then per table: name, ncols, columns (name, u8 type,
+   u8 pk), u32 rows, per column rows x i32 or rows x [u16 len | bytes],
+   and (02) u16 nindexes + [name, u16 column].
+*/
+#define ROWS_PER_PAGE (RDB_PAGE / 4)
+
+static void buf_seg(Buf *b, const Segment *sg)
+{
+    buf_u32(b, sg->npages);
+    buf_u32(b, (uint32_t)sg->nruns);
+    for (int i = 0; i < sg->nruns; i++)
+    {
+        buf_u32(b, sg->runs[i].first);
+        buf_u32(b, sg->runs[i].count);
+    }
+}
+
+/* bounds-checked reader over the catalog */
+typedef struct
+{
+    const char *p;
+    size_t n, pos;
+    bool bad;
+} Rd;
+
+static void rd_get(Rd *r, void *dst, size_t n)
+{
+    if (r->bad || r->pos + n > r->n)
+    {
+        r->bad = true;
+        memset(dst, 0, n);
+        return;
+    }
+    memcpy(dst, r->p + r->pos, n);
+    r->pos += n;
+}
+static uint8_t rd_u8(Rd *r)
+{
+    uint8_t v;
+    rd_get(r, &v, 1);
+    return v;
+}
+static uint16_t rd_u16(Rd *r)
+{
+    uint16_t v;
+    rd_get(r, &v, 2);
+    return v;
+}
+static uint32_t rd_u32(Rd *r)
+{
+    uint32_t v;
+    rd_get(r, &v, 4);
+    return v;
+}
+static char *rd_str(Rd *r)
+{
+    uint16_t n = rd_u16(r);
+    char *s = xmalloc(n + 1u);
+    rd_get(r, s, n);
+    s[n] = 0;
+    return s;
+}
+static void rd_seg(Rd *r, Segment *sg, uint32_t file_pages)
+{
+    sg->npages = rd_u32(r);
+    sg->nruns = (int)rd_u32(r);
+    if (r->bad || sg->nruns < 0 || (size_t)sg->nruns > r->n / 8)
+    {
+        r->bad = true;
+        sg->nruns = 0;
+        sg->npages = 0;
+        return;
+    }
+    sg->runs = xmalloc(sizeof(PageRun) * (sg->nruns ? sg->nruns : 1));
+    uint32_t total = 0;
+    for (int i = 0; i < sg->nruns; i++)
+    {
+        sg->runs[i].first = rd_u32(r);
+        sg->runs[i].count = rd_u32(r);
+        if (sg->runs[i].first == 0 || sg->runs[i].first > file_pages ||
+            sg->runs[i].count > file_pages - sg->runs[i].first)
+            r->bad = true;
+        total += sg->runs[i].count;
+    }
+    if (total != sg->npages)
+        r->bad = true;
+}
+
+static void seg_truncate(Segment *sg, uint32_t npages)
+{
+    uint32_t have = 0;
+    int i = 0;
+    for (; i < sg->nruns && have < npages; i++)
+    {
+        if (have + sg->runs[i].count > npages)
+            sg->runs[i].count = npages - have;
+        have += sg->runs[i].count;
+    }
+    sg->nruns = i;
+    sg->npages = have;
+}
+
+static void seg_append(Segment *sg, uint32_t first, uint32_t count)
+{
+    if (!count)
+        return;
+    if (sg->nruns && sg->runs[sg->nruns - 1].first + sg->runs[sg->nruns - 1].count == first)
+        sg->runs[sg->nruns - 1].count += count;
+    else
+    {
+        sg->runs = xrealloc(sg->runs, sizeof(PageRun) * (sg->nruns + 1));
+        sg->runs[sg->nruns].first = first;
+        sg->runs[sg->nruns].count = count;
+        sg->nruns++;
+    }
+    sg->npages += count;
+}
+
+static bool use_mmap(void)
+{
+    long ps = sysconf(_SC_PAGESIZE);
+    return ps > 0 && RDB_PAGE % ps == 0;
+}
+
+/* Map a segment's runs back to back into one private, writable region of at
+   least want bytes. The tail past the file data is anonymous zero memory, so
+   INSERT can grow into it. Falls back to pread when the OS page size does not
+   divide RDB_PAGE. */
+static char *seg_map(int fd, const Segment *sg, size_t want, size_t *len_out)
+{
+    size_t len = MAX((size_t)sg->npages * RDB_PAGE, want);
+    len = (len + RDB_PAGE - 1) / RDB_PAGE * RDB_PAGE;
+    if (!len)
+        len = RDB_PAGE;
+    char *base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        perror("mmap");
+        exit(1);
+    }
+    bool direct = use_mmap();
+    size_t off = 0;
+    for (int i = 0; i < sg->nruns; i++)
+    {
+        size_t n = (size_t)sg->runs[i].count * RDB_PAGE;
+        off_t at = (off_t)sg->runs[i].first * RDB_PAGE;
+        if (direct)
+        {
+            if (mmap(base + off, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, at) == MAP_FAILED)
+            {
+                perror("mmap");
+                exit(1);
+            }
+        }
+        else if (pread(fd, base + off, n, at) != (ssize_t)n)
+        {
+            perror("pread");
+            exit(1);
+        }
+        off += n;
+    }
+    *len_out = len;
+    return base;
+}
+
+static bool write_all(int fd, const void *p, size_t n, off_t at)
+{
+    const char *c = p;
+    while (n)
+    {
+        ssize_t w = pwrite(fd, c, n, at);
+        if (w < 0)
+            return false;
+        c += w;
+        n -= (size_t)w;
+        at += w;
+    }
+    return true;
+}
+
+/* Append buf (padded to whole pages) at *next; returns the first page used. */
+static uint32_t put_pages(int fd, Buf *b, uint32_t *next, bool *ok)
+{
+    size_t pages = (b->n + RDB_PAGE - 1) / RDB_PAGE;
+    uint32_t first = *next;
+    if (!pages)
+        return first;
+    size_t padded = pages * RDB_PAGE;
+    if (b->cap < padded)
+    {
+        b->p = xrealloc(b->p, padded);
+        b->cap = padded;
+    }
+    memset(b->p + b->n, 0, padded - b->n);
+    b->n = padded;
+    if (!write_all(fd, b->p, b->n, (off_t)first * RDB_PAGE))
+        *ok = false;
+    *next += (uint32_t)pages;
+    return first;
+}
+
+/* Write the dirty part of every table at *next and the catalog after it. */
+static bool save_pages(Database *db, int fd, bool full, uint32_t *next, uint32_t *cat_page, uint32_t *cat_len)
+{
+    bool ok = true;
+    Buf b = {0}, heap = {0};
+    for (int ti = 0; ti < db->ntables; ti++)
+    {
+        Table *t = db->tables[ti];
+        if (full)
+        {
+            t->clean_rows = 0;
+            seg_truncate(&t->heap, 0);
+            t->heap_valid = false; /* offsets into the mapped heap no longer match the file */
+        }
+        uint32_t first_dirty = (uint32_t)(t->clean_rows / ROWS_PER_PAGE);
+        uint32_t total = (uint32_t)((t->rows + ROWS_PER_PAGE - 1) / ROWS_PER_PAGE);
+        uint32_t heap_base = t->heap.npages * RDB_PAGE;
+        heap.n = 0;
+        for (int c = 0; c < t->ncols; c++)
+        {
+            Segment *sg = &t->data[c].seg;
+            seg_truncate(sg, first_dirty);
+            b.n = 0;
+            for (int r = (int)(first_dirty * ROWS_PER_PAGE); r < t->rows; r++)
+            {
+                uint32_t v;
+                if (t->cols[c].type == T_INT)
+                    v = (uint32_t)t->data[c].i[r];
+                else
+                {
+                    const char *s = t->data[c].s[r] ? t->data[c].s[r] : "";
+                    if (t->heap_valid && in_heap(t, s))
+                        v = (uint32_t)(s - t->heap_map);
+                    else
+                    {
+                        v = heap_base + (uint32_t)heap.n;
+                        buf_put(&heap, s, strlen(s) + 1);
+                    }
+                }
+                buf_u32(&b, v);
+            }
+            uint32_t first = put_pages(fd, &b, next, &ok);
+            seg_append(sg, first, total - first_dirty);
+        }
+        if (heap.n)
+        {
+            uint32_t pages = (uint32_t)((heap.n + RDB_PAGE - 1) / RDB_PAGE);
+            seg_append(&t->heap, put_pages(fd, &heap, next, &ok), pages);
+        }
+    }
+
+    b.n = 0;
+    buf_u32(&b, (uint32_t)db->ntables);
+    for (int ti = 0; ti < db->ntables; ti++)
+    {
+        Table *t = db->tables[ti];
+        buf_str(&b, t->name);
+        buf_u16(&b, (uint16_t)t->ncols);
+        for (int c = 0; c < t->ncols; c++)
+        {
+            buf_str(&b, t->cols[c].name);
+            buf_u8(&b, (uint8_t)t->cols[c].type);
+            buf_u8(&b, (uint8_t)(t->cols[c].primary_key ? 1 : 0));
+            buf_seg(&b, &t->data[c].seg);
+        }
+        buf_u32(&b, (uint32_t)t->rows);
+        buf_seg(&b, &t->heap);
+        buf_u16(&b, (uint16_t)t->nindexes);
+        for (int i = 0; i < t->nindexes; i++)
+        {
+            buf_str(&b, t->indexes[i]->name);
+            buf_u16(&b, (uint16_t)t->indexes[i]->col);
+        }
+    }
+    *cat_len = (uint32_t)b.n;
+    *cat_page = put_pages(fd, &b, next, &ok);
+    free(b.p);
+    free(heap.p);
+    return ok;
+}
+
+typedef struct
+{
+    char magic[8];
+    uint32_t page_size;
+    uint32_t npages;
+    uint64_t generation;
+    uint32_t catalog_page;
+    uint32_t catalog_len;
+} FileHeader;
+
+static bool read_header(int fd, FileHeader *h)
+{
+    return pread(fd, h, sizeof *h, 0) == (ssize_t)sizeof *h && memcmp(h->magic, "RRRRDB03", 8) == 0 &&
+           h->page_size == RDB_PAGE;
+}
+
+static bool write_header(int fd, uint32_t npages, uint64_t gen, uint32_t cat_page, uint32_t cat_len)
+{
+    char page[RDB_PAGE] = {0};
+    FileHeader h = {.page_size = RDB_PAGE, .npages = npages, .generation = gen,
+                    .catalog_page = cat_page, .catalog_len = cat_len};
+    memcpy(h.magic, "RRRRDB03", 8);
+    memcpy(page, &h, sizeof h);
+    return write_all(fd, page, sizeof page, 0);
+}
+
+static uint32_t live_pages(Database *db)
+{
+    uint32_t n = 1;
+    for (int ti = 0; ti < db->ntables; ti++)
+    {
+        Table *t = db->tables[ti];
+        n += t->heap.npages;
+        for (int c = 0; c < t->ncols; c++)
+            n += t->data[c].seg.npages;
+    }
+    return n;
+}
+
+static bool cmd_save(Database *db, Lexer *L)
+{
+    if (L->cur.kind != TK_IDENT && L->cur.kind != TK_STRING)
+    {
+        fprintf(stderr, "SAVE: need filename\n");
+        return false;
+    }
+    const char *path = (L->cur.kind == TK_STRING) ? L->cur.lex : L->cur.lex; /* use as-is */
+
+    /* incremental only into the file we last loaded/saved, while it is ours */
+    bool incremental = false;
+    int fd = -1;
+    FileHeader h;
+    if (db->path && strcmp(db->path, path) == 0)
+    {
+        fd = open(path, O_RDWR);
+        incremental = fd >= 0 && read_header(fd, &h) && h.generation == db->generation &&
+                      h.npages <= 2 * live_pages(db) + 64;
+        if (!incremental && fd >= 0)
+            close(fd);
+    }
+
+    char *tmp = NULL;
+    uint32_t next = 1;
+    if (incremental)
+        next = h.npages;
+    else
+    {
+        /* never rewrite a file in place: mapped pages of it may still be live */
+        tmp = xmalloc(strlen(path) + 5);
+        sprintf(tmp, "%s.tmp", path);
+        fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            perror("open");
+            free(tmp);
+            return false;
+        }
+    }
+
+    uint32_t cat_page = 0, cat_len = 0, first_new = next;
+    bool ok = save_pages(db, fd, !incremental, &next, &cat_page, &cat_len);
+    ok = ok && fdatasync(fd) == 0;
+    ok = ok && write_header(fd, next, db->generation + 1, cat_page, cat_len) && fdatasync(fd) == 0;
+    close(fd);
+    if (ok && tmp)
+        ok = rename(tmp, path) == 0;
+    if (!ok)
+    {
+        perror("SAVE");
+        if (tmp)
+            unlink(tmp);
+        free(tmp);
+        /* on-disk layout is unknown now: next SAVE writes a fresh file */
+        free(db->path);
+        db->path = NULL;
+        return false;
+    }
+    free(tmp);
+    db->generation++;
+    if (!db->path || strcmp(db->path, path) != 0)
+    {
+        free(db->path);
+        db->path = xstrdup(path);
+    }
+    for (int ti = 0; ti < db->ntables; ti++)
+        db->tables[ti]->clean_rows = db->tables[ti]->rows;
+    /* checkpoint: the log restarts empty */
+    db->unlogged = false;
+    if (db->wal.on && !wal_restart(db))
+        db->wal.on = false;
+    if (!db->wal.on)
+    {
+        /* a leftover log could carry this generation number too */
+        char *wp = wal_path(path);
+        unlink(wp);
+        free(wp);
+    }
+    printf("Saved to %s (%u page(s) written%s)\n", path, next - first_new + 1, incremental ? ", incremental" : "");
+    return true;
+}
+
+static void db_clear(Database *db)
+{
+    wal_close(db);
+    for (int i = 0; i < db->ntables; i++)
+        table_free(db->tables[i]);
+    free(db->tables);
+    db->tables = NULL;
+    db->ntables = 0;
+    free(db->path);
+    db->path = NULL;
+}
+
+static bool run_stmt(Database *db, const char *line);
+
+/* WAL_INSERT / WAL_DELETE payload -> table change; false if malformed */
+static bool wal_apply(Database *db, uint8_t type, const char *p, size_t n)
+{
+    Rd r = {.p = p, .n = n};
+    if (type == WAL_SQL)
+    {
+        char *stmt = xmalloc(n + 1);
+        memcpy(stmt, p, n);
+        stmt[n] = 0;
+        run_stmt(db, stmt);
+        free(stmt);
+        return true;
+    }
+    char *tname = rd_str(&r);
+    Table *t = db_find_table(db, tname);
+    free(tname);
+    if (!t)
+        return false;
+    if (type == WAL_INSERT)
+    {
+        int32_t ivals[128];
+        char *svals[128] = {0};
+        if (t->ncols > 128)
+            return false;
+        for (int c = 0; c < t->ncols; c++)
+        {
+            if (t->cols[c].type == T_INT)
+                ivals[c] = (int32_t)rd_u32(&r);
+            else
+                svals[c] = rd_str(&r);
+        }
+        for (int c = 0; c < t->ncols; c++)
+            if (svals[c])
+            {
+                char *v = svals[c];
+                svals[c] = table_str(t, c, v, strlen(v));
+                free(v);
+            }
+        return !r.bad && table_insert_row(t, ivals, svals);
+    }
+    if (type != WAL_DELETE)
+        return false;
     Where w;
     memset(&w, 0, sizeof w);
-    bool has_where = parse_where(L, t, &w);
-
-    int kept = 0;
-    for (int r = 0; r < t->rows; r++)
+    bool has_where = rd_u8(&r) != 0;
+    if (has_where)
     {
-        bool match = has_where ? eval_where(t, &w, r) : true;
-        if (match)
-        {
-            /* free TEXT cells */
-            for (int c = 0; c < t->ncols; c++)
-                if (t->cols[c].type == T_TEXT && t->data[c].s[r])
-                {
-                    free(t->data[c].s[r]);
-                    t->data[c].s[r] = NULL;
-                }
-            continue; /* drop row r */
-        }
+        w.col = rd_u16(&r);
+        w.op = (Op)rd_u8(&r);
+        w.is_int = rd_u8(&r) != 0;
+        if (w.is_int)
+            w.ival = (int32_t)rd_u32(&r);
         else
+            w.sval = rd_str(&r);
+        if (r.bad || w.col >= t->ncols || w.op > OP_GE)
         {
-            if (kept != r)
-            {
-                /* move row r -> kept */
-                for (int c = 0; c < t->ncols; c++)
-                {
-                    if (t->cols[c].type == T_INT)
-                        t->data[c].i[kept] = t->data[c].i[r];
-                    else
-                    {
-                        t->data[c].s[kept] = t->data[c].s[r];
-                        t->data[c].s[r] = NULL;
-                    }
-                }
-            }
-            kept++;
+            free(w.sval);
+            return false;
         }
+        where_pick_index(t, &w);
     }
-    int deleted = t->rows - kept;
-    t->rows = kept;
-
-    /* rebuild index if present */
-    if (t->pk_col >= 0)
-        table_build_index(t);
-
-    if (has_where && w.sval)
-        free(w.sval);
-    printf("Deleted %d row(s).\n", deleted);
-    return true;
+    if (!r.bad)
+        table_delete_where(t, has_where ? &w : NULL);
+    free(w.sval);
+    return !r.bad;
 }
 
-/* DROP TABLE name */
-static bool cmd_drop(Database *db, Lexer *L)
+/* After LOAD of db->path: apply <path>.wal if it extends this checkpoint. */
+static void wal_replay(Database *db)
 {
-    if (!expect(L, TK_KW_TABLE, "TABLE"))
-        return false;
-    if (L->cur.kind != TK_IDENT)
+    char *path = wal_path(db->path);
+    int fd = open(path, O_RDWR);
+    free(path);
+    if (fd < 0)
+        return;
+    struct stat st;
+    char *log = NULL;
+    size_t n = 0;
+    if (fstat(fd, &st) == 0 && st.st_size >= 16)
     {
-        fprintf(stderr, "DROP: need table name\n");
-        return false;
+        n = (size_t)st.st_size;
+        log = xmalloc(n);
+        if (pread(fd, log, n, 0) != (ssize_t)n)
+            n = 0;
     }
-    char *name = xstrdup(L->cur.lex);
-    lex_next(L);
-    int idx = -1;
-    for (int i = 0; i < db->ntables; i++)
-        if (strcasecmp(db->tables[i]->name, name) == 0)
-        {
-            idx = i;
+    if (n < 16 || memcmp(log, "RDBWAL01", 8) != 0 || memcmp(log + 8, &db->generation, 8) != 0)
+    {
+        free(log); /* no log, or one that predates the checkpoint */
+        close(fd);
+        return;
+    }
+    size_t pos = 16;
+    long applied = 0, failed = 0;
+    db->replaying = true;
+    while (pos + 9 <= n)
+    {
+        uint32_t len, crc;
+        memcpy(&len, log + pos, 4);
+        memcpy(&crc, log + pos + 4, 4);
+        if (len == 0 || len > n - pos - 8 || crc32_buf(0, log + pos + 8, len) != crc)
             break;
-        }
-    if (idx < 0)
+        if (wal_apply(db, (uint8_t)log[pos + 8], log + pos + 9, len - 1))
+            applied++;
+        else
+            failed++;
+        pos += 8 + (size_t)len;
+    }
+    db->replaying = false;
+    if (pos < n)
     {
-        fprintf(stderr, "No such table\n");
-        free(name);
-        return false;
+        /* torn tail from a crash mid-write: cut it so appends stay readable */
+        if (ftruncate(fd, (off_t)pos) != 0)
+            perror("WAL");
+        fprintf(stderr, "WAL: dropped %zu byte(s) of incomplete records\n", n - pos);
     }
-    table_free(db->tables[idx]);
-    for (int i = idx + 1; i < db->ntables; i++)
-        db->tables[i - 1] = db->tables[i];
-    db->ntables--;
-    printf("Dropped table '%s'.\n", name);
-    free(name);
-    return true;
+    free(log);
+    close(fd);
+    printf("Replayed %ld WAL record(s)%s\n", applied, failed ? " (some failed)" : "");
 }
 
-/* ------------------------- save/load ------------------------- */
-/* Binary format (little-endian-ish):
-   magic[8]="RRRRDB01"
-   u32 ntables
-   For each table:
-     u16 name_len, bytes name
-     u16 ncols
-     For each column:
-       u16 colname_len, bytes colname
-       u8  type (1=int,2=text)
-       u8  primary_key (0/1)
-     u32 rows
-     For each column, type==INT: rows * i32
-                    type==TEXT: rows * [u16 len | bytes]
-*/
-static bool cmd_save(Database *db, Lexer *L)
+static bool load_paged(Database *db, const char *path, int fd)
 {
-    if (L->cur.kind != TK_IDENT && L->cur.kind != TK_STRING)
+    FileHeader h;
+    struct stat st;
+    if (!read_header(fd, &h) || fstat(fd, &st) != 0 || (uint64_t)st.st_size < (uint64_t)h.npages * RDB_PAGE ||
+        h.catalog_page == 0 || h.catalog_page >= h.npages ||
+        h.catalog_len > (uint64_t)(h.npages - h.catalog_page) * RDB_PAGE)
     {
-        fprintf(stderr, "SAVE: need filename\n");
+        fprintf(stderr, "Bad file\n");
         return false;
     }
-    const char *path = (L->cur.kind == TK_STRING) ? L->cur.lex : L->cur.lex; /* use as-is */
-    FILE *f = fopen(path, "wb");
-    if (!f)
+    char *cat = xmalloc(h.catalog_len ? h.catalog_len : 1);
+    if (pread(fd, cat, h.catalog_len, (off_t)h.catalog_page * RDB_PAGE) != (ssize_t)h.catalog_len)
     {
-        perror("open");
+        perror("read");
+        free(cat);
         return false;
     }
-    fwrite("RRRRDB01", 1, 8, f);
-    uint32_t nt = (uint32_t)db->ntables;
-    fwrite(&nt, 4, 1, f);
-    for (int ti = 0; ti < db->ntables; ti++)
+    db_clear(db);
+
+    Rd r = {.p = cat, .n = h.catalog_len};
+    uint32_t nt = rd_u32(&r);
+    for (uint32_t ti = 0; ti < nt && !r.bad; ti++)
     {
-        Table *t = db->tables[ti];
-        uint16_t nlen = (uint16_t)strlen(t->name);
-        fwrite(&nlen, 2, 1, f);
-        fwrite(t->name, 1, nlen, f);
-        uint16_t nc = (uint16_t)t->ncols;
-        fwrite(&nc, 2, 1, f);
-        for (int c = 0; c < t->ncols; c++)
+        char *tname = rd_str(&r);
+        uint16_t nc = rd_u16(&r);
+        Table *t = table_create(tname, nc);
+        free(tname);
+        for (int c = 0; c < nc; c++)
         {
-            uint16_t clen = (uint16_t)strlen(t->cols[c].name);
-            fwrite(&clen, 2, 1, f);
-            fwrite(t->cols[c].name, 1, clen, f);
-            uint8_t ty = (uint8_t)t->cols[c].type;
-            fwrite(&ty, 1, 1, f);
-            uint8_t pk = (uint8_t)(t->cols[c].primary_key ? 1 : 0);
-            fwrite(&pk, 1, 1, f);
+            t->cols[c].name = rd_str(&r);
+            t->cols[c].type = rd_u8(&r) == T_TEXT ? T_TEXT : T_INT;
+            t->cols[c].primary_key = rd_u8(&r) != 0;
+            if (t->cols[c].primary_key)
+                t->pk_col = c;
+            rd_seg(&r, &t->data[c].seg, h.npages);
         }
-        uint32_t rows = (uint32_t)t->rows;
-        fwrite(&rows, 4, 1, f);
-        for (int c = 0; c < t->ncols; c++)
+        uint32_t rows = rd_u32(&r);
+        rd_seg(&r, &t->heap, h.npages);
+        for (int c = 0; c < nc && !r.bad; c++)
+            if ((uint64_t)t->data[c].seg.npages * ROWS_PER_PAGE < rows)
+                r.bad = true;
+        if (r.bad || rows > INT32_MAX / 2)
+        {
+            r.bad = true;
+            table_free(t);
+            break;
+        }
+
+        /* leave headroom so INSERT does not have to leave the mapping at once */
+        t->cap = (int)MAX(rows * 2u, 1024u);
+        t->heap_map = seg_map(fd, &t->heap, 0, &t->heap_map_len);
+        t->heap_valid = true;
+        for (int c = 0; c < nc; c++)
         {
+            ColData *d = &t->data[c];
             if (t->cols[c].type == T_INT)
             {
-                for (int r = 0; r < t->rows; r++)
-                {
-                    int32_t v = t->data[c].i[r];
-                    fwrite(&v, 4, 1, f);
-                }
+                d->i = (int32_t *)seg_map(fd, &d->seg, sizeof(int32_t) * (size_t)t->cap, &d->map_len);
+                continue;
             }
-            else
+            size_t olen;
+            uint32_t *off = (uint32_t *)seg_map(fd, &d->seg, 0, &olen);
+            d->s = xmalloc(sizeof(char *) * t->cap);
+            for (uint32_t i = 0; i < rows; i++)
             {
-                for (int r = 0; r < t->rows; r++)
-                {
-                    const char *s = t->data[c].s[r] ? t->data[c].s[r] : "";
-                    size_t len = strlen(s);
-                    if (len > 65535)
-                        len = 65535;
-                    uint16_t L16 = (uint16_t)len;
-                    fwrite(&L16, 2, 1, f);
-                    fwrite(s, 1, len, f);
-                }
+                /* offsets are trusted only if they stay inside the heap */
+                d->s[i] = off[i] < t->heap_map_len ? t->heap_map + off[i] : NULL;
+                if (d->s[i] && !memchr(d->s[i], 0, t->heap_map_len - off[i]))
+                    d->s[i] = NULL;
             }
+            for (int i = (int)rows; i < t->cap; i++)
+                d->s[i] = NULL;
+            munmap(off, olen);
         }
-    }
-    fclose(f);
-    printf("Saved to %s\n", path);
-    return true;
-}
+        t->rows = (int)rows;
+        t->clean_rows = t->rows;
 
-static bool cmd_load(Database *db, Lexer *L)
-{
-    if (L->cur.kind != TK_IDENT && L->cur.kind != TK_STRING)
-    {
-        fprintf(stderr, "LOAD: need filename\n");
-        return false;
-    }
-    const char *path = (L->cur.kind == TK_STRING) ? L->cur.lex : L->cur.lex;
-    FILE *f = fopen(path, "rb");
-    if (!f)
-    {
-        perror("open");
-        return false;
+        uint16_t ni = rd_u16(&r);
+        for (int i = 0; i < ni && !r.bad; i++)
+        {
+            char *iname = rd_str(&r);
+            uint16_t ic = rd_u16(&r);
+            if (ic < t->ncols)
+                table_add_index(t, iname, ic, false);
+            free(iname);
+        }
+        db->tables = xrealloc(db->tables, sizeof(Table *) * (db->ntables + 1));
+        db->tables[db->ntables++] = t;
     }
-    char magic[9] = {0};
-    fread(magic, 1, 8, f);
-    if (strcmp(magic, "RRRRDB01") != 0)
+    free(cat);
+    if (r.bad)
     {
-        fprintf(stderr, "Bad file\n");
-        fclose(f);
+        fprintf(stderr, "Bad file (catalog)\n");
+        db_clear(db);
         return false;
     }
-    /* clear existing db */
-    for (int i = 0; i < db->ntables; i++)
-        table_free(db->tables[i]);
-    free(db->tables);
-    db->tables = NULL;
-    db->ntables = 0;
+    db->path = xstrdup(path);
+    db->generation = h.generation;
+    printf("Loaded %u table(s) from %s\n", nt, path);
+    wal_replay(db);
+    db->unlogged = false;
+    if (db->wal.on && !wal_reopen(db))
+        db->wal.on = false;
+    return true;
+}
 
+static bool load_stream(Database *db, const char *path, FILE *f, int version)
+{
+    db_clear(db);
     uint32_t nt = 0;
     fread(&nt, 4, 1, f);
     for (uint32_t ti = 0; ti < nt; ti++)
@@ -1312,11 +3725,12 @@ static bool cmd_load(Database *db, Lexer *L)
             if (pk)
                 t->pk_col = c;
         }
-        table_prepare_storage(t);
         uint32_t rows;
         fread(&rows, 4, 1, f);
+        while ((uint32_t)t->cap < rows)
+            t->cap = t->cap * 2 + 8;
+        table_prepare_storage(t);
         t->rows = rows;
-        table_grow_if_needed(t); /* ensure cap >= rows */
         for (int c = 0; c < t->ncols; c++)
         {
             if (t->cols[c].type == T_INT)
@@ -1330,14 +3744,13 @@ static bool cmd_load(Database *db, Lexer *L)
             }
             else
             {
+                char s[65536];
                 for (uint32_t r = 0; r < rows; r++)
                 {
-                    uint16_t L16;
+                    uint16_t L16 = 0;
                     fread(&L16, 2, 1, f);
-                    char *s = xmalloc(L16 + 1);
-                    fread(s, 1, L16, f);
-                    s[L16] = 0;
-                    t->data[c].s[r] = s;
+                    size_t got = fread(s, 1, L16, f);
+                    t->data[c].s[r] = table_str(t, c, s, got);
                 }
             }
         }
@@ -1345,12 +3758,58 @@ static bool cmd_load(Database *db, Lexer *L)
         db->tables[db->ntables++] = t;
         if (t->pk_col >= 0)
             table_build_index(t);
+        uint16_t ni = 0;
+        if (version >= 2)
+            fread(&ni, 2, 1, f);
+        for (int i = 0; i < ni; i++)
+        {
+            uint16_t ilen, ic;
+            fread(&ilen, 2, 1, f);
+            char *iname = xmalloc(ilen + 1);
+            fread(iname, 1, ilen, f);
+            iname[ilen] = 0;
+            fread(&ic, 2, 1, f);
+            if (ic < t->ncols)
+                table_add_index(t, iname, ic, false);
+            free(iname);
+        }
     }
-    fclose(f);
     printf("Loaded %u table(s) from %s\n", nt, path);
     return true;
 }
 
+static bool cmd_load(Database *db, Lexer *L)
+{
+    if (L->cur.kind != TK_IDENT && L->cur.kind != TK_STRING)
+    {
+        fprintf(stderr, "LOAD: need filename\n");
+        return false;
+    }
+    const char *path = (L->cur.kind == TK_STRING) ? L->cur.lex : L->cur.lex;
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        perror("open");
+        return false;
+    }
+    char magic[9] = {0};
+    fread(magic, 1, 8, f);
+    bool ok;
+    if (strcmp(magic, "RRRRDB03") == 0)
+        ok = load_paged(db, path, fileno(f));
+    else if (strcmp(magic, "RRRRDB01") == 0)
+        ok = load_stream(db, path, f, 1);
+    else if (strcmp(magic, "RRRRDB02") == 0)
+        ok = load_stream(db, path, f, 2);
+    else
+    {
+        fprintf(stderr, "Bad file\n");
+        ok = false;
+    }
+    fclose(f);
+    return ok;
+}
+
 /* ------------------------- meta commands ------------------------- */
 static void cmd_tables(Database *db)
 {
@@ -1381,6 +3840,8 @@ static void cmd_schema(Database *db, const char *opt)
                    t->cols[c].primary_key ? " PRIMARY" : "", t->cols[c].primary_key ? " KEY" : "");
         }
         printf(");\n");
+        for (int i = 0; i < t->nindexes; i++)
+            printf("INDEX %s ON %s(%s)\n", t->indexes[i]->name, t->name, t->cols[t->indexes[i]->col].name);
     }
     else
     {
@@ -1400,6 +3861,267 @@ static void cmd_schema(Database *db, const char *opt)
     }
 }
 
+/* .bench [rows]: per-row eval_where vs. block scan on a synthetic INT column */
+static void cmd_bench(int rows)
+{
+    if (rows <= 0)
+        rows = 4000000;
+    Table *t = table_create("bench", 1);
+    t->cols[0].name = xstrdup("v");
+    t->cols[0].type = T_INT;
+    t->cap = rows;
+    table_prepare_storage(t);
+    uint32_t x = 2463534242u; /* xorshift32, fixed seed for repeatable runs */
+    for (int r = 0; r < rows; r++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        t->data[0].i[r] = (int32_t)(x % 1000000u);
+    }
+    t->rows = rows;
+
+    static const struct
+    {
+        Op op;
+        int k;
+        const char *txt;
+    } cases[] = {
+        {OP_EQ, 500000, "v = 500000"},
+        {OP_LT, 10000, "v < 10000"},
+        {OP_GE, 500000, "v >= 500000"},
+        {OP_NE, 1, "v != 1"},
+    };
+    int sel[SCAN_BLOCK];
+    printf("%d rows, best of 5\n", rows);
+    printf("%-12s %10s %12s %12s %8s\n", "predicate", "matches", "row ns/row", "block ns/row", "speedup");
+    for (size_t ci = 0; ci < sizeof cases / sizeof cases[0]; ci++)
+    {
+        Where w = {.col = 0, .op = cases[ci].op, .is_int = true, .ival = cases[ci].k, .sval = NULL};
+        double best_row = 1e30, best_blk = 1e30;
+        long n_row = 0, n_blk = 0;
+        for (int rep = 0; rep < 5; rep++)
+        {
+            double t0 = now_sec();
+            n_row = 0;
+            for (int r = 0; r < t->rows; r++)
+                n_row += eval_where(t, &w, r);
+            double t1 = now_sec();
+            n_blk = 0;
+            for (int base = 0; base < t->rows; base += SCAN_BLOCK)
+                n_blk += scan_where(t, &w, base, MIN(SCAN_BLOCK, t->rows - base), sel);
+            double t2 = now_sec();
+            best_row = MIN(best_row, t1 - t0);
+            best_blk = MIN(best_blk, t2 - t1);
+        }
+        if (n_row != n_blk)
+            fprintf(stderr, "bench: mismatch for %s (%ld vs %ld)\n", cases[ci].txt, n_row, n_blk);
+        printf("%-12s %10ld %12.3f %12.3f %7.2fx\n", cases[ci].txt, n_blk,
+               best_row * 1e9 / rows, best_blk * 1e9 / rows, best_row / (best_blk > 0 ? best_blk : 1e-12));
+    }
+    table_free(t);
+}
+
+/* .bench copy [rows]: the same rows through INSERT statements and through COPY */
+static void cmd_bench_copy(int rows)
+{
+    if (rows <= 0)
+        rows = 1000000;
+    char path[64], line[256];
+    snprintf(path, sizeof path, "/tmp/rdb-bench-%ld.csv", (long)getpid());
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        perror("bench");
+        return;
+    }
+    char **stmts = xmalloc(sizeof(char *) * rows);
+    uint32_t x = 2463534242u;
+    for (int r = 0; r < rows; r++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        /* telemetry-like: a few hundred hosts, one free-form field */
+        int host = (int)(x % 300u), v = (int)(x >> 12) % 100000;
+        fprintf(f, "%d,host-%03d,%d,msg %u\n", r, host, v, x);
+        snprintf(line, sizeof line, "INSERT INTO b VALUES (%d, \"host-%03d\", %d, \"msg %u\")", r, host, v, x);
+        stmts[r] = xstrdup(line);
+    }
+    fclose(f);
+
+    Database *db = db_create();
+    db->replaying = true; /* quiet */
+    run_stmt(db, "CREATE TABLE b (id INT PRIMARY KEY, host TEXT, v INT, note TEXT)");
+    run_stmt(db, "CREATE TABLE c (id INT PRIMARY KEY, host TEXT, v INT, note TEXT)");
+    double t0 = now_sec();
+    for (int r = 0; r < rows; r++)
+        run_stmt(db, stmts[r]);
+    double t1 = now_sec();
+    snprintf(line, sizeof line, "COPY c FROM '%s'", path);
+    run_stmt(db, line);
+    double t2 = now_sec();
+
+    Table *b = db_find_table(db, "b"), *c = db_find_table(db, "c");
+    if (b->rows != rows || c->rows != rows)
+        fprintf(stderr, "bench: row count mismatch (%d / %d)\n", b->rows, c->rows);
+    printf("%d rows (INT pk, TEXT host x300, INT, TEXT unique)\n", rows);
+    printf("%-8s %10s %14s\n", "path", "seconds", "rows/s");
+    printf("%-8s %10.3f %14.0f\n", "INSERT", t1 - t0, rows / MAX(t1 - t0, 1e-9));
+    printf("%-8s %10.3f %14.0f  (%.1fx)\n", "COPY", t2 - t1, rows / MAX(t2 - t1, 1e-9),
+           (t1 - t0) / MAX(t2 - t1, 1e-9));
+    printf("TEXT arena: %.1f MB for %d cells; host column interned to %u value(s)\n",
+           c->arena.bytes / 1048576.0, 2 * rows, c->data[1].dict.n);
+    for (int r = 0; r < rows; r++)
+        free(stmts[r]);
+    free(stmts);
+    db_free(db);
+    unlink(path);
+}
+
+/* .bench agg [rows]: aggregate queries at 1, 2, 4, ... worker threads */
+static void cmd_bench_agg(int rows)
+{
+    if (rows <= 0)
+        rows = 8000000;
+    Table *t = table_create("bench", 3);
+    static const char *names[] = {"g", "v", "w"};
+    for (int c = 0; c < 3; c++)
+    {
+        t->cols[c].name = xstrdup(names[c]);
+        t->cols[c].type = T_INT;
+    }
+    t->cap = rows;
+    table_prepare_storage(t);
+    uint32_t x = 2463534242u;
+    for (int r = 0; r < rows; r++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        t->data[0].i[r] = (int32_t)(x % 1000u);
+        t->data[1].i[r] = (int32_t)(x >> 8) % 100000;
+        t->data[2].i[r] = (int32_t)(x >> 4) % 1000000;
+    }
+    t->rows = rows;
+
+    static const struct
+    {
+        AggItem items[4];
+        int nitems, group_col;
+        bool where;
+        const char *txt;
+    } cases[] = {
+        {{{AGG_COUNT, -1}, {AGG_SUM, 1}, {AGG_MIN, 2}, {AGG_MAX, 2}}, 4, -1, false, "COUNT/SUM/MIN/MAX"},
+        {{{AGG_SUM, 1}, {AGG_AVG, 2}}, 2, -1, true, "... WHERE w < 100000"},
+        {{{AGG_NONE, 0}, {AGG_COUNT, -1}, {AGG_AVG, 1}}, 3, 0, false, "GROUP BY g (1000)"},
+    };
+    Where w = {.col = 2, .op = OP_LT, .is_int = true, .ival = 100000};
+    int saved = pool_threads(), maxw = MAX(saved, 1);
+    printf("%d rows, best of 3; up to %d thread(s)\n", rows, maxw);
+    printf("%-22s %8s %10s %8s\n", "query", "threads", "ms", "speedup");
+    for (size_t ci = 0; ci < sizeof cases / sizeof cases[0]; ci++)
+    {
+        double base = 0;
+        int64_t check = 0;
+        for (int nt = 1;; nt = MIN(nt * 2, maxw))
+        {
+            pool.nthreads = nt;
+            double best = 1e30;
+            for (int rep = 0; rep < 3; rep++)
+            {
+                AggTab g;
+                double t0 = now_sec();
+                agg_run(t, cases[ci].where ? &w : NULL, cases[ci].items, cases[ci].nitems, cases[ci].group_col, &g);
+                best = MIN(best, now_sec() - t0);
+                int64_t sum = 0;
+                for (int k = 0; k < g.ngroups * g.stride; k++)
+                    sum += g.acc[k];
+                if (nt == 1 && rep == 0)
+                    check = sum;
+                else if (sum != check)
+                    fprintf(stderr, "bench: result mismatch at %d thread(s)\n", nt);
+                agg_tab_free(&g);
+            }
+            if (nt == 1)
+                base = best;
+            printf("%-22s %8d %10.2f %7.2fx\n", nt == 1 ? cases[ci].txt : "", nt, best * 1e3, base / MAX(best, 1e-12));
+            if (nt == maxw)
+                break;
+        }
+    }
+    pool.nthreads = saved;
+    table_free(t);
+}
+
+/* .threads [N]: workers used by aggregate queries */
+static void cmd_threads(Lexer *L)
+{
+    if (L->cur.kind == TK_NUMBER)
+    {
+        if (L->cur.number < 1 || L->cur.number > POOL_MAX)
+        {
+            fprintf(stderr, ".threads: 1..%d\n", POOL_MAX);
+            return;
+        }
+        pool.nthreads = L->cur.number;
+    }
+    printf("%d worker thread(s)\n", pool_threads());
+}
+
+/* .wal [on | off | N [MS]]: N records / MS milliseconds per group commit */
+static void cmd_wal(Database *db, Lexer *L)
+{
+    Wal *wl = &db->wal;
+    if (L->cur.kind == TK_IDENT && strcasecmp(L->cur.lex, "off") == 0)
+    {
+        wal_close(db);
+        wl->on = false;
+        puts("WAL off.");
+        return;
+    }
+    if (L->cur.kind == TK_NUMBER || (L->cur.kind == TK_IDENT && strcasecmp(L->cur.lex, "on") == 0))
+    {
+        int n = 64, ms = 10;
+        if (L->cur.kind == TK_NUMBER)
+        {
+            n = L->cur.number;
+            lex_next(L);
+            if (L->cur.kind == TK_NUMBER)
+                ms = L->cur.number;
+        }
+        if (n < 1 || ms < 0)
+        {
+            fprintf(stderr, ".wal: need N >= 1 and MS >= 0\n");
+            return;
+        }
+        if (!wl->on)
+        {
+            if (!db->path)
+            {
+                fprintf(stderr, ".wal: SAVE or LOAD a database file first\n");
+                return;
+            }
+            if (db->unlogged)
+            {
+                fprintf(stderr, ".wal: unsaved changes would be missing from the log; SAVE first\n");
+                return;
+            }
+            if (!wal_reopen(db))
+                return;
+            wl->on = true;
+        }
+        wal_commit(db);
+        wl->sync_n = n;
+        wl->sync_ms = ms;
+    }
+    if (wl->on)
+        printf("WAL on: %s.wal, sync every %d record(s) or %d ms; %ld record(s) in %ld commit(s)\n", db->path,
+               wl->sync_n, wl->sync_ms, wl->records, wl->commits);
+    else
+        puts("WAL off.");
+}
+
 /* ------------------------- top-level parser ------------------------- */
 static bool run_stmt(Database *db, const char *line)
 {
@@ -1427,30 +4149,70 @@ static bool run_stmt(Database *db, const char *line)
             cmd_schema(db, buf[0] ? buf : NULL);
             return true;
         }
+        if (L.cur.kind == TK_IDENT && strcasecmp(L.cur.lex, "bench") == 0)
+        {
+            lex_next(&L);
+            if (L.cur.kind == TK_KW_COPY)
+            {
+                lex_next(&L);
+                cmd_bench_copy(L.cur.kind == TK_NUMBER ? L.cur.number : 0);
+                return true;
+            }
+            if (L.cur.kind == TK_IDENT && strcasecmp(L.cur.lex, "agg") == 0)
+            {
+                lex_next(&L);
+                cmd_bench_agg(L.cur.kind == TK_NUMBER ? L.cur.number : 0);
+                return true;
+            }
+            cmd_bench(L.cur.kind == TK_NUMBER ? L.cur.number : 0);
+            return true;
+        }
+        if (L.cur.kind == TK_IDENT && strcasecmp(L.cur.lex, "threads") == 0)
+        {
+            lex_next(&L);
+            cmd_threads(&L);
+            return true;
+        }
+        if (L.cur.kind == TK_IDENT && strcasecmp(L.cur.lex, "wal") == 0)
+        {
+            lex_next(&L);
+            cmd_wal(db, &L);
+            return true;
+        }
         if (L.cur.kind == TK_IDENT && (strcasecmp(L.cur.lex, "quit") == 0 || strcasecmp(L.cur.lex, "exit") == 0))
         {
+            wal_close(db);
             exit(0);
         }
         fprintf(stderr, "Unknown dot-command\n");
         return false;
     }
 
+    bool ok;
     switch (L.cur.kind)
     {
     case TK_KW_CREATE:
         lex_next(&L);
-        return cmd_create(db, &L);
+        if ((ok = cmd_create(db, &L)))
+            wal_log_sql(db, line);
+        return ok;
     case TK_KW_INSERT:
         lex_next(&L);
         return cmd_insert(db, &L);
+    case TK_KW_COPY:
+        lex_next(&L);
+        return cmd_copy(db, &L);
     case TK_KW_SELECT:
+        lex_next(&L);
         return cmd_select(db, &L);
     case TK_KW_DELETE:
         lex_next(&L);
         return cmd_delete(db, &L);
     case TK_KW_DROP:
         lex_next(&L);
-        return cmd_drop(db, &L);
+        if ((ok = cmd_drop(db, &L)))
+            wal_log_sql(db, line);
+        return ok;
     case TK_KW_SAVE:
         lex_next(&L);
         return cmd_save(db, &L);
@@ -1476,12 +4238,19 @@ int main(void)
     puts("  CREATE TABLE people (id INT PRIMARY KEY, name TEXT, age INT)");
     puts("  INSERT INTO people VALUES (1, \"Alice\", 30)");
     puts("  SELECT * FROM people WHERE id = 1");
+    puts("  SELECT age, COUNT(*) FROM people GROUP BY age");
+    puts("  CREATE INDEX people_age ON people (age)");
+    puts("  COPY people FROM 'people.csv'");
     puts("  SAVE mydb.bin   |  LOAD mydb.bin");
-    puts("Meta: .tables, .schema [table], .quit");
+    puts("Meta: .tables, .schema [table], .wal [on|off|N [MS]], .threads [N],\n      .bench [copy|agg] [rows], .quit");
     while (1)
     {
         fputs("db> ", stdout);
         fflush(stdout);
+        /* group commit: no more input queued, so sync what we have */
+        struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+        if (db->wal.pending && poll(&pfd, 1, 0) == 0)
+            wal_commit(db);
         if (!fgets(line, sizeof line, stdin))
             break;
         trim(line);
@@ -1489,6 +4258,7 @@ int main(void)
             continue;
         run_stmt(db, line);
     }
+    wal_close(db);
     db_free(db);
     return 0;
 }
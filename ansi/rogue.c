@@ -1,8 +1,9 @@
 /* rogue.c
  * A tiny Rogue-style, single-file C game for terminal (Linux/macOS/Windows).
  * - Random rooms + corridors
- * - FOV & map memory
- * - Monsters with simple chase AI
+ * - FOV (recursive shadowcasting) & map memory
+ * - Monsters chase along a shared per-turn distance map
+ * - Redraws only the screen cells that changed
  * - Items: potions(!) heal, rations(%) feed
  * - Stairs(>) to descend; Amulet(*) on final floor
  *
@@ -13,6 +14,9 @@
  * Controls:
  *   Arrows / WASD / HJKL (+ diagonals Y U B N), '>' to descend, 'Q' to quit
  *
+ * Headless soak/benchmark (no terminal I/O):
+ *   ./rogue --bench [turns] [WxH] [monsters]     (default 20000 400x200 2000)
+ *
  * Notes:
  * - Uses ANSI escapes; on modern Windows 10+ consoles this works. We enable it via
  *   SetConsoleMode if available; otherwise most newer terminals handle it fine.
@@ -245,7 +249,13 @@ typedef struct
     bool vis;  /* currently visible */
 } Tile;
 
-static Tile mapc[MAP_H - 1][MAP_W]; /* last line reserved for status */
+/* The map is map_w x map_h (MAP_W x MAP_H-1 when playing; --bench picks
+   its own size); the status line goes below it. */
+static int map_w = MAP_W, map_h = MAP_H - 1;
+static Tile *mapc;
+#define TILE(x, y) mapc[(size_t)(y) * map_w + (x)]
+static int *mob_grid;  /* per cell: index of the mob there + 1, or 0 */
+static int *item_grid; /* same for items */
 
 typedef struct
 {
@@ -293,48 +303,78 @@ typedef struct
 } Item;
 
 static Player pl;
-static Mob mobs[MAX_MOBS];
-static Item items[MAX_ITEMS];
+static Mob *mobs;
+static Item *items;
+static int max_mobs = MAX_MOBS, max_items = MAX_ITEMS, max_rooms = MAX_ROOMS;
+static int mobs_per_floor = 0; /* 0: 6..12 */
 static int stairs_x = 0, stairs_y = 0;
 
+#define FOV_CELLS ((2 * VIEW_R + 1) * (2 * VIEW_R + 1))
+static int vis_cells[FOV_CELLS]; /* lit by the last compute_fov() */
+static int nvis = 0;
+
+/* The screen can only change where the FOV was or is: cells lit and
+   unlit since the last render(), or everything after a new floor */
+static int redraw_cells[4 * FOV_CELLS];
+static int nredraw = 0;
+static bool redraw_all = true;
+
 /* ---------- Utils ---------- */
 static bool in_bounds(int x, int y)
 {
-    return x >= 0 && x < MAP_W && y >= 0 && y < (MAP_H - 1);
+    return x >= 0 && x < map_w && y >= 0 && y < map_h;
 }
 static bool is_blocking(int x, int y)
 {
     if (!in_bounds(x, y))
         return true;
-    TileType t = mapc[y][x].t;
+    TileType t = TILE(x, y).t;
     return (t == T_WALL);
 }
 static bool is_opaque(int x, int y)
 {
     if (!in_bounds(x, y))
         return true;
-    return mapc[y][x].t == T_WALL;
+    return TILE(x, y).t == T_WALL;
 }
 static void place_player_in_rect(Rect r)
 {
     pl.x = r.x + r.w / 2;
     pl.y = r.y + r.h / 2;
 }
+static void *xcalloc(size_t n, size_t sz)
+{
+    void *p = calloc(n, sz);
+    if (!p)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return p;
+}
 
 /* ---------- Rooms & dungeon gen ---------- */
-static Rect rooms[MAX_ROOMS];
+static Rect *rooms;
 static int nrooms = 0;
+static bool *room_cell; /* inside some room's rect (overlap test) */
 
-static bool rect_overlap(Rect a, Rect b)
+static bool rect_free(Rect r)
 {
-    return !(a.x + a.w <= b.x || b.x + b.w <= a.x || a.y + a.h <= b.y || b.y + b.h <= a.y);
+    for (int y = r.y; y < r.y + r.h; ++y)
+        for (int x = r.x; x < r.x + r.w; ++x)
+            if (room_cell[(size_t)y * map_w + x])
+                return false;
+    return true;
 }
 static void carve_rect(Rect r)
 {
     for (int y = r.y; y < r.y + r.h; ++y)
         for (int x = r.x; x < r.x + r.w; ++x)
             if (in_bounds(x, y))
-                mapc[y][x].t = T_FLOOR;
+            {
+                TILE(x, y).t = T_FLOOR;
+                room_cell[(size_t)y * map_w + x] = true;
+            }
 }
 static void carve_h_tunnel(int x1, int x2, int y)
 {
@@ -346,7 +386,7 @@ static void carve_h_tunnel(int x1, int x2, int y)
     }
     for (int x = x1; x <= x2; ++x)
         if (in_bounds(x, y))
-            mapc[y][x].t = T_FLOOR;
+            TILE(x, y).t = T_FLOOR;
 }
 static void carve_v_tunnel(int y1, int y2, int x)
 {
@@ -358,37 +398,35 @@ static void carve_v_tunnel(int y1, int y2, int x)
     }
     for (int y = y1; y <= y2; ++y)
         if (in_bounds(x, y))
-            mapc[y][x].t = T_FLOOR;
+            TILE(x, y).t = T_FLOOR;
 }
 
 static void clear_mobs_items(void)
 {
-    for (int i = 0; i < MAX_MOBS; i++)
+    for (int i = 0; i < max_mobs; i++)
         mobs[i].alive = false;
-    for (int i = 0; i < MAX_ITEMS; i++)
+    for (int i = 0; i < max_items; i++)
         items[i].alive = false;
+    memset(mob_grid, 0, sizeof(int) * (size_t)map_w * map_h);
+    memset(item_grid, 0, sizeof(int) * (size_t)map_w * map_h);
 }
 static bool mob_at(int x, int y, int *idx)
 {
-    for (int i = 0; i < MAX_MOBS; i++)
-        if (mobs[i].alive && mobs[i].x == x && mobs[i].y == y)
-        {
-            if (idx)
-                *idx = i;
-            return true;
-        }
-    return false;
+    if (!in_bounds(x, y))
+        return false;
+    int m = mob_grid[(size_t)y * map_w + x];
+    if (m && idx)
+        *idx = m - 1;
+    return m != 0;
 }
 static bool item_at(int x, int y, int *idx)
 {
-    for (int i = 0; i < MAX_ITEMS; i++)
-        if (items[i].alive && items[i].x == x && items[i].y == y)
-        {
-            if (idx)
-                *idx = i;
-            return true;
-        }
-    return false;
+    if (!in_bounds(x, y))
+        return false;
+    int m = item_grid[(size_t)y * map_w + x];
+    if (m && idx)
+        *idx = m - 1;
+    return m != 0;
 }
 static bool is_walkable_free(int x, int y)
 {
@@ -401,7 +439,7 @@ static bool is_walkable_free(int x, int y)
 
 static void add_mob(MobType t, int x, int y)
 {
-    for (int i = 0; i < MAX_MOBS; i++)
+    for (int i = 0; i < max_mobs; i++)
         if (!mobs[i].alive)
         {
             mobs[i].alive = true;
@@ -422,12 +460,20 @@ static void add_mob(MobType t, int x, int y)
                 mobs[i].ch = 'o';
                 mobs[i].name = "orc";
             }
+            mob_grid[(size_t)y * map_w + x] = i + 1;
             return;
         }
 }
+static void move_mob(int i, int x, int y)
+{
+    mob_grid[(size_t)mobs[i].y * map_w + mobs[i].x] = 0;
+    mob_grid[(size_t)y * map_w + x] = i + 1;
+    mobs[i].x = x;
+    mobs[i].y = y;
+}
 static void add_item(ItemType t, int x, int y)
 {
-    for (int i = 0; i < MAX_ITEMS; i++)
+    for (int i = 0; i < max_items; i++)
         if (!items[i].alive)
         {
             items[i].alive = true;
@@ -445,6 +491,7 @@ static void add_item(ItemType t, int x, int y)
                 items[i].ch = '%';
                 items[i].name = "ration";
             }
+            item_grid[(size_t)y * map_w + x] = i + 1;
             return;
         }
 }
@@ -452,34 +499,28 @@ static void add_item(ItemType t, int x, int y)
 static void gen_floor(int floor)
 {
     /* walls everywhere */
-    for (int y = 0; y < MAP_H - 1; y++)
+    for (int y = 0; y < map_h; y++)
     {
-        for (int x = 0; x < MAP_W; x++)
+        for (int x = 0; x < map_w; x++)
         {
-            mapc[y][x].t = T_WALL;
-            mapc[y][x].seen = mapc[y][x].vis = false;
+            TILE(x, y).t = T_WALL;
+            TILE(x, y).seen = TILE(x, y).vis = false;
         }
     }
+    nvis = 0;
+    redraw_all = true;
+    memset(room_cell, 0, sizeof(bool) * (size_t)map_w * map_h);
     nrooms = 0;
     int attempts = 0;
-    while (nrooms < MAX_ROOMS && attempts < 2000)
+    while (nrooms < max_rooms && attempts < 2000 * (max_rooms / MAX_ROOMS))
     {
         attempts++;
         Rect r;
         r.w = irand(4, 12);
         r.h = irand(3, 7);
-        r.x = irand(1, MAP_W - r.w - 2);
-        r.y = irand(1, (MAP_H - 2) - r.h - 1);
-        bool ok = true;
-        for (int i = 0; i < nrooms; i++)
-        {
-            if (rect_overlap(r, rooms[i]))
-            {
-                ok = false;
-                break;
-            }
-        }
-        if (!ok)
+        r.x = irand(1, map_w - r.w - 2);
+        r.y = irand(1, map_h - r.h - 2);
+        if (!rect_free(r))
             continue;
         carve_rect(r);
         if (nrooms > 0)
@@ -507,7 +548,7 @@ static void gen_floor(int floor)
     Rect last = rooms[nrooms - 1];
     stairs_x = last.x + last.w / 2;
     stairs_y = last.y + last.h / 2;
-    mapc[stairs_y][stairs_x].t = (floor < FLOORS ? T_STAIR : T_FLOOR);
+    TILE(stairs_x, stairs_y).t = (floor < FLOORS ? T_STAIR : T_FLOOR);
 
     /* place amulet on final floor */
     if (floor == FLOORS)
@@ -516,184 +557,176 @@ static void gen_floor(int floor)
         Rect r = rooms[irand(0, nrooms - 1)];
         int ax = r.x + irand(1, r.w - 2);
         int ay = r.y + irand(1, r.h - 2);
-        mapc[ay][ax].t = T_AMULET;
+        TILE(ax, ay).t = T_AMULET;
     }
 
     /* place player in first room for new floor */
     place_player_in_rect(rooms[0]);
 
-    /* monsters & items */
+    /* monsters & items; a crowded floor just gets fewer */
     clear_mobs_items();
-    int nm = irand(6, 12);
-    for (int i = 0; i < nm; i++)
+    int nm = mobs_per_floor ? mobs_per_floor : irand(6, 12);
+    for (int i = 0, tries = 0; i < nm && tries < nm * 50; tries++)
     {
         Rect r = rooms[irand(0, nrooms - 1)];
         int x = r.x + irand(1, r.w - 2);
         int y = r.y + irand(1, r.h - 2);
         if ((x == pl.x && y == pl.y) || (x == stairs_x && y == stairs_y))
-        {
-            i--;
             continue;
-        }
         if (mob_at(x, y, NULL))
-        {
-            i--;
             continue;
-        }
         add_mob((rand() % 3) ? MOB_GOBLIN : MOB_ORC, x, y);
+        i++;
     }
-    int ni = irand(4, 8);
-    for (int i = 0; i < ni; i++)
+    int ni = irand(4, 8) * (max_rooms / MAX_ROOMS);
+    for (int i = 0, tries = 0; i < ni && tries < ni * 50; tries++)
     {
         Rect r = rooms[irand(0, nrooms - 1)];
         int x = r.x + irand(1, r.w - 2);
         int y = r.y + irand(1, r.h - 2);
-        if ((x == pl.x && y == pl.y) || mob_at(x, y, NULL))
-        {
-            i--;
+        if ((x == pl.x && y == pl.y) || mob_at(x, y, NULL) || item_at(x, y, NULL))
             continue;
-        }
         add_item((rand() % 2) ? IT_POTION : IT_RATION, x, y);
+        i++;
     }
 }
 
-/* ---------- FOV (simple ray casting) ---------- */
-static void set_visibility(bool v)
+/* ---------- FOV (recursive shadowcasting) ---------- */
+static void mark_redraw(int c)
 {
-    for (int y = 0; y < MAP_H - 1; y++)
-        for (int x = 0; x < MAP_W; x++)
-            mapc[y][x].vis = v;
+    if (nredraw < (int)(sizeof redraw_cells / sizeof redraw_cells[0]))
+        redraw_cells[nredraw++] = c;
+    else
+        redraw_all = true;
 }
 
-/* Bresenham line; returns whether fully visible to end */
-static bool los(int x0, int y0, int x1, int y1)
+static void light(int x, int y)
 {
-    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
-    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
-    int err = dx + dy, e2;
-    int x = x0, y = y0;
-    while (1)
+    Tile *t = &TILE(x, y);
+    if (!t->vis)
     {
-        if (x == x1 && y == y1)
-            return true;
-        if (!(x == x0 && y == y0) && is_opaque(x, y))
-            return false;
-        e2 = 2 * err;
-        if (e2 >= dy)
-        {
-            err += dy;
-            x += sx;
-        }
-        if (e2 <= dx)
-        {
-            err += dx;
-            y += sy;
-        }
+        t->vis = t->seen = true;
+        vis_cells[nvis++] = y * map_w + x;
+        mark_redraw(y * map_w + x);
     }
 }
 
-static void compute_fov(void)
+/* One octant: rows `row`..VIEW_R away from (cx,cy), between slopes start
+   and end; (xx,xy,yx,yy) maps octant coordinates onto the map. A wall
+   narrows the rest of the row and recurses for the part it shadows. */
+static void cast_light(int cx, int cy, int row, double start, double end,
+                       int xx, int xy, int yx, int yy)
 {
-    set_visibility(false);
-    for (int y = pl.y - VIEW_R; y <= pl.y + VIEW_R; ++y)
+    if (start < end)
+        return;
+    double new_start = 0;
+    for (int j = row; j <= VIEW_R; j++)
     {
-        for (int x = pl.x - VIEW_R; x <= pl.x + VIEW_R; ++x)
+        bool blocked = false;
+        for (int dx = -j, dy = -j; dx <= 0; dx++)
         {
-            if (!in_bounds(x, y))
+            int x = cx + dx * xx + dy * xy;
+            int y = cy + dx * yx + dy * yy;
+            double l_slope = (dx - 0.5) / (dy + 0.5);
+            double r_slope = (dx + 0.5) / (dy - 0.5);
+            if (start < r_slope)
                 continue;
-            int dx = x - pl.x, dy = y - pl.y;
-            if (dx * dx + dy * dy <= VIEW_R * VIEW_R)
+            if (end > l_slope)
+                break;
+            if (dx * dx + dy * dy <= VIEW_R * VIEW_R && in_bounds(x, y))
+                light(x, y);
+            bool opaque = is_opaque(x, y);
+            if (blocked)
             {
-                if (los(pl.x, pl.y, x, y))
+                if (opaque)
                 {
-                    mapc[y][x].vis = true;
-                    mapc[y][x].seen = true;
+                    new_start = r_slope;
+                    continue;
                 }
+                blocked = false;
+                start = new_start;
+            }
+            else if (opaque && j < VIEW_R)
+            {
+                blocked = true;
+                cast_light(cx, cy, j + 1, start, l_slope, xx, xy, yx, yy);
+                new_start = r_slope;
             }
         }
+        if (blocked)
+            break;
+    }
+}
+
+static void compute_fov(void)
+{
+    static const int mult[4][8] = {{1, 0, 0, -1, -1, 0, 0, 1},
+                                   {0, 1, -1, 0, 0, -1, 1, 0},
+                                   {0, 1, 1, 0, 0, -1, -1, 0},
+                                   {1, 0, 0, 1, -1, 0, 0, -1}};
+    for (int i = 0; i < nvis; i++)
+    {
+        mapc[vis_cells[i]].vis = false;
+        mark_redraw(vis_cells[i]);
     }
+    nvis = 0;
+    light(pl.x, pl.y);
+    for (int o = 0; o < 8; o++)
+        cast_light(pl.x, pl.y, 1, 1.0, 0.0, mult[0][o], mult[1][o], mult[2][o], mult[3][o]);
 }
 
 /* ---------- Rendering ---------- */
-static void draw_map(void)
+/* Each frame (map rows plus the status line) is composed into `frame` and
+   compared with `shown`, what the terminal already holds; only changed
+   cells are written, with a cursor move where a run of changes breaks.
+   Between floors only the cells on the redraw list are recomposed. */
+typedef struct
 {
-    for (int y = 0; y < MAP_H - 1; y++)
+    char *b;
+    size_t len, cap;
+} OutBuf;
+
+static OutBuf out;
+static char *frame, *shown; /* (map_h + 1) rows of map_w */
+
+static void out_write(const char *s, size_t n)
+{
+    if (out.len + n > out.cap)
     {
-        term_move(y + 1, 1);
-        for (int x = 0; x < MAP_W; x++)
+        out.cap = (out.len + n) * 2;
+        out.b = realloc(out.b, out.cap);
+        if (!out.b)
         {
-            char ch = ' ';
-            Tile *t = &mapc[y][x];
-            if (!t->seen)
-            {
-                ch = ' ';
-            }
-            else
-            {
-                if (t->vis)
-                {
-                    switch (t->t)
-                    {
-                    case T_WALL:
-                        ch = '#';
-                        break;
-                    case T_FLOOR:
-                        ch = '.';
-                        break;
-                    case T_STAIR:
-                        ch = '>';
-                        break;
-                    case T_AMULET:
-                        ch = '*';
-                        break;
-                    }
-                }
-                else
-                {
-                    /* memory (dim) */
-                    switch (t->t)
-                    {
-                    case T_WALL:
-                        ch = '#';
-                        break;
-                    case T_FLOOR:
-                        ch = '.';
-                        break;
-                    case T_STAIR:
-                        ch = '>';
-                        break;
-                    case T_AMULET:
-                        ch = '.';
-                        break; /* hidden if not in view */
-                    }
-                }
-            }
-            putchar(ch);
+            fprintf(stderr, "out of memory\n");
+            exit(1);
         }
     }
-    /* Items */
-    for (int i = 0; i < MAX_ITEMS; i++)
-        if (items[i].alive)
-        {
-            if (mapc[items[i].y][items[i].x].vis)
-            {
-                term_move(items[i].y + 1, items[i].x + 1);
-                putchar(items[i].ch);
-            }
-        }
-    /* Mobs */
-    for (int i = 0; i < MAX_MOBS; i++)
-        if (mobs[i].alive)
-        {
-            if (mapc[mobs[i].y][mobs[i].x].vis)
-            {
-                term_move(mobs[i].y + 1, mobs[i].x + 1);
-                putchar(mobs[i].ch);
-            }
-        }
-    /* Player */
-    term_move(pl.y + 1, pl.x + 1);
-    putchar('@');
+    memcpy(out.b + out.len, s, n);
+    out.len += n;
+}
+static void out_move(int y, int x)
+{
+    char buf[32];
+    int n = snprintf(buf, sizeof buf, "\x1b[%d;%dH", y, x);
+    out_write(buf, (size_t)n);
+}
+
+static char tile_char(const Tile *t)
+{
+    if (!t->seen)
+        return ' ';
+    switch (t->t)
+    {
+    case T_WALL:
+        return '#';
+    case T_FLOOR:
+        return '.';
+    case T_STAIR:
+        return '>';
+    case T_AMULET:
+        return t->vis ? '*' : '.'; /* hidden if not in view */
+    }
+    return ' ';
 }
 
 /* ---------- Status line ---------- */
@@ -705,16 +738,86 @@ static void set_msg(const char *fmt, ...)
     vsnprintf(status_msg, MAP_W, fmt, ap);
     va_end(ap);
 }
-static void draw_status(void)
+
+/* What cell c shows: player, else a visible mob, else a visible item, else
+   the tile */
+static char cell_char(int c)
 {
-    term_move(MAP_H, 1);
-    for (int i = 0; i < MAP_W; i++)
-        putchar(' ');
-    term_move(MAP_H, 1);
-    printf("HP %d/%d  Food %d  Floor %d/%d  %s%s",
-           pl.hp, pl.hpmax, pl.hunger, pl.floor, FLOORS,
-           pl.have_amulet ? "Amulet:Yes " : "",
-           status_msg);
+    const Tile *t = &mapc[c];
+    if (c == pl.y * map_w + pl.x)
+        return '@';
+    if (t->vis && mob_grid[c])
+        return mobs[mob_grid[c] - 1].ch;
+    if (t->vis && item_grid[c])
+        return items[item_grid[c] - 1].ch;
+    return tile_char(t);
+}
+
+static void compose_status(void)
+{
+    /* Status, blank-padded to the map width */
+    char status[2 * MAP_W];
+    int n = snprintf(status, sizeof status, "HP %d/%d  Food %d  Floor %d/%d  %s%s",
+                     pl.hp, pl.hpmax, pl.hunger, pl.floor, FLOORS,
+                     pl.have_amulet ? "Amulet:Yes " : "",
+                     status_msg);
+    n = clampi(n, 0, (int)sizeof status - 1);
+    char *line = frame + (size_t)map_h * map_w;
+    for (int x = 0; x < map_w; x++)
+        line[x] = x < n ? status[x] : ' ';
+}
+
+/* Write cells [x0, x1) of row y that differ from what is shown */
+static void emit_row(int y, int x0, int x1, int *cy, int *cx)
+{
+    const char *f = frame + (size_t)y * map_w;
+    char *s = shown + (size_t)y * map_w;
+    for (int x = x0; x < x1; x++)
+    {
+        if (f[x] == s[x])
+            continue;
+        if (y == *cy && x > *cx && x - *cx <= 4)
+            out_write(f + *cx, (size_t)(x - *cx)); /* reprint a short gap */
+        else if (y != *cy || x != *cx)
+            out_move(y + 1, x + 1);
+        out_write(f + x, 1);
+        s[x] = f[x];
+        *cy = y;
+        *cx = x + 1;
+    }
+}
+
+/* Append to `out` the escape sequences that bring the terminal up to date */
+static void render(void)
+{
+    int cy = -1, cx = -1; /* terminal cursor, where known */
+    compose_status();
+    if (redraw_all)
+    {
+        for (int c = 0; c < map_w * map_h; c++)
+            frame[c] = cell_char(c);
+        for (int y = 0; y <= map_h; y++)
+            emit_row(y, 0, map_w, &cy, &cx);
+    }
+    else
+    {
+        /* the lit area is a small box: sweep it in row order */
+        int x0 = map_w, x1 = 0, y0 = map_h, y1 = 0;
+        for (int i = 0; i < nredraw; i++)
+        {
+            int c = redraw_cells[i], x = c % map_w, y = c / map_w;
+            frame[c] = cell_char(c);
+            x0 = x < x0 ? x : x0;
+            x1 = x >= x1 ? x + 1 : x1;
+            y0 = y < y0 ? y : y0;
+            y1 = y >= y1 ? y + 1 : y1;
+        }
+        for (int y = y0; y < y1; y++)
+            emit_row(y, x0, x1, &cy, &cx);
+        emit_row(map_h, 0, map_w, &cy, &cx);
+    }
+    redraw_all = false;
+    nredraw = 0;
 }
 
 /* ---------- Combat & Items ---------- */
@@ -731,6 +834,7 @@ static void attack_mob(int i)
     if (mobs[i].hp <= 0)
     {
         mobs[i].alive = false;
+        mob_grid[(size_t)mobs[i].y * map_w + mobs[i].x] = 0;
         set_msg("You slay the %s.", mobs[i].name);
     }
     else
@@ -756,22 +860,76 @@ static void pickup_if_any(void)
             set_msg("You eat a ration (+%d food).", feed);
         }
         items[idx].alive = false;
+        item_grid[(size_t)pl.y * map_w + pl.x] = 0;
     }
     /* Amulet */
-    if (mapc[pl.y][pl.x].t == T_AMULET)
+    if (TILE(pl.x, pl.y).t == T_AMULET)
     {
         pl.have_amulet = true;
-        mapc[pl.y][pl.x].t = T_FLOOR;
+        TILE(pl.x, pl.y).t = T_FLOOR;
         set_msg("You pick up the Amulet of Yendor!");
     }
 }
 
 /* ---------- Monster AI ---------- */
+/* One distance map per turn, shared by every monster: a breadth-first
+   (unit-cost Dijkstra) flood from the player over walkable tiles, 8-way
+   like monster moves. Chasers step downhill on it, so they follow
+   corridors around walls. It is built on the first chase of a turn and
+   only reaches cells within FLOW_R steps; the stamp array marks this
+   turn's cells, so nothing is cleared between turns. */
+#define FLOW_R (3 * VIEW_R)
+#define FLOW_FAR 0x7fffffff
+
+static int *flow_dist, *flow_queue;
+static unsigned *flow_stamp, flow_turn = 0;
+
+static const int dir8[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+static void build_flow(void)
+{
+    flow_turn++;
+    int head = 0, tail = 0;
+    int start = pl.y * map_w + pl.x;
+    flow_stamp[start] = flow_turn;
+    flow_dist[start] = 0;
+    flow_queue[tail++] = start;
+    while (head < tail)
+    {
+        int c = flow_queue[head++];
+        int d = flow_dist[c];
+        if (d == FLOW_R)
+            continue;
+        int x = c % map_w, y = c / map_w;
+        for (int k = 0; k < 8; k++)
+        {
+            int nx = x + dir8[k][0], ny = y + dir8[k][1];
+            if (is_blocking(nx, ny))
+                continue;
+            int n = ny * map_w + nx;
+            if (flow_stamp[n] == flow_turn)
+                continue;
+            flow_stamp[n] = flow_turn;
+            flow_dist[n] = d + 1;
+            flow_queue[tail++] = n;
+        }
+    }
+}
+
+static int flow_at(int x, int y)
+{
+    if (!in_bounds(x, y))
+        return FLOW_FAR;
+    int c = y * map_w + x;
+    return flow_stamp[c] == flow_turn ? flow_dist[c] : FLOW_FAR;
+}
+
 static int signi(int v) { return (v > 0) - (v < 0); }
 
 static void mobs_turn(void)
 {
-    for (int i = 0; i < MAX_MOBS; i++)
+    bool flow_built = false;
+    for (int i = 0; i < max_mobs; i++)
         if (mobs[i].alive)
         {
             /* If adjacent to player, attack */
@@ -782,69 +940,57 @@ static void mobs_turn(void)
                 attack_player(i);
                 continue;
             }
-            /* Move toward player if in FOV & somewhat close, else wander */
+            /* Chase down the distance map if in FOV & somewhat close, else
+               wander; the straight step wins ties */
             int step_x = 0, step_y = 0;
-            if (mapc[mobs[i].y][mobs[i].x].vis && (dx * dx + dy * dy) <= (VIEW_R * VIEW_R))
+            bool chase = false;
+            if (TILE(mobs[i].x, mobs[i].y).vis && (dx * dx + dy * dy) <= (VIEW_R * VIEW_R))
             {
-                step_x = signi(dx);
-                step_y = signi(dy);
-                /* try axis-aligned if blocked */
-                if (!is_walkable_free(mobs[i].x + step_x, mobs[i].y + step_y))
+                if (!flow_built)
                 {
-                    if (abs(dx) > abs(dy))
-                    {
-                        if (is_walkable_free(mobs[i].x + step_x, mobs[i].y))
-                        {
-                            step_y = 0;
-                        }
-                        else if (is_walkable_free(mobs[i].x, mobs[i].y + step_y))
-                        {
-                            step_x = 0;
-                        }
-                        else
-                        {
-                            step_x = (rand() % 3) - 1;
-                            step_y = (rand() % 3) - 1;
-                        }
-                    }
-                    else
+                    build_flow();
+                    flow_built = true;
+                }
+                int best = flow_at(mobs[i].x, mobs[i].y);
+                int sx = signi(dx), sy = signi(dy);
+                if (flow_at(mobs[i].x + sx, mobs[i].y + sy) < best &&
+                    is_walkable_free(mobs[i].x + sx, mobs[i].y + sy))
+                {
+                    step_x = sx;
+                    step_y = sy;
+                    chase = true;
+                }
+                else
+                    for (int k = 0; k < 8; k++)
                     {
-                        if (is_walkable_free(mobs[i].x, mobs[i].y + step_y))
+                        int nx = mobs[i].x + dir8[k][0], ny = mobs[i].y + dir8[k][1];
+                        int d = flow_at(nx, ny);
+                        if (d < best && is_walkable_free(nx, ny))
                         {
-                            step_x = 0;
-                        }
-                        else if (is_walkable_free(mobs[i].x + step_x, mobs[i].y))
-                        {
-                            step_y = 0;
-                        }
-                        else
-                        {
-                            step_x = (rand() % 3) - 1;
-                            step_y = (rand() % 3) - 1;
+                            best = d;
+                            step_x = dir8[k][0];
+                            step_y = dir8[k][1];
+                            chase = true;
                         }
                     }
-                }
             }
-            else
+            if (!chase)
             {
                 step_x = (rand() % 3) - 1;
                 step_y = (rand() % 3) - 1;
             }
-            int nx = mobs[i].x + clampi(step_x, -1, 1);
-            int ny = mobs[i].y + clampi(step_y, -1, 1);
+            int nx = mobs[i].x + step_x;
+            int ny = mobs[i].y + step_y;
             if (in_bounds(nx, ny) && is_walkable_free(nx, ny))
-            {
-                mobs[i].x = nx;
-                mobs[i].y = ny;
-            }
+                move_mob(i, nx, ny);
         }
 }
 
 /* ---------- Player movement ---------- */
 static void try_move_player(int dx, int dy)
 {
-    int nx = clampi(pl.x + dx, 0, MAP_W - 1);
-    int ny = clampi(pl.y + dy, 0, MAP_H - 2);
+    int nx = clampi(pl.x + dx, 0, map_w - 1);
+    int ny = clampi(pl.y + dy, 0, map_h - 1);
     if (nx == pl.x && ny == pl.y)
         return;
     if (is_blocking(nx, ny))
@@ -866,7 +1012,7 @@ static void try_move_player(int dx, int dy)
 /* ---------- Floor transitions ---------- */
 static bool descend_if_possible(void)
 {
-    if (mapc[pl.y][pl.x].t == T_STAIR)
+    if (TILE(pl.x, pl.y).t == T_STAIR)
     {
         pl.floor++;
         set_msg("You descend to floor %d.", pl.floor);
@@ -881,6 +1027,122 @@ static bool descend_if_possible(void)
     }
 }
 
+/* ---------- World setup ---------- */
+/* Size the map and everything indexed by cell; bigger maps get
+   proportionally more rooms and items */
+static void world_init(int w, int h, int nmobs)
+{
+    map_w = w;
+    map_h = h;
+    size_t cells = (size_t)w * h;
+    int scale = (int)(cells / ((size_t)MAP_W * (MAP_H - 1)));
+    if (scale < 1)
+        scale = 1;
+    max_rooms = MAX_ROOMS * scale;
+    max_items = MAX_ITEMS * scale;
+    mobs_per_floor = nmobs;
+    max_mobs = nmobs > MAX_MOBS ? nmobs : MAX_MOBS;
+
+    mapc = xcalloc(cells, sizeof(Tile));
+    mob_grid = xcalloc(cells, sizeof(int));
+    item_grid = xcalloc(cells, sizeof(int));
+    room_cell = xcalloc(cells, sizeof(bool));
+    flow_dist = xcalloc(cells, sizeof(int));
+    flow_queue = xcalloc(cells, sizeof(int));
+    flow_stamp = xcalloc(cells, sizeof(unsigned));
+    rooms = xcalloc((size_t)max_rooms, sizeof(Rect));
+    mobs = xcalloc((size_t)max_mobs, sizeof(Mob));
+    items = xcalloc((size_t)max_items, sizeof(Item));
+    frame = xcalloc(cells + (size_t)w, 1);
+    shown = xcalloc(cells + (size_t)w, 1); /* NULs: first frame draws everything */
+
+    pl.hpmax = 20;
+    pl.hp = 20;
+    pl.hunger = 800;
+    pl.floor = 1;
+    pl.have_amulet = false;
+}
+
+/* starvation / regen */
+static void hunger_tick(void)
+{
+    pl.hunger -= 1;
+    if (pl.hunger <= 0)
+    {
+        pl.hunger = 0;
+        if (rand() % 3 == 0)
+        {
+            pl.hp -= 1;
+            set_msg("You are starving!");
+        }
+    }
+    else if (pl.hunger > 600 && rand() % 9 == 0)
+    {
+        pl.hp = clampi(pl.hp + 1, 0, pl.hpmax);
+    }
+}
+
+/* ---------- Headless benchmark ---------- */
+/* A random-walking, unkillable player on a big map full of monsters, with
+   a fresh floor every 500 turns; frames are rendered into the output
+   buffer and dropped. Reports turns/sec and per-phase costs. */
+static int bench(int turns, int w, int h, int nmobs)
+{
+    srand(1);
+    world_init(w, h, nmobs);
+    gen_floor(pl.floor);
+
+    clock_t t_fov = 0, t_ai = 0, t_draw = 0;
+    size_t bytes = 0;
+    int floors = 1, deaths = 0;
+    clock_t t0 = clock();
+    for (int turn = 0; turn < turns; turn++)
+    {
+        clock_t a = clock();
+        compute_fov();
+        clock_t b = clock();
+        render();
+        bytes += out.len;
+        out.len = 0;
+        clock_t c = clock();
+        hunger_tick();
+        try_move_player(irand(-1, 1), irand(-1, 1));
+        mobs_turn();
+        t_fov += b - a;
+        t_draw += c - b;
+        t_ai += clock() - c;
+        if (pl.hp <= 0)
+        {
+            deaths++;
+            pl.hp = pl.hpmax;
+            pl.hunger = 800;
+        }
+        if (turn % 500 == 499)
+        {
+            pl.floor = pl.floor % FLOORS + 1;
+            pl.have_amulet = false;
+            gen_floor(pl.floor);
+            floors++;
+        }
+    }
+    double secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    memset(shown, 0, (size_t)map_w * (map_h + 1)); /* what a full repaint costs */
+    redraw_all = true;
+    render();
+    size_t full = out.len;
+    out.len = 0;
+
+    double per = 1e6 / CLOCKS_PER_SEC / turns;
+    printf("rogue bench: %dx%d map, %d monsters, %d turns in %.2f s = %.0f turns/s\n",
+           w, h, nmobs, turns, secs, turns / secs);
+    printf("  per turn: fov %.2f us, player+monsters %.2f us, render %.2f us\n",
+           t_fov * per, t_ai * per, t_draw * per);
+    printf("  output %.0f bytes/turn (full repaint %zu), %d floors, %d deaths\n",
+           (double)bytes / turns, full, floors, deaths);
+    return 0;
+}
+
 /* ---------- Main loop ---------- */
 static void game_over_screen(const char *msg)
 {
@@ -896,8 +1158,24 @@ static void game_over_screen(const char *msg)
 #endif
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        int turns = argc > 2 ? atoi(argv[2]) : 20000;
+        int w = 400, h = 200;
+        if (argc > 3 && sscanf(argv[3], "%dx%d", &w, &h) != 2)
+            w = 400, h = 200;
+        int nmobs = argc > 4 ? atoi(argv[4]) : 2000;
+        if (turns < 1 || w < MAP_W || h < MAP_H - 1 || nmobs < 1)
+        {
+            fprintf(stderr, "usage: %s --bench [turns] [WxH, at least %dx%d] [monsters]\n",
+                    argv[0], MAP_W, MAP_H - 1);
+            return 2;
+        }
+        return bench(turns, w, h, nmobs);
+    }
+
     srand((unsigned)time(NULL));
 
 #if defined(_WIN32)
@@ -915,13 +1193,7 @@ int main(void)
     term_hide_cursor();
     term_clear();
 
-    /* init player */
-    pl.hpmax = 20;
-    pl.hp = 20;
-    pl.hunger = 800;
-    pl.floor = 1;
-    pl.have_amulet = false;
-
+    world_init(MAP_W, MAP_H - 1, 0);
     gen_floor(pl.floor);
     compute_fov();
     pickup_if_any();
@@ -931,26 +1203,12 @@ int main(void)
     while (running)
     {
         compute_fov();
-        term_clear();
-        draw_map();
-        draw_status();
+        render();
+        fwrite(out.b, 1, out.len, stdout);
+        out.len = 0;
         fflush(stdout);
 
-        /* starvation / regen */
-        pl.hunger -= 1;
-        if (pl.hunger <= 0)
-        {
-            pl.hunger = 0;
-            if (rand() % 3 == 0)
-            {
-                pl.hp -= 1;
-                set_msg("You are starving!");
-            }
-        }
-        else if (pl.hunger > 600 && rand() % 9 == 0)
-        {
-            pl.hp = clampi(pl.hp + 1, 0, pl.hpmax);
-        }
+        hunger_tick();
 
         if (pl.hp <= 0)
         {
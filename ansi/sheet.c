@@ -1,13 +1,21 @@
 /* sheet.c — terminal spreadsheet (C99)
  *
  * Features:
- *  - A1 references, 64 columns (A..BL), 100 rows.
+ *  - A1 references, 16384 columns (A..XFD), 1048576 rows, sparse storage
+ *    (only cells that are set or referenced exist).
  *  - Numbers + formulas (= …) with + - * / ^, parentheses.
  *  - Functions: SUM, AVG, MIN, MAX, COUNT over ranges/exprs.
  *  - Ranges: A1:B3, comma-separated arguments.
- *  - Recalc on-demand with cycle detection (#CYCLE), parse errors (#PARSE),
- *    invalid refs (#REF), divide-by-zero (#DIV0).
- *  - REPL commands: SET, SHOW, PRINT, CLEAR, SAVESS, LOADSS, SAVECSV, LOADCSV, HELP, QUIT.
+ *  - Formulas compile once, at SET, to a postfix program; references and
+ *    ranges become edges of a dependency graph. An edit marks the cell and
+ *    everything downstream dirty, and the next read recomputes just those
+ *    cells in topological order (SCCs from Tarjan's algorithm: any cell on
+ *    a reference cycle is #CYCLE). Range aggregates keep running sums,
+ *    counts and min/max that cell changes update in place.
+ *  - Errors: #CYCLE, parse errors (#PARSE), invalid refs (#REF),
+ *    divide-by-zero (#DIV0); the first one met in left-to-right
+ *    evaluation order wins.
+ *  - REPL commands: SET, SHOW, PRINT, CLEAR, SAVESS, LOADSS, SAVECSV, LOADCSV, BENCH, HELP, QUIT.
  *
  * Build: gcc -std=c99 -O2 -Wall -Wextra sheet.c -o sheet -lm
  */
@@ -23,14 +31,19 @@ ss> print 5 5
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 
-#define MAX_ROWS 100
-#define MAX_COLS 64
+#define MAX_ROWS 1048576
+#define MAX_COLS 16384 /* A..XFD */
 #define COL_LABEL_MAX 3
+#define ROW_DIGITS_MAX 7
 #define LINE_MAXLEN 4096
+#define RANGE_RESCAN_DELTAS 4096 /* min deltas between rescans of a running sum */
 
 /* ---------- utils ---------- */
 static char *xstrdup(const char *s)
@@ -41,6 +54,27 @@ static char *xstrdup(const char *s)
         memcpy(p, s, n);
     return p;
 }
+static void *xrealloc(void *p, size_t n)
+{
+    void *q = realloc(p, n ? n : 1);
+    if (!q)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return q;
+}
+/* Grow *arr (element size sz) so that index need-1 fits */
+static void grow(void **arr, int *cap, int need, size_t sz)
+{
+    if (need <= *cap)
+        return;
+    int n = *cap ? *cap : 16;
+    while (n < need)
+        n *= 2;
+    *arr = xrealloc(*arr, (size_t)n * sz);
+    *cap = n;
+}
 static void trim(char *s)
 {
     size_t n = strlen(s);
@@ -63,26 +97,217 @@ typedef enum
     E_CYCLE
 } EvalErr;
 
+typedef enum
+{
+    F_SUM,
+    F_AVG,
+    F_MIN,
+    F_MAX,
+    F_COUNT
+} FuncId;
+
+/* Compiled formula: postfix over a value stack, in the order the source
+   is read, so the first error met is the same one a left-to-right
+   evaluation would hit. Function calls keep their running (acc, count)
+   on a separate aggregate stack. */
+typedef enum
+{
+    OP_NUM,   /* push num */
+    OP_REF,   /* push value of cell arg; its error aborts */
+    OP_NEG,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_POW,
+    OP_FN,    /* open aggregate fn */
+    OP_ARG,   /* fold the popped value into the open aggregate */
+    OP_RANGE, /* fold range arg into the open aggregate */
+    OP_ENDFN, /* close the aggregate, push its result */
+    OP_PARSE  /* the source stops parsing here: #PARSE */
+} OpCode;
+
 typedef struct
 {
+    uint8_t op;
+    uint8_t fn;
+    int arg; /* cell id (OP_REF) or range id (OP_RANGE) */
+    double num;
+} Op;
+
+typedef struct
+{
+    int row, col;
     char *formula;  /* NULL if literal */
     double literal; /* if formula==NULL -> literal value */
-    /* cache for this eval pass */
-    int last_eval_id;
-    double cached;
-    EvalErr last_err;
-    bool set; /* has any value/formula been set? */
+    bool set;       /* has any value/formula been set? */
+    Op *code;       /* compiled formula */
+    int ncode;
+    int *deps; /* formula cells with an OP_REF to this one */
+    int ndeps, capdeps;
+    /* value as of the last recalc; ranges have folded in these */
+    double value;
+    EvalErr err;
+    bool counted; /* set, as ranges last saw it */
+    /* recalc */
+    bool dirty;
+    bool tj_on;
+    int tj_index, tj_low; /* 0 = not visited */
 } Cell;
 
+/* A range argument of one formula, with a running aggregate over the set
+   cells inside it. Unset cells count as 0 for SUM/AVG/MIN/MAX. */
+typedef struct
+{
+    int owner; /* formula cell; -1 if free */
+    int r1, c1, r2, c2;
+    double sum, min, max; /* over cells without an error */
+    int nset, nok, nerr;
+    int deltas;    /* updates since the last full scan */
+    bool stale;    /* everything needs a rescan */
+    bool mm_stale; /* min/max need a rescan */
+} Range;
+
 typedef struct
 {
-    Cell cells[MAX_ROWS][MAX_COLS];
-    int eval_pass_id;
+    int *ids;
+    int n, cap;
+} IdList;
+
+typedef struct
+{
+    double acc, count;
+    FuncId fn;
+} Agg;
+
+typedef struct
+{
+    Cell *cells;
+    int ncells, capcells;
+    int *index; /* open addressing: (row, col) -> cell id + 1 */
+    int index_cap;
+    Range *ranges;
+    int nranges, capranges;
+    IdList free_ranges;
+    IdList *colranges; /* [MAX_COLS]: ranges covering each column */
+    IdList dirty;      /* waiting for recalc(), in marking order */
+    /* recalc scratch */
+    IdList order, tj_stack, call_stack, call_iter;
+    double *vstk;
+    int capv;
+    Agg *astk;
+    int capa;
 } Sheet;
 
+static void ids_push(IdList *l, int id)
+{
+    grow((void **)&l->ids, &l->cap, l->n + 1, sizeof(int));
+    l->ids[l->n++] = id;
+}
+static void ids_remove(IdList *l, int id)
+{
+    for (int i = 0; i < l->n; i++)
+        if (l->ids[i] == id)
+        {
+            l->ids[i] = l->ids[--l->n];
+            return;
+        }
+}
+
 static void sheet_init(Sheet *sh)
 {
     memset(sh, 0, sizeof *sh);
+    sh->colranges = (IdList *)calloc(MAX_COLS, sizeof(IdList));
+    if (!sh->colranges)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+}
+
+static void sheet_free(Sheet *sh)
+{
+    for (int i = 0; i < sh->ncells; i++)
+    {
+        free(sh->cells[i].formula);
+        free(sh->cells[i].code);
+        free(sh->cells[i].deps);
+    }
+    for (int c = 0; c < MAX_COLS; c++)
+        free(sh->colranges[c].ids);
+    free(sh->colranges);
+    free(sh->cells);
+    free(sh->index);
+    free(sh->ranges);
+    free(sh->free_ranges.ids);
+    free(sh->dirty.ids);
+    free(sh->order.ids);
+    free(sh->tj_stack.ids);
+    free(sh->call_stack.ids);
+    free(sh->call_iter.ids);
+    free(sh->vstk);
+    free(sh->astk);
+}
+
+static uint32_t cell_hash(int r, int c)
+{
+    uint64_t k = ((uint64_t)(uint32_t)r << 14) | (uint32_t)c;
+    k *= 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(k >> 32);
+}
+
+/* Cell id at (r,c), or -1 */
+static int cell_find(const Sheet *sh, int r, int c)
+{
+    if (!sh->index_cap)
+        return -1;
+    uint32_t mask = (uint32_t)sh->index_cap - 1;
+    for (uint32_t h = cell_hash(r, c) & mask;; h = (h + 1) & mask)
+    {
+        int id = sh->index[h] - 1;
+        if (id < 0)
+            return -1;
+        if (sh->cells[id].row == r && sh->cells[id].col == c)
+            return id;
+    }
+}
+
+static void index_put(Sheet *sh, int id)
+{
+    uint32_t mask = (uint32_t)sh->index_cap - 1;
+    uint32_t h = cell_hash(sh->cells[id].row, sh->cells[id].col) & mask;
+    while (sh->index[h])
+        h = (h + 1) & mask;
+    sh->index[h] = id + 1;
+}
+
+/* Cell id at (r,c), creating an empty cell. May move sh->cells. */
+static int cell_get(Sheet *sh, int r, int c)
+{
+    int id = cell_find(sh, r, c);
+    if (id >= 0)
+        return id;
+    if ((sh->ncells + 1) * 2 > sh->index_cap)
+    {
+        free(sh->index);
+        sh->index_cap = sh->index_cap ? sh->index_cap * 2 : 1024;
+        sh->index = (int *)calloc((size_t)sh->index_cap, sizeof(int));
+        if (!sh->index)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        for (int i = 0; i < sh->ncells; i++)
+            index_put(sh, i);
+    }
+    grow((void **)&sh->cells, &sh->capcells, sh->ncells + 1, sizeof(Cell));
+    id = sh->ncells++;
+    Cell *cell = &sh->cells[id];
+    memset(cell, 0, sizeof *cell);
+    cell->row = r;
+    cell->col = c;
+    index_put(sh, id);
+    return id;
 }
 
 /* Convert column number to label (0->A, 25->Z, 26->AA, ...) */
@@ -154,7 +379,7 @@ static bool parse_cellref(const char *s, int *pos, int *prow, int *pcol)
         row = row * 10 + (s[i] - '0');
         i++;
         cnt++;
-        if (cnt > 3)
+        if (cnt >= ROW_DIGITS_MAX)
             break;
     }
     if (row < 1 || row > MAX_ROWS)
@@ -165,19 +390,19 @@ static bool parse_cellref(const char *s, int *pos, int *prow, int *pcol)
     return true;
 }
 
-/* ---------- expression parser ---------- */
+/* ---------- formula compiler ---------- */
 typedef struct
 {
     const char *s;
     int pos;
     Sheet *sh;
-    /* for cycle detection within one top-level evaluation */
-    bool (*visiting)[MAX_COLS]; /* 2D array pointer [MAX_ROWS][MAX_COLS] */
+    int owner; /* cell being compiled */
+    Op *code;
+    int n, cap;
+    int depth, max_depth;   /* value stack */
+    int fdepth, max_fdepth; /* aggregate stack */
 } Parser;
 
-/* Forward decls */
-static EvalErr eval_cell(Sheet *sh, int r, int c, double *out, bool visiting[MAX_ROWS][MAX_COLS]);
-
 static void skip_ws(Parser *p)
 {
     while (isspace((unsigned char)p->s[p->pos]))
@@ -194,92 +419,52 @@ static bool match(Parser *p, char ch)
     }
     return false;
 }
-static bool match_word(Parser *p, const char *kw)
+
+static void emit(Parser *p, OpCode op, int fn, int arg, double num)
 {
-    skip_ws(p);
-    int n = (int)strlen(kw);
-    if (strncasecmp(p->s + p->pos, kw, n) == 0)
+    grow((void **)&p->code, &p->cap, p->n + 1, sizeof(Op));
+    Op *o = &p->code[p->n++];
+    o->op = (uint8_t)op;
+    o->fn = (uint8_t)fn;
+    o->arg = arg;
+    o->num = num;
+    switch (op)
     {
-        if (isalpha((unsigned char)kw[n - 1]))
-        {
-            char nxt = p->s[p->pos + n];
-            if (isalpha((unsigned char)nxt))
-                return false; /* require token boundary */
-        }
-        p->pos += n;
-        return true;
+    case OP_NUM:
+    case OP_REF:
+    case OP_ENDFN:
+        p->depth++;
+        break;
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_POW:
+    case OP_ARG:
+        p->depth--;
+        break;
+    default:
+        break;
     }
-    return false;
+    if (op == OP_FN)
+        p->fdepth++;
+    if (op == OP_ENDFN)
+        p->fdepth--;
+    if (p->depth > p->max_depth)
+        p->max_depth = p->depth;
+    if (p->fdepth > p->max_fdepth)
+        p->max_fdepth = p->fdepth;
 }
 
-/* Forward: expression grammar */
-static EvalErr parse_expr(Parser *p, double *out);
+/* Forward: expression grammar. Each returns false at a parse error; the
+   ops emitted so far are exactly what was evaluated before reaching it. */
+static bool parse_expr(Parser *p);
 
-/* Evaluate a range (r1:c1 to r2:c2 inclusive) applying aggregator */
-typedef enum
-{
-    F_SUM,
-    F_AVG,
-    F_MIN,
-    F_MAX,
-    F_COUNT
-} FuncId;
-
-static EvalErr eval_range_aggregate(Sheet *sh, int r1, int c1, int r2, int c2, FuncId f,
-                                    double *acc, int *count, bool visiting[MAX_ROWS][MAX_COLS])
-{
-    if (r2 < r1)
-    {
-        int t = r1;
-        r1 = r2;
-        r2 = t;
-    }
-    if (c2 < c1)
-    {
-        int t = c1;
-        c1 = c2;
-        c2 = t;
-    }
-    for (int r = r1; r <= r2; r++)
-    {
-        for (int c = c1; c <= c2; c++)
-        {
-            double v = 0;
-            EvalErr e = eval_cell(sh, r, c, &v, visiting);
-            if (e != E_OK && e != E_REF)
-            { /* ignore REF for COUNT */
-                return e;
-            }
-            if (f == F_COUNT)
-            {
-                if (sh->cells[r][c].set)
-                    (*count)++;
-            }
-            else
-            {
-                if (*count == 0)
-                {
-                    *acc = v;
-                }
-                else
-                {
-                    if (f == F_SUM)
-                        *acc += v;
-                    else if (f == F_MIN)
-                        *acc = (v < *acc) ? v : *acc;
-                    else if (f == F_MAX)
-                        *acc = (v > *acc) ? v : *acc;
-                }
-                (*count)++;
-            }
-        }
-    }
-    return E_OK;
-}
+static int range_new(Sheet *sh, int owner, int r1, int c1, int r2, int c2);
 
-/* Try parse a range A1:B3. On success sets flag and returns E_OK (no evaluation).
- * If not a range, leaves parser pos unchanged and returns E_OK with range_flag=false. */
-static EvalErr try_parse_range(Parser *p, int *r1, int *c1, int *r2, int *c2, bool *is_range)
+/* Try parse a range A1:B3. On success sets flag (no evaluation).
+ * If not a range, leaves parser pos unchanged with range_flag=false. */
+static void try_parse_range(Parser *p, int *r1, int *c1, int *r2, int *c2, bool *is_range)
 {
     int save = p->pos;
     skip_ws(p);
@@ -288,14 +473,14 @@ static EvalErr try_parse_range(Parser *p, int *r1, int *c1, int *r2, int *c2, bo
     {
         p->pos = save;
         *is_range = false;
-        return E_OK;
+        return;
     }
     skip_ws(p);
     if (p->s[p->pos] != ':')
     {
         p->pos = save;
         *is_range = false;
-        return E_OK;
+        return;
     }
     p->pos++; /* consume ':' */
     int rr2, cc2;
@@ -303,19 +488,17 @@ static EvalErr try_parse_range(Parser *p, int *r1, int *c1, int *r2, int *c2, bo
     {
         p->pos = save;
         *is_range = false;
-        return E_OK;
+        return;
     }
     *r1 = rr1;
     *c1 = cc1;
     *r2 = rr2;
     *c2 = cc2;
     *is_range = true;
-    return E_OK;
 }
 
-/* Parse a function call: NAME '(' args ')' where args are expressions or ranges.
-   Returns E_OK and writes result to *out. */
-static EvalErr parse_function(Parser *p, const char *name, double *out)
+/* Parse a function call: NAME '(' args ')' where args are expressions or ranges. */
+static bool parse_function(Parser *p, const char *name)
 {
     FuncId fid;
     if (strcasecmp(name, "SUM") == 0)
@@ -329,14 +512,12 @@ static EvalErr parse_function(Parser *p, const char *name, double *out)
     else if (strcasecmp(name, "COUNT") == 0)
         fid = F_COUNT;
     else
-        return E_PARSE;
+        return false;
 
     if (!match(p, '('))
-        return E_PARSE;
+        return false;
 
-    double acc = 0.0;
-    int count = 0;
-    bool first = true;
+    emit(p, OP_FN, fid, 0, 0);
     while (1)
     {
         skip_ws(p);
@@ -346,88 +527,42 @@ static EvalErr parse_function(Parser *p, const char *name, double *out)
         /* Try range first */
         int r1, c1, r2, c2;
         bool isrange = false;
-        EvalErr er = try_parse_range(p, &r1, &c1, &r2, &c2, &isrange);
-        if (er != E_OK)
-            return er;
+        try_parse_range(p, &r1, &c1, &r2, &c2, &isrange);
         if (isrange)
-        {
-            er = eval_range_aggregate(p->sh, r1, c1, r2, c2, fid, &acc, &count, p->visiting);
-            if (er != E_OK)
-                return er;
-        }
+            emit(p, OP_RANGE, fid, range_new(p->sh, p->owner, r1, c1, r2, c2), 0);
         else
         {
             /* General expression */
-            double v = 0;
-            er = parse_expr(p, &v);
-            if (er != E_OK)
-                return er;
-            if (fid == F_COUNT)
-            {
-                count += 1;
-            }
-            else
-            {
-                if (first)
-                    acc = v;
-                else
-                {
-                    if (fid == F_SUM)
-                        acc += v;
-                    else if (fid == F_MIN)
-                        acc = (v < acc) ? v : acc;
-                    else if (fid == F_MAX)
-                        acc = (v > acc) ? v : acc;
-                }
-                count += 1;
-            }
+            if (!parse_expr(p))
+                return false;
+            emit(p, OP_ARG, fid, 0, 0);
         }
 
         skip_ws(p);
         if (match(p, ','))
-        {
-            first = false;
             continue;
-        }
         if (match(p, ')'))
             break;
         /* Unexpected token */
-        if (p->s[p->pos] == 0)
-            return E_PARSE;
-        return E_PARSE;
-    }
-
-    if (fid == F_AVG)
-    {
-        if (count == 0)
-            return E_DIV0;
-        *out = acc / (double)count;
-    }
-    else if (fid == F_COUNT)
-    {
-        *out = (double)count;
-    }
-    else
-    {
-        *out = acc;
+        return false;
     }
-    return E_OK;
+    emit(p, OP_ENDFN, fid, 0, 0);
+    return true;
 }
 
 /* Primary := number | cell | function | '(' expr ')' | unary ('+'|'-') factor */
-static EvalErr parse_factor(Parser *p, double *out)
+static bool parse_factor(Parser *p)
 {
     skip_ws(p);
     /* unary */
     if (match(p, '+'))
-        return parse_factor(p, out);
+        return parse_factor(p);
     if (match(p, '-'))
     {
-        EvalErr e = parse_factor(p, out);
-        if (e != E_OK)
-            return e;
-        *out = -(*out);
-        return E_OK;
+        if (!parse_factor(p))
+            return false;
+        emit(p, OP_NEG, 0, 0, 0);
+        return true;
     }
 
     /* number */
@@ -436,8 +571,8 @@ static EvalErr parse_factor(Parser *p, double *out)
         double v = 0;
         if (parse_number(p->s, &p->pos, &v))
         {
-            *out = v;
-            return E_OK;
+            emit(p, OP_NUM, 0, 0, v);
+            return true;
         }
         p->pos = sv;
     }
@@ -448,8 +583,12 @@ static EvalErr parse_factor(Parser *p, double *out)
         int r, c;
         if (parse_cellref(p->s, &p->pos, &r, &c))
         {
-            EvalErr e = eval_cell(p->sh, r, c, out, p->visiting);
-            return e;
+            int id = cell_get(p->sh, r, c);
+            Cell *dep = &p->sh->cells[id];
+            grow((void **)&dep->deps, &dep->capdeps, dep->ndeps + 1, sizeof(int));
+            dep->deps[dep->ndeps++] = p->owner;
+            emit(p, OP_REF, 0, id, 0);
+            return true;
         }
         p->pos = sv;
     }
@@ -470,18 +609,8 @@ static EvalErr parse_factor(Parser *p, double *out)
         {
             skip_ws(p);
             if (p->s[p->pos] == '(')
-            {
-                double v = 0;
-                EvalErr e = parse_function(p, name, &v);
-                if (e != E_OK)
-                    return e;
-                *out = v;
-                return E_OK;
-            }
-            else
-            {
-                p->pos = sv; /* not a function after all */
-            }
+                return parse_function(p, name);
+            p->pos = sv; /* not a function after all */
         }
         else
         {
@@ -491,173 +620,628 @@ static EvalErr parse_factor(Parser *p, double *out)
 
     /* (expr) */
     if (match(p, '('))
-    {
-        EvalErr e = parse_expr(p, out);
-        if (e != E_OK)
-            return e;
-        if (!match(p, ')'))
-            return E_PARSE;
-        return E_OK;
-    }
+        return parse_expr(p) && match(p, ')');
 
-    return E_PARSE;
+    return false;
 }
 
 /* exponentiation (right-assoc) */
-static EvalErr parse_power(Parser *p, double *out)
+static bool parse_power(Parser *p)
 {
-    EvalErr e = parse_factor(p, out);
-    if (e != E_OK)
-        return e;
+    if (!parse_factor(p))
+        return false;
     skip_ws(p);
     if (match(p, '^'))
     {
-        double rhs = 0;
-        e = parse_power(p, &rhs);
-        if (e != E_OK)
-            return e;
-        *out = pow(*out, rhs);
+        if (!parse_power(p))
+            return false;
+        emit(p, OP_POW, 0, 0, 0);
     }
-    return E_OK;
+    return true;
 }
 
 /* term: factor ((* or /) factor)* */
-static EvalErr parse_term(Parser *p, double *out)
+static bool parse_term(Parser *p)
 {
-    EvalErr e = parse_power(p, out);
-    if (e != E_OK)
-        return e;
+    if (!parse_power(p))
+        return false;
     while (1)
     {
         skip_ws(p);
+        OpCode op;
         if (match(p, '*'))
-        {
-            double rhs = 0;
-            e = parse_power(p, &rhs);
-            if (e != E_OK)
-                return e;
-            *out *= rhs;
-        }
+            op = OP_MUL;
         else if (match(p, '/'))
-        {
-            double rhs = 0;
-            e = parse_power(p, &rhs);
-            if (e != E_OK)
-                return e;
-            if (rhs == 0)
-                return E_DIV0;
-            *out /= rhs;
-        }
+            op = OP_DIV;
         else
             break;
+        if (!parse_power(p))
+            return false;
+        emit(p, op, 0, 0, 0);
     }
-    return E_OK;
+    return true;
 }
 
 /* expr: term ((+|-) term)* */
-static EvalErr parse_expr(Parser *p, double *out)
+static bool parse_expr(Parser *p)
 {
-    EvalErr e = parse_term(p, out);
-    if (e != E_OK)
-        return e;
+    if (!parse_term(p))
+        return false;
     while (1)
     {
         skip_ws(p);
+        OpCode op;
         if (match(p, '+'))
+            op = OP_ADD;
+        else if (match(p, '-'))
+            op = OP_SUB;
+        else
+            break;
+        if (!parse_term(p))
+            return false;
+        emit(p, op, 0, 0, 0);
+    }
+    return true;
+}
+
+/* Compile cells[id].formula, registering its references and ranges */
+static void compile_formula(Sheet *sh, int id)
+{
+    Parser p = {.s = sh->cells[id].formula, .pos = 0, .sh = sh, .owner = id};
+    bool ok = parse_expr(&p);
+    if (ok)
+    {
+        /* trailing junk? */
+        skip_ws(&p);
+        ok = (p.s[p.pos] == 0);
+    }
+    if (!ok)
+        emit(&p, OP_PARSE, 0, 0, 0);
+    grow((void **)&sh->vstk, &sh->capv, p.max_depth + 1, sizeof(double));
+    grow((void **)&sh->astk, &sh->capa, p.max_fdepth + 1, sizeof(Agg));
+    sh->cells[id].code = p.code;
+    sh->cells[id].ncode = p.n;
+}
+
+/* ---------- range aggregates ---------- */
+
+static double range_area(const Range *g)
+{
+    return (double)(g->r2 - g->r1 + 1) * (double)(g->c2 - g->c1 + 1);
+}
+
+static bool range_has(const Range *g, int r, int c)
+{
+    return r >= g->r1 && r <= g->r2 && c >= g->c1 && c <= g->c2;
+}
+
+static int range_new(Sheet *sh, int owner, int r1, int c1, int r2, int c2)
+{
+    int id;
+    if (sh->free_ranges.n)
+        id = sh->free_ranges.ids[--sh->free_ranges.n];
+    else
+    {
+        grow((void **)&sh->ranges, &sh->capranges, sh->nranges + 1, sizeof(Range));
+        id = sh->nranges++;
+    }
+    Range *g = &sh->ranges[id];
+    memset(g, 0, sizeof *g);
+    g->owner = owner;
+    g->r1 = (r1 < r2) ? r1 : r2;
+    g->r2 = (r1 < r2) ? r2 : r1;
+    g->c1 = (c1 < c2) ? c1 : c2;
+    g->c2 = (c1 < c2) ? c2 : c1;
+    g->stale = true;
+    for (int c = g->c1; c <= g->c2; c++)
+        ids_push(&sh->colranges[c], id);
+    return id;
+}
+
+static void range_free(Sheet *sh, int id)
+{
+    Range *g = &sh->ranges[id];
+    for (int c = g->c1; c <= g->c2; c++)
+        ids_remove(&sh->colranges[c], id);
+    g->owner = -1;
+    ids_push(&sh->free_ranges, id);
+}
+
+/* Existing cells inside a range: row-major over the area when that is
+   smaller than the sheet, otherwise every cell filtered by bounds */
+typedef struct
+{
+    const Range *g;
+    bool by_area;
+    int r, c, i;
+} RangeIter;
+
+static void range_iter(RangeIter *it, const Sheet *sh, const Range *g)
+{
+    it->g = g;
+    it->by_area = range_area(g) <= (double)sh->ncells;
+    it->r = g->r1;
+    it->c = g->c1;
+    it->i = 0;
+}
+
+/* Next cell id, or -1 */
+static int range_next(RangeIter *it, const Sheet *sh)
+{
+    const Range *g = it->g;
+    if (it->by_area)
+    {
+        while (it->r <= g->r2)
         {
-            double rhs = 0;
-            e = parse_term(p, &rhs);
-            if (e != E_OK)
-                return e;
-            *out += rhs;
+            int id = cell_find(sh, it->r, it->c);
+            if (++it->c > g->c2)
+            {
+                it->c = g->c1;
+                it->r++;
+            }
+            if (id >= 0)
+                return id;
         }
-        else if (match(p, '-'))
+        return -1;
+    }
+    while (it->i < sh->ncells)
+    {
+        const Cell *cell = &sh->cells[it->i++];
+        if (range_has(g, cell->row, cell->col))
+            return it->i - 1;
+    }
+    return -1;
+}
+
+static void range_rescan(Sheet *sh, Range *g)
+{
+    g->sum = 0;
+    g->min = g->max = 0;
+    g->nset = g->nok = g->nerr = 0;
+    RangeIter it;
+    range_iter(&it, sh, g);
+    for (int id; (id = range_next(&it, sh)) >= 0;)
+    {
+        const Cell *cell = &sh->cells[id];
+        if (!cell->counted)
+            continue;
+        g->nset++;
+        if (cell->err != E_OK)
         {
-            double rhs = 0;
-            e = parse_term(p, &rhs);
-            if (e != E_OK)
-                return e;
-            *out -= rhs;
+            g->nerr++;
+            continue;
         }
+        double v = cell->value;
+        g->sum += v;
+        if (g->nok == 0 || v < g->min)
+            g->min = v;
+        if (g->nok == 0 || v > g->max)
+            g->max = v;
+        g->nok++;
+    }
+    g->deltas = 0;
+    g->stale = g->mm_stale = false;
+}
+
+/* One cell of g went from (was, oe, ov) to (now, ne, nv) */
+static void range_update(Range *g, bool was, EvalErr oe, double ov, bool now, EvalErr ne, double nv)
+{
+    if (g->stale)
+        return;
+    if (was)
+    {
+        g->nset--;
+        if (oe != E_OK)
+            g->nerr--;
         else
-            break;
+        {
+            g->nok--;
+            if (!isfinite(ov))
+                g->stale = true;
+            g->sum -= ov;
+            if (ov <= g->min || ov >= g->max)
+                g->mm_stale = true;
+        }
+    }
+    if (now)
+    {
+        g->nset++;
+        if (ne != E_OK)
+            g->nerr++;
+        else
+        {
+            if (!isfinite(nv))
+                g->stale = true;
+            g->sum += nv;
+            if (!g->mm_stale)
+            {
+                if (g->nok == 0 || nv < g->min)
+                    g->min = nv;
+                if (g->nok == 0 || nv > g->max)
+                    g->max = nv;
+            }
+            g->nok++;
+        }
+    }
+    /* rescan to bound rounding drift, no more often than the rescan costs */
+    if (++g->deltas >= RANGE_RESCAN_DELTAS && g->deltas >= g->nset)
+        g->stale = true;
+}
+
+/* First error in row-major order, as a cell-by-cell scan would meet it */
+static EvalErr range_first_err(const Sheet *sh, const Range *g)
+{
+    int best = -1;
+    RangeIter it;
+    range_iter(&it, sh, g);
+    for (int id; (id = range_next(&it, sh)) >= 0;)
+    {
+        const Cell *cell = &sh->cells[id];
+        if (!cell->counted || cell->err == E_OK || cell->err == E_REF)
+            continue;
+        if (best < 0 || cell->row < sh->cells[best].row ||
+            (cell->row == sh->cells[best].row && cell->col < sh->cells[best].col))
+            best = id;
+    }
+    return best < 0 ? E_OK : sh->cells[best].err;
+}
+
+/* Fold range g into aggregate a. Unset cells are zeros, and every cell of
+   the area counts towards AVG's divisor; COUNT counts set cells. */
+static EvalErr range_fold(Sheet *sh, Range *g, Agg *a)
+{
+    if (g->stale || (g->mm_stale && (a->fn == F_MIN || a->fn == F_MAX)))
+        range_rescan(sh, g);
+    if (g->nerr > 0)
+    {
+        EvalErr e = range_first_err(sh, g);
+        if (e != E_OK)
+            return e;
+    }
+    if (a->fn == F_COUNT)
+    {
+        a->count += g->nset;
+        return E_OK;
     }
+    double area = range_area(g);
+    double lo = g->min, hi = g->max;
+    if (g->nok < area)
+    {
+        lo = (g->nok == 0 || lo > 0) ? 0 : lo;
+        hi = (g->nok == 0 || hi < 0) ? 0 : hi;
+    }
+    if (a->fn == F_SUM || a->fn == F_AVG)
+        a->acc += g->sum;
+    else if (a->fn == F_MIN)
+        a->acc = (a->count == 0 || lo < a->acc) ? lo : a->acc;
+    else
+        a->acc = (a->count == 0 || hi > a->acc) ? hi : a->acc;
+    a->count += area;
     return E_OK;
 }
 
 /* ---------- evaluation ---------- */
-static EvalErr eval_formula(Sheet *sh, int r, int c, const char *fml,
-                            double *out, bool visiting[MAX_ROWS][MAX_COLS])
-{
-    Parser p = {.s = fml, .pos = 0, .sh = sh, .visiting = visiting};
-    EvalErr e = parse_expr(&p, out);
-    if (e != E_OK)
-        return e;
-    /* trailing junk? */
-    skip_ws(&p);
-    if (p.s[p.pos])
-        return E_PARSE;
+
+static void fold_value(Agg *a, double v)
+{
+    if (a->fn != F_COUNT)
+    {
+        if (a->count == 0)
+            a->acc = v;
+        else if (a->fn == F_SUM || a->fn == F_AVG)
+            a->acc += v;
+        else if (a->fn == F_MIN)
+            a->acc = (v < a->acc) ? v : a->acc;
+        else if (a->fn == F_MAX)
+            a->acc = (v > a->acc) ? v : a->acc;
+    }
+    a->count += 1;
+}
+
+/* Run a compiled formula. Its precedents are already up to date. */
+static EvalErr run_formula(Sheet *sh, const Op *code, int n, double *out)
+{
+    double *st = sh->vstk;
+    Agg *ag = sh->astk;
+    int sp = 0, ap = 0;
+    for (const Op *o = code, *end = code + n; o < end; o++)
+    {
+        switch ((OpCode)o->op)
+        {
+        case OP_NUM:
+            st[sp++] = o->num;
+            break;
+        case OP_REF:
+        {
+            const Cell *c = &sh->cells[o->arg];
+            if (!c->counted)
+                st[sp++] = 0.0;
+            else if (c->err != E_OK)
+                return c->err;
+            else
+                st[sp++] = c->value;
+            break;
+        }
+        case OP_NEG:
+            st[sp - 1] = -st[sp - 1];
+            break;
+        case OP_ADD:
+            sp--;
+            st[sp - 1] += st[sp];
+            break;
+        case OP_SUB:
+            sp--;
+            st[sp - 1] -= st[sp];
+            break;
+        case OP_MUL:
+            sp--;
+            st[sp - 1] *= st[sp];
+            break;
+        case OP_DIV:
+            sp--;
+            if (st[sp] == 0)
+                return E_DIV0;
+            st[sp - 1] /= st[sp];
+            break;
+        case OP_POW:
+            sp--;
+            st[sp - 1] = pow(st[sp - 1], st[sp]);
+            break;
+        case OP_FN:
+            ag[ap].fn = (FuncId)o->fn;
+            ag[ap].acc = 0.0;
+            ag[ap].count = 0;
+            ap++;
+            break;
+        case OP_ARG:
+            fold_value(&ag[ap - 1], st[--sp]);
+            break;
+        case OP_RANGE:
+        {
+            EvalErr e = range_fold(sh, &sh->ranges[o->arg], &ag[ap - 1]);
+            if (e != E_OK)
+                return e;
+            break;
+        }
+        case OP_ENDFN:
+        {
+            Agg *a = &ag[--ap];
+            if (a->fn == F_AVG)
+            {
+                if (a->count == 0)
+                    return E_DIV0;
+                st[sp++] = a->acc / a->count;
+            }
+            else if (a->fn == F_COUNT)
+                st[sp++] = a->count;
+            else
+                st[sp++] = a->acc;
+            break;
+        }
+        case OP_PARSE:
+            return E_PARSE;
+        }
+    }
+    *out = st[0];
     return E_OK;
 }
 
-static EvalErr eval_cell(Sheet *sh, int r, int c, double *out, bool visiting[MAX_ROWS][MAX_COLS])
+/* ---------- dependency graph ---------- */
+
+/* Dependents of cell x, one per call: formulas referencing it, then owners
+   of ranges covering it. *k is the iterator (start at 0); -1 when done. */
+static int next_dependent(const Sheet *sh, int x, int *k)
 {
-    if (r < 0 || r >= MAX_ROWS || c < 0 || c >= MAX_COLS)
-        return E_REF;
+    const Cell *cell = &sh->cells[x];
+    if (*k < cell->ndeps)
+        return cell->deps[(*k)++];
+    const IdList *l = &sh->colranges[cell->col];
+    while (*k - cell->ndeps < l->n)
+    {
+        const Range *g = &sh->ranges[l->ids[*k - cell->ndeps]];
+        (*k)++;
+        if (g->owner >= 0 && range_has(g, cell->row, cell->col))
+            return g->owner;
+    }
+    return -1;
+}
 
-    Cell *cell = &sh->cells[r][c];
+/* Mark cell id and everything downstream of it for the next recalc() */
+static void mark_dirty(Sheet *sh, int id)
+{
+    if (sh->cells[id].dirty)
+        return;
+    int from = sh->dirty.n;
+    sh->cells[id].dirty = true;
+    ids_push(&sh->dirty, id);
+    for (int i = from; i < sh->dirty.n; i++)
+    {
+        int k = 0, y;
+        while ((y = next_dependent(sh, sh->dirty.ids[i], &k)) >= 0)
+            if (!sh->cells[y].dirty)
+            {
+                sh->cells[y].dirty = true;
+                ids_push(&sh->dirty, y);
+            }
+    }
+}
 
-    if (cell->last_eval_id == sh->eval_pass_id)
+/* Drop a cell's formula and its edges */
+static void forget_formula(Sheet *sh, int id)
+{
+    Cell *cell = &sh->cells[id];
+    for (int i = 0; i < cell->ncode; i++)
     {
-        *out = cell->cached;
-        return cell->last_err;
+        const Op *o = &cell->code[i];
+        if (o->op == OP_REF)
+        {
+            Cell *dep = &sh->cells[o->arg];
+            for (int j = 0; j < dep->ndeps; j++)
+                if (dep->deps[j] == id)
+                {
+                    dep->deps[j] = dep->deps[--dep->ndeps];
+                    break;
+                }
+        }
+        else if (o->op == OP_RANGE)
+            range_free(sh, o->arg);
     }
+    free(cell->code);
+    cell->code = NULL;
+    cell->ncode = 0;
+    free(cell->formula);
+    cell->formula = NULL;
+}
 
+/* Publish a cell's new value, updating the ranges that cover it */
+static void commit(Sheet *sh, int id, bool now, double nv, EvalErr ne)
+{
+    Cell *cell = &sh->cells[id];
+    bool was = cell->counted;
+    double ov = cell->value;
+    EvalErr oe = cell->err;
+    cell->counted = now;
+    cell->value = nv;
+    cell->err = ne;
+    if (was == now && oe == ne && (ov == nv || (isnan(ov) && isnan(nv))))
+        return;
+    const IdList *l = &sh->colranges[cell->col];
+    for (int i = 0; i < l->n; i++)
+    {
+        Range *g = &sh->ranges[l->ids[i]];
+        if (range_has(g, cell->row, cell->col))
+            range_update(g, was, oe, ov, now, ne, nv);
+    }
+}
+
+static void eval_one(Sheet *sh, int id)
+{
+    Cell *cell = &sh->cells[id];
     if (!cell->set)
+        commit(sh, id, false, 0.0, E_OK);
+    else if (cell->formula == NULL)
+        commit(sh, id, true, cell->literal, E_OK);
+    else
     {
-        cell->last_eval_id = sh->eval_pass_id;
-        cell->cached = 0.0;
-        cell->last_err = E_OK;
-        *out = 0.0;
-        return E_OK;
+        double v = NAN;
+        EvalErr e = run_formula(sh, cell->code, cell->ncode, &v);
+        commit(sh, id, true, e == E_OK ? v : NAN, e);
     }
+}
+
+/* Recompute the dirty cells. Tarjan's algorithm over the dependents edges
+   emits strongly connected components downstream-first, so walking its
+   output backwards evaluates every cell after its precedents. Components
+   with more than one cell, or a cell depending on itself, are cycles. */
+static void recalc(Sheet *sh)
+{
+    if (sh->dirty.n == 0)
+        return;
+    IdList *order = &sh->order, *S = &sh->tj_stack, *calls = &sh->call_stack, *iters = &sh->call_iter;
+    order->n = 0;
+    int counter = 0;
+    IdList comp_end = {0}; /* order index just past each component */
 
-    if (visiting[r][c])
+    for (int i = 0; i < sh->dirty.n; i++)
     {
-        cell->last_eval_id = sh->eval_pass_id;
-        cell->last_err = E_CYCLE;
-        cell->cached = NAN;
-        *out = NAN;
-        return E_CYCLE;
+        int root = sh->dirty.ids[i];
+        if (sh->cells[root].tj_index)
+            continue;
+        calls->n = iters->n = 0;
+        ids_push(calls, root);
+        ids_push(iters, 0);
+        sh->cells[root].tj_index = sh->cells[root].tj_low = ++counter;
+        sh->cells[root].tj_on = true;
+        ids_push(S, root);
+        while (calls->n)
+        {
+            int v = calls->ids[calls->n - 1];
+            int w = next_dependent(sh, v, &iters->ids[iters->n - 1]);
+            if (w >= 0)
+            {
+                Cell *cw = &sh->cells[w];
+                if (!cw->tj_index)
+                {
+                    cw->tj_index = cw->tj_low = ++counter;
+                    cw->tj_on = true;
+                    ids_push(S, w);
+                    ids_push(calls, w);
+                    ids_push(iters, 0);
+                }
+                else if (cw->tj_on && cw->tj_index < sh->cells[v].tj_low)
+                    sh->cells[v].tj_low = cw->tj_index;
+                continue;
+            }
+            calls->n--;
+            iters->n--;
+            Cell *cv = &sh->cells[v];
+            if (cv->tj_low == cv->tj_index)
+            {
+                int x;
+                do
+                {
+                    x = S->ids[--S->n];
+                    sh->cells[x].tj_on = false;
+                    ids_push(order, x);
+                } while (x != v);
+                ids_push(&comp_end, order->n);
+            }
+            if (calls->n)
+            {
+                Cell *cp = &sh->cells[calls->ids[calls->n - 1]];
+                if (cv->tj_low < cp->tj_low)
+                    cp->tj_low = cv->tj_low;
+            }
+        }
     }
-    visiting[r][c] = true;
 
-    EvalErr err = E_OK;
-    double val = 0.0;
-    if (cell->formula == NULL)
+    for (int ci = comp_end.n - 1; ci >= 0; ci--)
     {
-        val = cell->literal;
+        int lo = ci ? comp_end.ids[ci - 1] : 0, hi = comp_end.ids[ci];
+        bool cycle = hi - lo > 1;
+        if (!cycle)
+        {
+            int x = order->ids[lo], k = 0, y;
+            while (!cycle && (y = next_dependent(sh, x, &k)) >= 0)
+                cycle = (y == x);
+        }
+        for (int j = lo; j < hi; j++)
+        {
+            if (cycle)
+                commit(sh, order->ids[j], true, NAN, E_CYCLE);
+            else
+                eval_one(sh, order->ids[j]);
+        }
     }
-    else
+    free(comp_end.ids);
+
+    for (int i = 0; i < sh->dirty.n; i++)
     {
-        err = eval_formula(sh, r, c, cell->formula, &val, visiting);
+        Cell *cell = &sh->cells[sh->dirty.ids[i]];
+        cell->dirty = false;
+        cell->tj_index = cell->tj_low = 0;
     }
+    sh->dirty.n = 0;
+}
 
-    visiting[r][c] = false;
-    cell->last_eval_id = sh->eval_pass_id;
-    cell->cached = val;
-    cell->last_err = err;
-    *out = val;
-    return err;
+/* Current value of (r,c); recalc() first */
+static EvalErr cell_value(const Sheet *sh, int r, int c, double *out)
+{
+    int id = cell_find(sh, r, c);
+    if (id < 0 || !sh->cells[id].counted)
+    {
+        *out = 0.0;
+        return E_OK;
+    }
+    *out = sh->cells[id].value;
+    return sh->cells[id].err;
 }
 
 /* ---------- commands ---------- */
 static void print_cell_value(Sheet *sh, int r, int c, char *buf, size_t bufsz)
 {
     double v = 0;
-    bool visiting[MAX_ROWS][MAX_COLS] = {0};
-    sh->eval_pass_id++;
-    EvalErr e = eval_cell(sh, r, c, &v, visiting);
+    EvalErr e = cell_value(sh, r, c, &v);
     if (e == E_OK)
     {
         if (isnan(v) || isinf(v))
@@ -688,6 +1272,7 @@ static void cmd_print(Sheet *sh, int rows, int cols)
     if (cols > MAX_COLS)
         cols = MAX_COLS;
     const int W = 12;
+    recalc(sh);
 
     /* header */
     printf("%*s", W, "");
@@ -712,16 +1297,13 @@ static void cmd_print(Sheet *sh, int rows, int cols)
     }
 }
 
-/* Parse literal vs formula and set cell */
+/* Parse literal vs formula and set cell; dependents recalc on next read */
 static void set_cell(Sheet *sh, int r, int c, const char *rhs)
 {
-    Cell *cell = &sh->cells[r][c];
+    int id = cell_get(sh, r, c);
+    Cell *cell = &sh->cells[id];
     /* free existing */
-    if (cell->formula)
-    {
-        free(cell->formula);
-        cell->formula = NULL;
-    }
+    forget_formula(sh, id);
     cell->literal = 0;
     cell->set = true;
 
@@ -752,21 +1334,35 @@ static void set_cell(Sheet *sh, int r, int c, const char *rhs)
             cell->literal = v;
         }
     }
+    if (cell->formula)
+        compile_formula(sh, id);
+    mark_dirty(sh, id);
+}
+
+static void clear_cell(Sheet *sh, int r, int c)
+{
+    int id = cell_find(sh, r, c);
+    if (id < 0)
+        return;
+    forget_formula(sh, id);
+    sh->cells[id].literal = 0;
+    sh->cells[id].set = false;
+    mark_dirty(sh, id);
 }
 
 /* SHOW A1: print formula and value */
 static void cmd_show(Sheet *sh, int r, int c)
 {
-    Cell *cell = &sh->cells[r][c];
     double v = 0;
-    bool visiting[MAX_ROWS][MAX_COLS] = {0};
-    sh->eval_pass_id++;
-    EvalErr e = eval_cell(sh, r, c, &v, visiting);
+    recalc(sh);
+    EvalErr e = cell_value(sh, r, c, &v);
+    int id = cell_find(sh, r, c);
+    const Cell *cell = (id >= 0) ? &sh->cells[id] : NULL;
 
     char lbl[COL_LABEL_MAX + 1];
     col_to_label(c, lbl);
     printf("[%s%d] ", lbl, r + 1);
-    if (!cell->set)
+    if (!cell || !cell->set)
     {
         printf("(empty)\n");
         return;
@@ -793,13 +1389,7 @@ static void cmd_clear(Sheet *sh, const char *arg)
 {
     if (strcasecmp(arg, "ALL") == 0)
     {
-        for (int r = 0; r < MAX_ROWS; r++)
-            for (int c = 0; c < MAX_COLS; c++)
-            {
-                Cell *cell = &sh->cells[r][c];
-                if (cell->formula)
-                    free(cell->formula);
-            }
+        sheet_free(sh);
         sheet_init(sh);
         printf("Cleared all.\n");
         return;
@@ -810,18 +1400,35 @@ static void cmd_clear(Sheet *sh, const char *arg)
         printf("Bad cell ref.\n");
         return;
     }
-    Cell *cell = &sh->cells[r][c];
-    if (cell->formula)
-    {
-        free(cell->formula);
-        cell->formula = NULL;
-    }
-    cell->literal = 0;
-    cell->set = false;
-    cell->last_eval_id = 0;
+    clear_cell(sh, r, c);
     printf("Cleared.\n");
 }
 
+typedef struct
+{
+    int row, col, id;
+} CellPos;
+
+static int cmp_cell_pos(const void *a, const void *b)
+{
+    const CellPos *x = (const CellPos *)a, *y = (const CellPos *)b;
+    if (x->row != y->row)
+        return (x->row < y->row) ? -1 : 1;
+    return (x->col > y->col) - (x->col < y->col);
+}
+
+/* Set cells in row-major order; caller frees */
+static CellPos *set_cells_sorted(const Sheet *sh, int *n)
+{
+    CellPos *v = (CellPos *)xrealloc(NULL, (size_t)sh->ncells * sizeof(CellPos));
+    *n = 0;
+    for (int i = 0; i < sh->ncells; i++)
+        if (sh->cells[i].set)
+            v[(*n)++] = (CellPos){sh->cells[i].row, sh->cells[i].col, i};
+    qsort(v, (size_t)*n, sizeof(CellPos), cmp_cell_pos);
+    return v;
+}
+
 /* Save with formulas (script of SET commands) */
 static void cmd_savess(Sheet *sh, const char *path)
 {
@@ -831,19 +1438,19 @@ static void cmd_savess(Sheet *sh, const char *path)
         perror("open");
         return;
     }
-    for (int r = 0; r < MAX_ROWS; r++)
-        for (int c = 0; c < MAX_COLS; c++)
-        {
-            Cell *cell = &sh->cells[r][c];
-            if (!cell->set)
-                continue;
-            char lbl[COL_LABEL_MAX + 1];
-            col_to_label(c, lbl);
-            if (cell->formula)
-                fprintf(f, "SET %s%d =%s\n", lbl, r + 1, cell->formula);
-            else
-                fprintf(f, "SET %s%d %.*g\n", lbl, r + 1, 15, cell->literal);
-        }
+    int n;
+    CellPos *pos = set_cells_sorted(sh, &n);
+    for (int i = 0; i < n; i++)
+    {
+        const Cell *cell = &sh->cells[pos[i].id];
+        char lbl[COL_LABEL_MAX + 1];
+        col_to_label(cell->col, lbl);
+        if (cell->formula)
+            fprintf(f, "SET %s%d =%s\n", lbl, cell->row + 1, cell->formula);
+        else
+            fprintf(f, "SET %s%d %.*g\n", lbl, cell->row + 1, 15, cell->literal);
+    }
+    free(pos);
     fclose(f);
     printf("Saved to %s\n", path);
 }
@@ -881,26 +1488,25 @@ static void cmd_savecsv(Sheet *sh, const char *path)
         perror("open");
         return;
     }
-    bool visiting[MAX_ROWS][MAX_COLS] = {0};
-    sh->eval_pass_id++;
+    recalc(sh);
 
-    for (int r = 0; r < MAX_ROWS; r++)
+    /* row-major walk over set cells; each line stops at its last set cell */
+    int n;
+    CellPos *pos = set_cells_sorted(sh, &n);
+    int row = 0, col = 0;
+    for (int i = 0; i < n; i++)
     {
-        bool any = false;
-        for (int c = 0; c < MAX_COLS; c++)
-        {
-            double v = 0;
-            EvalErr e = eval_cell(sh, r, c, &v, visiting);
-            if (any)
-                fprintf(f, ",");
-            if (e == E_OK)
-                fprintf(f, "%.15g", v);
-            else
-                fprintf(f, "");
-            any = true;
-        }
-        fprintf(f, "\n");
+        for (; row < pos[i].row; row++, col = 0)
+            fputc('\n', f);
+        for (; col < pos[i].col; col++)
+            fputc(',', f);
+        double v = 0;
+        if (cell_value(sh, pos[i].row, pos[i].col, &v) == E_OK)
+            fprintf(f, "%.15g", v);
     }
+    if (n > 0)
+        fputc('\n', f);
+    free(pos);
     fclose(f);
     printf("Saved CSV to %s\n", path);
 }
@@ -931,14 +1537,7 @@ static void cmd_loadcsv(Sheet *sh, const char *path)
             }
             else
             {
-                Cell *cell = &sh->cells[r][c];
-                if (cell->formula)
-                {
-                    free(cell->formula);
-                    cell->formula = NULL;
-                }
-                cell->literal = 0;
-                cell->set = false;
+                clear_cell(sh, r, c);
             }
             c++;
             if (!q)
@@ -951,6 +1550,73 @@ static void cmd_loadcsv(Sheet *sh, const char *path)
     printf("Loaded CSV from %s\n", path);
 }
 
+/* ---------- benchmark ---------- */
+static double cpu_sec(void) { return (double)clock() / CLOCKS_PER_SEC; }
+
+/* BENCH [n]: on a scratch sheet, n values in column A, Bi = Ai*2+1, and
+   C1 = SUM(B1:Bn), C2 = MAX(A1:An), C3 = AVG(A1:An). Times the first
+   calculation, a forced full recalculation and single-cell edits, then
+   checks the incrementally maintained totals against a full one. */
+static void cmd_bench(int n)
+{
+    if (n < 1 || n > MAX_ROWS)
+        n = 100000;
+    Sheet b;
+    sheet_init(&b);
+    char rhs[64];
+    double t0 = cpu_sec();
+    for (int i = 0; i < n; i++)
+    {
+        snprintf(rhs, sizeof rhs, "%d", i);
+        set_cell(&b, i, 0, rhs);
+        snprintf(rhs, sizeof rhs, "=A%d*2+1", i + 1);
+        set_cell(&b, i, 1, rhs);
+    }
+    snprintf(rhs, sizeof rhs, "=SUM(B1:B%d)", n);
+    set_cell(&b, 0, 2, rhs);
+    snprintf(rhs, sizeof rhs, "=MAX(A1:A%d)", n);
+    set_cell(&b, 1, 2, rhs);
+    snprintf(rhs, sizeof rhs, "=AVG(A1:A%d)", n);
+    set_cell(&b, 2, 2, rhs);
+    double t_set = cpu_sec() - t0;
+
+    t0 = cpu_sec();
+    recalc(&b);
+    double t_first = cpu_sec() - t0;
+
+    const int edits = 10000;
+    t0 = cpu_sec();
+    for (int k = 0; k < edits; k++)
+    {
+        snprintf(rhs, sizeof rhs, "%d", (k * 37) % 1000);
+        set_cell(&b, (int)(((long long)k * 7919) % n), 0, rhs);
+        recalc(&b);
+    }
+    double t_edit = cpu_sec() - t0;
+    double inc[3];
+    for (int r = 0; r < 3; r++)
+        (void)cell_value(&b, r, 2, &inc[r]);
+
+    t0 = cpu_sec();
+    for (int i = 0; i < b.ncells; i++)
+        mark_dirty(&b, i);
+    for (int i = 0; i < b.nranges; i++)
+        b.ranges[i].stale = true;
+    recalc(&b);
+    double t_full = cpu_sec() - t0;
+    bool same = true;
+    for (int r = 0; r < 3; r++)
+    {
+        double v;
+        (void)cell_value(&b, r, 2, &v);
+        same = same && v == inc[r];
+    }
+
+    printf("cells %d: SET %.1f ms, first calc %.1f ms, full recalc %.1f ms, edit+recalc %.2f us%s\n",
+           b.ncells, t_set * 1e3, t_first * 1e3, t_full * 1e3, t_edit * 1e6 / edits, same ? "" : "  MISMATCH");
+    sheet_free(&b);
+}
+
 /* ---------- REPL ---------- */
 static void help()
 {
@@ -962,6 +1628,7 @@ static void help()
     puts("  CLEAR A1 | CLEAR ALL      clear cell or sheet");
     puts("  SAVESS file.ss / LOADSS file.ss   save/load with formulas");
     puts("  SAVECSV file.csv / LOADCSV file.csv   values only");
+    puts("  BENCH [n]                 time recalculation on a scratch sheet");
     puts("  HELP");
     puts("  QUIT / EXIT");
 }
@@ -1048,6 +1715,11 @@ static void process_line(Sheet *sh, char *line)
         cmd_clear(sh, line + i);
         return;
     }
+    if (strcmp(cmd, "BENCH") == 0)
+    {
+        cmd_bench(line[i] ? atoi(line + i) : 100000);
+        return;
+    }
     if (strcmp(cmd, "SAVESS") == 0)
     {
         if (!line[i])
@@ -1106,5 +1778,6 @@ int main(void)
             break;
         process_line(&sh, line);
     }
+    sheet_free(&sh);
     return 0;
 }
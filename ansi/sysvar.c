@@ -4,11 +4,15 @@
  *
  * Features:
  *  - Hierarchical string keys like "net.ipv4.tcp_syn_retries" (dot-separated)
- *  - In‑memory hash map with pthread RW lock
+ *  - In‑memory hash map: lock-free readers (epoch-based reclamation),
+ *    writers serialized, incremental doubling; zero-copy sv_view()
  *  - Flags (read‑only) and overwrite control
  *  - Simple persistent store: tab‑separated file (key\tvalue\tflags) with
  *    C‑style escapes for tabs/newlines/backslashes
- *  - CLI: list/get/set/unset with optional -f <file>
+ *  - Dot-segment prefix index: sorted sv_list, subtree unset/snapshot/restore
+ *  - Optional shared-memory segment (-m): many processes see one store,
+ *    seqlock reads without syscalls, futex wake-up on change (watch)
+ *  - CLI: list/get/set/unset/dump/watch with optional -f <file>, -m <segment>
  *
  * Build:  gcc -O2 -Wall -pthread sysvar.c -o sysvar
  * Usage:
@@ -16,6 +20,10 @@
  *   ./sysvar get key
  *   ./sysvar list [prefix]
  *   ./sysvar unset key
+ *   ./sysvar unset -p prefix
+ *   ./sysvar dump [prefix]
+ *   ./sysvar -m /dev/shm/sysvar watch [prefix]
+ *   ./sysvar bench [readers] [keys] [ms]
  *
  * Default DB path order: $SYSVAR_DB, then $HOME/.config/sysvar.db
  */
@@ -27,46 +35,156 @@
 ./sysvar set -o net.ipv4.base_hop_limit 128    # overwrite (needs -o)
 ./sysvar list net.ipv4                         # list subtree
 ./sysvar unset some.temp.key                   # remove (fails if #ro)
+./sysvar unset -p net.ipv6.                    # remove a subtree (#ro keys stay)
+./sysvar -m /dev/shm/sysvar watch net.          # print changes as other processes make them
+./sysvar -m /dev/shm/sysvar set -o net.mtu 9000 # watchers wake at once
 #endif
 
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE /* usleep */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdatomic.h>
 #include <errno.h>
 #include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 /* ---------- Flags ---------- */
 #define SV_FLAG_RDONLY (1u << 0)
 
-/* ---------- Hash map ---------- */
+/* ---------- Hash map ----------
+ * Readers take no lock: they run inside sv_read_begin()/sv_read_end()
+ * (sv_get does so itself) and follow atomic links. Writers are serialized
+ * by g_store.lock and never change what a reader may be looking at:
+ * a new value is a new SVVal swapped in, a removed key is unlinked, and
+ * the old memory is retired until every reader that might hold it has
+ * left its read section (epoch-based reclamation).
+ *
+ * The bucket array doubles when count exceeds it. The new table is
+ * filled SV_MIGRATE_STEP old buckets per write, linking nodes through
+ * the node's other next[] slot, so the table readers search stays intact
+ * until the new one is complete and published.
+ */
 #ifndef SV_BUCKETS
-#define SV_BUCKETS 1024
+#define SV_BUCKETS 1024 /* initial size, a power of two */
 #endif
+#define SV_MIGRATE_STEP 64
+
+typedef struct SVVal
+{
+    uint64_t version; /* store generation of the write that made it */
+    unsigned flags;
+    size_t len;
+    char str[];
+} SVVal;
 
 typedef struct SVVar
 {
     char *key;
-    char *val;
-    unsigned flags;
-    struct SVVar *next;
+    unsigned long hash;
+    _Atomic(SVVal *) val;
+    _Atomic(struct SVVar *) next[2]; /* chain link, next[table->parity] */
+    struct SVNode *node;             /* its place in the prefix index */
 } SVVar;
 
+typedef struct SVTable
+{
+    size_t mask;
+    int parity;
+    _Atomic(SVVar *) b[];
+} SVTable;
+
+/* ---------- Prefix index ----------
+ * A trie over dot-separated segments holds every SVVar the hash holds,
+ * so prefix operations visit only the matching subtree, in segment order
+ * ("a", "a.b", "a.c", "a-b"). A node's children form a skip list sorted by
+ * segment. Readers walk it lock-free like the hash; the writer links a new
+ * node bottom-up and unlinks top-down, and removed nodes are retired.
+ */
+#define SV_SKIP 10 /* levels; a quarter of the nodes reach each next level */
+
+typedef struct SVNode
+{
+    char *seg;
+    _Atomic(struct SVVar *) var;        /* key ending at this node, or NULL */
+    _Atomic(struct SVNode *) kids[SV_SKIP]; /* first child at each level */
+    struct SVNode *parent;              /* writers only */
+    size_t nkids;                       /* writers only */
+    int height;
+    _Atomic(struct SVNode *) sib[]; /* next sibling at levels 0..height-1 */
+} SVNode;
+
+/* memory unlinked by a writer, freed once no reader can see it */
+typedef struct SVRetired
+{
+    struct SVRetired *next;
+    uint64_t epoch;
+    void *p;
+    void (*fn)(void *);
+} SVRetired;
+
+/* one per reading thread, on its own cache line */
+typedef struct SVReader
+{
+    _Atomic uint64_t epoch; /* global epoch on entry; 0 outside a read section */
+    unsigned depth;
+    bool used;
+    struct SVReader *next;
+} __attribute__((aligned(64))) SVReader;
+
 typedef struct
 {
-    SVVar *buckets[SV_BUCKETS];
-    pthread_rwlock_t lock;
-    char *db_path; /* nullable until set */
+    _Atomic(SVTable *) table; /* the complete table readers search */
+    SVTable *grow;            /* being filled, or NULL */
+    size_t grow_pos;          /* old buckets already linked into grow */
+    bool old_pending;         /* the table before this one is not freed yet */
+    pthread_mutex_t lock;     /* writers */
+    char *db_path;            /* nullable until set */
     size_t count;
+    _Atomic uint64_t generation; /* bumped by every change */
+    _Atomic uint64_t epoch;
+    SVRetired *retired;
+    _Atomic(SVReader *) readers;
+    pthread_mutex_t readers_lock;
 } SVStore;
 
-static SVStore g_store = {.buckets = {NULL}, .lock = PTHREAD_RWLOCK_INITIALIZER, .db_path = NULL, .count = 0};
+static SVStore g_store = {.lock = PTHREAD_MUTEX_INITIALIZER, .readers_lock = PTHREAD_MUTEX_INITIALIZER, .epoch = 1};
+
+/* Zero-copy read: valid until the enclosing sv_read_end() */
+typedef struct
+{
+    const char *val;
+    size_t len;
+    unsigned flags;
+    uint64_t version; /* changes whenever the key is set again */
+} SVView;
+
+/* Copy of a subtree (sv_snapshot) */
+typedef struct
+{
+    char *key, *val;
+    unsigned flags;
+} SVEntry;
+
+typedef struct
+{
+    char *prefix;
+    uint64_t generation; /* sv_generation() when taken */
+    size_t n, cap;
+    SVEntry *e; /* in key order */
+} SVSnapshot;
 
 /* ---------- Utilities ---------- */
 static unsigned long djb2(const char *s)
@@ -221,72 +339,1175 @@ static char *unescape_value(const char *v)
     return out;
 }
 
-/* ---------- Core store ops (internal; lock must be held) ---------- */
-static SVVar *sv_find_locked(const char *key, unsigned long *out_idx)
+static inline const SVVal *sv_var_val(const SVVar *v) { return atomic_load_explicit(&v->val, memory_order_acquire); }
+
+/* ---------- Read sections (epoch-based) ---------- */
+static pthread_key_t g_reader_key;
+static pthread_once_t g_reader_once = PTHREAD_ONCE_INIT;
+static __thread SVReader *t_reader;
+
+static void sv_reader_exit(void *p)
+{
+    SVReader *r = p;
+    pthread_mutex_lock(&g_store.readers_lock);
+    atomic_store_explicit(&r->epoch, 0, memory_order_release);
+    r->depth = 0;
+    r->used = false;
+    pthread_mutex_unlock(&g_store.readers_lock);
+}
+
+static void sv_reader_key_init(void) { pthread_key_create(&g_reader_key, sv_reader_exit); }
+
+static SVReader *sv_reader(void)
 {
-    unsigned long idx = djb2(key) % SV_BUCKETS;
-    if (out_idx)
-        *out_idx = idx;
-    SVVar *v = g_store.buckets[idx];
-    while (v)
+    if (t_reader)
+        return t_reader;
+    pthread_once(&g_reader_once, sv_reader_key_init);
+    pthread_mutex_lock(&g_store.readers_lock);
+    SVReader *r = atomic_load_explicit(&g_store.readers, memory_order_relaxed);
+    while (r && r->used)
+        r = r->next;
+    if (!r)
     {
-        if (strcmp(v->key, key) == 0)
-            return v;
-        v = v->next;
+        void *mem;
+        if (posix_memalign(&mem, 64, sizeof(SVReader)) != 0)
+        {
+            perror("posix_memalign");
+            exit(1);
+        }
+        r = memset(mem, 0, sizeof(SVReader));
+        r->next = atomic_load_explicit(&g_store.readers, memory_order_relaxed);
+        atomic_store_explicit(&g_store.readers, r, memory_order_release);
+    }
+    r->used = true;
+    pthread_mutex_unlock(&g_store.readers_lock);
+    pthread_setspecific(g_reader_key, r);
+    t_reader = r;
+    return r;
+}
+
+/* Sections nest. Keep them short: memory retired meanwhile waits for them. */
+void sv_read_begin(void)
+{
+    SVReader *r = sv_reader();
+    if (r->depth++ == 0)
+    {
+        atomic_store_explicit(&r->epoch, atomic_load_explicit(&g_store.epoch, memory_order_acquire),
+                              memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst); /* publish the epoch before reading any link */
+    }
+}
+
+void sv_read_end(void)
+{
+    SVReader *r = t_reader;
+    if (r && r->depth && --r->depth == 0)
+        atomic_store_explicit(&r->epoch, 0, memory_order_release);
+}
+
+/* lock held */
+static void sv_retire(void *p, void (*fn)(void *))
+{
+    SVRetired *d = xmalloc(sizeof(*d));
+    d->p = p;
+    d->fn = fn;
+    d->epoch = atomic_load_explicit(&g_store.epoch, memory_order_relaxed);
+    d->next = g_store.retired;
+    g_store.retired = d;
+}
+
+/* lock held: advance the epoch, free what no reader can still reach */
+static void sv_reclaim(void)
+{
+    if (!g_store.retired)
+        return;
+    atomic_fetch_add_explicit(&g_store.epoch, 1, memory_order_seq_cst);
+    uint64_t oldest = UINT64_MAX;
+    for (SVReader *r = atomic_load_explicit(&g_store.readers, memory_order_acquire); r; r = r->next)
+    {
+        uint64_t e = atomic_load_explicit(&r->epoch, memory_order_acquire);
+        if (e && e < oldest)
+            oldest = e;
+    }
+    for (SVRetired **pp = &g_store.retired; *pp;)
+    {
+        SVRetired *d = *pp;
+        if (d->epoch < oldest)
+        {
+            *pp = d->next;
+            d->fn(d->p);
+            free(d);
+        }
+        else
+            pp = &d->next;
+    }
+}
+
+static void sv_var_free(void *p)
+{
+    SVVar *v = p;
+    free(atomic_load_explicit(&v->val, memory_order_relaxed));
+    free(v->key);
+    free(v);
+}
+
+static void sv_table_free(void *p)
+{
+    free(p);
+    g_store.old_pending = false; /* its parity may be reused */
+}
+
+/* ---------- Core store ops ---------- */
+static unsigned long sv_hash(const char *key)
+{
+    unsigned long h = djb2(key);
+    return h ^ (h >> 15) ^ (h >> 31); /* fold the high bits into the bucket index */
+}
+
+static SVTable *sv_table_new(size_t nbuckets, int parity)
+{
+    SVTable *t = xmalloc(sizeof(*t) + nbuckets * sizeof(t->b[0]));
+    t->mask = nbuckets - 1;
+    t->parity = parity;
+    for (size_t i = 0; i < nbuckets; i++)
+        atomic_init(&t->b[i], NULL);
+    return t;
+}
+
+/* lock held */
+static SVTable *sv_table_locked(void)
+{
+    SVTable *t = atomic_load_explicit(&g_store.table, memory_order_relaxed);
+    if (!t)
+    {
+        t = sv_table_new(SV_BUCKETS, 0);
+        atomic_store_explicit(&g_store.table, t, memory_order_release);
     }
+    return t;
+}
+
+static SVTable *sv_table(void)
+{
+    SVTable *t = atomic_load_explicit(&g_store.table, memory_order_acquire);
+    if (t)
+        return t;
+    pthread_mutex_lock(&g_store.lock);
+    t = sv_table_locked();
+    pthread_mutex_unlock(&g_store.lock);
+    return t;
+}
+
+/* t from sv_table() in a read section, or from sv_table_locked() */
+static SVVar *sv_find(const SVTable *t, const char *key)
+{
+    unsigned long h = sv_hash(key);
+    for (SVVar *v = atomic_load_explicit(&t->b[h & t->mask], memory_order_acquire); v;
+         v = atomic_load_explicit(&v->next[t->parity], memory_order_acquire))
+        if (v->hash == h && strcmp(v->key, key) == 0)
+            return v;
     return NULL;
 }
 
+static void sv_link(SVTable *t, SVVar *v)
+{
+    _Atomic(SVVar *) *head = &t->b[v->hash & t->mask];
+    atomic_store_explicit(&v->next[t->parity], atomic_load_explicit(head, memory_order_relaxed), memory_order_relaxed);
+    atomic_store_explicit(head, v, memory_order_release);
+}
+
+static void sv_unlink(SVTable *t, SVVar *v)
+{
+    _Atomic(SVVar *) *pp = &t->b[v->hash & t->mask];
+    for (SVVar *cur; (cur = atomic_load_explicit(pp, memory_order_relaxed));)
+    {
+        if (cur == v)
+        {
+            atomic_store_explicit(pp, atomic_load_explicit(&v->next[t->parity], memory_order_relaxed),
+                                  memory_order_release);
+            return;
+        }
+        pp = &cur->next[t->parity];
+    }
+}
+
+/* lock held: start or continue doubling the table */
+static void sv_grow_step(void)
+{
+    SVTable *t = atomic_load_explicit(&g_store.table, memory_order_relaxed);
+    if (!g_store.grow)
+    {
+        if (g_store.count <= t->mask + 1 || g_store.old_pending)
+            return;
+        g_store.grow = sv_table_new((t->mask + 1) * 2, !t->parity);
+        g_store.grow_pos = 0;
+    }
+    for (int i = 0; i < SV_MIGRATE_STEP && g_store.grow_pos <= t->mask; i++, g_store.grow_pos++)
+        for (SVVar *v = atomic_load_explicit(&t->b[g_store.grow_pos], memory_order_relaxed); v;
+             v = atomic_load_explicit(&v->next[t->parity], memory_order_relaxed))
+            sv_link(g_store.grow, v);
+    if (g_store.grow_pos > t->mask)
+    {
+        atomic_store_explicit(&g_store.table, g_store.grow, memory_order_release);
+        g_store.grow = NULL;
+        g_store.old_pending = true;
+        sv_retire(t, sv_table_free);
+    }
+}
+
+/* lock held: the write is done; bump the generation and tidy up */
+static void sv_changed(void)
+{
+    atomic_fetch_add_explicit(&g_store.generation, 1, memory_order_release);
+    sv_grow_step();
+    sv_reclaim();
+}
+
+static SVVal *sv_val_new(const char *val, unsigned flags)
+{
+    size_t len = strlen(val);
+    SVVal *s = xmalloc(sizeof(*s) + len + 1);
+    s->version = atomic_load_explicit(&g_store.generation, memory_order_relaxed) + 1;
+    s->flags = flags;
+    s->len = len;
+    memcpy(s->str, val, len + 1);
+    return s;
+}
+
+/* ---------- Prefix index ops ---------- */
+static SVNode g_root; /* seg NULL; holds no key */
+
+static void sv_node_free(void *p)
+{
+    SVNode *n = p;
+    free(n->seg);
+    free(n);
+}
+
+/* First child of n whose segment is not below s[0..len); the children that
+   start with it follow on level 0. pred (writers) gets the link to patch
+   at each level. */
+static SVNode *sv_kid_seek(SVNode *n, const char *s, size_t len, _Atomic(SVNode *) **pred)
+{
+    _Atomic(SVNode *) *links = n->kids;
+    SVNode *next = NULL;
+    for (int l = SV_SKIP - 1; l >= 0; l--)
+    {
+        while ((next = atomic_load_explicit(&links[l], memory_order_acquire)) && strncmp(next->seg, s, len) < 0)
+            links = next->sib;
+        if (pred)
+            pred[l] = &links[l];
+    }
+    return next;
+}
+
+static SVNode *sv_kid_next(const SVNode *c) { return atomic_load_explicit(&c->sib[0], memory_order_acquire); }
+
+/* child with segment exactly s[0..len) */
+static SVNode *sv_child(SVNode *n, const char *s, size_t len)
+{
+    SVNode *c = sv_kid_seek(n, s, len, NULL);
+    return (c && strncmp(c->seg, s, len) == 0 && c->seg[len] == '\0') ? c : NULL;
+}
+
+/* lock held: the node for key, created along the way */
+static SVNode *sv_node_get(const char *key)
+{
+    static uint32_t rnd = 2463534242u;
+    SVNode *n = &g_root;
+    for (const char *p = key;;)
+    {
+        const char *dot = strchr(p, '.');
+        size_t len = dot ? (size_t)(dot - p) : strlen(p);
+        _Atomic(SVNode *) *pred[SV_SKIP];
+        SVNode *c = sv_kid_seek(n, p, len, pred);
+        if (!c || strncmp(c->seg, p, len) != 0 || c->seg[len] != '\0')
+        {
+            int h = 1;
+            rnd ^= rnd << 13;
+            rnd ^= rnd >> 17;
+            rnd ^= rnd << 5;
+            for (uint32_t r = rnd; h < SV_SKIP && (r & 3) == 0; r >>= 2)
+                h++;
+            c = xmalloc(sizeof(*c) + (size_t)h * sizeof(c->sib[0]));
+            c->seg = xmalloc(len + 1);
+            memcpy(c->seg, p, len);
+            c->seg[len] = '\0';
+            atomic_init(&c->var, NULL);
+            for (int l = 0; l < SV_SKIP; l++)
+                atomic_init(&c->kids[l], NULL);
+            c->parent = n;
+            c->nkids = 0;
+            c->height = h;
+            /* pred[] was found with the prefix compare; c sorts before every child that starts with it */
+            for (int l = 0; l < h; l++)
+                atomic_init(&c->sib[l], atomic_load_explicit(pred[l], memory_order_relaxed));
+            for (int l = 0; l < h; l++)
+                atomic_store_explicit(pred[l], c, memory_order_release);
+            n->nkids++;
+        }
+        n = c;
+        if (!dot)
+            return n;
+        p = dot + 1;
+    }
+}
+
+/* lock held: the key of n is gone; drop n and any ancestors left empty */
+static void sv_node_prune(SVNode *n)
+{
+    while (n != &g_root && !atomic_load_explicit(&n->var, memory_order_relaxed) && !n->nkids)
+    {
+        SVNode *p = n->parent;
+        _Atomic(SVNode *) *pred[SV_SKIP];
+        sv_kid_seek(p, n->seg, strlen(n->seg) + 1, pred);
+        for (int l = n->height - 1; l >= 0; l--)
+            atomic_store_explicit(pred[l], atomic_load_explicit(&n->sib[l], memory_order_relaxed),
+                                  memory_order_release);
+        p->nkids--;
+        sv_retire(n, sv_node_free);
+        n = p;
+    }
+}
+
+/* lock held: retire every node below n (the caller unlinks them) */
+static void sv_node_retire_kids(SVNode *n)
+{
+    for (SVNode *c = atomic_load_explicit(&n->kids[0], memory_order_relaxed), *next; c; c = next)
+    {
+        next = atomic_load_explicit(&c->sib[0], memory_order_relaxed);
+        sv_node_retire_kids(c);
+        sv_retire(c, sv_node_free);
+    }
+}
+
+/* Pre-order walk of the keys starting with prefix; stops when fn returns nonzero.
+   In a read section, or lock held without writing until it returns. */
+typedef int (*sv_visit_fn)(SVVar *v, void *ctx);
+
+static int sv_walk_node(const SVNode *n, sv_visit_fn fn, void *ctx)
+{
+    SVVar *v = atomic_load_explicit(&n->var, memory_order_acquire);
+    if (v && fn(v, ctx))
+        return 1;
+    for (const SVNode *c = atomic_load_explicit(&n->kids[0], memory_order_acquire); c; c = sv_kid_next(c))
+        if (sv_walk_node(c, fn, ctx))
+            return 1;
+    return 0;
+}
+
+static void sv_walk(const char *prefix, sv_visit_fn fn, void *ctx)
+{
+    SVNode *n = &g_root;
+    const char *p = prefix ? prefix : "";
+    const char *dot;
+    /* whole segments first, then every child starting with the partial last one */
+    while ((dot = strchr(p, '.')))
+    {
+        if (!(n = sv_child(n, p, (size_t)(dot - p))))
+            return;
+        p = dot + 1;
+    }
+    size_t len = strlen(p);
+    for (SVNode *c = sv_kid_seek(n, p, len, NULL); c && strncmp(c->seg, p, len) == 0; c = sv_kid_next(c))
+        if (sv_walk_node(c, fn, ctx))
+            return;
+}
+
+typedef struct
+{
+    SVVar **v;
+    size_t n, cap;
+} SVVec;
+
+static int sv_collect(SVVar *v, void *ctx)
+{
+    SVVec *vec = ctx;
+    if (vec->n == vec->cap)
+    {
+        vec->cap = vec->cap ? vec->cap * 2 : 64;
+        vec->v = realloc(vec->v, vec->cap * sizeof(*vec->v));
+        if (!vec->v)
+        {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    vec->v[vec->n++] = v;
+    return 0;
+}
+
 static int sv_set_locked(const char *key, const char *val, unsigned flags, bool overwrite)
 {
-    unsigned long idx;
-    SVVar *v = sv_find_locked(key, &idx);
+    SVTable *t = sv_table_locked();
+    SVVar *v = sv_find(t, key);
     if (v)
     {
-        if ((v->flags & SV_FLAG_RDONLY) && !overwrite)
+        SVVal *old = atomic_load_explicit(&v->val, memory_order_relaxed);
+        if ((old->flags & SV_FLAG_RDONLY) && !overwrite)
             return -2; /* read-only */
         if (!overwrite)
             return -1; /* exists and overwrite not allowed */
         /* Overwrite allowed */
-        free(v->val);
-        v->val = xstrdup(val);
-        v->flags = (v->flags & SV_FLAG_RDONLY) | (flags & SV_FLAG_RDONLY); /* preserve RO if already RO unless explicitly set again */
+        unsigned nf = (old->flags & SV_FLAG_RDONLY) | (flags & SV_FLAG_RDONLY); /* preserve RO if already RO unless explicitly set again */
+        atomic_store_explicit(&v->val, sv_val_new(val, nf), memory_order_release);
+        sv_retire(old, free);
+        sv_changed();
         return 0;
     }
     v = xmalloc(sizeof(*v));
     v->key = xstrdup(key);
-    v->val = xstrdup(val);
-    v->flags = flags;
-    v->next = g_store.buckets[idx];
-    g_store.buckets[idx] = v;
+    v->hash = sv_hash(key);
+    atomic_init(&v->val, sv_val_new(val, flags));
+    v->node = sv_node_get(key);
+    atomic_store_explicit(&v->node->var, v, memory_order_release);
+    sv_link(t, v);
+    if (g_store.grow && (v->hash & t->mask) < g_store.grow_pos)
+        sv_link(g_store.grow, v); /* its bucket was migrated already */
     g_store.count++;
+    sv_changed();
     return 0;
 }
 
+/* lock held: take v out of the hash and the index */
+static void sv_remove_locked(SVTable *t, SVVar *v)
+{
+    sv_unlink(t, v);
+    if (g_store.grow && (v->hash & t->mask) < g_store.grow_pos)
+        sv_unlink(g_store.grow, v);
+    atomic_store_explicit(&v->node->var, NULL, memory_order_release);
+    sv_node_prune(v->node);
+    sv_retire(v, sv_var_free);
+    g_store.count--;
+}
+
 static int sv_unset_locked(const char *key)
 {
-    unsigned long idx = djb2(key) % SV_BUCKETS;
-    SVVar *prev = NULL, *cur = g_store.buckets[idx];
-    while (cur)
+    SVTable *t = sv_table_locked();
+    SVVar *v = sv_find(t, key);
+    if (!v)
+        return -1; /* not found */
+    if (atomic_load_explicit(&v->val, memory_order_relaxed)->flags & SV_FLAG_RDONLY)
+        return -2;
+    sv_remove_locked(t, v);
+    sv_changed();
+    return 0;
+}
+
+/* lock held: unset every writable key starting with prefix; returns how many */
+static size_t sv_unset_tree_locked(const char *prefix)
+{
+    SVTable *t = sv_table_locked();
+    SVVec vec = {0};
+    sv_walk(prefix, sv_collect, &vec); /* collect first: removal rewrites the child arrays */
+    size_t n = 0;
+    for (size_t i = 0; i < vec.n; i++)
+        if (!(atomic_load_explicit(&vec.v[i]->val, memory_order_relaxed)->flags & SV_FLAG_RDONLY))
+        {
+            sv_remove_locked(t, vec.v[i]);
+            n++;
+        }
+    free(vec.v);
+    if (n)
+        sv_changed();
+    return n;
+}
+
+/* lock held: drop every key (the table keeps its size) */
+static void sv_clear_locked(void)
+{
+    SVTable *t = sv_table_locked();
+    free(g_store.grow); /* never published */
+    g_store.grow = NULL;
+    for (size_t i = 0; i <= t->mask; i++)
     {
-        if (strcmp(cur->key, key) == 0)
+        SVVar *v = atomic_exchange_explicit(&t->b[i], NULL, memory_order_release);
+        while (v)
         {
-            if (cur->flags & SV_FLAG_RDONLY)
-                return -2;
-            if (prev)
-                prev->next = cur->next;
-            else
-                g_store.buckets[idx] = cur->next;
-            free(cur->key);
-            free(cur->val);
-            free(cur);
-            g_store.count--;
-            return 0;
+            SVVar *n = atomic_load_explicit(&v->next[t->parity], memory_order_relaxed);
+            sv_retire(v, sv_var_free);
+            v = n;
+        }
+    }
+    sv_node_retire_kids(&g_root);
+    for (int l = 0; l < SV_SKIP; l++)
+        atomic_store_explicit(&g_root.kids[l], NULL, memory_order_release);
+    g_root.nkids = 0;
+    g_store.count = 0;
+    sv_changed();
+}
+
+/* ---------- Shared segment ----------
+ * sv_shm_attach() moves the store into a file mmap'd by every process
+ * (e.g. /dev/shm/sysvar). Layout: SVShmHdr, nslots SVShmSlot (open
+ * addressing, linear probing), then a heap of 8-byte words holding
+ * "key\0value\0" blocks.
+ *
+ * Each slot is a seqlock: the writer makes seq odd, rewrites the slot and
+ * stores it even again; a reader copies the slot and its heap block and
+ * retries if seq moved. sv_get and sv_shm_read do no syscall and take no
+ * lock. Writers (any process) hold a record lock on the segment plus g_shm.lock,
+ * append a new block for every value, and slide live blocks down in place
+ * when the heap fills, each move under its slot's seqlock.
+ *
+ * hdr->gen is bumped after every change and doubles as a futex word:
+ * sv_shm_wait() sleeps on it, sv_shm_watch_fd() turns it into an eventfd.
+ * The local hash and prefix index become a cache of the segment, brought
+ * up to date (changed slots only) by sv_view, sv_list and friends when
+ * gen has moved.
+ */
+#define SV_SHM_MAGIC 0x48535653u /* 'SVSH' */
+#define SV_SHM_VERSION 1
+#define SV_SHM_SLOTS 65536
+#define SV_SHM_HEAP (16u << 20)
+#define SV_SHM_MAXKEY 1023
+#define SV_SHM_LOG 1024 /* recent slot writes, so a sync need not scan every slot */
+#define SV_SHM_HDR ((sizeof(SVShmHdr) + 63) & ~(size_t)63) /* slots start here */
+
+enum
+{
+    SV_SLOT_EMPTY = 0,
+    SV_SLOT_LIVE = 1,
+    SV_SLOT_DEAD = 2 /* tombstone: probing goes on past it */
+};
+
+typedef struct
+{
+    uint32_t magic, version;
+    uint32_t nslots; /* power of two */
+    uint32_t live, dead;
+    uint32_t writing; /* slot + 1 while a writer has it odd: repaired after a crash */
+    uint64_t heap_size, heap_used, heap_dead;
+    _Atomic uint32_t gen;     /* futex word */
+    _Atomic uint32_t waiters; /* processes in sv_shm_wait: writers skip FUTEX_WAKE without them */
+    _Atomic uint32_t logpos;  /* slot writes so far; log[pos % SV_SHM_LOG] = slot */
+    _Atomic uint32_t log[SV_SHM_LOG];
+} SVShmHdr;
+
+typedef struct
+{
+    _Atomic uint32_t seq; /* odd while being written */
+    _Atomic uint32_t state;
+    _Atomic uint32_t hash;
+    _Atomic uint32_t flags;
+    _Atomic uint32_t klen;
+    _Atomic uint32_t vlen;
+    _Atomic uint64_t off; /* heap byte offset of the block */
+} SVShmSlot;
+
+typedef void (*sv_change_fn)(const char *key, const char *val, void *ctx); /* val NULL: unset */
+
+static struct
+{
+    SVShmHdr *hdr;
+    SVShmSlot *slot;
+    _Atomic uint64_t *heap;
+    size_t map_len;
+    int fd;
+    pthread_mutex_t lock;         /* writers of this process; flock orders processes */
+    _Atomic uint32_t synced_gen;  /* hdr->gen the local cache reflects */
+    uint32_t synced_log;          /* hdr->logpos at that point */
+    uint32_t *seen_seq;           /* per slot, as last copied into the local store */
+    char **seen_key;
+} g_shm = {.fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+static size_t sv_round8(size_t n) { return (n + 7) & ~(size_t)7; }
+/* a heap block holds the key, NUL, padding to a word, then the value and NUL */
+static size_t shm_block(size_t klen, size_t vlen) { return sv_round8(klen + 1) + sv_round8(vlen + 1); }
+
+static void shm_put(uint64_t off, const char *src, size_t n)
+{
+    _Atomic uint64_t *w = g_shm.heap + off / 8;
+    for (size_t i = 0; i < n; i += 8)
+    {
+        uint64_t x = 0;
+        memcpy(&x, src + i, n - i < 8 ? n - i : 8);
+        atomic_store_explicit(&w[i / 8], x, memory_order_relaxed);
+    }
+}
+
+static void shm_copy(uint64_t off, char *dst, size_t n)
+{
+    const _Atomic uint64_t *w = g_shm.heap + off / 8;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t x = atomic_load_explicit(&w[i / 8], memory_order_relaxed);
+        memcpy(dst + i, &x, 8);
+    }
+    if (i < n)
+    {
+        uint64_t x = atomic_load_explicit(&w[i / 8], memory_order_relaxed);
+        memcpy(dst + i, &x, n - i);
+    }
+}
+
+/* one consistent copy of slot i; key gets klen bytes (<= SV_SHM_MAXKEY), val up to cap */
+typedef struct
+{
+    uint32_t seq, state, hash, flags, klen, vlen;
+    uint64_t off;
+} SVSlotCopy;
+
+static void shm_read_slot(uint32_t i, SVSlotCopy *c, char *key, char *val, size_t cap)
+{
+    SVShmSlot *s = &g_shm.slot[i];
+    for (unsigned spins = 0;; spins++)
+    {
+        c->seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (c->seq & 1)
+        {
+            if (spins > 64)
+                sched_yield();
+            continue;
+        }
+        c->state = atomic_load_explicit(&s->state, memory_order_relaxed);
+        c->hash = atomic_load_explicit(&s->hash, memory_order_relaxed);
+        c->flags = atomic_load_explicit(&s->flags, memory_order_relaxed);
+        c->klen = atomic_load_explicit(&s->klen, memory_order_relaxed);
+        c->vlen = atomic_load_explicit(&s->vlen, memory_order_relaxed);
+        c->off = atomic_load_explicit(&s->off, memory_order_relaxed);
+        /* fields may be torn until seq is checked: bound them before touching the heap */
+        bool sane = c->state != SV_SLOT_LIVE ||
+                    (c->klen <= SV_SHM_MAXKEY && c->off % 8 == 0 &&
+                     c->off + shm_block(c->klen, c->vlen) <= g_shm.hdr->heap_size);
+        if (sane && c->state == SV_SLOT_LIVE)
+        {
+            if (key)
+                shm_copy(c->off, key, c->klen);
+            if (val)
+                shm_copy(c->off + sv_round8((size_t)c->klen + 1), val, c->vlen < cap ? c->vlen : cap);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s->seq, memory_order_relaxed) == c->seq && sane)
+            return;
+    }
+}
+
+/* Slot holding key, or -1; the value (truncated to cap) goes to val. */
+static long shm_lookup(const char *key, char *val, size_t cap, SVSlotCopy *c)
+{
+    size_t klen = strlen(key);
+    if (klen > SV_SHM_MAXKEY)
+        return -1;
+    uint32_t h = (uint32_t)sv_hash(key), mask = g_shm.hdr->nslots - 1;
+    char kbuf[SV_SHM_MAXKEY + 1];
+    for (uint32_t n = 0, i = h & mask; n <= mask; n++, i = (i + 1) & mask)
+    {
+        SVShmSlot *s = &g_shm.slot[i];
+        if (atomic_load_explicit(&s->state, memory_order_relaxed) == SV_SLOT_EMPTY &&
+            !(atomic_load_explicit(&s->seq, memory_order_acquire) & 1))
+            return -1; /* never used: the key is not further along */
+        if (atomic_load_explicit(&s->hash, memory_order_relaxed) != h)
+            continue; /* a stale hash can only make us look closer, below */
+        shm_read_slot(i, c, kbuf, NULL, 0);
+        if (c->state == SV_SLOT_EMPTY)
+            return -1;
+        if (c->state != SV_SLOT_LIVE || c->hash != h || c->klen != klen || memcmp(kbuf, key, klen) != 0)
+            continue;
+        if (!val)
+            return (long)i;
+        shm_read_slot(i, c, kbuf, val, cap);
+        if (c->state == SV_SLOT_LIVE && c->klen == klen && memcmp(kbuf, key, klen) == 0)
+            return (long)i;
+        i = (i - 1) & mask; /* rewritten between the copies: look again */
+        n--;
+    }
+    return -1;
+}
+
+/* Lock-free, syscall-free read into buf. Returns the value length (may exceed cap;
+   buf then holds a prefix, unterminated), -1 if unset. Needs sv_shm_attach. */
+long sv_shm_read(const char *key, char *buf, size_t cap, unsigned *out_flags)
+{
+    SVSlotCopy c;
+    if (!g_shm.hdr || shm_lookup(key, buf, cap, &c) < 0)
+        return -1;
+    if (c.vlen < cap)
+        buf[c.vlen] = '\0';
+    if (out_flags)
+        *out_flags = c.flags;
+    return (long)c.vlen;
+}
+
+/* ---- writers: g_shm.lock and the file lock held ---- */
+/* a POSIX record lock: owned per process, so a child forked after attaching still has to wait
+   (flock would be shared through the inherited descriptor); threads are ordered by g_shm.lock */
+static void shm_file_lock(int fd, short type)
+{
+    struct flock fl = {.l_type = type, .l_whence = SEEK_SET, .l_start = 0, .l_len = 1};
+    while (fcntl(fd, F_SETLKW, &fl) != 0 && errno == EINTR)
+        ;
+}
+
+static void shm_lock(void)
+{
+    pthread_mutex_lock(&g_shm.lock);
+    shm_file_lock(g_shm.fd, F_WRLCK);
+    SVShmHdr *h = g_shm.hdr;
+    if (h->writing)
+    {
+        /* the last writer died inside a slot update: retire the slot */
+        SVShmSlot *s = &g_shm.slot[h->writing - 1];
+        uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+        if (seq & 1)
+        {
+            atomic_store_explicit(&s->state, SV_SLOT_DEAD, memory_order_relaxed);
+            atomic_store_explicit(&s->seq, seq + 1, memory_order_release);
+        }
+        h->live = h->dead = 0;
+        for (uint32_t i = 0; i < h->nslots; i++)
+        {
+            uint32_t st = atomic_load_explicit(&g_shm.slot[i].state, memory_order_relaxed);
+            h->live += st == SV_SLOT_LIVE;
+            h->dead += st == SV_SLOT_DEAD;
+        }
+        h->writing = 0;
+    }
+}
+
+static void shm_unlock(bool changed)
+{
+    if (changed)
+    {
+        atomic_fetch_add_explicit(&g_shm.hdr->gen, 1, memory_order_seq_cst);
+        if (atomic_load_explicit(&g_shm.hdr->waiters, memory_order_seq_cst))
+            syscall(SYS_futex, &g_shm.hdr->gen, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+    shm_file_lock(g_shm.fd, F_UNLCK);
+    pthread_mutex_unlock(&g_shm.lock);
+}
+
+static void shm_write_slot(uint32_t i, uint32_t state, uint32_t hash, uint32_t flags, uint32_t klen, uint32_t vlen,
+                           uint64_t off)
+{
+    SVShmSlot *s = &g_shm.slot[i];
+    uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    g_shm.hdr->writing = i + 1;
+    atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&s->state, state, memory_order_relaxed);
+    atomic_store_explicit(&s->hash, hash, memory_order_relaxed);
+    atomic_store_explicit(&s->flags, flags, memory_order_relaxed);
+    atomic_store_explicit(&s->klen, klen, memory_order_relaxed);
+    atomic_store_explicit(&s->vlen, vlen, memory_order_relaxed);
+    atomic_store_explicit(&s->off, off, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+    g_shm.hdr->writing = 0;
+    uint32_t pos = atomic_load_explicit(&g_shm.hdr->logpos, memory_order_relaxed);
+    atomic_store_explicit(&g_shm.hdr->log[pos % SV_SHM_LOG], i, memory_order_relaxed);
+    atomic_store_explicit(&g_shm.hdr->logpos, pos + 1, memory_order_release);
+}
+
+static int shm_cmp_off(const void *a, const void *b)
+{
+    uint64_t x = atomic_load_explicit(&g_shm.slot[*(const uint32_t *)a].off, memory_order_relaxed);
+    uint64_t y = atomic_load_explicit(&g_shm.slot[*(const uint32_t *)b].off, memory_order_relaxed);
+    return (x > y) - (x < y);
+}
+
+/* slide live blocks down over dead space, lowest offset first */
+static void shm_compact(void)
+{
+    SVShmHdr *h = g_shm.hdr;
+    uint32_t *ord = xmalloc((size_t)(h->live ? h->live : 1) * sizeof(*ord)), n = 0;
+    for (uint32_t i = 0; i < h->nslots && n < h->live; i++)
+        if (atomic_load_explicit(&g_shm.slot[i].state, memory_order_relaxed) == SV_SLOT_LIVE)
+            ord[n++] = i;
+    qsort(ord, n, sizeof(*ord), shm_cmp_off);
+    uint64_t to = 8;
+    for (uint32_t j = 0; j < n; j++)
+    {
+        SVShmSlot *s = &g_shm.slot[ord[j]];
+        uint64_t from = atomic_load_explicit(&s->off, memory_order_relaxed);
+        uint32_t klen = atomic_load_explicit(&s->klen, memory_order_relaxed);
+        uint32_t vlen = atomic_load_explicit(&s->vlen, memory_order_relaxed);
+        size_t words = shm_block(klen, vlen) / 8;
+        if (from != to)
+        {
+            uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+            h->writing = ord[j] + 1;
+            atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+            atomic_thread_fence(memory_order_release);
+            for (size_t w = 0; w < words; w++) /* to < from: ascending copy is safe */
+                atomic_store_explicit(&g_shm.heap[to / 8 + w],
+                                      atomic_load_explicit(&g_shm.heap[from / 8 + w], memory_order_relaxed),
+                                      memory_order_relaxed);
+            atomic_store_explicit(&s->off, to, memory_order_relaxed);
+            atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+            h->writing = 0;
+        }
+        to += words * 8;
+    }
+    h->heap_used = to;
+    h->heap_dead = 0;
+    free(ord);
+}
+
+/* heap block of n bytes, or -1 if even a compacted heap lacks room */
+static int64_t shm_alloc(size_t n)
+{
+    SVShmHdr *h = g_shm.hdr;
+    n = sv_round8(n);
+    if (h->heap_used + n > h->heap_size && h->heap_dead)
+        shm_compact();
+    if (h->heap_used + n > h->heap_size)
+        return -1;
+    int64_t off = (int64_t)h->heap_used;
+    h->heap_used += n;
+    return off;
+}
+
+/* slot of key, or (as ~slot) where to insert it; -1 when full */
+static long shm_find_w(const char *key, size_t klen, uint32_t h)
+{
+    uint32_t mask = g_shm.hdr->nslots - 1;
+    long tomb = -1;
+    char kbuf[SV_SHM_MAXKEY + 1];
+    for (uint32_t n = 0, i = h & mask; n <= mask; n++, i = (i + 1) & mask)
+    {
+        SVShmSlot *s = &g_shm.slot[i];
+        uint32_t st = atomic_load_explicit(&s->state, memory_order_relaxed);
+        if (st == SV_SLOT_EMPTY)
+            return ~(tomb >= 0 ? tomb : (long)i);
+        if (st == SV_SLOT_DEAD)
+        {
+            if (tomb < 0)
+                tomb = (long)i;
+            continue;
+        }
+        if (atomic_load_explicit(&s->hash, memory_order_relaxed) != h ||
+            atomic_load_explicit(&s->klen, memory_order_relaxed) != klen)
+            continue;
+        shm_copy(atomic_load_explicit(&s->off, memory_order_relaxed), kbuf, klen);
+        if (memcmp(kbuf, key, klen) == 0)
+            return (long)i;
+    }
+    return tomb >= 0 ? ~tomb : -1;
+}
+
+static void shm_free_block(uint32_t i)
+{
+    SVShmSlot *s = &g_shm.slot[i];
+    g_shm.hdr->heap_dead += shm_block(atomic_load_explicit(&s->klen, memory_order_relaxed),
+                                      atomic_load_explicit(&s->vlen, memory_order_relaxed));
+}
+
+/* same rules and return codes as sv_set_locked; -3: segment full */
+static int shm_set_locked(const char *key, const char *val, unsigned flags, bool overwrite)
+{
+    SVShmHdr *hd = g_shm.hdr;
+    size_t klen = strlen(key), vlen = strlen(val);
+    if (klen > SV_SHM_MAXKEY)
+        return -3;
+    uint32_t h = (uint32_t)sv_hash(key);
+    long at = shm_find_w(key, klen, h);
+    if (at == -1)
+        return -3;
+    if (at >= 0)
+    {
+        unsigned old = atomic_load_explicit(&g_shm.slot[at].flags, memory_order_relaxed);
+        if ((old & SV_FLAG_RDONLY) && !overwrite)
+            return -2;
+        if (!overwrite)
+            return -1;
+        flags = (old & SV_FLAG_RDONLY) | (flags & SV_FLAG_RDONLY);
+    }
+    else if (hd->live + hd->dead >= hd->nslots - hd->nslots / 8 &&
+             atomic_load_explicit(&g_shm.slot[~at].state, memory_order_relaxed) == SV_SLOT_EMPTY)
+        return -3; /* keep empty slots around so probes end */
+    int64_t off = shm_alloc(shm_block(klen, vlen));
+    if (off < 0)
+        return -3;
+    shm_put((uint64_t)off, key, klen + 1);
+    shm_put((uint64_t)off + sv_round8(klen + 1), val, vlen + 1);
+    if (at >= 0)
+    {
+        shm_free_block((uint32_t)at);
+        shm_write_slot((uint32_t)at, SV_SLOT_LIVE, h, flags, (uint32_t)klen, (uint32_t)vlen, (uint64_t)off);
+        return 0;
+    }
+    uint32_t i = (uint32_t)~at;
+    if (atomic_load_explicit(&g_shm.slot[i].state, memory_order_relaxed) == SV_SLOT_DEAD)
+        hd->dead--;
+    hd->live++;
+    shm_write_slot(i, SV_SLOT_LIVE, h, flags, (uint32_t)klen, (uint32_t)vlen, (uint64_t)off);
+    return 0;
+}
+
+static int shm_unset_locked(const char *key, bool force)
+{
+    size_t klen = strlen(key);
+    if (klen > SV_SHM_MAXKEY)
+        return -1;
+    uint32_t h = (uint32_t)sv_hash(key);
+    long at = shm_find_w(key, klen, h);
+    if (at < 0)
+        return -1;
+    SVShmSlot *s = &g_shm.slot[at];
+    if (!force && (atomic_load_explicit(&s->flags, memory_order_relaxed) & SV_FLAG_RDONLY))
+        return -2;
+    shm_free_block((uint32_t)at);
+    shm_write_slot((uint32_t)at, SV_SLOT_DEAD, h, 0, 0, 0, 0);
+    g_shm.hdr->live--;
+    g_shm.hdr->dead++;
+    return 0;
+}
+
+static int sv_shm_set(const char *key, const char *val, unsigned flags, bool overwrite)
+{
+    shm_lock();
+    int rc = shm_set_locked(key, val, flags, overwrite);
+    shm_unlock(rc == 0);
+    return rc;
+}
+
+static int sv_shm_unset(const char *key)
+{
+    shm_lock();
+    int rc = shm_unset_locked(key, false);
+    shm_unlock(rc == 0);
+    return rc;
+}
+
+/* g_store.lock held: copy slot i into the local store if it changed since last seen */
+static void sv_shm_sync_slot(uint32_t i, char **val, size_t *cap, sv_change_fn fn, void *ctx)
+{
+    uint32_t seq = atomic_load_explicit(&g_shm.slot[i].seq, memory_order_acquire);
+    if (seq == g_shm.seen_seq[i])
+        return; /* unchanged; when odd, wait it out below: compaction moves are not logged */
+    SVSlotCopy c;
+    char key[SV_SHM_MAXKEY + 1];
+    for (;;)
+    {
+        shm_read_slot(i, &c, key, *val, *cap - 1);
+        if (c.state != SV_SLOT_LIVE || c.vlen < *cap)
+            break;
+        *cap = (size_t)c.vlen + 1;
+        free(*val);
+        *val = xmalloc(*cap);
+    }
+    key[c.state == SV_SLOT_LIVE ? c.klen : 0] = '\0';
+    SVTable *t = sv_table_locked();
+    char *was = g_shm.seen_key[i];
+    if (was && (c.state != SV_SLOT_LIVE || strcmp(was, key) != 0))
+    {
+        /* gone from this slot; it may have moved to another one (synced before or after) */
+        SVSlotCopy o;
+        SVVar *v = sv_find(t, was);
+        if (v && shm_lookup(was, NULL, 0, &o) < 0)
+        {
+            sv_remove_locked(t, v);
+            if (fn)
+                fn(was, NULL, ctx);
+        }
+        free(was);
+        g_shm.seen_key[i] = NULL;
+    }
+    if (c.state == SV_SLOT_LIVE)
+    {
+        (*val)[c.vlen] = '\0';
+        sv_set_locked(key, *val, c.flags, true);
+        if (fn)
+            fn(key, *val, ctx);
+        if (!g_shm.seen_key[i])
+            g_shm.seen_key[i] = xstrdup(key);
+    }
+    g_shm.seen_seq[i] = c.seq;
+}
+
+/* g_store.lock held: bring the local store up to the segment; the slots
+   written since the last sync come from the log unless it wrapped */
+static void sv_shm_sync_locked(sv_change_fn fn, void *ctx)
+{
+    SVShmHdr *h = g_shm.hdr;
+    uint32_t gen = atomic_load_explicit(&h->gen, memory_order_acquire);
+    uint32_t from = g_shm.synced_log, to = atomic_load_explicit(&h->logpos, memory_order_acquire);
+    size_t cap = 256;
+    char *val = xmalloc(cap);
+    bool full = to - from > SV_SHM_LOG;
+    for (uint32_t p = from; !full && p != to; p++)
+        sv_shm_sync_slot(atomic_load_explicit(&h->log[p % SV_SHM_LOG], memory_order_relaxed) & (h->nslots - 1),
+                         &val, &cap, fn, ctx);
+    if (!full && atomic_load_explicit(&h->logpos, memory_order_acquire) - from > SV_SHM_LOG)
+        full = true; /* overwritten while we read it */
+    for (uint32_t i = 0; full && i < h->nslots; i++)
+        sv_shm_sync_slot(i, &val, &cap, fn, ctx);
+    free(val);
+    sv_changed();
+    g_shm.synced_log = to;
+    atomic_store_explicit(&g_shm.synced_gen, gen, memory_order_release);
+}
+
+/* bring the local cache up to date if the segment changed (one load when it did not) */
+static void sv_shm_refresh(void)
+{
+    if (!g_shm.hdr || atomic_load_explicit(&g_shm.hdr->gen, memory_order_acquire) ==
+                          atomic_load_explicit(&g_shm.synced_gen, memory_order_acquire))
+        return;
+    pthread_mutex_lock(&g_store.lock);
+    sv_shm_sync_locked(NULL, NULL);
+    pthread_mutex_unlock(&g_store.lock);
+}
+
+static int sv_shm_import_key(SVVar *v, void *ctx)
+{
+    const SVVal *s = sv_var_val(v);
+    if (shm_set_locked(v->key, s->str, s->flags, true) != 0)
+        *(int *)ctx = -1;
+    return 0;
+}
+
+/* g_store.lock held: make the segment hold exactly the local keys */
+static int sv_shm_import_locked(void)
+{
+    int rc = 0;
+    char key[SV_SHM_MAXKEY + 1];
+    SVTable *t = sv_table_locked();
+    shm_lock();
+    for (uint32_t i = 0; i < g_shm.hdr->nslots; i++)
+    {
+        SVSlotCopy c;
+        shm_read_slot(i, &c, key, NULL, 0);
+        if (c.state != SV_SLOT_LIVE)
+            continue;
+        key[c.klen] = '\0';
+        if (!sv_find(t, key))
+            shm_unset_locked(key, true);
+    }
+    sv_walk(NULL, sv_shm_import_key, &rc);
+    shm_unlock(true);
+    return rc;
+}
+
+/* ---- public ---- */
+/* Map the segment at path, creating it (nslots rounded up to a power of two,
+   heap_bytes of values; 0 = defaults) if it does not exist. A new segment
+   is filled from the local store (e.g. what sv_init loaded); an existing one
+   replaces it. */
+int sv_shm_attach(const char *path, uint32_t nslots, uint64_t heap_bytes)
+{
+    if (g_shm.hdr)
+        return 0;
+    uint32_t ns = 1024;
+    while (ns < (nslots ? nslots : SV_SHM_SLOTS) && ns < (1u << 30))
+        ns <<= 1;
+    uint64_t heap = sv_round8(heap_bytes ? heap_bytes : SV_SHM_HEAP);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -1;
+    shm_file_lock(fd, F_WRLCK);
+    struct stat st;
+    bool fresh = fstat(fd, &st) == 0 && st.st_size == 0;
+    if (fresh && ftruncate(fd, (off_t)(SV_SHM_HDR + (uint64_t)ns * sizeof(SVShmSlot) + heap)) != 0)
+        goto fail;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < SV_SHM_HDR)
+        goto fail;
+    void *mem = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED)
+        goto fail;
+    SVShmHdr *h = mem;
+    if (fresh)
+    {
+        h->version = SV_SHM_VERSION;
+        h->nslots = ns;
+        h->heap_size = heap;
+        h->heap_used = 8; /* offset 0 stays unused */
+        h->magic = SV_SHM_MAGIC;
+    }
+    else if (h->magic != SV_SHM_MAGIC || h->version != SV_SHM_VERSION || !h->nslots || (h->nslots & (h->nslots - 1)) ||
+             SV_SHM_HDR + (uint64_t)h->nslots * sizeof(SVShmSlot) + h->heap_size > (uint64_t)st.st_size)
+    {
+        munmap(mem, (size_t)st.st_size);
+        errno = EINVAL;
+        goto fail;
+    }
+    shm_file_lock(fd, F_UNLCK);
+    g_shm.hdr = h;
+    g_shm.slot = (SVShmSlot *)((char *)mem + SV_SHM_HDR);
+    g_shm.heap = (_Atomic uint64_t *)(g_shm.slot + h->nslots);
+    g_shm.map_len = (size_t)st.st_size;
+    g_shm.fd = fd;
+    g_shm.seen_seq = calloc(h->nslots, sizeof(*g_shm.seen_seq));
+    g_shm.seen_key = calloc(h->nslots, sizeof(*g_shm.seen_key));
+    if (!g_shm.seen_seq || !g_shm.seen_key)
+    {
+        perror("calloc");
+        exit(1);
+    }
+    pthread_mutex_lock(&g_store.lock);
+    int rc = 0;
+    if (fresh)
+        rc = sv_shm_import_locked();
+    else
+        sv_clear_locked();
+    sv_shm_sync_locked(NULL, NULL);
+    pthread_mutex_unlock(&g_store.lock);
+    return rc;
+fail:
+    {
+        int e = errno;
+        shm_file_lock(fd, F_UNLCK);
+        close(fd);
+        errno = e;
+        return -1;
+    }
+}
+
+/* Sleep until the segment changes after *gen (timeout_ms < 0: forever).
+   Returns 1 with *gen updated, 0 on timeout, -1 if not attached. */
+int sv_shm_wait(uint32_t *gen, int timeout_ms)
+{
+    if (!g_shm.hdr)
+        return -1;
+    _Atomic uint32_t *g = &g_shm.hdr->gen;
+    uint32_t now = atomic_load_explicit(g, memory_order_acquire);
+    if (now == *gen)
+    {
+        struct timespec ts = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L};
+        atomic_fetch_add_explicit(&g_shm.hdr->waiters, 1, memory_order_seq_cst);
+        if (atomic_load_explicit(g, memory_order_seq_cst) == *gen)
+            syscall(SYS_futex, g, FUTEX_WAIT, *gen, timeout_ms < 0 ? NULL : &ts, NULL, 0);
+        atomic_fetch_sub_explicit(&g_shm.hdr->waiters, 1, memory_order_relaxed);
+        now = atomic_load_explicit(g, memory_order_acquire);
+    }
+    if (now == *gen)
+        return 0;
+    *gen = now;
+    return 1;
+}
+
+uint32_t sv_shm_gen(void) { return g_shm.hdr ? atomic_load_explicit(&g_shm.hdr->gen, memory_order_acquire) : 0; }
+
+static void *sv_shm_watcher(void *p)
+{
+    int efd = (int)(intptr_t)p;
+    uint32_t gen = sv_shm_gen();
+    for (;;)
+        if (sv_shm_wait(&gen, -1) > 0)
+        {
+            uint64_t one = 1;
+            if (write(efd, &one, sizeof(one)) < 0 && errno == EBADF)
+                return NULL; /* caller closed it */
         }
-        prev = cur;
-        cur = cur->next;
+}
+
+/* An eventfd that becomes readable after each change, for poll/epoll loops;
+   read it to rearm. A helper thread does the futex wait. */
+int sv_shm_watch_fd(void)
+{
+    if (!g_shm.hdr)
+        return -1;
+    int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (efd < 0)
+        return -1;
+    pthread_t th;
+    if (pthread_create(&th, NULL, sv_shm_watcher, (void *)(intptr_t)efd) != 0)
+    {
+        close(efd);
+        return -1;
     }
-    return -1; /* not found */
+    pthread_detach(th);
+    return efd;
 }
 
 /* ---------- Public API ---------- */
@@ -295,55 +1516,56 @@ int sv_load(const char *db_path);
 int sv_save(const char *db_path);
 int sv_set(const char *key, const char *val, unsigned flags, bool overwrite);
 int sv_get(const char *key, char **out_val, unsigned *out_flags);
+int sv_view(const char *key, SVView *out);
+uint64_t sv_generation(void);
+void sv_read_begin(void);
+void sv_read_end(void);
 int sv_unset(const char *key);
 size_t sv_list(const char *prefix, SVVar ***out_vec);
+size_t sv_unset_tree(const char *prefix);
+SVSnapshot *sv_snapshot(const char *prefix);
+int sv_restore(const SVSnapshot *s);
+void sv_snapshot_free(SVSnapshot *s);
+
+int sv_shm_attach(const char *path, uint32_t nslots, uint64_t heap_bytes);
+long sv_shm_read(const char *key, char *buf, size_t cap, unsigned *out_flags);
+int sv_shm_wait(uint32_t *gen, int timeout_ms);
+int sv_shm_watch_fd(void);
+uint32_t sv_shm_gen(void);
 
 int sv_init(const char *db_path)
 {
-    pthread_rwlock_wrlock(&g_store.lock);
+    pthread_mutex_lock(&g_store.lock);
     if (g_store.db_path)
     {
         free(g_store.db_path);
         g_store.db_path = NULL;
     }
     g_store.db_path = xstrdup(db_path ? db_path : sv_default_path());
-    pthread_rwlock_unlock(&g_store.lock);
+    pthread_mutex_unlock(&g_store.lock);
     return sv_load(NULL); /* load from g_store.db_path */
 }
 
 int sv_load(const char *db_path)
 {
     int rc = 0;
-    pthread_rwlock_wrlock(&g_store.lock);
+    pthread_mutex_lock(&g_store.lock);
     const char *path = db_path ? db_path : g_store.db_path;
     if (!path)
     {
-        pthread_rwlock_unlock(&g_store.lock);
+        pthread_mutex_unlock(&g_store.lock);
         return 0;
     }
     FILE *fp = fopen(path, "r");
     if (!fp)
     { /* not fatal if missing */
         rc = (errno == ENOENT) ? 0 : -1;
-        pthread_rwlock_unlock(&g_store.lock);
+        pthread_mutex_unlock(&g_store.lock);
         return rc;
     }
 
     /* Clear existing */
-    for (size_t i = 0; i < SV_BUCKETS; i++)
-    {
-        SVVar *v = g_store.buckets[i];
-        while (v)
-        {
-            SVVar *n = v->next;
-            free(v->key);
-            free(v->val);
-            free(v);
-            v = n;
-        }
-        g_store.buckets[i] = NULL;
-    }
-    g_store.count = 0;
+    sv_clear_locked();
 
     char *line = NULL;
     size_t cap = 0;
@@ -377,43 +1599,55 @@ int sv_load(const char *db_path)
     }
     free(line);
     fclose(fp);
-    pthread_rwlock_unlock(&g_store.lock);
+    if (g_shm.hdr)
+    {
+        /* the file becomes the segment's content */
+        rc = sv_shm_import_locked();
+        sv_shm_sync_locked(NULL, NULL);
+    }
+    pthread_mutex_unlock(&g_store.lock);
     return rc;
 }
 
+static int sv_save_line(SVVar *v, void *ctx)
+{
+    const SVVal *s = sv_var_val(v);
+    char *esc = escape_value(s->str);
+    fprintf(ctx, "%s\t%s\t%s\n", v->key, esc, (s->flags & SV_FLAG_RDONLY) ? "ro" : "-");
+    free(esc);
+    return 0;
+}
+
 int sv_save(const char *db_path)
 {
     int rc = 0;
-    pthread_rwlock_rdlock(&g_store.lock);
+    sv_shm_refresh();
+    pthread_mutex_lock(&g_store.lock);
     const char *path = db_path ? db_path : g_store.db_path;
     if (!path)
     {
-        pthread_rwlock_unlock(&g_store.lock);
+        pthread_mutex_unlock(&g_store.lock);
         errno = EINVAL;
         return -1;
     }
     char tmp_path[PATH_MAX];
     snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
-    pthread_rwlock_unlock(&g_store.lock);
-
     if (ensure_parent_dir(path) != 0)
+    {
+        pthread_mutex_unlock(&g_store.lock);
         return -1;
+    }
 
     FILE *fp = fopen(tmp_path, "w");
     if (!fp)
-        return -1;
-
-    pthread_rwlock_rdlock(&g_store.lock);
-    for (size_t i = 0; i < SV_BUCKETS; i++)
     {
-        for (SVVar *v = g_store.buckets[i]; v; v = v->next)
-        {
-            char *esc = escape_value(v->val);
-            fprintf(fp, "%s\t%s\t%s\n", v->key, esc, (v->flags & SV_FLAG_RDONLY) ? "ro" : "-");
-            free(esc);
-        }
+        pthread_mutex_unlock(&g_store.lock);
+        return -1;
     }
-    pthread_rwlock_unlock(&g_store.lock);
+
+    /* writers are held off, so this is a consistent snapshot, written in key order */
+    sv_walk(NULL, sv_save_line, fp);
+    pthread_mutex_unlock(&g_store.lock);
 
     if (fclose(fp) != 0)
     {
@@ -431,117 +1665,428 @@ int sv_save(const char *db_path)
 int sv_set(const char *key, const char *val, unsigned flags, bool overwrite)
 {
     int rc;
-    pthread_rwlock_wrlock(&g_store.lock);
+    if (g_shm.hdr)
+        return sv_shm_set(key, val, flags, overwrite);
+    pthread_mutex_lock(&g_store.lock);
     rc = sv_set_locked(key, val, flags, overwrite);
-    pthread_rwlock_unlock(&g_store.lock);
+    pthread_mutex_unlock(&g_store.lock);
     return rc;
 }
 
+/* Returns a copy in *out_val (caller frees). Hot paths: sv_view. */
 int sv_get(const char *key, char **out_val, unsigned *out_flags)
 {
     int rc = 0;
-    pthread_rwlock_rdlock(&g_store.lock);
-    SVVar *v = sv_find_locked(key, NULL);
+    if (g_shm.hdr)
+    {
+        char buf[256];
+        long n = sv_shm_read(key, buf, sizeof(buf), out_flags);
+        if (n < 0)
+            return -1;
+        if (!out_val)
+            return 0;
+        if ((size_t)n < sizeof(buf))
+        {
+            *out_val = xstrdup(buf);
+            return 0;
+        }
+        for (;;)
+        {
+            /* longer than buf: read again into one that fits (it may grow meanwhile) */
+            size_t cap = (size_t)n + 1;
+            char *val = xmalloc(cap);
+            if ((n = sv_shm_read(key, val, cap, out_flags)) >= 0 && (size_t)n < cap)
+            {
+                *out_val = val;
+                return 0;
+            }
+            free(val);
+            if (n < 0)
+                return -1;
+        }
+    }
+    sv_read_begin();
+    SVVar *v = sv_find(sv_table(), key);
     if (!v)
     {
         rc = -1;
     }
     else
     {
+        const SVVal *s = sv_var_val(v);
         if (out_val)
-            *out_val = xstrdup(v->val);
+            *out_val = xstrdup(s->str);
         if (out_flags)
-            *out_flags = v->flags;
+            *out_flags = s->flags;
     }
-    pthread_rwlock_unlock(&g_store.lock);
+    sv_read_end();
     return rc;
 }
 
+/* Inside sv_read_begin()/sv_read_end(): no lock, no copy. */
+int sv_view(const char *key, SVView *out)
+{
+    sv_shm_refresh();
+    SVVar *v = sv_find(sv_table(), key);
+    if (!v)
+        return -1;
+    const SVVal *s = sv_var_val(v);
+    out->val = s->str;
+    out->len = s->len;
+    out->flags = s->flags;
+    out->version = s->version;
+    return 0;
+}
+
+/* Changes with every set/unset/load: a cheap "reparse my cached config?" check. */
+uint64_t sv_generation(void) { return atomic_load_explicit(&g_store.generation, memory_order_acquire); }
+
 int sv_unset(const char *key)
 {
     int rc;
-    pthread_rwlock_wrlock(&g_store.lock);
+    if (g_shm.hdr)
+        return sv_shm_unset(key);
+    pthread_mutex_lock(&g_store.lock);
     rc = sv_unset_locked(key);
-    pthread_rwlock_unlock(&g_store.lock);
+    pthread_mutex_unlock(&g_store.lock);
     return rc;
 }
 
-/* Collect variables matching prefix (or all if prefix==NULL). Caller must free vec and entries. */
+/* Collect variables matching prefix (or all if prefix==NULL), in segment order. Caller frees vec only;
+   the entries point into the store, so with concurrent writers keep a read section open while using them. */
 size_t sv_list(const char *prefix, SVVar ***out_vec)
 {
-    size_t cap = 64, n = 0;
-    SVVar **vec = xmalloc(cap * sizeof(*vec));
-    pthread_rwlock_rdlock(&g_store.lock);
-    for (size_t i = 0; i < SV_BUCKETS; i++)
+    SVVec vec = {0};
+    sv_shm_refresh();
+    sv_read_begin();
+    sv_walk(prefix, sv_collect, &vec);
+    sv_read_end();
+    *out_vec = vec.v ? vec.v : xmalloc(sizeof(*vec.v));
+    return vec.n;
+}
+
+/* Unset every key starting with prefix, except read-only ones; returns how many went. */
+size_t sv_unset_tree(const char *prefix)
+{
+    if (g_shm.hdr)
+    {
+        SVSnapshot *snap = sv_snapshot(prefix);
+        size_t n = 0;
+        for (size_t i = 0; i < snap->n; i++)
+            n += sv_shm_unset(snap->e[i].key) == 0;
+        sv_snapshot_free(snap);
+        return n;
+    }
+    pthread_mutex_lock(&g_store.lock);
+    size_t n = sv_unset_tree_locked(prefix);
+    pthread_mutex_unlock(&g_store.lock);
+    return n;
+}
+
+static int sv_snap_add(SVVar *v, void *ctx)
+{
+    SVSnapshot *s = ctx;
+    if (s->n == s->cap)
     {
-        for (SVVar *v = g_store.buckets[i]; v; v = v->next)
+        s->cap = s->cap ? s->cap * 2 : 64;
+        s->e = realloc(s->e, s->cap * sizeof(*s->e));
+        if (!s->e)
         {
-            if (prefix && strncmp(v->key, prefix, strlen(prefix)) != 0)
+            perror("realloc");
+            exit(1);
+        }
+    }
+    const SVVal *val = sv_var_val(v);
+    s->e[s->n].key = xstrdup(v->key);
+    s->e[s->n].val = xstrdup(val->str);
+    s->e[s->n].flags = val->flags;
+    s->n++;
+    return 0;
+}
+
+/* Private copy of the keys under prefix as of one instant; sv_snapshot_free() it. */
+SVSnapshot *sv_snapshot(const char *prefix)
+{
+    SVSnapshot *s = xmalloc(sizeof(*s));
+    memset(s, 0, sizeof(*s));
+    s->prefix = xstrdup(prefix ? prefix : "");
+    pthread_mutex_lock(&g_store.lock); /* no writer in between: a consistent cut */
+    if (g_shm.hdr)
+        sv_shm_sync_locked(NULL, NULL); /* of the segment as of now */
+    s->generation = atomic_load_explicit(&g_store.generation, memory_order_relaxed);
+    sv_walk(prefix, sv_snap_add, s);
+    pthread_mutex_unlock(&g_store.lock);
+    return s;
+}
+
+/* Put the subtree back as it was: writable keys under the prefix that the
+   snapshot lacks are unset, and its entries are set (flags included). */
+int sv_restore(const SVSnapshot *s)
+{
+    if (g_shm.hdr)
+    {
+        int rc = 0;
+        sv_unset_tree(s->prefix);
+        for (size_t i = 0; i < s->n; i++)
+            if (sv_shm_set(s->e[i].key, s->e[i].val, s->e[i].flags, true) != 0)
+                rc = -1;
+        return rc;
+    }
+    pthread_mutex_lock(&g_store.lock);
+    sv_unset_tree_locked(s->prefix);
+    for (size_t i = 0; i < s->n; i++)
+        sv_set_locked(s->e[i].key, s->e[i].val, s->e[i].flags, true);
+    pthread_mutex_unlock(&g_store.lock);
+    return 0;
+}
+
+void sv_snapshot_free(SVSnapshot *s)
+{
+    if (!s)
+        return;
+    for (size_t i = 0; i < s->n; i++)
+    {
+        free(s->e[i].key);
+        free(s->e[i].val);
+    }
+    free(s->e);
+    free(s->prefix);
+    free(s);
+}
+
+/* ---------- Benchmark ---------- */
+/* Read-heavy contention: reader threads look up random keys while one
+   writer keeps overwriting. "rwlock+copy" wraps sv_get in a global
+   rwlock, as every read used to be. */
+static char (*g_bench_keys)[32];
+static pthread_rwlock_t g_bench_rw = PTHREAD_RWLOCK_INITIALIZER;
+
+typedef struct
+{
+    int mode; /* 0 rwlock+copy, 1 sv_get, 2 sv_view, 3 sv_shm_read */
+    int nkeys;
+    unsigned seed;
+    atomic_bool *stop;
+    uint64_t ops;
+} SVBenchArg;
+
+static unsigned bench_rand(unsigned *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static void *bench_reader(void *p)
+{
+    SVBenchArg *a = p;
+    uint64_t n = 0, sum = 0;
+    while (!atomic_load_explicit(a->stop, memory_order_relaxed))
+    {
+        for (int i = 0; i < 256; i++, n++)
+        {
+            const char *key = g_bench_keys[bench_rand(&a->seed) % (unsigned)a->nkeys];
+            if (a->mode == 3)
+            {
+                char buf[32];
+                if (sv_shm_read(key, buf, sizeof(buf), NULL) >= 0)
+                    sum += (unsigned char)buf[0];
                 continue;
-            if (n == cap)
+            }
+            if (a->mode == 2)
             {
-                cap *= 2;
-                vec = realloc(vec, cap * sizeof(*vec));
-                if (!vec)
-                {
-                    perror("realloc");
-                    exit(1);
-                }
+                SVView vw;
+                sv_read_begin();
+                if (sv_view(key, &vw) == 0)
+                    sum += (unsigned char)vw.val[0];
+                sv_read_end();
+                continue;
             }
-            vec[n++] = v; /* note: pointing into store; do not free entries */
+            char *val = NULL;
+            if (a->mode == 0)
+                pthread_rwlock_rdlock(&g_bench_rw);
+            if (sv_get(key, &val, NULL) == 0)
+                sum += (unsigned char)val[0];
+            if (a->mode == 0)
+                pthread_rwlock_unlock(&g_bench_rw);
+            free(val);
         }
     }
-    pthread_rwlock_unlock(&g_store.lock);
-    /* sort by key for stable output */
-    int cmp(const void *a, const void *b)
+    a->ops = n + (sum == 1); /* keep sum live */
+    return NULL;
+}
+
+static void *bench_writer(void *p)
+{
+    SVBenchArg *a = p;
+    char val[32];
+    uint64_t n = 0;
+    while (!atomic_load_explicit(a->stop, memory_order_relaxed))
     {
-        const SVVar *va = *(const SVVar *const *)a;
-        const SVVar *vb = *(const SVVar *const *)b;
-        return strcmp(va->key, vb->key);
+        snprintf(val, sizeof(val), "w%llu", (unsigned long long)n++);
+        if (a->mode == 0)
+            pthread_rwlock_wrlock(&g_bench_rw);
+        sv_set(g_bench_keys[bench_rand(&a->seed) % (unsigned)a->nkeys], val, 0, true);
+        if (a->mode == 0)
+            pthread_rwlock_unlock(&g_bench_rw);
+        usleep(100);
     }
-    qsort(vec, n, sizeof(*vec), cmp);
-    *out_vec = vec;
-    return n;
+    a->ops = n;
+    return NULL;
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cmd_bench(int nthreads, int nkeys, int ms)
+{
+    static const char *names[] = {"rwlock+copy", "sv_get", "sv_view", "sv_shm_read"};
+    g_bench_keys = xmalloc((size_t)nkeys * sizeof(*g_bench_keys));
+    double t0 = bench_now();
+    for (int i = 0; i < nkeys; i++)
+    {
+        char val[32];
+        snprintf(g_bench_keys[i], sizeof(g_bench_keys[i]), "net.bench%d.key%d", i % 64, i);
+        snprintf(val, sizeof(val), "%d", i);
+        sv_set(g_bench_keys[i], val, 0, true);
+    }
+    double t1 = bench_now();
+    SVTable *t = sv_table();
+    printf("%d keys inserted in %.1f ms (%zu buckets), %d reader(s) + 1 writer, %d ms per mode\n", nkeys,
+           (t1 - t0) * 1e3, t->mask + 1, nthreads, ms);
+    SVVar **vec;
+    double l0 = bench_now();
+    size_t nsub = sv_list("net.bench7.", &vec);
+    free(vec);
+    double l1 = bench_now();
+    size_t nall = sv_list(NULL, &vec);
+    free(vec);
+    double l2 = bench_now();
+    printf("sv_list: %zu keys under net.bench7. in %.3f ms, all %zu in %.3f ms\n", nsub, (l1 - l0) * 1e3, nall,
+           (l2 - l1) * 1e3);
+    printf("%-12s %14s %12s %10s\n", "mode", "reads/s", "ns/read", "writes");
+    pthread_t *th = xmalloc((size_t)(nthreads + 1) * sizeof(*th));
+    SVBenchArg *args = xmalloc((size_t)(nthreads + 1) * sizeof(*args));
+    /* then the same through a scratch segment: sv_get/sv_view pick up the writer's changes from it */
+    char shm_path[64];
+    snprintf(shm_path, sizeof(shm_path), "/dev/shm/sysvar-bench.%ld", (long)getpid());
+    static const int order[] = {0, 1, 2, -1, 3, 1, 2};
+    for (size_t k = 0; k < sizeof(order) / sizeof(order[0]); k++)
+    {
+        int mode = order[k];
+        if (mode < 0)
+        {
+            if (sv_shm_attach(shm_path, (uint32_t)nkeys * 2, (uint64_t)nkeys * 64 + (1u << 20)) != 0)
+            {
+                fprintf(stderr, "no shared segment (%s): %s\n", shm_path, strerror(errno));
+                break;
+            }
+            unlink(shm_path);
+            printf("shared segment:\n");
+            continue;
+        }
+        atomic_bool stop = false;
+        for (int i = 0; i <= nthreads; i++)
+        {
+            args[i] = (SVBenchArg){.mode = mode, .nkeys = nkeys, .seed = 2463534242u + (unsigned)i * 7919u, .stop = &stop};
+            pthread_create(&th[i], NULL, i < nthreads ? bench_reader : bench_writer, &args[i]);
+        }
+        double s0 = bench_now();
+        usleep((useconds_t)ms * 1000);
+        atomic_store(&stop, true);
+        uint64_t reads = 0;
+        for (int i = 0; i <= nthreads; i++)
+        {
+            pthread_join(th[i], NULL);
+            if (i < nthreads)
+                reads += args[i].ops;
+        }
+        double secs = bench_now() - s0;
+        printf("%-12s %14.0f %12.1f %10llu\n", names[mode], reads / secs, secs * 1e9 * nthreads / (double)reads,
+               (unsigned long long)args[nthreads].ops);
+    }
+    free(th);
+    free(args);
+    free(g_bench_keys);
+    return 0;
 }
 
 /* ---------- CLI ---------- */
+static void watch_print(const char *key, const char *val, void *ctx)
+{
+    const char *prefix = ctx;
+    if (strncmp(key, prefix, strlen(prefix)) != 0)
+        return;
+    if (val)
+        printf("%s = %s\n", key, val);
+    else
+        printf("%s unset\n", key);
+}
+
 static void usage(const char *prog)
 {
     fprintf(stderr,
-            "Usage: %s [-f <dbfile>] <cmd> [args]\n"
+            "Usage: %s [-f <dbfile>] [-m <segment>] <cmd> [args]\n"
             "Commands:\n"
             "  list [prefix]\n"
             "  get <key>\n"
             "  set [-o] [-r] <key> <value>\n"
             "     -o  overwrite existing\n"
             "     -r  mark as read-only\n"
-            "  unset <key>\n",
+            "  unset [-p] <key>\n"
+            "     -p  every writable key starting with <key>\n"
+            "  dump [prefix]     (db format, one consistent snapshot)\n"
+            "  watch [prefix]    (needs -m; prints changes as they happen)\n"
+            "Options:\n"
+            "  -m <segment>  share the store with other processes through a file in\n"
+            "                /dev/shm; the first one fills it from the db\n"
+            "  bench [readers] [keys] [ms]   (in memory, the db is not touched)\n",
             prog);
 }
 
 int main(int argc, char **argv)
 {
-    const char *dbfile = NULL;
+    const char *dbfile = NULL, *segment = NULL;
     int opt;
-    while ((opt = getopt(argc, argv, "f:h")) != -1)
+    while ((opt = getopt(argc, argv, "f:m:h")) != -1)
     {
         switch (opt)
         {
         case 'f':
             dbfile = optarg;
             break;
+        case 'm':
+            segment = optarg;
+            break;
         case 'h':
         default:
             usage(argv[0]);
             return (opt == 'h' ? 0 : 1);
         }
     }
+    if (optind < argc && strcmp(argv[optind], "bench") == 0)
+    {
+        int nthreads = optind + 1 < argc ? atoi(argv[optind + 1]) : 4;
+        int nkeys = optind + 2 < argc ? atoi(argv[optind + 2]) : 50000;
+        int ms = optind + 3 < argc ? atoi(argv[optind + 3]) : 1000;
+        return cmd_bench(nthreads > 0 ? nthreads : 1, nkeys > 0 ? nkeys : 1, ms > 0 ? ms : 1000);
+    }
     if (!dbfile)
         dbfile = sv_default_path();
     if (sv_init(dbfile) != 0)
     {
         fprintf(stderr, "warning: could not load '%s': %s\n", dbfile, strerror(errno));
     }
+    if (segment && sv_shm_attach(segment, 0, 0) != 0)
+    {
+        fprintf(stderr, "cannot attach '%s': %s\n", segment, strerror(errno));
+        return 1;
+    }
 
     if (optind >= argc)
     {
@@ -557,8 +2102,8 @@ int main(int argc, char **argv)
         size_t n = sv_list(prefix, &vec);
         for (size_t i = 0; i < n; i++)
         {
-            const SVVar *v = vec[i];
-            printf("%s = %s%s\n", v->key, v->val, (v->flags & SV_FLAG_RDONLY) ? "\t#ro" : "");
+            const SVVal *s = sv_var_val(vec[i]);
+            printf("%s = %s%s\n", vec[i]->key, s->str, (s->flags & SV_FLAG_RDONLY) ? "\t#ro" : "");
         }
         free(vec);
         return 0;
@@ -622,14 +2167,60 @@ int main(int argc, char **argv)
         }
         return 0;
     }
+    else if (strcmp(cmd, "watch") == 0)
+    {
+        if (!segment)
+        {
+            fprintf(stderr, "watch needs a shared segment (-m)\n");
+            return 1;
+        }
+        const char *prefix = (optind < argc) ? argv[optind++] : "";
+        uint32_t gen = sv_shm_gen();
+        for (;;)
+        {
+            pthread_mutex_lock(&g_store.lock);
+            sv_shm_sync_locked(watch_print, (void *)prefix);
+            pthread_mutex_unlock(&g_store.lock);
+            fflush(stdout);
+            sv_shm_wait(&gen, -1);
+        }
+    }
+    else if (strcmp(cmd, "dump") == 0)
+    {
+        SVSnapshot *snap = sv_snapshot((optind < argc) ? argv[optind++] : NULL);
+        for (size_t i = 0; i < snap->n; i++)
+        {
+            char *esc = escape_value(snap->e[i].val);
+            printf("%s\t%s\t%s\n", snap->e[i].key, esc, (snap->e[i].flags & SV_FLAG_RDONLY) ? "ro" : "-");
+            free(esc);
+        }
+        sv_snapshot_free(snap);
+        return 0;
+    }
     else if (strcmp(cmd, "unset") == 0)
     {
+        bool tree = optind < argc && strcmp(argv[optind], "-p") == 0;
+        if (tree)
+            optind++;
         if (optind >= argc)
         {
             usage(argv[0]);
             return 1;
         }
         const char *key = argv[optind++];
+        if (tree)
+        {
+            size_t n = sv_unset_tree(key);
+            if (n == 0)
+            {
+                fprintf(stderr, "nothing writable under: %s\n", key);
+                return 2;
+            }
+            printf("unset %zu key(s)\n", n);
+            if (sv_save(NULL) != 0)
+                fprintf(stderr, "warning: save failed: %s\n", strerror(errno));
+            return 0;
+        }
         int rc = sv_unset(key);
         if (rc == -2)
         {
@@ -0,0 +1,326 @@
+/*
+ * onchip_bench.c — one benchmark and profiling harness over every onchip
+ * interpreter, linked in as libraries (see onchip_bench.h)
+ *
+ * The suite. Each engine runs the workloads its language can express, written
+ * in that language; an op is the unit below, so ns/op compares engines doing
+ * the same work:
+ *   loops      1000 x 1000 nested counted loop adding 1     op = inner iteration
+ *   arith      200000 iterations of r += (i + 3) * 4 - i * 4 - 11
+ *                                                           op = iteration
+ *   recursion  naive fib(24) (Prolog: naive reverse of 30 elements, 300 times)
+ *                                                           op = call
+ *   strings    100000 appends of a 4-char piece, restarting every 100
+ *                                                           op = append
+ *   lists      build and walk (Prolog: copy) a 1000-element list, 100 times
+ *                                                           op = list cell
+ *   scan       ONCHIP_SCANS scans of a seal-in motor over a fixed input cycle
+ *                                                           op = scan
+ * Without functions, C, Fortran and Kestrel skip recursion; Prolog, which has
+ * no arithmetic, loops by walking lists. Every run's result is checked.
+ *
+ * Per engine and workload: `warmup` untimed runs, then `reps` timed ones.
+ * Reported as JSON on stdout: the median and minimum ns/op, the heap the
+ * loaded program holds, the peak heap above it during a run, bytes a run
+ * leaves behind, and allocations per op (allocator calls plus the carves
+ * of the Lisp and Prolog pools). A build with -DONCHIP_PROFILE adds an
+ * opcode / AST node histogram of one extra run; time with a plain build,
+ * as the counters cost a few percent.
+ *
+ * Usage:
+ *   onchip_bench [--engine e1,e2] [--workload w1,w2] [--warmup N] [--reps N] [--hist]
+ *   onchip_bench --list              -> engines and their workloads
+ *   onchip_bench --cli ENGINE args.. -> that interpreter's own command line
+ *
+ * Build (add -DONCHIP_PROFILE to every line for --hist):
+ *   for f in onchip_c onchip_fortran onchip_kestrel onchip_lisp onchip_lua onchip_prolog \
+ *            onchip_plc_ld onchip_plc_st onchip_plc_fbd onchip_plc_sfc; do
+ *     gcc -std=c99 -O2 -Wall -DONCHIP_LIB -c $f.c -o $f.o; done
+ *   gcc -std=c99 -O2 -Wall -DONCHIP_LIB onchip_bench.c onchip_*.o -o onchip_bench -lm
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ONCHIP_BENCH_IMPL
+#include "onchip_bench.h"
+
+#ifndef ONCHIP_LIB
+#error "build with -DONCHIP_LIB, as the interpreters"
+#endif
+
+/* ---------------- Counting allocator ---------------- */
+
+OnchipMem onchip_mem;
+#ifdef ONCHIP_PROFILE
+unsigned long long onchip_hist[ONCHIP_HIST_MAX];
+#endif
+
+/* Each block carries its size in front, padded to malloc's alignment */
+typedef union
+{
+    size_t n;
+    long double ld;
+    void *p;
+    long long ll;
+} MemHdr;
+
+static void mem_add(size_t n)
+{
+    onchip_mem.live += n;
+    if (onchip_mem.live > onchip_mem.peak)
+        onchip_mem.peak = onchip_mem.live;
+    onchip_mem.allocs++;
+}
+
+void *onchip_malloc(size_t n)
+{
+    MemHdr *h = (MemHdr *)malloc(sizeof(MemHdr) + n);
+    if (!h)
+        return NULL;
+    h->n = n;
+    mem_add(n);
+    return h + 1;
+}
+
+void *onchip_calloc(size_t n, size_t size)
+{
+    if (size && n > ((size_t)-1 - sizeof(MemHdr)) / size)
+        return NULL;
+    MemHdr *h = (MemHdr *)calloc(1, sizeof(MemHdr) + n * size);
+    if (!h)
+        return NULL;
+    h->n = n * size;
+    mem_add(n * size);
+    return h + 1;
+}
+
+void *onchip_realloc(void *p, size_t n)
+{
+    if (!p)
+        return onchip_malloc(n);
+    MemHdr *h = (MemHdr *)p - 1;
+    size_t old = h->n;
+    h = (MemHdr *)realloc(h, sizeof(MemHdr) + n);
+    if (!h)
+        return NULL;
+    h->n = n;
+    onchip_mem.live -= old;
+    mem_add(n);
+    return h + 1;
+}
+
+void onchip_free(void *p)
+{
+    if (!p)
+        return;
+    MemHdr *h = (MemHdr *)p - 1;
+    onchip_mem.live -= h->n;
+    free(h);
+}
+
+/* ---------------- Harness ---------------- */
+
+#define ENGINE_PTR(e) &onchip_engine_##e,
+static const OnchipEngine *const ENGINES[] = {ONCHIP_ENGINES(ENGINE_PTR)};
+#undef ENGINE_PTR
+#define NENGINES ((int)(sizeof(ENGINES) / sizeof(ENGINES[0])))
+
+typedef struct
+{
+    const char *engines, *workloads; /* comma lists, NULL = all */
+    int warmup, reps, hist;
+} Opts;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* name is an entry of the comma-separated list (NULL matches everything) */
+static int in_list(const char *list, const char *name)
+{
+    size_t n = strlen(name);
+    for (const char *p = list; p; p = strchr(p, ','), p = p ? p + 1 : NULL)
+        if (strncmp(p, name, n) == 0 && (p[n] == ',' || p[n] == '\0'))
+            return 1;
+    return list == NULL;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+#ifdef ONCHIP_PROFILE
+static const OnchipEngine *g_hist_engine; /* for cmp_hist's tie break */
+static int cmp_hist(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    if (onchip_hist[x] != onchip_hist[y])
+        return onchip_hist[x] < onchip_hist[y] ? 1 : -1;
+    return strcmp(g_hist_engine->op_names[x], g_hist_engine->op_names[y]);
+}
+
+/* One more run with the counters cleared, most frequent first */
+static void emit_hist(const OnchipEngine *e, FILE *out)
+{
+    static int order[ONCHIP_HIST_MAX];
+    double r;
+    memset(onchip_hist, 0, sizeof(onchip_hist));
+    e->run(&r);
+    int n = 0;
+    for (int k = 0; k < e->nops; k++)
+        if (onchip_hist[k])
+            order[n++] = k;
+    g_hist_engine = e;
+    qsort(order, (size_t)n, sizeof(int), cmp_hist);
+    fprintf(out, ",\n     \"histogram\": {");
+    for (int j = 0; j < n; j++)
+        fprintf(out, "%s\"%s\": %llu", j ? ", " : "", e->op_names[order[j]], onchip_hist[order[j]]);
+    fputc('}', out);
+}
+#endif
+
+/* Runs one workload and prints its JSON object; 0 if a run failed or gave
+   the wrong result */
+static int bench_one(const OnchipEngine *e, const OnchipWorkload *w, const Opts *o, FILE *out)
+{
+    fprintf(out, "    {\"engine\": \"%s\", \"workload\": \"%s\", \"ops\": %.0f", e->name, w->name, w->ops);
+    size_t live0 = onchip_mem.live;
+    if (!e->load(w->src))
+    {
+        fprintf(out, ", \"ok\": false, \"error\": \"load failed\"}");
+        return 0;
+    }
+    size_t load_bytes = onchip_mem.live - live0;
+
+    double result = 0.0;
+    int ok = 1;
+    for (int k = 0; k < o->warmup; k++)
+        ok &= e->run(&result) && result == w->expect;
+
+    double *t = (double *)malloc((size_t)o->reps * sizeof(double));
+    size_t peak = 0;
+    long long retained = 0;
+    unsigned long long allocs = 0;
+    for (int k = 0; k < o->reps; k++)
+    {
+        size_t live = onchip_mem.live;
+        unsigned long long a0 = onchip_mem.allocs;
+        onchip_mem.peak = live;
+        double t0 = now_ns();
+        ok &= e->run(&result) && result == w->expect;
+        t[k] = now_ns() - t0;
+        if (onchip_mem.peak - live > peak)
+            peak = onchip_mem.peak - live;
+        allocs += onchip_mem.allocs - a0;
+        retained += (long long)onchip_mem.live - (long long)live;
+    }
+    qsort(t, (size_t)o->reps, sizeof(double), cmp_double);
+    double ops = w->ops * (double)o->reps;
+    fprintf(out,
+            ", \"result\": %.17g, \"ok\": %s, \"reps\": %d,\n"
+            "     \"ns_per_op\": %.3f, \"ns_per_op_min\": %.3f, \"load_heap_bytes\": %zu, \"peak_heap_bytes\": %zu,\n"
+            "     \"retained_bytes_per_run\": %lld, \"allocs_per_op\": %.6f",
+            result, ok ? "true" : "false", o->reps, t[o->reps / 2] / w->ops, t[0] / w->ops, load_bytes, peak,
+            retained / o->reps, (double)allocs / ops);
+    free(t);
+#ifdef ONCHIP_PROFILE
+    if (o->hist)
+        emit_hist(e, out);
+#endif
+    fputc('}', out);
+    e->unload();
+    return ok;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: onchip_bench [--engine e1,e2] [--workload w1,w2] [--warmup N] [--reps N] [--hist]\n"
+                    "       onchip_bench --list\n"
+                    "       onchip_bench --cli ENGINE [args...]\n");
+}
+
+int main(int argc, char **argv)
+{
+    Opts o = {NULL, NULL, 1, 5, 0};
+    for (int a = 1; a < argc; a++)
+    {
+        const char *arg = argv[a];
+        int more = a + 1 < argc;
+        if (strcmp(arg, "--cli") == 0 && more)
+        {
+            for (int k = 0; k < NENGINES; k++)
+                if (strcmp(ENGINES[k]->name, argv[a + 1]) == 0)
+                    return ENGINES[k]->cli(argc - a - 1, argv + a + 1);
+            fprintf(stderr, "unknown engine '%s'\n", argv[a + 1]);
+            return 2;
+        }
+        if (strcmp(arg, "--list") == 0)
+        {
+            for (int k = 0; k < NENGINES; k++)
+            {
+                printf("%-8s", ENGINES[k]->name);
+                for (int j = 0; j < ENGINES[k]->nwork; j++)
+                    printf(" %s", ENGINES[k]->work[j].name);
+                putchar('\n');
+            }
+            return 0;
+        }
+        if (strcmp(arg, "--engine") == 0 && more)
+            o.engines = argv[++a];
+        else if (strcmp(arg, "--workload") == 0 && more)
+            o.workloads = argv[++a];
+        else if (strcmp(arg, "--warmup") == 0 && more)
+            o.warmup = atoi(argv[++a]);
+        else if (strcmp(arg, "--reps") == 0 && more)
+            o.reps = atoi(argv[++a]);
+        else if (strcmp(arg, "--hist") == 0)
+            o.hist = 1;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (o.warmup < 0 || o.reps < 1)
+    {
+        usage();
+        return 2;
+    }
+#ifndef ONCHIP_PROFILE
+    if (o.hist)
+    {
+        fprintf(stderr, "--hist needs a build with -DONCHIP_PROFILE\n");
+        return 2;
+    }
+#endif
+
+    int bad = 0, first = 1;
+    printf("{\"warmup\": %d, \"reps\": %d, \"scans\": %ld, \"results\": [\n", o.warmup, o.reps, ONCHIP_SCANS);
+    for (int k = 0; k < NENGINES; k++)
+    {
+        const OnchipEngine *e = ENGINES[k];
+        if (!in_list(o.engines, e->name))
+            continue;
+        for (int j = 0; j < e->nwork; j++)
+        {
+            if (!in_list(o.workloads, e->work[j].name))
+                continue;
+            if (!first)
+                printf(",\n");
+            first = 0;
+            bad |= !bench_one(e, &e->work[j], &o, stdout);
+            fflush(stdout);
+        }
+    }
+    printf("\n]}\n");
+    return bad;
+}
@@ -0,0 +1,136 @@
+/*
+ * onchip_bench.h — library entry points and profiling hooks shared by the
+ * onchip interpreters and the onchip_bench.c harness
+ *
+ * What this provides
+ *  - OnchipEngine: what an interpreter built with -DONCHIP_LIB exports in
+ *    place of main(): load/run/unload over one workload at a time, its
+ *    versions of the standard workloads (see onchip_bench.c), histogram
+ *    labels, and its own command line as cli().
+ *  - Counting allocator: with ONCHIP_LIB, malloc/calloc/realloc/free in the
+ *    including file go through onchip_malloc() and friends, which track live
+ *    and peak bytes and the number of calls in onchip_mem. Engines with their
+ *    own pools (cells, bump heaps) also count each carve with ONCHIP_ALLOC().
+ *  - Histogram: with ONCHIP_PROFILE, ONCHIP_OP(k) (an expression yielding k,
+ *    for dispatch) and ONCHIP_COUNT(k) (a statement) bump onchip_hist[k].
+ *    Without it both compile to nothing, so timing builds are unaffected.
+ *  - The scan workload's input pattern, so the PLC front ends are driven
+ *    identically.
+ *
+ * A standalone interpreter build sees only no-op macros. Include after the
+ * system headers, so their declarations keep the real allocator names:
+ *   #include "onchip_bench.h"
+ */
+
+#ifndef ONCHIP_BENCH_H
+#define ONCHIP_BENCH_H
+
+#include <stddef.h>
+
+#if defined(ONCHIP_PROFILE) && !defined(ONCHIP_LIB)
+#error "ONCHIP_PROFILE needs ONCHIP_LIB (the counters live in onchip_bench.c)"
+#endif
+
+/* ---------------- Engine descriptor ---------------- */
+
+typedef struct
+{
+    const char *name;  /* suite workload: loops, arith, recursion, strings, lists, scan */
+    const char *src;   /* the workload in the engine's own language */
+    double ops;        /* operations one run performs, as the suite counts them */
+    double expect;     /* result every run must produce */
+} OnchipWorkload;
+
+typedef struct
+{
+    const char *name;
+    const OnchipWorkload *work;
+    int nwork;
+    int (*load)(const char *src); /* parse and compile; 0 after a diagnostic */
+    int (*run)(double *result);   /* one run from the loaded program's initial state */
+    void (*unload)(void);
+    const char *const *op_names; /* histogram labels, indexed as counted */
+    int nops;
+    int (*cli)(int argc, char **argv); /* the interpreter's own main() */
+} OnchipEngine;
+
+#define ONCHIP_ENGINES(X) \
+    X(c)                  \
+    X(fortran)            \
+    X(kestrel)            \
+    X(lisp)               \
+    X(lua)                \
+    X(prolog)             \
+    X(plc_ld)             \
+    X(plc_st)             \
+    X(plc_fbd)            \
+    X(plc_sfc)
+
+#define ONCHIP_ENGINE_DECL(e) extern const OnchipEngine onchip_engine_##e;
+ONCHIP_ENGINES(ONCHIP_ENGINE_DECL)
+#undef ONCHIP_ENGINE_DECL
+
+/* ---------------- Allocation accounting ---------------- */
+
+typedef struct
+{
+    size_t live, peak;         /* bytes held through the counting allocator */
+    unsigned long long allocs; /* allocator calls plus ONCHIP_ALLOC() carves */
+} OnchipMem;
+
+#ifdef ONCHIP_LIB
+extern OnchipMem onchip_mem;
+void *onchip_malloc(size_t n);
+void *onchip_calloc(size_t n, size_t size);
+void *onchip_realloc(void *p, size_t n);
+void onchip_free(void *p);
+#ifndef ONCHIP_BENCH_IMPL
+#define malloc onchip_malloc
+#define calloc onchip_calloc
+#define realloc onchip_realloc
+#define free onchip_free
+#endif
+#define ONCHIP_ALLOC() ((void)onchip_mem.allocs++)
+#else
+#define ONCHIP_ALLOC() ((void)0)
+#endif
+
+/* ---------------- Op histogram ---------------- */
+
+#define ONCHIP_HIST_MAX 256
+
+#ifdef ONCHIP_PROFILE
+extern unsigned long long onchip_hist[ONCHIP_HIST_MAX];
+static inline unsigned onchip_op(unsigned k)
+{
+    onchip_hist[k]++;
+    return k;
+}
+#define ONCHIP_OP(k) onchip_op(k)
+#define ONCHIP_COUNT(k) ((void)onchip_hist[k]++)
+#else
+#define ONCHIP_OP(k) (k)
+#define ONCHIP_COUNT(k) ((void)0)
+#endif
+
+/* ---------------- Scan workload ---------------- */
+
+/* Scans per run, 100 ms each. Inputs repeat every 3 s: Start is held from
+   100 to 1500 ms and Stop from 1500 ms on, so a seal-in Motor (and the Lamp
+   that follows it) is on for 14 of every 30 scans. */
+#define ONCHIP_SCANS 100000L
+#define ONCHIP_SCAN_DT_MS 100u
+/* Scans with the Lamp on in one run: the result every scan workload checks */
+#define ONCHIP_SCAN_LAMP_ON                                   \
+    (ONCHIP_SCANS / 30 * 14 + (ONCHIP_SCANS % 30 > 15   ? 14 \
+                               : ONCHIP_SCANS % 30 > 1 ? ONCHIP_SCANS % 30 - 1 \
+                                                       : 0))
+
+static inline void onchip_scan_inputs(long step, int *start, int *stop)
+{
+    long t = (step % 30) * (long)ONCHIP_SCAN_DT_MS;
+    *start = t >= 100 && t < 1500;
+    *stop = t >= 1500;
+}
+
+#endif /* ONCHIP_BENCH_H */
@@ -1,8 +1,22 @@
+/*
+ * C-like subset interpreter: int variables, print, if/else, while.
+ * Programs are lowered to the register VM in onchip_vm.h (shared with
+ * onchip_fortran.c); the original AST walker is kept behind --tree and as
+ * the baseline for --bench.
+ *
+ * Build: gcc -std=c99 -O2 -Wall onchip_c.c -o onchip_c -lm
+ */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdint.h>
+#include <time.h>
+
+/* The subset's int is C's int: 32 bits, wrapping in the VM */
+#define VM_INT int32_t
+#define VM_UINT uint32_t
+#include "onchip_vm.h"
 
 /* ====== Embedded demo program ====== */
 static const char *demo_program =
@@ -982,6 +996,99 @@ static void exec_stmt(Env *E, Stmt *s, int *ok)
     }
 }
 
+/* ====== Lowering to the shared VM ====== */
+
+static IrExpr *lower_expr(Expr *e)
+{
+    switch (e->kind)
+    {
+    case EX_INT:
+        return ir_int(e->value);
+    case EX_VAR:
+        return ir_var(e->var);
+    case EX_UNARY:
+        return ir_un(e->op, lower_expr(e->lhs));
+    default:
+        return ir_bin(e->op, lower_expr(e->lhs), lower_expr(e->rhs));
+    }
+}
+
+static IrStmt *lower_stmt(Stmt *s)
+{
+    switch (s->kind)
+    {
+    case ST_BLOCK:
+    {
+        IrStmt *b = ir_stmt_new(IS_BLOCK);
+        for (int i = 0; i < s->u.block.count; i++)
+            ir_append(b, lower_stmt(s->u.block.items[i]));
+        return b;
+    }
+    case ST_VARDECL:
+        return ir_decl(s->u.vardecl.name, s->u.vardecl.init ? lower_expr(s->u.vardecl.init) : NULL);
+    case ST_ASSIGN:
+        return ir_assign(s->u.assign.name, lower_expr(s->u.assign.value));
+    case ST_PRINT:
+    {
+        IrStmt *p = ir_stmt_new(IS_PRINT);
+        ir_append(p, lower_expr(s->u.print.expr));
+        return p;
+    }
+    case ST_IF:
+        return ir_if(lower_expr(s->u.ifs.cond), lower_stmt(s->u.ifs.then_branch),
+                     lower_stmt(s->u.ifs.else_branch));
+    case ST_WHILE:
+        return ir_while(lower_expr(s->u.whil.cond), lower_stmt(s->u.whil.body));
+    default:
+        return ir_stmt_new(IS_BLOCK);
+    }
+}
+
+static int compile_program(VmProg *vm, Stmt *program)
+{
+    IrLang lang = {VM_MODE_INT, 1};
+    if (ir_compile(vm, lang, lower_stmt(program)) != 0)
+    {
+        fprintf(stderr, "Compile error: program too large for the bytecode VM\n");
+        return 0;
+    }
+    return 1;
+}
+
+/* Runs the compiled program; reports errors as exec_stmt does */
+static int run_program(VmProg *vm)
+{
+    int err = vm_run(vm);
+    const char *name = vm->err_slot >= 0 ? vm->name[vm->err_slot] : "";
+    switch (err)
+    {
+    case VM_OK:
+        return 1;
+    case VM_E_DIV0:
+        fprintf(stderr, "Runtime error: division by zero\n");
+        break;
+    case VM_E_MOD0:
+        fprintf(stderr, "Runtime error: modulo by zero\n");
+        break;
+    case VM_E_UNDEF:
+        fprintf(stderr, "Runtime error: undefined variable '%s'\n", name);
+        break;
+    case VM_E_UNINIT:
+        fprintf(stderr, "Runtime error: uninitialized variable '%s'\n", name);
+        break;
+    case VM_E_REDECL:
+        fprintf(stderr, "Runtime error: redeclaration of '%s'\n", name);
+        break;
+    case VM_E_UNDECL:
+        fprintf(stderr, "Runtime error: assignment to undeclared '%s'\n", name);
+        break;
+    default:
+        fprintf(stderr, "Runtime error: VM error %d\n", err);
+        break;
+    }
+    return 0;
+}
+
 /* ====== Build AST from source ====== */
 
 static Stmt *parse_program(Parser *P)
@@ -1020,8 +1127,138 @@ static char *load_file(const char *path)
     return buf;
 }
 
+static Stmt *parse_source(const char *source)
+{
+    Parser P;
+    lex_init(&P.L, source);
+    lex_next(&P.L);
+    P.had_error = 0;
+    Stmt *program = parse_program(&P);
+    if (P.had_error)
+    {
+        fprintf(stderr, "Aborting due to parse errors.\n");
+        return NULL;
+    }
+    return program;
+}
+
+/* ====== Benchmark: tree walker vs VM ====== */
+
+static const struct
+{
+    const char *name, *src; /* result left in r */
+} BENCH[] = {
+    {"loops", "int r = 0; int i = 0; int j = 0;\n"
+              "while (i < 2000) {\n"
+              "    j = 0;\n"
+              "    while (j < 1000) { r = (r + i * j) % 1000003; j = j + 1; }\n"
+              "    i = i + 1;\n"
+              "}\n"},
+    {"collatz", "int n = 1; int x = 0; int r = 0;\n"
+                "while (n < 30000) {\n"
+                "    x = n;\n"
+                "    while (x != 1) {\n"
+                "        if (x % 2 == 0) { x = x / 2; } else { x = 3 * x + 1; }\n"
+                "        r = r + 1;\n"
+                "    }\n"
+                "    n = n + 1;\n"
+                "}\n"},
+};
+
+static double ms_since(clock_t t0) { return (double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC; }
+
+static int run_bench(void)
+{
+    int bad = 0;
+    printf("%-8s %10s %10s %8s\n", "bench", "tree ms", "vm ms", "speedup");
+    for (size_t b = 0; b < sizeof(BENCH) / sizeof(BENCH[0]); b++)
+    {
+        Stmt *program = parse_source(BENCH[b].src);
+        if (!program)
+            return 1;
+        Env env;
+        env_init(&env);
+        int ok = 1;
+        clock_t t0 = clock();
+        exec_stmt(&env, program, &ok);
+        double tree_ms = ms_since(t0);
+        int tree_r = env.vars[env_find(&env, "r")].value;
+        env_free(&env);
+
+        VmProg vm;
+        t0 = clock();
+        ok &= compile_program(&vm, program) && run_program(&vm); /* compile time included */
+        double vm_ms = ms_since(t0);
+        int same = ok && vm.r[vm_find_var(&vm, "r")].i == tree_r;
+        vm_free(&vm);
+
+        printf("%-8s %10.1f %10.1f %7.1fx%s\n", BENCH[b].name, tree_ms, vm_ms,
+               vm_ms > 0 ? tree_ms / vm_ms : 0.0, same ? "" : "  MISMATCH");
+        bad |= !same;
+    }
+    return bad;
+}
+
+/* ====== Library entry point for onchip_bench.c ====== */
+
+#ifdef ONCHIP_LIB
+/* The suite's workloads this subset can express (no functions, so no
+   recursion); each leaves its result in r */
+static const OnchipWorkload LIB_WORK[] = {
+    {"loops",
+     "int r = 0; int i = 0; int j = 0;\n"
+     "while (i < 1000) {\n"
+     "    j = 0;\n"
+     "    while (j < 1000) { r = r + 1; j = j + 1; }\n"
+     "    i = i + 1;\n"
+     "}\n",
+     1e6, 1e6},
+    {"arith",
+     "int r = 0; int i = 0;\n"
+     "while (i < 200000) { r = r + ((i + 3) * 4 - i * 4 - 11); i = i + 1; }\n",
+     2e5, 2e5},
+};
+
+static VmProg lib_vm;
+
+static int lib_load(const char *src)
+{
+    Stmt *program = parse_source(src);
+    return program && compile_program(&lib_vm, program);
+}
+
+static int lib_run(double *result)
+{
+    if (!run_program(&lib_vm))
+        return 0;
+    *result = lib_vm.r[vm_find_var(&lib_vm, "r")].i;
+    return 1;
+}
+
+static void lib_unload(void) { vm_free(&lib_vm); }
+
+#define main onchip_c_main
+#endif
+
 int main(int argc, char **argv)
 {
+    /* Usage:
+         onchip_c                -> run the embedded demo
+         onchip_c prog.c         -> run a file
+         onchip_c --tree ...     -> same, on the AST walker instead of the VM
+         onchip_c --dis [prog.c] -> list the compiled bytecode
+         onchip_c --bench        -> time tree walker vs VM */
+    int tree = 0, dis = 0;
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+        return run_bench();
+    if (argc > 1 && (strcmp(argv[1], "--tree") == 0 || strcmp(argv[1], "--dis") == 0))
+    {
+        tree = argv[1][2] == 't';
+        dis = !tree;
+        argv++;
+        argc--;
+    }
+
     const char *source = demo_program;
     char *heap_source = NULL;
     if (argc > 1)
@@ -1035,24 +1272,37 @@ int main(int argc, char **argv)
         source = heap_source;
     }
 
-    Parser P;
-    lex_init(&P.L, source);
-    lex_next(&P.L);
-    P.had_error = 0;
-    Stmt *program = parse_program(&P);
-    if (P.had_error)
+    Stmt *program = parse_source(source);
+    if (!program)
     {
-        fprintf(stderr, "Aborting due to parse errors.\n");
         free(heap_source);
         return 2;
     }
 
-    Env env;
-    env_init(&env);
     int ok = 1;
-    exec_stmt(&env, program, &ok);
-    env_free(&env);
+    if (tree)
+    {
+        Env env;
+        env_init(&env);
+        exec_stmt(&env, program, &ok);
+        env_free(&env);
+    }
+    else
+    {
+        VmProg vm;
+        ok = compile_program(&vm, program);
+        if (ok && dis)
+            vm_dis(&vm, stdout);
+        else if (ok)
+            ok = run_program(&vm);
+        vm_free(&vm);
+    }
 
     free(heap_source);
     return ok ? 0 : 3;
 }
+
+#ifdef ONCHIP_LIB
+const OnchipEngine onchip_engine_c = {"c", LIB_WORK, (int)(sizeof(LIB_WORK) / sizeof(LIB_WORK[0])),
+                                      lib_load, lib_run, lib_unload, vm_op_names, VM_OP_COUNT, main};
+#endif
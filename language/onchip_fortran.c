@@ -1,8 +1,20 @@
+/*
+ * Fortran-like subset interpreter: INTEGER/REAL, assignment, PRINT *,
+ * IF/THEN/ELSE/END IF, DO/END DO. Values are REAL throughout, as before.
+ * Programs are lowered to the register VM in onchip_vm.h (shared with
+ * onchip_c.c); the original AST walker is kept behind --tree and as the
+ * baseline for --bench.
+ *
+ * Build: gcc -std=c99 -O2 -Wall onchip_fortran.c -o onchip_fortran -lm
+ */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <time.h>
+
+#include "onchip_vm.h"
 
 /* ===================== Embedded demo program ===================== */
 static const char *demo_program =
@@ -1288,6 +1300,104 @@ static void exec_stmt(Env *E, Stmt *s)
   }
 }
 
+/* ===================== Lowering to the shared VM ===================== */
+
+static IrExpr *lower_expr(Expr *e)
+{
+  switch (e->kind)
+  {
+  case EX_NUM:
+    return ir_real(e->num);
+  case EX_VAR:
+    return ir_var(e->var);
+  case EX_STR:
+    return ir_str(e->s);
+  case EX_UN:
+    return ir_un(e->op, lower_expr(e->a));
+  default:
+    return ir_bin(e->op, lower_expr(e->a), lower_expr(e->b));
+  }
+}
+
+static IrStmt *lower_stmt(Stmt *s)
+{
+  switch (s->kind)
+  {
+  case ST_BLOCK:
+  {
+    IrStmt *b = ir_stmt_new(IS_BLOCK);
+    for (int i = 0; i < s->u.block.count; i++)
+      ir_append(b, lower_stmt(s->u.block.items[i]));
+    return b;
+  }
+  case ST_DECL:
+  {
+    IrStmt *b = ir_stmt_new(IS_BLOCK);
+    for (int i = 0; i < s->u.decl.count; i++)
+      ir_append(b, ir_decl(s->u.decl.names[i], NULL));
+    return b;
+  }
+  case ST_ASSIGN:
+    return ir_assign(s->u.assign.name, lower_expr(s->u.assign.value));
+  case ST_PRINT:
+  {
+    IrStmt *p = ir_stmt_new(IS_PRINT);
+    for (int i = 0; i < s->u.print.count; i++)
+      ir_append(p, lower_expr(s->u.print.items[i]));
+    return p;
+  }
+  case ST_IF:
+    return ir_if(lower_expr(s->u.ifs.cond), lower_stmt(s->u.ifs.thenb), lower_stmt(s->u.ifs.elseb));
+  case ST_DO:
+    return ir_do(s->u.doloop.ivar, lower_expr(s->u.doloop.start), lower_expr(s->u.doloop.end),
+                 lower_expr(s->u.doloop.step), lower_stmt(s->u.doloop.body));
+  default:
+    return ir_stmt_new(IS_BLOCK);
+  }
+}
+
+static int compile_program(VmProg *vm, Stmt *prog)
+{
+  IrLang lang = {VM_MODE_REAL, 0};
+  if (ir_compile(vm, lang, lower_stmt(prog)) != 0)
+  {
+    fprintf(stderr, "Compile: program too large for the bytecode VM\n");
+    return 0;
+  }
+  return 1;
+}
+
+/* Runs the compiled program; reports errors as exec_stmt does */
+static int run_program(VmProg *vm)
+{
+  int err = vm_run(vm);
+  const char *name = vm->err_slot >= 0 ? vm->name[vm->err_slot] : "";
+  switch (err)
+  {
+  case VM_OK:
+    return 1;
+  case VM_E_DIV0:
+    fprintf(stderr, "Runtime: division by zero\n");
+    break;
+  case VM_E_UNDEF:
+    fprintf(stderr, "Runtime: undefined var %s\n", name);
+    break;
+  case VM_E_UNINIT:
+    fprintf(stderr, "Runtime: uninitialized var %s\n", name);
+    break;
+  case VM_E_STEP0:
+    fprintf(stderr, "Runtime: DO step cannot be 0\n");
+    break;
+  case VM_E_STR:
+    fprintf(stderr, "Runtime: string used in numeric context\n");
+    break;
+  default:
+    fprintf(stderr, "Runtime: VM error %d\n", err);
+    break;
+  }
+  return 0;
+}
+
 /* ===================== Driver ===================== */
 
 static char *load_file(const char *path)
@@ -1310,8 +1420,150 @@ static char *load_file(const char *path)
   return buf;
 }
 
+static Stmt *parse_source(const char *src)
+{
+  Parser P;
+  lx_init(&P.L, src);
+  lx_next(&P.L);
+  P.had_error = 0;
+  Stmt *prog = parse_program(&P);
+  if (P.had_error)
+  {
+    fprintf(stderr, "Aborting due to parse errors.\n");
+    return NULL;
+  }
+  return prog;
+}
+
+/* ===================== Benchmark: tree walker vs VM ===================== */
+
+static const struct
+{
+  const char *name, *src; /* result left in R */
+} BENCH[] = {
+    {"kernel", "REAL S\n"
+               "S = 0.0\n"
+               "DO I = 1, 1000\n"
+               "  DO J = 1, 1000\n"
+               "    S = S + I * 0.5 - J / 4.0\n"
+               "  END DO\n"
+               "END DO\n"
+               "R = S\n"},
+    {"leibniz", "P = 0.0\n"
+                "SG = 1.0\n"
+                "DO K = 0, 999999\n"
+                "  P = P + SG / (2 * K + 1)\n"
+                "  SG = -SG\n"
+                "END DO\n"
+                "R = 4 * P\n"},
+    {"triangle", "N = 0\n"
+                 "DO I = 1, 1000\n"
+                 "  DO J = I, 1000\n"
+                 "    IF (I + J .GT. 1000) THEN\n"
+                 "      N = N + 1\n"
+                 "    END IF\n"
+                 "  END DO\n"
+                 "END DO\n"
+                 "R = N\n"},
+};
+
+static double ms_since(clock_t t0) { return (double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC; }
+
+static int run_bench(void)
+{
+  int bad = 0;
+  printf("%-8s %10s %10s %8s\n", "bench", "tree ms", "vm ms", "speedup");
+  for (size_t b = 0; b < sizeof(BENCH) / sizeof(BENCH[0]); b++)
+  {
+    Stmt *prog = parse_source(BENCH[b].src);
+    if (!prog)
+      return 1;
+    Env env;
+    env_init(&env);
+    rt_ok = 1;
+    clock_t t0 = clock();
+    exec_stmt(&env, prog);
+    double tree_ms = ms_since(t0);
+    double tree_r = env.v[env_find(&env, "R")].val;
+    int ok = rt_ok;
+    env_free(&env);
+
+    VmProg vm;
+    t0 = clock();
+    ok &= compile_program(&vm, prog) && run_program(&vm); /* compile time included */
+    double vm_ms = ms_since(t0);
+    int same = ok && vm_get(&vm, vm_find_var(&vm, "R")) == tree_r;
+    vm_free(&vm);
+
+    printf("%-8s %10.1f %10.1f %7.1fx%s\n", BENCH[b].name, tree_ms, vm_ms,
+           vm_ms > 0 ? tree_ms / vm_ms : 0.0, same ? "" : "  MISMATCH");
+    bad |= !same;
+  }
+  return bad;
+}
+
+/* ===================== Library entry point for onchip_bench.c ===================== */
+
+#ifdef ONCHIP_LIB
+/* The suite's workloads this subset can express (no functions, so no
+   recursion); each leaves its result in R */
+static const OnchipWorkload LIB_WORK[] = {
+    {"loops",
+     "R = 0\n"
+     "DO I = 1, 1000\n"
+     "  DO J = 1, 1000\n"
+     "    R = R + 1\n"
+     "  END DO\n"
+     "END DO\n",
+     1e6, 1e6},
+    {"arith",
+     "R = 0\n"
+     "DO I = 0, 199999\n"
+     "  R = R + ((I + 3) * 4 - I * 4 - 11)\n"
+     "END DO\n",
+     2e5, 2e5},
+};
+
+static VmProg lib_vm;
+
+static int lib_load(const char *src)
+{
+  Stmt *prog = parse_source(src);
+  return prog && compile_program(&lib_vm, prog);
+}
+
+static int lib_run(double *result)
+{
+  if (!run_program(&lib_vm))
+    return 0;
+  *result = vm_get(&lib_vm, vm_find_var(&lib_vm, "R"));
+  return 1;
+}
+
+static void lib_unload(void) { vm_free(&lib_vm); }
+
+#define main onchip_fortran_main
+#endif
+
 int main(int argc, char **argv)
 {
+  /* Usage:
+       onchip_fortran                -> run the embedded demo
+       onchip_fortran prog.f         -> run a file
+       onchip_fortran --tree ...     -> same, on the AST walker instead of the VM
+       onchip_fortran --dis [prog.f] -> list the compiled bytecode
+       onchip_fortran --bench        -> time tree walker vs VM */
+  int tree = 0, dis = 0;
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    return run_bench();
+  if (argc > 1 && (strcmp(argv[1], "--tree") == 0 || strcmp(argv[1], "--dis") == 0))
+  {
+    tree = argv[1][2] == 't';
+    dis = !tree;
+    argv++;
+    argc--;
+  }
+
   const char *src = demo_program;
   char *heap = NULL;
   if (argc > 1)
@@ -1325,23 +1577,38 @@ int main(int argc, char **argv)
     src = heap;
   }
 
-  Parser P;
-  lx_init(&P.L, src);
-  lx_next(&P.L);
-  P.had_error = 0;
-  Stmt *prog = parse_program(&P);
-  if (P.had_error)
+  Stmt *prog = parse_source(src);
+  if (!prog)
   {
-    fprintf(stderr, "Aborting due to parse errors.\n");
     free(heap);
     return 2;
   }
 
-  Env env;
-  env_init(&env);
-  rt_ok = 1;
-  exec_stmt(&env, prog);
-  env_free(&env);
+  int ok = 1;
+  if (tree)
+  {
+    Env env;
+    env_init(&env);
+    rt_ok = 1;
+    exec_stmt(&env, prog);
+    env_free(&env);
+    ok = rt_ok;
+  }
+  else
+  {
+    VmProg vm;
+    ok = compile_program(&vm, prog);
+    if (ok && dis)
+      vm_dis(&vm, stdout);
+    else if (ok)
+      ok = run_program(&vm);
+    vm_free(&vm);
+  }
   free(heap);
-  return rt_ok ? 0 : 3;
+  return ok ? 0 : 3;
 }
+
+#ifdef ONCHIP_LIB
+const OnchipEngine onchip_engine_fortran = {"fortran", LIB_WORK, (int)(sizeof(LIB_WORK) / sizeof(LIB_WORK[0])),
+                                            lib_load, lib_run, lib_unload, vm_op_names, VM_OP_COUNT, main};
+#endif
@@ -8,8 +8,14 @@
  *
  * Design:
  *  - Single-pass lexer + Pratt parser for expressions
- *  - Statement execution without an AST (exec/skip walkers)
+ *  - The token array is compiled once to threaded stack code: variables
+ *    become slots, jumps are resolved, constant operands are folded into
+ *    the instruction and comparisons fuse with the branch that tests them
+ *  - The original exec/skip walkers remain behind --walk and as the
+ *    baseline for --bench
  *  - Fixed-size tables, no malloc
+ *
+ * Build: gcc -std=c99 -O2 -Wall onchip_kestrel.c -o kestrel
  */
 
 #include <stdio.h>
@@ -18,12 +24,17 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <time.h>
+
+#include "onchip_bench.h"
 
 /* ---------- Tunables / Limits ---------- */
 #define SRC_MAX 65536u
 #define TOK_MAX 8192u
 #define NAME_MAX 32u
 #define VAR_MAX 512u
+#define CODE_MAX (3u * TOK_MAX)
+#define STACK_MAX 256u
 
 /* ---------- Tokenization ---------- */
 typedef enum
@@ -737,6 +748,638 @@ static void exec_or_skip_block(bool execute)
     }
 }
 
+/* ---------- Threaded code ---------- */
+
+static int32_t k_div(int32_t l, int32_t r)
+{
+    if (r == 0)
+    {
+        die("division by zero");
+    }
+    return (r == -1) ? (int32_t)(0u - (uint32_t)l) : (l / r);
+}
+static int32_t k_mod(int32_t l, int32_t r)
+{
+    if (r == 0)
+    {
+        die("mod by zero");
+    }
+    return (r == -1) ? 0 : (l % r);
+}
+
+/* Binary operators as expressions over l and r. Each has three forms: _S
+   pops both operands, _K takes r from the instruction's constant k, _V from
+   the variable in slot a. */
+#define BINOPS(X)                                \
+    X(ADD, (int32_t)((uint32_t)l + (uint32_t)r)) \
+    X(SUB, (int32_t)((uint32_t)l - (uint32_t)r)) \
+    X(MUL, (int32_t)((uint32_t)l * (uint32_t)r)) \
+    X(DIV, k_div(l, r))                          \
+    X(MOD, k_mod(l, r))                          \
+    X(LT, (l < r) ? 1 : 0)                       \
+    X(LE, (l <= r) ? 1 : 0)                      \
+    X(GT, (l > r) ? 1 : 0)                       \
+    X(GE, (l >= r) ? 1 : 0)                      \
+    X(EQ, (l == r) ? 1 : 0)                      \
+    X(NE, (l != r) ? 1 : 0)                      \
+    X(AND, ((l != 0) && (r != 0)) ? 1 : 0)       \
+    X(OR, ((l != 0) || (r != 0)) ? 1 : 0)
+
+/* Compare-and-branch, in BINOPS order: JT<rel> pops l (and r for _S) and
+   jumps to a when (l rel r). The _V form keeps its variable slot in k. */
+#define RELOPS(X) X(LT, <) X(LE, <=) X(GT, >) X(GE, >=) X(EQ, ==) X(NE, !=)
+
+#define OP_BIN3(o, expr) OP_##o##_S, OP_##o##_K, OP_##o##_V,
+#define OP_JT3(o, cmp) OP_JT##o##_S, OP_JT##o##_K, OP_JT##o##_V,
+#define NAME_BIN3(o, expr) #o "_S", #o "_K", #o "_V",
+#define NAME_JT3(o, cmp) "JT" #o "_S", "JT" #o "_K", "JT" #o "_V",
+typedef enum
+{
+    OP_HALT,
+    OP_PUSHK, /* push k */
+    OP_LOADV, /* push var[a] */
+    OP_STORE, /* var[a] = pop */
+    OP_NEG,
+    OP_NOT,
+    OP_PRINT, /* print pop */
+    OP_JMP,   /* goto a */
+    OP_JZ,    /* if pop == 0 goto a */
+    OP_JNZ,   /* if pop != 0 goto a */
+    BINOPS(OP_BIN3)
+    RELOPS(OP_JT3)
+    OP_COUNT
+} OpCode;
+static const char *const g_op_names[] = {"HALT", "PUSHK", "LOADV", "STORE", "NEG", "NOT", "PRINT", "JMP", "JZ", "JNZ",
+                                         BINOPS(NAME_BIN3) RELOPS(NAME_JT3)};
+
+typedef struct
+{
+    uint16_t op;
+    uint16_t a; /* variable slot or jump target */
+    int32_t k;  /* constant */
+} Insn;
+
+static Insn g_code[CODE_MAX];
+static uint32_t g_ncode = 0u;
+static uint32_t g_depth = 0u; /* operand stack depth while compiling */
+
+/* ---------- Compiler: tokens -> threaded code ---------- */
+
+#define NO_JUMP 0xFFFFFFFFu
+
+static uint32_t emit_op(OpCode op, uint32_t a, int32_t k)
+{
+    if (g_ncode >= CODE_MAX)
+    {
+        die("program too large");
+    }
+    g_code[g_ncode].op = (uint16_t)op;
+    g_code[g_ncode].a = (uint16_t)a;
+    g_code[g_ncode].k = k;
+    return g_ncode++;
+}
+
+static void emit_push(OpCode op, uint32_t a, int32_t k)
+{
+    g_depth++;
+    if (g_depth > STACK_MAX)
+    {
+        die("expression too deep");
+    }
+    (void)emit_op(op, a, k);
+}
+
+/* The instruction `back` places before the end. Right after an operand is
+   compiled this is its final instruction; expressions contain no jumps, so
+   peepholes may rewrite or drop it. */
+static Insn *last_insn(uint32_t back)
+{
+    return (g_ncode > back) ? &g_code[g_ncode - 1u - back] : NULL;
+}
+
+static int32_t apply_binop(OpCode base, int32_t l, int32_t r)
+{
+    switch (base)
+    {
+#define APPLY(o, expr) \
+    case OP_##o##_S:   \
+        return (expr);
+        BINOPS(APPLY)
+#undef APPLY
+    default:
+        die("unexpected binary operator");
+        return 0;
+    }
+}
+
+/* A binary operator: fold two constants (unless it would trap, which is
+   left to run time), fuse a constant or variable right operand into the
+   _K/_V form, else the stack form */
+static void emit_binop(OpCode base)
+{
+    Insn *r = last_insn(0u);
+    Insn *l = last_insn(1u);
+    g_depth--;
+    if ((r != NULL) && (r->op == OP_PUSHK))
+    {
+        bool traps = ((base == OP_DIV_S) || (base == OP_MOD_S)) && (r->k == 0);
+        if ((l != NULL) && (l->op == OP_PUSHK) && !traps)
+        {
+            l->k = apply_binop(base, l->k, r->k);
+            g_ncode--;
+            return;
+        }
+        r->op = (uint16_t)(base + 1);
+        return;
+    }
+    if ((r != NULL) && (r->op == OP_LOADV))
+    {
+        r->op = (uint16_t)(base + 2);
+        return;
+    }
+    (void)emit_op(base, 0u, 0);
+}
+
+static void emit_unop(OpCode op)
+{
+    Insn *v = last_insn(0u);
+    if ((v != NULL) && (v->op == OP_PUSHK))
+    {
+        v->k = (op == OP_NEG) ? (int32_t)(0u - (uint32_t)v->k) : ((v->k == 0) ? 1 : 0);
+        return;
+    }
+    (void)emit_op(op, 0u, 0);
+}
+
+/* Pop the condition just compiled and jump to target when its truth equals
+   sense. A comparison fuses into JT<rel> (negated for sense == false), a
+   constant into an unconditional jump or nothing. Returns the jump's index
+   for patching, NO_JUMP if none was emitted. */
+static uint32_t emit_cond_jump(bool sense, uint32_t target)
+{
+    static const uint8_t negate[6] = {3u, 2u, 1u, 0u, 5u, 4u}; /* LT->GE, LE->GT, ... */
+    Insn *c = last_insn(0u);
+    g_depth--;
+    if ((c != NULL) && (c->op == OP_PUSHK))
+    {
+        bool truth = (c->k != 0);
+        g_ncode--;
+        return (truth == sense) ? emit_op(OP_JMP, target, 0) : NO_JUMP;
+    }
+    if ((c != NULL) && (c->op >= (uint16_t)OP_LT_S) && (c->op <= (uint16_t)OP_NE_V))
+    {
+        uint32_t rel = ((uint32_t)c->op - (uint32_t)OP_LT_S) / 3u;
+        uint32_t form = ((uint32_t)c->op - (uint32_t)OP_LT_S) % 3u;
+        if (!sense)
+        {
+            rel = negate[rel];
+        }
+        if (form == 2u)
+        {
+            c->k = (int32_t)c->a;
+        }
+        c->op = (uint16_t)((uint32_t)OP_JTLT_S + (rel * 3u) + form);
+        c->a = (uint16_t)target;
+        return g_ncode - 1u;
+    }
+    return emit_op(sense ? OP_JNZ : OP_JZ, target, 0);
+}
+
+static void patch_jump(uint32_t at)
+{
+    if (at != NO_JUMP)
+    {
+        g_code[at].a = (uint16_t)g_ncode;
+    }
+}
+
+static void emit_store(int idx)
+{
+    (void)emit_op(OP_STORE, (uint32_t)idx, 0);
+    g_depth--;
+}
+
+static void compile_expr_prec(Prec prec);
+
+static void compile_unary(void)
+{
+    Token *t = cur();
+    if (accept(T_BANG))
+    {
+        compile_unary();
+        emit_unop(OP_NOT);
+    }
+    else if (accept(T_MINUS))
+    {
+        compile_unary();
+        emit_unop(OP_NEG);
+    }
+    else if (accept(T_INT) || accept(T_TRUE) || accept(T_FALSE))
+    {
+        emit_push(OP_PUSHK, 0u, (t->kind == T_INT) ? t->ival : ((t->kind == T_TRUE) ? 1 : 0));
+    }
+    else if (accept(T_LPAREN))
+    {
+        compile_expr_prec(PREC_LOWEST);
+        expect(T_RPAREN, "missing )");
+    }
+    else if (accept(T_IDENT))
+    {
+        emit_push(OP_LOADV, (uint32_t)ensure_var(t->start, t->len), 0);
+    }
+    else
+    {
+        die("expected primary expression");
+    }
+}
+
+static OpCode binop_of(TokKind k)
+{
+    switch (k)
+    {
+    case T_PLUS:
+        return OP_ADD_S;
+    case T_MINUS:
+        return OP_SUB_S;
+    case T_STAR:
+        return OP_MUL_S;
+    case T_SLASH:
+        return OP_DIV_S;
+    case T_PERCENT:
+        return OP_MOD_S;
+    case T_LT:
+        return OP_LT_S;
+    case T_LE:
+        return OP_LE_S;
+    case T_GT:
+        return OP_GT_S;
+    case T_GE:
+        return OP_GE_S;
+    case T_EQ:
+        return OP_EQ_S;
+    case T_NE:
+        return OP_NE_S;
+    case T_AND:
+        return OP_AND_S;
+    default:
+        return OP_OR_S;
+    }
+}
+
+/* Same grammar as parse_expr_prec; like it, && and || evaluate both sides */
+static void compile_expr_prec(Prec prec)
+{
+    compile_unary();
+    for (;;)
+    {
+        TokKind k = cur()->kind;
+        int p = precedence_of(k);
+        if ((p < 0) || (p < (int)prec))
+        {
+            break;
+        }
+        g_ix++;
+        compile_expr_prec((Prec)(p + 1));
+        emit_binop(binop_of(k));
+    }
+}
+
+static void compile_block(void);
+
+static void compile_stmt(void)
+{
+    /* let IDENT = expr ; */
+    if (accept(T_LET))
+    {
+        Token *id = cur();
+        expect(T_IDENT, "expected identifier after let");
+        int idx = ensure_var(id->start, id->len);
+        expect(T_ASSIGN, "missing '=' after identifier");
+        compile_expr_prec(PREC_LOWEST);
+        expect(T_SEMI, "missing ';' after expression");
+        emit_store(idx);
+        return;
+    }
+
+    /* if (...) block [ else block ] */
+    if (accept(T_IF))
+    {
+        expect(T_LPAREN, "missing '(' after if");
+        compile_expr_prec(PREC_LOWEST);
+        expect(T_RPAREN, "missing ')' after if condition");
+        uint32_t to_else = emit_cond_jump(false, 0u);
+        compile_block();
+        if (accept(T_ELSE))
+        {
+            uint32_t to_end = emit_op(OP_JMP, 0u, 0);
+            patch_jump(to_else);
+            compile_block();
+            patch_jump(to_end);
+        }
+        else
+        {
+            patch_jump(to_else);
+        }
+        return;
+    }
+
+    /* while (...) { ... }: test on entry, then at the bottom of the body */
+    if (accept(T_WHILE))
+    {
+        expect(T_LPAREN, "missing '(' after while");
+        uint32_t cond_pos = g_ix;
+        compile_expr_prec(PREC_LOWEST);
+        expect(T_RPAREN, "missing ')' after while condition");
+        expect(T_LBRACE, "missing '{' after while(...)");
+        uint32_t to_exit = emit_cond_jump(false, 0u);
+        uint32_t top = g_ncode;
+        while (!accept(T_RBRACE))
+        {
+            if (cur()->kind == T_EOF)
+            {
+                die("unclosed { in while");
+            }
+            compile_stmt();
+        }
+        uint32_t after = g_ix;
+        g_ix = cond_pos;
+        compile_expr_prec(PREC_LOWEST);
+        (void)emit_cond_jump(true, top);
+        g_ix = after;
+        patch_jump(to_exit);
+        return;
+    }
+
+    /* print(expr); */
+    if (accept(T_PRINT))
+    {
+        expect(T_LPAREN, "missing '(' after print");
+        compile_expr_prec(PREC_LOWEST);
+        expect(T_RPAREN, "missing ')' after print(expr)");
+        expect(T_SEMI, "missing ';' after print(...)");
+        (void)emit_op(OP_PRINT, 0u, 0);
+        g_depth--;
+        return;
+    }
+
+    /* block or single statement as block */
+    if (accept(T_LBRACE))
+    {
+        while (!accept(T_RBRACE))
+        {
+            compile_stmt();
+        }
+        return;
+    }
+
+    /* IDENT = expr ; */
+    if (cur()->kind == T_IDENT)
+    {
+        Token *id = cur();
+        g_ix++;
+        int idx = ensure_var(id->start, id->len);
+        expect(T_ASSIGN, "missing '=' in assignment");
+        compile_expr_prec(PREC_LOWEST);
+        expect(T_SEMI, "missing ';' after assignment");
+        emit_store(idx);
+        return;
+    }
+
+    die("unexpected statement");
+}
+
+static void compile_block(void)
+{
+    if (accept(T_LBRACE))
+    {
+        while (!accept(T_RBRACE))
+        {
+            compile_stmt();
+        }
+    }
+    else
+    {
+        compile_stmt();
+    }
+}
+
+static void compile_program(void)
+{
+    g_ncode = 0u;
+    g_depth = 0u;
+    g_ix = 0u;
+    while (cur()->kind != T_EOF)
+    {
+        compile_stmt();
+    }
+    (void)emit_op(OP_HALT, 0u, 0);
+}
+
+/* ---------- VM ---------- */
+
+static void print_value(int32_t v)
+{
+    if (v == 0)
+    {
+        printf("false\n");
+    }
+    else if (v == 1)
+    {
+        printf("true\n");
+    }
+    else
+    {
+        printf("%d\n", v);
+    }
+}
+
+/* Stack machine with the top of stack cached in tos. stack[1] is the
+   bottom; the slot below it absorbs the stale tos of the first push. */
+static void run_code(void)
+{
+    int32_t stack[STACK_MAX + 2u];
+    int32_t *sp = &stack[1];
+    int32_t tos = 0;
+    const Insn *code = g_code;
+    const Insn *pc = code;
+    const Insn *i;
+    Var *v = g_vars;
+    stack[1] = 0;
+
+#ifdef __GNUC__
+#define LBL_BIN3(o, expr) &&L_##o##_S, &&L_##o##_K, &&L_##o##_V,
+#define LBL_JT3(o, cmp) &&L_JT##o##_S, &&L_JT##o##_K, &&L_JT##o##_V,
+    static const void *const labels[] = {&&L_HALT, &&L_PUSHK, &&L_LOADV, &&L_STORE, &&L_NEG, &&L_NOT,
+                                         &&L_PRINT, &&L_JMP, &&L_JZ, &&L_JNZ,
+                                         BINOPS(LBL_BIN3) RELOPS(LBL_JT3)};
+#define CASE(o) L_##o
+#define NEXT() goto *labels[ONCHIP_OP((i = pc++)->op)]
+#else
+#define CASE(o) case OP_##o
+#define NEXT() goto dispatch
+#endif
+#define RUN_BIN3(o, expr)                   \
+    CASE(o##_S) :                           \
+    {                                       \
+        int32_t l = *sp--;                  \
+        int32_t r = tos;                    \
+        tos = (expr);                       \
+        NEXT();                             \
+    }                                       \
+    CASE(o##_K) :                           \
+    {                                       \
+        int32_t l = tos;                    \
+        int32_t r = i->k;                   \
+        tos = (expr);                       \
+        NEXT();                             \
+    }                                       \
+    CASE(o##_V) :                           \
+    {                                       \
+        int32_t l = tos;                    \
+        int32_t r = v[i->a].value;          \
+        tos = (expr);                       \
+        NEXT();                             \
+    }
+#define RUN_JT3(o, cmp)                     \
+    CASE(JT##o##_S) :                       \
+    {                                       \
+        bool t = (*sp cmp tos);             \
+        tos = sp[-1];                       \
+        sp -= 2;                            \
+        if (t)                              \
+        {                                   \
+            pc = code + i->a;               \
+        }                                   \
+        NEXT();                             \
+    }                                       \
+    CASE(JT##o##_K) :                       \
+    {                                       \
+        bool t = (tos cmp i->k);            \
+        tos = *sp--;                        \
+        if (t)                              \
+        {                                   \
+            pc = code + i->a;               \
+        }                                   \
+        NEXT();                             \
+    }                                       \
+    CASE(JT##o##_V) :                       \
+    {                                       \
+        bool t = (tos cmp v[i->k].value);   \
+        tos = *sp--;                        \
+        if (t)                              \
+        {                                   \
+            pc = code + i->a;               \
+        }                                   \
+        NEXT();                             \
+    }
+
+    NEXT();
+#ifndef __GNUC__
+dispatch:
+    i = pc++;
+    switch ((OpCode)ONCHIP_OP(i->op))
+#endif
+    {
+    CASE(HALT):
+        return;
+    CASE(PUSHK):
+        *++sp = tos;
+        tos = i->k;
+        NEXT();
+    CASE(LOADV):
+        *++sp = tos;
+        tos = v[i->a].value;
+        NEXT();
+    CASE(STORE):
+        v[i->a].value = tos;
+        tos = *sp--;
+        NEXT();
+    CASE(NEG):
+        tos = (int32_t)(0u - (uint32_t)tos);
+        NEXT();
+    CASE(NOT):
+        tos = (tos == 0) ? 1 : 0;
+        NEXT();
+    CASE(PRINT):
+        print_value(tos);
+        tos = *sp--;
+        NEXT();
+    CASE(JMP):
+        pc = code + i->a;
+        NEXT();
+    CASE(JZ):
+    {
+        int32_t c = tos;
+        tos = *sp--;
+        if (c == 0)
+        {
+            pc = code + i->a;
+        }
+        NEXT();
+    }
+    CASE(JNZ):
+    {
+        int32_t c = tos;
+        tos = *sp--;
+        if (c != 0)
+        {
+            pc = code + i->a;
+        }
+        NEXT();
+    }
+        BINOPS(RUN_BIN3)
+        RELOPS(RUN_JT3)
+#ifndef __GNUC__
+    default:
+        die("bad opcode");
+#endif
+    }
+#undef CASE
+#undef NEXT
+#undef RUN_BIN3
+#undef RUN_JT3
+}
+
+static void disassemble(void)
+{
+    for (uint32_t pc = 0u; pc < g_ncode; pc++)
+    {
+        const Insn *i = &g_code[pc];
+        uint32_t op = (uint32_t)i->op;
+        printf("%5u  %-9s", (unsigned)pc, g_op_names[op]);
+        if ((op == (uint32_t)OP_LOADV) || (op == (uint32_t)OP_STORE))
+        {
+            printf(" %s", g_vars[i->a].name);
+        }
+        else if (op == (uint32_t)OP_PUSHK)
+        {
+            printf(" %d", i->k);
+        }
+        else if (op >= (uint32_t)OP_ADD_S)
+        {
+            bool jump = (op >= (uint32_t)OP_JTLT_S);
+            uint32_t form = (op - (uint32_t)(jump ? OP_JTLT_S : OP_ADD_S)) % 3u;
+            if (form == 1u)
+            {
+                printf(" %d", i->k);
+            }
+            else if (form == 2u)
+            {
+                printf(" %s", g_vars[jump ? (uint32_t)i->k : (uint32_t)i->a].name);
+            }
+            if (jump)
+            {
+                printf(" -> %u", (unsigned)i->a);
+            }
+        }
+        else if (op >= (uint32_t)OP_JMP)
+        {
+            printf(" -> %u", (unsigned)i->a);
+        }
+        putchar('\n');
+    }
+}
+
 /* ---------- Embedded demo program ---------- */
 
 static const char *demo_program =
@@ -756,7 +1399,7 @@ static const char *demo_program =
 
 static char g_buf[SRC_MAX];
 
-static void run_source(const char *src)
+static void load_source(const char *src)
 {
     g_src = src;
     g_len = (uint32_t)strlen(src);
@@ -764,14 +1407,141 @@ static void run_source(const char *src)
     lex();
     g_ix = 0u;
     memset(g_vars, 0, sizeof(g_vars));
+}
+
+static void walk_source(const char *src)
+{
+    load_source(src);
     while (cur()->kind != T_EOF)
     {
         exec_or_skip_stmt(true);
     }
 }
 
+static void run_source(const char *src)
+{
+    load_source(src);
+    compile_program();
+    run_code();
+}
+
+/* ---------- Benchmark ---------- */
+
+static const char *const bench_names[] = {"sum", "nested"};
+static const char *const bench_programs[] = {
+    "let i = 0; let s = 0;\n"
+    "while (i < 1000000) { s = (s + i * 7) % 1000003; i = i + 1; }\n",
+    "let s = 0; let i = 0;\n"
+    "while (i < 1000) {\n"
+    "  let j = 0;\n"
+    "  while (j < 1000) { if (i % 7 == j % 5) { s = s + 1; } j = j + 1; }\n"
+    "  i = i + 1;\n"
+    "}\n"};
+
+static double ms_since(clock_t t0)
+{
+    return ((double)(clock() - t0) * 1000.0) / (double)CLOCKS_PER_SEC;
+}
+
+static int32_t result_s(void)
+{
+    int idx = find_var("s", 1u);
+    return (idx >= 0) ? g_vars[idx].value : 0;
+}
+
+static int run_bench(void)
+{
+    int bad = 0;
+    printf("%-8s %10s %10s %8s\n", "bench", "walk ms", "code ms", "speedup");
+    for (uint32_t b = 0u; b < (uint32_t)(sizeof(bench_programs) / sizeof(bench_programs[0])); b++)
+    {
+        clock_t t0 = clock();
+        walk_source(bench_programs[b]);
+        double walk_ms = ms_since(t0);
+        int32_t walk_s = result_s();
+
+        t0 = clock();
+        run_source(bench_programs[b]);
+        double code_ms = ms_since(t0);
+        bool same = (result_s() == walk_s);
+
+        printf("%-8s %10.1f %10.1f %7.1fx%s\n", bench_names[b], walk_ms, code_ms,
+               (code_ms > 0.0) ? (walk_ms / code_ms) : 0.0, same ? "" : "  MISMATCH");
+        if (!same)
+        {
+            bad = 1;
+        }
+    }
+    return bad;
+}
+
+/* ---------- Library entry point for onchip_bench.c ---------- */
+
+#ifdef ONCHIP_LIB
+/* The suite's workloads the language can express (no functions, so no
+   recursion); each leaves its result in r */
+static const OnchipWorkload lib_work[] = {
+    {"loops",
+     "let r = 0; let i = 0;\n"
+     "while (i < 1000) {\n"
+     "  let j = 0;\n"
+     "  while (j < 1000) { r = r + 1; j = j + 1; }\n"
+     "  i = i + 1;\n"
+     "}\n",
+     1e6, 1e6},
+    {"arith",
+     "let r = 0; let i = 0;\n"
+     "while (i < 200000) { r = r + ((i + 3) * 4 - i * 4 - 11); i = i + 1; }\n",
+     2e5, 2e5},
+};
+
+/* The source must outlive the program: tokens point into it */
+static int lib_load(const char *src)
+{
+    load_source(src);
+    compile_program();
+    return 1;
+}
+
+static int lib_run(double *result)
+{
+    int idx;
+    run_code();
+    idx = find_var("r", 1u);
+    *result = (idx >= 0) ? (double)g_vars[idx].value : 0.0;
+    return idx >= 0;
+}
+
+static void lib_unload(void)
+{
+}
+
+#define main onchip_kestrel_main
+#endif
+
 int main(int argc, char **argv)
 {
+    /* Usage:
+         kestrel                -> run the embedded demo
+         kestrel prog.k         -> run a file
+         kestrel --walk ...     -> same, on the exec/skip walkers
+         kestrel --dis [prog.k] -> list the compiled code
+         kestrel --bench        -> time walkers vs compiled code */
+    bool walk = false;
+    bool dis = false;
+    if ((argc >= 2) && (strcmp(argv[1], "--bench") == 0))
+    {
+        return run_bench();
+    }
+    if ((argc >= 2) && ((strcmp(argv[1], "--walk") == 0) || (strcmp(argv[1], "--dis") == 0)))
+    {
+        walk = (argv[1][2] == 'w');
+        dis = !walk;
+        argv++;
+        argc--;
+    }
+
+    const char *src = demo_program;
     if (argc >= 2)
     {
         FILE *f = fopen(argv[1], "rb");
@@ -783,12 +1553,31 @@ int main(int argc, char **argv)
         size_t n = fread(g_buf, 1, (size_t)(SRC_MAX - 1u), f);
         fclose(f);
         g_buf[n] = '\0';
-        run_source(g_buf);
+        src = g_buf;
     }
-    else
+    else if (!dis)
     {
         puts("== Kestrel demo ==");
-        run_source(demo_program);
+    }
+
+    if (walk)
+    {
+        walk_source(src);
+    }
+    else if (dis)
+    {
+        load_source(src);
+        compile_program();
+        disassemble();
+    }
+    else
+    {
+        run_source(src);
     }
     return 0;
 }
+
+#ifdef ONCHIP_LIB
+const OnchipEngine onchip_engine_kestrel = {"kestrel", lib_work, (int)(sizeof(lib_work) / sizeof(lib_work[0])),
+                                            lib_load, lib_run, lib_unload, g_op_names, (int)OP_COUNT, main};
+#endif
@@ -2,6 +2,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#include "onchip_bench.h"
 
 /* ================= Embedded demo program ================= */
 static const char *demo_program =
@@ -40,12 +45,15 @@ typedef enum
     T_STR,
     T_CONS,
     T_FUNC,
-    T_LAMBDA
+    T_LAMBDA,
+    T_ENV, /* heap cell holding an Env */
+    T_FREE /* heap cell on the free list */
 } LType;
 
 struct LVal
 {
     LType t;
+    unsigned char mark;
     union
     {
         double num;
@@ -69,11 +77,18 @@ struct LVal
     } u;
 };
 
+typedef struct
+{
+    LVal *sym; /* interned: compared by pointer */
+    LVal *val;
+} EnvSlot;
+
 struct Env
 {
+    LType t; /* same leading fields as LVal: envs are heap cells too */
+    unsigned char mark;
     struct Env *parent;
-    char **names;
-    LVal **vals;
+    EnvSlot *slots;
     int count, cap;
 };
 
@@ -97,32 +112,373 @@ static char *strdup2(const char *s)
     return p;
 }
 
+/* Integers that fit are tagged immediates (low pointer bit set) */
+#define IS_FIX(v) (((uintptr_t)(v)) & 1)
+#define FIX_MAX (INTPTR_MAX >> 1)
+#define FIX_MIN (-FIX_MAX - 1)
+static LType type_of(const LVal *v) { return IS_FIX(v) ? T_NUM : v->t; }
+static double num_of(const LVal *v) { return IS_FIX(v) ? (double)((intptr_t)(uintptr_t)v >> 1) : v->u.num; }
+
+/* =============== Heap and garbage collector =============== */
+/* Every LVal and Env lives in a 32-byte cell carved from fixed-size chunks and
+   recycled through one free list. Variable-size payloads (string bytes, env
+   slot arrays) come from power-of-two size classes of 16..512 bytes with their
+   own free lists; bigger ones fall back to malloc. Symbols, builtins and NIL
+   are permanent and live outside the heap.
+
+   Collection is mark-sweep, run when the free list is empty. Roots are the
+   global env plus two shadow stacks of addresses of C locals that hold heap
+   values across an allocation (protect / protect_env). eval, apply and the
+   reader save the stack depth on entry and restore it on exit, so a frame's
+   roots need no matching pops. When a collection leaves less than half the
+   heap free, it grows by whole chunks, up to --heap-max. */
+#ifndef LISP_CHUNK_CELLS
+#define LISP_CHUNK_CELLS 1024 /* 32 KB chunks on 64-bit targets */
+#endif
+#define BLOB_CLASSES 6 /* 16, 32, .. 512 bytes */
+#define BLOB_PAGE 4096
+
+typedef union Cell
+{
+    LVal v;
+    Env e;
+} Cell;
+
+typedef struct Chunk
+{
+    struct Chunk *next;
+    Cell cells[LISP_CHUNK_CELLS];
+} Chunk;
+
+static struct
+{
+    Chunk *chunks;
+    Cell *free_list; /* linked through v.u.cons.cdr */
+    size_t ncells, nfree;
+    size_t max_bytes; /* cell chunks + blob pages; 0 = unlimited */
+    void *blob_free[BLOB_CLASSES];
+    size_t blob_pages, blob_big;
+    LVal ***vroots;
+    Env ***eroots;
+    int nvroots, capvroots, neroots, caperoots;
+    Env *global;
+    Cell **mark_stack;
+    size_t mark_sp, mark_cap;
+    int stress; /* collect on every allocation (debugging roots) */
+    /* statistics */
+    unsigned long collections;
+    double pause_total_ms, pause_max_ms;
+    size_t peak_live_cells, peak_bytes, last_live_cells;
+} heap;
+
+static size_t heap_bytes(void)
+{
+    return heap.ncells / LISP_CHUNK_CELLS * sizeof(Chunk) + heap.blob_pages * BLOB_PAGE + heap.blob_big;
+}
+
+static void protect(LVal **p)
+{
+    if (heap.nvroots == heap.capvroots)
+    {
+        heap.capvroots = heap.capvroots ? heap.capvroots * 2 : 256;
+        heap.vroots = (LVal ***)realloc(heap.vroots, (size_t)heap.capvroots * sizeof(*heap.vroots));
+        if (!heap.vroots)
+        {
+            fprintf(stderr, "OOM\n");
+            exit(1);
+        }
+    }
+    heap.vroots[heap.nvroots++] = p;
+}
+static void protect_env(Env **p)
+{
+    if (heap.neroots == heap.caperoots)
+    {
+        heap.caperoots = heap.caperoots ? heap.caperoots * 2 : 256;
+        heap.eroots = (Env ***)realloc(heap.eroots, (size_t)heap.caperoots * sizeof(*heap.eroots));
+        if (!heap.eroots)
+        {
+            fprintf(stderr, "OOM\n");
+            exit(1);
+        }
+    }
+    heap.eroots[heap.neroots++] = p;
+}
+
+/* blobs: size-class payload allocator */
+static int blob_class(size_t n)
+{
+    int c = 0;
+    for (size_t sz = 16; sz < n; sz <<= 1)
+        c++;
+    return c;
+}
+static void *blob_alloc(size_t n)
+{
+    int c = blob_class(n);
+    if (c >= BLOB_CLASSES)
+    {
+        heap.blob_big += n;
+        return xmalloc(n);
+    }
+    if (!heap.blob_free[c])
+    {
+        size_t sz = (size_t)16 << c;
+        char *page = (char *)xmalloc(BLOB_PAGE);
+        heap.blob_pages++;
+        for (size_t off = 0; off + sz <= BLOB_PAGE; off += sz)
+        {
+            *(void **)(page + off) = heap.blob_free[c];
+            heap.blob_free[c] = page + off;
+        }
+        if (heap_bytes() > heap.peak_bytes)
+            heap.peak_bytes = heap_bytes();
+    }
+    void *p = heap.blob_free[c];
+    heap.blob_free[c] = *(void **)p;
+    ONCHIP_ALLOC();
+    return p;
+}
+static void blob_release(void *p, size_t n)
+{
+    if (!p)
+        return;
+    int c = blob_class(n);
+    if (c >= BLOB_CLASSES)
+    {
+        heap.blob_big -= n;
+        free(p);
+        return;
+    }
+    *(void **)p = heap.blob_free[c];
+    heap.blob_free[c] = p;
+}
+
+static void heap_grow(void)
+{
+    Chunk *ch = (Chunk *)xmalloc(sizeof *ch);
+    ch->next = heap.chunks;
+    heap.chunks = ch;
+    for (int i = LISP_CHUNK_CELLS - 1; i >= 0; i--)
+    {
+        Cell *c = &ch->cells[i];
+        c->v.t = T_FREE;
+        c->v.mark = 0;
+        c->v.u.cons.cdr = (LVal *)heap.free_list;
+        heap.free_list = c;
+    }
+    heap.ncells += LISP_CHUNK_CELLS;
+    heap.nfree += LISP_CHUNK_CELLS;
+    if (heap_bytes() > heap.peak_bytes)
+        heap.peak_bytes = heap_bytes();
+}
+
+/* Only heap cells are marked: immediates and permanent values are skipped */
+static void mark_push(void *p)
+{
+    Cell *c = (Cell *)p;
+    if (!c || IS_FIX(c) || c->v.mark || c->v.t == T_NIL || c->v.t == T_SYM || c->v.t == T_FUNC)
+        return;
+    c->v.mark = 1;
+    if (c->v.t == T_NUM || c->v.t == T_STR)
+        return; /* nothing to trace */
+    if (heap.mark_sp == heap.mark_cap)
+    {
+        heap.mark_cap = heap.mark_cap ? heap.mark_cap * 2 : 1024;
+        heap.mark_stack = (Cell **)realloc(heap.mark_stack, heap.mark_cap * sizeof(Cell *));
+        if (!heap.mark_stack)
+        {
+            fprintf(stderr, "OOM\n");
+            exit(1);
+        }
+    }
+    heap.mark_stack[heap.mark_sp++] = c;
+}
+
+static void gc_mark(void)
+{
+    mark_push(heap.global);
+    for (int i = 0; i < heap.nvroots; i++)
+        mark_push(*heap.vroots[i]);
+    for (int i = 0; i < heap.neroots; i++)
+        mark_push(*heap.eroots[i]);
+    while (heap.mark_sp)
+    {
+        Cell *c = heap.mark_stack[--heap.mark_sp];
+        switch (c->v.t)
+        {
+        case T_CONS:
+            mark_push(c->v.u.cons.car);
+            mark_push(c->v.u.cons.cdr);
+            break;
+        case T_LAMBDA:
+            mark_push(c->v.u.lam.params);
+            mark_push(c->v.u.lam.body);
+            mark_push(c->v.u.lam.env);
+            break;
+        case T_ENV:
+            mark_push(c->e.parent);
+            for (int i = 0; i < c->e.count; i++)
+                mark_push(c->e.slots[i].val);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void gc_sweep(void)
+{
+    size_t live = 0;
+    for (Chunk *ch = heap.chunks; ch; ch = ch->next)
+        for (int i = 0; i < LISP_CHUNK_CELLS; i++)
+        {
+            Cell *c = &ch->cells[i];
+            if (c->v.t == T_FREE)
+                continue;
+            if (c->v.mark)
+            {
+                c->v.mark = 0;
+                live++;
+                continue;
+            }
+            if (c->v.t == T_STR)
+                blob_release(c->v.u.str, strlen(c->v.u.str) + 1);
+            else if (c->v.t == T_ENV)
+                blob_release(c->e.slots, (size_t)c->e.cap * sizeof(EnvSlot));
+            c->v.t = T_FREE;
+            c->v.u.cons.cdr = (LVal *)heap.free_list;
+            heap.free_list = c;
+            heap.nfree++;
+        }
+    heap.last_live_cells = live;
+}
+
+static void gc_collect(void)
+{
+    clock_t t0 = clock();
+    size_t in_use = heap.ncells - heap.nfree;
+    if (in_use > heap.peak_live_cells)
+        heap.peak_live_cells = in_use;
+    gc_mark();
+    gc_sweep();
+    double ms = (double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC;
+    heap.collections++;
+    heap.pause_total_ms += ms;
+    if (ms > heap.pause_max_ms)
+        heap.pause_max_ms = ms;
+}
+
+static Cell *cell_alloc(void)
+{
+    if (!heap.free_list || heap.stress)
+    {
+        if (heap.ncells)
+            gc_collect();
+        /* keep at least half the heap free so collections stay amortised */
+        while (heap.nfree * 2 < heap.ncells || !heap.free_list)
+        {
+            if (heap.max_bytes && heap_bytes() + sizeof(Chunk) > heap.max_bytes)
+            {
+                if (heap.free_list)
+                    break;
+                fprintf(stderr, "out of memory: heap limit %zu KB reached\n", heap.max_bytes / 1024);
+                exit(1);
+            }
+            heap_grow();
+        }
+    }
+    Cell *c = heap.free_list;
+    heap.free_list = (Cell *)c->v.u.cons.cdr;
+    heap.nfree--;
+    ONCHIP_ALLOC();
+    c->v.mark = 0;
+    return c;
+}
+
+static void gc_report(void)
+{
+    size_t in_use = heap.ncells - heap.nfree;
+    if (in_use > heap.peak_live_cells)
+        heap.peak_live_cells = in_use;
+    fprintf(stderr,
+            "gc: %lu collections, pause total %.3f ms, max %.3f ms; heap %zu cells (%zu KB incl. payload pages), "
+            "high-water %zu KB, peak cells in use %zu, live after last gc %zu\n",
+            heap.collections, heap.pause_total_ms, heap.pause_max_ms, heap.ncells, heap_bytes() / 1024,
+            heap.peak_bytes / 1024, heap.peak_live_cells, heap.last_live_cells);
+}
+
+/* symbols are interned: one permanent LVal per name */
+static LVal **sym_table;
+static size_t sym_count, sym_cap;
+
+static unsigned long sym_hash(const char *s)
+{
+    unsigned long h = 5381;
+    while (*s)
+        h = h * 33 + (unsigned char)*s++;
+    return h;
+}
+
 /* constructors */
-static LVal *l_nil(void) { return NIL; }
 static LVal *l_num(double v)
 {
-    LVal *x = (LVal *)xmalloc(sizeof *x);
+    if (v == (double)(intptr_t)v && v >= (double)FIX_MIN && v <= (double)FIX_MAX && !(v == 0 && signbit(v)))
+        return (LVal *)(((uintptr_t)(intptr_t)v << 1) | 1);
+    LVal *x = &cell_alloc()->v;
     x->t = T_NUM;
     x->u.num = v;
     return x;
 }
 static LVal *l_sym(const char *s)
 {
+    if (2 * (sym_count + 1) > sym_cap)
+    {
+        size_t ncap = sym_cap ? sym_cap * 2 : 256;
+        LVal **nt = (LVal **)calloc(ncap, sizeof(LVal *));
+        if (!nt)
+        {
+            fprintf(stderr, "OOM\n");
+            exit(1);
+        }
+        for (size_t i = 0; i < sym_cap; i++)
+            if (sym_table[i])
+            {
+                size_t h = sym_hash(sym_table[i]->u.sym) & (ncap - 1);
+                while (nt[h])
+                    h = (h + 1) & (ncap - 1);
+                nt[h] = sym_table[i];
+            }
+        free(sym_table);
+        sym_table = nt;
+        sym_cap = ncap;
+    }
+    size_t h = sym_hash(s) & (sym_cap - 1);
+    for (; sym_table[h]; h = (h + 1) & (sym_cap - 1))
+        if (strcmp(sym_table[h]->u.sym, s) == 0)
+            return sym_table[h];
     LVal *x = (LVal *)xmalloc(sizeof *x);
     x->t = T_SYM;
+    x->mark = 0;
     x->u.sym = strdup2(s);
+    sym_table[h] = x;
+    sym_count++;
     return x;
 }
 static LVal *l_str(const char *s)
 {
-    LVal *x = (LVal *)xmalloc(sizeof *x);
+    size_t n = strlen(s) + 1;
+    char *p = (char *)blob_alloc(n); /* no collection: only cells trigger one */
+    memcpy(p, s, n);
+    LVal *x = &cell_alloc()->v;
     x->t = T_STR;
-    x->u.str = strdup2(s);
+    x->u.str = p;
     return x;
 }
 static LVal *l_cons(LVal *a, LVal *d)
 {
-    LVal *x = (LVal *)xmalloc(sizeof *x);
+    /* a and d must be reachable (protected) in the caller */
+    LVal *x = &cell_alloc()->v;
     x->t = T_CONS;
     x->u.cons.car = a;
     x->u.cons.cdr = d;
@@ -130,15 +486,16 @@ static LVal *l_cons(LVal *a, LVal *d)
 }
 static LVal *l_func(CFn f, const char *name)
 {
-    LVal *x = (LVal *)xmalloc(sizeof *x);
+    LVal *x = (LVal *)xmalloc(sizeof *x); /* builtins are permanent */
     x->t = T_FUNC;
+    x->mark = 0;
     x->u.func.fn = f;
     x->u.func.name = name;
     return x;
 }
 static LVal *l_lambda(LVal *params, LVal *body, Env *env)
 {
-    LVal *x = (LVal *)xmalloc(sizeof *x);
+    LVal *x = &cell_alloc()->v;
     x->t = T_LAMBDA;
     x->u.lam.params = params;
     x->u.lam.body = body;
@@ -148,24 +505,14 @@ static LVal *l_lambda(LVal *params, LVal *body, Env *env)
 
 /* list helpers */
 static int is_nil(LVal *v) { return v == NIL; }
-static LVal *car(LVal *v) { return (v->t == T_CONS) ? v->u.cons.car : NIL; }
-static LVal *cdr(LVal *v) { return (v->t == T_CONS) ? v->u.cons.cdr : NIL; }
+static LVal *car(LVal *v) { return (type_of(v) == T_CONS) ? v->u.cons.car : NIL; }
+static LVal *cdr(LVal *v) { return (type_of(v) == T_CONS) ? v->u.cons.cdr : NIL; }
 static int is_list(LVal *v)
 {
-    while (v->t == T_CONS)
+    while (type_of(v) == T_CONS)
         v = v->u.cons.cdr;
     return is_nil(v);
 }
-static int list_len(LVal *v)
-{
-    int n = 0;
-    while (v->t == T_CONS)
-    {
-        n++;
-        v = v->u.cons.cdr;
-    }
-    return n;
-}
 
 /* =============== Printing =============== */
 static void print_val(LVal *v);
@@ -173,7 +520,7 @@ static void print_list(LVal *v)
 {
     putchar('(');
     int first = 1;
-    while (v->t == T_CONS)
+    while (type_of(v) == T_CONS)
     {
         if (!first)
             putchar(' ');
@@ -190,14 +537,14 @@ static void print_list(LVal *v)
 }
 static void print_val(LVal *v)
 {
-    switch (v->t)
+    switch (type_of(v))
     {
     case T_NIL:
         printf("()");
         break;
     case T_NUM:
     {
-        double z = v->u.num;
+        double z = num_of(v);
         if (z == (long long)z)
             printf("%lld", (long long)z);
         else
@@ -239,63 +586,85 @@ static void print_val(LVal *v)
     case T_LAMBDA:
         printf("#<procedure>");
         break;
+    default:
+        printf("#<internal>");
+        break;
     }
 }
 
 /* =============== Environment =============== */
 static Env *env_new(Env *parent)
 {
-    Env *e = (Env *)xmalloc(sizeof *e);
+    Env *e = &cell_alloc()->e; /* parent must be reachable in the caller */
+    e->t = T_ENV;
     e->parent = parent;
-    e->names = NULL;
-    e->vals = NULL;
+    e->slots = NULL;
     e->count = 0;
     e->cap = 0;
     return e;
 }
-static void env_def(Env *e, const char *name, LVal *val)
+static void env_def(Env *e, LVal *sym, LVal *val)
 {
     for (int i = 0; i < e->count; i++)
-        if (!strcmp(e->names[i], name))
+        if (e->slots[i].sym == sym)
         {
-            e->vals[i] = val;
+            e->slots[i].val = val;
             return;
         }
     if (e->count >= e->cap)
     {
-        e->cap = e->cap ? e->cap * 2 : 16;
-        e->names = (char **)realloc(e->names, (size_t)e->cap * sizeof(char *));
-        e->vals = (LVal **)realloc(e->vals, (size_t)e->cap * sizeof(LVal *));
+        int ncap = e->cap ? e->cap * 2 : 4;
+        EnvSlot *ns = (EnvSlot *)blob_alloc((size_t)ncap * sizeof(EnvSlot));
+        if (e->count)
+            memcpy(ns, e->slots, (size_t)e->count * sizeof(EnvSlot));
+        blob_release(e->slots, (size_t)e->cap * sizeof(EnvSlot));
+        e->slots = ns;
+        e->cap = ncap;
     }
-    e->names[e->count] = strdup2(name);
-    e->vals[e->count] = val;
+    e->slots[e->count].sym = sym;
+    e->slots[e->count].val = val;
     e->count++;
 }
-static int env_set(Env *e, const char *name, LVal *val)
+static int env_set(Env *e, LVal *sym, LVal *val)
 {
     for (Env *p = e; p; p = p->parent)
     {
         for (int i = 0; i < p->count; i++)
-            if (!strcmp(p->names[i], name))
+            if (p->slots[i].sym == sym)
             {
-                p->vals[i] = val;
+                p->slots[i].val = val;
                 return 1;
             }
     }
     return 0;
 }
-static LVal *env_get(Env *e, const char *name)
+static LVal *env_get(Env *e, LVal *sym)
 {
     for (Env *p = e; p; p = p->parent)
     {
         for (int i = 0; i < p->count; i++)
-            if (!strcmp(p->names[i], name))
-                return p->vals[i];
+            if (p->slots[i].sym == sym)
+                return p->slots[i].val;
     }
-    fprintf(stderr, "unbound symbol: %s\n", name);
+    fprintf(stderr, "unbound symbol: %s\n", sym->u.sym);
     exit(1);
 }
 
+/* special-form keywords, interned once so eval dispatches on pointers */
+static LVal *S_QUOTE, *S_IF, *S_BEGIN, *S_DEFINE, *S_SET, *S_LAMBDA, *S_LET, *S_AND, *S_OR;
+static void intern_keywords(void)
+{
+    S_QUOTE = l_sym("quote");
+    S_IF = l_sym("if");
+    S_BEGIN = l_sym("begin");
+    S_DEFINE = l_sym("define");
+    S_SET = l_sym("set!");
+    S_LAMBDA = l_sym("lambda");
+    S_LET = l_sym("let");
+    S_AND = l_sym("and");
+    S_OR = l_sym("or");
+}
+
 /* =============== Reader (tokenizer + parser) =============== */
 typedef enum
 {
@@ -507,7 +876,16 @@ static LVal *read_after_lp(Lexer *L)
 /* read_expr: assumes L->cur already holds the next token to read */
 static LVal *parse_list_items(Lexer *L); /* fwd */
 
+static LVal *read_expr_inner(Lexer *L);
 static LVal *read_expr(Lexer *L)
+{
+    int nv = heap.nvroots;
+    LVal *v = read_expr_inner(L);
+    heap.nvroots = nv;
+    return v;
+}
+
+static LVal *read_expr_inner(Lexer *L)
 {
     switch (L->cur.t)
     {
@@ -538,13 +916,17 @@ static LVal *read_expr(Lexer *L)
     {
         next_tok(L); /* read quoted expr */
         LVal *q = read_expr(L);
-        return l_cons(l_sym("quote"), l_cons(q, NIL));
+        protect(&q);
+        q = l_cons(q, NIL);
+        return l_cons(S_QUOTE, q);
     }
     case TK_LP:
     {
         next_tok(L); /* move to first item or ')' */
         /* read items until ')' */
-        LVal *head = NIL, *tail = NULL;
+        LVal *head = NIL, *tail = NULL, *it = NIL;
+        protect(&head);
+        protect(&it);
         while (L->cur.t != TK_RP)
         {
             if (L->cur.t == TK_EOF)
@@ -552,7 +934,7 @@ static LVal *read_expr(Lexer *L)
                 fprintf(stderr, "parse error: unexpected EOF in list\n");
                 exit(1);
             }
-            LVal *it = read_expr(L); /* read_expr advances tokens */
+            it = read_expr(L); /* read_expr advances tokens */
             if (is_nil(head))
             {
                 head = tail = l_cons(it, NIL);
@@ -575,51 +957,93 @@ static LVal *read_expr(Lexer *L)
 /* =============== Eval =============== */
 static LVal *eval(Env *e, LVal *v);
 
+/* eval steps by kind, counted in ONCHIP_PROFILE builds (onchip_bench --hist) */
+#define LISP_EVALS(X)                 \
+    X(SELF, "self")                   \
+    X(VAR, "var")                     \
+    X(QUOTE, "quote")                 \
+    X(IF, "if")                       \
+    X(BEGIN, "begin")                 \
+    X(DEFINE, "define")               \
+    X(SET, "set!")                    \
+    X(LAMBDA, "lambda")               \
+    X(LET, "let")                     \
+    X(AND, "and")                     \
+    X(OR, "or")                       \
+    X(CALL_BUILTIN, "call-builtin")   \
+    X(CALL_LAMBDA, "call-lambda")
+#define LISP_EV_ENUM(e, name) EV_##e,
+enum
+{
+    LISP_EVALS(LISP_EV_ENUM) EV_COUNT
+};
+
 static LVal *evlist(Env *e, LVal *lst)
-{ /* evaluate each arg into a new list */
+{ /* evaluate each arg into a new list; e and lst are protected by eval */
     if (is_nil(lst))
         return NIL;
-    LVal *h = l_cons(eval(e, car(lst)), NIL);
-    LVal *t = h;
+    int nv = heap.nvroots;
+    LVal *x = eval(e, car(lst)), *h, *t;
+    protect(&x);
+    h = t = l_cons(x, NIL);
+    protect(&h);
     for (lst = cdr(lst); !is_nil(lst); lst = cdr(lst))
     {
-        t->u.cons.cdr = l_cons(eval(e, car(lst)), NIL);
+        x = eval(e, car(lst));
+        t->u.cons.cdr = l_cons(x, NIL);
         t = t->u.cons.cdr;
     }
+    heap.nvroots = nv;
     return h;
 }
 
 /* helper predicates */
 static int truthy(LVal *v) { return !is_nil(v); }
-static int is_symbol(LVal *v, const char *s) { return v->t == T_SYM && strcmp(v->u.sym, s) == 0; }
+
 
 /* forward for builtins registration */
 static void install_builtins(Env *g);
 
 /* apply */
+static LVal *apply_inner(Env *e, LVal *f, LVal *args);
 static LVal *apply(Env *e, LVal *f, LVal *args)
 {
-    if (f->t == T_FUNC)
+    int nv = heap.nvroots, ne = heap.neroots;
+    protect(&f);
+    protect(&args);
+    LVal *r = apply_inner(e, f, args);
+    heap.nvroots = nv;
+    heap.neroots = ne;
+    return r;
+}
+static LVal *apply_inner(Env *e, LVal *f, LVal *args)
+{
+    if (type_of(f) == T_FUNC)
+    {
+        ONCHIP_COUNT(EV_CALL_BUILTIN);
         return f->u.func.fn(e, args);
-    if (f->t == T_LAMBDA)
+    }
+    if (type_of(f) == T_LAMBDA)
     {
+        ONCHIP_COUNT(EV_CALL_LAMBDA);
         /* bind parameters to args in new env */
         Env *call = env_new(f->u.lam.env);
+        protect_env(&call);
         LVal *ps = f->u.lam.params;
         LVal *as = args;
-        while (!is_nil(ps) && ps->t == T_CONS)
+        while (!is_nil(ps) && type_of(ps) == T_CONS)
         {
             if (is_nil(as))
             {
                 fprintf(stderr, "arity mismatch (too few args)\n");
                 exit(1);
             }
-            if (car(ps)->t != T_SYM)
+            if (type_of(car(ps)) != T_SYM)
             {
                 fprintf(stderr, "lambda param must be symbol\n");
                 exit(1);
             }
-            env_def(call, car(ps)->u.sym, car(as));
+            env_def(call, car(ps), car(as));
             ps = cdr(ps);
             as = cdr(as);
         }
@@ -646,20 +1070,33 @@ static LVal *apply(Env *e, LVal *f, LVal *args)
     exit(1);
 }
 
-/* eval */
+/* eval: the wrapper roots the form and env for the whole evaluation */
+static LVal *eval_inner(Env *e, LVal *v);
 static LVal *eval(Env *e, LVal *v)
+{
+    int nv = heap.nvroots, ne = heap.neroots;
+    protect(&v);
+    protect_env(&e);
+    LVal *r = eval_inner(e, v);
+    heap.nvroots = nv;
+    heap.neroots = ne;
+    return r;
+}
+static LVal *eval_inner(Env *e, LVal *v)
 {
     /* atoms */
-    switch (v->t)
+    switch (type_of(v))
     {
     case T_NUM:
     case T_STR:
     case T_FUNC:
     case T_LAMBDA:
     case T_NIL:
+        ONCHIP_COUNT(EV_SELF);
         return v;
     case T_SYM:
-        return env_get(e, v->u.sym);
+        ONCHIP_COUNT(EV_VAR);
+        return env_get(e, v);
     default:
         break;
     }
@@ -671,15 +1108,19 @@ static LVal *eval(Env *e, LVal *v)
     LVal *args = cdr(v);
 
     /* special forms */
-    if (op->t == T_SYM)
+    if (type_of(op) == T_SYM)
     {
         /* quote */
-        if (is_symbol(op, "quote"))
+        if (op == S_QUOTE)
+        {
+            ONCHIP_COUNT(EV_QUOTE);
             return car(args);
+        }
 
         /* if */
-        if (is_symbol(op, "if"))
+        if (op == S_IF)
         {
+            ONCHIP_COUNT(EV_IF);
             LVal *cond = eval(e, car(args));
             LVal *thenb = car(cdr(args));
             LVal *elseb = car(cdr(cdr(args)));
@@ -687,8 +1128,9 @@ static LVal *eval(Env *e, LVal *v)
         }
 
         /* begin */
-        if (is_symbol(op, "begin"))
+        if (op == S_BEGIN)
         {
+            ONCHIP_COUNT(EV_BEGIN);
             LVal *last = NIL;
             for (LVal *it = args; !is_nil(it); it = cdr(it))
                 last = eval(e, car(it));
@@ -696,44 +1138,46 @@ static LVal *eval(Env *e, LVal *v)
         }
 
         /* define: (define name expr) or (define (f x y) body...) */
-        if (is_symbol(op, "define"))
+        if (op == S_DEFINE)
         {
+            ONCHIP_COUNT(EV_DEFINE);
             LVal *head = car(args);
-            if (head && head->t == T_CONS && car(head)->t == T_SYM)
+            if (head && type_of(head) == T_CONS && type_of(car(head)) == T_SYM)
             {
                 /* function form */
                 LVal *fname = car(head);
                 LVal *params = cdr(head);
                 LVal *body = cdr(args);
                 LVal *lam = l_lambda(params, body, e);
-                env_def(e, fname->u.sym, lam);
+                env_def(e, fname, lam);
                 return fname;
             }
             else
             {
                 /* variable form */
-                if (head->t != T_SYM)
+                if (type_of(head) != T_SYM)
                 {
                     fprintf(stderr, "define name must be symbol\n");
                     exit(1);
                 }
                 LVal *val = eval(e, car(cdr(args)));
-                env_def(e, head->u.sym, val);
+                env_def(e, head, val);
                 return head;
             }
         }
 
         /* set! */
-        if (is_symbol(op, "set!"))
+        if (op == S_SET)
         {
+            ONCHIP_COUNT(EV_SET);
             LVal *name = car(args);
-            if (name->t != T_SYM)
+            if (type_of(name) != T_SYM)
             {
                 fprintf(stderr, "set!: first arg must be symbol\n");
                 exit(1);
             }
             LVal *val = eval(e, car(cdr(args)));
-            if (!env_set(e, name->u.sym, val))
+            if (!env_set(e, name, val))
             {
                 fprintf(stderr, "set!: unbound variable %s\n", name->u.sym);
                 exit(1);
@@ -742,20 +1186,25 @@ static LVal *eval(Env *e, LVal *v)
         }
 
         /* lambda */
-        if (is_symbol(op, "lambda"))
+        if (op == S_LAMBDA)
         {
+            ONCHIP_COUNT(EV_LAMBDA);
             LVal *params = car(args);
             LVal *body = cdr(args);
             return l_lambda(params, body, e);
         }
 
         /* let (simple sugar): (let ((x e1) (y e2)) body...) */
-        if (is_symbol(op, "let"))
+        if (op == S_LET)
         {
+            ONCHIP_COUNT(EV_LET);
             LVal *bindings = car(args);
             LVal *body = cdr(args);
             /* transform into ((lambda (vars...) body...) vals...) */
-            LVal *vars = NIL, *vars_t = NULL, *vals = NIL, *vals_t = NULL;
+            LVal *vars = NIL, *vars_t = NULL, *vals = NIL, *vals_t = NULL, *ev = NIL;
+            protect(&vars);
+            protect(&vals);
+            protect(&ev);
             for (; !is_nil(bindings); bindings = cdr(bindings))
             {
                 LVal *pair = car(bindings);
@@ -770,7 +1219,7 @@ static LVal *eval(Env *e, LVal *v)
                     vars_t->u.cons.cdr = l_cons(nm, NIL);
                     vars_t = vars_t->u.cons.cdr;
                 }
-                LVal *ev = eval(e, ex);
+                ev = eval(e, ex);
                 if (is_nil(vals))
                 {
                     vals = vals_t = l_cons(ev, NIL);
@@ -786,8 +1235,9 @@ static LVal *eval(Env *e, LVal *v)
         }
 
         /* and/or (short-circuit) */
-        if (is_symbol(op, "and"))
+        if (op == S_AND)
         {
+            ONCHIP_COUNT(EV_AND);
             LVal *last = TRUE_SYM;
             for (LVal *it = args; !is_nil(it); it = cdr(it))
             {
@@ -797,8 +1247,9 @@ static LVal *eval(Env *e, LVal *v)
             }
             return last;
         }
-        if (is_symbol(op, "or"))
+        if (op == S_OR)
         {
+            ONCHIP_COUNT(EV_OR);
             for (LVal *it = args; !is_nil(it); it = cdr(it))
             {
                 LVal *v2 = eval(e, car(it));
@@ -811,6 +1262,7 @@ static LVal *eval(Env *e, LVal *v)
 
     /* normal application */
     LVal *fn = eval(e, op);
+    protect(&fn);
     LVal *ev = evlist(e, args);
     return apply(e, fn, ev);
 }
@@ -819,7 +1271,7 @@ static LVal *eval(Env *e, LVal *v)
 #define ENSURE_NUM(x, where)                                 \
     do                                                       \
     {                                                        \
-        if ((x)->t != T_NUM)                                 \
+        if (type_of(x) != T_NUM)                              \
         {                                                    \
             fprintf(stderr, "%s: expected number\n", where); \
             exit(1);                                         \
@@ -828,7 +1280,7 @@ static LVal *eval(Env *e, LVal *v)
 #define ENSURE_PAIR(x, where)                                   \
     do                                                          \
     {                                                           \
-        if ((x)->t != T_CONS)                                   \
+        if (type_of(x) != T_CONS)                                \
         {                                                       \
             fprintf(stderr, "%s: expected pair/list\n", where); \
             exit(1);                                            \
@@ -842,7 +1294,7 @@ static LVal *b_add(Env *e, LVal *a)
     for (; !is_nil(a); a = cdr(a))
     {
         ENSURE_NUM(car(a), "+");
-        s += car(a)->u.num;
+        s += num_of(car(a));
     }
     return l_num(s);
 }
@@ -852,13 +1304,13 @@ static LVal *b_sub(Env *e, LVal *a)
     if (is_nil(a))
         return l_num(0);
     ENSURE_NUM(car(a), "-");
-    double s = car(a)->u.num;
+    double s = num_of(car(a));
     if (is_nil(cdr(a)))
         return l_num(-s);
     for (a = cdr(a); !is_nil(a); a = cdr(a))
     {
         ENSURE_NUM(car(a), "-");
-        s -= car(a)->u.num;
+        s -= num_of(car(a));
     }
     return l_num(s);
 }
@@ -869,7 +1321,7 @@ static LVal *b_mul(Env *e, LVal *a)
     for (; !is_nil(a); a = cdr(a))
     {
         ENSURE_NUM(car(a), "*");
-        p *= car(a)->u.num;
+        p *= num_of(car(a));
     }
     return l_num(p);
 }
@@ -877,11 +1329,11 @@ static LVal *b_div(Env *e, LVal *a)
 {
     (void)e;
     ENSURE_NUM(car(a), "/");
-    double v = car(a)->u.num;
+    double v = num_of(car(a));
     for (a = cdr(a); !is_nil(a); a = cdr(a))
     {
         ENSURE_NUM(car(a), "/");
-        double d = car(a)->u.num;
+        double d = num_of(car(a));
         if (d == 0)
         {
             fprintf(stderr, "/: divide by zero\n");
@@ -901,12 +1353,12 @@ static LVal *cmp_core(const char *who, LVal *a, int (*pred)(double, double))
         exit(1);
     }
     ENSURE_NUM(car(a), who);
-    double prev = car(a)->u.num;
+    double prev = num_of(car(a));
     a = cdr(a);
     while (!is_nil(a))
     {
         ENSURE_NUM(car(a), who);
-        double x = car(a)->u.num;
+        double x = num_of(car(a));
         if (!pred(prev, x))
             return NIL;
         prev = x;
@@ -972,7 +1424,7 @@ static LVal *b_cdr(Env *e, LVal *a)
 static LVal *b_pairp(Env *e, LVal *a)
 {
     (void)e;
-    return bool_ret(car(a)->t == T_CONS);
+    return bool_ret(type_of(car(a)) == T_CONS);
 }
 static LVal *b_nullp(Env *e, LVal *a)
 {
@@ -987,31 +1439,31 @@ static LVal *b_listp(Env *e, LVal *a)
 static LVal *b_numberp(Env *e, LVal *a)
 {
     (void)e;
-    return bool_ret(car(a)->t == T_NUM);
+    return bool_ret(type_of(car(a)) == T_NUM);
 }
 static LVal *b_symbolp(Env *e, LVal *a)
 {
     (void)e;
-    return bool_ret(car(a)->t == T_SYM);
+    return bool_ret(type_of(car(a)) == T_SYM);
 }
 static LVal *b_procp(Env *e, LVal *a)
 {
     (void)e;
-    return bool_ret(car(a)->t == T_FUNC || car(a)->t == T_LAMBDA);
+    return bool_ret(type_of(car(a)) == T_FUNC || type_of(car(a)) == T_LAMBDA);
 }
 
 static int equal_rec(LVal *x, LVal *y)
 {
-    if (x->t != y->t)
+    if (type_of(x) != type_of(y))
         return 0;
-    switch (x->t)
+    switch (type_of(x))
     {
     case T_NIL:
         return 1;
     case T_NUM:
-        return x->u.num == y->u.num;
+        return num_of(x) == num_of(y);
     case T_SYM:
-        return strcmp(x->u.sym, y->u.sym) == 0;
+        return x == y; /* interned */
     case T_STR:
         return strcmp(x->u.str, y->u.str) == 0;
     case T_CONS:
@@ -1020,6 +1472,8 @@ static int equal_rec(LVal *x, LVal *y)
         return x->u.func.fn == y->u.func.fn;
     case T_LAMBDA:
         return x == y; /* simplistic */
+    default:
+        return 0;
     }
     return 0;
 }
@@ -1055,7 +1509,7 @@ static LVal *b_display(Env *e, LVal *a)
     for (; !is_nil(a); a = cdr(a))
     {
         LVal *v = car(a);
-        if (v->t == T_STR)
+        if (type_of(v) == T_STR)
             printf("%s", v->u.str);
         else
             print_val(v);
@@ -1087,34 +1541,52 @@ static LVal *b_newline(Env *e, LVal *a)
 
 static void install_builtins(Env *g)
 {
-    env_def(g, "+", l_func(b_add, "+"));
-    env_def(g, "-", l_func(b_sub, "-"));
-    env_def(g, "*", l_func(b_mul, "*"));
-    env_def(g, "/", l_func(b_div, "/"));
-    env_def(g, "=", l_func(b_num_eq, "="));
-    env_def(g, "<", l_func(b_lt, "<"));
-    env_def(g, "<=", l_func(b_le, "<="));
-    env_def(g, ">", l_func(b_gt, ">"));
-    env_def(g, ">=", l_func(b_ge, ">="));
-    env_def(g, "cons", l_func(b_cons, "cons"));
-    env_def(g, "car", l_func(b_car, "car"));
-    env_def(g, "cdr", l_func(b_cdr, "cdr"));
-    env_def(g, "pair?", l_func(b_pairp, "pair?"));
-    env_def(g, "null?", l_func(b_nullp, "null?"));
-    env_def(g, "list?", l_func(b_listp, "list?"));
-    env_def(g, "number?", l_func(b_numberp, "number?"));
-    env_def(g, "symbol?", l_func(b_symbolp, "symbol?"));
-    env_def(g, "procedure?", l_func(b_procp, "procedure?"));
-    env_def(g, "eq?", l_func(b_eq, "eq?"));
-    env_def(g, "equal?", l_func(b_equal, "equal?"));
-    env_def(g, "list", l_func(b_list, "list"));
-    env_def(g, "display", l_func(b_display, "display"));
-    env_def(g, "print", l_func(b_print, "print"));
-    env_def(g, "newline", l_func(b_newline, "newline"));
-    env_def(g, "#t", TRUE_SYM);
+    env_def(g, l_sym("+"), l_func(b_add, "+"));
+    env_def(g, l_sym("-"), l_func(b_sub, "-"));
+    env_def(g, l_sym("*"), l_func(b_mul, "*"));
+    env_def(g, l_sym("/"), l_func(b_div, "/"));
+    env_def(g, l_sym("="), l_func(b_num_eq, "="));
+    env_def(g, l_sym("<"), l_func(b_lt, "<"));
+    env_def(g, l_sym("<="), l_func(b_le, "<="));
+    env_def(g, l_sym(">"), l_func(b_gt, ">"));
+    env_def(g, l_sym(">="), l_func(b_ge, ">="));
+    env_def(g, l_sym("cons"), l_func(b_cons, "cons"));
+    env_def(g, l_sym("car"), l_func(b_car, "car"));
+    env_def(g, l_sym("cdr"), l_func(b_cdr, "cdr"));
+    env_def(g, l_sym("pair?"), l_func(b_pairp, "pair?"));
+    env_def(g, l_sym("null?"), l_func(b_nullp, "null?"));
+    env_def(g, l_sym("list?"), l_func(b_listp, "list?"));
+    env_def(g, l_sym("number?"), l_func(b_numberp, "number?"));
+    env_def(g, l_sym("symbol?"), l_func(b_symbolp, "symbol?"));
+    env_def(g, l_sym("procedure?"), l_func(b_procp, "procedure?"));
+    env_def(g, l_sym("eq?"), l_func(b_eq, "eq?"));
+    env_def(g, l_sym("equal?"), l_func(b_equal, "equal?"));
+    env_def(g, l_sym("list"), l_func(b_list, "list"));
+    env_def(g, l_sym("display"), l_func(b_display, "display"));
+    env_def(g, l_sym("print"), l_func(b_print, "print"));
+    env_def(g, l_sym("newline"), l_func(b_newline, "newline"));
+    env_def(g, l_sym("#t"), TRUE_SYM);
 }
 
 /* =============== Driver =============== */
+
+/* singletons, keywords, and the global env with the builtins */
+static Env *lisp_init(void)
+{
+    /* init singletons (outside the heap: never collected) */
+    NIL = (LVal *)xmalloc(sizeof *NIL);
+    NIL->t = T_NIL;
+    NIL->mark = 0;
+    TRUE_SYM = l_sym("#t");
+    intern_keywords();
+
+    /* global env */
+    Env *G = env_new(NULL);
+    heap.global = G;
+    install_builtins(G);
+    return G;
+}
+
 static char *load_file(const char *path)
 {
     FILE *f = fopen(path, "rb");
@@ -1130,29 +1602,123 @@ static char *load_file(const char *path)
     return buf;
 }
 
+/* =============== Library entry point for onchip_bench.c =============== */
+#ifdef ONCHIP_LIB
+/* The suite's workloads (no string operations, so no strings), loops as
+   recursion; each defines r */
+static const OnchipWorkload LIB_WORK[] = {
+    {"loops",
+     "(define (inner j r) (if (= j 0) r (inner (- j 1) (+ r 1))))\n"
+     "(define (outer i r) (if (= i 0) r (outer (- i 1) (inner 1000 r))))\n"
+     "(define r (outer 1000 0))\n",
+     1e6, 1e6},
+    {"arith",
+     "(define (arith-in i n r)\n"
+     "  (if (= i n) r (arith-in (+ i 1) n (+ r (- (- (* (+ i 3) 4) (* i 4)) 11)))))\n"
+     "(define (arith-out k r)\n"
+     "  (if (= k 200) r (arith-out (+ k 1) (arith-in (* k 1000) (* (+ k 1) 1000) r))))\n"
+     "(define r (arith-out 0 0))\n",
+     2e5, 2e5},
+    {"recursion",
+     "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))\n"
+     "(define r (fib 24))\n",
+     150049, 46368},
+    {"lists",
+     "(define (build n acc) (if (= n 0) acc (build (- n 1) (cons n acc))))\n"
+     "(define (sum xs acc) (if (null? xs) acc (sum (cdr xs) (+ acc (car xs)))))\n"
+     "(define (rounds k r) (if (= k 0) r (rounds (- k 1) (+ r (sum (build 1000 '()) 0)))))\n"
+     "(define r (rounds 100 0))\n",
+     1e5, 50050000},
+};
+
+#define LISP_EV_NAME(e, name) name,
+static const char *const eval_names[] = {LISP_EVALS(LISP_EV_NAME)};
+
+static LVal *lib_forms; /* the loaded top-level forms; a permanent root */
+
+static int lib_load(const char *src)
+{
+    if (!heap.global)
+    {
+        lisp_init();
+        protect(&lib_forms);
+    }
+    Lexer L = {.s = src, .i = 0, .n = strlen(src), .line = 1, .col = 1};
+    LVal *expr = NIL, *tail = NULL;
+    int nv = heap.nvroots;
+    protect(&expr);
+    lib_forms = NIL;
+    next_tok(&L);
+    while (L.cur.t != TK_EOF)
+    {
+        expr = read_expr(&L);
+        LVal *cell = l_cons(expr, NIL);
+        if (tail)
+            tail->u.cons.cdr = cell;
+        else
+            lib_forms = cell;
+        tail = cell;
+    }
+    heap.nvroots = nv;
+    return 1;
+}
+
+static int lib_run(double *result)
+{
+    for (LVal *f = lib_forms; !is_nil(f); f = cdr(f))
+        eval(heap.global, car(f));
+    LVal *r = env_get(heap.global, l_sym("r"));
+    *result = type_of(r) == T_NUM ? num_of(r) : NAN;
+    return 1;
+}
+
+static void lib_unload(void) { lib_forms = NIL; }
+
+#define main onchip_lisp_main
+#endif
+
 int main(int argc, char **argv)
 {
-    /* init singletons */
-    NIL = (LVal *)xmalloc(sizeof *NIL);
-    NIL->t = T_NIL;
-    TRUE_SYM = l_sym("#t");
+    /* options:
+         --gc-stats     print collector statistics to stderr at exit
+         --heap-max KB  cap the cell arena + string/env blobs
+         --gc-stress    collect on every allocation (root-tracking check) */
+    int gc_stats = 0;
+    while (argc > 1 && strncmp(argv[1], "--", 2) == 0)
+    {
+        if (strcmp(argv[1], "--gc-stats") == 0)
+            gc_stats = 1;
+        else if (strcmp(argv[1], "--gc-stress") == 0)
+            heap.stress = 1;
+        else if (strcmp(argv[1], "--heap-max") == 0 && argc > 2)
+        {
+            heap.max_bytes = (size_t)strtoul(argv[2], NULL, 10) * 1024;
+            argv++;
+            argc--;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--gc-stats] [--gc-stress] [--heap-max KB] [file.lisp]\n", argv[0]);
+            return 1;
+        }
+        argv++;
+        argc--;
+    }
 
-    /* global env */
-    Env *G = env_new(NULL);
-    install_builtins(G);
+    Env *G = lisp_init();
 
     /* load program */
     const char *src = demo_program;
-    char *heap = NULL;
+    char *text = NULL;
     if (argc > 1)
     {
-        heap = load_file(argv[1]);
-        if (!heap)
+        text = load_file(argv[1]);
+        if (!text)
         {
             fprintf(stderr, "could not read '%s'\n", argv[1]);
             return 1;
         }
-        src = heap;
+        src = text;
     }
 
     /* lex + parse + eval top-level forms */
@@ -1161,15 +1727,25 @@ int main(int argc, char **argv)
     while (L.cur.t != TK_EOF)
     {
         LVal *expr = read_expr(&L);
+        int nv = heap.nvroots;
+        protect(&expr);
         LVal *res = eval(G, expr);
+        heap.nvroots = nv;
         /* print result of top-level evaluations that aren't function/define returning symbols */
-        if (res != NIL && res->t != T_LAMBDA)
+        if (res != NIL && type_of(res) != T_LAMBDA)
         { /* keep it friendly and REPL-like */
             print_val(res);
             putchar('\n');
         }
     }
 
-    free(heap);
+    if (gc_stats)
+        gc_report();
+    free(text);
     return 0;
 }
+
+#ifdef ONCHIP_LIB
+const OnchipEngine onchip_engine_lisp = {"lisp", LIB_WORK, (int)(sizeof(LIB_WORK) / sizeof(LIB_WORK[0])),
+                                         lib_load, lib_run, lib_unload, eval_names, EV_COUNT, main};
+#endif
@@ -1,7 +1,10 @@
 // luette.c - tiny Lua-like interpreter in one C file, no external libraries.
 // Subset: numbers, strings, booleans, nil, variables, assignment,
 // if/then/else/end, while/do/end, function/end (no closures), return,
-// calls, and builtin print(...). Comments: -- to end-of-line.
+// calls, string concatenation (..), and builtin print(...).
+// Comments: -- to end-of-line.
+// Scripts are compiled to register bytecode and run on a small VM; the original
+// AST walker is kept behind --tree and as the baseline for --bench.
 // This is a teaching toy, not production; no GC; very basic error checks.
 
 #include <stdio.h>
@@ -10,6 +13,11 @@
 #include <ctype.h>
 #include <math.h>
 #include <setjmp.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "onchip_bench.h"
 
 /*======================== Utilities ========================*/
 #define DIE(...)                                \
@@ -72,12 +80,13 @@ typedef enum
     T_SLASH = '/',
     T_PCT = '%',
     T_CARET = '^',
-    T_EQ,
-    T_NE,
     T_LT = '<',
-    T_LE,
     T_GT = '>',
-    T_GE
+    T_EQ = 256, // multi-char tokens stay clear of the single-char ones
+    T_NE,
+    T_LE,
+    T_GE,
+    T_CONCAT
 } Tok;
 
 typedef struct
@@ -317,6 +326,12 @@ static void lex_next(Lex *L)
     }
     default:
     {
+        if (c == '.' && L->pos < L->len && L->src[L->pos] == '.')
+        {
+            L->pos++;
+            L->tok = T_CONCAT;
+            return;
+        }
         if (isdigit((unsigned char)c) || (c == '.' && L->pos < L->len && isdigit((unsigned char)L->src[L->pos])))
         {
             size_t s = L->pos - 1;
@@ -353,10 +368,14 @@ typedef enum
     V_NUM,
     V_BOOL,
     V_STR,
-    V_FUNC
+    V_FUNC,
+    V_PROTO, // bytecode function
+    V_CFUNC, // builtin
+    V_UNDEF  // bytecode global never assigned; never stored in a register
 } VTag;
 
 struct AST; // forward
+struct Proto;
 
 typedef struct Value
 {
@@ -367,6 +386,8 @@ typedef struct Value
         int boolean;
         char *str;
         struct AST *func; // function node pointer
+        struct Proto *proto;
+        struct Value (*cfn)(int argc, struct Value *argv);
     } u;
 } Value;
 
@@ -418,11 +439,95 @@ static const char *vtag(VTag t)
     case V_STR:
         return "string";
     case V_FUNC:
+    case V_PROTO:
+    case V_CFUNC:
         return "function";
+    case V_UNDEF:
+        return "nil";
     }
     return "?";
 }
 
+static int values_equal(const Value *a, const Value *b)
+{
+    if (a->t != b->t)
+        return 0;
+    switch (a->t)
+    {
+    case V_NUM:
+        return a->u.num == b->u.num;
+    case V_BOOL:
+        return a->u.boolean == b->u.boolean;
+    case V_STR:
+        return a->u.str == b->u.str || strcmp(a->u.str, b->u.str) == 0;
+    case V_FUNC:
+        return a->u.func == b->u.func;
+    case V_PROTO:
+        return a->u.proto == b->u.proto;
+    case V_CFUNC:
+        return a->u.cfn == b->u.cfn;
+    default:
+        return 1;
+    }
+}
+
+// Number to string like Lua's %.14g, with a fast path for integers
+static int num_to_str(double x, char *buf)
+{
+    if (fabs(x) < 1e14 && x == (double)(int64_t)x && !(x == 0 && signbit(x)))
+    {
+        char tmp[16];
+        int n = 0, len = 0;
+        int64_t v = (int64_t)x;
+        uint64_t u = v < 0 ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+        do
+            tmp[n++] = (char)('0' + u % 10);
+        while (u /= 10);
+        if (v < 0)
+            buf[len++] = '-';
+        while (n)
+            buf[len++] = tmp[--n];
+        buf[len] = 0;
+        return len;
+    }
+    return snprintf(buf, 32, "%.14g", x);
+}
+
+#define CONCAT_MAX 256
+
+// v[0] .. v[1] .. v[n-1] for strings and numbers, in one allocation; NULL
+// with *bad set to the first operand that is something else
+static char *concat_values(const Value *v, int n, int *bad)
+{
+    static char nums[CONCAT_MAX][32];
+    size_t lens[CONCAT_MAX], total = 0;
+    if (n > CONCAT_MAX)
+        DIE("too many operands to concatenate");
+    for (int i = 0; i < n; i++)
+    {
+        if (v[i].t == V_NUM)
+            lens[i] = (size_t)num_to_str(v[i].u.num, nums[i]);
+        else if (v[i].t == V_STR)
+            lens[i] = strlen(v[i].u.str);
+        else
+        {
+            *bad = i;
+            return NULL;
+        }
+        total += lens[i];
+    }
+    char *s = (char *)malloc(total + 1), *p = s;
+    if (!s)
+        DIE("oom");
+    for (int i = 0; i < n; i++)
+    {
+        memcpy(p, v[i].t == V_NUM ? nums[i] : v[i].u.str, lens[i]);
+        p += lens[i];
+    }
+    *p = 0;
+    return s;
+}
+
 /*======================== Environment ========================*/
 typedef struct Binding
 {
@@ -695,11 +800,6 @@ static AST *parse_primary(Parser *P)
 
 static AST *parse_unary(Parser *P)
 {
-    if (accept(P, T_KNOT) || accept(P, T_MINUS))
-    {
-        int op = (P->L.tok == T_MINUS) ? 0 : 0; // dummy: we consumed already using accept
-    }
-    // re-implement properly:
     if (P->L.tok == T_KNOT)
     {
         int line = P->L.line;
@@ -728,13 +828,15 @@ static int bin_prec(Tok t)
     switch (t)
     {
     case T_CARET:
-        return 8; // right-assoc
+        return 9; // right-assoc
     case T_STAR:
     case T_SLASH:
     case T_PCT:
-        return 7;
+        return 8;
     case T_PLUS:
     case T_MINUS:
+        return 7;
+    case T_CONCAT:
         return 6;
     case T_LT:
     case T_LE:
@@ -934,14 +1036,13 @@ static AST *parse_chunk(const char *code)
 typedef struct
 {
     jmp_buf jb;
-    int active; // inside function
     Value retv;
 } RetJump;
 
 typedef struct
 {
-    Env *G; // global
-    RetJump rj;
+    Env *G;      // global
+    RetJump *rj; // innermost active call, NULL at top level
 } VM;
 
 static int is_truthy(Value v)
@@ -984,18 +1085,19 @@ static Value call_function(VM *vm, Env *env, AST *fndef, int argc, Value *argv)
         Value v = (i < argc) ? argv[i] : V_nil();
         env_set(E, pname, v);
     }
-    // enable return jump
-    vm->rj.active = 1;
-    if (!setjmp(vm->rj.jb))
+    // enable return jump; nested calls chain their own and restore ours
+    RetJump rj, *outer = vm->rj;
+    vm->rj = &rj;
+    if (!setjmp(rj.jb))
     {
         (void)eval(vm, E, fndef->u.fundef.body);
-        vm->rj.active = 0;
+        vm->rj = outer;
         return V_nil();
     }
     else
     {
-        vm->rj.active = 0;
-        return vm->rj.retv;
+        vm->rj = outer;
+        return rj.retv;
     }
 }
 
@@ -1023,6 +1125,15 @@ static Value builtin_print(int argc, Value *argv)
         case V_FUNC:
             printf("function:%p", (void *)v.u.func);
             break;
+        case V_PROTO:
+            printf("function:%p", (void *)v.u.proto);
+            break;
+        case V_CFUNC:
+            printf("function:builtin");
+            break;
+        case V_UNDEF:
+            printf("nil");
+            break;
         }
     }
     printf("\n");
@@ -1110,16 +1221,17 @@ static Value eval(VM *vm, Env *env, AST *n)
         case T_CARET:
             return V_num(pow(as_num(n, A), as_num(n, B)));
         case T_EQ:
-            return V_bool(A.t == B.t && ((A.t == V_NUM && A.u.num == B.u.num) ||
-                                         (A.t == V_BOOL && A.u.boolean == B.u.boolean) ||
-                                         (A.t == V_NIL) ||
-                                         (A.t == V_STR && strcmp(A.u.str, B.u.str) == 0) ||
-                                         (A.t == V_FUNC && A.u.func == B.u.func)));
+            return V_bool(values_equal(&A, &B));
         case T_NE:
+            return V_bool(!values_equal(&A, &B));
+        case T_CONCAT:
         {
-            Value eq = eval(vm, env, n); /* unreachable */
-            (void)eq;
-            DIE("internal");
+            Value ab[2] = {A, B};
+            int bad;
+            char *s = concat_values(ab, 2, &bad);
+            if (!s)
+                DIE("line %d: attempt to concatenate a %s value", n->line, vtag(ab[bad].t));
+            return V_str(s);
         }
         case T_LT:
             return V_bool(as_num(n, A) < as_num(n, B));
@@ -1139,7 +1251,7 @@ static Value eval(VM *vm, Env *env, AST *n)
         if (strcmp(n->u.call.name, "print") == 0)
         {
             int m = n->u.call.args.n;
-            Value *argv = (Value *)alloca(sizeof(Value) * m);
+            Value argv[m > 0 ? m : 1];
             for (int i = 0; i < m; i++)
                 argv[i] = eval(vm, env, (AST *)n->u.call.args.d[i]);
             return builtin_print(m, argv);
@@ -1149,7 +1261,7 @@ static Value eval(VM *vm, Env *env, AST *n)
         if (!env_get(env, n->u.call.name, &f) || f.t != V_FUNC)
             DIE("line %d: attempt to call non-function '%s'", n->line, n->u.call.name);
         int m = n->u.call.args.n;
-        Value *argv = (Value *)alloca(sizeof(Value) * m);
+        Value argv[m > 0 ? m : 1];
         for (int i = 0; i < m; i++)
             argv[i] = eval(vm, env, (AST *)n->u.call.args.d[i]);
         // function env is current env (no closures), typical simple dynamic env
@@ -1181,16 +1293,965 @@ static Value eval(VM *vm, Env *env, AST *n)
         Value r = V_nil();
         if (n->u.ret.exprs.n > 0)
             r = eval(vm, env, (AST *)n->u.ret.exprs.d[0]);
-        if (!vm->rj.active)
+        if (!vm->rj)
             DIE("line %d: 'return' outside function", n->line);
-        vm->rj.retv = r;
-        longjmp(vm->rj.jb, 1);
+        vm->rj->retv = r;
+        longjmp(vm->rj->jb, 1);
     }
     }
     DIE("line %d: unhandled node", n->line);
     return V_nil();
 }
 
+/*======================== Bytecode compiler ========================*/
+// The walker above resolves every name by strcmp down the Env chain on every
+// access. This pass compiles the AST once to register bytecode instead:
+// identifiers and string constants are interned, globals live in an array
+// indexed by intern id, and a function's parameters and assigned names become
+// register slots fixed at compile time. Scoping is lexical: names a function
+// does not assign resolve to globals, not to the caller's locals as in the
+// dynamic walker. A local starts out as a copy of the global of the same name
+// (or nil), which matches the walker for the usual "x = x + 1" in a function.
+//
+// Instructions are 32 bits, Lua 5.1 style: op:6 A:8 C:9 B:9 or op:6 A:8 Bx:18.
+// B and C are "RK" operands: a register, or constant (x & 0xFF) if bit 8 is set.
+typedef uint32_t Instr;
+
+#define I_OP(i) ((int)((i) & 0x3F))
+#define I_A(i) ((int)(((i) >> 6) & 0xFF))
+#define I_C(i) ((int)(((i) >> 14) & 0x1FF))
+#define I_B(i) ((int)((i) >> 23))
+#define I_Bx(i) ((int)((i) >> 14))
+#define I_sBx(i) (I_Bx(i) - MAXARG_sBx)
+#define MAXARG_Bx ((1 << 18) - 1)
+#define MAXARG_sBx (MAXARG_Bx >> 1)
+#define RK_CONST 0x100
+#define MK_ABC(o, a, b, c) ((Instr)(o) | (Instr)(a) << 6 | (Instr)(c) << 14 | (Instr)(b) << 23)
+#define MK_ABx(o, a, bx) ((Instr)(o) | (Instr)(a) << 6 | (Instr)(bx) << 14)
+
+#define OPCODES(X)                                                       \
+    X(MOVE)      /* R[A] = R[B]                                       */ \
+    X(LOADK)     /* R[A] = K[Bx]                                      */ \
+    X(LOADNIL)   /* R[A] = nil                                        */ \
+    X(LOADBOOL)  /* R[A] = B; if C skip next                          */ \
+    X(GETGLOBAL) /* R[A] = G[Bx], error if never assigned             */ \
+    X(SETGLOBAL) /* G[Bx] = R[A]                                      */ \
+    X(INITLOCAL) /* R[A] = G[Bx] or nil, in a function prologue       */ \
+    X(ADD)       /* R[A] = RK[B] + RK[C], likewise SUB .. POW         */ \
+    X(SUB)                                                               \
+    X(MUL)                                                               \
+    X(DIV)                                                               \
+    X(MOD)                                                               \
+    X(POW)                                                               \
+    X(CONCAT)    /* R[A] = R[B] .. R[B+1] .. ... .. R[C]              */ \
+    X(UNM)       /* R[A] = -R[B]                                      */ \
+    X(NOT)       /* R[A] = not R[B]                                   */ \
+    X(EQ)        /* if (RK[B] == RK[C]) != A skip next, else take JMP */ \
+    X(LT)                                                                \
+    X(LE)                                                                \
+    X(TEST)      /* if truthy(R[A]) != C skip next, else take JMP     */ \
+    X(JMP)       /* pc += sBx                                         */ \
+    X(CALL)      /* R[A] = R[A](R[A+1] .. R[A+B])                     */ \
+    X(RETURN)    /* return B ? R[A] : nil                             */ \
+    X(FUNC)      /* R[A] = function P[Bx]                             */
+
+#define OP_ENUM(o) OP_##o,
+#define OP_NAME(o) #o,
+typedef enum
+{
+    OPCODES(OP_ENUM) OP_COUNT
+} OpCode;
+static const char *const op_names[] = {OPCODES(OP_NAME)};
+
+typedef struct Proto
+{
+    const char *name;
+    Instr *code;
+    int *lines;
+    int ncode, capcode;
+    Value *k;
+    int nk, capk;
+    struct Proto **protos;
+    int nprotos, capprotos;
+    int nparams, nregs;
+} Proto;
+
+#define GROW(p, n, cap)                                     \
+    do                                                      \
+    {                                                       \
+        if ((n) >= (cap))                                   \
+        {                                                   \
+            (cap) = (cap) ? (cap) * 2 : 16;                 \
+            (p) = realloc((p), (size_t)(cap) * sizeof(*(p))); \
+            if (!(p))                                       \
+                DIE("oom");                                 \
+        }                                                   \
+    } while (0)
+
+/*------------------------ Interning ------------------------*/
+static const char **istr; // intern id -> string
+static Value *gvals;      // globals, indexed by intern id
+static int nistr, capistr;
+static int *ihash; // open addressing, intern id + 1 (0 = empty)
+static int caphash;
+
+static unsigned str_hash(const char *s)
+{
+    unsigned h = 2166136261u;
+    while (*s)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+static int intern(const char *s)
+{
+    if (2 * (nistr + 1) > caphash)
+    {
+        int ncap = caphash ? caphash * 2 : 256;
+        int *nh = (int *)calloc(ncap, sizeof(int));
+        if (!nh)
+            DIE("oom");
+        for (int id = 0; id < nistr; id++)
+        {
+            unsigned h = str_hash(istr[id]) & (ncap - 1);
+            while (nh[h])
+                h = (h + 1) & (ncap - 1);
+            nh[h] = id + 1;
+        }
+        free(ihash);
+        ihash = nh;
+        caphash = ncap;
+    }
+    unsigned h = str_hash(s) & (caphash - 1);
+    for (; ihash[h]; h = (h + 1) & (caphash - 1))
+        if (strcmp(istr[ihash[h] - 1], s) == 0)
+            return ihash[h] - 1;
+    if (nistr > MAXARG_Bx)
+        DIE("too many distinct names and strings");
+    if (nistr >= capistr)
+    {
+        capistr = capistr ? capistr * 2 : 256;
+        istr = realloc(istr, capistr * sizeof(*istr));
+        gvals = realloc(gvals, capistr * sizeof(*gvals));
+        if (!istr || !gvals)
+            DIE("oom");
+    }
+    istr[nistr] = sdup(s);
+    gvals[nistr].t = V_UNDEF;
+    ihash[h] = nistr + 1;
+    return nistr++;
+}
+
+/*------------------------ Code generation ------------------------*/
+#define MAX_REGS 250
+
+typedef struct
+{
+    Proto *f;
+    int is_main;          // chunk top level: every name is a global
+    int locals[MAX_REGS]; // intern ids of slots 0 .. nlocals-1
+    int nlocals, freereg;
+    int line; // source line recorded for emitted code
+} FuncState;
+
+typedef struct
+{
+    int *d, n, cap;
+} JumpList; // pcs of JMPs waiting for a target
+
+static Proto *proto_new(const char *name)
+{
+    Proto *f = (Proto *)calloc(1, sizeof(Proto));
+    if (!f)
+        DIE("oom");
+    f->name = name;
+    return f;
+}
+
+static int emit(FuncState *fs, Instr i)
+{
+    Proto *f = fs->f;
+    if (f->ncode >= f->capcode)
+    {
+        f->capcode = f->capcode ? f->capcode * 2 : 64;
+        f->code = realloc(f->code, f->capcode * sizeof(*f->code));
+        f->lines = realloc(f->lines, f->capcode * sizeof(*f->lines));
+        if (!f->code || !f->lines)
+            DIE("oom");
+    }
+    f->code[f->ncode] = i;
+    f->lines[f->ncode] = fs->line;
+    return f->ncode++;
+}
+
+static int emit_jmp(FuncState *fs) { return emit(fs, MK_ABx(OP_JMP, 0, MAXARG_sBx)); }
+
+static void patch_jmp(FuncState *fs, int pc, int target)
+{
+    int off = target - (pc + 1);
+    if (off > MAXARG_sBx || off < -MAXARG_sBx)
+        DIE("line %d: jump too long", fs->f->lines[pc]);
+    fs->f->code[pc] = MK_ABx(OP_JMP, 0, off + MAXARG_sBx);
+}
+
+static void jl_add(JumpList *jl, int pc)
+{
+    GROW(jl->d, jl->n, jl->cap);
+    jl->d[jl->n++] = pc;
+}
+
+static void jl_patch_here(FuncState *fs, JumpList *jl)
+{
+    for (int i = 0; i < jl->n; i++)
+        patch_jmp(fs, jl->d[i], fs->f->ncode);
+    free(jl->d);
+}
+
+static int addk(FuncState *fs, Value v)
+{
+    Proto *f = fs->f;
+    for (int i = 0; i < f->nk; i++)
+    {
+        const Value *c = &f->k[i];
+        if (c->t == v.t && (v.t == V_NUM ? memcmp(&c->u.num, &v.u.num, sizeof(double)) == 0 : v.t == V_STR ? c->u.str == v.u.str : v.t == V_BOOL ? c->u.boolean == v.u.boolean : 1))
+            return i;
+    }
+    if (f->nk > MAXARG_Bx)
+        DIE("line %d: too many constants", fs->line);
+    GROW(f->k, f->nk, f->capk);
+    f->k[f->nk] = v;
+    return f->nk++;
+}
+
+// Literal (or negated number literal) value of n; 0 if n is not one
+static int const_node(AST *n, Value *v)
+{
+    switch (n->t)
+    {
+    case N_NUM:
+        *v = V_num(n->u.num.num);
+        return 1;
+    case N_STR:
+        *v = V_str((char *)istr[intern(n->u.str.s)]);
+        return 1;
+    case N_BOOL:
+        *v = V_bool(n->u.boolean.b);
+        return 1;
+    case N_NIL:
+        *v = V_nil();
+        return 1;
+    case N_UN:
+        if (n->u.un.op == T_MINUS && n->u.un.a->t == N_NUM)
+        {
+            *v = V_num(-n->u.un.a->u.num.num);
+            return 1;
+        }
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+static int reg_alloc(FuncState *fs)
+{
+    if (fs->freereg >= MAX_REGS)
+        DIE("line %d: expression too complex", fs->line);
+    if (++fs->freereg > fs->f->nregs)
+        fs->f->nregs = fs->freereg;
+    return fs->freereg - 1;
+}
+
+static int local_slot(FuncState *fs, int id)
+{
+    for (int s = fs->nlocals - 1; s >= 0; s--)
+        if (fs->locals[s] == id)
+            return s;
+    return -1;
+}
+
+static int arith_op(int tok)
+{
+    switch (tok)
+    {
+    case T_PLUS:
+        return OP_ADD;
+    case T_MINUS:
+        return OP_SUB;
+    case T_STAR:
+        return OP_MUL;
+    case T_SLASH:
+        return OP_DIV;
+    case T_PCT:
+        return OP_MOD;
+    case T_CARET:
+        return OP_POW;
+    default:
+        return -1;
+    }
+}
+
+static int is_compare(int tok)
+{
+    return tok == T_EQ || tok == T_NE || tok == T_LT || tok == T_LE || tok == T_GT || tok == T_GE;
+}
+
+static void exp2reg(FuncState *fs, AST *n, int target);
+
+// Register holding n: a local's own slot, else a fresh temporary
+static int exp2anyreg(FuncState *fs, AST *n)
+{
+    if (n->t == N_VAR)
+    {
+        int s = local_slot(fs, intern(n->u.var.name));
+        if (s >= 0)
+            return s;
+    }
+    int r = reg_alloc(fs);
+    exp2reg(fs, n, r);
+    return r;
+}
+
+static int exp2rk(FuncState *fs, AST *n)
+{
+    Value v;
+    if (const_node(n, &v))
+    {
+        int k = addk(fs, v);
+        if (k < RK_CONST)
+            return k | RK_CONST;
+    }
+    return exp2anyreg(fs, n);
+}
+
+// Operands of a .. b .. c into consecutive fresh registers
+static void concat_operands(FuncState *fs, AST *n)
+{
+    if (n->t == N_BIN && n->u.bin.op == T_CONCAT)
+    {
+        concat_operands(fs, n->u.bin.a);
+        concat_operands(fs, n->u.bin.b);
+    }
+    else
+        exp2reg(fs, n, reg_alloc(fs));
+}
+
+// Emit code that takes a jump (added to jl) when truthy(n) == when and
+// falls through otherwise; comparisons fuse with the jump
+static void cond_jump(FuncState *fs, AST *n, int when, JumpList *jl)
+{
+    int save = fs->freereg;
+    Value v;
+    fs->line = n->line;
+    if (const_node(n, &v))
+    {
+        if (is_truthy(v) == when)
+            jl_add(jl, emit_jmp(fs));
+        return;
+    }
+    if (n->t == N_UN && n->u.un.op == T_KNOT)
+    {
+        cond_jump(fs, n->u.un.a, !when, jl);
+        return;
+    }
+    if (n->t == N_BIN && (n->u.bin.op == T_KAND || n->u.bin.op == T_KOR))
+    {
+        int decides = n->u.bin.op == T_KOR; // truthiness of a that settles the result
+        if (when == decides)
+        {
+            cond_jump(fs, n->u.bin.a, when, jl);
+            cond_jump(fs, n->u.bin.b, when, jl);
+        }
+        else
+        {
+            JumpList skip = {0};
+            cond_jump(fs, n->u.bin.a, decides, &skip);
+            cond_jump(fs, n->u.bin.b, when, jl);
+            jl_patch_here(fs, &skip);
+        }
+        return;
+    }
+    if (n->t == N_BIN && is_compare(n->u.bin.op))
+    {
+        int op = n->u.bin.op;
+        int o = (op == T_EQ || op == T_NE) ? OP_EQ : (op == T_LT || op == T_GT) ? OP_LT : OP_LE;
+        int neg = op == T_NE, swap = op == T_GT || op == T_GE;
+        int b = exp2rk(fs, n->u.bin.a), c = exp2rk(fs, n->u.bin.b);
+        fs->line = n->line;
+        emit(fs, MK_ABC(o, when ^ neg, swap ? c : b, swap ? b : c));
+        jl_add(jl, emit_jmp(fs));
+        fs->freereg = save;
+        return;
+    }
+    int r = exp2anyreg(fs, n);
+    fs->line = n->line;
+    emit(fs, MK_ABC(OP_TEST, r, 0, when));
+    jl_add(jl, emit_jmp(fs));
+    fs->freereg = save;
+}
+
+// Compile "name = expr"; returns the register holding the assigned value
+static int compile_assign(FuncState *fs, AST *n)
+{
+    int id = intern(n->u.assign.name);
+    int s = local_slot(fs, id);
+    if (s >= 0)
+    {
+        exp2reg(fs, n->u.assign.expr, s);
+        return s;
+    }
+    int r = exp2anyreg(fs, n->u.assign.expr);
+    fs->line = n->line;
+    emit(fs, MK_ABx(OP_SETGLOBAL, r, id));
+    return r;
+}
+
+static void exp2reg(FuncState *fs, AST *n, int target)
+{
+    int save = fs->freereg;
+    Value v;
+    fs->line = n->line;
+    if (const_node(n, &v))
+    {
+        if (v.t == V_NIL)
+            emit(fs, MK_ABC(OP_LOADNIL, target, 0, 0));
+        else if (v.t == V_BOOL)
+            emit(fs, MK_ABC(OP_LOADBOOL, target, v.u.boolean, 0));
+        else
+            emit(fs, MK_ABx(OP_LOADK, target, addk(fs, v)));
+        return;
+    }
+    switch (n->t)
+    {
+    case N_VAR:
+    {
+        int id = intern(n->u.var.name), s = local_slot(fs, id);
+        if (s < 0)
+            emit(fs, MK_ABx(OP_GETGLOBAL, target, id));
+        else if (s != target)
+            emit(fs, MK_ABC(OP_MOVE, target, s, 0));
+        return;
+    }
+    case N_ASSIGN:
+    {
+        int r = compile_assign(fs, n);
+        if (r != target)
+            emit(fs, MK_ABC(OP_MOVE, target, r, 0));
+        fs->freereg = save;
+        return;
+    }
+    case N_UN:
+    {
+        int r = exp2anyreg(fs, n->u.un.a);
+        fs->line = n->line;
+        emit(fs, MK_ABC(n->u.un.op == T_KNOT ? OP_NOT : OP_UNM, target, r, 0));
+        fs->freereg = save;
+        return;
+    }
+    case N_BIN:
+    {
+        int op = n->u.bin.op;
+        if (op == T_KAND || op == T_KOR)
+        {
+            // a local target would be clobbered before b reads it
+            int r = target < fs->nlocals ? reg_alloc(fs) : target;
+            exp2reg(fs, n->u.bin.a, r);
+            fs->line = n->line;
+            emit(fs, MK_ABC(OP_TEST, r, 0, op == T_KOR));
+            int j = emit_jmp(fs);
+            exp2reg(fs, n->u.bin.b, r);
+            patch_jmp(fs, j, fs->f->ncode);
+            if (r != target)
+                emit(fs, MK_ABC(OP_MOVE, target, r, 0));
+            fs->freereg = save;
+            return;
+        }
+        if (is_compare(op))
+        {
+            JumpList fl = {0};
+            cond_jump(fs, n, 0, &fl);
+            emit(fs, MK_ABC(OP_LOADBOOL, target, 1, 1));
+            jl_patch_here(fs, &fl);
+            emit(fs, MK_ABC(OP_LOADBOOL, target, 0, 0));
+            return;
+        }
+        if (op == T_CONCAT)
+        {
+            // a whole chain is one CONCAT: one allocation, each operand copied once
+            int first = fs->freereg;
+            concat_operands(fs, n);
+            fs->line = n->line;
+            emit(fs, MK_ABC(OP_CONCAT, target, first, fs->freereg - 1));
+            fs->freereg = save;
+            return;
+        }
+        if (arith_op(op) < 0)
+            DIE("line %d: bad binop", n->line);
+        int b = exp2rk(fs, n->u.bin.a), c = exp2rk(fs, n->u.bin.b);
+        fs->line = n->line;
+        emit(fs, MK_ABC(arith_op(op), target, b, c));
+        fs->freereg = save;
+        return;
+    }
+    case N_CALL:
+    {
+        // callee and arguments go in consecutive registers; a call whose
+        // target is the newest temporary is built in place
+        int base = (target == fs->freereg - 1 && target >= fs->nlocals) ? target : reg_alloc(fs);
+        int id = intern(n->u.call.name), s = local_slot(fs, id);
+        if (s >= 0)
+            emit(fs, MK_ABC(OP_MOVE, base, s, 0));
+        else
+            emit(fs, MK_ABx(OP_GETGLOBAL, base, id));
+        for (int i = 0; i < n->u.call.args.n; i++)
+            exp2reg(fs, (AST *)n->u.call.args.d[i], reg_alloc(fs));
+        fs->line = n->line;
+        emit(fs, MK_ABC(OP_CALL, base, n->u.call.args.n, 0));
+        if (base != target)
+            emit(fs, MK_ABC(OP_MOVE, target, base, 0));
+        fs->freereg = save;
+        return;
+    }
+    default:
+        DIE("line %d: statement used as expression", n->line);
+    }
+}
+
+static Proto *compile_function(AST *fn);
+
+static void compile_stmt(FuncState *fs, AST *n)
+{
+    fs->line = n->line;
+    switch (n->t)
+    {
+    case N_BLOCK:
+        for (int i = 0; i < n->u.block.stmts.n; i++)
+        {
+            compile_stmt(fs, (AST *)n->u.block.stmts.d[i]);
+            fs->freereg = fs->nlocals;
+        }
+        return;
+    case N_ASSIGN:
+        compile_assign(fs, n);
+        return;
+    case N_IF:
+    {
+        JumpList fl = {0};
+        cond_jump(fs, n->u.ifs.cond, 0, &fl);
+        compile_stmt(fs, n->u.ifs.thn);
+        if (n->u.ifs.els)
+        {
+            int j = emit_jmp(fs);
+            jl_patch_here(fs, &fl);
+            compile_stmt(fs, n->u.ifs.els);
+            patch_jmp(fs, j, fs->f->ncode);
+        }
+        else
+            jl_patch_here(fs, &fl);
+        return;
+    }
+    case N_WHILE:
+    {
+        JumpList fl = {0};
+        int top = fs->f->ncode;
+        cond_jump(fs, n->u.whil.cond, 0, &fl);
+        compile_stmt(fs, n->u.whil.body);
+        patch_jmp(fs, emit_jmp(fs), top);
+        jl_patch_here(fs, &fl);
+        return;
+    }
+    case N_FUNDEF:
+    {
+        Proto *f = fs->f;
+        if (f->nprotos > MAXARG_Bx)
+            DIE("line %d: too many functions", n->line);
+        GROW(f->protos, f->nprotos, f->capprotos);
+        f->protos[f->nprotos] = compile_function(n);
+        int id = intern(n->u.fundef.name), s = local_slot(fs, id);
+        fs->line = n->line;
+        if (s >= 0)
+            emit(fs, MK_ABx(OP_FUNC, s, f->nprotos));
+        else
+        {
+            int r = reg_alloc(fs);
+            emit(fs, MK_ABx(OP_FUNC, r, f->nprotos));
+            emit(fs, MK_ABx(OP_SETGLOBAL, r, id));
+        }
+        f->nprotos++;
+        return;
+    }
+    case N_RETURN:
+        if (fs->is_main)
+            DIE("line %d: 'return' outside function", n->line);
+        if (n->u.ret.exprs.n > 0)
+        {
+            int r = exp2anyreg(fs, (AST *)n->u.ret.exprs.d[0]);
+            fs->line = n->line;
+            emit(fs, MK_ABC(OP_RETURN, r, 1, 0));
+        }
+        else
+            emit(fs, MK_ABC(OP_RETURN, 0, 0, 0));
+        return;
+    default:
+        exp2reg(fs, n, reg_alloc(fs));
+        return;
+    }
+}
+
+static void add_local(FuncState *fs, int id)
+{
+    if (local_slot(fs, id) >= 0)
+        return;
+    if (fs->nlocals >= MAX_REGS - 32)
+        DIE("line %d: too many locals in '%s'", fs->line, fs->f->name);
+    fs->locals[fs->nlocals++] = id;
+}
+
+// Every name a function assigns (or defines a function as) is one of its locals
+static void scan_locals(FuncState *fs, AST *n)
+{
+    switch (n->t)
+    {
+    case N_BLOCK:
+        for (int i = 0; i < n->u.block.stmts.n; i++)
+            scan_locals(fs, (AST *)n->u.block.stmts.d[i]);
+        break;
+    case N_ASSIGN:
+        add_local(fs, intern(n->u.assign.name));
+        scan_locals(fs, n->u.assign.expr);
+        break;
+    case N_BIN:
+        scan_locals(fs, n->u.bin.a);
+        scan_locals(fs, n->u.bin.b);
+        break;
+    case N_UN:
+        scan_locals(fs, n->u.un.a);
+        break;
+    case N_CALL:
+        for (int i = 0; i < n->u.call.args.n; i++)
+            scan_locals(fs, (AST *)n->u.call.args.d[i]);
+        break;
+    case N_IF:
+        scan_locals(fs, n->u.ifs.cond);
+        scan_locals(fs, n->u.ifs.thn);
+        if (n->u.ifs.els)
+            scan_locals(fs, n->u.ifs.els);
+        break;
+    case N_WHILE:
+        scan_locals(fs, n->u.whil.cond);
+        scan_locals(fs, n->u.whil.body);
+        break;
+    case N_FUNDEF:
+        add_local(fs, intern(n->u.fundef.name)); // its body is scanned on its own
+        break;
+    case N_RETURN:
+        for (int i = 0; i < n->u.ret.exprs.n; i++)
+            scan_locals(fs, (AST *)n->u.ret.exprs.d[i]);
+        break;
+    default:
+        break;
+    }
+}
+
+static Proto *compile_function(AST *fn)
+{
+    static FuncState zero;
+    FuncState fs = zero;
+    Vec *ps = &fn->u.fundef.params;
+    fs.f = proto_new(fn->u.fundef.name);
+    fs.line = fn->line;
+    if (ps->n > MAX_REGS / 2)
+        DIE("line %d: too many parameters", fn->line);
+    for (int i = 0; i < ps->n; i++)
+        fs.locals[fs.nlocals++] = intern((char *)ps->d[i]);
+    fs.f->nparams = ps->n;
+    scan_locals(&fs, fn->u.fundef.body);
+    fs.freereg = fs.f->nregs = fs.nlocals;
+    for (int s = fs.f->nparams; s < fs.nlocals; s++)
+        emit(&fs, MK_ABx(OP_INITLOCAL, s, fs.locals[s]));
+    compile_stmt(&fs, fn->u.fundef.body);
+    emit(&fs, MK_ABC(OP_RETURN, 0, 0, 0));
+    return fs.f;
+}
+
+static Proto *compile_chunk(AST *prog)
+{
+    static FuncState zero;
+    FuncState fs = zero;
+    fs.f = proto_new("main chunk");
+    fs.is_main = 1;
+    fs.line = prog->line;
+    compile_stmt(&fs, prog);
+    emit(&fs, MK_ABC(OP_RETURN, 0, 0, 0));
+    return fs.f;
+}
+
+static void dis_proto(const Proto *f)
+{
+    printf("function %s: %d params, %d registers, %d constants\n", f->name, f->nparams, f->nregs, f->nk);
+    for (int pc = 0; pc < f->ncode; pc++)
+    {
+        Instr i = f->code[pc];
+        int o = I_OP(i);
+        printf("%5d [%3d] %-10s", pc, f->lines[pc], op_names[o]);
+        if (o == OP_JMP)
+            printf("-> %d", pc + 1 + I_sBx(i));
+        else if (o == OP_GETGLOBAL || o == OP_SETGLOBAL || o == OP_INITLOCAL)
+            printf("%d %s", I_A(i), istr[I_Bx(i)]);
+        else if (o == OP_LOADK || o == OP_FUNC)
+            printf("%d %d", I_A(i), I_Bx(i));
+        else
+            printf("%d %d %d", I_A(i), I_B(i), I_C(i));
+        putchar('\n');
+    }
+    for (int p = 0; p < f->nprotos; p++)
+        dis_proto(f->protos[p]);
+}
+
+/*======================== Bytecode VM ========================*/
+#define BVM_STACK (1 << 16)
+#define BVM_FRAMES 4096
+
+typedef struct
+{
+    Proto *f;
+    const Instr *pc;
+    Value *base;
+} Frame;
+
+static Value bvm_stack[BVM_STACK];
+static Frame bvm_frames[BVM_FRAMES];
+
+static void vm_error(const Proto *f, const Instr *pc, const char *fmt, ...)
+{
+    va_list ap;
+    fprintf(stderr, "error: line %d: ", f->lines[pc - 1 - f->code]);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+// fmod(x, y), via an integer remainder when both are exact integers (fmod is
+// a slow microcoded loop on x86); same result, including fmod's -0
+static double num_mod(double x, double y)
+{
+    if (x == (double)(int64_t)x && y == (double)(int64_t)y && y != 0 &&
+        fabs(x) < 9007199254740992.0 && fabs(y) < 9007199254740992.0)
+    {
+        double r = (double)((int64_t)x % (int64_t)y);
+        return r == 0 ? copysign(0.0, x) : r;
+    }
+    return fmod(x, y);
+}
+
+static void bvm_init(void)
+{
+    static int done;
+    if (done)
+        return;
+    done = 1;
+    int id = intern("print");
+    gvals[id].t = V_CFUNC;
+    gvals[id].u.cfn = builtin_print;
+}
+
+static void bvm_execute(Proto *main_chunk)
+{
+    Frame *fp = bvm_frames;
+    Proto *f = main_chunk;
+    const Instr *pc = f->code;
+    const Value *k = f->k;
+    Value *base = bvm_stack + 1; // a callee's base[-1] receives its result
+    Value *G = gvals;
+    Instr i;
+
+    if (f->nregs + 1 > BVM_STACK)
+        DIE("stack overflow");
+
+#define RA (&base[I_A(i)])
+#define RK(x) ((x) & RK_CONST ? &k[(x) & 0xFF] : &base[x])
+// EQ/LT/LE/TEST are always followed by a JMP: take it here, saving a dispatch
+#define VM_COND_JUMP(cond)              \
+    do                                  \
+    {                                   \
+        if (cond)                       \
+            pc++;                       \
+        else                            \
+            pc += I_sBx(*pc) + 1;       \
+    } while (0)
+#ifdef __GNUC__
+#define OP_LABEL(o) &&L_##o,
+    static const void *const labels[] = {OPCODES(OP_LABEL)};
+#define VM_CASE(o) L_##o
+#define VM_DISPATCH() goto *labels[ONCHIP_OP(I_OP(i = *pc++))]
+#else
+#define VM_CASE(o) case OP_##o
+#define VM_DISPATCH() goto dispatch
+#endif
+#define VM_ARITH(o, expr)                                       \
+    VM_CASE(o):                                                \
+    {                                                           \
+        const Value *rb = RK(I_B(i)), *rc = RK(I_C(i));         \
+        if (rb->t != V_NUM || rc->t != V_NUM)                   \
+            vm_error(f, pc, "expected number, got %s",          \
+                     vtag(rb->t != V_NUM ? rb->t : rc->t));     \
+        double x = rb->u.num, y = rc->u.num;                    \
+        RA->t = V_NUM;                                          \
+        RA->u.num = (expr);                                     \
+    }                                                           \
+    VM_DISPATCH();
+#define VM_CMP(o, op)                                           \
+    VM_CASE(o):                                                \
+    {                                                           \
+        const Value *rb = RK(I_B(i)), *rc = RK(I_C(i));         \
+        if (rb->t != V_NUM || rc->t != V_NUM)                   \
+            vm_error(f, pc, "expected number, got %s",          \
+                     vtag(rb->t != V_NUM ? rb->t : rc->t));     \
+        VM_COND_JUMP((rb->u.num op rc->u.num) != I_A(i));       \
+    }                                                           \
+    VM_DISPATCH();
+
+    VM_DISPATCH();
+#ifndef __GNUC__
+dispatch:
+    i = *pc++;
+    switch (ONCHIP_OP(I_OP(i)))
+#endif
+    {
+    VM_CASE(MOVE):
+        *RA = base[I_B(i)];
+        VM_DISPATCH();
+    VM_CASE(LOADK):
+        *RA = k[I_Bx(i)];
+        VM_DISPATCH();
+    VM_CASE(LOADNIL):
+        RA->t = V_NIL;
+        VM_DISPATCH();
+    VM_CASE(LOADBOOL):
+        RA->t = V_BOOL;
+        RA->u.boolean = I_B(i);
+        if (I_C(i))
+            pc++;
+        VM_DISPATCH();
+    VM_CASE(GETGLOBAL):
+        {
+            const Value *g = &G[I_Bx(i)];
+            if (g->t == V_UNDEF)
+                vm_error(f, pc, "undefined variable '%s'", istr[I_Bx(i)]);
+            *RA = *g;
+        }
+        VM_DISPATCH();
+    VM_CASE(SETGLOBAL):
+        G[I_Bx(i)] = *RA;
+        VM_DISPATCH();
+    VM_CASE(INITLOCAL):
+        *RA = G[I_Bx(i)];
+        if (RA->t == V_UNDEF)
+            RA->t = V_NIL;
+        VM_DISPATCH();
+    VM_ARITH(ADD, x + y)
+    VM_ARITH(SUB, x - y)
+    VM_ARITH(MUL, x * y)
+    VM_ARITH(DIV, x / y)
+    VM_ARITH(MOD, num_mod(x, y))
+    VM_ARITH(POW, pow(x, y))
+    VM_CASE(CONCAT):
+        {
+            int bad;
+            char *s = concat_values(&base[I_B(i)], I_C(i) - I_B(i) + 1, &bad);
+            if (!s)
+                vm_error(f, pc, "attempt to concatenate a %s value", vtag(base[I_B(i) + bad].t));
+            RA->t = V_STR;
+            RA->u.str = s;
+        }
+        VM_DISPATCH();
+    VM_CASE(UNM):
+        {
+            const Value *rb = &base[I_B(i)];
+            if (rb->t != V_NUM)
+                vm_error(f, pc, "expected number, got %s", vtag(rb->t));
+            double x = -rb->u.num;
+            RA->t = V_NUM;
+            RA->u.num = x;
+        }
+        VM_DISPATCH();
+    VM_CASE(NOT):
+        {
+            int b = !is_truthy(base[I_B(i)]);
+            RA->t = V_BOOL;
+            RA->u.boolean = b;
+        }
+        VM_DISPATCH();
+    VM_CASE(EQ):
+        VM_COND_JUMP(values_equal(RK(I_B(i)), RK(I_C(i))) != I_A(i));
+        VM_DISPATCH();
+    VM_CMP(LT, <)
+    VM_CMP(LE, <=)
+    VM_CASE(TEST):
+        VM_COND_JUMP(is_truthy(*RA) != I_C(i));
+        VM_DISPATCH();
+    VM_CASE(JMP):
+        pc += I_sBx(i);
+        VM_DISPATCH();
+    VM_CASE(CALL):
+        {
+            Value *fn = RA;
+            int nargs = I_B(i);
+            if (fn->t == V_CFUNC)
+            {
+                *fn = fn->u.cfn(nargs, fn + 1);
+                VM_DISPATCH();
+            }
+            if (fn->t != V_PROTO)
+                vm_error(f, pc, "attempt to call a %s value", vtag(fn->t));
+            Proto *g = fn->u.proto;
+            Value *nb = fn + 1;
+            if (fp + 1 == bvm_frames + BVM_FRAMES || nb + g->nregs > bvm_stack + BVM_STACK)
+                vm_error(f, pc, "stack overflow");
+            for (int a = nargs; a < g->nparams; a++)
+                nb[a].t = V_NIL;
+            fp->f = f;
+            fp->pc = pc;
+            fp->base = base;
+            fp++;
+            f = g;
+            k = f->k;
+            base = nb;
+            pc = f->code;
+        }
+        VM_DISPATCH();
+    VM_CASE(RETURN):
+        {
+            Value r;
+            if (I_B(i))
+                r = *RA;
+            else
+                r.t = V_NIL;
+            if (fp == bvm_frames)
+                return;
+            base[-1] = r;
+            fp--;
+            f = fp->f;
+            k = f->k;
+            base = fp->base;
+            pc = fp->pc;
+        }
+        VM_DISPATCH();
+    VM_CASE(FUNC):
+        RA->t = V_PROTO;
+        RA->u.proto = f->protos[I_Bx(i)];
+        VM_DISPATCH();
+    }
+#undef RA
+#undef RK
+#undef VM_COND_JUMP
+#undef VM_CASE
+#undef VM_DISPATCH
+#undef VM_ARITH
+#undef VM_CMP
+}
+
 /*======================== Runner / REPL ========================*/
 static char *read_file(const char *path)
 {
@@ -1210,9 +2271,22 @@ static char *read_file(const char *path)
     return buf;
 }
 
+static int opt_tree; // --tree: evaluate the AST directly instead of compiling
+
+static void run_bytecode(AST *prog)
+{
+    bvm_init();
+    bvm_execute(compile_chunk(prog));
+}
+
 static void run_code(const char *code)
 {
     AST *prog = parse_chunk(code);
+    if (!opt_tree)
+    {
+        run_bytecode(prog);
+        return;
+    }
     VM vm = {0};
     vm.G = env_new(NULL);
     eval(&vm, vm.G, prog);
@@ -1256,7 +2330,10 @@ static void repl(void)
         }
         // parse & eval
         AST *prog = parse_chunk(code);
-        eval(&vm, G, prog);
+        if (opt_tree)
+            eval(&vm, G, prog);
+        else
+            run_bytecode(prog); // globals persist across lines
         free(code);
     }
 }
@@ -1281,6 +2358,156 @@ static const char DEMO_LUA[] =
 "end\n";
 
 
+/*======================== Benchmarks ========================*/
+// Each script leaves its result in global r, which both engines must agree on.
+static const struct
+{
+    const char *name;
+    const char *src;
+} BENCH[] = {
+    {"fib",
+     "function fib(n)\n"
+     "  if n < 2 then return n end\n"
+     "  return fib(n-1) + fib(n-2)\n"
+     "end\n"
+     "r = fib(25)\n"},
+    {"loops",
+     "function loop(n)\n"
+     "  i = 0\n"
+     "  s = 0\n"
+     "  while i < n do\n"
+     "    if i % 3 == 0 and i ~= 6 then s = s + i * 2 else s = s - 1 end\n"
+     "    i = i + 1\n"
+     "  end\n"
+     "  return s\n"
+     "end\n"
+     "r = loop(1000000)\n"},
+    {"concat",
+     "function build(n)\n"
+     "  i = 0\n"
+     "  s = \"\"\n"
+     "  while i < n do\n"
+     "    if i % 100 == 0 then s = \"\" end\n"
+     "    s = s .. \"k\" .. i .. \",\"\n"
+     "    i = i + 1\n"
+     "  end\n"
+     "  return s\n"
+     "end\n"
+     "r = build(100000)\n"},
+};
+
+static double ms_since(clock_t t0) { return (double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC; }
+
+static int run_bench(void)
+{
+    int bad = 0;
+    printf("%-8s %10s %10s %8s\n", "bench", "tree ms", "vm ms", "speedup");
+    for (size_t b = 0; b < sizeof(BENCH) / sizeof(BENCH[0]); b++)
+    {
+        AST *prog = parse_chunk(BENCH[b].src);
+        VM vm = {0};
+        vm.G = env_new(NULL);
+        clock_t t0 = clock();
+        eval(&vm, vm.G, prog);
+        double tree_ms = ms_since(t0);
+        Value tree_r = V_nil();
+        env_get(vm.G, "r", &tree_r);
+
+        t0 = clock();
+        run_bytecode(prog); // compile time included
+        double vm_ms = ms_since(t0);
+        Value vm_r = gvals[intern("r")];
+
+        int same = values_equal(&tree_r, &vm_r);
+        printf("%-8s %10.1f %10.1f %7.1fx%s\n", BENCH[b].name, tree_ms, vm_ms,
+               vm_ms > 0 ? tree_ms / vm_ms : 0.0, same ? "" : "  MISMATCH");
+        bad |= !same;
+    }
+    return bad;
+}
+
+/*======================== Library entry point ========================*/
+#ifdef ONCHIP_LIB
+// The suite's workloads for onchip_bench.c (no tables, so no lists); each
+// leaves its result in global r, a string counting as its length. Strings
+// are never collected, so every append shows up as retained heap.
+static const OnchipWorkload LIB_WORK[] = {
+    {"loops",
+     "function loops()\n"
+     "  r = 0\n"
+     "  i = 0\n"
+     "  while i < 1000 do\n"
+     "    j = 0\n"
+     "    while j < 1000 do\n"
+     "      r = r + 1\n"
+     "      j = j + 1\n"
+     "    end\n"
+     "    i = i + 1\n"
+     "  end\n"
+     "  return r\n"
+     "end\n"
+     "r = loops()\n",
+     1e6, 1e6},
+    {"arith",
+     "function arith(n)\n"
+     "  r = 0\n"
+     "  i = 0\n"
+     "  while i < n do\n"
+     "    r = r + ((i + 3) * 4 - i * 4 - 11)\n"
+     "    i = i + 1\n"
+     "  end\n"
+     "  return r\n"
+     "end\n"
+     "r = arith(200000)\n",
+     2e5, 2e5},
+    {"recursion",
+     "function fib(n)\n"
+     "  if n < 2 then return n end\n"
+     "  return fib(n-1) + fib(n-2)\n"
+     "end\n"
+     "r = fib(24)\n",
+     150049, 46368},
+    {"strings",
+     "function build(n)\n"
+     "  i = 0\n"
+     "  s = \"\"\n"
+     "  while i < n do\n"
+     "    if i % 100 == 0 then s = \"\" end\n"
+     "    s = s .. \"abcd\"\n"
+     "    i = i + 1\n"
+     "  end\n"
+     "  return s\n"
+     "end\n"
+     "r = build(100000)\n",
+     1e5, 400},
+};
+
+static Proto *lib_main;
+
+static int lib_load(const char *src)
+{
+    bvm_init();
+    lib_main = compile_chunk(parse_chunk(src));
+    return 1;
+}
+
+static int lib_run(double *result)
+{
+    bvm_execute(lib_main);
+    Value r = gvals[intern("r")];
+    if (r.t == V_STR)
+        *result = (double)strlen(r.u.str);
+    else
+        *result = r.t == V_NUM ? r.u.num : NAN;
+    return 1;
+}
+
+// Protos and interned names stay, as in the REPL
+static void lib_unload(void) { lib_main = NULL; }
+
+#define main onchip_lua_main
+#endif
+
 /*======================== Main ========================*/
 
 int main(int argc, char **argv)
@@ -1290,6 +2517,16 @@ int main(int argc, char **argv)
     //   ./luette --demo          -> run embedded demo
     //   ./luette --repl          -> interactive REPL
     //   ./luette script.lu       -> run file
+    //   ./luette --tree ...      -> same, on the AST walker instead of bytecode
+    //   ./luette --dis script.lu -> list the compiled bytecode
+    //   ./luette --bench         -> time tree walker vs bytecode VM
+
+    if (argc >= 2 && strcmp(argv[1], "--tree") == 0)
+    {
+        opt_tree = 1;
+        argv++;
+        argc--;
+    }
 
     if (argc == 1)
     {
@@ -1310,9 +2547,25 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0)
+        return run_bench();
+
+    if (argc >= 3 && strcmp(argv[1], "--dis") == 0)
+    {
+        char *code = read_file(argv[2]);
+        dis_proto(compile_chunk(parse_chunk(code)));
+        free(code);
+        return 0;
+    }
+
     // Otherwise, treat argv[1] as a file path
     char *code = read_file(argv[1]);
     run_code(code);
     free(code);
     return 0;
 }
+
+#ifdef ONCHIP_LIB
+const OnchipEngine onchip_engine_lua = {"lua", LIB_WORK, (int)(sizeof(LIB_WORK) / sizeof(LIB_WORK[0])),
+                                        lib_load, lib_run, lib_unload, op_names, OP_COUNT, main};
+#endif
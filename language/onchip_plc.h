@@ -0,0 +1,786 @@
+/*
+ * onchip_plc.h — compiled scan programs and a cyclic task scheduler shared
+ * by the PLC front ends (onchip_plc_ld.c, _st.c, _fbd.c, _sfc.c)
+ *
+ * What this provides
+ *  - PlcImage: the process image. BOOLs are packed 64 per uint64_t word, so
+ *    contacts on one word test with a single mask; REALs sit in a separate
+ *    area and function-block state (TON, R_TRIG, SR) beside them.
+ *  - PlcProg: a flat instruction list over a BOOL accumulator, a 64-deep
+ *    bit stack for nested expressions and a REAL accumulator. Front ends
+ *    compile once at load; plc_run() executes one scan with no parsing and
+ *    no name lookups.
+ *  - PlcExprs: a small BOOL expression tree (NOT/AND/OR/XOR over bits and
+ *    constants) for the textual front ends. Builders fold constants, and
+ *    plc_emit_expr() feeds simple operands straight into AND/OR instead of
+ *    going through the stack.
+ *  - Peephole: consecutive contacts of one polarity on the same image word
+ *    merge into one masked test (LD a; AND b; AND c is a single LD), as do
+ *    consecutive OUT/SET/RESET coils; reloading a bit just written by OUT
+ *    is dropped.
+ *  - PlcTask/plc_sched_run(): a non-preemptive cyclic scheduler. Tasks have
+ *    fixed periods and, when due together, run in array order. Every scan
+ *    is timed; plc_sched_report() prints min/avg/max (WCET) execution time,
+ *    release jitter and overruns in microseconds.
+ *  - plc_run() counts each dispatch per opcode in ONCHIP_PROFILE builds.
+ *
+ * Semantics
+ *  - Masked contacts: LD/AND are true when every bit of the mask is set,
+ *    LDN/ANDN when every bit is clear, OR when any bit is set, ORN when any
+ *    is clear. With one bit these are the usual IL contacts.
+ *  - TON: Q once IN has been true for PT ms; ET starts at the dt of the
+ *    first scan. A non-zero preset in the instruction replaces the block's
+ *    (the LD front end lets each rung restate PT; the last one sticks).
+ *  - Tasks get their nominal period as dt, so timers advance the same way
+ *    on every run. In real-time mode releases are absolute CLOCK_MONOTONIC
+ *    times; a task that falls more than a period behind skips the releases
+ *    it missed (counted as overruns) rather than bursting to catch up.
+ *  - Compile errors set too_big/too_deep on the PlcProg; the front ends
+ *    check them once after compiling.
+ *
+ * Header only (static functions), so each interpreter stays a single-file
+ * build. Needs POSIX clocks (_GNU_SOURCE or _POSIX_C_SOURCE >= 200112L
+ * before the first include):
+ *   #include "onchip_plc.h"
+ */
+
+#ifndef ONCHIP_PLC_H
+#define ONCHIP_PLC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "onchip_bench.h"
+
+#define PLC_BIT_WORDS 64u /* 4096 BOOLs */
+#define PLC_REAL_MAX 256u
+#define PLC_FB_MAX 128u
+#define PLC_CODE_MAX 4096u
+#define PLC_EXPR_MAX 1024u
+#define PLC_STACK_DEPTH 64u
+
+/* ---------------- Process image ---------------- */
+
+typedef struct
+{
+    uint32_t pt_ms; /* preset (TON) */
+    uint32_t et_ms; /* elapsed (TON) */
+    bool in_prev;   /* TON, R_TRIG */
+    bool q;         /* TON, SR */
+} PlcFb;
+
+typedef struct
+{
+    uint64_t bits[PLC_BIT_WORDS];
+    float real[PLC_REAL_MAX];
+    PlcFb fb[PLC_FB_MAX];
+    uint32_t nbits, nreal, nfb; /* allocated so far */
+} PlcImage;
+
+static inline void plc_image_init(PlcImage *img)
+{
+    memset(img, 0, sizeof(*img));
+}
+
+/* Allocators return -1 when the area is full */
+static inline int plc_alloc_bit(PlcImage *img)
+{
+    if (img->nbits >= PLC_BIT_WORDS * 64u)
+        return -1;
+    return (int)img->nbits++;
+}
+
+/* n whole words, aligned, for word-at-a-time ops; returns the first bit */
+static inline int plc_alloc_words(PlcImage *img, uint32_t n)
+{
+    uint32_t first = (img->nbits + 63u) & ~63u;
+    if (first + (n * 64u) > PLC_BIT_WORDS * 64u)
+        return -1;
+    img->nbits = first + (n * 64u);
+    return (int)first;
+}
+
+static inline int plc_alloc_real(PlcImage *img)
+{
+    if (img->nreal >= PLC_REAL_MAX)
+        return -1;
+    return (int)img->nreal++;
+}
+
+static inline int plc_alloc_fb(PlcImage *img)
+{
+    if (img->nfb >= PLC_FB_MAX)
+        return -1;
+    return (int)img->nfb++;
+}
+
+static inline bool plc_get(const PlcImage *img, uint32_t bit)
+{
+    return ((img->bits[bit >> 6] >> (bit & 63u)) & 1u) != 0u;
+}
+
+static inline void plc_put(PlcImage *img, uint32_t bit, bool v)
+{
+    uint64_t m = (uint64_t)1u << (bit & 63u);
+    if (v)
+        img->bits[bit >> 6] |= m;
+    else
+        img->bits[bit >> 6] &= ~m;
+}
+
+static inline bool plc_ton(PlcFb *t, bool in, uint32_t dt_ms, uint32_t pt_override)
+{
+    if (pt_override > 0u)
+        t->pt_ms = pt_override;
+    if (in)
+    {
+        if (t->in_prev)
+        {
+            uint64_t sum = (uint64_t)t->et_ms + dt_ms;
+            t->et_ms = (sum > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (uint32_t)sum;
+        }
+        else
+            t->et_ms = dt_ms;
+    }
+    else
+        t->et_ms = 0u;
+    t->in_prev = in;
+    t->q = (t->pt_ms > 0u) && (t->et_ms >= t->pt_ms);
+    return t->q;
+}
+
+/* ---------------- Instructions ---------------- */
+
+/* Operands: w = image word (bits), REAL index or step word; m = bit mask
+   within bits[w] (or TON preset); k = constant, jump target or FB index. */
+#define PLC_OPCODES(X)                                          \
+    X(END)      /* stop the scan */                              \
+    X(LD)       /* acc = all of m set */                         \
+    X(LDN)      /* acc = none of m set */                        \
+    X(AND)      /* acc &= all of m set */                        \
+    X(ANDN)     /* acc &= none of m set */                       \
+    X(OR)       /* acc |= any of m set */                        \
+    X(ORN)      /* acc |= any of m clear */                      \
+    X(XOR)      /* acc ^= bit m */                               \
+    X(LDK)      /* acc = k */                                    \
+    X(NOT)      /* acc = !acc */                                 \
+    X(PUSH)     /* push acc on the bit stack */                  \
+    X(POPAND)   /* acc = pop & acc */                            \
+    X(POPOR)    /* acc = pop | acc */                            \
+    X(POPXOR)   /* acc = pop ^ acc */                            \
+    X(OUT)      /* bits m = acc */                               \
+    X(SET)      /* if acc: bits m = 1 */                         \
+    X(RESET)    /* if acc: bits m = 0 */                         \
+    X(TON)      /* acc = TON fb[k] (IN = acc, PT override = m) */ \
+    X(RTRIG)    /* acc = rising edge of acc, state fb[k] */      \
+    X(SR)       /* fb[k]: S = pop, R = acc (reset wins); acc=Q */ \
+    X(JMP)      /* goto k */                                     \
+    X(JMPF)     /* if !acc goto k */                             \
+    X(LDR)      /* racc = real[w] */                             \
+    X(LDRB)     /* racc = bit m ? 1 : 0 */                       \
+    X(LDRK)     /* racc = (int32)k */                            \
+    X(ADDR)     /* racc += real[w] */                            \
+    X(SUBR)     /* racc -= real[w] */                            \
+    X(MULR)     /* racc *= real[w] */                            \
+    X(GTR)      /* acc = racc > real[w] */                       \
+    X(LTR)      /* acc = racc < real[w] */                       \
+    X(EQR)      /* acc = |racc - real[w]| < 1e-6 */              \
+    X(NZR)      /* acc = racc != 0 */                            \
+    X(STR)      /* real[w] = racc */                             \
+    X(STEPS)    /* SFC commit over k words at w, see plc_run() */
+
+#define PLC_OP_ENUM(o) PLC_##o,
+enum
+{
+    PLC_OPCODES(PLC_OP_ENUM) PLC_NOPS
+};
+#undef PLC_OP_ENUM
+#define PLC_OP_NAME(o) #o,
+static const char *const plc_op_names[] = {PLC_OPCODES(PLC_OP_NAME)};
+#undef PLC_OP_NAME
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t pad;
+    uint16_t w;
+    uint32_t k;
+    uint64_t m;
+} PlcIns;
+
+typedef struct
+{
+    PlcIns code[PLC_CODE_MAX];
+    uint32_t n;
+    uint32_t barrier; /* no peephole may touch code before this */
+    int too_big;      /* code area overflowed */
+    int too_deep;     /* expression nesting beyond the bit stack */
+} PlcProg;
+
+static inline void plc_prog_init(PlcProg *P)
+{
+    P->n = 0u;
+    P->barrier = 0u;
+    P->too_big = 0;
+    P->too_deep = 0;
+}
+
+static inline uint32_t plc_emit(PlcProg *P, int op, uint32_t w, uint32_t k, uint64_t m)
+{
+    if (P->n >= PLC_CODE_MAX)
+    {
+        P->too_big = 1;
+        return P->n;
+    }
+    PlcIns *i = &P->code[P->n];
+    i->op = (uint8_t)op;
+    i->pad = 0u;
+    i->w = (uint16_t)w;
+    i->k = k;
+    i->m = m;
+    return P->n++;
+}
+
+/* A jump target here: later instructions must not merge into earlier ones */
+static inline uint32_t plc_label(PlcProg *P)
+{
+    P->barrier = P->n;
+    return P->n;
+}
+
+static inline void plc_patch(PlcProg *P, uint32_t at)
+{
+    if (at < P->n)
+        P->code[at].k = plc_label(P);
+}
+
+/* Can `op` on the same word fold into the previous instruction's mask? */
+static inline bool plc_merges(int prev, int op)
+{
+    switch (op)
+    {
+    case PLC_AND:
+        return (prev == PLC_LD) || (prev == PLC_AND);
+    case PLC_ANDN:
+        return (prev == PLC_LDN) || (prev == PLC_ANDN);
+    case PLC_OR:
+    case PLC_ORN:
+    case PLC_OUT:
+    case PLC_SET:
+    case PLC_RESET:
+        return prev == op;
+    default:
+        return false;
+    }
+}
+
+/* A contact or coil on one image bit. LD of a bit the previous OUT just
+   wrote is dropped: acc still holds it. */
+static inline void plc_emit_bit(PlcProg *P, int op, uint32_t bit)
+{
+    uint32_t w = bit >> 6;
+    uint64_t m = (uint64_t)1u << (bit & 63u);
+    if (P->n > P->barrier)
+    {
+        PlcIns *last = &P->code[P->n - 1u];
+        if ((last->w == w) && plc_merges(last->op, op))
+        {
+            last->m |= m;
+            return;
+        }
+        if ((last->w == w) && (last->op == PLC_OUT) && (op == PLC_LD) && ((last->m & m) != 0u))
+            return;
+    }
+    (void)plc_emit(P, op, w, 0u, m);
+}
+
+/* ---------------- BOOL expressions ---------------- */
+
+enum
+{
+    PX_K,
+    PX_BIT,
+    PX_NOT,
+    PX_AND,
+    PX_OR,
+    PX_XOR
+};
+
+typedef struct
+{
+    uint8_t kind;
+    bool k;
+    uint32_t bit;
+    int a, b;
+} PlcExpr;
+
+typedef struct
+{
+    PlcExpr e[PLC_EXPR_MAX];
+    int n;
+    int too_big;
+} PlcExprs;
+
+static inline int plc_x_new(PlcExprs *X, int kind, bool k, uint32_t bit, int a, int b)
+{
+    if (X->n >= (int)PLC_EXPR_MAX)
+    {
+        X->too_big = 1;
+        return 0;
+    }
+    PlcExpr *e = &X->e[X->n];
+    e->kind = (uint8_t)kind;
+    e->k = k;
+    e->bit = bit;
+    e->a = a;
+    e->b = b;
+    return X->n++;
+}
+
+static inline int plc_x_k(PlcExprs *X, bool k) { return plc_x_new(X, PX_K, k, 0u, -1, -1); }
+static inline int plc_x_bit(PlcExprs *X, uint32_t bit) { return plc_x_new(X, PX_BIT, false, bit, -1, -1); }
+
+static inline int plc_x_not(PlcExprs *X, int a)
+{
+    if (X->e[a].kind == PX_K)
+        return plc_x_k(X, !X->e[a].k);
+    if (X->e[a].kind == PX_NOT)
+        return X->e[a].a;
+    return plc_x_new(X, PX_NOT, false, 0u, a, -1);
+}
+
+/* kind is PX_AND, PX_OR or PX_XOR; constant operands fold away */
+static inline int plc_x_bin(PlcExprs *X, int kind, int a, int b)
+{
+    for (int side = 0; side < 2; side++)
+    {
+        int c = side ? a : b, other = side ? b : a;
+        if (X->e[c].kind != PX_K)
+            continue;
+        bool k = X->e[c].k;
+        if (kind == PX_XOR)
+            return k ? plc_x_not(X, other) : other;
+        if (k == (kind == PX_OR))
+            return c; /* x AND FALSE, x OR TRUE */
+        return other;
+    }
+    return plc_x_new(X, kind, false, 0u, a, b);
+}
+
+static inline void plc_emit_expr_at(PlcProg *P, const PlcExprs *X, int i, uint32_t depth)
+{
+    static const int contact[3][2] = {{PLC_AND, PLC_ANDN}, {PLC_OR, PLC_ORN}, {PLC_XOR, -1}};
+    static const int pop[3] = {PLC_POPAND, PLC_POPOR, PLC_POPXOR};
+    const PlcExpr *e = &X->e[i];
+    switch (e->kind)
+    {
+    case PX_K:
+        (void)plc_emit(P, PLC_LDK, 0u, e->k ? 1u : 0u, 0u);
+        return;
+    case PX_BIT:
+        plc_emit_bit(P, PLC_LD, e->bit);
+        return;
+    case PX_NOT:
+        if (X->e[e->a].kind == PX_BIT)
+            plc_emit_bit(P, PLC_LDN, X->e[e->a].bit);
+        else
+        {
+            plc_emit_expr_at(P, X, e->a, depth);
+            (void)plc_emit(P, PLC_NOT, 0u, 0u, 0u);
+        }
+        return;
+    default:
+    {
+        int op = e->kind - PX_AND;
+        const PlcExpr *r = &X->e[e->b];
+        plc_emit_expr_at(P, X, e->a, depth);
+        if (r->kind == PX_BIT)
+            plc_emit_bit(P, contact[op][0], r->bit);
+        else if ((r->kind == PX_NOT) && (X->e[r->a].kind == PX_BIT) && (contact[op][1] >= 0))
+            plc_emit_bit(P, contact[op][1], X->e[r->a].bit);
+        else if (depth + 1u >= PLC_STACK_DEPTH)
+            P->too_deep = 1;
+        else
+        {
+            (void)plc_emit(P, PLC_PUSH, 0u, 0u, 0u);
+            plc_emit_expr_at(P, X, e->b, depth + 1u);
+            (void)plc_emit(P, pop[op], 0u, 0u, 0u);
+        }
+        return;
+    }
+    }
+}
+
+/* Code leaving the value of expression i in acc */
+static inline void plc_emit_expr(PlcProg *P, const PlcExprs *X, int i)
+{
+    plc_emit_expr_at(P, X, i, 0u);
+}
+
+/* ---------------- Scan ---------------- */
+
+/* One scan: run from the first instruction to END */
+static inline void plc_run(const PlcProg *P, PlcImage *img, uint32_t dt_ms)
+{
+    const PlcIns *code = P->code;
+    const PlcIns *pc = code;
+    const PlcIns *i;
+    uint64_t *bits = img->bits;
+    float *real = img->real;
+    bool acc = false;
+    uint64_t stk = 0u;
+    float racc = 0.0f;
+
+#ifdef __GNUC__
+#define PLC_OP_LABEL(o) &&L_##o,
+    static const void *const labels[] = {PLC_OPCODES(PLC_OP_LABEL)};
+#undef PLC_OP_LABEL
+#define CASE(o) L_##o
+#define NEXT() goto *labels[ONCHIP_OP((i = pc++)->op)]
+#else
+#define CASE(o) case PLC_##o
+#define NEXT() goto dispatch
+#endif
+
+    NEXT();
+#ifndef __GNUC__
+dispatch:
+    i = pc++;
+    switch (ONCHIP_OP(i->op))
+#endif
+    {
+    CASE(END):
+        return;
+    CASE(LD):
+        acc = (bits[i->w] & i->m) == i->m;
+        NEXT();
+    CASE(LDN):
+        acc = (bits[i->w] & i->m) == 0u;
+        NEXT();
+    CASE(AND):
+        acc = acc && ((bits[i->w] & i->m) == i->m);
+        NEXT();
+    CASE(ANDN):
+        acc = acc && ((bits[i->w] & i->m) == 0u);
+        NEXT();
+    CASE(OR):
+        acc = acc || ((bits[i->w] & i->m) != 0u);
+        NEXT();
+    CASE(ORN):
+        acc = acc || ((bits[i->w] & i->m) != i->m);
+        NEXT();
+    CASE(XOR):
+        acc = acc != ((bits[i->w] & i->m) != 0u);
+        NEXT();
+    CASE(LDK):
+        acc = i->k != 0u;
+        NEXT();
+    CASE(NOT):
+        acc = !acc;
+        NEXT();
+    CASE(PUSH):
+        stk = (stk << 1) | (uint64_t)acc;
+        NEXT();
+    CASE(POPAND):
+        acc = acc && ((stk & 1u) != 0u);
+        stk >>= 1;
+        NEXT();
+    CASE(POPOR):
+        acc = acc || ((stk & 1u) != 0u);
+        stk >>= 1;
+        NEXT();
+    CASE(POPXOR):
+        acc = acc != ((stk & 1u) != 0u);
+        stk >>= 1;
+        NEXT();
+    CASE(OUT):
+        bits[i->w] = (bits[i->w] & ~i->m) | (i->m & (0u - (uint64_t)acc));
+        NEXT();
+    CASE(SET):
+        if (acc)
+            bits[i->w] |= i->m;
+        NEXT();
+    CASE(RESET):
+        if (acc)
+            bits[i->w] &= ~i->m;
+        NEXT();
+    CASE(TON):
+        acc = plc_ton(&img->fb[i->k], acc, dt_ms, (uint32_t)i->m);
+        NEXT();
+    CASE(RTRIG):
+    {
+        PlcFb *f = &img->fb[i->k];
+        bool q = acc && !f->in_prev;
+        f->in_prev = acc;
+        acc = q;
+        NEXT();
+    }
+    CASE(SR):
+    {
+        PlcFb *f = &img->fb[i->k];
+        bool s = (stk & 1u) != 0u;
+        stk >>= 1;
+        if (acc)
+            f->q = false;
+        else if (s)
+            f->q = true;
+        acc = f->q;
+        NEXT();
+    }
+    CASE(JMP):
+        pc = code + i->k;
+        NEXT();
+    CASE(JMPF):
+        if (!acc)
+            pc = code + i->k;
+        NEXT();
+    CASE(LDR):
+        racc = real[i->w];
+        NEXT();
+    CASE(LDRB):
+        racc = ((bits[i->w] & i->m) != 0u) ? 1.0f : 0.0f;
+        NEXT();
+    CASE(LDRK):
+        racc = (float)(int32_t)i->k;
+        NEXT();
+    CASE(ADDR):
+        racc += real[i->w];
+        NEXT();
+    CASE(SUBR):
+        racc -= real[i->w];
+        NEXT();
+    CASE(MULR):
+        racc *= real[i->w];
+        NEXT();
+    CASE(GTR):
+        acc = racc > real[i->w];
+        NEXT();
+    CASE(LTR):
+        acc = racc < real[i->w];
+        NEXT();
+    CASE(EQR):
+    {
+        float d = racc - real[i->w];
+        acc = (d < 1e-6f) && (d > -1e-6f);
+        NEXT();
+    }
+    CASE(NZR):
+        acc = racc != 0.0f;
+        NEXT();
+    CASE(STR):
+        real[i->w] = racc;
+        NEXT();
+    CASE(STEPS):
+    {
+        /* k words of step flags at w, then k words of "activate" and k of
+           "deactivate" requests: clear the deactivated, set the activated
+           (activation wins), and clear the requests for the next scan */
+        uint64_t *s = &bits[i->w];
+        for (uint32_t j = 0u; j < i->k; j++)
+        {
+            s[j] = (s[j] & ~s[j + (2u * i->k)]) | s[j + i->k];
+            s[j + i->k] = 0u;
+            s[j + (2u * i->k)] = 0u;
+        }
+        NEXT();
+    }
+#ifndef __GNUC__
+    default:
+        return;
+#endif
+    }
+#undef CASE
+#undef NEXT
+}
+
+/* ---------------- Listing ---------------- */
+
+static inline const char *plc_op_name(int op)
+{
+    return ((op >= 0) && (op < PLC_NOPS)) ? plc_op_names[op] : "?";
+}
+
+/* bit_name(bit) may be NULL or return NULL; bits then print as %X<w>.<b> */
+static inline void plc_dis(const PlcProg *P, FILE *out, const char *(*bit_name)(uint32_t bit))
+{
+    for (uint32_t pc = 0u; pc < P->n; pc++)
+    {
+        const PlcIns *i = &P->code[pc];
+        fprintf(out, "%5u  %-7s", (unsigned)pc, plc_op_name(i->op));
+        switch (i->op)
+        {
+        case PLC_LD:
+        case PLC_LDN:
+        case PLC_AND:
+        case PLC_ANDN:
+        case PLC_OR:
+        case PLC_ORN:
+        case PLC_XOR:
+        case PLC_OUT:
+        case PLC_SET:
+        case PLC_RESET:
+        case PLC_LDRB:
+        {
+            const char *sep = " ";
+            for (uint32_t b = 0u; b < 64u; b++)
+            {
+                if (((i->m >> b) & 1u) == 0u)
+                    continue;
+                uint32_t bit = ((uint32_t)i->w * 64u) + b;
+                const char *nm = bit_name ? bit_name(bit) : NULL;
+                if (nm)
+                    fprintf(out, "%s%s", sep, nm);
+                else
+                    fprintf(out, "%s%%X%u.%u", sep, (unsigned)i->w, (unsigned)b);
+                sep = ", ";
+            }
+            break;
+        }
+        case PLC_LDK:
+        case PLC_LDRK:
+            fprintf(out, " %d", (int)(int32_t)i->k);
+            break;
+        case PLC_TON:
+            fprintf(out, " FB%u PT=%u", (unsigned)i->k, (unsigned)i->m);
+            break;
+        case PLC_RTRIG:
+        case PLC_SR:
+            fprintf(out, " FB%u", (unsigned)i->k);
+            break;
+        case PLC_JMP:
+        case PLC_JMPF:
+            fprintf(out, " -> %u", (unsigned)i->k);
+            break;
+        case PLC_LDR:
+        case PLC_ADDR:
+        case PLC_SUBR:
+        case PLC_MULR:
+        case PLC_GTR:
+        case PLC_LTR:
+        case PLC_EQR:
+        case PLC_STR:
+            fprintf(out, " %%R%u", (unsigned)i->w);
+            break;
+        case PLC_STEPS:
+            fprintf(out, " %%X%u x%u", (unsigned)i->w, (unsigned)i->k);
+            break;
+        default:
+            break;
+        }
+        fputc('\n', out);
+    }
+}
+
+/* ---------------- Cyclic scheduler ---------------- */
+
+typedef void (*PlcTaskFn)(void *ctx, uint32_t dt_ms);
+
+typedef struct
+{
+    const char *name;
+    uint32_t period_us;
+    PlcTaskFn fn;
+    void *ctx;
+    /* filled in by plc_sched_run() */
+    uint64_t release_ns;
+    uint32_t scans;
+    uint32_t overruns;
+    uint64_t exec_min_ns, exec_max_ns, exec_sum_ns;
+    uint64_t jit_max_ns, jit_sum_ns;
+} PlcTask;
+
+static inline uint64_t plc_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+}
+
+static inline void plc_sleep_until(uint64_t t_ns)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(t_ns / 1000000000u);
+    ts.tv_nsec = (long)(t_ns % 1000000000u);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+}
+
+/* Run the tasks for duration_us. With realtime == false the schedule runs
+   on a virtual clock as fast as possible: same order, same dt, no sleeping
+   (jitter is then zero and only execution times are meaningful). */
+static inline void plc_sched_run(PlcTask *tasks, int n, uint64_t duration_us, bool realtime)
+{
+    uint64_t t0 = realtime ? plc_now_ns() : 0u;
+    uint64_t end = t0 + (duration_us * 1000u);
+    for (int j = 0; j < n; j++)
+    {
+        PlcTask *t = &tasks[j];
+        t->release_ns = t0;
+        t->scans = 0u;
+        t->overruns = 0u;
+        t->exec_min_ns = UINT64_MAX;
+        t->exec_max_ns = 0u;
+        t->exec_sum_ns = 0u;
+        t->jit_max_ns = 0u;
+        t->jit_sum_ns = 0u;
+    }
+    for (;;)
+    {
+        PlcTask *t = NULL;
+        for (int j = 0; j < n; j++)
+            if ((t == NULL) || (tasks[j].release_ns < t->release_ns))
+                t = &tasks[j];
+        if ((t == NULL) || (t->release_ns >= end))
+            break;
+
+        uint64_t start;
+        if (realtime)
+        {
+            plc_sleep_until(t->release_ns);
+            start = plc_now_ns();
+        }
+        else
+            start = plc_now_ns();
+        t->fn(t->ctx, t->period_us / 1000u);
+        uint64_t stop = plc_now_ns();
+
+        uint64_t exec = stop - start;
+        uint64_t jit = (realtime && (start > t->release_ns)) ? (start - t->release_ns) : 0u;
+        t->scans++;
+        t->exec_sum_ns += exec;
+        t->exec_min_ns = (exec < t->exec_min_ns) ? exec : t->exec_min_ns;
+        t->exec_max_ns = (exec > t->exec_max_ns) ? exec : t->exec_max_ns;
+        t->jit_sum_ns += jit;
+        t->jit_max_ns = (jit > t->jit_max_ns) ? jit : t->jit_max_ns;
+
+        uint64_t period = (uint64_t)t->period_us * 1000u;
+        t->release_ns += period;
+        while (realtime && (t->release_ns + period <= stop))
+        {
+            t->release_ns += period;
+            t->overruns++;
+        }
+    }
+}
+
+static inline void plc_sched_report(const PlcTask *tasks, int n, FILE *out)
+{
+    fprintf(out, "%-8s %9s %7s %9s %9s %9s %9s %9s %8s\n", "task", "period us", "scans", "exec min", "exec avg",
+            "WCET", "jit avg", "jit max", "overruns");
+    for (int j = 0; j < n; j++)
+    {
+        const PlcTask *t = &tasks[j];
+        double scans = (t->scans > 0u) ? (double)t->scans : 1.0;
+        fprintf(out, "%-8s %9u %7u %9.3f %9.3f %9.3f %9.3f %9.3f %8u\n", t->name, (unsigned)t->period_us,
+                (unsigned)t->scans, (t->scans > 0u) ? (double)t->exec_min_ns / 1000.0 : 0.0,
+                (double)t->exec_sum_ns / scans / 1000.0, (double)t->exec_max_ns / 1000.0,
+                (double)t->jit_sum_ns / scans / 1000.0, (double)t->jit_max_ns / 1000.0, (unsigned)t->overruns);
+    }
+}
+
+#endif /* ONCHIP_PLC_H */
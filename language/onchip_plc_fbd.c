@@ -6,10 +6,16 @@
  *  - Parameters: N=<int> for variadic logic arity; PT=<ms> for TON preset time
  *  - DAG check via topological sort; executes one scan with dt_ms
  *  - Boolean and Real values with automatic coercion at sinks
+ *  - The network compiles once, in topological order, to a scan program over
+ *    the process image in onchip_plc.h: BOOL variables and block outputs are
+ *    packed bits, REALs image words, TON/R_TRIG/SR state function blocks.
+ *    The original block evaluator stays behind --interp and as the baseline
+ *    for --bench.
  *
  * Build:  gcc -std=c99 -O2 -Wall plc_fbd.c -o plc_fbd -lm
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,6 +23,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <math.h>
+#include <time.h>
+
+#include "onchip_plc.h"
 
 /* ---------- Limits ---------- */
 #define NAME_LEN 32
@@ -686,17 +695,328 @@ static void fbd_scan(uint32_t dt_ms)
     }
 }
 
+/* ---------- Compilation to a scan program ---------- */
+
+static PlcProg g_prog;
+static PlcImage g_img;
+static PlcExprs g_x;
+static bool g_interp = false; /* --interp: run fbd_scan() on the tables */
+
+/* Where each variable and block output lives: an image bit for BOOL, an
+   image REAL otherwise. Block output types are static: logic, compare and
+   FB blocks give BOOL, ADD/SUB/MUL REAL, MOVE the type of its input. */
+static int g_var_slot[MAX_VARS];
+static int g_blk_slot[MAX_BLOCKS];
+static bool g_blk_real[MAX_BLOCKS];
+
+/* A pure logic block (AND/OR/XOR/NOT) whose output has exactly one reader,
+   a block taking BOOL inputs, is not stored at all: its expression tree is
+   spliced into the reader (e.g. NOT feeding AND becomes an ANDN contact).
+   Inputs are stable for the whole block phase, so evaluating it later
+   gives the same value. */
+static int g_blk_expr[MAX_BLOCKS]; /* tree in g_x, or -1 when stored */
+static int g_expr_pending = 0;     /* spliced trees not yet consumed */
+
+typedef struct
+{
+    int connected;
+    int real;
+    int slot;
+} Src;
+
+static Src src_info(const SourceRef *s)
+{
+    Src r = {0, 0, 0};
+    if (s->index < 0)
+        return r;
+    r.connected = 1;
+    if (s->is_var)
+    {
+        r.real = g_vars[s->index].type == VT_REAL;
+        r.slot = g_var_slot[s->index];
+    }
+    else
+    {
+        r.real = g_blk_real[s->index];
+        r.slot = g_blk_slot[s->index];
+    }
+    return r;
+}
+
+static int need(int slot)
+{
+    if (slot < 0)
+    {
+        fprintf(stderr, "Process image full\n");
+        exit(1);
+    }
+    return slot;
+}
+
+/* Code leaving to_bool(source) in acc */
+static void emit_bool(const SourceRef *ref, Src s)
+{
+    if (s.connected && !ref->is_var && g_blk_expr[ref->index] >= 0)
+    {
+        g_expr_pending--;
+        plc_emit_expr(&g_prog, &g_x, g_blk_expr[ref->index]);
+        return;
+    }
+    if (!s.connected)
+        (void)plc_emit(&g_prog, PLC_LDK, 0u, 0u, 0u);
+    else if (s.real)
+    {
+        (void)plc_emit(&g_prog, PLC_LDR, (uint32_t)s.slot, 0u, 0u);
+        (void)plc_emit(&g_prog, PLC_NZR, 0u, 0u, 0u);
+    }
+    else
+        plc_emit_bit(&g_prog, PLC_LD, (uint32_t)s.slot);
+}
+
+/* Code leaving to_real(source) in racc */
+static void emit_real(Src s)
+{
+    if (!s.connected)
+        (void)plc_emit(&g_prog, PLC_LDRK, 0u, 0u, 0u);
+    else if (s.real)
+        (void)plc_emit(&g_prog, PLC_LDR, (uint32_t)s.slot, 0u, 0u);
+    else
+        plc_emit_bit(&g_prog, PLC_LDRB, (uint32_t)s.slot);
+}
+
+/* A REAL image index holding to_real(source), via a temporary if needed */
+static uint32_t real_operand(Src s)
+{
+    if (s.connected && s.real)
+        return (uint32_t)s.slot;
+    int tmp = need(plc_alloc_real(&g_img));
+    emit_real(s);
+    (void)plc_emit(&g_prog, PLC_STR, (uint32_t)tmp, 0u, 0u);
+    return (uint32_t)tmp;
+}
+
+/* An expression leaf for to_bool(source), via a temporary bit for REALs */
+static int bool_leaf(const SourceRef *ref, Src s)
+{
+    if (s.connected && !ref->is_var && g_blk_expr[ref->index] >= 0)
+    {
+        g_expr_pending--;
+        return g_blk_expr[ref->index];
+    }
+    if (!s.connected)
+        return plc_x_k(&g_x, false);
+    if (!s.real)
+        return plc_x_bit(&g_x, (uint32_t)s.slot);
+    int tmp = need(plc_alloc_bit(&g_img));
+    emit_bool(ref, s);
+    plc_emit_bit(&g_prog, PLC_OUT, (uint32_t)tmp);
+    return plc_x_bit(&g_x, (uint32_t)tmp);
+}
+
+static bool is_logic(const Block *b)
+{
+    return b->type == BT_AND || b->type == BT_OR || b->type == BT_XOR || b->type == BT_NOT;
+}
+
+static bool reads_real(const Block *b)
+{
+    return b->type == BT_ADD || b->type == BT_SUB || b->type == BT_MUL || b->type == BT_GT || b->type == BT_LT ||
+           b->type == BT_EQ;
+}
+
+static void compile_block(int bi, const int *block_refs, const bool *stored)
+{
+    Block *b = &g_blocks[bi];
+    Src in[MAX_PORTS];
+    for (int i = 0; i < b->n_in; i++)
+        in[i] = src_info(&b->inputs[i]);
+    if (g_expr_pending == 0)
+        g_x.n = 0;
+
+    g_blk_expr[bi] = -1;
+    if (is_logic(b))
+    {
+        int e;
+        if (b->type == BT_NOT)
+            e = plc_x_not(&g_x, bool_leaf(&b->inputs[0], in[0]));
+        else
+        {
+            int kind = (b->type == BT_AND) ? PX_AND : (b->type == BT_OR) ? PX_OR : PX_XOR;
+            e = plc_x_k(&g_x, b->type == BT_AND);
+            for (int i = 0; i < b->n_in; i++)
+                e = plc_x_bin(&g_x, kind, e, bool_leaf(&b->inputs[i], in[i]));
+        }
+        if (block_refs[bi] == 1 && !stored[bi])
+        {
+            g_blk_expr[bi] = e;
+            g_expr_pending++;
+            return;
+        }
+        g_blk_real[bi] = false;
+        g_blk_slot[bi] = need(plc_alloc_bit(&g_img));
+        plc_emit_expr(&g_prog, &g_x, e);
+        plc_emit_bit(&g_prog, PLC_OUT, (uint32_t)g_blk_slot[bi]);
+        return;
+    }
+
+    g_blk_real[bi] = (b->type == BT_ADD || b->type == BT_SUB || b->type == BT_MUL) ||
+                     (b->type == BT_MOVE && in[0].connected && in[0].real);
+    g_blk_slot[bi] = need(g_blk_real[bi] ? plc_alloc_real(&g_img) : plc_alloc_bit(&g_img));
+    uint32_t out = (uint32_t)g_blk_slot[bi];
+
+    switch (b->type)
+    {
+    case BT_MOVE:
+        if (g_blk_real[bi])
+            emit_real(in[0]);
+        else
+            emit_bool(&b->inputs[0], in[0]);
+        break;
+    case BT_ADD:
+    case BT_SUB:
+    case BT_MUL:
+    case BT_GT:
+    case BT_LT:
+    case BT_EQ:
+    {
+        static const int op[] = {[BT_ADD] = PLC_ADDR, [BT_SUB] = PLC_SUBR, [BT_MUL] = PLC_MULR,
+                                 [BT_GT] = PLC_GTR,   [BT_LT] = PLC_LTR,   [BT_EQ] = PLC_EQR};
+        uint32_t rhs = real_operand(in[1]);
+        emit_real(in[0]);
+        (void)plc_emit(&g_prog, op[b->type], rhs, 0u, 0u);
+        break;
+    }
+    case BT_TON:
+        emit_bool(&b->inputs[0], in[0]);
+        (void)plc_emit(&g_prog, PLC_TON, 0u, (uint32_t)need(plc_alloc_fb(&g_img)), b->PT_ms);
+        break;
+    case BT_RTRIG:
+        emit_bool(&b->inputs[0], in[0]);
+        (void)plc_emit(&g_prog, PLC_RTRIG, 0u, (uint32_t)need(plc_alloc_fb(&g_img)), 0u);
+        break;
+    case BT_SR:
+        emit_bool(&b->inputs[0], in[0]);
+        (void)plc_emit(&g_prog, PLC_PUSH, 0u, 0u, 0u);
+        emit_bool(&b->inputs[1], in[1]);
+        (void)plc_emit(&g_prog, PLC_SR, 0u, (uint32_t)need(plc_alloc_fb(&g_img)), 0u);
+        break;
+    default:
+        (void)plc_emit(&g_prog, PLC_LDK, 0u, 0u, 0u);
+        break;
+    }
+    if (g_blk_real[bi])
+        (void)plc_emit(&g_prog, PLC_STR, out, 0u, 0u);
+    else
+        plc_emit_bit(&g_prog, PLC_OUT, out);
+}
+
+/* Blocks in topological order, then the variable sinks in variable order,
+   as fbd_scan() does */
+static int compile_network(void)
+{
+    plc_prog_init(&g_prog);
+    plc_image_init(&g_img);
+    for (int vi = 0; vi < g_var_count; vi++)
+    {
+        if (g_vars[vi].type == VT_REAL)
+        {
+            g_var_slot[vi] = need(plc_alloc_real(&g_img));
+            g_img.real[g_var_slot[vi]] = g_vars[vi].val.v.r;
+        }
+        else
+        {
+            g_var_slot[vi] = need(plc_alloc_bit(&g_img));
+            plc_put(&g_img, (uint32_t)g_var_slot[vi], g_vars[vi].val.v.b);
+        }
+    }
+    static int block_refs[MAX_BLOCKS];
+    static bool stored[MAX_BLOCKS]; /* read by a variable or as a REAL */
+    memset(block_refs, 0, sizeof(block_refs));
+    memset(stored, 0, sizeof(stored));
+    for (int bi = 0; bi < g_block_count; bi++)
+        for (int i = 0; i < g_blocks[bi].n_in; i++)
+        {
+            const SourceRef *r = &g_blocks[bi].inputs[i];
+            if (!r->is_var && r->index >= 0)
+            {
+                block_refs[r->index]++;
+                stored[r->index] = stored[r->index] || reads_real(&g_blocks[bi]);
+            }
+        }
+    for (int vi = 0; vi < g_var_count; vi++)
+        if (g_vars[vi].has_sink && !g_vars[vi].sink_src.is_var)
+            stored[g_vars[vi].sink_src.index] = true;
+
+    g_expr_pending = 0;
+    for (int i = 0; i < g_block_count; i++)
+        compile_block(topo_order[i], block_refs, stored);
+    for (int vi = 0; vi < g_var_count; ++vi)
+    {
+        if (!g_vars[vi].has_sink)
+            continue;
+        Src s = src_info(&g_vars[vi].sink_src);
+        if (g_vars[vi].type == VT_BOOL)
+        {
+            emit_bool(&g_vars[vi].sink_src, s);
+            plc_emit_bit(&g_prog, PLC_OUT, (uint32_t)g_var_slot[vi]);
+        }
+        else
+        {
+            emit_real(s);
+            (void)plc_emit(&g_prog, PLC_STR, (uint32_t)g_var_slot[vi], 0u, 0u);
+        }
+    }
+    (void)plc_emit(&g_prog, PLC_END, 0u, 0u, 0u);
+    return !(g_prog.too_big || g_prog.too_deep || g_x.too_big);
+}
+
+static Value var_value(int vi)
+{
+    if (g_interp)
+        return g_vars[vi].val;
+    if (g_vars[vi].type == VT_REAL)
+        return make_real(g_img.real[g_var_slot[vi]]);
+    return make_bool(plc_get(&g_img, (uint32_t)g_var_slot[vi]));
+}
+
+/* Inputs go to both the variable table and the image */
+static void io_write(int vi, bool v)
+{
+    g_vars[vi].val = make_bool(v);
+    plc_put(&g_img, (uint32_t)g_var_slot[vi], v);
+}
+
+static void scan(uint32_t dt_ms)
+{
+    if (g_interp)
+        fbd_scan(dt_ms);
+    else
+        plc_run(&g_prog, &g_img, dt_ms);
+}
+
+static const char *bit_name(uint32_t bit)
+{
+    for (int vi = 0; vi < g_var_count; vi++)
+        if (g_vars[vi].type == VT_BOOL && g_var_slot[vi] == (int)bit)
+            return g_vars[vi].name;
+    for (int bi = 0; bi < g_block_count; bi++)
+        if (!g_blk_real[bi] && g_blk_expr[bi] < 0 && g_blk_slot[bi] == (int)bit)
+            return g_blocks[bi].name;
+    return NULL;
+}
+
 /* ---------- Pretty printing ---------- */
 static void print_vars(void)
 {
     printf("Vars: ");
     for (int i = 0; i < g_var_count; i++)
     {
+        Value v = var_value(i);
         printf("%s=", g_vars[i].name);
         if (g_vars[i].type == VT_BOOL)
-            printf("%d ", g_vars[i].val.v.b ? 1 : 0);
+            printf("%d ", v.v.b ? 1 : 0);
         else
-            printf("%.3f ", g_vars[i].val.v.r);
+            printf("%.3f ", v.v.r);
     }
     printf("\n");
 }
@@ -866,32 +1186,193 @@ static const char *demo_fbd =
     "CONNECT and1.OUT -> t1.IN;\n"
     "CONNECT t1.Q -> Lamp;\n";
 
+static int g_idx_start, g_idx_stop;
+static void drive_inputs(uint32_t t)
+{
+    io_write(g_idx_start, t >= 100 && t < 1500);
+    io_write(g_idx_stop, t >= 1500);
+}
+
+/* ---------- Benchmark / cyclic tasks ---------- */
+static double ms_since(clock_t t0) { return (double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC; }
+
+/* The demo network repeated on private blocks and outputs, so --bench
+   times a scan of realistic size rather than loop overhead */
+#define BENCH_COPIES 32
+static char g_bench_src[BENCH_COPIES * 512];
+static const char *bench_source(void)
+{
+    size_t n = (size_t)snprintf(g_bench_src, sizeof(g_bench_src), "VAR BOOL Start = 0;\nVAR BOOL Stop = 0;\n");
+    for (int i = 0; i < BENCH_COPIES; ++i)
+        n += (size_t)snprintf(g_bench_src + n, sizeof(g_bench_src) - n,
+                              "VAR BOOL Motor%d = 0;\nVAR BOOL Lamp%d = 0;\n"
+                              "BLOCK not%d NOT;\nBLOCK and%d AND N=2;\nBLOCK sr%d SR;\nBLOCK t%d TON PT=%d;\n"
+                              "CONNECT Stop -> not%d.IN;\nCONNECT Start -> and%d.IN1;\n"
+                              "CONNECT not%d.OUT -> and%d.IN2;\nCONNECT and%d.OUT -> sr%d.S;\n"
+                              "CONNECT Stop -> sr%d.R;\nCONNECT sr%d.Q -> Motor%d;\n"
+                              "CONNECT and%d.OUT -> t%d.IN;\nCONNECT t%d.Q -> Lamp%d;\n",
+                              i, i, i, i, i, i, 200 * (i % 10 + 1), i, i, i, i, i, i, i, i, i, i, i, i, i);
+    return g_bench_src;
+}
+
+static int run_bench(void)
+{
+    enum { SCANS = 200000 };
+    double ms[2];
+    for (int e = 0; e < 2; ++e)
+    {
+        g_interp = (e == 0);
+        clock_t t0 = clock();
+        for (int step = 0; step < SCANS; ++step)
+        {
+            drive_inputs((uint32_t)(step % 30) * 100u);
+            scan(100);
+        }
+        ms[e] = ms_since(t0);
+    }
+    int same = 1;
+    for (int vi = 0; vi < g_var_count; ++vi)
+    {
+        g_interp = true;
+        Value a = var_value(vi);
+        g_interp = false;
+        Value b = var_value(vi);
+        same = same && (to_real(a) == to_real(b));
+    }
+    printf("%-8s %6s %12s %12s %8s\n", "scans", "blocks", "interp us", "compiled us", "speedup");
+    printf("%-8d %6d %12.3f %12.3f %7.1fx%s\n", SCANS, g_block_count, ms[0] * 1000.0 / SCANS,
+           ms[1] * 1000.0 / SCANS, ms[1] > 0.0 ? ms[0] / ms[1] : 0.0, same ? "" : "  MISMATCH");
+    return same ? 0 : 1;
+}
+
+typedef struct
+{
+    uint32_t t_ms;
+} IoCtx;
+
+static void io_task(void *ctx, uint32_t dt_ms)
+{
+    IoCtx *io = (IoCtx *)ctx;
+    drive_inputs(io->t_ms);
+    io->t_ms += dt_ms;
+}
+
+static void logic_task(void *ctx, uint32_t dt_ms)
+{
+    (void)ctx;
+    scan(dt_ms);
+}
+
+/* ====== Library entry point for onchip_bench.c ====== */
+
+#ifdef ONCHIP_LIB
+/* The suite's scan workload: the demo's seal-in, with the Lamp on the SR's Q */
+static const OnchipWorkload LIB_WORK[] = {
+    {"scan",
+     "VAR BOOL Start = 0;\nVAR BOOL Stop = 0;\nVAR BOOL Motor = 0;\nVAR BOOL Lamp = 0;\n"
+     "BLOCK not1 NOT;\nBLOCK and1 AND N=2;\nBLOCK sr1 SR;\n"
+     "CONNECT Stop -> not1.IN;\nCONNECT Start -> and1.IN1;\nCONNECT not1.OUT -> and1.IN2;\n"
+     "CONNECT and1.OUT -> sr1.S;\nCONNECT Stop -> sr1.R;\n"
+     "CONNECT sr1.Q -> Motor;\nCONNECT sr1.Q -> Lamp;\n",
+     ONCHIP_SCANS, ONCHIP_SCAN_LAMP_ON},
+};
+
+static PlcImage lib_img0; /* the image as compiled, restored before each run */
+static int lib_lamp;
+
+static int lib_load(const char *src)
+{
+    if (!parse_program(src) || !compile_network())
+        return 0;
+    g_idx_start = var_index("Start");
+    g_idx_stop = var_index("Stop");
+    lib_lamp = var_index("Lamp");
+    lib_img0 = g_img;
+    return 1;
+}
+
+static int lib_run(double *result)
+{
+    long on = 0;
+    g_img = lib_img0;
+    for (long step = 0; step < ONCHIP_SCANS; ++step)
+    {
+        int start, stop;
+        onchip_scan_inputs(step, &start, &stop);
+        io_write(g_idx_start, start);
+        io_write(g_idx_stop, stop);
+        scan(ONCHIP_SCAN_DT_MS);
+        on += to_bool(var_value(lib_lamp));
+    }
+    *result = (double)on;
+    return 1;
+}
+
+static void lib_unload(void) {}
+
+#define main onchip_plc_fbd_main
+#endif
+
 /* ---------- Main: simulate a few seconds ---------- */
-int main(void)
+int main(int argc, char **argv)
 {
-    if (!parse_program(demo_fbd))
+    /* Usage:
+         plc_fbd               -> run the demo (30 scans of 100 ms)
+         plc_fbd --interp      -> same, on the block evaluator
+         plc_fbd --dis         -> list the compiled scan program
+         plc_fbd --bench       -> time block evaluator vs compiled scan on
+                                  the demo network repeated 32 times
+         plc_fbd --sched [ms]  -> run as real-time cyclic tasks (io 5 ms,
+                                  logic 10 ms) for ms (3000), report scan times */
+    const char *mode = (argc > 1) ? argv[1] : "";
+    bool bench = (strcmp(mode, "--bench") == 0);
+    if (!parse_program(bench ? bench_source() : demo_fbd))
     {
         fprintf(stderr, "Failed to parse FBD program.\n");
         return 1;
     }
-    int idxStart = var_index("Start");
-    int idxStop = var_index("Stop");
+    if (!compile_network())
+    {
+        fprintf(stderr, "Failed to compile FBD program.\n");
+        return 1;
+    }
+    g_idx_start = var_index("Start");
+    g_idx_stop = var_index("Stop");
+
+    if (strcmp(mode, "--dis") == 0)
+    {
+        plc_dis(&g_prog, stdout, bit_name);
+        return 0;
+    }
+    if (bench)
+        return run_bench();
+    if (strcmp(mode, "--sched") == 0)
+    {
+        IoCtx io = {0};
+        PlcTask tasks[2] = {{.name = "io", .period_us = 5000, .fn = io_task, .ctx = &io},
+                            {.name = "logic", .period_us = 10000, .fn = logic_task, .ctx = NULL}};
+        uint32_t run_ms = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 10) : 3000u;
+        plc_sched_run(tasks, 2, (uint64_t)run_ms * 1000u, true);
+        printf("t=%4ums  ", io.t_ms);
+        print_vars();
+        plc_sched_report(tasks, 2, stdout);
+        return 0;
+    }
+    g_interp = (strcmp(mode, "--interp") == 0);
 
     uint32_t t = 0;
     for (int step = 0; step < 30; ++step)
     {
-        if (t >= 100 && t < 1500)
-            g_vars[idxStart].val = make_bool(true);
-        else
-            g_vars[idxStart].val = make_bool(false);
-        if (t >= 1500)
-            g_vars[idxStop].val = make_bool(true);
-        else
-            g_vars[idxStop].val = make_bool(false);
-        fbd_scan(100); /* 100 ms scan time */
+        drive_inputs(t);
+        scan(100); /* 100 ms scan time */
         printf("t=%4ums  ", t);
         print_vars();
         t += 100;
     }
     return 0;
 }
+
+#ifdef ONCHIP_LIB
+const OnchipEngine onchip_engine_plc_fbd = {"plc_fbd", LIB_WORK, (int)(sizeof(LIB_WORK) / sizeof(LIB_WORK[0])),
+                                            lib_load, lib_run, lib_unload, plc_op_names, PLC_NOPS, main};
+#endif
@@ -1,14 +1,21 @@
 /* Ladder (LD) interpreter with IL-style input
  * Features: LD/LDN, AND/ANDN, OR/ORN, NOT, OUT/SET/RESET, TON (on-delay), ENDRUNG
  * Timer semantics (TON): Q turns TRUE when IN has been TRUE for PT ms; resets when IN=FALSE
+ * Rungs compile once to a flat scan program over the packed process image
+ * in onchip_plc.h (symbol i is image bit i, timer i is FB i); the original
+ * rung walker stays behind --interp and as the baseline for --bench.
  * Compile:  gcc -std=c99 -O2 -Wall plc_ld.c -o plc_ld
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdlib.h>
+
+#include "onchip_plc.h"
 
 /* ---------------- Config limits ---------------- */
 #define MAX_SYMBOLS 128
@@ -499,6 +506,126 @@ static void plc_scan(const Program *prog, uint32_t dt_ms)
     }
 }
 
+/* ---------------- Compilation to a scan program ---------------- */
+static PlcProg g_prog;
+static PlcImage g_img;
+static bool g_interp = false; /* --interp: run plc_scan() on the symbol table */
+
+/* Same accumulator rules as plc_scan(): each rung starts with ACC = FALSE,
+   and an AND/OR before the first load acts as the load. TON leaves the
+   rung "unloaded", so a contact after it still loads. */
+static bool program_compile(const Program *prog, PlcProg *P)
+{
+    plc_prog_init(P);
+    for (int r = 0; r < prog->rung_count; ++r)
+    {
+        const Rung *rg = &prog->rungs[r];
+        bool acc_init = false;
+        bool acc_set = false; /* ACC written in this rung (else still FALSE) */
+
+        for (int i = 0; i < rg->len; ++i)
+        {
+            const Instr *in = &rg->instrs[i];
+            int op = -1;
+            switch (in->op)
+            {
+            case OPC_LD:
+                op = PLC_LD;
+                break;
+            case OPC_LDN:
+                op = PLC_LDN;
+                break;
+            case OPC_AND:
+                op = acc_init ? PLC_AND : PLC_LD;
+                break;
+            case OPC_ANDN:
+                op = acc_init ? PLC_ANDN : PLC_LDN;
+                break;
+            case OPC_OR:
+                op = acc_init ? PLC_OR : PLC_LD;
+                break;
+            case OPC_ORN:
+                op = acc_init ? PLC_ORN : PLC_LDN;
+                break;
+            case OPC_OUT:
+                op = PLC_OUT;
+                break;
+            case OPC_SET:
+                op = PLC_SET;
+                break;
+            case OPC_RESET:
+                op = PLC_RESET;
+                break;
+            default:
+                break;
+            }
+            if (op == PLC_LD || op == PLC_LDN || op == PLC_AND || op == PLC_ANDN || op == PLC_OR || op == PLC_ORN)
+            {
+                if (in->var_idx < 0)
+                    return false;
+                plc_emit_bit(P, op, (uint32_t)in->var_idx);
+                acc_init = true;
+                acc_set = true;
+                continue;
+            }
+            if (in->op == OPC_ENDRUNG)
+                continue;
+
+            /* the rest read ACC */
+            if (!acc_set)
+            {
+                (void)plc_emit(P, PLC_LDK, 0u, 0u, 0u);
+                acc_set = true;
+            }
+            if (in->op == OPC_NOT)
+            {
+                (void)plc_emit(P, PLC_NOT, 0u, 0u, 0u);
+                acc_init = true;
+            }
+            else if (in->op == OPC_TON)
+            {
+                if (in->timer_idx < 0)
+                    return false;
+                (void)plc_emit(P, PLC_TON, 0u, (uint32_t)in->timer_idx, in->pt_ms);
+            }
+            else
+            {
+                if (in->var_idx < 0)
+                    return false;
+                plc_emit_bit(P, op, (uint32_t)in->var_idx);
+            }
+        }
+    }
+    (void)plc_emit(P, PLC_END, 0u, 0u, 0u);
+    return !P->too_big;
+}
+
+static bool var_value(int idx)
+{
+    return g_interp ? sym_get(idx) : plc_get(&g_img, (uint32_t)idx);
+}
+
+/* Inputs go to both the symbol table and the image */
+static void io_write(int idx, bool v)
+{
+    sym_set(idx, v);
+    if (idx >= 0)
+        plc_put(&g_img, (uint32_t)idx, v);
+}
+
+static void scan(const Program *prog, uint32_t dt_ms)
+{
+    if (g_interp)
+        plc_scan(prog, dt_ms);
+    else
+        plc_run(&g_prog, &g_img, dt_ms);
+}
+
+static const char *bit_name(uint32_t bit)
+{
+    return (bit < (uint32_t)g_symbol_count) ? g_symbols[bit].name : NULL;
+}
+
 /* ---------------- Demo ---------------- */
 static const char *demo_program =
     "; --- Rung 1: Motor seal-in (Start & !Stop) OR Motor ---\n"
@@ -530,44 +657,195 @@ static void print_vars(void)
     printf("Vars: ");
     for (int i = 0; i < g_symbol_count; ++i)
     {
-        printf("%s=%d ", g_symbols[i].name, g_symbols[i].value ? 1 : 0);
+        printf("%s=%d ", g_symbols[i].name, var_value(i) ? 1 : 0);
     }
     printf("\n");
 }
 
-int main(void)
+/* Example input profile:
+   - t=100ms: Start=1
+   - t=1500ms: Stop=1 (forces Motor reset) */
+static int g_idx_start, g_idx_stop;
+static void drive_inputs(uint32_t t)
+{
+    io_write(g_idx_start, t >= 100 && t < 1500);
+    io_write(g_idx_stop, t >= 1500);
+}
+
+/* ---------------- Benchmark / cyclic tasks ---------------- */
+static double ms_since(clock_t t0) { return (double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC; }
+
+/* The demo rungs repeated on private coils and timers, so --bench times a
+   scan of realistic size rather than loop overhead */
+#define BENCH_COPIES 32
+static char g_bench_src[BENCH_COPIES * 256];
+static const char *bench_source(void)
+{
+    size_t n = 0;
+    for (int i = 0; i < BENCH_COPIES; ++i)
+        n += (size_t)snprintf(g_bench_src + n, sizeof(g_bench_src) - n,
+                              "LD Start\nANDN Stop\nOR Motor%d\nOUT Motor%d\nENDRUNG\n"
+                              "LD Motor%d\nOUT Seal%d\nENDRUNG\n"
+                              "LD Stop\nRESET Motor%d\nENDRUNG\n"
+                              "LD Start\nANDN Stop\nTON T%d PT=%d\nOUT Lamp%d\nENDRUNG\n",
+                              i, i, i, i, i, i, 200 * (i % 10 + 1), i);
+    return g_bench_src;
+}
+
+static int run_bench(const Program *prog)
+{
+    enum { SCANS = 200000 };
+    double ms[2];
+    for (int e = 0; e < 2; ++e)
+    {
+        g_interp = (e == 0);
+        clock_t t0 = clock();
+        for (int step = 0; step < SCANS; ++step)
+        {
+            drive_inputs((uint32_t)(step % 30) * 100u);
+            scan(prog, 100);
+        }
+        ms[e] = ms_since(t0);
+    }
+    int same = 1;
+    for (int i = 0; i < g_symbol_count; ++i)
+        same = same && (sym_get(i) == plc_get(&g_img, (uint32_t)i));
+    printf("%-8s %6s %12s %12s %8s\n", "scans", "rungs", "interp us", "compiled us", "speedup");
+    printf("%-8d %6d %12.3f %12.3f %7.1fx%s\n", SCANS, prog->rung_count, ms[0] * 1000.0 / SCANS,
+           ms[1] * 1000.0 / SCANS, ms[1] > 0.0 ? ms[0] / ms[1] : 0.0, same ? "" : "  MISMATCH");
+    return same ? 0 : 1;
+}
+
+typedef struct
+{
+    uint32_t t_ms;
+} IoCtx;
+
+static void io_task(void *ctx, uint32_t dt_ms)
+{
+    IoCtx *io = (IoCtx *)ctx;
+    drive_inputs(io->t_ms);
+    io->t_ms += dt_ms;
+}
+
+static void logic_task(void *ctx, uint32_t dt_ms)
+{
+    scan((const Program *)ctx, dt_ms);
+}
+
+/* ====== Library entry point for onchip_bench.c ====== */
+
+#ifdef ONCHIP_LIB
+/* The suite's scan workload: the demo's seal-in, with a Lamp following Motor */
+static const OnchipWorkload LIB_WORK[] = {
+    {"scan",
+     "LD Start\nOR Motor\nANDN Stop\nOUT Motor\nENDRUNG\n"
+     "LD Motor\nOUT Lamp\nENDRUNG\n",
+     ONCHIP_SCANS, ONCHIP_SCAN_LAMP_ON},
+};
+
+static Program lib_prog;
+static PlcImage lib_img0; /* the image as compiled, restored before each run */
+static int lib_lamp;
+
+static int lib_load(const char *src)
+{
+    g_symbol_count = 0;
+    if (!program_parse(&lib_prog, src))
+        return 0;
+    g_idx_start = sym_index("Start");
+    g_idx_stop = sym_index("Stop");
+    lib_lamp = sym_index("Lamp");
+
+    plc_image_init(&g_img);
+    g_img.nbits = (uint32_t)g_symbol_count;
+    g_img.nfb = MAX_TIMERS;
+    if (!program_compile(&lib_prog, &g_prog))
+        return 0;
+    lib_img0 = g_img;
+    return 1;
+}
+
+static int lib_run(double *result)
 {
-    Program prog;
-    if (!program_parse(&prog, demo_program))
+    long on = 0;
+    g_img = lib_img0;
+    for (long step = 0; step < ONCHIP_SCANS; ++step)
+    {
+        int start, stop;
+        onchip_scan_inputs(step, &start, &stop);
+        io_write(g_idx_start, start);
+        io_write(g_idx_stop, stop);
+        scan(&lib_prog, ONCHIP_SCAN_DT_MS);
+        on += var_value(lib_lamp);
+    }
+    *result = (double)on;
+    return 1;
+}
+
+static void lib_unload(void) {}
+
+#define main onchip_plc_ld_main
+#endif
+
+int main(int argc, char **argv)
+{
+    /* Usage:
+         plc_ld                -> run the demo (30 scans of 100 ms)
+         plc_ld --interp       -> same, on the rung walker
+         plc_ld --dis          -> list the compiled scan program
+         plc_ld --bench        -> time rung walker vs compiled scan on the
+                                  demo rungs repeated 32 times
+         plc_ld --sched [ms]   -> run as real-time cyclic tasks (io 5 ms,
+                                  logic 10 ms) for ms (3000), report scan times */
+    const char *mode = (argc > 1) ? argv[1] : "";
+    bool bench = (strcmp(mode, "--bench") == 0);
+    static Program prog;
+    if (!program_parse(&prog, bench ? bench_source() : demo_program))
     {
         fprintf(stderr, "Failed to parse program.\n");
         return 1;
     }
 
-    int idxStart = sym_index("Start");
-    int idxStop = sym_index("Stop");
-    (void)idxStart;
-    (void)idxStop;
+    g_idx_start = sym_index("Start");
+    g_idx_stop = sym_index("Stop");
+
+    plc_image_init(&g_img);
+    g_img.nbits = (uint32_t)g_symbol_count;
+    g_img.nfb = MAX_TIMERS;
+    if (!program_compile(&prog, &g_prog))
+    {
+        fprintf(stderr, "Failed to compile program.\n");
+        return 1;
+    }
+
+    if (strcmp(mode, "--dis") == 0)
+    {
+        plc_dis(&g_prog, stdout, bit_name);
+        return 0;
+    }
+    if (bench)
+        return run_bench(&prog);
+    if (strcmp(mode, "--sched") == 0)
+    {
+        IoCtx io = {0};
+        PlcTask tasks[2] = {{.name = "io", .period_us = 5000, .fn = io_task, .ctx = &io},
+                            {.name = "logic", .period_us = 10000, .fn = logic_task, .ctx = &prog}};
+        uint32_t run_ms = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 10) : 3000u;
+        plc_sched_run(tasks, 2, (uint64_t)run_ms * 1000u, true);
+        printf("t=%4ums  ", io.t_ms);
+        print_vars();
+        plc_sched_report(tasks, 2, stdout);
+        return 0;
+    }
+    g_interp = (strcmp(mode, "--interp") == 0);
 
     /* Simulate 3 seconds in 100 ms scans */
     uint32_t t = 0;
     for (int step = 0; step < 30; ++step)
     {
-        /* Example input profile:
-           - t=100ms: Start=1
-           - t=1500ms: Stop=1 (forces Motor reset)
-        */
-        if (t >= 100 && t < 1500)
-            sym_set(idxStart, true);
-        else
-            sym_set(idxStart, false);
-
-        if (t >= 1500)
-            sym_set(idxStop, true);
-        else
-            sym_set(idxStop, false);
-
-        plc_scan(&prog, 100); /* dt = 100 ms scan time */
+        drive_inputs(t);
+        scan(&prog, 100); /* dt = 100 ms scan time */
 
         printf("t=%4ums  ", t);
         print_vars();
@@ -576,3 +854,8 @@ int main(void)
 
     return 0;
 }
+
+#ifdef ONCHIP_LIB
+const OnchipEngine onchip_engine_plc_ld = {"plc_ld", LIB_WORK, (int)(sizeof(LIB_WORK) / sizeof(LIB_WORK[0])),
+                                           lib_load, lib_run, lib_unload, plc_op_names, PLC_NOPS, main};
+#endif
@@ -7,15 +7,26 @@
  *  - Boolean expressions: NOT, AND, OR, parentheses
  *  - Actions execute every scan while the owning step is active ("DO")
  *  - Deterministic scan: evaluate all transitions, then apply, then run actions
+ *  - The chart compiles once to a scan program over the packed process image
+ *    in onchip_plc.h: variable i is image bit i, and the step flags with
+ *    their activate/deactivate requests sit in whole words after them, so
+ *    "apply" is a single STEPS instruction. The original interpreter, which
+ *    re-parses every expression string each scan, stays behind --interp and
+ *    as the baseline for --bench.
  *
  * Build:  gcc -std=c99 -O2 -Wall plc_sfc.c -o plc_sfc
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "onchip_plc.h"
 
 /* ---------------- Limits ---------------- */
 #define NAME_LEN 64
@@ -525,15 +536,190 @@ static void sfc_scan(void)
     }
 }
 
+/* ---------------- Compiler ---------------- */
+
+/* Same grammar as the parse_expr_* functions, but building PlcExpr trees.
+   Identifiers are created here, at compile time, rather than on the first
+   scan that happens to evaluate them. */
+
+static PlcProg g_prog;
+static PlcImage g_img;
+static PlcExprs g_x;
+static uint32_t g_step_bit; /* step s is image bit g_step_bit + s */
+static uint32_t g_step_words;
+static bool g_interp = false; /* --interp: evaluate the expression strings */
+
+static int cx_or(ExprP *P);
+static int cx_primary(ExprP *P)
+{
+    if (P->cur == TK_TRUE)
+    {
+        ep_eat(P, TK_TRUE);
+        return plc_x_k(&g_x, true);
+    }
+    if (P->cur == TK_FALSE)
+    {
+        ep_eat(P, TK_FALSE);
+        return plc_x_k(&g_x, false);
+    }
+    if (P->cur == TK_ID)
+    {
+        int vi = var_ensure(P->lex, false);
+        ep_eat(P, TK_ID);
+        return plc_x_bit(&g_x, (uint32_t)vi);
+    }
+    if (P->cur == TK_LP)
+    {
+        ep_eat(P, TK_LP);
+        int e = cx_or(P);
+        ep_eat(P, TK_RP);
+        return e;
+    }
+    fprintf(stderr, "Expr expected primary near '%s'\n", P->lex);
+    exit(1);
+}
+static int cx_unary(ExprP *P)
+{
+    if (P->cur == TK_NOT)
+    {
+        ep_eat(P, TK_NOT);
+        return plc_x_not(&g_x, cx_unary(P));
+    }
+    return cx_primary(P);
+}
+static int cx_and(ExprP *P)
+{
+    int e = cx_unary(P);
+    while (P->cur == TK_AND)
+    {
+        ep_eat(P, TK_AND);
+        e = plc_x_bin(&g_x, PX_AND, e, cx_unary(P));
+    }
+    return e;
+}
+static int cx_or(ExprP *P)
+{
+    int e = cx_and(P);
+    while (P->cur == TK_OR)
+    {
+        ep_eat(P, TK_OR);
+        e = plc_x_bin(&g_x, PX_OR, e, cx_and(P));
+    }
+    return e;
+}
+static int compile_expr(const char *s)
+{
+    ExprP P;
+    ep_init(&P, s);
+    return cx_or(&P);
+}
+
+static uint32_t step_bit(int s) { return g_step_bit + (uint32_t)s; }
+static uint32_t act_bit(int s) { return step_bit(s) + (g_step_words * 64u); }
+static uint32_t deact_bit(int s) { return step_bit(s) + (2u * g_step_words * 64u); }
+
+static void check_size(void)
+{
+    if (g_x.too_big || g_prog.too_big || g_prog.too_deep)
+    {
+        fprintf(stderr, "Chart too large to compile\n");
+        exit(1);
+    }
+}
+
+/* Scan program, in sfc_scan() order:
+     transitions:  LD from AND <cond>; SET act[to]; SET deact[from]
+     apply:        STEPS
+     actions:      LD step; JMPF next; <expr>; OUT var; ... per run of
+                   actions on the same step */
+static void compile_chart(void)
+{
+    plc_prog_init(&g_prog);
+    plc_image_init(&g_img);
+    g_img.nbits = MAX_VARS; /* variables may still be created while compiling */
+    g_step_words = ((uint32_t)g_stepc + 63u) / 64u;
+    if (g_step_words == 0u)
+        g_step_words = 1u;
+    g_step_bit = (uint32_t)plc_alloc_words(&g_img, 3u * g_step_words);
+
+    for (int i = 0; i < g_transc; i++)
+    {
+        g_x.n = 0;
+        int cond = compile_expr(g_trans[i].expr);
+        int e = plc_x_bin(&g_x, PX_AND, plc_x_bit(&g_x, step_bit(g_trans[i].from)), cond);
+        if ((g_x.e[e].kind == PX_K) && !g_x.e[e].k)
+            continue; /* never fires */
+        plc_emit_expr(&g_prog, &g_x, e);
+        plc_emit_bit(&g_prog, PLC_SET, act_bit(g_trans[i].to));
+        plc_emit_bit(&g_prog, PLC_SET, deact_bit(g_trans[i].from));
+        check_size();
+    }
+    (void)plc_emit(&g_prog, PLC_STEPS, step_bit(0) / 64u, g_step_words, 0u);
+
+    for (int i = 0; i < g_actionc;)
+    {
+        int step = g_actions[i].step;
+        plc_emit_bit(&g_prog, PLC_LD, step_bit(step));
+        uint32_t skip = plc_emit(&g_prog, PLC_JMPF, 0u, 0u, 0u);
+        for (; i < g_actionc && g_actions[i].step == step; i++)
+        {
+            g_x.n = 0;
+            plc_emit_expr(&g_prog, &g_x, compile_expr(g_actions[i].expr));
+            plc_emit_bit(&g_prog, PLC_OUT, (uint32_t)g_actions[i].var);
+            check_size();
+        }
+        plc_patch(&g_prog, skip);
+    }
+    (void)plc_emit(&g_prog, PLC_END, 0u, 0u, 0u);
+    check_size();
+
+    for (int i = 0; i < g_varc; i++)
+        plc_put(&g_img, (uint32_t)i, g_vars[i].val);
+    for (int s = 0; s < g_stepc; s++)
+        plc_put(&g_img, step_bit(s), g_steps[s].active);
+}
+
+static bool var_value(int i)
+{
+    return g_interp ? g_vars[i].val : plc_get(&g_img, (uint32_t)i);
+}
+
+static bool step_active(int s)
+{
+    return g_interp ? g_steps[s].active : plc_get(&g_img, step_bit(s));
+}
+
+/* Inputs go to both the variable table and the image */
+static void io_write(int i, bool v)
+{
+    g_vars[i].val = v;
+    plc_put(&g_img, (uint32_t)i, v);
+}
+
+static const char *bit_name(uint32_t bit)
+{
+    static char buf[NAME_LEN + 8];
+    if (bit < (uint32_t)g_varc)
+        return g_vars[bit].name;
+    if (bit < g_step_bit)
+        return NULL;
+    uint32_t s = (bit - g_step_bit) % (g_step_words * 64u);
+    uint32_t area = (bit - g_step_bit) / (g_step_words * 64u);
+    if (s >= (uint32_t)g_stepc)
+        return NULL;
+    snprintf(buf, sizeof(buf), "%s%s", area == 1u ? "act:" : area == 2u ? "deact:" : "", g_steps[s].name);
+    return buf;
+}
+
 static void print_state(int t)
 {
     printf("t=%d  Steps:", t);
     for (int i = 0; i < g_stepc; i++)
-        if (g_steps[i].active)
+        if (step_active(i))
             printf(" %s", g_steps[i].name);
     printf("  |  Vars:");
     for (int i = 0; i < g_varc; i++)
-        printf(" %s=%s", g_vars[i].name, g_vars[i].val ? "TRUE" : "FALSE");
+        printf(" %s=%s", g_vars[i].name, var_value(i) ? "TRUE" : "FALSE");
     printf("\n");
 }
 
@@ -569,27 +755,197 @@ static const char *demo_program =
     "ACTION Done DO Motor  := FALSE;\n"
     "ACTION Done DO Valve  := TRUE;\n";
 
-int main(void)
+/* Start at scan 1, TempOK from 3, TimerDone from 6 */
+static int g_idxStart, g_idxTemp, g_idxTimer;
+static void drive_inputs(int t)
 {
-    parse_program(demo_program);
+    io_write(g_idxStart, t >= 1);
+    io_write(g_idxTemp, t >= 3);
+    io_write(g_idxTimer, t >= 6);
+}
 
-    // Simulate 10 scans; toggle inputs over time
-    int idxStart = var_ensure("Start", false);
-    int idxTemp = var_ensure("TempOK", false);
-    int idxTimer = var_ensure("TimerDone", false);
+/* ---------------- Benchmark / cyclic tasks ---------------- */
 
-    for (int t = 0; t < 10; t++)
+static double ms_since(clock_t t0) { return (double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC; }
+
+/* The demo chart repeated on private steps and outputs, with Done -> Idle
+   so every copy keeps cycling while --bench replays the input pattern */
+#define BENCH_COPIES 16
+static char g_bench_src[BENCH_COPIES * 512];
+static const char *bench_source(void)
+{
+    size_t n = 0;
+    for (int i = 0; i < BENCH_COPIES; i++)
+        n += (size_t)snprintf(g_bench_src + n, sizeof(g_bench_src) - n,
+                              "STEP Idle%d;\nSTEP Heat%d;\nSTEP Cook%d;\nSTEP Done%d;\nINITIAL Idle%d;\n"
+                              "TRANS Idle%d -> Heat%d IF Start;\n"
+                              "TRANS Heat%d -> Cook%d IF TempOK AND Start;\n"
+                              "TRANS Cook%d -> Done%d IF TimerDone OR NOT Start;\n"
+                              "TRANS Done%d -> Idle%d IF NOT Start;\n"
+                              "ACTION Heat%d DO Heater%d := TRUE;\n"
+                              "ACTION Heat%d DO Motor%d := FALSE;\n"
+                              "ACTION Heat%d DO Valve%d := NOT TempOK;\n"
+                              "ACTION Cook%d DO Heater%d := NOT TimerDone;\n"
+                              "ACTION Cook%d DO Motor%d := TRUE;\n"
+                              "ACTION Done%d DO Motor%d := FALSE;\n"
+                              "ACTION Done%d DO Valve%d := Start AND NOT TempOK OR TimerDone;\n",
+                              i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i);
+    return g_bench_src;
+}
+
+static int run_bench(void)
+{
+    enum { SCANS = 20000 };
+    double ms[2];
+    for (int e = 0; e < 2; e++)
     {
-        // Drive inputs
-        if (t == 1)
-            g_vars[idxStart].val = true; // Start pressed
-        if (t == 3)
-            g_vars[idxTemp].val = true; // Temperature ok
-        if (t == 6)
-            g_vars[idxTimer].val = true; // Timer elapsed
+        clock_t t0 = clock();
+        for (int step = 0; step < SCANS; step++)
+        {
+            drive_inputs(step % 10);
+            if (e == 0)
+                sfc_scan();
+            else
+                plc_run(&g_prog, &g_img, 0u);
+        }
+        ms[e] = ms_since(t0);
+    }
+    int same = 1;
+    for (int i = 0; i < g_varc; i++)
+        same = same && (g_vars[i].val == plc_get(&g_img, (uint32_t)i));
+    for (int s = 0; s < g_stepc; s++)
+        same = same && (g_steps[s].active == plc_get(&g_img, step_bit(s)));
+    printf("%-8s %6s %6s %12s %12s %8s\n", "scans", "steps", "vars", "interp us", "compiled us", "speedup");
+    printf("%-8d %6d %6d %12.3f %12.3f %7.1fx%s\n", SCANS, g_stepc, g_varc, ms[0] * 1000.0 / SCANS,
+           ms[1] * 1000.0 / SCANS, ms[1] > 0.0 ? ms[0] / ms[1] : 0.0, same ? "" : "  MISMATCH");
+    return same ? 0 : 1;
+}
 
-        sfc_scan();
+typedef struct
+{
+    uint32_t t_ms;
+} IoCtx;
+
+/* One demo step per 100 ms */
+static void io_task(void *ctx, uint32_t dt_ms)
+{
+    IoCtx *io = (IoCtx *)ctx;
+    drive_inputs((int)(io->t_ms / 100u));
+    io->t_ms += dt_ms;
+}
+
+static void logic_task(void *ctx, uint32_t dt_ms)
+{
+    (void)ctx;
+    plc_run(&g_prog, &g_img, dt_ms);
+}
+
+/* ====== Library entry point for onchip_bench.c ====== */
+
+#ifdef ONCHIP_LIB
+/* The suite's scan workload: the seal-in as a two-step chart lighting a Lamp */
+static const OnchipWorkload LIB_WORK[] = {
+    {"scan",
+     "VAR\n  Start : BOOL := FALSE;\n  Stop : BOOL := FALSE;\n  Lamp : BOOL := FALSE;\nEND_VAR\n"
+     "STEP Stopped;\nSTEP Running;\nINITIAL Stopped;\n"
+     "TRANS Stopped -> Running IF Start AND NOT Stop;\n"
+     "TRANS Running -> Stopped IF Stop;\n"
+     "ACTION Running DO Lamp := TRUE;\n"
+     "ACTION Stopped DO Lamp := FALSE;\n",
+     ONCHIP_SCANS, ONCHIP_SCAN_LAMP_ON},
+};
+
+static PlcImage lib_img0; /* the image as compiled, restored before each run */
+static int lib_stop, lib_lamp;
+
+static int lib_load(const char *src)
+{
+    g_varc = g_stepc = g_transc = g_actionc = 0;
+    parse_program(src); /* exits on a syntax error */
+    g_idxStart = var_ensure("Start", false);
+    lib_stop = var_ensure("Stop", false);
+    lib_lamp = var_ensure("Lamp", false);
+    compile_chart();
+    lib_img0 = g_img;
+    return 1;
+}
+
+static int lib_run(double *result)
+{
+    long on = 0;
+    g_img = lib_img0;
+    for (long step = 0; step < ONCHIP_SCANS; ++step)
+    {
+        int start, stop;
+        onchip_scan_inputs(step, &start, &stop);
+        io_write(g_idxStart, start);
+        io_write(lib_stop, stop);
+        plc_run(&g_prog, &g_img, ONCHIP_SCAN_DT_MS);
+        on += var_value(lib_lamp);
+    }
+    *result = (double)on;
+    return 1;
+}
+
+static void lib_unload(void) {}
+
+#define main onchip_plc_sfc_main
+#endif
+
+int main(int argc, char **argv)
+{
+    /* Usage:
+         plc_sfc                -> run the demo (10 scans)
+         plc_sfc --interp       -> same, evaluating the expression strings
+         plc_sfc --dis          -> list the compiled scan program
+         plc_sfc --bench        -> time interpreted vs compiled scan on the
+                                   demo chart repeated 16 times
+         plc_sfc --sched [ms]   -> run as real-time cyclic tasks (io 5 ms,
+                                   logic 10 ms) for ms (1000), report scan times */
+    const char *mode = (argc > 1) ? argv[1] : "";
+    bool bench = (strcmp(mode, "--bench") == 0);
+    g_interp = (strcmp(mode, "--interp") == 0);
+    parse_program(bench ? bench_source() : demo_program);
+
+    g_idxStart = var_ensure("Start", false);
+    g_idxTemp = var_ensure("TempOK", false);
+    g_idxTimer = var_ensure("TimerDone", false);
+    if (!g_interp)
+        compile_chart();
+
+    if (strcmp(mode, "--dis") == 0)
+    {
+        plc_dis(&g_prog, stdout, bit_name);
+        return 0;
+    }
+    if (bench)
+        return run_bench();
+    if (strcmp(mode, "--sched") == 0)
+    {
+        IoCtx io = {0};
+        PlcTask tasks[2] = {{.name = "io", .period_us = 5000, .fn = io_task, .ctx = &io},
+                            {.name = "logic", .period_us = 10000, .fn = logic_task, .ctx = NULL}};
+        uint32_t run_ms = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 10) : 1000u;
+        plc_sched_run(tasks, 2, (uint64_t)run_ms * 1000u, true);
+        print_state((int)(io.t_ms / 100u));
+        plc_sched_report(tasks, 2, stdout);
+        return 0;
+    }
+
+    // Simulate 10 scans; drive inputs over time
+    for (int t = 0; t < 10; t++)
+    {
+        drive_inputs(t);
+        if (g_interp)
+            sfc_scan();
+        else
+            plc_run(&g_prog, &g_img, 0u);
         print_state(t);
     }
     return 0;
 }
+
+#ifdef ONCHIP_LIB
+const OnchipEngine onchip_engine_plc_sfc = {"plc_sfc", LIB_WORK, (int)(sizeof(LIB_WORK) / sizeof(LIB_WORK[0])),
+                                            lib_load, lib_run, lib_unload, plc_op_names, PLC_NOPS, main};
+#endif
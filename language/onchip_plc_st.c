@@ -8,15 +8,24 @@
  *
  * Notes:
  *  - Extend easily with INT/REAL by expanding Value/lexer and arithmetic rules.
+ *  - The program compiles once to a scan program over the packed process
+ *    image in onchip_plc.h (variable i is image bit i). The original
+ *    parse-and-execute interpreter stays behind --interp and as the
+ *    baseline for --bench.
  *
  * Build:  gcc -std=c99 -O2 -Wall plc_st.c -o plc_st
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "onchip_plc.h"
 
 /* -------------------- Value & Symbol Table -------------------- */
 
@@ -501,6 +510,192 @@ static void parse_program(Parser *P)
     }
 }
 
+/* -------------------- Compiler -------------------- */
+
+/* Same grammar as the parse_* functions, but expressions become PlcExpr
+   trees and statements code. VAR blocks run once, here, through
+   parse_var_block(): the interpreter only ever applied an initializer when
+   it created the variable, so re-running them each scan changed nothing. */
+
+static PlcProg g_prog;
+static PlcImage g_img;
+static PlcExprs g_x;
+static bool g_interp = false; /* --interp: re-parse and execute every scan */
+
+static int cx_or(Parser *P);
+
+static int cx_primary(Parser *P)
+{
+    if (P->cur.k == T_TRUE)
+    {
+        ps_eat(P, T_TRUE);
+        return plc_x_k(&g_x, true);
+    }
+    if (P->cur.k == T_FALSE)
+    {
+        ps_eat(P, T_FALSE);
+        return plc_x_k(&g_x, false);
+    }
+    if (P->cur.k == T_ID)
+    {
+        char name[NAME_LEN];
+        strncpy(name, P->cur.lex, NAME_LEN);
+        ps_eat(P, T_ID);
+        int i = sym_lookup(name);
+        if (i < 0)
+        {
+            fprintf(stderr, "Undeclared identifier '%s'\n", name);
+            exit(1);
+        }
+        return plc_x_bit(&g_x, (uint32_t)i);
+    }
+    if (P->cur.k == T_LPAREN)
+    {
+        ps_eat(P, T_LPAREN);
+        int e = cx_or(P);
+        ps_eat(P, T_RPAREN);
+        return e;
+    }
+    fprintf(stderr, "Parse error line %d: expected primary\n", P->L.line);
+    exit(1);
+}
+
+static int cx_unary(Parser *P)
+{
+    if (P->cur.k == T_NOT)
+    {
+        ps_eat(P, T_NOT);
+        return plc_x_not(&g_x, cx_unary(P));
+    }
+    return cx_primary(P);
+}
+
+static int cx_and(Parser *P)
+{
+    int e = cx_unary(P);
+    while (P->cur.k == T_AND)
+    {
+        ps_eat(P, T_AND);
+        e = plc_x_bin(&g_x, PX_AND, e, cx_unary(P));
+    }
+    return e;
+}
+
+static int cx_or(Parser *P)
+{
+    int e = cx_and(P);
+    while (P->cur.k == T_OR)
+    {
+        ps_eat(P, T_OR);
+        e = plc_x_bin(&g_x, PX_OR, e, cx_and(P));
+    }
+    return e;
+}
+
+/* ID := expr ; */
+static void cs_assign(Parser *P)
+{
+    char lhs[NAME_LEN];
+    strncpy(lhs, P->cur.lex, NAME_LEN);
+    ps_eat(P, T_ID);
+    ps_eat(P, T_ASSIGN);
+    g_x.n = 0;
+    int e = cx_or(P);
+    ps_eat(P, T_SEMI);
+    int i = sym_lookup(lhs);
+    if (i < 0)
+    {
+        fprintf(stderr, "Assignment to undeclared '%s'\n", lhs);
+        exit(1);
+    }
+    plc_emit_expr(&g_prog, &g_x, e);
+    plc_emit_bit(&g_prog, PLC_OUT, (uint32_t)i);
+}
+
+static void cs_branch(Parser *P, const char *part)
+{
+    if (P->cur.k != T_ID)
+    {
+        fprintf(stderr, "Expected statement in %s at line %d\n", part, P->L.line);
+        exit(1);
+    }
+    cs_assign(P);
+}
+
+static void cs_if(Parser *P)
+{
+    ps_eat(P, T_IF);
+    g_x.n = 0;
+    int cond = cx_or(P);
+    ps_eat(P, T_THEN);
+    plc_emit_expr(&g_prog, &g_x, cond);
+    uint32_t to_else = plc_emit(&g_prog, PLC_JMPF, 0u, 0u, 0u);
+    while (P->cur.k != T_ELSE && P->cur.k != T_END_IF)
+        cs_branch(P, "THEN");
+    if (P->cur.k == T_ELSE)
+    {
+        ps_eat(P, T_ELSE);
+        uint32_t to_end = plc_emit(&g_prog, PLC_JMP, 0u, 0u, 0u);
+        plc_patch(&g_prog, to_else);
+        while (P->cur.k != T_END_IF)
+            cs_branch(P, "ELSE");
+        plc_patch(&g_prog, to_end);
+    }
+    else
+        plc_patch(&g_prog, to_else);
+    ps_eat(P, T_END_IF);
+    ps_eat(P, T_SEMI);
+}
+
+static void compile_program(const char *src)
+{
+    Parser P;
+    ps_init(&P, src);
+    plc_prog_init(&g_prog);
+    while (P.cur.k != T_EOF)
+    {
+        if (P.cur.k == T_VAR)
+            parse_var_block(&P);
+        else if (P.cur.k == T_IF)
+            cs_if(&P);
+        else if (P.cur.k == T_ID)
+            cs_assign(&P);
+        else
+        {
+            fprintf(stderr, "Unexpected token at line %d ('%s')\n", P.L.line, P.cur.lex);
+            exit(1);
+        }
+        if (g_x.too_big || g_prog.too_big || g_prog.too_deep)
+        {
+            fprintf(stderr, "program too large (line %d)\n", P.L.line);
+            exit(1);
+        }
+    }
+    (void)plc_emit(&g_prog, PLC_END, 0u, 0u, 0u);
+
+    plc_image_init(&g_img);
+    g_img.nbits = (uint32_t)g_varc;
+    for (int i = 0; i < g_varc; i++)
+        plc_put(&g_img, (uint32_t)i, g_vars[i].val.v.b);
+}
+
+static bool var_value(int i)
+{
+    return g_interp ? g_vars[i].val.v.b : plc_get(&g_img, (uint32_t)i);
+}
+
+/* Inputs go to both the symbol table and the image */
+static void io_write(int i, bool v)
+{
+    g_vars[i].val = make_bool(v);
+    plc_put(&g_img, (uint32_t)i, v);
+}
+
+static const char *bit_name(uint32_t bit)
+{
+    return (bit < (uint32_t)g_varc) ? g_vars[bit].name : NULL;
+}
+
 /* -------------------- Demo Program -------------------- */
 static const char *demo_program =
     "// Minimal ST demo with BOOLs and IF logic\n"
@@ -525,36 +720,217 @@ static void print_vars(void)
     for (int i = 0; i < g_varc; i++)
     {
         if (g_vars[i].t == VT_BOOL)
-            printf("%s=%s ", g_vars[i].name, g_vars[i].val.v.b ? "TRUE" : "FALSE");
+            printf("%s=%s ", g_vars[i].name, var_value(i) ? "TRUE" : "FALSE");
     }
     printf("\n");
 }
 
-int main(void)
+/* Start pressed between scans 2..6, Stop from scan 7 */
+static int g_iStart, g_iStop;
+static void drive_inputs(int t)
 {
-    /* Simulate several cycles where inputs change, re-running the program each cycle */
-    for (int t = 0; t < 10; t++)
+    io_write(g_iStart, t >= 2 && t < 7);
+    io_write(g_iStop, t >= 7);
+}
+
+/* -------------------- Benchmark / cyclic tasks -------------------- */
+
+static double ms_since(clock_t t0) { return (double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC; }
+
+/* The demo logic repeated on private outputs, so --bench times a scan of
+   realistic size rather than loop overhead */
+#define BENCH_COPIES 32
+static char g_bench_src[BENCH_COPIES * 256];
+static const char *bench_source(void)
+{
+    size_t n = (size_t)snprintf(g_bench_src, sizeof(g_bench_src), "VAR Start : BOOL; Stop : BOOL; END_VAR\n");
+    for (int i = 0; i < BENCH_COPIES; i++)
+        n += (size_t)snprintf(g_bench_src + n, sizeof(g_bench_src) - n,
+                              "VAR Motor%d : BOOL := FALSE; Lamp%d : BOOL := FALSE; END_VAR\n"
+                              "IF Start AND NOT Stop THEN Motor%d := TRUE; ELSE Motor%d := FALSE; END_IF;\n"
+                              "Lamp%d := Motor%d;\n",
+                              i, i, i, i, i, i);
+    return g_bench_src;
+}
+
+static int run_bench(void)
+{
+    enum { SCANS = 20000 };
+    double ms[2];
+    for (int e = 0; e < 2; e++)
     {
-        /* Re-parse each scan so expressions use current inputs */
-        Parser P;
-        ps_init(&P, demo_program);
-        parse_program(&P);
-        // Modify inputs after parse (simulate external IO updates)
-        int iStart = sym_lookup("Start");
-        int iStop = sym_lookup("Stop");
-        if (iStart < 0 || iStop < 0)
+        clock_t t0 = clock();
+        for (int step = 0; step < SCANS; step++)
+        {
+            drive_inputs(step % 10);
+            if (e == 0)
+            {
+                Parser P;
+                ps_init(&P, g_bench_src);
+                parse_program(&P);
+            }
+            else
+                plc_run(&g_prog, &g_img, 0u);
+        }
+        ms[e] = ms_since(t0);
+    }
+    int same = 1;
+    for (int i = 0; i < g_varc; i++)
+        same = same && (g_vars[i].val.v.b == plc_get(&g_img, (uint32_t)i));
+    printf("%-8s %6s %12s %12s %8s\n", "scans", "vars", "interp us", "compiled us", "speedup");
+    printf("%-8d %6d %12.3f %12.3f %7.1fx%s\n", SCANS, g_varc, ms[0] * 1000.0 / SCANS,
+           ms[1] * 1000.0 / SCANS, ms[1] > 0.0 ? ms[0] / ms[1] : 0.0, same ? "" : "  MISMATCH");
+    return same ? 0 : 1;
+}
+
+typedef struct
+{
+    uint32_t t_ms;
+} IoCtx;
+
+/* One demo step per 100 ms */
+static void io_task(void *ctx, uint32_t dt_ms)
+{
+    IoCtx *io = (IoCtx *)ctx;
+    drive_inputs((int)(io->t_ms / 100u));
+    io->t_ms += dt_ms;
+}
+
+static void logic_task(void *ctx, uint32_t dt_ms)
+{
+    (void)ctx;
+    plc_run(&g_prog, &g_img, dt_ms);
+}
+
+/* ====== Library entry point for onchip_bench.c ====== */
+
+#ifdef ONCHIP_LIB
+/* The suite's scan workload: the demo's seal-in, with a Lamp following Motor */
+static const OnchipWorkload LIB_WORK[] = {
+    {"scan",
+     "VAR Start : BOOL; Stop : BOOL; Motor : BOOL := FALSE; Lamp : BOOL := FALSE; END_VAR\n"
+     "Motor := (Start OR Motor) AND NOT Stop;\n"
+     "Lamp := Motor;\n",
+     ONCHIP_SCANS, ONCHIP_SCAN_LAMP_ON},
+};
+
+static PlcImage lib_img0; /* the image as compiled, restored before each run */
+static int lib_lamp;
+
+static int lib_load(const char *src)
+{
+    g_varc = 0;
+    compile_program(src); /* exits on a syntax error */
+    g_iStart = sym_lookup("Start");
+    g_iStop = sym_lookup("Stop");
+    lib_lamp = sym_lookup("Lamp");
+    if (g_iStart < 0 || g_iStop < 0 || lib_lamp < 0)
+        return 0;
+    lib_img0 = g_img;
+    return 1;
+}
+
+static int lib_run(double *result)
+{
+    long on = 0;
+    g_img = lib_img0;
+    for (long step = 0; step < ONCHIP_SCANS; ++step)
+    {
+        int start, stop;
+        onchip_scan_inputs(step, &start, &stop);
+        io_write(g_iStart, start);
+        io_write(g_iStop, stop);
+        plc_run(&g_prog, &g_img, ONCHIP_SCAN_DT_MS);
+        on += var_value(lib_lamp);
+    }
+    *result = (double)on;
+    return 1;
+}
+
+static void lib_unload(void) {}
+
+#define main onchip_plc_st_main
+#endif
+
+int main(int argc, char **argv)
+{
+    /* Usage:
+         plc_st                -> run the demo (10 scans)
+         plc_st --interp       -> same, re-parsing the source every scan
+         plc_st --dis          -> list the compiled scan program
+         plc_st --bench        -> time re-parsing vs compiled scan on the
+                                  demo logic repeated 32 times
+         plc_st --sched [ms]   -> run as real-time cyclic tasks (io 5 ms,
+                                  logic 10 ms) for ms (1000), report scan times */
+    const char *mode = (argc > 1) ? argv[1] : "";
+    bool bench = (strcmp(mode, "--bench") == 0);
+    g_interp = (strcmp(mode, "--interp") == 0);
+    if (!g_interp)
+    {
+        compile_program(bench ? bench_source() : demo_program);
+        g_iStart = sym_lookup("Start");
+        g_iStop = sym_lookup("Stop");
+        if (g_iStart < 0 || g_iStop < 0)
         {
             fprintf(stderr, "demo variables missing\n");
             return 1;
         }
-        g_vars[iStart].val = make_bool(t >= 2 && t < 7); // Start pressed between scans 2..6
-        g_vars[iStop].val = make_bool(t >= 7);           // Stop pressed from scan 7
-        // Re-run logic with updated IO
-        Parser P2;
-        ps_init(&P2, demo_program);
-        parse_program(&P2);
+    }
+    if (strcmp(mode, "--dis") == 0)
+    {
+        plc_dis(&g_prog, stdout, bit_name);
+        return 0;
+    }
+    if (bench)
+        return run_bench();
+    if (strcmp(mode, "--sched") == 0)
+    {
+        IoCtx io = {0};
+        PlcTask tasks[2] = {{.name = "io", .period_us = 5000, .fn = io_task, .ctx = &io},
+                            {.name = "logic", .period_us = 10000, .fn = logic_task, .ctx = NULL}};
+        uint32_t run_ms = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 10) : 1000u;
+        plc_sched_run(tasks, 2, (uint64_t)run_ms * 1000u, true);
+        printf("t=%ums  ", io.t_ms);
+        print_vars();
+        plc_sched_report(tasks, 2, stdout);
+        return 0;
+    }
+
+    /* Simulate several cycles where inputs change: drive inputs, scan, print */
+    for (int t = 0; t < 10; t++)
+    {
+        if (g_interp)
+        {
+            /* Re-parse each scan so expressions use current inputs */
+            Parser P;
+            ps_init(&P, demo_program);
+            parse_program(&P);
+            // Modify inputs after parse (simulate external IO updates)
+            g_iStart = sym_lookup("Start");
+            g_iStop = sym_lookup("Stop");
+            if (g_iStart < 0 || g_iStop < 0)
+            {
+                fprintf(stderr, "demo variables missing\n");
+                return 1;
+            }
+            drive_inputs(t);
+            // Re-run logic with updated IO
+            Parser P2;
+            ps_init(&P2, demo_program);
+            parse_program(&P2);
+        }
+        else
+        {
+            drive_inputs(t);
+            plc_run(&g_prog, &g_img, 0u);
+        }
         printf("t=%d  ", t);
         print_vars();
     }
     return 0;
 }
+
+#ifdef ONCHIP_LIB
+const OnchipEngine onchip_engine_plc_st = {"plc_st", LIB_WORK, (int)(sizeof(LIB_WORK) / sizeof(LIB_WORK[0])),
+                                           lib_load, lib_run, lib_unload, plc_op_names, PLC_NOPS, main};
+#endif
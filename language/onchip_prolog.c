@@ -2,6 +2,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "onchip_bench.h"
 
 /* ============ Embedded demo program ============ */
 static const char *demo_program =
@@ -318,28 +323,25 @@ struct Term
         double num; /* number */
         struct
         {
-            char *name;
+            char *name; /* interned: equal functors share the pointer */
             int arity;
             ArgVec args;
-        } s; /* struct / atom (arity 0) */
+            int ground; /* clause terms only: no variables inside, share instead of renaming */
+        } s;            /* struct / atom (arity 0) */
     } u;
 };
 
-/* Clause: head :- body[0], body[1], ... */
+/* Clause: head :- body[0], body[1], ...
+   Its variables are numbered 0..nvars-1 (u.v.id) so a call can rename
+   them through a flat frame instead of a pointer map. */
 typedef struct
 {
     Term *head;
     Term **body;
     int body_n;
+    int nvars;
 } Clause;
 
-/* Knowledge base */
-typedef struct
-{
-    Clause *c;
-    int n, cap;
-} KB;
-
 static void args_init(ArgVec *av)
 {
     av->a = NULL;
@@ -356,6 +358,55 @@ static void args_push(ArgVec *av, Term *t)
     av->a[av->n++] = t;
 }
 
+/* atom table: every functor name is stored once */
+static struct
+{
+    char **s;
+    size_t n, cap;
+} g_atoms;
+
+static size_t str_hash(const char *s)
+{
+    size_t h = 2166136261u;
+    while (*s)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+static char *intern(const char *name)
+{
+    if (g_atoms.n * 2 >= g_atoms.cap)
+    {
+        size_t ncap = g_atoms.cap ? g_atoms.cap * 2 : 256;
+        char **ns = (char **)calloc(ncap, sizeof(char *));
+        if (!ns)
+        {
+            fprintf(stderr, "OOM\n");
+            exit(1);
+        }
+        for (size_t i = 0; i < g_atoms.cap; i++)
+            if (g_atoms.s[i])
+            {
+                size_t j = str_hash(g_atoms.s[i]) & (ncap - 1);
+                while (ns[j])
+                    j = (j + 1) & (ncap - 1);
+                ns[j] = g_atoms.s[i];
+            }
+        free(g_atoms.s);
+        g_atoms.s = ns;
+        g_atoms.cap = ncap;
+    }
+    size_t j = str_hash(name) & (g_atoms.cap - 1);
+    while (g_atoms.s[j])
+    {
+        if (!strcmp(g_atoms.s[j], name))
+            return g_atoms.s[j];
+        j = (j + 1) & (g_atoms.cap - 1);
+    }
+    g_atoms.n++;
+    return g_atoms.s[j] = strdup2(name);
+}
+
 static Term *mk_var(const char *name)
 {
     Term *t = (Term *)xmalloc(sizeof *t);
@@ -377,15 +428,17 @@ static Term *mk_atom(const char *name)
 {
     Term *t = (Term *)xmalloc(sizeof *t);
     t->k = TM_STRUC;
-    t->u.s.name = strdup2(name);
+    t->u.s.name = intern(name);
     t->u.s.arity = 0;
     args_init(&t->u.s.args);
+    t->u.s.ground = 1;
     return t;
 }
 static Term *mk_struct(const char *name, int arity)
 {
     Term *t = mk_atom(name);
     t->u.s.arity = arity;
+    t->u.s.ground = arity == 0;
     for (int i = 0; i < arity; i++)
         args_push(&t->u.s.args, NULL);
     return t;
@@ -602,11 +655,110 @@ static Clause *parse_one(Parser *P, int *is_query, TermVec *q_goals)
         free(goals.ptrs);
     }
     expect(P, TK_DOT, "expected '.' at end of clause");
+    for (int i = 0; i < V.n; i++)
+        V.vars[i]->u.v.id = i;
+    cl->nvars = V.n;
     return cl;
 }
 
 /* ============ Unification & Engine ============ */
 
+/* atoms the engine tests for, interned once at startup */
+static char *A_TRUE, *A_FAIL, *A_NL, *A_WRITE, *A_EQ, *A_DIF;
+static void init_atoms(void)
+{
+    A_TRUE = intern("true");
+    A_FAIL = intern("fail");
+    A_NL = intern("nl");
+    A_WRITE = intern("write");
+    A_EQ = intern("=");
+    A_DIF = intern("dif");
+}
+
+/* Runtime heap: terms built while solving (renamed clause bodies, goal
+   continuations, variable frames) are bump-allocated from fixed blocks.
+   A choicepoint records the top, so backtracking over it releases all of
+   that at once. Blocks are kept for reuse. */
+#define HEAP_BLOCK (64 * 1024)
+typedef struct
+{
+    int blk;
+    size_t off;
+} HeapMark;
+static struct
+{
+    char **blk;
+    int nblk, cap, cur;
+    size_t off;
+} g_heap;
+
+static void *h_alloc(size_t n)
+{
+    n = (n + 7) & ~(size_t)7;
+    if (g_heap.nblk == 0 || g_heap.off + n > HEAP_BLOCK)
+    {
+        if (n > HEAP_BLOCK)
+        {
+            fprintf(stderr, "clause too large for runtime heap block\n");
+            exit(1);
+        }
+        int next = g_heap.nblk ? g_heap.cur + 1 : 0;
+        if (next == g_heap.nblk)
+        {
+            if (g_heap.nblk >= g_heap.cap)
+            {
+                g_heap.cap = g_heap.cap ? g_heap.cap * 2 : 16;
+                g_heap.blk = (char **)realloc(g_heap.blk, (size_t)g_heap.cap * sizeof(char *));
+            }
+            g_heap.blk[g_heap.nblk++] = (char *)xmalloc(HEAP_BLOCK);
+        }
+        g_heap.cur = next;
+        g_heap.off = 0;
+    }
+    void *p = g_heap.blk[g_heap.cur] + g_heap.off;
+    g_heap.off += n;
+    ONCHIP_ALLOC();
+    return p;
+}
+static HeapMark h_mark(void)
+{
+    HeapMark m = {g_heap.cur, g_heap.off};
+    return m;
+}
+static void h_release(HeapMark m)
+{
+    g_heap.cur = m.blk;
+    g_heap.off = m.off;
+}
+
+static Term *h_var(const Term *orig)
+{
+    Term *t = (Term *)h_alloc(sizeof *t);
+    t->k = TM_VAR;
+    t->u.v.id = 0;
+    t->u.v.ref = NULL;
+    t->u.v.name = orig->u.v.name; /* shared with the clause */
+    t->u.v.anonymous = orig->u.v.anonymous;
+    return t;
+}
+static Term *h_struct(char *name, int arity)
+{
+    Term *t = (Term *)h_alloc(sizeof *t);
+    t->k = TM_STRUC;
+    t->u.s.name = name;
+    t->u.s.arity = arity;
+    t->u.s.args.a = (Term **)h_alloc((size_t)arity * sizeof(Term *));
+    t->u.s.args.n = t->u.s.args.cap = arity;
+    t->u.s.ground = 0;
+    return t;
+}
+static Term **h_frame(int nvars)
+{
+    Term **f = (Term **)h_alloc((size_t)nvars * sizeof(Term *));
+    memset(f, 0, (size_t)nvars * sizeof(Term *));
+    return f;
+}
+
 /* trail for variable bindings to allow backtracking */
 typedef struct
 {
@@ -640,80 +792,116 @@ static Term *deref(Term *t)
     return t;
 }
 
+static void bind(Term *var, Term *val)
+{
+    var->u.v.ref = val;
+    trail_push(var);
+}
+
+/* the last argument is unified by iteration, so long lists don't recurse */
 static int unify(Term *a, Term *b)
 {
-    a = deref(a);
-    b = deref(b);
-    if (a == b)
-        return 1;
-    if (a->k == TM_VAR)
-    {
-        a->u.v.ref = b;
-        trail_push(a);
-        return 1;
-    }
-    if (b->k == TM_VAR)
-    {
-        b->u.v.ref = a;
-        trail_push(b);
-        return 1;
-    }
-    if (a->k == TM_NUM && b->k == TM_NUM)
-        return a->u.num == b->u.num;
-    if (a->k == TM_STRUC && b->k == TM_STRUC)
+    for (;;)
     {
-        if (strcmp(a->u.s.name, b->u.s.name) != 0)
+        a = deref(a);
+        b = deref(b);
+        if (a == b)
+            return 1;
+        if (a->k == TM_VAR)
+        {
+            bind(a, b);
+            return 1;
+        }
+        if (b->k == TM_VAR)
+        {
+            bind(b, a);
+            return 1;
+        }
+        if (a->k == TM_NUM && b->k == TM_NUM)
+            return a->u.num == b->u.num;
+        if (a->k != TM_STRUC || b->k != TM_STRUC)
             return 0;
-        if (a->u.s.arity != b->u.s.arity)
+        if (a->u.s.name != b->u.s.name || a->u.s.arity != b->u.s.arity)
             return 0;
-        for (int i = 0; i < a->u.s.arity; i++)
-        {
+        int n = a->u.s.arity;
+        if (n == 0)
+            return 1;
+        for (int i = 0; i < n - 1; i++)
             if (!unify(a->u.s.args.a[i], b->u.s.args.a[i]))
                 return 0;
-        }
-        return 1;
+        a = a->u.s.args.a[n - 1];
+        b = b->u.s.args.a[n - 1];
     }
-    return 0;
 }
 
-/* deep copy a term, refreshing vars; map by pointer */
-typedef struct
+/* instantiate a clause term: variables come from the frame (fresh on first
+   use), ground subterms are shared with the clause */
+static Term *rename_term(Term *p, Term **frame)
 {
-    const Term **from;
-    Term **to;
-    int n, cap;
-} VMap;
-static Term *copy_term(Term *t, VMap *M);
+    if (p->k == TM_VAR)
+    {
+        Term **slot = &frame[p->u.v.id];
+        if (!*slot)
+            *slot = h_var(p);
+        return *slot;
+    }
+    if (p->k == TM_NUM || p->u.s.ground)
+        return p;
+    Term *t = h_struct(p->u.s.name, p->u.s.arity);
+    for (int i = 0; i < p->u.s.arity; i++)
+        t->u.s.args.a[i] = rename_term(p->u.s.args.a[i], frame);
+    return t;
+}
 
-static Term *map_get(VMap *M, const Term *orig)
+/* Unify clause term p directly against runtime term t, without copying the
+   clause first. A clause variable's first occurrence just aliases the goal
+   subterm; only parts bound to goal variables get built. */
+static int unify_head(Term *p, Term *t, Term **frame)
 {
-    for (int i = 0; i < M->n; i++)
-        if (M->from[i] == orig)
-            return M->to[i];
-    if (M->n >= M->cap)
+    for (;;)
     {
-        M->cap = M->cap ? M->cap * 2 : 16;
-        M->from = (const Term **)realloc(M->from, (size_t)M->cap * sizeof(Term *));
-        M->to = (Term **)realloc(M->to, (size_t)M->cap * sizeof(Term *));
+        if (p->k == TM_VAR)
+        {
+            Term **slot = &frame[p->u.v.id];
+            if (!*slot)
+            {
+                *slot = t;
+                return 1;
+            }
+            return unify(t, *slot); /* goal side first, as a copied head would bind */
+        }
+        t = deref(t);
+        if (t->k == TM_VAR)
+        {
+            bind(t, rename_term(p, frame));
+            return 1;
+        }
+        if (p->k == TM_NUM)
+            return t->k == TM_NUM && t->u.num == p->u.num;
+        if (t->k != TM_STRUC || t->u.s.name != p->u.s.name || t->u.s.arity != p->u.s.arity)
+            return 0;
+        int n = p->u.s.arity;
+        if (n == 0)
+            return 1;
+        for (int i = 0; i < n - 1; i++)
+            if (!unify_head(p->u.s.args.a[i], t->u.s.args.a[i], frame))
+                return 0;
+        p = p->u.s.args.a[n - 1];
+        t = t->u.s.args.a[n - 1];
     }
-    Term *nv = mk_var(orig->k == TM_VAR && orig->u.v.name ? orig->u.v.name : "_");
-    M->from[M->n] = orig;
-    M->to[M->n] = nv;
-    M->n++;
-    return nv;
 }
 
-static Term *copy_term(Term *t, VMap *M)
+static int mark_ground(Term *t)
 {
     if (t->k == TM_VAR)
-        return map_get(M, t);
+        return 0;
     if (t->k == TM_NUM)
-        return mk_num(t->u.num);
-    /* struct */
-    Term *c = mk_struct(t->u.s.name, t->u.s.arity);
+        return 1;
+    int g = 1;
     for (int i = 0; i < t->u.s.arity; i++)
-        c->u.s.args.a[i] = copy_term(t->u.s.args.a[i], M);
-    return c;
+        g &= mark_ground(t->u.s.args.a[i]);
+    t->u.s.ground = g;
+    return g;
 }
 
 /* print a term (pretty lists) */
@@ -797,31 +985,29 @@ static void print_term(Term *t)
 /* Builtins */
 static int is_atom(Term *t, const char *name, int arity)
 {
-    t = deref(t);
-    return t->k == TM_STRUC && t->u.s.arity == arity && strcmp(t->u.s.name, name) == 0;
+    return t->k == TM_STRUC && t->u.s.arity == arity && t->u.s.name == name;
 }
 
 static int builtin_call(Term *goal)
 {
-    goal = deref(goal);
-    if (is_atom(goal, "true", 0))
+    if (is_atom(goal, A_TRUE, 0))
         return 1;
-    if (is_atom(goal, "fail", 0))
+    if (is_atom(goal, A_FAIL, 0))
         return 0;
 
-    if (is_atom(goal, "nl", 0))
+    if (is_atom(goal, A_NL, 0))
     {
         printf("\n");
         return 1;
     }
 
-    if (is_atom(goal, "write", 1))
+    if (is_atom(goal, A_WRITE, 1))
     {
         print_term(goal->u.s.args.a[0]);
         return 1;
     }
 
-    if (is_atom(goal, "=", 2))
+    if (is_atom(goal, A_EQ, 2))
     {
         int m = trail_mark();
         if (unify(goal->u.s.args.a[0], goal->u.s.args.a[1]))
@@ -830,7 +1016,7 @@ static int builtin_call(Term *goal)
         return 0;
     }
 
-    if (is_atom(goal, "dif", 2))
+    if (is_atom(goal, A_DIF, 2))
     {
         int m = trail_mark();
         int ok = unify(goal->u.s.args.a[0], goal->u.s.args.a[1]);
@@ -841,23 +1027,313 @@ static int builtin_call(Term *goal)
     return -1; /* not a builtin */
 }
 
-/* solver: depth-first search, enumerate all solutions */
-static KB g_kb = {0};
-static int g_solution_count = 0;
+/* ============ Predicates & first-argument index ============ */
 
-/* concatenate body with rest goals */
-static Term **concat_goals(Term **body, int bn, Term **rest, int rn, int *outn)
+/* First-argument key: a functor (name/arity) or a number. kind 0 is a
+   variable, which matches every key. */
+typedef struct
 {
-    int n = bn + rn;
-    Term **g = (Term **)xmalloc((size_t)n * sizeof(Term *));
-    for (int i = 0; i < bn; i++)
-        g[i] = body[i];
-    for (int i = 0; i < rn; i++)
-        g[bn + i] = rest[i];
-    *outn = n;
-    return g;
+    int kind;
+    const char *name;
+    int arity;
+    double num;
+} ArgKey;
+
+static ArgKey arg_key(Term *t)
+{
+    ArgKey k = {0, NULL, 0, 0.0};
+    if (t->k == TM_STRUC)
+    {
+        k.kind = 1;
+        k.name = t->u.s.name;
+        k.arity = t->u.s.arity;
+    }
+    else if (t->k == TM_NUM)
+    {
+        k.kind = 2;
+        k.num = t->u.num == 0 ? 0.0 : t->u.num; /* -0 unifies with 0 */
+    }
+    return k;
+}
+static size_t key_hash(ArgKey k)
+{
+    uint64_t h;
+    if (k.kind == 1)
+        h = (uint64_t)(uintptr_t)k.name * 31 + (uint64_t)k.arity;
+    else
+        memcpy(&h, &k.num, sizeof h);
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    return (size_t)(h ^ (h >> 32));
+}
+static int key_eq(ArgKey a, ArgKey b)
+{
+    if (a.kind != b.kind)
+        return 0;
+    return a.kind == 1 ? a.name == b.name && a.arity == b.arity : a.num == b.num;
+}
+
+typedef struct
+{
+    int *v;
+    int n, cap;
+} IntVec;
+static void ivec_push(IntVec *v, int x)
+{
+    if (v->n >= v->cap)
+    {
+        v->cap = v->cap ? v->cap * 2 : 4;
+        v->v = (int *)realloc(v->v, (size_t)v->cap * sizeof(int));
+    }
+    v->v[v->n++] = x;
+}
+
+/* clauses whose first argument can match key: that key's clauses plus the
+   variable-first ones, in source order */
+typedef struct
+{
+    ArgKey key; /* kind 0 = empty slot */
+    IntVec cl;
+} IndexBucket;
+
+typedef struct
+{
+    char *name;
+    int arity;
+    Clause **cl; /* source order */
+    int n, cap;
+    IntVec var_cl; /* clauses with a variable first argument */
+    IndexBucket *bk;
+    int nbk, capbk;
+} Pred;
+
+static struct
+{
+    Pred **v;
+    int n, cap;
+} g_preds;
+
+static size_t pred_hash(const char *name, int arity) { return ((uintptr_t)name >> 3) * 31 + (size_t)arity; }
+
+static Pred *pred_find(const char *name, int arity)
+{
+    if (!g_preds.cap)
+        return NULL;
+    size_t j = pred_hash(name, arity) & (size_t)(g_preds.cap - 1);
+    while (g_preds.v[j])
+    {
+        if (g_preds.v[j]->name == name && g_preds.v[j]->arity == arity)
+            return g_preds.v[j];
+        j = (j + 1) & (size_t)(g_preds.cap - 1);
+    }
+    return NULL;
+}
+
+static Pred *pred_get(char *name, int arity)
+{
+    Pred *p = pred_find(name, arity);
+    if (p)
+        return p;
+    if (g_preds.n * 2 >= g_preds.cap)
+    {
+        int ncap = g_preds.cap ? g_preds.cap * 2 : 64;
+        Pred **nv = (Pred **)calloc((size_t)ncap, sizeof(Pred *));
+        if (!nv)
+        {
+            fprintf(stderr, "OOM\n");
+            exit(1);
+        }
+        for (int i = 0; i < g_preds.cap; i++)
+            if (g_preds.v[i])
+            {
+                size_t j = pred_hash(g_preds.v[i]->name, g_preds.v[i]->arity) & (size_t)(ncap - 1);
+                while (nv[j])
+                    j = (j + 1) & (size_t)(ncap - 1);
+                nv[j] = g_preds.v[i];
+            }
+        free(g_preds.v);
+        g_preds.v = nv;
+        g_preds.cap = ncap;
+    }
+    p = (Pred *)xmalloc(sizeof *p);
+    memset(p, 0, sizeof *p);
+    p->name = name;
+    p->arity = arity;
+    size_t j = pred_hash(name, arity) & (size_t)(g_preds.cap - 1);
+    while (g_preds.v[j])
+        j = (j + 1) & (size_t)(g_preds.cap - 1);
+    g_preds.v[j] = p;
+    g_preds.n++;
+    return p;
+}
+
+static IndexBucket *bucket_find(Pred *p, ArgKey k)
+{
+    if (!p->capbk)
+        return NULL;
+    size_t j = key_hash(k) & (size_t)(p->capbk - 1);
+    while (p->bk[j].key.kind)
+    {
+        if (key_eq(p->bk[j].key, k))
+            return &p->bk[j];
+        j = (j + 1) & (size_t)(p->capbk - 1);
+    }
+    return NULL;
+}
+
+static IndexBucket *bucket_get(Pred *p, ArgKey k)
+{
+    IndexBucket *b = bucket_find(p, k);
+    if (b)
+        return b;
+    if (p->nbk * 2 >= p->capbk)
+    {
+        int ncap = p->capbk ? p->capbk * 2 : 8;
+        IndexBucket *nb = (IndexBucket *)calloc((size_t)ncap, sizeof(IndexBucket));
+        if (!nb)
+        {
+            fprintf(stderr, "OOM\n");
+            exit(1);
+        }
+        for (int i = 0; i < p->capbk; i++)
+            if (p->bk[i].key.kind)
+            {
+                size_t j = key_hash(p->bk[i].key) & (size_t)(ncap - 1);
+                while (nb[j].key.kind)
+                    j = (j + 1) & (size_t)(ncap - 1);
+                nb[j] = p->bk[i];
+            }
+        free(p->bk);
+        p->bk = nb;
+        p->capbk = ncap;
+    }
+    size_t j = key_hash(k) & (size_t)(p->capbk - 1);
+    while (p->bk[j].key.kind)
+        j = (j + 1) & (size_t)(p->capbk - 1);
+    b = &p->bk[j];
+    b->key = k;
+    /* variable-first clauses seen so far match this key too */
+    for (int i = 0; i < p->var_cl.n; i++)
+        ivec_push(&b->cl, p->var_cl.v[i]);
+    p->nbk++;
+    return b;
+}
+
+static void kb_add(Clause *cl)
+{
+    Term *h = cl->head;
+    if (h->k != TM_STRUC)
+    {
+        fprintf(stderr, "clause head must be an atom or compound term\n");
+        exit(2);
+    }
+    mark_ground(h);
+    for (int i = 0; i < cl->body_n; i++)
+        mark_ground(cl->body[i]);
+
+    Pred *p = pred_get(h->u.s.name, h->u.s.arity);
+    if (p->n >= p->cap)
+    {
+        p->cap = p->cap ? p->cap * 2 : 4;
+        p->cl = (Clause **)realloc(p->cl, (size_t)p->cap * sizeof(Clause *));
+    }
+    int idx = p->n++;
+    p->cl[idx] = cl;
+    if (p->arity == 0)
+        return;
+
+    ArgKey k = arg_key(h->u.s.args.a[0]);
+    if (!k.kind)
+    {
+        ivec_push(&p->var_cl, idx);
+        for (int i = 0; i < p->capbk; i++)
+            if (p->bk[i].key.kind)
+                ivec_push(&p->bk[i].cl, idx);
+        return;
+    }
+    ivec_push(&bucket_get(p, k)->cl, idx);
+}
+
+static int g_noindex = 0; /* bench: scan every clause, as before indexing */
+
+/* candidate clauses for a call: *alt == NULL means all of p->cl */
+static void candidates(Pred *p, Term *goal, const int **alt, int *n)
+{
+    *alt = NULL;
+    *n = p->n;
+    if (g_noindex || p->arity == 0)
+        return;
+    ArgKey k = arg_key(deref(goal->u.s.args.a[0]));
+    if (!k.kind)
+        return;
+    IndexBucket *b = bucket_find(p, k);
+    if (b)
+    {
+        *alt = b->cl.v;
+        *n = b->cl.n;
+    }
+    else
+    {
+        *alt = p->var_cl.v;
+        *n = p->var_cl.n;
+    }
+}
+
+/* ============ Solver ============ */
+
+/* pending goals: an immutable list shared by every choicepoint that needs it */
+typedef struct Cont
+{
+    Term *goal;
+    struct Cont *next;
+} Cont;
+
+static Cont *cont(Term *goal, Cont *next)
+{
+    Cont *c = (Cont *)h_alloc(sizeof *c);
+    c->goal = goal;
+    c->next = next;
+    return c;
 }
 
+/* a call with untried candidate clauses */
+typedef struct
+{
+    Term *goal;
+    Cont *next;
+    Pred *pred;
+    const int *alt;
+    int n, i;
+    int trail;
+    HeapMark heap;
+} ChoicePoint;
+
+static struct
+{
+    ChoicePoint *v;
+    int n, cap;
+} g_cp;
+static int g_cp_peak = 0;
+
+/* solver events, counted in ONCHIP_PROFILE builds (onchip_bench --hist) */
+#define SOLVE_EVENTS(X)                \
+    X(CALL, "call")                    \
+    X(BUILTIN, "builtin")              \
+    X(NO_CLAUSES, "no-clauses")        \
+    X(HEAD_FAIL, "head-fail")          \
+    X(CHOICEPOINT, "choicepoint")      \
+    X(BACKTRACK, "backtrack")          \
+    X(SOLUTION, "solution")
+#define SOLVE_EV_ENUM(e, name) SV_##e,
+enum
+{
+    SOLVE_EVENTS(SOLVE_EV_ENUM) SV_COUNT
+};
+
+static int g_solution_count = 0;
+static long long g_inferences = 0;
+static int g_quiet = 0; /* bench: count solutions without printing them */
+
 /* collect printable vars from original query goals */
 typedef struct
 {
@@ -878,17 +1354,21 @@ static void vset_add(VSet *S, Term *v)
 }
 static void collect_vars(Term *t, VSet *S)
 {
-    t = deref(t);
-    if (t->k == TM_VAR)
-    {
-        if (!t->u.v.anonymous)
-            vset_add(S, t);
-        return;
-    }
-    if (t->k == TM_STRUC)
+    for (;;)
     {
-        for (int i = 0; i < t->u.s.arity; i++)
+        t = deref(t);
+        if (t->k == TM_VAR)
+        {
+            if (!t->u.v.anonymous)
+                vset_add(S, t);
+            return;
+        }
+        if (t->k != TM_STRUC || t->u.s.arity == 0)
+            return;
+        int n = t->u.s.arity;
+        for (int i = 0; i < n - 1; i++)
             collect_vars(t->u.s.args.a[i], S);
+        t = t->u.s.args.a[n - 1];
     }
 }
 
@@ -909,73 +1389,126 @@ static void print_solution(VSet *S)
     printf("\n");
 }
 
-/* recursive search */
+/* Depth-first search over all solutions, without C recursion: the goal list
+   is a continuation, and each call with untried clauses pushes a
+   choicepoint. A clause's last body goal inherits the caller's
+   continuation, and a call down to its last candidate leaves no
+   choicepoint, so deterministic recursion runs in constant C stack and
+   choicepoint space (last-call optimization). */
 static void solve(Term **goals, int gn, VSet *query_vars)
 {
-    if (gn == 0)
-    {
-        g_solution_count++;
-        print_solution(query_vars);
-        return; /* continue for more on backtracking */
-    }
-    Term *G = goals[0];
-
-    /* check builtin first */
-    int bi = builtin_call(G);
-    if (bi == 1)
-    {
-        /* succeed: continue with rest */
-        solve(goals + 1, gn - 1, query_vars);
-        return;
-    }
-    else if (bi == 0)
+    int trail0 = trail_mark(), cp0 = g_cp.n;
+    HeapMark heap0 = h_mark();
+    Cont *c = NULL;
+    for (int j = gn - 1; j >= 0; j--)
+        c = cont(goals[j], c);
+
+    Term *goal;
+    Cont *next;
+    Pred *pr;
+    const int *alt;
+    int n, i, tm;
+    HeapMark hm;
+    for (;;)
     {
-        /* builtin fail -> backtrack */
-        return;
-    }
+        if (!c)
+        {
+            ONCHIP_COUNT(SV_SOLUTION);
+            g_solution_count++;
+            if (!g_quiet)
+                print_solution(query_vars);
+            goto backtrack; /* continue for more on backtracking */
+        }
+        goal = deref(c->goal);
+        next = c->next;
+        g_inferences++;
+        ONCHIP_COUNT(SV_CALL);
+
+        /* check builtin first */
+        int bi = builtin_call(goal);
+        if (bi >= 0)
+            ONCHIP_COUNT(SV_BUILTIN);
+        if (bi == 1)
+        {
+            c = next;
+            continue;
+        }
+        if (bi == 0)
+            goto backtrack;
 
-    /* try user clauses */
-    for (int i = 0; i < g_kb.n; i++)
-    {
-        Clause *cl = &g_kb.c[i];
+        pr = goal->k == TM_STRUC ? pred_find(goal->u.s.name, goal->u.s.arity) : NULL;
+        if (!pr)
+        {
+            ONCHIP_COUNT(SV_NO_CLAUSES);
+            goto backtrack; /* no clauses: fail */
+        }
+        candidates(pr, goal, &alt, &n);
+        i = 0;
+        tm = trail_mark();
+        hm = h_mark();
 
-        /* quick functor filter */
-        Term *Gh = deref(G);
-        Term *H = cl->head;
-        if (Gh->k == TM_STRUC && H->k == TM_STRUC)
+    try_clauses:
+        for (; i < n; i++)
         {
-            if (strcmp(Gh->u.s.name, H->u.s.name) != 0)
-                continue;
-            if (Gh->u.s.arity != H->u.s.arity)
+            Clause *cl = pr->cl[alt ? alt[i] : i];
+            Term **frame = h_frame(cl->nvars);
+            if (!unify_head(cl->head, goal, frame))
+            {
+                ONCHIP_COUNT(SV_HEAD_FAIL);
+                trail_unwind(tm);
+                h_release(hm);
                 continue;
+            }
+            if (i + 1 < n)
+            {
+                if (g_cp.n >= g_cp.cap)
+                {
+                    g_cp.cap = g_cp.cap ? g_cp.cap * 2 : 64;
+                    g_cp.v = (ChoicePoint *)realloc(g_cp.v, (size_t)g_cp.cap * sizeof(ChoicePoint));
+                }
+                ChoicePoint *cp = &g_cp.v[g_cp.n++];
+                ONCHIP_COUNT(SV_CHOICEPOINT);
+                if (g_cp.n > g_cp_peak)
+                    g_cp_peak = g_cp.n;
+                cp->goal = goal;
+                cp->next = next;
+                cp->pred = pr;
+                cp->alt = alt;
+                cp->n = n;
+                cp->i = i + 1;
+                cp->trail = tm;
+                cp->heap = hm;
+            }
+            /* prepend the renamed body to the rest goals */
+            c = next;
+            for (int j = cl->body_n - 1; j >= 0; j--)
+                c = cont(rename_term(cl->body[j], frame), c);
+            break;
         }
-        else if (Gh->k != H->k)
+        if (i < n)
             continue;
 
-        int mark = trail_mark();
-        VMap M = {0};
-        Term *Hcopy = copy_term(cl->head, &M);
-        if (unify(Gh, Hcopy))
+    backtrack:
+        if (g_cp.n == cp0)
+            break;
         {
-            /* copy body with same var map; prepend to rest goals */
-            int bn = cl->body_n;
-            Term **B = NULL;
-            if (bn > 0)
-            {
-                B = (Term **)xmalloc((size_t)bn * sizeof(Term *));
-                for (int j = 0; j < bn; j++)
-                    B[j] = copy_term(cl->body[j], &M);
-            }
-            int newn = 0;
-            Term **NG = concat_goals(B, bn, goals + 1, gn - 1, &newn);
-            solve(NG, newn, query_vars);
-            free(B);
-            free(NG);
+            ChoicePoint *cp = &g_cp.v[--g_cp.n];
+            ONCHIP_COUNT(SV_BACKTRACK);
+            trail_unwind(cp->trail);
+            h_release(cp->heap);
+            goal = cp->goal;
+            next = cp->next;
+            pr = cp->pred;
+            alt = cp->alt;
+            n = cp->n;
+            i = cp->i;
+            tm = cp->trail;
+            hm = cp->heap;
         }
-        trail_unwind(mark);
-        free(M.from);
-        free(M.to);
+        goto try_clauses;
     }
+    trail_unwind(trail0);
+    h_release(heap0);
 }
 
 /* ============ Driver ============ */
@@ -995,21 +1528,9 @@ static char *load_file(const char *path)
     return buf;
 }
 
-int main(int argc, char **argv)
+/* parse src, adding clauses to the KB; the last query replaces *last_query */
+static int consult(const char *src, TermVec *last_query)
 {
-    const char *src = demo_program;
-    char *heap = NULL;
-    if (argc > 1)
-    {
-        heap = load_file(argv[1]);
-        if (!heap)
-        {
-            fprintf(stderr, "Could not read '%s'\n", argv[1]);
-            return 1;
-        }
-        src = heap;
-    }
-
     Parser P;
     P.had_error = 0;
     P.L.src = src;
@@ -1019,8 +1540,6 @@ int main(int argc, char **argv)
     P.L.col = 1;
     lx_next(&P.L);
 
-    /* parse loop */
-    TermVec last_query = {0};
     while (P.L.cur.t != TK_EOF)
     {
         int is_q = 0;
@@ -1029,25 +1548,225 @@ int main(int argc, char **argv)
         if (P.had_error)
         {
             fprintf(stderr, "Aborting due to parse errors.\n");
-            free(heap);
-            return 2;
+            return 0;
         }
         if (is_q)
         {
             /* replace last query */
-            free(last_query.ptrs);
-            last_query = q_goals;
+            free(last_query->ptrs);
+            *last_query = q_goals;
         }
         else
+            kb_add(cl);
+    }
+    return 1;
+}
+
+/* ============ Benchmarks ============ */
+
+static const char *bench_program =
+    "app([], L, L).\n"
+    "app([H|T], L, [H|R]) :- app(T, L, R).\n"
+    "nrev([], []).\n"
+    "nrev([H|T], R) :- nrev(T, RT), app(RT, [H], R).\n"
+    "walk([]).\n"
+    "walk([_|T]) :- walk(T).\n";
+
+#define BENCH_FACTS 5000
+#define BENCH_NREV_RUNS 2000
+#define BENCH_WALK_LEN 200000
+
+typedef struct
+{
+    char *s;
+    size_t n, cap;
+} StrBuf;
+static void sb_printf(StrBuf *b, const char *fmt, ...)
+{
+    va_list ap;
+    if (b->n + 256 > b->cap)
+    {
+        b->cap = b->cap ? b->cap * 2 : 4096;
+        b->s = (char *)realloc(b->s, b->cap);
+    }
+    va_start(ap, fmt);
+    b->n += (size_t)vsnprintf(b->s + b->n, b->cap - b->n, fmt, ap);
+    va_end(ap);
+}
+
+static TermVec bench_query(const char *src)
+{
+    TermVec q = {0};
+    if (!consult(src, &q) || q.n == 0)
+        exit(2);
+    return q;
+}
+
+/* run each query `reps` times; every run must yield exactly one solution */
+static void bench_row(const char *name, TermVec *qs, int nq, int reps)
+{
+    VSet none = {0};
+    long long inf0 = g_inferences;
+    g_cp_peak = 0;
+    int sols = 0;
+    clock_t t0 = clock();
+    for (int r = 0; r < reps; r++)
+        for (int q = 0; q < nq; q++)
         {
-            if (g_kb.n >= g_kb.cap)
-            {
-                g_kb.cap = g_kb.cap ? g_kb.cap * 2 : 16;
-                g_kb.c = (Clause *)realloc(g_kb.c, (size_t)g_kb.cap * sizeof(Clause));
-            }
-            g_kb.c[g_kb.n++] = *cl;
-            free(cl);
+            g_solution_count = 0;
+            solve(qs[q].ptrs, qs[q].n, &none);
+            sols += g_solution_count == 1;
+        }
+    double ms = (double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC;
+    long long inf = g_inferences - inf0;
+    printf("%-22s %12lld %10.1f %12.0f %7d%s\n", name, inf, ms, ms > 0 ? inf / (ms / 1000.0) : 0.0,
+           g_cp_peak, sols == reps * nq ? "" : "  WRONG");
+}
+
+static int run_bench(void)
+{
+    TermVec none = {0};
+    if (!consult(bench_program, &none))
+        return 2;
+
+    StrBuf b = {0};
+    for (int i = 0; i < BENCH_FACTS; i++)
+        sb_printf(&b, "f(k%d, %d).\n", i, i);
+    if (!consult(b.s, &none))
+        return 2;
+
+    b.n = 0;
+    sb_printf(&b, "?- nrev([1");
+    for (int i = 2; i <= 30; i++)
+        sb_printf(&b, ",%d", i);
+    sb_printf(&b, "], R).");
+    TermVec nrev = bench_query(b.s);
+
+    TermVec *lookups = (TermVec *)xmalloc(BENCH_FACTS * sizeof(TermVec));
+    for (int i = 0; i < BENCH_FACTS; i++)
+    {
+        char q[64];
+        snprintf(q, sizeof q, "?- f(k%d, V).", (i * 7919) % BENCH_FACTS);
+        lookups[i] = bench_query(q);
+    }
+
+    b.n = 0;
+    sb_printf(&b, "?- walk([0");
+    for (int i = 1; i < BENCH_WALK_LEN; i++)
+        sb_printf(&b, ",%d", i);
+    sb_printf(&b, "]).");
+    TermVec walk = bench_query(b.s);
+    free(b.s);
+
+    g_quiet = 1;
+    printf("%-22s %12s %10s %12s %7s\n", "bench", "inferences", "ms", "LIPS", "max cp");
+    bench_row("nrev30", &nrev, 1, BENCH_NREV_RUNS);
+    bench_row("fact lookup (5000)", lookups, BENCH_FACTS, 1);
+    bench_row("walk 200k (LCO)", &walk, 1, 1);
+    g_noindex = 1;
+    bench_row("nrev30, no index", &nrev, 1, BENCH_NREV_RUNS);
+    bench_row("fact lookup, no index", lookups, BENCH_FACTS, 1);
+    g_noindex = 0;
+    return 0;
+}
+
+/* ============ Library entry point for onchip_bench.c ============ */
+#ifdef ONCHIP_LIB
+/* The suite's workloads over lists, as there is no arithmetic: loops walk a
+   list, recursion is naive reverse, and a run is one query whose result is
+   its number of solutions. Clauses stay in the database once consulted, so
+   each workload has its own predicate names; every _ in a clause is one
+   variable here, so the body names what it ignores. */
+#define PL_X10 "x,x,x,x,x,x,x,x,x,x"
+#define PL_X100 PL_X10 "," PL_X10 "," PL_X10 "," PL_X10 "," PL_X10 "," \
+    PL_X10 "," PL_X10 "," PL_X10 "," PL_X10 "," PL_X10
+#define PL_X1000 PL_X100 "," PL_X100 "," PL_X100 "," PL_X100 "," PL_X100 "," \
+    PL_X100 "," PL_X100 "," PL_X100 "," PL_X100 "," PL_X100
+static const OnchipWorkload LIB_WORK[] = {
+    {"loops",
+     "walk([]).\n"
+     "walk([_|T]) :- walk(T).\n"
+     "loop([], _).\n"
+     "loop([_|T], L) :- walk(L), loop(T, L).\n"
+     "xs1000([" PL_X1000 "]).\n"
+     "?- xs1000(L), loop(L, L).\n",
+     1e6, 1},
+    {"recursion", /* 496 calls per reverse */
+     "app([], L, L).\n"
+     "app([H|T], L, [H|R]) :- app(T, L, R).\n"
+     "nrev([], []).\n"
+     "nrev([H|T], R) :- nrev(T, RT), app(RT, [H], R).\n"
+     "rep([]).\n"
+     "rep([_|T]) :- nrev([1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,"
+     "21,22,23,24,25,26,27,28,29,30], R), rep(T).\n"
+     "?- rep([" PL_X100 "," PL_X100 "," PL_X100 "]).\n",
+     300 * 496, 1},
+    {"lists",
+     "copy([], []).\n"
+     "copy([H|T], [H|R]) :- copy(T, R).\n"
+     "copies([], _).\n"
+     "copies([_|T], L) :- copy(L, C), copies(T, L).\n"
+     "ys1000([" PL_X1000 "]).\n"
+     "?- ys1000(L), copies([" PL_X100 "], L).\n",
+     1e5, 1},
+};
+
+#define SOLVE_EV_NAME(e, name) name,
+static const char *const solve_names[] = {SOLVE_EVENTS(SOLVE_EV_NAME)};
+
+static TermVec lib_query;
+
+static int lib_load(const char *src)
+{
+    if (!A_TRUE)
+        init_atoms();
+    g_quiet = 1;
+    return consult(src, &lib_query) && lib_query.n > 0;
+}
+
+static int lib_run(double *result)
+{
+    VSet none = {0};
+    g_solution_count = 0;
+    solve(lib_query.ptrs, lib_query.n, &none);
+    *result = g_solution_count;
+    return 1;
+}
+
+static void lib_unload(void)
+{
+    free(lib_query.ptrs);
+    lib_query.ptrs = NULL;
+    lib_query.n = 0;
+}
+
+#define main onchip_prolog_main
+#endif
+
+int main(int argc, char **argv)
+{
+    init_atoms();
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+        return run_bench();
+
+    const char *src = demo_program;
+    char *text = NULL;
+    if (argc > 1)
+    {
+        text = load_file(argv[1]);
+        if (!text)
+        {
+            fprintf(stderr, "Could not read '%s'\n", argv[1]);
+            return 1;
         }
+        src = text;
+    }
+
+    TermVec last_query = {0};
+    if (!consult(src, &last_query))
+    {
+        free(text);
+        return 2;
     }
 
     if (last_query.n == 0)
@@ -1069,10 +1788,15 @@ int main(int argc, char **argv)
     if (g_solution_count == 0)
         printf("false.\n");
 
-    free(heap);
+    free(text);
     free(g_trail.v);
+    free(g_cp.v);
     free(qvars.v);
     free(last_query.ptrs);
-    free(g_kb.c); /* (not freeing deep terms for brevity) */
     return 0;
 }
+
+#ifdef ONCHIP_LIB
+const OnchipEngine onchip_engine_prolog = {"prolog", LIB_WORK, (int)(sizeof(LIB_WORK) / sizeof(LIB_WORK[0])),
+                                           lib_load, lib_run, lib_unload, solve_names, SV_COUNT, main};
+#endif
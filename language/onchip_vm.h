@@ -0,0 +1,1471 @@
+/*
+ * onchip_vm.h — typed IR, lowering and register VM shared by onchip_c.c and
+ * onchip_fortran.c
+ *
+ * What this provides
+ *  - IrExpr/IrStmt: a small tree both front ends translate their ASTs into.
+ *    Operators keep the front ends' codes ('+', IR_LE = 256 + 'l', ...).
+ *  - ir_compile(): constant folding, typing, variable -> frame slot
+ *    resolution, and codegen to three-address register bytecode. Variables,
+ *    constants and temporaries share one frame, so every operand is a slot.
+ *  - vm_run(): computed-goto dispatch (a switch elsewhere) over int- and
+ *    real-specialized opcodes, with fused compare-and-branch and DO-loop ops.
+ *    Dispatches are counted per opcode in ONCHIP_PROFILE builds.
+ *  - vm_dis(): a bytecode listing, operands shown by variable name.
+ *
+ * Semantics
+ *  - VM_MODE_INT (C subset): every value is a VM_INT, / and % are integer
+ *    ops and wrap instead of overflowing.
+ *  - VM_MODE_REAL (Fortran subset): every value is a double as far as the
+ *    program can tell. A DO counter that is never assigned and whose bounds
+ *    are integral runs on int ops, as do + and - on such values and
+ *    comparison results: exact while they stay below 2^53.
+ *  - Each variable slot has a state (none / declared / set), so the front
+ *    ends keep their runtime errors. The lowering tracks which variables
+ *    are definitely set at each point and only emits a check where it
+ *    cannot prove it; straight-line code and loop bodies after the first
+ *    assignment run check-free.
+ *  - VM_INT is int64_t unless VM_INT/VM_UINT are defined before the include.
+ *
+ * Header only (static functions), so each interpreter stays a single-file
+ * build:
+ *   #include "onchip_vm.h"
+ */
+
+#ifndef ONCHIP_VM_H
+#define ONCHIP_VM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "onchip_bench.h"
+
+#ifndef VM_INT
+#define VM_INT int64_t
+#define VM_UINT uint64_t
+#endif
+
+/* Two-character operators, as both front ends encode them */
+#define IR_LE (256 + 'l')
+#define IR_GE (256 + 'g')
+#define IR_EQ (256 + 'e')
+#define IR_NE (256 + 'n')
+#define IR_AND (256 + '&')
+#define IR_OR (256 + '|')
+
+enum
+{
+    VM_MODE_INT,
+    VM_MODE_REAL
+};
+enum
+{
+    VM_T_INT,
+    VM_T_REAL
+};
+enum
+{
+    VM_S_NONE,
+    VM_S_DECL,
+    VM_S_SET
+};
+enum
+{
+    VM_K_VAR,
+    VM_K_CONST,
+    VM_K_TEMP
+};
+
+/* Runtime errors; vm_run() returns one and leaves the variable in err_slot */
+enum
+{
+    VM_OK,
+    VM_E_DIV0,
+    VM_E_MOD0,
+    VM_E_UNDEF,  /* read of a never-declared variable */
+    VM_E_UNINIT, /* read of a declared, never-set variable */
+    VM_E_REDECL,
+    VM_E_UNDECL, /* assignment to a never-declared variable (strict_decl) */
+    VM_E_STEP0,
+    VM_E_STR /* string in numeric context */
+};
+
+typedef union
+{
+    VM_INT i;
+    double f;
+} VmVal;
+
+/* ---------- IR ---------- */
+
+typedef enum
+{
+    IR_CONST,
+    IR_VAR,
+    IR_STR,
+    IR_UN,
+    IR_BIN
+} IrExprKind;
+
+typedef struct IrExpr
+{
+    IrExprKind kind;
+    int op;           /* UN/BIN */
+    int type;         /* VM_T_*, set by the lowering */
+    VmVal v;          /* CONST: .i in INT mode, .f in REAL mode */
+    const char *name; /* VAR: the name; STR: the text */
+    int slot;         /* VAR, set by the lowering */
+    struct IrExpr *a, *b;
+} IrExpr;
+
+typedef enum
+{
+    IS_BLOCK,
+    IS_DECL,
+    IS_ASSIGN,
+    IS_PRINT,
+    IS_IF,
+    IS_WHILE,
+    IS_DO
+} IrStmtKind;
+
+typedef struct IrStmt
+{
+    IrStmtKind kind;
+    const char *name;          /* DECL, ASSIGN, DO: the variable */
+    int slot;                  /* set by the lowering */
+    IrExpr *e;                 /* DECL init (or NULL), ASSIGN value, IF/WHILE condition, DO start */
+    IrExpr *e2, *e3;           /* DO limit and step */
+    struct IrStmt *body, *alt; /* IF then/else (alt may be NULL), WHILE/DO body */
+    void **list;               /* BLOCK statements, PRINT items (IrExpr, STR allowed) */
+    int n, cap;
+} IrStmt;
+
+typedef struct
+{
+    int mode;        /* VM_MODE_* */
+    int strict_decl; /* declaring twice is an error, assigning needs a declaration */
+} IrLang;
+
+static inline IrExpr *ir_expr_new(IrExprKind k)
+{
+    IrExpr *e = (IrExpr *)calloc(1, sizeof(*e));
+    e->kind = k;
+    return e;
+}
+static inline IrExpr *ir_int(VM_INT v)
+{
+    IrExpr *e = ir_expr_new(IR_CONST);
+    e->v.i = v;
+    return e;
+}
+static inline IrExpr *ir_real(double v)
+{
+    IrExpr *e = ir_expr_new(IR_CONST);
+    e->v.f = v;
+    return e;
+}
+static inline IrExpr *ir_var(const char *name)
+{
+    IrExpr *e = ir_expr_new(IR_VAR);
+    e->name = name;
+    return e;
+}
+static inline IrExpr *ir_str(const char *s)
+{
+    IrExpr *e = ir_expr_new(IR_STR);
+    e->name = s;
+    return e;
+}
+static inline IrExpr *ir_un(int op, IrExpr *a)
+{
+    IrExpr *e = ir_expr_new(IR_UN);
+    e->op = op;
+    e->a = a;
+    return e;
+}
+static inline IrExpr *ir_bin(int op, IrExpr *a, IrExpr *b)
+{
+    IrExpr *e = ir_expr_new(IR_BIN);
+    e->op = op;
+    e->a = a;
+    e->b = b;
+    return e;
+}
+
+static inline IrStmt *ir_stmt_new(IrStmtKind k)
+{
+    IrStmt *s = (IrStmt *)calloc(1, sizeof(*s));
+    s->kind = k;
+    return s;
+}
+static inline void ir_append(IrStmt *s, void *item)
+{
+    if (s->n >= s->cap)
+    {
+        s->cap = s->cap ? s->cap * 2 : 8;
+        s->list = (void **)realloc(s->list, (size_t)s->cap * sizeof(void *));
+    }
+    s->list[s->n++] = item;
+}
+static inline IrStmt *ir_assign_new(IrStmtKind k, const char *name, IrExpr *e)
+{
+    IrStmt *s = ir_stmt_new(k);
+    s->name = name;
+    s->e = e;
+    return s;
+}
+#define ir_decl(name, init) ir_assign_new(IS_DECL, (name), (init))
+#define ir_assign(name, value) ir_assign_new(IS_ASSIGN, (name), (value))
+static inline IrStmt *ir_if(IrExpr *cond, IrStmt *then_s, IrStmt *else_s)
+{
+    IrStmt *s = ir_stmt_new(IS_IF);
+    s->e = cond;
+    s->body = then_s;
+    s->alt = else_s;
+    return s;
+}
+static inline IrStmt *ir_while(IrExpr *cond, IrStmt *body)
+{
+    IrStmt *s = ir_stmt_new(IS_WHILE);
+    s->e = cond;
+    s->body = body;
+    return s;
+}
+static inline IrStmt *ir_do(const char *var, IrExpr *start, IrExpr *limit, IrExpr *step, IrStmt *body)
+{
+    IrStmt *s = ir_assign_new(IS_DO, var, start);
+    s->e2 = limit;
+    s->e3 = step;
+    s->body = body;
+    return s;
+}
+
+/* ---------- Bytecode ---------- */
+
+/* Operand signature per opcode, for vm_dis: s = slot, j = jump target,
+   x = immediate, - = unused */
+#define VM_OPCODES(X)                                                          \
+    X(HALT, "---")     /* stop                                              */ \
+    X(MOV, "ss-")      /* r[a] = r[b]                                       */ \
+    X(I2F, "ss-")      /* r[a].f = r[b].i                                   */ \
+    X(ADDI, "sss")     /* r[a].i = r[b].i + r[c].i, wrapping; SUBI, MULI    */ \
+    X(SUBI, "sss")                                                             \
+    X(MULI, "sss")                                                             \
+    X(DIVI, "sss")     /* traps when r[c].i is 0; likewise MODI             */ \
+    X(MODI, "sss")                                                             \
+    X(NEGI, "ss-")                                                             \
+    X(ADDF, "sss")     /* r[a].f = r[b].f + r[c].f; SUBF .. POWF            */ \
+    X(SUBF, "sss")                                                             \
+    X(MULF, "sss")                                                             \
+    X(DIVF, "sss")     /* traps when r[c].f is 0                            */ \
+    X(POWF, "sss")                                                             \
+    X(NEGF, "ss-")                                                             \
+    X(JMP, "--j")      /* goto c                                            */ \
+    X(JZI, "s-j")      /* if (r[a] == 0) goto c; JNZ: if (r[a] != 0)        */ \
+    X(JNZI, "s-j")                                                             \
+    X(JZF, "s-j")                                                              \
+    X(JNZF, "s-j")                                                             \
+    X(JLTI, "ssj")     /* if (r[a] < r[b]) goto c; likewise LE .. NE        */ \
+    X(JLEI, "ssj")                                                             \
+    X(JGTI, "ssj")                                                             \
+    X(JGEI, "ssj")                                                             \
+    X(JEQI, "ssj")                                                             \
+    X(JNEI, "ssj")                                                             \
+    X(JLTF, "ssj")                                                             \
+    X(JLEF, "ssj")                                                             \
+    X(JGTF, "ssj")                                                             \
+    X(JGEF, "ssj")                                                             \
+    X(JEQF, "ssj")                                                             \
+    X(JNEF, "ssj")                                                             \
+    X(JNLTF, "ssj")    /* if !(r[a] < r[b]) goto c: NaN-safe negations      */ \
+    X(JNLEF, "ssj")                                                            \
+    X(JNGTF, "ssj")                                                            \
+    X(JNGEF, "ssj")                                                            \
+    X(FORPREPI, "ssj") /* limit r[b], step r[b+1]: trap if the step is 0,   */ \
+    X(FORLOOPI, "ssj") /*   goto c if r[a] is past the limit / r[a] += step, */ \
+    X(FORPREPF, "ssj") /*   goto c while it is not                          */ \
+    X(FORLOOPF, "ssj")                                                         \
+    X(DECL, "sx-")     /* state[a] = declared; trap if already, when b      */ \
+    X(CHKRD, "s--")    /* trap unless r[a] has been set                     */ \
+    X(CHKWR, "s--")    /* trap unless r[a] has been declared                */ \
+    X(DEF, "s--")      /* state[a] = set                                    */ \
+    X(PUTI, "s--")     /* print r[a].i                                      */ \
+    X(PUTF, "s--")     /* print r[a].f with %g                              */ \
+    X(PUTS, "-x-")     /* print string b                                    */ \
+    X(PUTC, "-x-")     /* print character b                                 */ \
+    X(TRAP, "-x-")     /* fail with error b                                 */
+
+#define VM_OP_ENUM(o, sig) VM_##o,
+#define VM_OP_NAME(o, sig) #o,
+#define VM_OP_SIG(o, sig) sig,
+typedef enum
+{
+    VM_OPCODES(VM_OP_ENUM) VM_OP_COUNT
+} VmOp;
+static const char *const vm_op_names[] = {VM_OPCODES(VM_OP_NAME)};
+static const char *const vm_op_sigs[] = {VM_OPCODES(VM_OP_SIG)};
+
+typedef struct
+{
+    uint16_t op, a, b, c;
+} VmIns;
+
+#define VM_MAX_SLOTS 0xFFFF
+#define VM_MAX_CODE 0xFFFE /* 0xFFFF ends a pending-jump chain */
+#define VM_NO_JUMP 0xFFFF
+
+typedef struct
+{
+    VmIns *code;
+    int ncode, capcode;
+    /* per slot */
+    VmVal *init;       /* constant value, 0 otherwise */
+    uint8_t *kind;     /* VM_K_* */
+    uint8_t *type;     /* VM_T_* (variables and constants) */
+    const char **name; /* variable name */
+    int nslot, capslot;
+    const char **str; /* PUTS strings */
+    int nstr, capstr;
+    int mode;
+    int too_big; /* more than VM_MAX_CODE instructions or VM_MAX_SLOTS slots */
+    /* after vm_run: the frame, and what went wrong */
+    VmVal *r;
+    uint8_t *st;
+    int err, err_slot;
+} VmProg;
+
+#define VM_GROW(p, n, cap, T)                                          \
+    do                                                                 \
+    {                                                                  \
+        if ((n) >= (cap))                                              \
+        {                                                              \
+            (cap) = (cap) ? (cap) * 2 : 64;                            \
+            (p) = (T *)realloc((void *)(p), (size_t)(cap) * sizeof(T)); \
+        }                                                              \
+    } while (0)
+
+static inline int vm_slot_new(VmProg *P, int kind, int type)
+{
+    if (P->nslot >= VM_MAX_SLOTS)
+        P->too_big = 1;
+    if (P->nslot >= P->capslot)
+    {
+        P->capslot = P->capslot ? P->capslot * 2 : 64;
+        P->init = (VmVal *)realloc(P->init, (size_t)P->capslot * sizeof(VmVal));
+        P->kind = (uint8_t *)realloc(P->kind, (size_t)P->capslot);
+        P->type = (uint8_t *)realloc(P->type, (size_t)P->capslot);
+        P->name = (const char **)realloc((void *)P->name, (size_t)P->capslot * sizeof(char *));
+    }
+    int s = P->nslot++;
+    P->init[s].i = 0;
+    P->kind[s] = (uint8_t)kind;
+    P->type[s] = (uint8_t)type;
+    P->name[s] = NULL;
+    return s;
+}
+
+/* Slot of a variable, -1 if the program never mentions it */
+static inline int vm_find_var(const VmProg *P, const char *name)
+{
+    for (int s = 0; s < P->nslot; s++)
+        if (P->kind[s] == VM_K_VAR && strcmp(P->name[s], name) == 0)
+            return s;
+    return -1;
+}
+static inline int vm_var(VmProg *P, const char *name)
+{
+    int s = vm_find_var(P, name);
+    if (s < 0)
+    {
+        s = vm_slot_new(P, VM_K_VAR, P->mode == VM_MODE_INT ? VM_T_INT : VM_T_REAL);
+        P->name[s] = name;
+    }
+    return s;
+}
+static inline int vm_const(VmProg *P, int type, VmVal v)
+{
+    for (int s = 0; s < P->nslot; s++)
+        if (P->kind[s] == VM_K_CONST && P->type[s] == type && memcmp(&P->init[s], &v, sizeof(v)) == 0)
+            return s;
+    int s = vm_slot_new(P, VM_K_CONST, type);
+    P->init[s] = v;
+    return s;
+}
+static inline int vm_const_i(VmProg *P, VM_INT i)
+{
+    VmVal v;
+    memset(&v, 0, sizeof(v));
+    v.i = i;
+    return vm_const(P, VM_T_INT, v);
+}
+static inline int vm_const_f(VmProg *P, double f)
+{
+    VmVal v;
+    v.f = f;
+    return vm_const(P, VM_T_REAL, v);
+}
+
+static inline int vm_emit(VmProg *P, int op, int a, int b, int c)
+{
+    if (P->ncode >= VM_MAX_CODE)
+        P->too_big = 1;
+    VM_GROW(P->code, P->ncode, P->capcode, VmIns);
+    VmIns *i = &P->code[P->ncode];
+    i->op = (uint16_t)op;
+    i->a = (uint16_t)a;
+    i->b = (uint16_t)b;
+    i->c = (uint16_t)c;
+    return P->ncode++;
+}
+
+static inline void vm_free(VmProg *P)
+{
+    free(P->code);
+    free(P->init);
+    free(P->kind);
+    free(P->type);
+    free((void *)P->name);
+    free((void *)P->str);
+    free(P->r);
+    free(P->st);
+    memset(P, 0, sizeof(*P));
+}
+
+/* Value of a variable after vm_run, as a double */
+static inline double vm_get(const VmProg *P, int slot)
+{
+    return P->type[slot] == VM_T_INT ? (double)P->r[slot].i : P->r[slot].f;
+}
+
+/* ---------- Lowering ---------- */
+
+#define IR_F_ASSIGNED 1
+#define IR_F_COUNTER 2
+#define IR_F_REALUSE 4 /* read where a real is wanted */
+
+typedef struct
+{
+    VmProg *P;
+    IrLang lang;
+    uint8_t *lb; /* per variable: state proven at this point of the code */
+    int nvar;
+    uint8_t *flag; /* per variable: IR_F_* */
+    int capflag;
+    IrStmt **dos; /* DO loops, for REAL-mode counter typing */
+    int ndo, capdo;
+    int *tmp; /* temporary pool: tmp[0 .. used) are live */
+    int ntmp, captmp, used;
+} IrLower;
+
+static inline int ir_is_rel(int op)
+{
+    return op == '<' || op == '>' || op == IR_LE || op == IR_GE || op == IR_EQ || op == IR_NE;
+}
+static inline int ir_is_bool(const IrExpr *e)
+{
+    return (e->kind == IR_BIN && (ir_is_rel(e->op) || e->op == IR_AND || e->op == IR_OR)) ||
+           (e->kind == IR_UN && e->op == '!');
+}
+
+static inline int ir_truth(const IrLower *L, const IrExpr *e)
+{
+    return L->lang.mode == VM_MODE_INT ? e->v.i != 0 : e->v.f != 0.0;
+}
+
+static inline int ir_rel_holds(int op, double x, double y)
+{
+    switch (op)
+    {
+    case '<':
+        return x < y;
+    case '>':
+        return x > y;
+    case IR_LE:
+        return x <= y;
+    case IR_GE:
+        return x >= y;
+    case IR_EQ:
+        return x == y;
+    default:
+        return x != y;
+    }
+}
+static inline int ir_rel_holds_i(int op, VM_INT x, VM_INT y)
+{
+    switch (op)
+    {
+    case '<':
+        return x < y;
+    case '>':
+        return x > y;
+    case IR_LE:
+        return x <= y;
+    case IR_GE:
+        return x >= y;
+    case IR_EQ:
+        return x == y;
+    default:
+        return x != y;
+    }
+}
+
+/* Fold e in place when its operands are constants. Anything that would trap
+   (division by zero) is left for run time so the error still happens there. */
+static inline void ir_fold(IrLower *L, IrExpr *e)
+{
+    int real = L->lang.mode == VM_MODE_REAL;
+    if (e->kind == IR_UN)
+    {
+        if (e->a->kind != IR_CONST)
+            return;
+        VmVal a = e->a->v, r = a;
+        if (e->op == '-')
+        {
+            if (real)
+                r.f = -a.f;
+            else
+                r.i = (VM_INT)(0 - (VM_UINT)a.i);
+        }
+        else if (e->op == '!')
+        {
+            if (real)
+                r.f = (a.f == 0.0);
+            else
+                r.i = (a.i == 0);
+        }
+        else if (e->op != '+')
+            return;
+        e->kind = IR_CONST;
+        e->v = r;
+        return;
+    }
+    if (e->kind != IR_BIN || e->a->kind != IR_CONST)
+        return;
+    /* short-circuit: the right operand is never evaluated */
+    if ((e->op == IR_AND && !ir_truth(L, e->a)) || (e->op == IR_OR && ir_truth(L, e->a)))
+    {
+        e->kind = IR_CONST;
+        if (real)
+            e->v.f = e->op == IR_OR;
+        else
+            e->v.i = e->op == IR_OR;
+        return;
+    }
+    if (e->b->kind != IR_CONST)
+        return;
+    VmVal a = e->a->v, b = e->b->v, r;
+    if (real)
+    {
+        double x = a.f, y = b.f;
+        switch (e->op)
+        {
+        case '+':
+            r.f = x + y;
+            break;
+        case '-':
+            r.f = x - y;
+            break;
+        case '*':
+            r.f = x * y;
+            break;
+        case '/':
+            if (y == 0)
+                return;
+            r.f = x / y;
+            break;
+        case '^':
+            r.f = pow(x, y);
+            break;
+        case IR_AND:
+            r.f = (x != 0.0 && y != 0.0);
+            break;
+        case IR_OR:
+            r.f = (x != 0.0 || y != 0.0);
+            break;
+        default:
+            if (!ir_is_rel(e->op))
+                return;
+            r.f = ir_rel_holds(e->op, x, y);
+            break;
+        }
+    }
+    else
+    {
+        VM_INT x = a.i, y = b.i;
+        memset(&r, 0, sizeof(r));
+        switch (e->op)
+        {
+        case '+':
+            r.i = (VM_INT)((VM_UINT)x + (VM_UINT)y);
+            break;
+        case '-':
+            r.i = (VM_INT)((VM_UINT)x - (VM_UINT)y);
+            break;
+        case '*':
+            r.i = (VM_INT)((VM_UINT)x * (VM_UINT)y);
+            break;
+        case '/':
+            if (y == 0)
+                return;
+            r.i = y == -1 ? (VM_INT)(0 - (VM_UINT)x) : x / y;
+            break;
+        case '%':
+            if (y == 0)
+                return;
+            r.i = y == -1 ? 0 : x % y;
+            break;
+        case IR_AND:
+            r.i = (x != 0 && y != 0);
+            break;
+        case IR_OR:
+            r.i = (x != 0 || y != 0);
+            break;
+        default:
+            if (!ir_is_rel(e->op))
+                return;
+            r.i = ir_rel_holds_i(e->op, x, y);
+            break;
+        }
+    }
+    e->kind = IR_CONST;
+    e->v = r;
+}
+
+static inline void ir_flag(IrLower *L, int slot, int f)
+{
+    while (slot >= L->capflag)
+    {
+        int old = L->capflag;
+        L->capflag = L->capflag ? L->capflag * 2 : 64;
+        L->flag = (uint8_t *)realloc(L->flag, (size_t)L->capflag);
+        memset(L->flag + old, 0, (size_t)(L->capflag - old));
+    }
+    L->flag[slot] |= (uint8_t)f;
+}
+
+/* Pass 1: fold constants bottom-up, give every variable its slot */
+static inline void ir_prep_expr(IrLower *L, IrExpr *e)
+{
+    if (!e)
+        return;
+    if (e->kind == IR_VAR)
+    {
+        e->slot = vm_var(L->P, e->name);
+        ir_flag(L, e->slot, 0);
+        return;
+    }
+    ir_prep_expr(L, e->a);
+    ir_prep_expr(L, e->b);
+    ir_fold(L, e);
+}
+
+static inline void ir_prep_stmt(IrLower *L, IrStmt *s)
+{
+    if (!s)
+        return;
+    switch (s->kind)
+    {
+    case IS_BLOCK:
+        for (int i = 0; i < s->n; i++)
+            ir_prep_stmt(L, (IrStmt *)s->list[i]);
+        return;
+    case IS_PRINT:
+        for (int i = 0; i < s->n; i++)
+            ir_prep_expr(L, (IrExpr *)s->list[i]);
+        return;
+    case IS_DECL:
+    case IS_ASSIGN:
+    case IS_DO:
+        s->slot = vm_var(L->P, s->name);
+        if (s->kind == IS_ASSIGN || (s->kind == IS_DECL && s->e))
+            ir_flag(L, s->slot, IR_F_ASSIGNED);
+        else if (s->kind == IS_DECL)
+            ir_flag(L, s->slot, 0);
+        else
+        {
+            ir_flag(L, s->slot, IR_F_COUNTER);
+            VM_GROW(L->dos, L->ndo, L->capdo, IrStmt *);
+            L->dos[L->ndo++] = s;
+        }
+        break;
+    default:
+        break;
+    }
+    ir_prep_expr(L, s->e);
+    ir_prep_expr(L, s->e2);
+    ir_prep_expr(L, s->e3);
+    ir_prep_stmt(L, s->body);
+    ir_prep_stmt(L, s->alt);
+}
+
+/* Type of e under the current variable types (see the header comment) */
+static inline int ir_typeof(IrLower *L, IrExpr *e)
+{
+    int t = VM_T_INT;
+    if (L->lang.mode == VM_MODE_INT)
+        t = VM_T_INT;
+    else if (e->kind == IR_CONST)
+    {
+        double v = e->v.f;
+        t = (v == floor(v) && fabs(v) <= 9007199254740992.0 && !(v == 0 && signbit(v))) ? VM_T_INT : VM_T_REAL;
+    }
+    else if (e->kind == IR_VAR)
+        t = L->P->type[e->slot];
+    else if (e->kind == IR_STR)
+        t = VM_T_REAL;
+    else if (ir_is_bool(e))
+    {
+        ir_typeof(L, e->a);
+        if (e->b)
+            ir_typeof(L, e->b);
+        t = VM_T_INT;
+    }
+    else if (e->kind == IR_UN)
+    {
+        int ta = ir_typeof(L, e->a);
+        t = e->op == '+' ? ta : VM_T_REAL;
+    }
+    else
+    {
+        int ta = ir_typeof(L, e->a), tb = ir_typeof(L, e->b);
+        t = ((e->op == '+' || e->op == '-') && ta == VM_T_INT && tb == VM_T_INT) ? VM_T_INT : VM_T_REAL;
+    }
+    e->type = t;
+    return t;
+}
+
+static inline void ir_type_stmt(IrLower *L, IrStmt *s)
+{
+    if (!s)
+        return;
+    if (s->kind == IS_BLOCK || s->kind == IS_PRINT)
+    {
+        for (int i = 0; i < s->n; i++)
+            if (s->kind == IS_BLOCK)
+                ir_type_stmt(L, (IrStmt *)s->list[i]);
+            else
+                ir_typeof(L, (IrExpr *)s->list[i]);
+        return;
+    }
+    if (s->e)
+        ir_typeof(L, s->e);
+    if (s->e2)
+        ir_typeof(L, s->e2);
+    if (s->e3)
+        ir_typeof(L, s->e3);
+    ir_type_stmt(L, s->body);
+    ir_type_stmt(L, s->alt);
+}
+
+/* Mark int variables that e reads where its context wants a real */
+static inline void ir_use_expr(IrLower *L, const IrExpr *e, int ctx)
+{
+    if (e->kind == IR_VAR && ctx == VM_T_REAL && L->P->type[e->slot] == VM_T_INT)
+        L->flag[e->slot] |= IR_F_REALUSE;
+    if (e->kind != IR_UN && e->kind != IR_BIN)
+        return;
+    if (e->kind == IR_BIN && ir_is_rel(e->op))
+        ctx = (e->a->type == VM_T_INT && e->b->type == VM_T_INT) ? VM_T_INT : VM_T_REAL;
+    else if (ir_is_bool(e))
+        ctx = -1; /* truth test, in the operand's own type */
+    else if (!(e->kind == IR_UN && e->op == '+'))
+        ctx = e->type;
+    ir_use_expr(L, e->a, ctx < 0 ? e->a->type : ctx);
+    if (e->b)
+        ir_use_expr(L, e->b, ctx < 0 ? e->b->type : ctx);
+}
+
+static inline void ir_use_stmt(IrLower *L, const IrStmt *s)
+{
+    if (!s)
+        return;
+    int t = s->kind == IS_DECL || s->kind == IS_ASSIGN || s->kind == IS_DO ? L->P->type[s->slot] : -1;
+    for (int i = 0; i < s->n; i++)
+        if (s->kind == IS_BLOCK)
+            ir_use_stmt(L, (const IrStmt *)s->list[i]);
+        else
+            ir_use_expr(L, (const IrExpr *)s->list[i], VM_T_REAL);
+    if (s->e)
+        ir_use_expr(L, s->e, t < 0 ? s->e->type : t);
+    if (s->e2)
+        ir_use_expr(L, s->e2, t);
+    if (s->e3)
+        ir_use_expr(L, s->e3, t);
+    ir_use_stmt(L, s->body);
+    ir_use_stmt(L, s->alt);
+}
+
+/* Variable types. REAL mode: a DO counter that is never assigned is an int
+   unless some DO over it has a real bound, or it is read where a real is
+   wanted (a real counter saves converting it on every use). Either can turn
+   another counter real, so iterate until nothing changes. */
+static inline void ir_type_vars(IrLower *L, IrStmt *prog)
+{
+    if (L->lang.mode == VM_MODE_INT)
+        return;
+    for (int s = 0; s < L->nvar; s++)
+        L->P->type[s] = L->flag[s] == IR_F_COUNTER ? VM_T_INT : VM_T_REAL;
+    for (int changed = 1; changed;)
+    {
+        changed = 0;
+        for (int d = 0; d < L->ndo; d++)
+        {
+            IrStmt *s = L->dos[d];
+            if (L->P->type[s->slot] == VM_T_INT &&
+                (ir_typeof(L, s->e) != VM_T_INT || ir_typeof(L, s->e2) != VM_T_INT ||
+                 ir_typeof(L, s->e3) != VM_T_INT))
+            {
+                L->P->type[s->slot] = VM_T_REAL;
+                changed = 1;
+            }
+        }
+        if (changed)
+            continue;
+        ir_type_stmt(L, prog);
+        ir_use_stmt(L, prog);
+        for (int v = 0; v < L->nvar; v++)
+            if (L->P->type[v] == VM_T_INT && (L->flag[v] & IR_F_REALUSE))
+            {
+                L->P->type[v] = VM_T_REAL;
+                changed = 1;
+            }
+    }
+}
+
+/* Temporaries are reused stack-wise: ir_mark() before an expression,
+   ir_release() after it */
+static inline int ir_tmp(IrLower *L)
+{
+    if (L->used == L->ntmp)
+    {
+        VM_GROW(L->tmp, L->ntmp, L->captmp, int);
+        L->tmp[L->ntmp++] = vm_slot_new(L->P, VM_K_TEMP, VM_T_INT);
+    }
+    return L->tmp[L->used++];
+}
+#define ir_mark(L) ((L)->used)
+#define ir_release(L, m) ((L)->used = (m))
+
+/* Pending jumps are chained through their c field until patched */
+static inline void ir_jump(IrLower *L, int op, int a, int b, int *list)
+{
+    *list = vm_emit(L->P, op, a, b, *list < 0 ? VM_NO_JUMP : *list);
+}
+static inline void ir_patch(IrLower *L, int list, int target)
+{
+    while (list >= 0)
+    {
+        VmIns *i = &L->P->code[list];
+        list = i->c == VM_NO_JUMP ? -1 : i->c;
+        i->c = (uint16_t)target;
+    }
+}
+
+static inline uint8_t *ir_lb_save(IrLower *L)
+{
+    uint8_t *c = (uint8_t *)malloc((size_t)L->nvar + 1);
+    memcpy(c, L->lb, (size_t)L->nvar);
+    return c;
+}
+/* Merge of two paths: what is proven on both */
+static inline void ir_lb_meet(IrLower *L, const uint8_t *other)
+{
+    for (int s = 0; s < L->nvar; s++)
+        if (other[s] < L->lb[s])
+            L->lb[s] = other[s];
+}
+
+static inline int ir_const_as(IrLower *L, const IrExpr *e, int ty)
+{
+    VM_INT i = L->lang.mode == VM_MODE_REAL ? (VM_INT)e->v.f : e->v.i;
+    double f = L->lang.mode == VM_MODE_REAL ? e->v.f : (double)e->v.i;
+    return ty == VM_T_INT ? vm_const_i(L->P, i) : vm_const_f(L->P, f);
+}
+
+/* Move a value of type 'from' in slot s to type ty, into dest if >= 0 */
+static inline int ir_to(IrLower *L, int s, int from, int ty, int dest)
+{
+    if (from != ty)
+    {
+        int d = dest >= 0 ? dest : ir_tmp(L);
+        vm_emit(L->P, VM_I2F, d, s, 0);
+        return d;
+    }
+    if (dest >= 0 && dest != s)
+    {
+        vm_emit(L->P, VM_MOV, dest, s, 0);
+        return dest;
+    }
+    return s;
+}
+
+static inline int ir_rel_op(int op, int type, int sense)
+{
+    static const int rel[] = {'<', IR_LE, '>', IR_GE, IR_EQ, IR_NE};
+    static const int neg_i[] = {VM_JGEI, VM_JGTI, VM_JLEI, VM_JLTI, VM_JNEI, VM_JEQI};
+    static const int neg_f[] = {VM_JNLTF, VM_JNLEF, VM_JNGTF, VM_JNGEF, VM_JNEF, VM_JEQF};
+    static const int pos_i[] = {VM_JLTI, VM_JLEI, VM_JGTI, VM_JGEI, VM_JEQI, VM_JNEI};
+    static const int pos_f[] = {VM_JLTF, VM_JLEF, VM_JGTF, VM_JGEF, VM_JEQF, VM_JNEF};
+    int k = 0;
+    while (rel[k] != op)
+        k++;
+    if (sense)
+        return type == VM_T_INT ? pos_i[k] : pos_f[k];
+    return type == VM_T_INT ? neg_i[k] : neg_f[k];
+}
+
+static inline int ir_expr(IrLower *L, IrExpr *e, int ty, int dest);
+
+/* Jump to *list when the truth of e equals sense; fall through otherwise */
+static inline void ir_cond(IrLower *L, IrExpr *e, int sense, int *list)
+{
+    if (e->kind == IR_CONST)
+    {
+        if (ir_truth(L, e) == sense)
+            ir_jump(L, VM_JMP, 0, 0, list);
+        return;
+    }
+    if (e->kind == IR_UN && (e->op == '!' || e->op == '+'))
+    {
+        ir_cond(L, e->a, e->op == '!' ? !sense : sense, list);
+        return;
+    }
+    if (e->kind == IR_BIN && ir_is_rel(e->op))
+    {
+        int t = (e->a->type == VM_T_INT && e->b->type == VM_T_INT) ? VM_T_INT : VM_T_REAL;
+        int m = ir_mark(L);
+        int ra = ir_expr(L, e->a, t, -1);
+        int rb = ir_expr(L, e->b, t, -1);
+        ir_release(L, m);
+        ir_jump(L, ir_rel_op(e->op, t, sense), ra, rb, list);
+        return;
+    }
+    if (e->kind == IR_BIN && (e->op == IR_AND || e->op == IR_OR))
+    {
+        /* the right operand runs conditionally: what it proves does not last */
+        int both = (e->op == IR_AND) != sense, skip = -1;
+        ir_cond(L, e->a, e->op == IR_OR, both ? list : &skip);
+        uint8_t *lb = ir_lb_save(L);
+        ir_cond(L, e->b, sense, list);
+        memcpy(L->lb, lb, (size_t)L->nvar);
+        free(lb);
+        ir_patch(L, skip, L->P->ncode);
+        return;
+    }
+    int m = ir_mark(L);
+    int r = ir_expr(L, e, e->type, -1);
+    ir_release(L, m);
+    if (e->type == VM_T_INT)
+        ir_jump(L, sense ? VM_JNZI : VM_JZI, r, 0, list);
+    else
+        ir_jump(L, sense ? VM_JNZF : VM_JZF, r, 0, list);
+}
+
+/* Evaluate e as type ty. Returns the slot holding the result: dest when
+   dest >= 0. Only the last instruction writes dest, so "x = f(x)" can
+   target x directly. */
+static inline int ir_expr(IrLower *L, IrExpr *e, int ty, int dest)
+{
+    VmProg *P = L->P;
+    switch (e->kind)
+    {
+    case IR_CONST:
+        return ir_to(L, ir_const_as(L, e, ty), ty, ty, dest);
+    case IR_VAR:
+        if (L->lb[e->slot] != VM_S_SET)
+        {
+            vm_emit(P, VM_CHKRD, e->slot, 0, 0);
+            L->lb[e->slot] = VM_S_SET; /* past the check, it is */
+        }
+        return ir_to(L, e->slot, P->type[e->slot], ty, dest);
+    case IR_STR:
+        vm_emit(P, VM_TRAP, 0, VM_E_STR, 0);
+        return ir_to(L, ty == VM_T_INT ? vm_const_i(P, 0) : vm_const_f(P, 0), ty, ty, dest);
+    default:
+        break;
+    }
+    if (e->kind == IR_UN && e->op == '+')
+        return ir_expr(L, e->a, ty, dest);
+    if (ir_is_bool(e))
+    {
+        int m = ir_mark(L), f = -1, j = -1;
+        ir_cond(L, e, 0, &f);
+        ir_release(L, m);
+        int d = dest >= 0 ? dest : ir_tmp(L);
+        vm_emit(P, VM_MOV, d, ty == VM_T_INT ? vm_const_i(P, 1) : vm_const_f(P, 1), 0);
+        ir_jump(L, VM_JMP, 0, 0, &j);
+        ir_patch(L, f, P->ncode);
+        vm_emit(P, VM_MOV, d, ty == VM_T_INT ? vm_const_i(P, 0) : vm_const_f(P, 0), 0);
+        ir_patch(L, j, P->ncode);
+        return d;
+    }
+
+    int t = e->type, op;
+    int m = ir_mark(L);
+    int ra = ir_expr(L, e->a, t, -1);
+    int rb = e->b ? ir_expr(L, e->b, t, -1) : 0;
+    ir_release(L, m);
+    switch (e->kind == IR_UN ? 0 : e->op)
+    {
+    case '+':
+        op = t == VM_T_INT ? VM_ADDI : VM_ADDF;
+        break;
+    case '-':
+        op = t == VM_T_INT ? VM_SUBI : VM_SUBF;
+        break;
+    case '*':
+        op = t == VM_T_INT ? VM_MULI : VM_MULF;
+        break;
+    case '/':
+        op = t == VM_T_INT ? VM_DIVI : VM_DIVF;
+        break;
+    case '%':
+        op = VM_MODI;
+        break;
+    case '^':
+        op = VM_POWF;
+        break;
+    default: /* unary minus */
+        op = t == VM_T_INT ? VM_NEGI : VM_NEGF;
+        break;
+    }
+    int d = (dest >= 0 && ty == t) ? dest : ir_tmp(L);
+    vm_emit(P, op, d, ra, rb);
+    return ir_to(L, d, t, ty, dest);
+}
+
+static inline void ir_stmt(IrLower *L, IrStmt *s);
+
+/* Declare/check v ahead of a store to it */
+static inline void ir_before_store(IrLower *L, int v)
+{
+    if (L->lb[v] != VM_S_NONE)
+        return;
+    if (L->lang.strict_decl)
+        vm_emit(L->P, VM_CHKWR, v, 0, 0);
+    else
+        vm_emit(L->P, VM_DECL, v, 0, 0);
+    L->lb[v] = VM_S_DECL;
+}
+static inline void ir_after_store(IrLower *L, int v)
+{
+    if (L->lb[v] != VM_S_SET)
+        vm_emit(L->P, VM_DEF, v, 0, 0);
+    L->lb[v] = VM_S_SET;
+}
+
+static inline void ir_stmt(IrLower *L, IrStmt *s)
+{
+    VmProg *P = L->P;
+    int m = ir_mark(L);
+    switch (s->kind)
+    {
+    case IS_BLOCK:
+        for (int i = 0; i < s->n; i++)
+            ir_stmt(L, (IrStmt *)s->list[i]);
+        break;
+    case IS_DECL:
+        if (L->lang.strict_decl || L->lb[s->slot] == VM_S_NONE)
+            vm_emit(P, VM_DECL, s->slot, L->lang.strict_decl, 0);
+        if (L->lb[s->slot] == VM_S_NONE)
+            L->lb[s->slot] = VM_S_DECL;
+        if (s->e)
+        {
+            ir_expr(L, s->e, P->type[s->slot], s->slot);
+            ir_after_store(L, s->slot);
+        }
+        break;
+    case IS_ASSIGN:
+        ir_before_store(L, s->slot);
+        ir_expr(L, s->e, P->type[s->slot], s->slot);
+        ir_after_store(L, s->slot);
+        break;
+    case IS_PRINT:
+        for (int i = 0; i < s->n; i++)
+        {
+            IrExpr *e = (IrExpr *)s->list[i];
+            if (i)
+                vm_emit(P, VM_PUTC, 0, ' ', 0);
+            if (e->kind == IR_STR)
+            {
+                VM_GROW(P->str, P->nstr, P->capstr, const char *);
+                P->str[P->nstr] = e->name;
+                vm_emit(P, VM_PUTS, 0, P->nstr++, 0);
+                continue;
+            }
+            int mi = ir_mark(L);
+            if (L->lang.mode == VM_MODE_INT)
+                vm_emit(P, VM_PUTI, ir_expr(L, e, VM_T_INT, -1), 0, 0);
+            else
+                vm_emit(P, VM_PUTF, ir_expr(L, e, VM_T_REAL, -1), 0, 0);
+            ir_release(L, mi);
+        }
+        vm_emit(P, VM_PUTC, 0, '\n', 0);
+        break;
+    case IS_IF:
+    {
+        if (s->e->kind == IR_CONST)
+        {
+            IrStmt *taken = ir_truth(L, s->e) ? s->body : s->alt;
+            if (taken)
+                ir_stmt(L, taken);
+            break;
+        }
+        int f = -1;
+        ir_cond(L, s->e, 0, &f);
+        uint8_t *before = ir_lb_save(L);
+        ir_stmt(L, s->body);
+        if (s->alt)
+        {
+            int j = -1;
+            ir_jump(L, VM_JMP, 0, 0, &j);
+            uint8_t *after_then = ir_lb_save(L);
+            memcpy(L->lb, before, (size_t)L->nvar);
+            ir_patch(L, f, P->ncode);
+            ir_stmt(L, s->alt);
+            ir_lb_meet(L, after_then);
+            ir_patch(L, j, P->ncode);
+            free(after_then);
+        }
+        else
+        {
+            ir_patch(L, f, P->ncode);
+            memcpy(L->lb, before, (size_t)L->nvar);
+        }
+        free(before);
+        break;
+    }
+    case IS_WHILE:
+    {
+        /* test at the top once, then at the bottom of each iteration */
+        int f = -1, t = -1;
+        ir_cond(L, s->e, 0, &f);
+        uint8_t *before = ir_lb_save(L);
+        int top = P->ncode;
+        ir_stmt(L, s->body);
+        ir_cond(L, s->e, 1, &t);
+        ir_patch(L, t, top);
+        ir_patch(L, f, P->ncode);
+        memcpy(L->lb, before, (size_t)L->nvar);
+        free(before);
+        break;
+    }
+    case IS_DO:
+    {
+        /* start, limit and step are evaluated once, before the counter is set;
+           limit and step get two adjacent slots of their own */
+        int v = s->slot, t = P->type[v];
+        ir_before_store(L, v);
+        int rs = ir_expr(L, s->e, t, -1);
+        int lim = vm_slot_new(P, VM_K_TEMP, t);
+        vm_slot_new(P, VM_K_TEMP, t);
+        ir_expr(L, s->e2, t, lim);
+        ir_expr(L, s->e3, t, lim + 1);
+        ir_to(L, rs, t, t, v);
+        ir_after_store(L, v);
+        int exit = -1;
+        ir_jump(L, t == VM_T_INT ? VM_FORPREPI : VM_FORPREPF, v, lim, &exit);
+        uint8_t *before = ir_lb_save(L);
+        ir_release(L, m);
+        int top = P->ncode;
+        ir_stmt(L, s->body);
+        vm_emit(P, t == VM_T_INT ? VM_FORLOOPI : VM_FORLOOPF, v, lim, top);
+        ir_patch(L, exit, P->ncode);
+        memcpy(L->lb, before, (size_t)L->nvar);
+        free(before);
+        break;
+    }
+    }
+    ir_release(L, m);
+}
+
+/* Lower prog into P. Returns 0, or -1 if it does not fit the 16-bit
+   operand encoding. */
+static inline int ir_compile(VmProg *P, IrLang lang, IrStmt *prog)
+{
+    IrLower L;
+    memset(&L, 0, sizeof(L));
+    memset(P, 0, sizeof(*P));
+    P->mode = lang.mode;
+    L.P = P;
+    L.lang = lang;
+    ir_prep_stmt(&L, prog);
+    L.nvar = P->nslot; /* variables take the first slots */
+    ir_flag(&L, L.nvar, 0);
+    ir_type_vars(&L, prog);
+    ir_type_stmt(&L, prog);
+    L.lb = (uint8_t *)calloc((size_t)L.nvar + 1, 1);
+    ir_stmt(&L, prog);
+    vm_emit(P, VM_HALT, 0, 0, 0);
+    free(L.lb);
+    free(L.flag);
+    free(L.dos);
+    free(L.tmp);
+    return P->too_big ? -1 : 0;
+}
+
+/* ---------- VM ---------- */
+
+static inline int vm_run(VmProg *P)
+{
+    free(P->r);
+    free(P->st);
+    P->r = (VmVal *)malloc((size_t)(P->nslot + 1) * sizeof(VmVal));
+    P->st = (uint8_t *)malloc((size_t)P->nslot + 1);
+    memcpy(P->r, P->init, (size_t)P->nslot * sizeof(VmVal));
+    for (int s = 0; s < P->nslot; s++)
+        P->st[s] = P->kind[s] == VM_K_VAR ? VM_S_NONE : VM_S_SET;
+    P->err = VM_OK;
+    P->err_slot = -1;
+
+    VmVal *r = P->r;
+    uint8_t *st = P->st;
+    const VmIns *code = P->code, *pc = code, *i;
+
+#define VM_FAIL(e, s)         \
+    do                        \
+    {                         \
+        P->err = (e);         \
+        P->err_slot = (s);    \
+        return (e);           \
+    } while (0)
+#define RA r[i->a]
+#define RB r[i->b]
+#define RC r[i->c]
+#ifdef __GNUC__
+#define VM_LABEL(o, sig) &&L_##o,
+    static const void *const labels[] = {VM_OPCODES(VM_LABEL)};
+#define VM_CASE(o) L_##o
+#define VM_NEXT() goto *labels[ONCHIP_OP((i = pc++)->op)]
+#else
+#define VM_CASE(o) case VM_##o
+#define VM_NEXT() goto dispatch
+#endif
+#define VM_ARITH(o, fld, expr) \
+    VM_CASE(o) : RA.fld = (expr); \
+    VM_NEXT();
+#define VM_JREL(o, fld, cmp)          \
+    VM_CASE(o) : if (cmp(RA.fld, RB.fld)) \
+        pc = code + i->c;             \
+    VM_NEXT();
+#define VM_LT(x, y) ((x) < (y))
+#define VM_LE(x, y) ((x) <= (y))
+#define VM_GT(x, y) ((x) > (y))
+#define VM_GE(x, y) ((x) >= (y))
+#define VM_EQ(x, y) ((x) == (y))
+#define VM_NE(x, y) ((x) != (y))
+#define VM_NLT(x, y) (!((x) < (y)))
+#define VM_NLE(x, y) (!((x) <= (y)))
+#define VM_NGT(x, y) (!((x) > (y)))
+#define VM_NGE(x, y) (!((x) >= (y)))
+#define VM_WRAP(x, o, y) ((VM_INT)((VM_UINT)(x)o(VM_UINT)(y)))
+#define VM_IN_LIMIT(v, lim, step) ((step) > 0 ? (v) <= (lim) : (v) >= (lim))
+
+    VM_NEXT();
+#ifndef __GNUC__
+dispatch:
+    i = pc++;
+    switch (ONCHIP_OP(i->op))
+#endif
+    {
+    VM_CASE(HALT):
+        return VM_OK;
+    VM_CASE(MOV):
+        RA = RB;
+        VM_NEXT();
+        VM_ARITH(I2F, f, (double)RB.i)
+        VM_ARITH(ADDI, i, VM_WRAP(RB.i, +, RC.i))
+        VM_ARITH(SUBI, i, VM_WRAP(RB.i, -, RC.i))
+        VM_ARITH(MULI, i, VM_WRAP(RB.i, *, RC.i))
+    VM_CASE(DIVI):
+        if (RC.i == 0)
+            VM_FAIL(VM_E_DIV0, -1);
+        RA.i = RC.i == -1 ? VM_WRAP(0, -, RB.i) : RB.i / RC.i;
+        VM_NEXT();
+    VM_CASE(MODI):
+        if (RC.i == 0)
+            VM_FAIL(VM_E_MOD0, -1);
+        RA.i = RC.i == -1 ? 0 : RB.i % RC.i;
+        VM_NEXT();
+        VM_ARITH(NEGI, i, VM_WRAP(0, -, RB.i))
+        VM_ARITH(ADDF, f, RB.f + RC.f)
+        VM_ARITH(SUBF, f, RB.f - RC.f)
+        VM_ARITH(MULF, f, RB.f * RC.f)
+    VM_CASE(DIVF):
+        if (RC.f == 0)
+            VM_FAIL(VM_E_DIV0, -1);
+        RA.f = RB.f / RC.f;
+        VM_NEXT();
+        VM_ARITH(POWF, f, pow(RB.f, RC.f))
+        VM_ARITH(NEGF, f, -RB.f)
+    VM_CASE(JMP):
+        pc = code + i->c;
+        VM_NEXT();
+    VM_CASE(JZI):
+        if (RA.i == 0)
+            pc = code + i->c;
+        VM_NEXT();
+    VM_CASE(JNZI):
+        if (RA.i != 0)
+            pc = code + i->c;
+        VM_NEXT();
+    VM_CASE(JZF):
+        if (RA.f == 0.0)
+            pc = code + i->c;
+        VM_NEXT();
+    VM_CASE(JNZF):
+        if (RA.f != 0.0)
+            pc = code + i->c;
+        VM_NEXT();
+        VM_JREL(JLTI, i, VM_LT)
+        VM_JREL(JLEI, i, VM_LE)
+        VM_JREL(JGTI, i, VM_GT)
+        VM_JREL(JGEI, i, VM_GE)
+        VM_JREL(JEQI, i, VM_EQ)
+        VM_JREL(JNEI, i, VM_NE)
+        VM_JREL(JLTF, f, VM_LT)
+        VM_JREL(JLEF, f, VM_LE)
+        VM_JREL(JGTF, f, VM_GT)
+        VM_JREL(JGEF, f, VM_GE)
+        VM_JREL(JEQF, f, VM_EQ)
+        VM_JREL(JNEF, f, VM_NE)
+        VM_JREL(JNLTF, f, VM_NLT)
+        VM_JREL(JNLEF, f, VM_NLE)
+        VM_JREL(JNGTF, f, VM_NGT)
+        VM_JREL(JNGEF, f, VM_NGE)
+    VM_CASE(FORPREPI):
+        if (r[i->b + 1].i == 0)
+            VM_FAIL(VM_E_STEP0, i->a);
+        if (!VM_IN_LIMIT(RA.i, RB.i, r[i->b + 1].i))
+            pc = code + i->c;
+        VM_NEXT();
+    VM_CASE(FORLOOPI):
+    {
+        VM_INT step = r[i->b + 1].i;
+        RA.i = VM_WRAP(RA.i, +, step);
+        if (VM_IN_LIMIT(RA.i, RB.i, step))
+            pc = code + i->c;
+        VM_NEXT();
+    }
+    VM_CASE(FORPREPF):
+        if (r[i->b + 1].f == 0)
+            VM_FAIL(VM_E_STEP0, i->a);
+        if (!VM_IN_LIMIT(RA.f, RB.f, r[i->b + 1].f))
+            pc = code + i->c;
+        VM_NEXT();
+    VM_CASE(FORLOOPF):
+    {
+        double step = r[i->b + 1].f;
+        RA.f += step;
+        if (VM_IN_LIMIT(RA.f, RB.f, step))
+            pc = code + i->c;
+        VM_NEXT();
+    }
+    VM_CASE(DECL):
+        if (st[i->a] != VM_S_NONE)
+        {
+            if (i->b)
+                VM_FAIL(VM_E_REDECL, i->a);
+        }
+        else
+            st[i->a] = VM_S_DECL;
+        VM_NEXT();
+    VM_CASE(CHKRD):
+        if (st[i->a] != VM_S_SET)
+            VM_FAIL(st[i->a] == VM_S_NONE ? VM_E_UNDEF : VM_E_UNINIT, i->a);
+        VM_NEXT();
+    VM_CASE(CHKWR):
+        if (st[i->a] == VM_S_NONE)
+            VM_FAIL(VM_E_UNDECL, i->a);
+        VM_NEXT();
+    VM_CASE(DEF):
+        st[i->a] = VM_S_SET;
+        VM_NEXT();
+    VM_CASE(PUTI):
+        printf("%lld", (long long)RA.i);
+        VM_NEXT();
+    VM_CASE(PUTF):
+        printf("%g", RA.f);
+        VM_NEXT();
+    VM_CASE(PUTS):
+        fputs(P->str[i->b], stdout);
+        VM_NEXT();
+    VM_CASE(PUTC):
+        putchar(i->b);
+        VM_NEXT();
+    VM_CASE(TRAP):
+        VM_FAIL(i->b, -1);
+#ifndef __GNUC__
+    default:
+        break;
+#endif
+    }
+    return VM_OK;
+
+#undef VM_FAIL
+#undef RA
+#undef RB
+#undef RC
+#undef VM_LABEL
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_ARITH
+#undef VM_JREL
+#undef VM_WRAP
+#undef VM_IN_LIMIT
+}
+
+/* ---------- Listing ---------- */
+
+static inline void vm_dis_slot(const VmProg *P, int s, FILE *out)
+{
+    if (P->kind[s] == VM_K_VAR)
+        fprintf(out, " %s", P->name[s]);
+    else if (P->kind[s] == VM_K_CONST && P->type[s] == VM_T_INT)
+        fprintf(out, " #%lld", (long long)P->init[s].i);
+    else if (P->kind[s] == VM_K_CONST)
+        fprintf(out, " #%g", P->init[s].f);
+    else
+        fprintf(out, " t%d", s);
+}
+
+static inline void vm_dis(const VmProg *P, FILE *out)
+{
+    int nvar = 0, nk = 0;
+    for (int s = 0; s < P->nslot; s++)
+    {
+        nvar += P->kind[s] == VM_K_VAR;
+        nk += P->kind[s] == VM_K_CONST;
+    }
+    fprintf(out, "%d instructions, %d slots (%d variables, %d constants)\n", P->ncode, P->nslot, nvar, nk);
+    for (int s = 0; s < P->nslot; s++)
+        if (P->kind[s] == VM_K_VAR)
+            fprintf(out, "  %-12s %s\n", P->name[s], P->type[s] == VM_T_INT ? "int" : "real");
+    for (int pc = 0; pc < P->ncode; pc++)
+    {
+        const VmIns *i = &P->code[pc];
+        const char *sig = vm_op_sigs[i->op];
+        const int opnd[3] = {i->a, i->b, i->c};
+        fprintf(out, "%5d  %-9s", pc, vm_op_names[i->op]);
+        for (int k = 0; k < 3; k++)
+        {
+            if (sig[k] == 's')
+                vm_dis_slot(P, opnd[k], out);
+            else if (sig[k] == 'j')
+                fprintf(out, " -> %d", opnd[k]);
+            else if (sig[k] == 'x' && i->op == VM_PUTS)
+                fprintf(out, " \"%s\"", P->str[opnd[k]]);
+            else if (sig[k] == 'x' && i->op == VM_PUTC)
+                fprintf(out, opnd[k] == '\n' ? " '\\n'" : " '%c'", opnd[k]);
+            else if (sig[k] == 'x')
+                fprintf(out, " %d", opnd[k]);
+        }
+        fputc('\n', out);
+    }
+}
+
+#endif /* ONCHIP_VM_H */
@@ -0,0 +1,331 @@
+/*
+ * inet_csum.h — the Internet checksum (RFC 1071) shared by the network tools
+ *
+ * What this provides
+ *  - csum_partial(): 64-bit accumulator kernel, with AVX2 / SSE2 / NEON variants
+ *    picked at compile time (-march=native etc.) and a portable one otherwise
+ *  - csum_copy(): copy a payload into the packet and sum it in the same pass
+ *  - Pseudo-header sums for UDP/TCP over IPv4
+ *  - RFC 1624 incremental updates: change a TTL, an ID, a port or an address
+ *    and patch the stored checksum instead of recomputing it
+ *
+ * Conventions
+ *  - Sums are of 16-bit words in memory order, so a folded result is already in
+ *    network byte order when stored with memcpy / a uint16_t field. The one's
+ *    complement sum does not care about byte order (RFC 1071 §2(B)).
+ *  - A "partial" sum is an unfolded uint64_t; chain them through the last
+ *    argument. Pieces after the first must start at an even offset in the
+ *    checksummed data, or be combined with csum_block_add().
+ *  - csum_fold() folds to 16 bits; inet_csum_finish() also complements: that is
+ *    the value to store. Verifying a whole header/segment including its stored
+ *    checksum gives 0 from inet_csum().
+ *
+ * Header only (static functions), so each tool stays a single-file build:
+ *   #include "inet_csum.h"
+ */
+
+#ifndef INET_CSUM_H
+#define INET_CSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define INET_CSUM_KERNEL "avx2"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define INET_CSUM_KERNEL "sse2"
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define INET_CSUM_KERNEL "neon"
+#else
+#define INET_CSUM_KERNEL "scalar"
+#endif
+
+/* =================== Folding =================== */
+static inline uint64_t csum_add(uint64_t a, uint64_t b)
+{
+    a += b;
+    return a + (a < b); /* end-around carry */
+}
+
+static inline uint16_t csum_fold(uint64_t sum)
+{
+    sum = (sum & 0xFFFFFFFFu) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFFu) + (sum >> 32);
+    sum = (sum & 0xFFFFu) + (sum >> 16);
+    sum = (sum & 0xFFFFu) + (sum >> 16);
+    sum = (sum & 0xFFFFu) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+static inline uint16_t inet_csum_finish(uint64_t sum) { return (uint16_t)~csum_fold(sum); }
+
+/* the last byte of odd-length data, as a memory-order word padded with zero */
+static inline uint64_t csum_tail_byte(const uint8_t *p)
+{
+    uint16_t w = 0;
+    memcpy(&w, p, 1);
+    return w;
+}
+
+/* =================== Kernels =================== */
+/* Portable: 64-bit loads with end-around carry, two independent chains. */
+static inline uint64_t csum_partial_scalar(const void *buf, size_t len, uint64_t sum)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    uint64_t s0 = sum, s1 = 0;
+    while (len >= 32)
+    {
+        uint64_t w[4];
+        memcpy(w, p, 32);
+        s0 = csum_add(s0, w[0]);
+        s1 = csum_add(s1, w[1]);
+        s0 = csum_add(s0, w[2]);
+        s1 = csum_add(s1, w[3]);
+        p += 32;
+        len -= 32;
+    }
+    while (len >= 8)
+    {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        s0 = csum_add(s0, w);
+        p += 8;
+        len -= 8;
+    }
+    if (len >= 4)
+    {
+        uint32_t w;
+        memcpy(&w, p, 4);
+        s1 = csum_add(s1, w);
+        p += 4;
+        len -= 4;
+    }
+    if (len >= 2)
+    {
+        uint16_t w;
+        memcpy(&w, p, 2);
+        s1 = csum_add(s1, w);
+        p += 2;
+        len -= 2;
+    }
+    if (len)
+        s1 = csum_add(s1, csum_tail_byte(p));
+    return csum_add(s0, s1);
+}
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON)
+/* 16-bit words widened to 32-bit lanes; lanes are drained to the 64-bit sum
+   before they could overflow (at most 2 x 0xFFFF per lane per step). Below
+   CSUM_SIMD_MIN bytes the drain costs more than the wide loads save. */
+#define CSUM_SIMD_DRAIN 16384
+#define CSUM_SIMD_MIN 256
+#endif
+
+#if defined(__AVX2__)
+static inline uint64_t csum_drain256(__m256i acc)
+{
+    uint32_t l[8];
+    _mm256_storeu_si256((__m256i *)l, acc);
+    return (uint64_t)l[0] + l[1] + l[2] + l[3] + l[4] + l[5] + l[6] + l[7];
+}
+
+static inline __m256i csum_step256(__m256i acc, __m256i v)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+    return _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+}
+
+static inline uint64_t csum_partial_simd(const void *buf, size_t len, uint64_t sum, void *dst)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    uint8_t *d = (uint8_t *)dst;
+    while (len >= 64)
+    {
+        __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+        for (size_t n = 0; len >= 64 && n < CSUM_SIMD_DRAIN; n++)
+        {
+            __m256i v0 = _mm256_loadu_si256((const __m256i *)p);
+            __m256i v1 = _mm256_loadu_si256((const __m256i *)(p + 32));
+            if (d)
+            {
+                _mm256_storeu_si256((__m256i *)d, v0);
+                _mm256_storeu_si256((__m256i *)(d + 32), v1);
+                d += 64;
+            }
+            a0 = csum_step256(a0, v0);
+            a1 = csum_step256(a1, v1);
+            p += 64;
+            len -= 64;
+        }
+        sum = csum_add(sum, csum_drain256(a0) + csum_drain256(a1));
+    }
+    if (d && len)
+        memcpy(d, p, len);
+    return csum_partial_scalar(p, len, sum);
+}
+#elif defined(__SSE2__)
+static inline uint64_t csum_drain128(__m128i acc)
+{
+    uint32_t l[4];
+    _mm_storeu_si128((__m128i *)l, acc);
+    return (uint64_t)l[0] + l[1] + l[2] + l[3];
+}
+
+static inline __m128i csum_step128(__m128i acc, __m128i v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+    return _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+}
+
+static inline uint64_t csum_partial_simd(const void *buf, size_t len, uint64_t sum, void *dst)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    uint8_t *d = (uint8_t *)dst;
+    while (len >= 32)
+    {
+        __m128i a0 = _mm_setzero_si128(), a1 = _mm_setzero_si128();
+        for (size_t n = 0; len >= 32 && n < CSUM_SIMD_DRAIN; n++)
+        {
+            __m128i v0 = _mm_loadu_si128((const __m128i *)p);
+            __m128i v1 = _mm_loadu_si128((const __m128i *)(p + 16));
+            if (d)
+            {
+                _mm_storeu_si128((__m128i *)d, v0);
+                _mm_storeu_si128((__m128i *)(d + 16), v1);
+                d += 32;
+            }
+            a0 = csum_step128(a0, v0);
+            a1 = csum_step128(a1, v1);
+            p += 32;
+            len -= 32;
+        }
+        sum = csum_add(sum, csum_drain128(a0) + csum_drain128(a1));
+    }
+    if (d && len)
+        memcpy(d, p, len);
+    return csum_partial_scalar(p, len, sum);
+}
+#elif defined(__ARM_NEON)
+static inline uint64_t csum_partial_simd(const void *buf, size_t len, uint64_t sum, void *dst)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    uint8_t *d = (uint8_t *)dst;
+    while (len >= 32)
+    {
+        uint32x4_t a0 = vdupq_n_u32(0), a1 = vdupq_n_u32(0);
+        for (size_t n = 0; len >= 32 && n < CSUM_SIMD_DRAIN; n++)
+        {
+            uint8x16_t v0 = vld1q_u8(p), v1 = vld1q_u8(p + 16);
+            if (d)
+            {
+                vst1q_u8(d, v0);
+                vst1q_u8(d + 16, v1);
+                d += 32;
+            }
+            a0 = vpadalq_u16(a0, vreinterpretq_u16_u8(v0));
+            a1 = vpadalq_u16(a1, vreinterpretq_u16_u8(v1));
+            p += 32;
+            len -= 32;
+        }
+        sum = csum_add(sum, vaddlvq_u32(a0) + vaddlvq_u32(a1));
+    }
+    if (d && len)
+        memcpy(d, p, len);
+    return csum_partial_scalar(p, len, sum);
+}
+#endif
+
+/* =================== API =================== */
+/* Sum len bytes at buf onto sum (unfolded). */
+static inline uint64_t csum_partial(const void *buf, size_t len, uint64_t sum)
+{
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON)
+    if (len >= CSUM_SIMD_MIN)
+        return csum_partial_simd(buf, len, sum, NULL);
+#endif
+    return csum_partial_scalar(buf, len, sum);
+}
+
+/* memcpy(dst, src, len) and return src summed onto sum, reading src once. */
+static inline uint64_t csum_copy(void *dst, const void *src, size_t len, uint64_t sum)
+{
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON)
+    if (len >= CSUM_SIMD_MIN)
+        return csum_partial_simd(src, len, sum, dst);
+#endif
+    memcpy(dst, src, len);
+    return csum_partial_scalar(dst, len, sum);
+}
+
+/* The checksum to store for len bytes (with the checksum field zeroed), or, over
+   data that includes its stored checksum, 0 when it is intact. */
+static inline uint16_t inet_csum(const void *buf, size_t len) { return inet_csum_finish(csum_partial(buf, len, 0)); }
+
+/* Add the partial sum of a block that starts at byte offset off in the data. */
+static inline uint64_t csum_block_add(uint64_t sum, uint64_t block, size_t off)
+{
+    if (off & 1)
+    {
+        uint16_t f = csum_fold(block);
+        block = (uint16_t)(f << 8 | f >> 8);
+    }
+    return csum_add(sum, block);
+}
+
+/* IPv4 pseudo-header for UDP/TCP: addresses in network order, length in host order. */
+static inline uint64_t csum_pseudo_ipv4(uint32_t saddr_be, uint32_t daddr_be, uint8_t proto, uint16_t len)
+{
+    uint8_t w[4] = {0, proto, (uint8_t)(len >> 8), (uint8_t)len};
+    uint32_t tail;
+    memcpy(&tail, w, 4);
+    return (uint64_t)saddr_be + daddr_be + tail;
+}
+
+/* =================== Incremental update (RFC 1624) =================== */
+/* HC' = ~(~HC + ~m + m'), eqn. 3: right for every value, unlike eqn. 2 (-0).
+   check is the stored checksum; the updated one is returned. The fields are
+   given as stored (network order) and must sit at an even offset. */
+static inline uint16_t csum_replace16(uint16_t check, uint16_t old, uint16_t new_)
+{
+    uint32_t sum = (uint32_t)(uint16_t)~check + (uint16_t)~old + new_;
+    sum = (sum & 0xFFFFu) + (sum >> 16);
+    sum = (sum & 0xFFFFu) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+/* a 32-bit field, e.g. an address */
+static inline uint16_t csum_replace32(uint16_t check, uint32_t old, uint32_t new_)
+{
+    uint64_t sum = (uint64_t)(uint16_t)~check + (uint16_t)~old + (uint16_t)~(old >> 16) + (new_ & 0xFFFFu) +
+                   (new_ >> 16);
+    return inet_csum_finish(sum);
+}
+
+/* n bytes (n even) changed from old to new */
+static inline uint16_t csum_replace(uint16_t check, const void *old, const void *new_, size_t n)
+{
+    uint64_t sum = (uint16_t)~check;
+    sum = csum_add(sum, (uint16_t)~csum_fold(csum_partial(old, n, 0)));
+    sum = csum_add(sum, csum_partial(new_, n, 0));
+    return inet_csum_finish(sum);
+}
+
+/* Store new_ into the 16-bit field and patch the checksum at check. Both are
+   plain pointers into the packet, so packed header structs work too. */
+static inline void csum_set16(void *check, void *field, uint16_t new_)
+{
+    uint16_t c, old;
+    memcpy(&c, check, 2);
+    memcpy(&old, field, 2);
+    memcpy(field, &new_, 2);
+    c = csum_replace16(c, old, new_);
+    memcpy(check, &c, 2);
+}
+
+#endif /* INET_CSUM_H */
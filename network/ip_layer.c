@@ -5,12 +5,12 @@
  *  - IPv4 header struct (no options) + parser/validator
  *  - Header checksum (RFC 791 / RFC 1071)
  *  - Packet builder for arbitrary protocol numbers
- *  - Simple fragmentation helper that emits fragments via a user callback
+ *  - Fragmentation helper that emits (header, payload slice) pairs via a user callback
+ *  - Fixed-memory reassembler (hole list, timeout wheel, flood-resistant eviction)
  *  - Optional demo main that crafts and sends a raw IPv4 packet (requires CAP_NET_RAW)
  *
  * Non-goals (kept small on purpose)
  *  - Full options support (IHL > 5) — parser rejects options by default
- *  - Reassembly cache (OS job); we only expose flags/offset
  *
  * Build (library):
  *   gcc -O2 -Wall -c ip_layer.c -o ip_layer.o
@@ -20,11 +20,14 @@
  *
  * Demo usage:
  *   sudo ./ip_demo send 127.0.0.1 253 "hello-ip"   # protocol 253 (experimental)
+ *   ./ip_demo bench 8000 1500 64 4                 # reassembly rate, 4 junk fragments per real one
  */
 
 #if 0
 gcc -O2 -Wall -DIP_DEMO_MAIN ip_layer.c -o ip_demo
 sudo ./ip_demo send 127.0.0.1 253 "hello-ip"
+./ip_demo bench 8000 1500 256
+./ip_demo bench 8000 1500 64 4
 #endif
 
 #define _GNU_SOURCE
@@ -40,8 +43,12 @@ sudo ./ip_demo send 127.0.0.1 253 "hello-ip"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "inet_csum.h"
+
 /* =================== IPv4 header (no options) =================== */
 #pragma pack(push, 1)
 typedef struct
@@ -66,21 +73,7 @@ typedef struct
 #define IPV4_FRAG_OFF_MASK 0x1FFF
 
 /* =================== Checksum =================== */
-static uint16_t ipv4_checksum(const void *hdr, size_t len)
-{
-    const uint16_t *w = (const uint16_t *)hdr;
-    uint32_t sum = 0;
-    while (len > 1)
-    {
-        sum += *w++;
-        len -= 2;
-    }
-    if (len)
-        sum += *(const uint8_t *)w;
-    while (sum >> 16)
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    return (uint16_t)~sum;
-}
+static uint16_t ipv4_checksum(const void *hdr, size_t len) { return inet_csum(hdr, len); }
 
 /* =================== Build header =================== */
 void ipv4_build_header(ipv4_hdr_t *ip,
@@ -158,12 +151,8 @@ bool ipv4_parse(const uint8_t *pkt, size_t len, ipv4_parsed_t *out)
     if (out->total_len < out->ihl || out->total_len > len)
         return false;
 
-    // validate header checksum
-    ipv4_hdr_t tmp;
-    memcpy(&tmp, ip, sizeof(tmp));
-    tmp.checksum = 0;
-    uint16_t cs = ipv4_checksum(&tmp, sizeof(tmp));
-    out->hdr_ok = (cs == ip->checksum);
+    // validate header checksum: summed with the stored checksum it folds to zero
+    out->hdr_ok = ipv4_checksum(ip, out->ihl) == 0;
 
     out->flags_off_be = ip->frag_off;
     return true;
@@ -171,20 +160,25 @@ bool ipv4_parse(const uint8_t *pkt, size_t len, ipv4_parsed_t *out)
 
 /* =================== Fragmentation =================== */
 /* Calls user callback once per fragment; callback should send/store the fragment.
- * Callback prototype: int (*emit)(const uint8_t *frag, size_t frag_len, void *user)
+ * The fragment is handed over as its header plus a slice of the caller's payload,
+ * so it can go out as a two-element iovec without copying the payload.
+ * Callback prototype: int (*emit)(const ipv4_hdr_t *hdr, const uint8_t *data, size_t data_len, void *user)
  * Returns number of fragments emitted, or -1 on error from callback.
  */
 int ipv4_fragment_and_emit(uint32_t saddr_be, uint32_t daddr_be,
                            uint8_t proto, uint8_t ttl, uint16_t id,
                            const uint8_t *payload, size_t payload_len,
                            size_t mtu,
-                           int (*emit)(const uint8_t *, size_t, void *), void *user)
+                           int (*emit)(const ipv4_hdr_t *, const uint8_t *, size_t, void *), void *user)
 {
     if (mtu < sizeof(ipv4_hdr_t) + 8)
         return -1;                                                    // sanity
     size_t max_payload_per_frag = ((mtu - sizeof(ipv4_hdr_t)) & ~7u); // multiple of 8 bytes
     size_t offset = 0;
     int count = 0;
+    // one header, checksummed once; per fragment only tot_len and frag_off change (RFC 1624)
+    ipv4_hdr_t base;
+    ipv4_build_header(&base, 0, saddr_be, daddr_be, id, ttl, proto, false);
     while (offset < payload_len)
     {
         size_t frag_payload = payload_len - offset;
@@ -195,28 +189,13 @@ int ipv4_fragment_and_emit(uint32_t saddr_be, uint32_t daddr_be,
             more = true;
         }
         size_t frag_len = sizeof(ipv4_hdr_t) + frag_payload;
-        uint8_t *buf = (uint8_t *)malloc(frag_len);
-        if (!buf)
-            return -1;
-        ipv4_hdr_t *ip = (ipv4_hdr_t *)buf;
-        memcpy(buf + sizeof(*ip), payload + offset, frag_payload);
-        ip->ver_ihl = (4u << 4) | 5u;
-        ip->tos = 0;
-        ip->tot_len = htons((uint16_t)frag_len);
-        ip->id = htons(id);
+        ipv4_hdr_t ip = base;
         uint16_t off_units = (uint16_t)(offset / 8u);
         uint16_t fo = (more ? IPV4_FLAG_MF : 0) | (off_units & IPV4_FRAG_OFF_MASK);
-        ip->frag_off = htons(fo);
-        ip->ttl = ttl ? ttl : 64;
-        ip->protocol = proto;
-        ip->checksum = 0;
-        ip->saddr = saddr_be;
-        ip->daddr = daddr_be;
-        ip->checksum = ipv4_checksum(ip, sizeof(*ip));
-
-        int rc = emit(buf, frag_len, user);
-        free(buf);
-        if (rc != 0)
+        csum_set16(&ip.checksum, &ip.tot_len, htons((uint16_t)frag_len));
+        csum_set16(&ip.checksum, &ip.frag_off, htons(fo));
+
+        if (emit(&ip, payload + offset, frag_payload, user) != 0)
             return -1;
         count++;
         offset += frag_payload;
@@ -224,19 +203,479 @@ int ipv4_fragment_and_emit(uint32_t saddr_be, uint32_t daddr_be,
     return count;
 }
 
+/* =================== Reassembly =================== */
+/*
+ * Fixed-memory IPv4 reassembler, keyed on (src, dst, proto, id).
+ *
+ * Every buffer is allocated by ipv4_reasm_create(); nothing is allocated per
+ * fragment. Each of the max_datagrams slots owns a small buffer, and a
+ * datagram that outgrows it moves to one of large_bufs 64 KiB buffers.
+ * Missing ranges are tracked as a hole-descriptor list (RFC 815) of at most
+ * IPV4_REASM_MAX_HOLES entries. Pending datagrams hang off a timeout wheel;
+ * when every slot is busy, datagrams with a single fragment in go first
+ * (reasm_evict), so a flood of never-completing fragments costs slots, never
+ * memory, and rarely a reassembly that was making progress.
+ * Overlapping fragments discard the datagram, exact duplicates are ignored.
+ */
+#define IPV4_REASM_MAX_HOLES 32
+#define IPV4_REASM_WHEEL 256        // timeout wheel slots (power of two)
+#define IPV4_REASM_HOLE_END 0xFFFFu // hole runs until the last fragment says otherwise
+#define IPV4_MAX_HDR 60
+#define IPV4_MAX_PAYLOAD (0xFFFF - sizeof(ipv4_hdr_t))
+
+typedef struct
+{
+    uint32_t max_datagrams; // concurrent reassemblies (default 1024)
+    uint32_t small_size;    // payload bytes of a slot's own buffer (default 4096)
+    uint32_t large_bufs;    // shared 64 KiB buffers (default 16)
+    uint32_t timeout_ms;    // from first fragment to giving up (default 30000)
+} ipv4_reasm_cfg_t;
+
+typedef struct
+{
+    uint64_t fragments;      // fragments offered
+    uint64_t completed;      // datagrams reassembled
+    uint64_t duplicates;     // fragments whose bytes were all present already
+    uint64_t dropped;        // datagrams discarded: overlap, bad length, too many holes
+    uint64_t no_buffer;      // datagrams discarded: no large buffer free
+    uint64_t timeouts;       // datagrams expired
+    uint64_t evictions;      // datagrams pushed out for a new one
+    uint64_t bad;            // packets that failed ipv4_parse or the header checksum
+} ipv4_reasm_stats_t;
+
+typedef struct
+{
+    uint32_t saddr, daddr; // key, network order
+    uint16_t id;
+    uint8_t proto;
+    uint8_t nholes;
+    uint16_t nfrags;   // fragments stored
+    uint8_t hdr_len;   // header of the offset-0 fragment, 0 until it arrives
+    uint16_t first_fo; // its host-order flags (DF survives reassembly)
+    uint32_t total;    // payload length once the last fragment is in, else 0
+    uint32_t expire;   // wheel tick
+    uint32_t cap;      // payload capacity of buf
+    int32_t large;     // large buffer index, or -1
+    int32_t hnext;     // hash chain / free list
+    int32_t wprev, wnext;
+    int32_t pprev, pnext; // probation list while nfrags < 2
+    uint8_t *buf;      // IPV4_MAX_HDR bytes of header room, then the payload
+    struct
+    {
+        uint16_t first, last; // inclusive byte offsets
+    } holes[IPV4_REASM_MAX_HOLES];
+} ipv4_reasm_ent_t;
+
+typedef struct
+{
+    ipv4_reasm_cfg_t cfg;
+    ipv4_reasm_ent_t *ents;
+    int32_t *buckets;
+    uint32_t hmask;
+    int32_t free_head;
+    int32_t wheel[IPV4_REASM_WHEEL], wheel_tail[IPV4_REASM_WHEEL]; // FIFO per tick: head is oldest
+    int32_t prob_head, prob_tail;                                 // FIFO of datagrams with < 2 fragments
+    uint32_t tick_ms, timeout_ticks, cur_tick;
+    bool started;
+    uint8_t *small_mem, *large_mem;
+    int32_t *large_free, *large_owner;
+    uint32_t nlarge_free, large_hand;
+    uint32_t used;
+    int32_t done; // slot handed out by the last ipv4_reasm_input(), freed on the next call
+    size_t mem_bytes;
+    ipv4_reasm_stats_t stats;
+} ipv4_reasm_t;
+
+static size_t reasm_stride(uint32_t payload) { return ((size_t)IPV4_MAX_HDR + payload + 63) & ~(size_t)63; }
+
+void ipv4_reasm_destroy(ipv4_reasm_t *r)
+{
+    if (!r)
+        return;
+    free(r->ents);
+    free(r->buckets);
+    free(r->small_mem);
+    free(r->large_mem);
+    free(r->large_free);
+    free(r->large_owner);
+    free(r);
+}
+
+/* Returns NULL if out of memory; zero cfg fields take the defaults */
+ipv4_reasm_t *ipv4_reasm_create(const ipv4_reasm_cfg_t *cfg)
+{
+    ipv4_reasm_t *r = calloc(1, sizeof(*r));
+    if (!r)
+        return NULL;
+    if (cfg)
+        r->cfg = *cfg;
+    if (!r->cfg.max_datagrams)
+        r->cfg.max_datagrams = 1024;
+    if (!r->cfg.small_size || r->cfg.small_size > IPV4_MAX_PAYLOAD)
+        r->cfg.small_size = 4096;
+    if (!r->cfg.timeout_ms)
+        r->cfg.timeout_ms = 30000;
+    if (!r->cfg.large_bufs)
+        r->cfg.large_bufs = 16;
+    uint32_t n = r->cfg.max_datagrams;
+
+    uint32_t nb = 1;
+    while (nb < 2 * n)
+        nb <<= 1;
+    r->hmask = nb - 1;
+    size_t ss = reasm_stride(r->cfg.small_size), ls = reasm_stride(IPV4_MAX_PAYLOAD);
+    r->ents = calloc(n, sizeof(*r->ents));
+    r->buckets = malloc(nb * sizeof(*r->buckets));
+    r->small_mem = aligned_alloc(64, n * ss);
+    r->large_mem = aligned_alloc(64, r->cfg.large_bufs * ls);
+    r->large_free = malloc(r->cfg.large_bufs * sizeof(*r->large_free));
+    r->large_owner = malloc(r->cfg.large_bufs * sizeof(*r->large_owner));
+    if (!r->ents || !r->buckets || !r->small_mem || !r->large_mem || !r->large_free || !r->large_owner)
+    {
+        ipv4_reasm_destroy(r);
+        return NULL;
+    }
+    r->mem_bytes = n * ss + r->cfg.large_bufs * ls + n * sizeof(*r->ents) + nb * sizeof(*r->buckets);
+    for (uint32_t i = 0; i < nb; i++)
+        r->buckets[i] = -1;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        r->ents[i].buf = r->small_mem + i * ss;
+        r->ents[i].hnext = i + 1 < n ? (int32_t)(i + 1) : -1;
+    }
+    r->free_head = 0;
+    for (uint32_t i = 0; i < r->cfg.large_bufs; i++)
+        r->large_free[i] = (int32_t)i;
+    r->nlarge_free = r->cfg.large_bufs;
+    for (int i = 0; i < IPV4_REASM_WHEEL; i++)
+        r->wheel[i] = r->wheel_tail[i] = -1;
+    // a tick small enough that the timeout spans at most half the wheel
+    r->tick_ms = r->cfg.timeout_ms / (IPV4_REASM_WHEEL / 2);
+    if (!r->tick_ms)
+        r->tick_ms = 1;
+    r->timeout_ticks = (r->cfg.timeout_ms + r->tick_ms - 1) / r->tick_ms;
+    r->prob_head = r->prob_tail = -1;
+    r->done = -1;
+    return r;
+}
+
+static uint32_t reasm_hash(const ipv4_reasm_t *r, uint32_t saddr, uint32_t daddr, uint16_t id, uint8_t proto)
+{
+    uint64_t h = ((uint64_t)saddr << 32 | daddr) ^ ((uint64_t)id << 8 | proto) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    return (uint32_t)(h >> 32) & r->hmask;
+}
+
+static void reasm_wheel_unlink(ipv4_reasm_t *r, int32_t i)
+{
+    ipv4_reasm_ent_t *e = &r->ents[i];
+    uint32_t slot = e->expire & (IPV4_REASM_WHEEL - 1);
+    if (e->wprev >= 0)
+        r->ents[e->wprev].wnext = e->wnext;
+    else
+        r->wheel[slot] = e->wnext;
+    if (e->wnext >= 0)
+        r->ents[e->wnext].wprev = e->wprev;
+    else
+        r->wheel_tail[slot] = e->wprev;
+}
+
+static void reasm_prob_unlink(ipv4_reasm_t *r, int32_t i)
+{
+    ipv4_reasm_ent_t *e = &r->ents[i];
+    if (e->pprev >= 0)
+        r->ents[e->pprev].pnext = e->pnext;
+    else
+        r->prob_head = e->pnext;
+    if (e->pnext >= 0)
+        r->ents[e->pnext].pprev = e->pprev;
+    else
+        r->prob_tail = e->pprev;
+}
+
+static void reasm_release(ipv4_reasm_t *r, int32_t i)
+{
+    ipv4_reasm_ent_t *e = &r->ents[i];
+    int32_t *pp = &r->buckets[reasm_hash(r, e->saddr, e->daddr, e->id, e->proto)];
+    while (*pp != i)
+        pp = &r->ents[*pp].hnext;
+    *pp = e->hnext;
+    reasm_wheel_unlink(r, i);
+    if (e->nfrags < 2)
+        reasm_prob_unlink(r, i);
+    if (e->large >= 0)
+    {
+        r->large_owner[e->large] = -1;
+        r->large_free[r->nlarge_free++] = e->large;
+        e->buf = r->small_mem + (size_t)i * reasm_stride(r->cfg.small_size);
+    }
+    e->hnext = r->free_head;
+    r->free_head = i;
+    r->used--;
+}
+
+/* Drop every datagram whose timer has run out by now_ms */
+void ipv4_reasm_expire(ipv4_reasm_t *r, uint64_t now_ms)
+{
+    uint32_t target = (uint32_t)(now_ms / r->tick_ms);
+    if (!r->started)
+    {
+        r->started = true;
+        r->cur_tick = target;
+        return;
+    }
+    uint32_t steps = target - r->cur_tick;
+    if (steps > IPV4_REASM_WHEEL)
+        steps = IPV4_REASM_WHEEL; // a long gap: one lap visits every slot
+    for (uint32_t k = 1; k <= steps; k++)
+    {
+        int32_t i = r->wheel[(r->cur_tick + k) & (IPV4_REASM_WHEEL - 1)];
+        while (i >= 0)
+        {
+            int32_t next = r->ents[i].wnext;
+            if ((int32_t)(r->ents[i].expire - target) <= 0 && i != r->done)
+            {
+                reasm_release(r, i);
+                r->stats.timeouts++;
+            }
+            i = next;
+        }
+    }
+    r->cur_tick = target;
+}
+
+/*
+ * Make room: evict the oldest datagram still on probation (fewer than two
+ * fragments in), or failing that the oldest of all. Flood junk rarely gets
+ * past one fragment, so real datagrams in progress outlive it.
+ */
+static void reasm_evict(ipv4_reasm_t *r)
+{
+    int32_t victim = r->prob_head;
+    for (uint32_t k = 1; victim < 0 && k <= IPV4_REASM_WHEEL; k++)
+        victim = r->wheel[(r->cur_tick + k) & (IPV4_REASM_WHEEL - 1)];
+    if (victim >= 0)
+    {
+        reasm_release(r, victim);
+        r->stats.evictions++;
+    }
+}
+
+/*
+ * Take a large buffer for slot self: a free one, or else the next one (clock
+ * order) whose owner is still on probation. -1 if every holder is making progress.
+ */
+static int32_t reasm_take_large(ipv4_reasm_t *r, int32_t self)
+{
+    for (uint32_t k = 0; !r->nlarge_free && k < r->cfg.large_bufs; k++)
+    {
+        uint32_t b = r->large_hand;
+        r->large_hand = (b + 1) % r->cfg.large_bufs;
+        int32_t owner = r->large_owner[b];
+        if (owner != self && r->ents[owner].nfrags < 2)
+        {
+            reasm_release(r, owner);
+            r->stats.evictions++;
+        }
+    }
+    if (!r->nlarge_free)
+        return -1;
+    int32_t b = r->large_free[--r->nlarge_free];
+    r->large_owner[b] = self;
+    return b;
+}
+
+static int32_t reasm_lookup(ipv4_reasm_t *r, const ipv4_hdr_t *ip)
+{
+    uint32_t h = reasm_hash(r, ip->saddr, ip->daddr, ip->id, ip->protocol);
+    for (int32_t i = r->buckets[h]; i >= 0; i = r->ents[i].hnext)
+    {
+        const ipv4_reasm_ent_t *e = &r->ents[i];
+        if (e->id == ip->id && e->saddr == ip->saddr && e->daddr == ip->daddr && e->proto == ip->protocol)
+            return i;
+    }
+    if (r->free_head < 0)
+        reasm_evict(r);
+    int32_t i = r->free_head;
+    ipv4_reasm_ent_t *e = &r->ents[i];
+    r->free_head = e->hnext;
+    r->used++;
+    e->saddr = ip->saddr;
+    e->daddr = ip->daddr;
+    e->id = ip->id;
+    e->proto = ip->protocol;
+    e->nfrags = 0;
+    e->hdr_len = 0;
+    e->first_fo = 0;
+    e->total = 0;
+    e->cap = r->cfg.small_size;
+    e->large = -1;
+    e->nholes = 1;
+    e->holes[0].first = 0;
+    e->holes[0].last = IPV4_REASM_HOLE_END;
+    e->hnext = r->buckets[h];
+    r->buckets[h] = i;
+    e->expire = r->cur_tick + r->timeout_ticks;
+    uint32_t slot = e->expire & (IPV4_REASM_WHEEL - 1);
+    e->wnext = -1;
+    e->wprev = r->wheel_tail[slot];
+    if (e->wprev >= 0)
+        r->ents[e->wprev].wnext = i;
+    else
+        r->wheel[slot] = i;
+    r->wheel_tail[slot] = i;
+    e->pnext = -1;
+    e->pprev = r->prob_tail;
+    if (e->pprev >= 0)
+        r->ents[e->pprev].pnext = i;
+    else
+        r->prob_head = i;
+    r->prob_tail = i;
+    return i;
+}
+
+/*
+ * Feed one IPv4 packet. Returns:
+ *   1  a whole datagram is in *out, *out_len: pkt itself if it was not a
+ *      fragment, otherwise reassembler memory valid until the next call
+ *   0  fragment stored (or an exact duplicate), datagram still incomplete
+ *  -1  packet or its datagram was dropped (see stats)
+ */
+int ipv4_reasm_input(ipv4_reasm_t *r, const uint8_t *pkt, size_t len, uint64_t now_ms,
+                     const uint8_t **out, size_t *out_len)
+{
+    if (r->done >= 0)
+    {
+        reasm_release(r, r->done);
+        r->done = -1;
+    }
+    ipv4_parsed_t P;
+    if (!ipv4_parse(pkt, len, &P) || !P.hdr_ok)
+    {
+        r->stats.bad++;
+        return -1;
+    }
+    uint16_t fo = ntohs(P.flags_off_be);
+    size_t first = (size_t)(fo & IPV4_FRAG_OFF_MASK) * 8u;
+    bool mf = (fo & IPV4_FLAG_MF) != 0;
+    if (!mf && first == 0)
+    {
+        *out = pkt;
+        *out_len = P.total_len;
+        return 1;
+    }
+    r->stats.fragments++;
+    ipv4_reasm_expire(r, now_ms);
+
+    size_t dlen = P.total_len - P.ihl;
+    int32_t i = reasm_lookup(r, P.ip);
+    ipv4_reasm_ent_t *e = &r->ents[i];
+    size_t last = first + dlen - 1;
+    // non-final fragments carry multiples of 8 bytes; nothing may reach past 64 KiB
+    if (dlen == 0 || (mf && dlen % 8) || first + dlen > IPV4_MAX_PAYLOAD || (e->total && last >= e->total))
+        goto drop;
+
+    int h = -1;
+    bool touches = false;
+    for (int k = 0; k < e->nholes; k++)
+    {
+        if (first <= e->holes[k].last && last >= e->holes[k].first)
+            touches = true;
+        if (first >= e->holes[k].first && last <= e->holes[k].last)
+            h = k;
+    }
+    if (h < 0)
+    {
+        if (touches)
+            goto drop; // partial overlap
+        r->stats.duplicates++;
+        return 0;
+    }
+    uint16_t hf = e->holes[h].first, hl = e->holes[h].last;
+    if (!mf && hl != IPV4_REASM_HOLE_END)
+        goto drop; // a last fragment ending before data already seen
+    if (e->nholes + (first > hf) + (mf && last < hl) - 1 > IPV4_REASM_MAX_HOLES)
+        goto drop;
+
+    if (last + 1 > e->cap)
+    {
+        int32_t big_idx = reasm_take_large(r, i);
+        if (big_idx < 0)
+        {
+            r->stats.no_buffer++;
+            reasm_release(r, i);
+            return -1;
+        }
+        e->large = big_idx;
+        uint8_t *big = r->large_mem + (size_t)e->large * reasm_stride(IPV4_MAX_PAYLOAD);
+        memcpy(big, e->buf, IPV4_MAX_HDR + e->cap);
+        e->buf = big;
+        e->cap = IPV4_MAX_PAYLOAD;
+    }
+
+    // replace hole h by what is left of it on either side
+    e->holes[h] = e->holes[--e->nholes];
+    if (first > hf)
+    {
+        e->holes[e->nholes].first = hf;
+        e->holes[e->nholes++].last = (uint16_t)(first - 1);
+    }
+    if (mf && last < hl)
+    {
+        e->holes[e->nholes].first = (uint16_t)(last + 1);
+        e->holes[e->nholes++].last = hl;
+    }
+    if (!mf)
+        e->total = (uint32_t)(last + 1);
+    memcpy(e->buf + IPV4_MAX_HDR + first, pkt + P.ihl, dlen);
+    if (++e->nfrags == 2)
+        reasm_prob_unlink(r, i); // off probation
+    if (first == 0)
+    {
+        e->hdr_len = (uint8_t)P.ihl;
+        e->first_fo = fo;
+        memcpy(e->buf + IPV4_MAX_HDR - P.ihl, pkt, P.ihl);
+    }
+    if (e->nholes)
+        return 0;
+
+    if (e->hdr_len + e->total > 0xFFFF)
+        goto drop;
+    ipv4_hdr_t *ip = (ipv4_hdr_t *)(e->buf + IPV4_MAX_HDR - e->hdr_len);
+    csum_set16(&ip->checksum, &ip->tot_len, htons((uint16_t)(e->hdr_len + e->total)));
+    csum_set16(&ip->checksum, &ip->frag_off, htons(e->first_fo & IPV4_FLAG_DF));
+    r->done = i;
+    r->stats.completed++;
+    *out = (const uint8_t *)ip;
+    *out_len = e->hdr_len + e->total;
+    return 1;
+
+drop:
+    r->stats.dropped++;
+    reasm_release(r, i);
+    return -1;
+}
+
 /* =================== Demo main =================== */
 #ifdef IP_DEMO_MAIN
-static int emit_sendto(const uint8_t *frag, size_t len, void *user)
+static int emit_sendmsg(const ipv4_hdr_t *hdr, const uint8_t *data, size_t len, void *user)
 {
     int s = *(int *)user; // raw socket
     struct sockaddr_in dst = {0};
-    const ipv4_hdr_t *ip = (const ipv4_hdr_t *)frag;
     dst.sin_family = AF_INET;
-    dst.sin_addr.s_addr = ip->daddr;
-    ssize_t wr = sendto(s, frag, len, 0, (struct sockaddr *)&dst, sizeof(dst));
+    dst.sin_addr.s_addr = hdr->daddr;
+    // header from the stack, payload straight from the caller's buffer
+    struct iovec iov[2] = {{(void *)hdr, sizeof(*hdr)}, {(void *)data, len}};
+    struct msghdr mh = {0};
+    mh.msg_name = &dst;
+    mh.msg_namelen = sizeof(dst);
+    mh.msg_iov = iov;
+    mh.msg_iovlen = 2;
+    ssize_t wr = sendmsg(s, &mh, 0);
     if (wr < 0)
     {
-        perror("sendto");
+        perror("sendmsg");
         return -1;
     }
     return 0;
@@ -274,7 +713,7 @@ static int demo_send(const char *dst_ip_str, uint8_t proto, const char *data)
     size_t mtu = 1500; // demo MTU; adjust per iface
 
     int nfrag = ipv4_fragment_and_emit(saddr_be, dst_addr.s_addr, proto, 64, (uint16_t)rand(),
-                                       payload, plen, mtu, emit_sendto, &s);
+                                       payload, plen, mtu, emit_sendmsg, &s);
     if (nfrag < 0)
     {
         fprintf(stderr, "send failed\n");
@@ -286,18 +725,216 @@ static int demo_send(const char *dst_ip_str, uint8_t proto, const char *data)
     return 0;
 }
 
+/* ---- reassembly bench: fragments kept in memory, fed back as fast as possible ---- */
+typedef struct
+{
+    uint8_t *mem;
+    size_t len, cap;
+} frag_store_t;
+
+static int emit_store(const ipv4_hdr_t *hdr, const uint8_t *data, size_t len, void *user)
+{
+    frag_store_t *st = user;
+    size_t need = (sizeof(*hdr) + len + 7) & ~(size_t)7;
+    if (st->len + need > st->cap)
+    {
+        size_t cap = st->cap ? st->cap * 2 : 1 << 20;
+        while (cap < st->len + need)
+            cap *= 2;
+        uint8_t *m = realloc(st->mem, cap);
+        if (!m)
+            return -1;
+        st->mem = m;
+        st->cap = cap;
+    }
+    memcpy(st->mem + st->len, hdr, sizeof(*hdr));
+    memcpy(st->mem + st->len + sizeof(*hdr), data, len);
+    st->len += need;
+    return 0;
+}
+
+static uint64_t demo_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static double demo_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * `inflight` datagrams of `plen` bytes are fragmented for `mtu` and their
+ * fragments interleaved (every other datagram back to front), optionally
+ * with `flood` never-completing junk fragments from random sources after
+ * each real one. The mix is replayed into one reassembler for `secs`.
+ */
+static int demo_bench(size_t plen, size_t mtu, size_t inflight, size_t flood, double secs)
+{
+    if (!plen || plen > IPV4_MAX_PAYLOAD || !inflight || inflight > 65536)
+    {
+        fprintf(stderr, "bad bench parameters\n");
+        return 1;
+    }
+    uint8_t *payload = malloc(plen);
+    frag_store_t st = {0};
+    size_t *off = NULL, nfr = 0, per = 0;
+    int rc = 1;
+    if (!payload)
+        goto out;
+    for (size_t k = 0; k < plen; k++)
+        payload[k] = (uint8_t)(k * 7);
+
+    // fragment every datagram, remembering where each fragment starts
+    size_t *start = malloc((inflight + 1) * sizeof(*start));
+    size_t *doff = NULL;
+    if (!start)
+        goto out;
+    for (size_t d = 0; d < inflight; d++)
+    {
+        start[d] = st.len;
+        int n = ipv4_fragment_and_emit(htonl(0xC0A80001), htonl(0xC0A80002), IPPROTO_UDP, 64, (uint16_t)d, payload,
+                                       plen, mtu, emit_store, &st);
+        if (n < 0)
+        {
+            free(start);
+            goto out;
+        }
+        per = (size_t)n;
+    }
+    start[inflight] = st.len;
+    doff = malloc(inflight * per * sizeof(*doff));
+    if (!doff)
+    {
+        free(start);
+        goto out;
+    }
+    for (size_t d = 0; d < inflight; d++)
+        for (size_t pos = start[d], j = 0; j < per; j++)
+        {
+            doff[d * per + j] = pos;
+            pos += (ntohs(((const ipv4_hdr_t *)(st.mem + pos))->tot_len) + 7) & ~(size_t)7;
+        }
+    free(start);
+
+    // junk: 64-byte MF fragments at random offsets, each from a different source
+    size_t njunk = flood ? 4096 : 0, junk0 = st.len;
+    uint8_t junkdata[64];
+    memset(junkdata, 0xEE, sizeof(junkdata));
+    srand(1);
+    for (size_t k = 0; k < njunk; k++)
+    {
+        ipv4_hdr_t jh;
+        ipv4_build_header(&jh, sizeof(jh) + sizeof(junkdata), htonl(0x0A000000u | (uint32_t)rand() % 0xFFFFFF),
+                          htonl(0xC0A80002), (uint16_t)rand(), 64, IPPROTO_UDP, false);
+        csum_set16(&jh.checksum, &jh.frag_off, htons(IPV4_FLAG_MF | (uint16_t)(1 + rand() % 1000)));
+        if (emit_store(&jh, junkdata, sizeof(junkdata), &st) != 0)
+        {
+            free(doff);
+            goto out;
+        }
+    }
+
+    // replay order: fragment j of every datagram, then fragment j+1, ...
+    nfr = inflight * per * (1 + flood);
+    off = malloc(nfr * sizeof(*off));
+    if (!off)
+    {
+        free(doff);
+        goto out;
+    }
+    size_t w = 0, jk = 0;
+    for (size_t j = 0; j < per; j++)
+        for (size_t d = 0; d < inflight; d++)
+        {
+            off[w++] = doff[d * per + (d & 1 ? per - 1 - j : j)];
+            for (size_t f = 0; f < flood; f++, jk = (jk + 1) % njunk)
+                off[w++] = junk0 + jk * ((sizeof(ipv4_hdr_t) + sizeof(junkdata) + 7) & ~(size_t)7);
+        }
+    free(doff);
+
+    ipv4_reasm_cfg_t cfg = {0};
+    cfg.small_size = plen <= 9216 ? (uint32_t)plen : 2048;
+    cfg.large_bufs = 64;
+    ipv4_reasm_t *r = ipv4_reasm_create(&cfg);
+    if (!r)
+    {
+        fprintf(stderr, "out of memory\n");
+        goto out;
+    }
+    printf("%zu-byte datagrams, MTU %zu: %zu fragments each, %zu in flight, %zu junk per fragment\n", plen, mtu, per,
+           inflight, flood);
+    printf("reassembler: %u slots x %u B + %u x 64 KiB = %.1f MiB, fixed\n", r->cfg.max_datagrams,
+           r->cfg.small_size, r->cfg.large_bufs, r->mem_bytes / 1048576.0);
+
+    uint64_t frags = 0, good = 0, corrupt = 0;
+    double t0 = demo_now(), t = t0;
+    while (t - t0 < secs)
+    {
+        uint64_t now = demo_now_ms();
+        for (size_t k = 0; k < nfr; k++)
+        {
+            const uint8_t *pkt = st.mem + off[k], *dg;
+            size_t dl;
+            if (ipv4_reasm_input(r, pkt, ntohs(((const ipv4_hdr_t *)pkt)->tot_len), now, &dg, &dl) != 1)
+                continue;
+            ipv4_parsed_t P;
+            if (dl == sizeof(ipv4_hdr_t) + plen && ipv4_parse(dg, dl, &P) && P.hdr_ok &&
+                memcmp(dg + sizeof(ipv4_hdr_t), payload, plen) == 0)
+                good++;
+            else
+                corrupt++;
+        }
+        frags += nfr;
+        t = demo_now();
+    }
+    double dt = t - t0;
+    printf("%.2f Mfrag/s, %.0f datagrams/s, %.2f Gbps reassembled, %.1f ns/fragment\n", frags / dt / 1e6,
+           good / dt, good * plen * 8 / dt / 1e9, dt * 1e9 / frags);
+    uint64_t sent = frags / (1 + flood) / per;
+    printf("complete %llu/%llu (%.1f%%), corrupt %llu\n", (unsigned long long)good, (unsigned long long)sent,
+           sent ? 100.0 * good / sent : 0, (unsigned long long)corrupt);
+    const ipv4_reasm_stats_t *S = &r->stats;
+    printf("stats: dup %llu dropped %llu no_buffer %llu timeouts %llu evictions %llu bad %llu, %u pending\n",
+           (unsigned long long)S->duplicates, (unsigned long long)S->dropped, (unsigned long long)S->no_buffer,
+           (unsigned long long)S->timeouts, (unsigned long long)S->evictions, (unsigned long long)S->bad, r->used);
+    ipv4_reasm_destroy(r);
+    rc = corrupt ? 1 : 0;
+out:
+    free(off);
+    free(st.mem);
+    free(payload);
+    return rc;
+}
+
 int main(int argc, char **argv)
 {
-    if (argc < 4)
+    if (argc < 2)
     {
-        fprintf(stderr, "Usage: %s send <dst_ip> <proto> <data>\n", argv[0]);
+        fprintf(stderr,
+                "Usage: %s send <dst_ip> <proto> <data>\n"
+                "       %s bench [payload=8000] [mtu=1500] [inflight=256] [flood=0] [secs=2]\n",
+                argv[0], argv[0]);
         return 1;
     }
     if (!strcmp(argv[1], "send"))
     {
+        if (argc < 5)
+        {
+            fprintf(stderr, "send needs <dst_ip> <proto> <data>\n");
+            return 1;
+        }
         uint8_t proto = (uint8_t)atoi(argv[3]);
         return demo_send(argv[2], proto, argv[4]);
     }
+    if (!strcmp(argv[1], "bench"))
+        return demo_bench(argc > 2 ? (size_t)atoi(argv[2]) : 8000, argc > 3 ? (size_t)atoi(argv[3]) : 1500,
+                          argc > 4 ? (size_t)atoi(argv[4]) : 256, argc > 5 ? (size_t)atoi(argv[5]) : 0,
+                          argc > 6 ? atof(argv[6]) : 2);
     fprintf(stderr, "unknown command\n");
     return 1;
 }
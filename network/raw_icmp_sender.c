@@ -9,27 +9,9 @@
 #include <netinet/ip_icmp.h>
 #include <time.h>
 
-#define DEST_IP "8.8.8.8" // Change to your target
-
-// Checksum function
-unsigned short checksum(void *b, int len)
-{
-    unsigned short *buf = b;
-    unsigned int sum = 0;
-    unsigned short result;
-
-    for (sum = 0; len > 1; len -= 2)
-        sum += *buf++;
+#include "inet_csum.h"
 
-    if (len == 1)
-        sum += *(unsigned char *)buf;
-
-    sum = (sum >> 16) + (sum & 0xffff);
-    sum += (sum >> 16);
-    result = ~sum;
-
-    return result;
-}
+#define DEST_IP "8.8.8.8" // Change to your target
 
 int main()
 {
@@ -56,7 +38,7 @@ int main()
     icmp->checksum = 0;
 
     int packet_len = sizeof(struct icmphdr) + datalen;
-    icmp->checksum = checksum((unsigned short *)icmp, packet_len);
+    icmp->checksum = inet_csum(icmp, packet_len);
 
     // Destination
     struct sockaddr_in dest;
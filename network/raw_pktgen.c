@@ -0,0 +1,886 @@
+// raw_pktgen.c - multi-threaded raw IPv4 load generator: TCP SYN / UDP / ICMP echo mixes
+// Build: gcc -O2 -Wall -Wextra -pthread -o raw_pktgen raw_pktgen.c
+// Usage: sudo ./raw_pktgen -d dst[/len] [-s src[/len]] [-m syn:60,udp:30,icmp:10]
+//                          [-p port[-port]] [-P port[-port]] [-l payload] [-x ttl]
+//                          [-t threads] [-r pps] [-b batch] [-T secs] [-n count]
+//                          [-i iface [-M dst_mac] [-Q]]
+//
+//  -d dst/len  Destination address, or a prefix to spread packets over.
+//  -s src/len  Source address or prefix (default: the address routing picks for dst).
+//  -m mix      Templates and weights: syn, udp, icmp (default udp).
+//  -p, -P      Destination / source port or range (default 9 / 1024-65535).
+//  -l bytes    UDP and ICMP payload length (default 18: 64-byte Ethernet frames).
+//  -x ttl      IP TTL (default 64).
+//  -t N        N sender threads, each with its own socket, pinned to its own core.
+//  -r pps      Total rate, token bucket per thread (default: as fast as possible).
+//  -b batch    Packets per sendmmsg() / per TX-ring kick (default 64).
+//  -T secs     Stop after secs (default: Ctrl+C).  -n count: stop after count packets.
+//  -i iface    Bypass the IP stack: write Ethernet frames into a PACKET_TX_RING on iface.
+//  -M mac      Next-hop MAC for -i (default 00:00:00:00:00:00, fine on lo).
+//  -Q          With -i, also skip the qdisc (PACKET_QDISC_BYPASS).
+//
+// Each thread keeps a pool of prebuilt packets, the templates in the -m mix
+// proportions. Before a packet goes out again its IP id, ports, TCP sequence,
+// ICMP id/sequence and (with a prefix) addresses are re-drawn and the IP and
+// L4 checksums patched incrementally (RFC 1624, inet_csum.h); nothing is
+// summed again. Without -i the pool goes to the kernel with sendmmsg() on an
+// IPPROTO_RAW socket. Rates are printed each second to stderr.
+//
+// Notes:
+//  * Requires root privileges. Linux only.
+//  * Spoofed sources (-s prefix) only make sense on a test network you own.
+//  * A -d prefix on a directly attached subnet means one ARP lookup per address
+//    and a crawl; route the prefix via a gateway on the test network instead.
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "inet_csum.h"
+
+static volatile sig_atomic_t g_stop = 0;
+static void on_sigint(int signo)
+{
+    (void)signo;
+    g_stop = 1;
+}
+
+enum
+{
+    T_SYN,
+    T_UDP,
+    T_ICMP,
+    T_KINDS
+};
+static const char *const kind_names[T_KINDS] = {"syn", "udp", "icmp"};
+
+#define POOL_MIN 256 // packets per thread pool: the mix is exact to 1/256
+#define SLOT_SIZE 2048
+#define RING_FRAME 2048
+#define RING_FRAMES 4096
+
+static struct
+{
+    uint32_t dst, ndst; // host order base and count (prefix)
+    uint32_t src, nsrc;
+    uint16_t dport_lo, dport_hi, sport_lo, sport_hi;
+    unsigned weight[T_KINDS];
+    unsigned payload;
+    uint8_t ttl;
+    int threads;
+    double rate; // total pps, 0 = unlimited
+    unsigned batch;
+    double secs;
+    unsigned long count; // 0 = unlimited
+    const char *ifname;  // TX ring mode
+    int ifindex;
+    uint8_t dst_mac[6], src_mac[6];
+    bool qdisc_bypass;
+} g_cfg = {.dport_lo = 9, .dport_hi = 9, .sport_lo = 1024, .sport_hi = 65535, .payload = 18, .ttl = 64,
+           .threads = 1, .batch = 64};
+
+struct worker
+{
+    int id, cpu, fd;
+    pthread_t th;
+    uint64_t rng;
+    uint16_t echo_seq;
+    unsigned long quota; // packets to send, 0 = unlimited
+    // pool of prebuilt packets
+    unsigned npool, cur;
+    uint8_t *pool;
+    uint8_t *kind;
+    uint16_t *len;
+    struct sockaddr_in *dst;
+    struct mmsghdr *msgs;
+    struct iovec *iov;
+    // TX ring
+    uint8_t *ring;
+    size_t ring_len;
+    unsigned ring_cur;
+    atomic_ulong pkts, bytes, errs; // written by the worker only
+    unsigned long last_pkts, last_bytes;
+};
+
+/* =================== Templates =================== */
+static uint64_t rng_next(uint64_t *s) // xorshift64*
+{
+    uint64_t x = *s;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// uniform in [lo, lo + n), n >= 1
+static uint32_t rng_range(uint64_t *s, uint32_t lo, uint32_t n) { return lo + (uint32_t)(((rng_next(s) >> 32) * n) >> 32); }
+
+// Build one complete packet of `kind` (IP header at 0, checksums valid); returns its length
+static size_t tmpl_build(uint8_t *buf, int kind)
+{
+    memset(buf, 0, SLOT_SIZE);
+    struct iphdr *iph = (struct iphdr *)buf;
+    uint8_t *l4 = buf + sizeof(*iph);
+    size_t l4len;
+    if (kind == T_SYN)
+    {
+        struct tcphdr *tcph = (struct tcphdr *)l4;
+        tcph->source = htons(g_cfg.sport_lo);
+        tcph->dest = htons(g_cfg.dport_lo);
+        tcph->doff = 6; // 20 bytes + MSS option, like a real SYN
+        tcph->syn = 1;
+        tcph->window = htons(64240);
+        static const uint8_t mss[4] = {2, 4, 0x05, 0xB4}; // MSS 1460
+        memcpy(l4 + sizeof(*tcph), mss, sizeof(mss));
+        l4len = sizeof(*tcph) + sizeof(mss);
+        iph->protocol = IPPROTO_TCP;
+    }
+    else if (kind == T_UDP)
+    {
+        struct udphdr *udph = (struct udphdr *)l4;
+        udph->source = htons(g_cfg.sport_lo);
+        udph->dest = htons(g_cfg.dport_lo);
+        l4len = sizeof(*udph) + g_cfg.payload;
+        udph->len = htons((uint16_t)l4len);
+        memset(l4 + sizeof(*udph), 'U', g_cfg.payload);
+        iph->protocol = IPPROTO_UDP;
+    }
+    else
+    {
+        struct icmphdr *icmp = (struct icmphdr *)l4;
+        icmp->type = ICMP_ECHO;
+        l4len = sizeof(*icmp) + g_cfg.payload;
+        memset(l4 + sizeof(*icmp), 'I', g_cfg.payload);
+        iph->protocol = IPPROTO_ICMP;
+    }
+    size_t len = sizeof(*iph) + l4len;
+    iph->ihl = 5;
+    iph->version = 4;
+    iph->tot_len = htons((uint16_t)len);
+    iph->ttl = g_cfg.ttl;
+    iph->saddr = htonl(g_cfg.src);
+    iph->daddr = htonl(g_cfg.dst);
+    iph->check = inet_csum(iph, sizeof(*iph));
+
+    uint64_t sum = kind == T_ICMP ? 0 : csum_pseudo_ipv4(iph->saddr, iph->daddr, iph->protocol, (uint16_t)l4len);
+    uint16_t c = inet_csum_finish(csum_partial(l4, l4len, sum));
+    if (kind == T_SYN)
+        ((struct tcphdr *)l4)->check = c;
+    else if (kind == T_UDP)
+        ((struct udphdr *)l4)->check = c ? c : 0xFFFF; // 0 means "no checksum"
+    else
+        ((struct icmphdr *)l4)->checksum = c;
+    return len;
+}
+
+// the L4 checksum field, or NULL for ICMP where addresses are not covered
+static uint8_t *l4_pseudo_check(uint8_t *p, int kind)
+{
+    uint8_t *l4 = p + sizeof(struct iphdr);
+    if (kind == T_SYN)
+        return l4 + offsetof(struct tcphdr, check);
+    if (kind == T_UDP)
+        return l4 + offsetof(struct udphdr, check);
+    return NULL;
+}
+
+static void set_addr(uint8_t *p, int kind, size_t off, uint32_t a_be)
+{
+    struct iphdr *iph = (struct iphdr *)p;
+    uint32_t old;
+    memcpy(&old, p + off, 4);
+    memcpy(p + off, &a_be, 4);
+    iph->check = csum_replace32(iph->check, old, a_be);
+    uint8_t *c = l4_pseudo_check(p, kind);
+    if (c)
+    {
+        uint16_t v;
+        memcpy(&v, c, 2);
+        v = csum_replace32(v, old, a_be);
+        if (kind == T_UDP && !v)
+            v = 0xFFFF;
+        memcpy(c, &v, 2);
+    }
+}
+
+static void set_l4_16(uint8_t *p, int kind, void *field, uint16_t v)
+{
+    uint8_t *c = kind == T_ICMP ? p + sizeof(struct iphdr) + offsetof(struct icmphdr, checksum)
+                                : l4_pseudo_check(p, kind);
+    csum_set16(c, field, v);
+    if (kind == T_UDP && !c[0] && !c[1])
+        c[0] = c[1] = 0xFF;
+}
+
+// Re-draw the varying fields of a pooled packet, patching checksums (RFC 1624)
+static void pkt_mutate(struct worker *w, uint8_t *p, int kind, struct sockaddr_in *dst)
+{
+    struct iphdr *iph = (struct iphdr *)p;
+    uint64_t r = rng_next(&w->rng);
+    csum_set16(&iph->check, &iph->id, (uint16_t)r);
+    if (g_cfg.nsrc > 1)
+        set_addr(p, kind, offsetof(struct iphdr, saddr), htonl(rng_range(&w->rng, g_cfg.src, g_cfg.nsrc)));
+    if (g_cfg.ndst > 1)
+    {
+        set_addr(p, kind, offsetof(struct iphdr, daddr), htonl(rng_range(&w->rng, g_cfg.dst, g_cfg.ndst)));
+        dst->sin_addr.s_addr = iph->daddr;
+    }
+    uint8_t *l4 = p + sizeof(*iph);
+    if (kind == T_ICMP)
+    {
+        struct icmphdr *icmp = (struct icmphdr *)l4;
+        set_l4_16(p, kind, &icmp->un.echo.id, (uint16_t)(r >> 16));
+        set_l4_16(p, kind, &icmp->un.echo.sequence, htons(w->echo_seq++));
+        return;
+    }
+    // TCP and UDP both start with source, dest ports
+    uint16_t sp = htons((uint16_t)rng_range(&w->rng, g_cfg.sport_lo, g_cfg.sport_hi - g_cfg.sport_lo + 1u));
+    set_l4_16(p, kind, l4, sp);
+    if (g_cfg.dport_hi != g_cfg.dport_lo)
+    {
+        uint16_t dp = htons((uint16_t)rng_range(&w->rng, g_cfg.dport_lo, g_cfg.dport_hi - g_cfg.dport_lo + 1u));
+        set_l4_16(p, kind, l4 + 2, dp);
+    }
+    if (kind == T_SYN)
+    {
+        struct tcphdr *tcph = (struct tcphdr *)l4;
+        uint32_t seq = (uint32_t)(r >> 32), old;
+        memcpy(&old, &tcph->seq, 4);
+        memcpy(&tcph->seq, &seq, 4);
+        tcph->check = csum_replace32(tcph->check, old, seq);
+    }
+}
+
+/* =================== Per-thread pool and sockets =================== */
+static int pool_setup(struct worker *w)
+{
+    unsigned n = (POOL_MIN + g_cfg.batch - 1) / g_cfg.batch * g_cfg.batch; // whole batches
+    w->npool = n;
+    w->pool = aligned_alloc(64, (size_t)n * SLOT_SIZE);
+    w->kind = calloc(n, 1);
+    w->len = calloc(n, sizeof(*w->len));
+    w->dst = calloc(n, sizeof(*w->dst));
+    w->msgs = calloc(n, sizeof(*w->msgs));
+    w->iov = calloc(n, sizeof(*w->iov));
+    if (!w->pool || !w->kind || !w->len || !w->dst || !w->msgs || !w->iov)
+    {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+    // the mix: each kind gets its share of slots, then the order is shuffled
+    unsigned total = 0, k = 0;
+    for (int t = 0; t < T_KINDS; t++)
+        total += g_cfg.weight[t];
+    for (int t = 0, acc = 0; t < T_KINDS; t++)
+    {
+        acc += (int)g_cfg.weight[t];
+        unsigned upto = (unsigned)((uint64_t)n * (unsigned)acc / total);
+        while (k < upto)
+            w->kind[k++] = (uint8_t)t;
+    }
+    for (unsigned i = n - 1; i > 0; i--)
+    {
+        unsigned j = rng_range(&w->rng, 0, i + 1);
+        uint8_t t = w->kind[i];
+        w->kind[i] = w->kind[j];
+        w->kind[j] = t;
+    }
+    for (unsigned i = 0; i < n; i++)
+    {
+        uint8_t *p = w->pool + (size_t)i * SLOT_SIZE;
+        w->len[i] = (uint16_t)tmpl_build(p, w->kind[i]);
+        w->dst[i].sin_family = AF_INET;
+        w->dst[i].sin_addr.s_addr = htonl(g_cfg.dst);
+        w->iov[i].iov_base = p;
+        w->iov[i].iov_len = w->len[i];
+        w->msgs[i].msg_hdr.msg_name = &w->dst[i];
+        w->msgs[i].msg_hdr.msg_namelen = sizeof(w->dst[i]);
+        w->msgs[i].msg_hdr.msg_iov = &w->iov[i];
+        w->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    return 0;
+}
+
+static int raw_setup(struct worker *w)
+{
+    // IPPROTO_RAW implies IP_HDRINCL and never receives
+    w->fd = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+    if (w->fd < 0)
+    {
+        perror("socket(AF_INET, SOCK_RAW, IPPROTO_RAW)");
+        return -1;
+    }
+    int sndbuf = 4 << 20;
+    setsockopt(w->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    return 0;
+}
+
+static int ring_setup(struct worker *w)
+{
+    // protocol 0: a TX-only socket, nothing is queued to it for receive
+    int fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (fd < 0)
+    {
+        perror("socket(AF_PACKET,SOCK_RAW)");
+        return -1;
+    }
+    int ver = TPACKET_V2;
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) < 0)
+    {
+        perror("setsockopt(PACKET_VERSION, TPACKET_V2)");
+        close(fd);
+        return -1;
+    }
+    if (g_cfg.qdisc_bypass)
+    {
+        int one = 1;
+        if (setsockopt(fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one)) < 0)
+            perror("setsockopt(PACKET_QDISC_BYPASS)");
+    }
+    struct tpacket_req req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = RING_FRAME * 32;
+    req.tp_frame_size = RING_FRAME;
+    req.tp_frame_nr = RING_FRAMES;
+    req.tp_block_nr = RING_FRAMES / 32;
+    if (setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0)
+    {
+        perror("setsockopt(PACKET_TX_RING)");
+        close(fd);
+        return -1;
+    }
+    w->ring_len = (size_t)req.tp_block_size * req.tp_block_nr;
+    w->ring = mmap(NULL, w->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+    if (w->ring == MAP_FAILED)
+        w->ring = mmap(NULL, w->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); // over RLIMIT_MEMLOCK
+    if (w->ring == MAP_FAILED)
+    {
+        perror("mmap(PACKET_TX_RING)");
+        close(fd);
+        return -1;
+    }
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = 0;
+    sll.sll_ifindex = g_cfg.ifindex;
+    if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0)
+    {
+        perror("bind(AF_PACKET)");
+        munmap(w->ring, w->ring_len);
+        close(fd);
+        return -1;
+    }
+    w->fd = fd;
+    return 0;
+}
+
+/* =================== Send paths =================== */
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// slots [cur, cur + n) mutated and handed to sendmmsg(); returns packets sent
+static unsigned send_mmsg(struct worker *w, unsigned n)
+{
+    unsigned base = w->cur;
+    for (unsigned i = base; i < base + n; i++)
+        pkt_mutate(w, w->pool + (size_t)i * SLOT_SIZE, w->kind[i], &w->dst[i]);
+    unsigned done = 0;
+    while (done < n && !g_stop)
+    {
+        int r = sendmmsg(w->fd, w->msgs + base + done, n - done, 0);
+        if (r < 0)
+        {
+            if (errno == ENOBUFS || errno == EAGAIN || errno == EINTR)
+                continue; // qdisc or device queue full: retry
+            atomic_fetch_add_explicit(&w->errs, 1, memory_order_relaxed);
+            break;
+        }
+        done += (unsigned)r;
+    }
+    unsigned long bytes = 0;
+    for (unsigned i = base; i < base + done; i++)
+        bytes += w->len[i];
+    atomic_fetch_add_explicit(&w->pkts, done, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->bytes, bytes, memory_order_relaxed);
+    w->cur = (base + n) % w->npool;
+    return done;
+}
+
+// n frames written into the TX ring, then one kick; returns packets queued
+static unsigned send_ring(struct worker *w, unsigned n)
+{
+    const size_t data_off = TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    unsigned done = 0;
+    unsigned long bytes = 0;
+    while (done < n && !g_stop)
+    {
+        struct tpacket2_hdr *hdr = (struct tpacket2_hdr *)(w->ring + (size_t)w->ring_cur * RING_FRAME);
+        uint32_t st = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+        if (st == TP_STATUS_WRONG_FORMAT)
+        {
+            atomic_fetch_add_explicit(&w->errs, 1, memory_order_relaxed);
+            st = TP_STATUS_AVAILABLE;
+        }
+        if (st != TP_STATUS_AVAILABLE)
+        {
+            // ring full: have the kernel send what is queued, then wait for room
+            if (done && send(w->fd, NULL, 0, MSG_DONTWAIT) < 0 && errno != EAGAIN && errno != ENOBUFS)
+                atomic_fetch_add_explicit(&w->errs, 1, memory_order_relaxed);
+            struct pollfd pfd = {.fd = w->fd, .events = POLLOUT};
+            poll(&pfd, 1, 10);
+            continue;
+        }
+        unsigned slot = w->cur;
+        uint8_t *p = w->pool + (size_t)slot * SLOT_SIZE;
+        pkt_mutate(w, p, w->kind[slot], &w->dst[slot]);
+        uint8_t *frame = (uint8_t *)hdr + data_off;
+        struct ethhdr *eth = (struct ethhdr *)frame;
+        memcpy(eth->h_dest, g_cfg.dst_mac, 6);
+        memcpy(eth->h_source, g_cfg.src_mac, 6);
+        eth->h_proto = htons(ETH_P_IP);
+        memcpy(frame + sizeof(*eth), p, w->len[slot]);
+        hdr->tp_len = (uint32_t)(sizeof(*eth) + w->len[slot]);
+        __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+        w->ring_cur = (w->ring_cur + 1) % RING_FRAMES;
+        w->cur = (slot + 1) % w->npool;
+        bytes += w->len[slot];
+        done++;
+    }
+    if (done && send(w->fd, NULL, 0, MSG_DONTWAIT) < 0 && errno != EAGAIN && errno != ENOBUFS)
+        atomic_fetch_add_explicit(&w->errs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->pkts, done, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->bytes, bytes, memory_order_relaxed);
+    return done;
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    if (w->cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    // token bucket: rate/threads tokens a second, at most one batch banked
+    double rate = g_cfg.rate / g_cfg.threads, tokens = 0, last = now_sec();
+    unsigned long sent = 0;
+    while (!g_stop && (!w->quota || sent < w->quota))
+    {
+        unsigned n = g_cfg.batch;
+        if (rate > 0)
+        {
+            double t = now_sec();
+            tokens += (t - last) * rate;
+            last = t;
+            if (tokens > g_cfg.batch)
+                tokens = g_cfg.batch;
+            if (tokens < 1)
+            {
+                double wait = (1 - tokens) / rate;
+                if (wait > 50e-6) // sleep long waits, spin short ones
+                {
+                    struct timespec ts = {0, (long)(wait * 1e9)};
+                    nanosleep(&ts, NULL);
+                }
+                continue;
+            }
+            n = (unsigned)tokens;
+        }
+        if (w->quota && n > w->quota - sent)
+            n = (unsigned)(w->quota - sent);
+        // sendmmsg works on whole slices of the pool
+        if (n > w->npool - w->cur)
+            n = w->npool - w->cur;
+        unsigned k = g_cfg.ifname ? send_ring(w, n) : send_mmsg(w, n);
+        sent += k;
+        tokens -= k;
+    }
+    return NULL;
+}
+
+static void worker_stats(struct worker *w, double secs, bool final)
+{
+    unsigned long pkts = atomic_load_explicit(&w->pkts, memory_order_relaxed);
+    unsigned long bytes = atomic_load_explicit(&w->bytes, memory_order_relaxed);
+    unsigned long errs = atomic_load_explicit(&w->errs, memory_order_relaxed);
+    if (final)
+        fprintf(stderr, "[total] t%d: %lu pkts %lu bytes errors %lu\n", w->id, pkts, bytes, errs);
+    else
+        fprintf(stderr, "[stats] t%d cpu%d: %10.0f pkt/s %9.1f Mbit/s errors %lu\n", w->id, w->cpu,
+                (double)(pkts - w->last_pkts) / secs, (double)(bytes - w->last_bytes) * 8 / secs / 1e6, errs);
+    w->last_pkts = pkts;
+    w->last_bytes = bytes;
+}
+
+/* =================== Options =================== */
+// "a.b.c.d" or "a.b.c.d/len" -> base (host order) and address count
+static int parse_prefix(const char *s, uint32_t *base, uint32_t *n)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s", s);
+    int len = 32;
+    char *slash = strchr(buf, '/');
+    if (slash)
+    {
+        *slash = 0;
+        len = atoi(slash + 1);
+        if (len < 1 || len > 32)
+            return -1;
+    }
+    struct in_addr a;
+    if (inet_pton(AF_INET, buf, &a) != 1)
+        return -1;
+    uint32_t mask = len == 32 ? 0xFFFFFFFFu : ~(0xFFFFFFFFu >> len);
+    *base = ntohl(a.s_addr) & mask;
+    *n = (uint32_t)(~mask + 1u);
+    if (len == 32)
+        *n = 1;
+    else if (len < 31) // skip the network and broadcast addresses
+    {
+        *base += 1;
+        *n -= 2;
+    }
+    return 0;
+}
+
+static int parse_ports(const char *s, uint16_t *lo, uint16_t *hi)
+{
+    char *end;
+    long a = strtol(s, &end, 10), b = a;
+    if (*end == '-')
+        b = strtol(end + 1, &end, 10);
+    if (*end || a < 0 || b > 65535 || a > b)
+        return -1;
+    *lo = (uint16_t)a;
+    *hi = (uint16_t)b;
+    return 0;
+}
+
+static int parse_mix(char *s)
+{
+    memset(g_cfg.weight, 0, sizeof(g_cfg.weight));
+    for (char *tok = strtok(s, ","); tok; tok = strtok(NULL, ","))
+    {
+        char *colon = strchr(tok, ':');
+        unsigned wgt = 1;
+        if (colon)
+        {
+            *colon = 0;
+            wgt = (unsigned)atoi(colon + 1);
+        }
+        int t = 0;
+        while (t < T_KINDS && strcmp(tok, kind_names[t]))
+            t++;
+        if (t == T_KINDS || !wgt)
+            return -1;
+        g_cfg.weight[t] += wgt;
+    }
+    return 0;
+}
+
+static int parse_mac(const char *s, uint8_t mac[6])
+{
+    unsigned m[6];
+    if (sscanf(s, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6)
+        return -1;
+    for (int i = 0; i < 6; i++)
+        mac[i] = (uint8_t)m[i];
+    return 0;
+}
+
+// the source address the kernel would use towards dst
+static int route_source(uint32_t dst, uint32_t *src)
+{
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s < 0)
+        return -1;
+    struct sockaddr_in a = {.sin_family = AF_INET, .sin_port = htons(9), .sin_addr.s_addr = htonl(dst)};
+    socklen_t len = sizeof(a);
+    int rc = connect(s, (struct sockaddr *)&a, sizeof(a)) == 0 && getsockname(s, (struct sockaddr *)&a, &len) == 0
+                 ? 0
+                 : -1;
+    close(s);
+    *src = ntohl(a.sin_addr.s_addr);
+    return rc;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s -d dst[/len] [-s src[/len]] [-m syn:60,udp:30,icmp:10]\n"
+            "          [-p port[-port]] [-P port[-port]] [-l payload] [-x ttl]\n"
+            "          [-t threads] [-r pps] [-b batch] [-T secs] [-n count]\n"
+            "          [-i iface [-M dst_mac] [-Q]]\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    bool have_dst = false, have_src = false;
+    g_cfg.weight[T_UDP] = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:s:m:p:P:l:x:t:r:b:T:n:i:M:Q")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            if (parse_prefix(optarg, &g_cfg.dst, &g_cfg.ndst) != 0)
+            {
+                fprintf(stderr, "bad destination: %s\n", optarg);
+                return 1;
+            }
+            have_dst = true;
+            break;
+        case 's':
+            if (parse_prefix(optarg, &g_cfg.src, &g_cfg.nsrc) != 0)
+            {
+                fprintf(stderr, "bad source: %s\n", optarg);
+                return 1;
+            }
+            have_src = true;
+            break;
+        case 'm':
+            if (parse_mix(optarg) != 0)
+            {
+                fprintf(stderr, "bad mix (want e.g. syn:60,udp:30,icmp:10)\n");
+                return 1;
+            }
+            break;
+        case 'p':
+        case 'P':
+            if (parse_ports(optarg, opt == 'p' ? &g_cfg.dport_lo : &g_cfg.sport_lo,
+                            opt == 'p' ? &g_cfg.dport_hi : &g_cfg.sport_hi) != 0)
+            {
+                fprintf(stderr, "bad port range: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'l':
+            g_cfg.payload = (unsigned)atoi(optarg);
+            break;
+        case 'x':
+            g_cfg.ttl = (uint8_t)atoi(optarg);
+            break;
+        case 't':
+            g_cfg.threads = atoi(optarg);
+            break;
+        case 'r':
+            g_cfg.rate = atof(optarg);
+            break;
+        case 'b':
+            g_cfg.batch = (unsigned)atoi(optarg);
+            break;
+        case 'T':
+            g_cfg.secs = atof(optarg);
+            break;
+        case 'n':
+            g_cfg.count = strtoul(optarg, NULL, 10);
+            break;
+        case 'i':
+            g_cfg.ifname = optarg;
+            break;
+        case 'M':
+            if (parse_mac(optarg, g_cfg.dst_mac) != 0)
+            {
+                fprintf(stderr, "bad MAC: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'Q':
+            g_cfg.qdisc_bypass = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!have_dst || g_cfg.threads < 1 || g_cfg.threads > 1024 || g_cfg.batch < 1 || g_cfg.batch > 1024 ||
+        g_cfg.payload > 1472 || g_cfg.rate < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!have_src)
+    {
+        g_cfg.nsrc = 1;
+        if (route_source(g_cfg.dst, &g_cfg.src) != 0)
+        {
+            perror("no route to destination");
+            return 1;
+        }
+    }
+    if (g_cfg.ifname)
+    {
+        g_cfg.ifindex = (int)if_nametoindex(g_cfg.ifname);
+        if (!g_cfg.ifindex)
+        {
+            perror("if_nametoindex");
+            return 1;
+        }
+        struct ifreq ifr;
+        memset(&ifr, 0, sizeof(ifr));
+        snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", g_cfg.ifname);
+        int s = socket(AF_INET, SOCK_DGRAM, 0);
+        if (s >= 0 && ioctl(s, SIOCGIFHWADDR, &ifr) == 0)
+            memcpy(g_cfg.src_mac, ifr.ifr_hwaddr.sa_data, 6);
+        if (s >= 0)
+            close(s);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigint;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // threads go on the CPUs we may run on, one each, wrapping if there are more threads
+    cpu_set_t allowed;
+    int cpus[CPU_SETSIZE], ncpu = 0;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        for (int c = 0; c < CPU_SETSIZE; c++)
+            if (CPU_ISSET(c, &allowed))
+                cpus[ncpu++] = c;
+    struct worker *ws = calloc((size_t)g_cfg.threads, sizeof(*ws));
+    if (!ws)
+    {
+        perror("calloc");
+        return 1;
+    }
+    int started = 0, rc = 0;
+    for (int i = 0; i < g_cfg.threads; i++)
+    {
+        struct worker *w = &ws[i];
+        w->id = i;
+        w->cpu = ncpu ? cpus[i % ncpu] : -1;
+        w->rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1) ^ (uint64_t)time(NULL) ^ (uint64_t)getpid() << 32;
+        w->quota = g_cfg.count ? g_cfg.count / g_cfg.threads + (i < (int)(g_cfg.count % g_cfg.threads)) : 0;
+        if (g_cfg.count && !w->quota)
+            break;
+        if (pool_setup(w) != 0 || (g_cfg.ifname ? ring_setup(w) : raw_setup(w)) != 0)
+        {
+            rc = 1;
+            break;
+        }
+        started++;
+    }
+
+    char sbuf[INET_ADDRSTRLEN], dbuf[INET_ADDRSTRLEN];
+    struct in_addr sa4 = {htonl(g_cfg.src)}, da4 = {htonl(g_cfg.dst)};
+    inet_ntop(AF_INET, &sa4, sbuf, sizeof(sbuf));
+    inet_ntop(AF_INET, &da4, dbuf, sizeof(dbuf));
+    if (rc == 0)
+    {
+        printf("Sending to %s (x%u) from %s (x%u), mix syn:%u udp:%u icmp:%u, %d thread(s), batch %u, %s%s. "
+               "Press Ctrl+C to stop.\n",
+               dbuf, g_cfg.ndst, sbuf, g_cfg.nsrc, g_cfg.weight[T_SYN], g_cfg.weight[T_UDP], g_cfg.weight[T_ICMP],
+               started, g_cfg.batch, g_cfg.ifname ? "TX ring on " : "sendmmsg", g_cfg.ifname ? g_cfg.ifname : "");
+        fflush(stdout);
+        for (int i = 0; i < started; i++)
+            if (pthread_create(&ws[i].th, NULL, worker_main, &ws[i]) != 0)
+            {
+                perror("pthread_create");
+                g_stop = 1;
+                started = i;
+                rc = 1;
+                break;
+            }
+    }
+    double t0 = now_sec(), last = t0;
+    while (rc == 0 && !g_stop)
+    {
+        struct timespec ts = {0, 100 * 1000000L};
+        nanosleep(&ts, NULL);
+        double t = now_sec();
+        if (g_cfg.secs > 0 && t - t0 >= g_cfg.secs)
+            g_stop = 1;
+        if (g_cfg.count)
+        {
+            unsigned long sum = 0;
+            for (int i = 0; i < started; i++)
+                sum += atomic_load_explicit(&ws[i].pkts, memory_order_relaxed);
+            if (sum >= g_cfg.count)
+                break; // the workers stop on their quotas
+        }
+        if (t - last < 1.0 || g_stop)
+            continue;
+        unsigned long pkts = 0, bytes = 0;
+        for (int i = 0; i < started; i++)
+        {
+            struct worker *w = &ws[i];
+            unsigned long p = atomic_load_explicit(&w->pkts, memory_order_relaxed);
+            unsigned long b = atomic_load_explicit(&w->bytes, memory_order_relaxed);
+            pkts += p - w->last_pkts;
+            bytes += b - w->last_bytes;
+            if (started > 1)
+                worker_stats(w, t - last, false); // also advances last_*
+            else
+            {
+                w->last_pkts = p;
+                w->last_bytes = b;
+            }
+        }
+        fprintf(stderr, "[stats] all: %10.0f pkt/s %9.3f Gbit/s (IP bytes)\n", pkts / (t - last),
+                bytes * 8 / (t - last) / 1e9);
+        last = t;
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(ws[i].th, NULL);
+    double dt = now_sec() - t0;
+    unsigned long total = 0, tbytes = 0;
+    for (int i = 0; i < g_cfg.threads; i++)
+    {
+        struct worker *w = &ws[i];
+        if (i < started)
+        {
+            worker_stats(w, 1, true);
+            total += w->pkts;
+            tbytes += w->bytes;
+        }
+        if (w->ring)
+            munmap(w->ring, w->ring_len);
+        if (w->fd > 0)
+            close(w->fd);
+        free(w->pool);
+        free(w->kind);
+        free(w->len);
+        free(w->dst);
+        free(w->msgs);
+        free(w->iov);
+    }
+    free(ws);
+    printf("Sent %lu packet(s) in %.2f s: %.0f pkt/s, %.3f Gbit/s. Bye.\n", total, dt, total / dt,
+           tbytes * 8 / dt / 1e9);
+    return rc;
+}
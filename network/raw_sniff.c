@@ -1,33 +1,62 @@
 // sniff_raw.c - raw-socket packet sniffer for Linux (AF_PACKET)
-// Build: gcc -O2 -Wall -Wextra -o sniff_raw sniff_raw.c
-// Usage: sudo ./sniff_raw [-i iface] [-p] [-x] [-n count]
+// Build: gcc -O2 -Wall -Wextra -pthread -o sniff_raw sniff_raw.c
+// Usage: sudo ./sniff_raw [-i iface] [-p] [-x] [-q] [-n count]
+//                         [-r] [-w workers] [-F hash|lb|cpu|rollover] [-b block_kb] [-B blocks]
+//                         [-s snaplen] [-o file.pcapng [-D] [-M buf_mb]] [-d] [filter expression]
 //
 //  -i iface   Interface name (e.g., eth0). If omitted, receives from all.
 //  -p         Enable promiscuous mode (requires -i).
 //  -x         Hex dump packet payload.
+//  -q         Quiet: count only, print no packets (use with -r/-w at high rates).
 //  -n count   Stop after capturing 'count' packets.
+//  -r         Receive from a TPACKET_V3 mmap'd block ring instead of recvfrom().
+//  -w N       N ring workers, one per core, sharing the traffic via PACKET_FANOUT (implies -r).
+//  -F mode    Fanout mode: hash (default, flow-consistent, defragments), lb, cpu, rollover.
+//  -b KB      Ring block size in KiB (default 1024; rounded up to a power-of-two page count).
+//  -B n       Ring blocks per worker (default 64).
+//  -s len     Keep at most len bytes of each packet (in ring mode the kernel truncates).
+//  -o file    Write a pcapng file instead of printing packets (4 buffers of -M MiB, default 4).
+//  -D         Open the pcapng file with O_DIRECT.
+//  -d         Print the compiled BPF program and exit.
+//  filter     e.g. "tcp and port 443", "udp and src host 10.0.0.1", "ip6 and icmp";
+//             compiled to classic BPF and attached with SO_ATTACH_FILTER (see filter_parse).
 //
 // Notes:
 //  * Requires root privileges.
 //  * Linux only (uses PF_PACKET / SOCK_RAW / ETH_P_ALL).
 //  * Promiscuous mode is attached as a membership; it’s removed when the socket closes.
+//  * Ring mode reads frames in place: no copy and no syscall per packet; the kernel
+//    hands over a block at a time. Each second it prints, per worker, packets/s,
+//    Mbit/s and the kernel's tp_drops (frames lost because the ring was full) and
+//    freeze count to stderr; size -b/-B until drops stay at zero.
 
 #define _GNU_SOURCE
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <linux/filter.h>
 #include <linux/if_packet.h>
 #include <linux/if_ether.h>
-#include <linux/if.h>
 #include <net/ethernet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 static volatile sig_atomic_t g_stop = 0;
@@ -37,33 +66,77 @@ static void on_sigint(int signo)
     g_stop = 1;
 }
 
-static void hex_dump(const unsigned char *buf, size_t len)
+// Output is formatted into a per-thread buffer and written with one fwrite,
+// so lines from several ring workers do not interleave.
+struct out
+{
+    char *p;
+    size_t n, cap;
+};
+
+static void out_printf(struct out *o, const char *fmt, ...)
+{
+    for (;;)
+    {
+        va_list ap;
+        va_start(ap, fmt);
+        int k = vsnprintf(o->p + o->n, o->cap - o->n, fmt, ap);
+        va_end(ap);
+        if (k < 0)
+            return;
+        if (o->n + (size_t)k < o->cap)
+        {
+            o->n += (size_t)k;
+            return;
+        }
+        size_t cap = o->cap ? o->cap * 2 : 4096;
+        while (cap <= o->n + (size_t)k)
+            cap *= 2;
+        char *p = realloc(o->p, cap);
+        if (!p)
+        {
+            perror("realloc");
+            exit(1);
+        }
+        o->p = p;
+        o->cap = cap;
+    }
+}
+
+static void out_flush(struct out *o)
+{
+    if (o->n)
+        fwrite(o->p, 1, o->n, stdout);
+    o->n = 0;
+}
+
+static void hex_dump(struct out *o, const unsigned char *buf, size_t len)
 {
     const size_t cols = 16;
     for (size_t i = 0; i < len; i += cols)
     {
-        printf("%04zx  ", i);
+        out_printf(o, "%04zx  ", i);
         for (size_t j = 0; j < cols; ++j)
         {
             if (i + j < len)
-                printf("%02x ", buf[i + j]);
+                out_printf(o, "%02x ", buf[i + j]);
             else
-                printf("   ");
+                out_printf(o, "   ");
         }
-        printf(" ");
+        out_printf(o, " ");
         for (size_t j = 0; j < cols; ++j)
         {
             if (i + j < len)
             {
                 unsigned char c = buf[i + j];
-                printf("%c", (c >= 32 && c <= 126) ? c : '.');
+                out_printf(o, "%c", (c >= 32 && c <= 126) ? c : '.');
             }
         }
-        printf("\n");
+        out_printf(o, "\n");
     }
 }
 
-static void print_ip_port_proto(const unsigned char *pkt, size_t len, uint16_t ethertype)
+static void print_ip_port_proto(struct out *o, const unsigned char *pkt, size_t len, uint16_t ethertype)
 {
     if (ethertype == ETH_P_IP)
     {
@@ -83,19 +156,19 @@ static void print_ip_port_proto(const unsigned char *pkt, size_t len, uint16_t e
         {
             if ((size_t)(l4 - pkt + 4) > len)
             {
-                printf(" IPv4 %s -> %s proto=%u\n", src, dst, proto);
+                out_printf(o, " IPv4 %s -> %s proto=%u", src, dst, proto);
                 return;
             }
             uint16_t sport = (uint16_t)(l4[0] << 8 | l4[1]);
             uint16_t dport = (uint16_t)(l4[2] << 8 | l4[3]);
-            printf(" IPv4 %s:%u -> %s:%u %s\n",
-                   src, ntohs(*(uint16_t *)&l4[0]),
-                   dst, ntohs(*(uint16_t *)&l4[2]),
-                   (proto == IPPROTO_TCP) ? "TCP" : "UDP");
+            out_printf(o, " IPv4 %s:%u -> %s:%u %s",
+                       src, sport,
+                       dst, dport,
+                       (proto == IPPROTO_TCP) ? "TCP" : "UDP");
         }
         else
         {
-            printf(" IPv4 %s -> %s proto=%u\n", src, dst, proto);
+            out_printf(o, " IPv4 %s -> %s proto=%u", src, dst, proto);
         }
     }
     else if (ethertype == ETH_P_IPV6)
@@ -110,7 +183,7 @@ static void print_ip_port_proto(const unsigned char *pkt, size_t len, uint16_t e
         memcpy(&d6, ip6 + 24, 16);
         inet_ntop(AF_INET6, &s6, src, sizeof(src));
         inet_ntop(AF_INET6, &d6, dst, sizeof(dst));
-        printf(" IPv6 %s -> %s next=%u\n", src, dst, next);
+        out_printf(o, " IPv6 %s -> %s next=%u", src, dst, next);
     }
     else
     {
@@ -118,7 +191,7 @@ static void print_ip_port_proto(const unsigned char *pkt, size_t len, uint16_t e
     }
 }
 
-static void print_eth_header(const unsigned char *pkt, size_t len, uint16_t *out_ethertype)
+static void print_eth_header(struct out *o, const unsigned char *pkt, size_t len, uint16_t *out_ethertype)
 {
     if (len < 14)
         return;
@@ -127,10 +200,931 @@ static void print_eth_header(const unsigned char *pkt, size_t len, uint16_t *out
     uint16_t type = (uint16_t)(pkt[12] << 8 | pkt[13]);
     *out_ethertype = type;
 
-    printf(" ETH %02x:%02x:%02x:%02x:%02x:%02x -> %02x:%02x:%02x:%02x:%02x:%02x type=0x%04x",
-           s[0], s[1], s[2], s[3], s[4], s[5],
-           d[0], d[1], d[2], d[3], d[4], d[5],
-           type);
+    out_printf(o, " ETH %02x:%02x:%02x:%02x:%02x:%02x -> %02x:%02x:%02x:%02x:%02x:%02x type=0x%04x",
+               s[0], s[1], s[2], s[3], s[4], s[5],
+               d[0], d[1], d[2], d[3], d[4], d[5],
+               type);
+}
+
+// One line (plus optional hex dump) per packet. caplen bytes are at pkt; len is the wire length.
+static void print_packet(struct out *o, const unsigned char *pkt, size_t caplen, size_t len,
+                         long sec, long usec, const char *iname, bool do_hex)
+{
+    uint16_t ethertype = 0;
+    out_printf(o, "[%ld.%06ld] if=%s len=%zu", sec, usec, iname, len);
+    if (caplen < len)
+        out_printf(o, " cap=%zu", caplen);
+    print_eth_header(o, pkt, caplen, &ethertype);
+    print_ip_port_proto(o, pkt, caplen, ethertype); // already host order
+    out_printf(o, "\n");
+    if (do_hex)
+    {
+        hex_dump(o, pkt, caplen);
+        out_printf(o, "\n");
+    }
+}
+
+// ---- In-kernel filter: a small expression compiled to classic BPF ----
+//
+//   expr := prim [and prim]...
+//   prim := ip | ip6 | arp | tcp | udp | icmp
+//         | [src|dst] host ADDR      (IPv4 or IPv6, matching the family)
+//         | [src|dst] port N         (TCP or UDP; IPv4 first fragments only)
+//
+// The program is attached with SO_ATTACH_FILTER so rejected packets are never
+// queued to us; its accept value is the snaplen, so the kernel also truncates.
+
+#define BPF_MAX 96
+#define BPF_NEXT (-1) // jump target: fall through
+#define BPF_REJ (-2)  // jump target: the final "ret #0"
+
+struct bpf_out
+{
+    struct sock_filter ins[BPF_MAX];
+    int jt[BPF_MAX], jf[BPF_MAX]; // absolute targets, or BPF_NEXT / BPF_REJ
+    int n;
+    bool overflow;
+};
+
+static int bpf_emit(struct bpf_out *b, uint16_t code, int jt, int jf, uint32_t k)
+{
+    if (b->n >= BPF_MAX - 2)
+    {
+        b->overflow = true;
+        return b->n;
+    }
+    b->ins[b->n] = (struct sock_filter){code, 0, 0, k};
+    b->jt[b->n] = jt;
+    b->jf[b->n] = jf;
+    return b->n++;
+}
+
+struct filter
+{
+    int family; // 0 any, 4, 6, or ETH_P_ARP
+    int proto;  // -1 any, else IP protocol
+    int nhosts, nports;
+    struct
+    {
+        int dir; // 0 either, 1 src, 2 dst
+        unsigned char addr[16];
+    } hosts[8];
+    struct
+    {
+        int dir;
+        uint16_t port;
+    } ports[8];
+};
+
+static int filter_parse(struct filter *f, char **words, int n)
+{
+    memset(f, 0, sizeof(*f));
+    f->proto = -1;
+    for (int i = 0; i < n; i++)
+    {
+        const char *w = words[i];
+        int dir = 0;
+        if (strcmp(w, "and") == 0 || strcmp(w, "&&") == 0)
+            continue;
+        if (strcmp(w, "ip") == 0 || strcmp(w, "ip6") == 0 || strcmp(w, "arp") == 0)
+        {
+            int fam = w[1] == 'r' ? ETH_P_ARP : w[2] == '6' ? 6 : 4;
+            if (f->family && f->family != fam)
+            {
+                fprintf(stderr, "filter: '%s' contradicts an earlier family\n", w);
+                return -1;
+            }
+            f->family = fam;
+            continue;
+        }
+        if (strcmp(w, "tcp") == 0 || strcmp(w, "udp") == 0 || strcmp(w, "icmp") == 0)
+        {
+            int proto = w[0] == 't' ? IPPROTO_TCP : w[0] == 'u' ? IPPROTO_UDP : IPPROTO_ICMP;
+            if (f->proto >= 0 && f->proto != proto)
+            {
+                fprintf(stderr, "filter: '%s' contradicts an earlier protocol\n", w);
+                return -1;
+            }
+            f->proto = proto;
+            continue;
+        }
+        if (strcmp(w, "src") == 0 || strcmp(w, "dst") == 0)
+        {
+            dir = w[0] == 's' ? 1 : 2;
+            if (++i >= n)
+                break;
+            w = words[i];
+        }
+        bool is_host = strcmp(w, "host") == 0;
+        if (!is_host && strcmp(w, "port") != 0)
+        {
+            fprintf(stderr, "filter: unexpected '%s'\n", w);
+            return -1;
+        }
+        if (++i >= n)
+        {
+            fprintf(stderr, "filter: '%s' needs an argument\n", w);
+            return -1;
+        }
+        const char *arg = words[i];
+        if (is_host)
+        {
+            if (f->nhosts == 8)
+            {
+                fprintf(stderr, "filter: too many hosts\n");
+                return -1;
+            }
+            int fam = strchr(arg, ':') ? 6 : 4;
+            if (inet_pton(fam == 6 ? AF_INET6 : AF_INET, arg, f->hosts[f->nhosts].addr) != 1)
+            {
+                fprintf(stderr, "filter: bad address '%s'\n", arg);
+                return -1;
+            }
+            if (f->family && f->family != fam)
+            {
+                fprintf(stderr, "filter: '%s' is not of the filter's address family\n", arg);
+                return -1;
+            }
+            f->family = fam;
+            f->hosts[f->nhosts++].dir = dir;
+        }
+        else
+        {
+            char *end;
+            long port = strtol(arg, &end, 10);
+            if (*end || port < 0 || port > 65535 || f->nports == 8)
+            {
+                fprintf(stderr, "filter: bad or too many port(s) '%s'\n", arg);
+                return -1;
+            }
+            f->ports[f->nports].dir = dir;
+            f->ports[f->nports++].port = (uint16_t)port;
+        }
+    }
+    if (f->nports && f->proto >= 0 && f->proto != IPPROTO_TCP && f->proto != IPPROTO_UDP)
+    {
+        fprintf(stderr, "filter: port needs tcp or udp\n");
+        return -1;
+    }
+    if (!f->family && (f->proto >= 0 || f->nports))
+        f->family = 4;
+    return 0;
+}
+
+// Match one address at [off]: jump to 'ok' or 'fail' (absolute / BPF_NEXT / BPF_REJ).
+static void bpf_addr(struct bpf_out *b, uint32_t off, const unsigned char *addr, int words, int ok, int fail)
+{
+    for (int w = 0; w < words; w++)
+    {
+        uint32_t k = (uint32_t)addr[4 * w] << 24 | (uint32_t)addr[4 * w + 1] << 16 |
+                     (uint32_t)addr[4 * w + 2] << 8 | addr[4 * w + 3];
+        bpf_emit(b, BPF_LD | BPF_W | BPF_ABS, BPF_NEXT, BPF_NEXT, off + 4 * (uint32_t)w);
+        bpf_emit(b, BPF_JMP | BPF_JEQ | BPF_K, w == words - 1 ? ok : BPF_NEXT, fail, k);
+    }
+}
+
+// Either the src or the dst field at off_a / off_b matches: emit both, patching
+// the first's failure to the second and its success past it.
+static void bpf_either(struct bpf_out *b, uint32_t off_a, uint32_t off_b, uint16_t size, const unsigned char *addr,
+                       uint16_t port, int words)
+{
+    int first = b->n;
+    if (words)
+        bpf_addr(b, off_a, addr, words, -100, -101);
+    else
+    {
+        bpf_emit(b, BPF_LD | size | BPF_IND, BPF_NEXT, BPF_NEXT, off_a);
+        bpf_emit(b, BPF_JMP | BPF_JEQ | BPF_K, -100, -101, port);
+    }
+    int second = b->n;
+    if (words)
+        bpf_addr(b, off_b, addr, words, BPF_NEXT, BPF_REJ);
+    else
+    {
+        bpf_emit(b, BPF_LD | size | BPF_IND, BPF_NEXT, BPF_NEXT, off_b);
+        bpf_emit(b, BPF_JMP | BPF_JEQ | BPF_K, BPF_NEXT, BPF_REJ, port);
+    }
+    for (int i = first; i < second; i++)
+    {
+        if (b->jt[i] == -100)
+            b->jt[i] = b->n;
+        if (b->jf[i] == -101)
+            b->jf[i] = second;
+    }
+}
+
+// Compile f (NULL: accept everything) into prog; returns the instruction count or -1.
+static int filter_compile(const struct filter *f, uint32_t snaplen, struct sock_filter *prog)
+{
+    struct bpf_out b;
+    memset(&b, 0, sizeof(b));
+    if (f && f->family)
+    {
+        bpf_emit(&b, BPF_LD | BPF_H | BPF_ABS, BPF_NEXT, BPF_NEXT, 12);
+        bpf_emit(&b, BPF_JMP | BPF_JEQ | BPF_K, BPF_NEXT, BPF_REJ,
+                 f->family == ETH_P_ARP ? ETH_P_ARP : f->family == 6 ? ETH_P_IPV6 : ETH_P_IP);
+    }
+    if (f && (f->family == 4 || f->family == 6))
+    {
+        bool v6 = f->family == 6;
+        uint32_t proto_off = v6 ? 14 + 6 : 14 + 9;
+        if (f->proto >= 0)
+        {
+            bpf_emit(&b, BPF_LD | BPF_B | BPF_ABS, BPF_NEXT, BPF_NEXT, proto_off);
+            bpf_emit(&b, BPF_JMP | BPF_JEQ | BPF_K, BPF_NEXT, BPF_REJ,
+                     v6 && f->proto == IPPROTO_ICMP ? IPPROTO_ICMPV6 : (uint32_t)f->proto);
+        }
+        else if (f->nports)
+        {
+            bpf_emit(&b, BPF_LD | BPF_B | BPF_ABS, BPF_NEXT, BPF_NEXT, proto_off);
+            int j = bpf_emit(&b, BPF_JMP | BPF_JEQ | BPF_K, -100, BPF_NEXT, IPPROTO_TCP);
+            bpf_emit(&b, BPF_JMP | BPF_JEQ | BPF_K, BPF_NEXT, BPF_REJ, IPPROTO_UDP);
+            b.jt[j] = b.n;
+        }
+        for (int i = 0; i < f->nhosts; i++)
+        {
+            uint32_t src = v6 ? 14 + 8 : 14 + 12, dst = v6 ? 14 + 24 : 14 + 16;
+            int words = v6 ? 4 : 1;
+            if (f->hosts[i].dir)
+                bpf_addr(&b, f->hosts[i].dir == 1 ? src : dst, f->hosts[i].addr, words, BPF_NEXT, BPF_REJ);
+            else
+                bpf_either(&b, src, dst, 0, f->hosts[i].addr, 0, words);
+        }
+        if (f->nports)
+        {
+            if (v6)
+                bpf_emit(&b, BPF_LDX | BPF_W | BPF_IMM, BPF_NEXT, BPF_NEXT, 40); // no extension headers
+            else
+            {
+                bpf_emit(&b, BPF_LD | BPF_H | BPF_ABS, BPF_NEXT, BPF_NEXT, 14 + 6);
+                bpf_emit(&b, BPF_JMP | BPF_JSET | BPF_K, BPF_REJ, BPF_NEXT, 0x1fff); // later fragment
+                bpf_emit(&b, BPF_LDX | BPF_B | BPF_MSH, BPF_NEXT, BPF_NEXT, 14);
+            }
+            for (int i = 0; i < f->nports; i++)
+            {
+                uint16_t port = f->ports[i].port;
+                if (f->ports[i].dir)
+                {
+                    bpf_emit(&b, BPF_LD | BPF_H | BPF_IND, BPF_NEXT, BPF_NEXT, f->ports[i].dir == 1 ? 14 : 16);
+                    bpf_emit(&b, BPF_JMP | BPF_JEQ | BPF_K, BPF_NEXT, BPF_REJ, port);
+                }
+                else
+                    bpf_either(&b, 14, 16, BPF_H, NULL, port, 0);
+            }
+        }
+    }
+    bpf_emit(&b, BPF_RET | BPF_K, BPF_NEXT, BPF_NEXT, snaplen);
+    int rej = bpf_emit(&b, BPF_RET | BPF_K, BPF_NEXT, BPF_NEXT, 0);
+    if (b.overflow)
+    {
+        fprintf(stderr, "filter: program too long\n");
+        return -1;
+    }
+    for (int i = 0; i < b.n; i++)
+    {
+        int t[2] = {b.jt[i], b.jf[i]};
+        for (int k = 0; k < 2; k++)
+        {
+            int to = t[k] == BPF_NEXT ? i + 1 : t[k] == BPF_REJ ? rej : t[k];
+            if (to - (i + 1) < 0 || to - (i + 1) > 255)
+            {
+                fprintf(stderr, "filter: jump out of range\n");
+                return -1;
+            }
+            if (k == 0)
+                b.ins[i].jt = (uint8_t)(to - (i + 1));
+            else
+                b.ins[i].jf = (uint8_t)(to - (i + 1));
+        }
+        prog[i] = b.ins[i];
+    }
+    return b.n;
+}
+
+// tcpdump -d style listing
+static void filter_dump(const struct sock_filter *prog, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        const struct sock_filter *in = &prog[i];
+        char op[48];
+        switch (in->code)
+        {
+        case BPF_LD | BPF_W | BPF_ABS: snprintf(op, sizeof(op), "ld       [%u]", in->k); break;
+        case BPF_LD | BPF_H | BPF_ABS: snprintf(op, sizeof(op), "ldh      [%u]", in->k); break;
+        case BPF_LD | BPF_B | BPF_ABS: snprintf(op, sizeof(op), "ldb      [%u]", in->k); break;
+        case BPF_LD | BPF_H | BPF_IND: snprintf(op, sizeof(op), "ldh      [x + %u]", in->k); break;
+        case BPF_LDX | BPF_B | BPF_MSH: snprintf(op, sizeof(op), "ldxb     4*([%u]&0xf)", in->k); break;
+        case BPF_LDX | BPF_W | BPF_IMM: snprintf(op, sizeof(op), "ldx      #%u", in->k); break;
+        case BPF_RET | BPF_K: snprintf(op, sizeof(op), "ret      #%u", in->k); break;
+        case BPF_JMP | BPF_JEQ | BPF_K: snprintf(op, sizeof(op), "jeq      #0x%x", in->k); break;
+        case BPF_JMP | BPF_JSET | BPF_K: snprintf(op, sizeof(op), "jset     #0x%x", in->k); break;
+        default: snprintf(op, sizeof(op), "code 0x%04x k=0x%x", in->code, in->k); break;
+        }
+        if (BPF_CLASS(in->code) == BPF_JMP)
+            printf("(%03d) %-24s jt %d\tjf %d\n", i, op, i + 1 + in->jt, i + 1 + in->jf);
+        else
+            printf("(%03d) %s\n", i, op);
+    }
+}
+
+static int filter_attach(int fd, struct sock_filter *prog, int n)
+{
+    struct sock_fprog fp = {.len = (unsigned short)n, .filter = prog};
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fp, sizeof(fp)) < 0)
+    {
+        perror("setsockopt(SO_ATTACH_FILTER)");
+        return -1;
+    }
+    return 0;
+}
+
+// ---- pcapng output ----
+//
+// Records are appended to a ring of large buffers; a writer thread writes each
+// one as it fills (with O_DIRECT if asked, the buffers being page-aligned), so
+// capture threads only ever memcpy. If the disk falls behind they wait, the
+// socket ring fills and the kernel's drop counter shows it.
+
+#define PCAPNG_NBUF 4
+#define PCAPNG_IFMAX 256
+
+struct pcapng
+{
+    int fd;
+    bool direct;
+    size_t buf_size;
+    unsigned char *buf[PCAPNG_NBUF];
+    size_t len[PCAPNG_NBUF];
+    int fill, flush, queued; // buffer being filled, next to write, full ones waiting
+    bool closing, failed;
+    pthread_mutex_t lock;
+    pthread_cond_t cv_full, cv_free;
+    pthread_t th;
+    atomic_int ifid[PCAPNG_IFMAX]; // ifindex -> interface id + 1
+    int nif;
+    unsigned long pkts, bytes, waits;
+};
+
+static struct pcapng *g_pcap;
+
+static void *pcapng_writer(void *arg)
+{
+    struct pcapng *pc = arg;
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT); // let it interrupt the capture thread
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    pthread_mutex_lock(&pc->lock);
+    for (;;)
+    {
+        while (!pc->queued && !pc->closing)
+            pthread_cond_wait(&pc->cv_full, &pc->lock);
+        if (!pc->queued)
+            break;
+        int i = pc->flush;
+        pthread_mutex_unlock(&pc->lock);
+        size_t off = 0;
+        while (off < pc->len[i] && !pc->failed)
+        {
+            ssize_t k = write(pc->fd, pc->buf[i] + off, pc->len[i] - off);
+            if (k < 0 && errno == EINTR)
+                continue;
+            if (k <= 0)
+            {
+                perror("pcapng write");
+                pc->failed = true;
+                break;
+            }
+            off += (size_t)k;
+        }
+        pthread_mutex_lock(&pc->lock);
+        pc->len[i] = 0;
+        pc->flush = (i + 1) % PCAPNG_NBUF;
+        pc->queued--;
+        pthread_cond_broadcast(&pc->cv_free);
+    }
+    pthread_mutex_unlock(&pc->lock);
+    return NULL;
+}
+
+// lock held
+static void pcapng_append_locked(struct pcapng *pc, const void *data, size_t n)
+{
+    const unsigned char *p = data;
+    while (n)
+    {
+        while (pc->queued == PCAPNG_NBUF)
+        {
+            pc->waits++;
+            pthread_cond_wait(&pc->cv_free, &pc->lock);
+        }
+        int i = pc->fill;
+        size_t k = pc->buf_size - pc->len[i];
+        if (k > n)
+            k = n;
+        memcpy(pc->buf[i] + pc->len[i], p, k);
+        pc->len[i] += k;
+        p += k;
+        n -= k;
+        if (pc->len[i] == pc->buf_size)
+        {
+            pc->fill = (i + 1) % PCAPNG_NBUF;
+            pc->queued++;
+            pthread_cond_signal(&pc->cv_full);
+        }
+    }
+}
+
+static void pcapng_append(struct pcapng *pc, const void *data, size_t n, unsigned long pkts)
+{
+    pthread_mutex_lock(&pc->lock);
+    pcapng_append_locked(pc, data, n);
+    pc->pkts += pkts;
+    pc->bytes += n;
+    pthread_mutex_unlock(&pc->lock);
+}
+
+static void put32(unsigned char *p, uint32_t v) { memcpy(p, &v, 4); } // pcapng is in the writer's byte order
+
+static void out_bytes(struct out *o, const void *data, size_t n)
+{
+    if (o->n + n > o->cap)
+    {
+        size_t cap = o->cap ? o->cap : 4096;
+        while (cap < o->n + n)
+            cap *= 2;
+        char *p = realloc(o->p, cap);
+        if (!p)
+        {
+            perror("realloc");
+            exit(1);
+        }
+        o->p = p;
+        o->cap = cap;
+    }
+    memcpy(o->p + o->n, data, n);
+    o->n += n;
+}
+
+static uint32_t pcapng_linktype(unsigned short hatype)
+{
+    switch (hatype)
+    {
+    case ARPHRD_ETHER:
+    case ARPHRD_LOOPBACK:
+        return 1; // LINKTYPE_ETHERNET
+    case ARPHRD_NONE:
+    case ARPHRD_PPP:
+    case ARPHRD_TUNNEL:
+    case ARPHRD_TUNNEL6:
+        return 101; // LINKTYPE_RAW: these come without a link-layer header
+    default:
+        return 1;
+    }
+}
+
+// Interface id for ifindex, writing its Interface Description Block the first time.
+static uint32_t pcapng_ifid(struct pcapng *pc, int ifindex, unsigned short hatype, const char *name, uint32_t snaplen)
+{
+    int slot = ifindex > 0 && ifindex < PCAPNG_IFMAX ? ifindex : 0;
+    int id = atomic_load_explicit(&pc->ifid[slot], memory_order_acquire);
+    if (id)
+        return (uint32_t)id - 1;
+    pthread_mutex_lock(&pc->lock);
+    id = atomic_load_explicit(&pc->ifid[slot], memory_order_relaxed);
+    if (!id)
+    {
+        unsigned char b[64 + IFNAMSIZ];
+        size_t nl = strlen(name), np = (nl + 3) & ~(size_t)3;
+        size_t len = 16 + 4 + np + 8 + 4 + 4;
+        memset(b, 0, sizeof(b));
+        put32(b, 1); // IDB
+        put32(b + 4, (uint32_t)len);
+        uint16_t lt = (uint16_t)pcapng_linktype(hatype);
+        memcpy(b + 8, &lt, 2);
+        put32(b + 12, snaplen);
+        uint16_t opt[2] = {2, (uint16_t)nl}; // if_name
+        memcpy(b + 16, opt, 4);
+        memcpy(b + 20, name, nl);
+        size_t o = 20 + np;
+        opt[0] = 9; // if_tsresol: 10^-9
+        opt[1] = 1;
+        memcpy(b + o, opt, 4);
+        b[o + 4] = 9;
+        o += 8;
+        o += 4; // opt_endofopt
+        put32(b + o, (uint32_t)len);
+        pcapng_append_locked(pc, b, len);
+        id = ++pc->nif;
+        atomic_store_explicit(&pc->ifid[slot], id, memory_order_release);
+    }
+    pthread_mutex_unlock(&pc->lock);
+    return (uint32_t)id - 1;
+}
+
+// Append one Enhanced Packet Block for this packet to o (flushed later with pcapng_append).
+static void pcapng_epb(struct out *o, uint32_t ifid, uint64_t ts_ns, const unsigned char *pkt, uint32_t caplen,
+                       uint32_t len)
+{
+    unsigned char h[28];
+    uint32_t pad = (4 - caplen % 4) % 4, total = 32 + caplen + pad;
+    put32(h, 6);
+    put32(h + 4, total);
+    put32(h + 8, ifid);
+    put32(h + 12, (uint32_t)(ts_ns >> 32));
+    put32(h + 16, (uint32_t)ts_ns);
+    put32(h + 20, caplen);
+    put32(h + 24, len);
+    out_bytes(o, h, sizeof(h));
+    out_bytes(o, pkt, caplen);
+    static const unsigned char zero[4];
+    put32(h, total);
+    out_bytes(o, zero, pad);
+    out_bytes(o, h, 4);
+}
+
+static struct pcapng *pcapng_open(const char *path, bool direct, size_t buf_mb)
+{
+    struct pcapng *pc = calloc(1, sizeof(*pc));
+    if (!pc)
+    {
+        perror("calloc");
+        return NULL;
+    }
+    pc->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (direct ? O_DIRECT : 0), 0644);
+    if (pc->fd < 0 && direct && errno == EINVAL)
+    {
+        fprintf(stderr, "warning: %s: O_DIRECT not supported there, using buffered writes\n", path);
+        direct = false;
+        pc->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+    if (pc->fd < 0)
+    {
+        perror(path);
+        free(pc);
+        return NULL;
+    }
+    pc->direct = direct;
+    pc->buf_size = buf_mb << 20; // a multiple of any O_DIRECT alignment
+    for (int i = 0; i < PCAPNG_NBUF; i++)
+        if (posix_memalign((void **)&pc->buf[i], 4096, pc->buf_size) != 0)
+        {
+            perror("posix_memalign");
+            exit(1);
+        }
+    pthread_mutex_init(&pc->lock, NULL);
+    pthread_cond_init(&pc->cv_full, NULL);
+    pthread_cond_init(&pc->cv_free, NULL);
+    // Section Header Block
+    unsigned char shb[28];
+    put32(shb, 0x0A0D0D0A);
+    put32(shb + 4, sizeof(shb));
+    put32(shb + 8, 0x1A2B3C4D);
+    uint16_t ver[2] = {1, 0};
+    memcpy(shb + 12, ver, 4);
+    memset(shb + 16, 0xff, 8); // section length unknown
+    put32(shb + 24, sizeof(shb));
+    pcapng_append_locked(pc, shb, sizeof(shb));
+    if (pthread_create(&pc->th, NULL, pcapng_writer, pc) != 0)
+    {
+        perror("pthread_create");
+        exit(1);
+    }
+    return pc;
+}
+
+static void pcapng_close(struct pcapng *pc)
+{
+    // hand over the part-filled buffer too, without O_DIRECT: its length is not aligned
+    pthread_mutex_lock(&pc->lock);
+    while (pc->queued)
+        pthread_cond_wait(&pc->cv_free, &pc->lock);
+    if (pc->direct)
+        fcntl(pc->fd, F_SETFL, fcntl(pc->fd, F_GETFL) & ~O_DIRECT);
+    if (pc->len[pc->fill])
+    {
+        pc->queued++;
+        pc->fill = (pc->fill + 1) % PCAPNG_NBUF;
+    }
+    pc->closing = true;
+    pthread_cond_signal(&pc->cv_full);
+    pthread_mutex_unlock(&pc->lock);
+    pthread_join(pc->th, NULL);
+    if (close(pc->fd) != 0 && !pc->failed)
+        perror("pcapng close");
+    fprintf(stderr, "[pcapng] %lu packets, %lu bytes, %lu buffer wait(s)%s\n", pc->pkts, pc->bytes, pc->waits,
+            pc->failed ? ", WRITE FAILED" : "");
+    for (int i = 0; i < PCAPNG_NBUF; i++)
+        free(pc->buf[i]);
+    pthread_mutex_destroy(&pc->lock);
+    pthread_cond_destroy(&pc->cv_full);
+    pthread_cond_destroy(&pc->cv_free);
+    free(pc);
+}
+
+// ---- TPACKET_V3 ring workers ----
+
+static struct
+{
+    const char *ifname;
+    int ifindex;
+    bool quiet, do_hex;
+    long limit;
+    unsigned block_size, block_nr;
+    int fanout_type;
+    uint32_t snaplen;
+    struct sock_filter prog[BPF_MAX];
+    int nprog; // 0: no filter attached
+} g_cfg;
+
+static atomic_long g_count; // packets taken, across workers (for -n)
+
+struct worker
+{
+    int id, cpu, fd;
+    pthread_t th;
+    unsigned char *map; // block_nr blocks of block_size bytes
+    size_t map_len;
+    atomic_ulong pkts, bytes; // written by the worker only
+    unsigned long last_pkts, last_bytes;
+    unsigned long drops, freezes; // totals of PACKET_STATISTICS (it resets on read)
+    struct out out;
+    struct out rec; // pcapng blocks of the current ring block
+    char ifnames[64][IFNAMSIZ]; // if_indextoname is an ioctl: cache it
+};
+
+static const char *worker_ifname(struct worker *w, int ifindex)
+{
+    if (ifindex <= 0 || ifindex >= 64)
+        return "?";
+    char *name = w->ifnames[ifindex];
+    if (!name[0] && !if_indextoname((unsigned)ifindex, name))
+        snprintf(name, IFNAMSIZ, "#%d", ifindex);
+    return name;
+}
+
+static int ring_setup(struct worker *w, int fanout_id, bool fanout)
+{
+    int fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (fd < 0)
+    {
+        perror("socket(AF_PACKET,SOCK_RAW)");
+        return -1;
+    }
+    int ver = TPACKET_V3;
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) < 0)
+    {
+        perror("setsockopt(PACKET_VERSION, TPACKET_V3)");
+        close(fd);
+        return -1;
+    }
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = g_cfg.block_size;
+    req.tp_block_nr = g_cfg.block_nr;
+    req.tp_frame_size = TPACKET_ALIGNMENT << 7; // 2048; V3 packs frames of any size into a block
+    req.tp_frame_nr = req.tp_block_size / req.tp_frame_size * req.tp_block_nr;
+    req.tp_retire_blk_tov = 60; // ms: hand over a part-filled block when traffic is slow
+    req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+    if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+    {
+        perror("setsockopt(PACKET_RX_RING)");
+        close(fd);
+        return -1;
+    }
+    w->map_len = (size_t)req.tp_block_size * req.tp_block_nr;
+    w->map = mmap(NULL, w->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+    if (w->map == MAP_FAILED)
+        w->map = mmap(NULL, w->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); // over RLIMIT_MEMLOCK
+    if (w->map == MAP_FAILED)
+    {
+        perror("mmap(PACKET_RX_RING)");
+        close(fd);
+        return -1;
+    }
+    if (g_cfg.nprog && filter_attach(fd, g_cfg.prog, g_cfg.nprog) != 0)
+    {
+        munmap(w->map, w->map_len);
+        close(fd);
+        return -1;
+    }
+    // bind after the ring exists so no frame goes the recvfrom way
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = g_cfg.ifindex;
+    if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0)
+    {
+        perror("bind(AF_PACKET)");
+        munmap(w->map, w->map_len);
+        close(fd);
+        return -1;
+    }
+    if (fanout)
+    {
+        int arg = fanout_id | g_cfg.fanout_type << 16;
+        if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0)
+        {
+            perror("setsockopt(PACKET_FANOUT)");
+            munmap(w->map, w->map_len);
+            close(fd);
+            return -1;
+        }
+    }
+    w->fd = fd;
+    return 0;
+}
+
+static void ring_block(struct worker *w, struct tpacket_block_desc *bd)
+{
+    uint32_t n = bd->hdr.bh1.num_pkts;
+    struct tpacket3_hdr *ppd = (struct tpacket3_hdr *)((unsigned char *)bd + bd->hdr.bh1.offset_to_first_pkt);
+    unsigned long bytes = 0, taken = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (g_cfg.limit >= 0 && atomic_fetch_add_explicit(&g_count, 1, memory_order_relaxed) >= g_cfg.limit)
+        {
+            g_stop = 1;
+            break;
+        }
+        bytes += ppd->tp_len;
+        taken++;
+        const struct sockaddr_ll *sll =
+            (const struct sockaddr_ll *)((unsigned char *)ppd + TPACKET_ALIGN(sizeof(*ppd)));
+        const unsigned char *pkt = (unsigned char *)ppd + ppd->tp_mac;
+        uint32_t caplen = ppd->tp_snaplen < g_cfg.snaplen ? ppd->tp_snaplen : g_cfg.snaplen;
+        if (g_pcap)
+        {
+            uint32_t ifid = pcapng_ifid(g_pcap, sll->sll_ifindex, sll->sll_hatype,
+                                        worker_ifname(w, sll->sll_ifindex), g_cfg.snaplen);
+            pcapng_epb(&w->rec, ifid, (uint64_t)ppd->tp_sec * 1000000000u + ppd->tp_nsec, pkt, caplen,
+                       ppd->tp_len);
+        }
+        if (!g_cfg.quiet)
+            print_packet(&w->out, pkt, caplen, ppd->tp_len, (long)ppd->tp_sec, (long)(ppd->tp_nsec / 1000),
+                         worker_ifname(w, sll->sll_ifindex), g_cfg.do_hex);
+        ppd = (struct tpacket3_hdr *)((unsigned char *)ppd + ppd->tp_next_offset);
+    }
+    out_flush(&w->out);
+    if (w->rec.n)
+    {
+        pcapng_append(g_pcap, w->rec.p, w->rec.n, taken);
+        w->rec.n = 0;
+    }
+    atomic_store_explicit(&w->pkts, atomic_load_explicit(&w->pkts, memory_order_relaxed) + taken,
+                          memory_order_relaxed);
+    atomic_store_explicit(&w->bytes, atomic_load_explicit(&w->bytes, memory_order_relaxed) + bytes,
+                          memory_order_relaxed);
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    if (w->cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    struct pollfd pfd = {.fd = w->fd, .events = POLLIN | POLLERR};
+    unsigned cur = 0;
+    while (!g_stop)
+    {
+        struct tpacket_block_desc *bd = (struct tpacket_block_desc *)(w->map + (size_t)cur * g_cfg.block_size);
+        if (!(__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+        {
+            poll(&pfd, 1, 100); // also wakes us to notice g_stop
+            continue;
+        }
+        ring_block(w, bd);
+        __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        cur = (cur + 1) % g_cfg.block_nr;
+    }
+    return NULL;
+}
+
+static void worker_stats(struct worker *w, double secs, bool final)
+{
+    struct tpacket_stats_v3 st;
+    socklen_t len = sizeof(st);
+    memset(&st, 0, sizeof(st));
+    if (getsockopt(w->fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) == 0)
+    {
+        w->drops += st.tp_drops;
+        w->freezes += st.tp_freeze_q_cnt;
+    }
+    unsigned long pkts = atomic_load_explicit(&w->pkts, memory_order_relaxed);
+    unsigned long bytes = atomic_load_explicit(&w->bytes, memory_order_relaxed);
+    if (final)
+        fprintf(stderr, "[total] w%d: %lu pkts %lu bytes drops %lu freezes %lu\n",
+                w->id, pkts, bytes, w->drops, w->freezes);
+    else
+        fprintf(stderr, "[stats] w%d cpu%d: %10.0f pkt/s %9.1f Mbit/s drops %u (total %lu) freezes %lu\n",
+                w->id, w->cpu, (double)(pkts - w->last_pkts) / secs,
+                (double)(bytes - w->last_bytes) * 8 / secs / 1e6, st.tp_drops, w->drops, w->freezes);
+    w->last_pkts = pkts;
+    w->last_bytes = bytes;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int run_ring(int nworkers, bool promiscuous)
+{
+    // workers go on the CPUs we may run on, one each, wrapping if there are more workers
+    cpu_set_t allowed;
+    int cpus[CPU_SETSIZE], ncpu = 0;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        for (int c = 0; c < CPU_SETSIZE; c++)
+            if (CPU_ISSET(c, &allowed))
+                cpus[ncpu++] = c;
+    struct worker *ws = calloc((size_t)nworkers, sizeof(*ws));
+    if (!ws)
+    {
+        perror("calloc");
+        return 1;
+    }
+    int fanout_id = getpid() & 0xffff;
+    int started = 0, rc = 0;
+    for (int i = 0; i < nworkers; i++)
+    {
+        ws[i].id = i;
+        ws[i].cpu = ncpu ? cpus[i % ncpu] : -1;
+        if (ring_setup(&ws[i], fanout_id, nworkers > 1) != 0)
+        {
+            rc = 1;
+            break;
+        }
+        started++;
+    }
+    struct packet_mreq mr;
+    bool promisc_added = false;
+    if (rc == 0 && promiscuous)
+    {
+        // one membership per interface is enough; it goes with worker 0's socket
+        memset(&mr, 0, sizeof(mr));
+        mr.mr_ifindex = g_cfg.ifindex;
+        mr.mr_type = PACKET_MR_PROMISC;
+        if (setsockopt(ws[0].fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr, sizeof(mr)) < 0)
+            perror("setsockopt(PACKET_ADD_MEMBERSHIP, PROMISC)");
+        else
+            promisc_added = true;
+    }
+    if (rc == 0)
+    {
+        printf("Sniffing %s (promisc=%s, %d ring worker(s), %u x %u KiB blocks each, fanout=%s). "
+               "Press Ctrl+C to stop.\n",
+               g_cfg.ifname ? g_cfg.ifname : "all interfaces", promisc_added ? "on" : "off", nworkers,
+               g_cfg.block_nr, g_cfg.block_size / 1024, nworkers > 1 ? "on" : "off");
+        fflush(stdout);
+        for (int i = 0; i < started; i++)
+            if (pthread_create(&ws[i].th, NULL, worker_main, &ws[i]) != 0)
+            {
+                perror("pthread_create");
+                g_stop = 1;
+                started = i;
+                rc = 1;
+                break;
+            }
+        double last = now_sec();
+        while (!g_stop)
+        {
+            struct timespec ts = {0, 100 * 1000000L};
+            nanosleep(&ts, NULL);
+            double t = now_sec();
+            if (t - last < 1.0 && !g_stop)
+                continue;
+            if (g_stop)
+                break;
+            for (int i = 0; i < started; i++)
+                worker_stats(&ws[i], t - last, false);
+            last = t;
+        }
+        for (int i = 0; i < started; i++)
+            pthread_join(ws[i].th, NULL);
+    }
+    long total = 0;
+    for (int i = 0; i < started; i++)
+    {
+        worker_stats(&ws[i], 1, true);
+        total += (long)ws[i].pkts;
+        if (promisc_added && i == 0)
+            setsockopt(ws[i].fd, SOL_PACKET, PACKET_DROP_MEMBERSHIP, &mr, sizeof(mr));
+        munmap(ws[i].map, ws[i].map_len);
+        close(ws[i].fd);
+        free(ws[i].out.p);
+        free(ws[i].rec.p);
+    }
+    free(ws);
+    printf("Captured %ld packet(s). Bye.\n", total);
+    return rc;
 }
 
 int main(int argc, char **argv)
@@ -138,10 +1132,19 @@ int main(int argc, char **argv)
     const char *ifname = NULL;
     bool promiscuous = false;
     bool do_hex = false;
+    bool quiet = false;
+    bool ring = false;
+    int nworkers = 1;
     long limit = -1;
+    long block_kb = 1024, nblocks = 64;
+    int fanout_type = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+    long snaplen = 0;
+    const char *pcap_path = NULL;
+    bool pcap_direct = false, dump_filter = false;
+    long pcap_mb = 4;
 
     int opt;
-    while ((opt = getopt(argc, argv, "i:pxn:")) != -1)
+    while ((opt = getopt(argc, argv, "i:pxqn:rw:F:b:B:s:o:DM:d")) != -1)
     {
         switch (opt)
         {
@@ -154,16 +1157,135 @@ int main(int argc, char **argv)
         case 'x':
             do_hex = true;
             break;
+        case 'q':
+            quiet = true;
+            break;
         case 'n':
             limit = strtol(optarg, NULL, 10);
             break;
+        case 'r':
+            ring = true;
+            break;
+        case 'w':
+            nworkers = (int)strtol(optarg, NULL, 10);
+            ring = true;
+            break;
+        case 'F':
+            if (strcmp(optarg, "hash") == 0)
+                fanout_type = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+            else if (strcmp(optarg, "lb") == 0)
+                fanout_type = PACKET_FANOUT_LB;
+            else if (strcmp(optarg, "cpu") == 0)
+                fanout_type = PACKET_FANOUT_CPU;
+            else if (strcmp(optarg, "rollover") == 0)
+                fanout_type = PACKET_FANOUT_ROLLOVER;
+            else
+            {
+                fprintf(stderr, "unknown fanout mode: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'b':
+            block_kb = strtol(optarg, NULL, 10);
+            break;
+        case 'B':
+            nblocks = strtol(optarg, NULL, 10);
+            break;
+        case 's':
+            snaplen = strtol(optarg, NULL, 10);
+            break;
+        case 'o':
+            pcap_path = optarg;
+            break;
+        case 'D':
+            pcap_direct = true;
+            break;
+        case 'M':
+            pcap_mb = strtol(optarg, NULL, 10);
+            break;
+        case 'd':
+            dump_filter = true;
+            break;
         default:
-            fprintf(stderr, "Usage: %s [-i iface] [-p] [-x] [-n count]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-i iface] [-p] [-x] [-q] [-n count] [-r] [-w workers]"
+                            " [-F hash|lb|cpu|rollover] [-b block_kb] [-B blocks]"
+                            " [-s snaplen] [-o file.pcapng [-D] [-M buf_mb]] [-d] [filter]\n",
+                    argv[0]);
             return 1;
         }
     }
+    if (snaplen <= 0 || snaplen > 262144)
+        snaplen = 262144;
+    if (pcap_mb < 1 || pcap_mb > 1024)
+        pcap_mb = 4;
+    g_cfg.snaplen = (uint32_t)snaplen;
+
+    // filter: the rest of the command line. Ring mode lets the kernel truncate to
+    // snaplen; recvfrom() could not then report the wire length, so there we truncate.
+    struct filter flt;
+    bool have_filter = optind < argc;
+    if (have_filter && filter_parse(&flt, argv + optind, argc - optind) != 0)
+        return 1;
+    if (have_filter || (ring && snaplen < 262144) || dump_filter)
+    {
+        g_cfg.nprog = filter_compile(have_filter ? &flt : NULL, ring ? g_cfg.snaplen : 262144, g_cfg.prog);
+        if (g_cfg.nprog < 0)
+            return 1;
+    }
+    if (dump_filter)
+    {
+        filter_dump(g_cfg.prog, g_cfg.nprog);
+        return 0;
+    }
+
+    // no SA_RESTART: a blocked recvfrom() must return EINTR
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigint;
+    sigaction(SIGINT, &sa, NULL);
+
+    if (pcap_path)
+    {
+        quiet = true;
+        g_pcap = pcapng_open(pcap_path, pcap_direct, (size_t)pcap_mb);
+        if (!g_pcap)
+            return 1;
+    }
 
-    signal(SIGINT, on_sigint);
+    if (ring)
+    {
+        if (nworkers < 1 || nworkers > 1024 || block_kb < 4 || block_kb > 1024 * 1024 || nblocks < 2)
+        {
+            fprintf(stderr, "bad ring geometry: -w 1..1024, -b >= 4 KiB, -B >= 2\n");
+            return 1;
+        }
+        if (promiscuous && !(ifname && *ifname))
+        {
+            fprintf(stderr, "[-p] requires -i <iface>\n");
+            return 1;
+        }
+        g_cfg.ifname = ifname;
+        if (ifname && *ifname && !(g_cfg.ifindex = (int)if_nametoindex(ifname)))
+        {
+            perror("if_nametoindex");
+            return 1;
+        }
+        // a block is one kernel allocation of 2^order pages
+        long page = sysconf(_SC_PAGESIZE);
+        unsigned long bs = (unsigned long)page;
+        while (bs < (unsigned long)block_kb * 1024)
+            bs <<= 1;
+        g_cfg.block_size = (unsigned)bs;
+        g_cfg.block_nr = (unsigned)nblocks;
+        g_cfg.quiet = quiet;
+        g_cfg.do_hex = do_hex;
+        g_cfg.limit = limit;
+        g_cfg.fanout_type = fanout_type;
+        int rc = run_ring(nworkers, promiscuous);
+        if (g_pcap)
+            pcapng_close(g_pcap);
+        return rc;
+    }
 
     int fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
     if (fd < 0)
@@ -171,6 +1293,11 @@ int main(int argc, char **argv)
         perror("socket(AF_PACKET,SOCK_RAW)");
         return 1;
     }
+    if (g_cfg.nprog && filter_attach(fd, g_cfg.prog, g_cfg.nprog) != 0)
+    {
+        close(fd);
+        return 1;
+    }
 
     // Optional: bind to an interface
     int ifindex = 0;
@@ -231,12 +1358,14 @@ int main(int argc, char **argv)
 
     unsigned char buf[65536];
     long count = 0;
+    struct out out = {0};
 
     while (!g_stop && (limit < 0 || count < limit))
     {
         struct sockaddr_ll from;
         socklen_t fromlen = sizeof(from);
-        ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &fromlen);
+        // MSG_TRUNC: n is the packet's full length even if buf holds less
+        ssize_t n = recvfrom(fd, buf, sizeof(buf), MSG_TRUNC, (struct sockaddr *)&from, &fromlen);
         if (n < 0)
         {
             if (errno == EINTR)
@@ -252,18 +1381,23 @@ int main(int argc, char **argv)
         char iname[IFNAMSIZ] = {0};
         if_indextoname(from.sll_ifindex, iname);
 
-        // Decode Ethernet
-        uint16_t ethertype = 0;
-        printf("[%ld.%06ld] if=%s len=%zd",
-               (long)tv.tv_sec, (long)tv.tv_usec, iname[0] ? iname : "?", n);
-        print_eth_header(buf, (size_t)n, &ethertype);
-        print_ip_port_proto(buf, (size_t)n, ntohs(ethertype));
-        printf("\n");
-
-        if (do_hex)
+        size_t caplen = (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf);
+        if (caplen > g_cfg.snaplen)
+            caplen = g_cfg.snaplen;
+        if (g_pcap)
+        {
+            uint32_t ifid = pcapng_ifid(g_pcap, from.sll_ifindex, from.sll_hatype, iname[0] ? iname : "?",
+                                        g_cfg.snaplen);
+            pcapng_epb(&out, ifid, (uint64_t)tv.tv_sec * 1000000000u + (uint64_t)tv.tv_usec * 1000u, buf,
+                       (uint32_t)caplen, (uint32_t)n);
+            pcapng_append(g_pcap, out.p, out.n, 1);
+            out.n = 0;
+        }
+        if (!quiet)
         {
-            hex_dump(buf, (size_t)n);
-            printf("\n");
+            print_packet(&out, buf, caplen, (size_t)n, (long)tv.tv_sec, (long)tv.tv_usec,
+                         iname[0] ? iname : "?", do_hex);
+            out_flush(&out);
         }
 
         ++count;
@@ -275,6 +1409,9 @@ int main(int argc, char **argv)
         setsockopt(fd, SOL_PACKET, PACKET_DROP_MEMBERSHIP, &mr, sizeof(mr));
     }
     close(fd);
+    free(out.p);
+    if (g_pcap)
+        pcapng_close(g_pcap);
     printf("Captured %ld packet(s). Bye.\n", count);
     return 0;
 }
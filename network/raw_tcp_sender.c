@@ -8,32 +8,13 @@
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 
+#include "inet_csum.h"
+
 #define DEST_IP "192.168.1.100"
 #define DEST_PORT 1234
 #define SRC_IP "192.168.1.10"
 #define SRC_PORT 55555
 
-// TCP pseudo-header (for checksum calculation)
-struct pseudo_header
-{
-    u_int32_t src_addr;
-    u_int32_t dst_addr;
-    u_int8_t placeholder;
-    u_int8_t protocol;
-    u_int16_t tcp_length;
-};
-
-// Checksum function
-unsigned short checksum(unsigned short *ptr, int nwords)
-{
-    unsigned long sum = 0;
-    while (nwords-- > 0)
-        sum += *ptr++;
-    sum = (sum >> 16) + (sum & 0xffff);
-    sum += (sum >> 16);
-    return (unsigned short)(~sum);
-}
-
 int main()
 {
     char buffer[4096];
@@ -77,7 +58,7 @@ int main()
     iph->check = 0;
     iph->saddr = inet_addr(SRC_IP);
     iph->daddr = inet_addr(DEST_IP);
-    iph->check = checksum((unsigned short *)buffer, iph->ihl * 2);
+    iph->check = inet_csum(buffer, iph->ihl * 4);
 
     // Fill TCP header
     tcph->source = htons(SRC_PORT);
@@ -90,21 +71,10 @@ int main()
     tcph->check = 0;
     tcph->urg_ptr = 0;
 
-    // Pseudo header for checksum
-    struct pseudo_header psh;
-    psh.src_addr = inet_addr(SRC_IP);
-    psh.dst_addr = inet_addr(DEST_IP);
-    psh.placeholder = 0;
-    psh.protocol = IPPROTO_TCP;
-    psh.tcp_length = htons(sizeof(struct tcphdr) + datalen);
-
-    int psize = sizeof(struct pseudo_header) + sizeof(struct tcphdr) + datalen;
-    char *pseudogram = malloc(psize);
-    memcpy(pseudogram, &psh, sizeof(struct pseudo_header));
-    memcpy(pseudogram + sizeof(struct pseudo_header), tcph, sizeof(struct tcphdr) + datalen);
-
-    tcph->check = checksum((unsigned short *)pseudogram, psize / 2);
-    free(pseudogram);
+    // Pseudo header + segment, summed in place (no pseudogram copy)
+    uint16_t tcp_len = sizeof(struct tcphdr) + datalen;
+    uint64_t sum = csum_pseudo_ipv4(iph->saddr, iph->daddr, IPPROTO_TCP, tcp_len);
+    tcph->check = inet_csum_finish(csum_partial(tcph, tcp_len, sum));
 
     // Destination info
     struct sockaddr_in sin;
@@ -8,22 +8,13 @@
 #include <netinet/udp.h>
 #include <sys/socket.h>
 
+#include "inet_csum.h"
+
 #define DEST_IP "192.168.1.100"
 #define DEST_PORT 12345
 #define SRC_IP "192.168.1.10"
 #define SRC_PORT 54321
 
-// Checksum calculation function
-unsigned short checksum(unsigned short *buf, int nwords)
-{
-    unsigned long sum = 0;
-    while (nwords-- > 0)
-        sum += *buf++;
-    sum = (sum >> 16) + (sum & 0xffff);
-    sum += (sum >> 16);
-    return (unsigned short)(~sum);
-}
-
 int main()
 {
     char buffer[4096];
@@ -69,7 +60,7 @@ int main()
     iph->check = 0;
     iph->saddr = inet_addr(SRC_IP);
     iph->daddr = inet_addr(DEST_IP);
-    iph->check = checksum((unsigned short *)buffer, iph->ihl * 2);
+    iph->check = inet_csum(buffer, iph->ihl * 4);
 
     // UDP Header
     udph->source = htons(SRC_PORT);
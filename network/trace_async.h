@@ -0,0 +1,577 @@
+// trace_async.h - event-driven traceroute engine shared by traceroute_icmp.c and traceroute_udp.c
+//
+// Instead of one probe at a time, every TTL x probe packet of every target is
+// put on the wire, paced to a fixed rate, and replies are matched back to the
+// probe that caused them by what the ICMP error quotes:
+//   ICMP probes: echo id/sequence  (id = ident + index >> 16, seq = index & 0xffff)
+//   UDP probes:  IP id and source port of the quoted datagram
+//                (id = 0x8000 | index & 0x7fff, sport = 0x8000 | (ident + index >> 15) & 0x7fff)
+// so `index` (target, TTL, probe) comes straight out of the reply. Probes are
+// sent on one IP_HDRINCL raw socket, which sets TTL per packet without a
+// setsockopt() each time; ICMP replies arrive on a raw ICMP socket (the same
+// one for ICMP probes).
+//
+// Up to `concurrency` targets are traced at once, round-robin, so no single
+// router sees a burst. A target stops getting probes beyond the TTL where it
+// answered. When all its replies are in, or the last probe has timed out, it
+// is written out as JSON lines, one per hop, then a summary:
+//   {"dst":"example.com","ip":"93.184.216.34","ttl":1,"probes":[{"ip":"192.168.1.1","rtt_ms":0.412,"icmp":"time-exceeded"},null,...]}
+//   {"dst":"example.com","ip":"93.184.216.34","reached":true,"hops":12,"sent":36,"replies":35,"elapsed_ms":1012.3}
+
+#ifndef TRACE_ASYNC_H
+#define TRACE_ASYNC_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/filter.h>
+#include <netdb.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "inet_csum.h"
+
+enum
+{
+    TRACE_ICMP,
+    TRACE_UDP
+};
+
+typedef struct
+{
+    int proto;        // TRACE_ICMP or TRACE_UDP
+    int max_hops;
+    int probes;       // per TTL
+    int timeout_ms;   // after a target's last probe
+    double rate_pps;  // packets per second, all targets together
+    int concurrency;  // targets in flight
+    int base_port;    // UDP destination port base (classic 33434)
+} trace_cfg_t;
+
+enum
+{
+    PROBE_UNSENT,
+    PROBE_SENT,
+    PROBE_ANSWERED,
+    PROBE_FAILED // sendto() refused it
+};
+
+typedef struct
+{
+    double sent_ms;
+    float rtt_ms;
+    uint32_t from; // network order
+    uint8_t type, code, state;
+} trace_probe_t;
+
+enum
+{
+    TGT_PENDING,
+    TGT_SENDING,
+    TGT_DRAINING,
+    TGT_DONE
+};
+
+typedef struct
+{
+    const char *name;
+    struct sockaddr_in dst;
+    int state;
+    int next;        // next probe slot: p * max_hops + (ttl - 1)
+    int nsent, nans;
+    int stop_ttl;    // no probes beyond this TTL (destination or unreachable seen)
+    bool reached;    // the destination itself answered
+    double start_ms, last_send_ms;
+    trace_probe_t *pr; // max_hops * probes, while live
+} trace_target_t;
+
+typedef struct
+{
+    const trace_cfg_t *cfg;
+    trace_target_t *tg;
+    int ntg;
+    int per;          // probes per target
+    int *live, nlive; // SENDING or DRAINING, at most cfg->concurrency
+    int rr;           // round-robin cursor into live[]
+    int admitted, done;
+    unsigned short ident;
+    int snd, rcv;     // rcv == snd for ICMP
+} trace_run_t;
+
+static double trace_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void trace_json_str(const char *s)
+{
+    putchar('"');
+    for (; *s; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            printf("\\%c", c);
+        else if (c < 0x20)
+            printf("\\u%04x", c);
+        else
+            putchar(c);
+    }
+    putchar('"');
+}
+
+static const char *trace_icmp_name(int type, int code)
+{
+    if (type == ICMP_TIME_EXCEEDED)
+        return "time-exceeded";
+    if (type == ICMP_ECHOREPLY)
+        return "echo-reply";
+    if (type != ICMP_DEST_UNREACH)
+        return "other";
+    switch (code)
+    {
+    case ICMP_NET_UNREACH: return "net-unreachable";
+    case ICMP_HOST_UNREACH: return "host-unreachable";
+    case ICMP_PROT_UNREACH: return "proto-unreachable";
+    case ICMP_PORT_UNREACH: return "port-unreachable";
+    case ICMP_FRAG_NEEDED: return "frag-needed";
+    case ICMP_NET_ANO:
+    case ICMP_HOST_ANO:
+    case ICMP_PKT_FILTERED: return "admin-prohibited";
+    default: return "unreachable";
+    }
+}
+
+static void trace_emit(trace_run_t *R, trace_target_t *t)
+{
+    const trace_cfg_t *c = R->cfg;
+    char dip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &t->dst.sin_addr, dip, sizeof(dip));
+    // hops up to the stopping TTL, or up to the last one anything answered at
+    int last = 0;
+    for (int ttl = 1; ttl <= c->max_hops; ttl++)
+        for (int p = 0; p < c->probes; p++)
+            if (t->pr[p * c->max_hops + ttl - 1].state == PROBE_ANSWERED)
+                last = ttl;
+    if (t->stop_ttl <= c->max_hops)
+        last = t->stop_ttl;
+    for (int ttl = 1; ttl <= last; ttl++)
+    {
+        printf("{\"dst\":");
+        trace_json_str(t->name);
+        printf(",\"ip\":\"%s\",\"ttl\":%d,\"probes\":[", dip, ttl);
+        for (int p = 0; p < c->probes; p++)
+        {
+            const trace_probe_t *pr = &t->pr[p * c->max_hops + ttl - 1];
+            if (p)
+                putchar(',');
+            if (pr->state != PROBE_ANSWERED)
+            {
+                printf("null");
+                continue;
+            }
+            char hip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &pr->from, hip, sizeof(hip));
+            printf("{\"ip\":\"%s\",\"rtt_ms\":%.3f,\"icmp\":\"%s\"}", hip, pr->rtt_ms,
+                   trace_icmp_name(pr->type, pr->code));
+        }
+        printf("]}\n");
+    }
+    printf("{\"dst\":");
+    trace_json_str(t->name);
+    printf(",\"ip\":\"%s\",\"reached\":%s,\"hops\":%d,\"sent\":%d,\"replies\":%d,\"elapsed_ms\":%.1f}\n", dip,
+           t->reached ? "true" : "false", last, t->nsent, t->nans, trace_now_ms() - t->start_ms);
+    fflush(stdout);
+}
+
+static int trace_resolve(const char *host, struct sockaddr_in *out, const char **err)
+{
+    memset(out, 0, sizeof(*out));
+    out->sin_family = AF_INET;
+    if (inet_pton(AF_INET, host, &out->sin_addr) == 1)
+        return 0;
+    struct addrinfo hints = {0}, *res = NULL;
+    hints.ai_family = AF_INET;
+    int gai = getaddrinfo(host, NULL, &hints, &res);
+    if (gai != 0)
+    {
+        *err = gai_strerror(gai);
+        return -1;
+    }
+    *out = *(struct sockaddr_in *)res->ai_addr;
+    freeaddrinfo(res);
+    return 0;
+}
+
+// bring pending targets in while there is room; unresolvable ones are reported and skipped
+static void trace_admit(trace_run_t *R)
+{
+    while (R->nlive < R->cfg->concurrency && R->admitted < R->ntg)
+    {
+        trace_target_t *t = &R->tg[R->admitted++];
+        const char *err = NULL;
+        if (trace_resolve(t->name, &t->dst, &err) < 0)
+        {
+            printf("{\"dst\":");
+            trace_json_str(t->name);
+            printf(",\"error\":");
+            trace_json_str(err);
+            printf("}\n");
+            t->state = TGT_DONE;
+            R->done++;
+            continue;
+        }
+        t->pr = calloc((size_t)R->per, sizeof(*t->pr));
+        if (!t->pr)
+        {
+            perror("calloc");
+            exit(1);
+        }
+        t->state = TGT_SENDING;
+        t->stop_ttl = R->cfg->max_hops + 1;
+        t->start_ms = trace_now_ms();
+        R->live[R->nlive++] = (int)(t - R->tg);
+    }
+}
+
+static int trace_send(trace_run_t *R, trace_target_t *t, int k)
+{
+    const trace_cfg_t *c = R->cfg;
+    uint32_t index = (uint32_t)((t - R->tg) * R->per + k);
+    int ttl = k % c->max_hops + 1, p = k / c->max_hops;
+    unsigned char pkt[sizeof(struct iphdr) + sizeof(struct icmphdr) + 8];
+    memset(pkt, 0, sizeof(pkt));
+    struct iphdr *ip = (struct iphdr *)pkt;
+    ip->version = 4;
+    ip->ihl = 5;
+    ip->ttl = (uint8_t)ttl;
+    ip->daddr = t->dst.sin_addr.s_addr; // saddr 0: the kernel picks it, and fills in the IP checksum
+    size_t len;
+    if (c->proto == TRACE_ICMP)
+    {
+        struct icmphdr *icmp = (struct icmphdr *)(pkt + sizeof(*ip));
+        icmp->type = ICMP_ECHO;
+        icmp->un.echo.id = htons((uint16_t)(R->ident + (index >> 16)));
+        icmp->un.echo.sequence = htons((uint16_t)index);
+        len = sizeof(*ip) + sizeof(*icmp);
+        icmp->checksum = inet_csum(icmp, sizeof(*icmp));
+        ip->protocol = IPPROTO_ICMP;
+        ip->id = 0; // kernel-assigned
+    }
+    else
+    {
+        struct udphdr *uh = (struct udphdr *)(pkt + sizeof(*ip));
+        uh->source = htons((uint16_t)(0x8000 | ((R->ident + (index >> 15)) & 0x7FFF)));
+        uh->dest = htons((uint16_t)(c->base_port + ttl * c->probes + p));
+        len = sizeof(*ip) + sizeof(*uh) + 4;
+        uh->len = htons((uint16_t)(len - sizeof(*ip)));
+        uh->check = 0; // optional over IPv4, and the source address is not known here
+        ip->protocol = IPPROTO_UDP;
+        ip->id = htons((uint16_t)(0x8000 | (index & 0x7FFF))); // nonzero, so the kernel keeps it
+    }
+    ip->tot_len = htons((uint16_t)len);
+    trace_probe_t *pr = &t->pr[k];
+    pr->sent_ms = trace_now_ms();
+    if (sendto(R->snd, pkt, len, 0, (struct sockaddr *)&t->dst, sizeof(t->dst)) < 0)
+    {
+        if (errno == EAGAIN || errno == ENOBUFS || errno == EINTR)
+            return -1; // try again on the next tick
+        pr->state = PROBE_FAILED;
+        return 0;
+    }
+    pr->state = PROBE_SENT;
+    t->nsent++;
+    t->last_send_ms = pr->sent_ms;
+    return 0;
+}
+
+// next probe of a sending target, skipping TTLs past where it stopped
+static int trace_next_slot(trace_run_t *R, trace_target_t *t)
+{
+    while (t->next < R->per && t->next % R->cfg->max_hops + 1 > t->stop_ttl)
+        t->next++;
+    return t->next < R->per ? t->next : -1;
+}
+
+static void trace_on_reply(trace_run_t *R, const unsigned char *buf, size_t n, uint32_t from, double now)
+{
+    const trace_cfg_t *c = R->cfg;
+    if (n < sizeof(struct iphdr))
+        return;
+    const struct iphdr *ip = (const struct iphdr *)buf;
+    size_t hl = ip->ihl * 4u;
+    if (n < hl + sizeof(struct icmphdr))
+        return;
+    const struct icmphdr *icmp = (const struct icmphdr *)(buf + hl);
+    uint32_t index, dst;
+    if (icmp->type == ICMP_ECHOREPLY)
+    {
+        if (c->proto != TRACE_ICMP)
+            return;
+        index = (uint32_t)((uint16_t)(ntohs(icmp->un.echo.id) - R->ident)) << 16 | ntohs(icmp->un.echo.sequence);
+        dst = from;
+    }
+    else if (icmp->type == ICMP_TIME_EXCEEDED || icmp->type == ICMP_DEST_UNREACH)
+    {
+        const unsigned char *in = (const unsigned char *)icmp + sizeof(*icmp);
+        size_t rem = n - hl - sizeof(*icmp);
+        if (rem < sizeof(struct iphdr))
+            return;
+        const struct iphdr *oip = (const struct iphdr *)in;
+        size_t ohl = oip->ihl * 4u;
+        if (ohl < sizeof(struct iphdr) || rem < ohl + 8)
+            return;
+        dst = oip->daddr;
+        if (c->proto == TRACE_ICMP)
+        {
+            const struct icmphdr *oi = (const struct icmphdr *)(in + ohl);
+            if (oip->protocol != IPPROTO_ICMP || oi->type != ICMP_ECHO)
+                return;
+            index = (uint32_t)((uint16_t)(ntohs(oi->un.echo.id) - R->ident)) << 16 | ntohs(oi->un.echo.sequence);
+        }
+        else
+        {
+            const struct udphdr *ou = (const struct udphdr *)(in + ohl);
+            uint16_t id = ntohs(oip->id), sport = ntohs(ou->source);
+            if (oip->protocol != IPPROTO_UDP || !(id & 0x8000) || !(sport & 0x8000))
+                return;
+            index = (uint32_t)((sport - R->ident) & 0x7FFF) << 15 | (id & 0x7FFF);
+        }
+    }
+    else
+        return;
+
+    if (index / (uint32_t)R->per >= (uint32_t)R->admitted)
+        return;
+    trace_target_t *t = &R->tg[index / (uint32_t)R->per];
+    int k = (int)(index % (uint32_t)R->per);
+    if (t->state != TGT_SENDING && t->state != TGT_DRAINING)
+        return;
+    trace_probe_t *pr = &t->pr[k];
+    if (t->dst.sin_addr.s_addr != dst || pr->state != PROBE_SENT)
+        return; // someone else's, or a duplicate
+    pr->state = PROBE_ANSWERED;
+    pr->rtt_ms = (float)(now - pr->sent_ms);
+    pr->from = from;
+    pr->type = icmp->type;
+    pr->code = icmp->code;
+    t->nans++;
+    int ttl = k % c->max_hops + 1;
+    if (icmp->type != ICMP_TIME_EXCEEDED && ttl < t->stop_ttl)
+        t->stop_ttl = ttl; // the path ends here: destination, or an unreachable
+    if (icmp->type != ICMP_TIME_EXCEEDED && from == t->dst.sin_addr.s_addr)
+        t->reached = true;
+}
+
+static void trace_drain(trace_run_t *R)
+{
+    for (;;)
+    {
+        unsigned char buf[1500];
+        struct sockaddr_in from;
+        socklen_t fl = sizeof(from);
+        ssize_t n = recvfrom(R->rcv, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&from, &fl);
+        if (n < 0)
+            return;
+        trace_on_reply(R, buf, (size_t)n, from.sin_addr.s_addr, trace_now_ms());
+    }
+}
+
+// write out and retire targets that have nothing more to wait for
+static void trace_reap(trace_run_t *R, double now)
+{
+    for (int i = 0; i < R->nlive;)
+    {
+        trace_target_t *t = &R->tg[R->live[i]];
+        if (t->state == TGT_SENDING && trace_next_slot(R, t) < 0)
+            t->state = TGT_DRAINING;
+        bool finished = t->state == TGT_DRAINING &&
+                        (t->nans == t->nsent || now - t->last_send_ms >= R->cfg->timeout_ms);
+        if (!finished)
+        {
+            i++;
+            continue;
+        }
+        trace_emit(R, t);
+        free(t->pr);
+        t->pr = NULL;
+        t->state = TGT_DONE;
+        R->done++;
+        R->live[i] = R->live[--R->nlive];
+    }
+}
+
+static int trace_raw_socket(int proto, bool hdrincl)
+{
+    int s = socket(AF_INET, SOCK_RAW, proto);
+    if (s < 0)
+    {
+        perror("socket raw");
+        return -1;
+    }
+    int one = 1, buf = 4 << 20;
+    if (hdrincl && setsockopt(s, IPPROTO_IP, IP_HDRINCL, &one, sizeof(one)) < 0)
+    {
+        perror("setsockopt(IP_HDRINCL)");
+        close(s);
+        return -1;
+    }
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+    setsockopt(s, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+    return s;
+}
+
+// Trace every host in hosts[] with the settings in cfg; returns 0, or 1 on setup failure
+static int trace_async_run(const trace_cfg_t *cfg, const char **hosts, int nhosts)
+{
+    trace_run_t R = {0};
+    R.cfg = cfg;
+    R.ntg = nhosts;
+    R.per = cfg->max_hops * cfg->probes;
+    R.ident = (unsigned short)getpid();
+    if (cfg->max_hops < 1 || cfg->max_hops > 255 || cfg->probes < 1 || cfg->concurrency < 1 || cfg->rate_pps <= 0)
+    {
+        fprintf(stderr, "bad parameters\n");
+        return 1;
+    }
+    // the reply encodings carry 32 (ICMP) or 30 (UDP) bits of probe index
+    if ((double)nhosts * R.per >= (cfg->proto == TRACE_ICMP ? 4294967296.0 : 1073741824.0))
+    {
+        fprintf(stderr, "too many probes\n");
+        return 1;
+    }
+    R.tg = calloc((size_t)nhosts, sizeof(*R.tg));
+    R.live = calloc((size_t)cfg->concurrency, sizeof(*R.live));
+    if (!R.tg || !R.live)
+    {
+        perror("calloc");
+        free(R.tg);
+        free(R.live);
+        return 1;
+    }
+    for (int i = 0; i < nhosts; i++)
+        R.tg[i].name = hosts[i];
+
+    R.snd = trace_raw_socket(cfg->proto == TRACE_ICMP ? IPPROTO_ICMP : IPPROTO_UDP, true);
+    R.rcv = cfg->proto == TRACE_ICMP ? R.snd : trace_raw_socket(IPPROTO_ICMP, false);
+    if (R.snd < 0 || R.rcv < 0)
+    {
+        if (R.snd >= 0)
+            close(R.snd);
+        free(R.tg);
+        free(R.live);
+        return 1;
+    }
+    if (cfg->proto == TRACE_UDP)
+    {
+        // the UDP raw socket would get a copy of every UDP packet the host receives
+        struct sock_filter none = BPF_STMT(BPF_RET | BPF_K, 0);
+        struct sock_fprog fp = {1, &none};
+        setsockopt(R.snd, SOL_SOCKET, SO_ATTACH_FILTER, &fp, sizeof(fp));
+    }
+
+    double gap = 1000.0 / cfg->rate_pps, next_send = trace_now_ms();
+    trace_admit(&R);
+    while (R.done < R.ntg)
+    {
+        double now = trace_now_ms();
+        if (next_send < now - 10)
+            next_send = now; // do not make up for lost time in a burst
+        // send what the pacing allows, round-robin over sending targets
+        int idle = 0;
+        while (next_send <= now && R.nlive && idle < R.nlive)
+        {
+            R.rr %= R.nlive;
+            trace_target_t *t = &R.tg[R.live[R.rr++]];
+            int k = t->state == TGT_SENDING ? trace_next_slot(&R, t) : -1;
+            if (k < 0)
+            {
+                idle++;
+                continue;
+            }
+            idle = 0;
+            if (trace_send(&R, t, k) < 0)
+                break;
+            t->next++;
+            next_send += gap;
+        }
+        trace_drain(&R);
+        trace_reap(&R, trace_now_ms());
+        trace_admit(&R);
+
+        now = trace_now_ms();
+        int wait = 20;
+        if (idle < R.nlive && next_send > now && next_send - now < wait)
+            wait = (int)(next_send - now);
+        else if (idle < R.nlive && next_send <= now)
+            wait = 0;
+        struct pollfd pfd = {R.rcv, POLLIN, 0};
+        poll(&pfd, 1, wait);
+    }
+    if (R.rcv != R.snd)
+        close(R.rcv);
+    close(R.snd);
+    free(R.tg);
+    free(R.live);
+    return 0;
+}
+
+// Read destinations from a file ("-" for stdin): one per line, '#' starts a comment.
+// Appends to *hosts (realloc'd); returns the new count, or -1.
+static int trace_read_hosts(const char *path, const char ***hosts, int n)
+{
+    FILE *f = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+    char line[512];
+    int cap = n;
+    while (fgets(line, sizeof(line), f))
+    {
+        char *s = line, *e;
+        if ((e = strchr(s, '#')))
+            *e = 0;
+        s += strspn(s, " \t\r\n");
+        e = s + strcspn(s, " \t\r\n");
+        *e = 0;
+        if (!*s)
+            continue;
+        if (n == cap)
+        {
+            cap = cap ? cap * 2 : 256;
+            const char **h = realloc(*hosts, (size_t)cap * sizeof(*h));
+            if (!h)
+            {
+                perror("realloc");
+                n = -1;
+                break;
+            }
+            *hosts = h;
+        }
+        (*hosts)[n] = strdup(s);
+        if (!(*hosts)[n])
+        {
+            perror("strdup");
+            n = -1;
+            break;
+        }
+        n++;
+    }
+    if (f != stdin)
+        fclose(f);
+    return n;
+}
+
+#endif
@@ -2,6 +2,8 @@
 // sudo required.
 //
 // Usage: ./traceroute_icmp [-m max_hops] [-q probes] [-w timeout_ms] <host>
+//        ./traceroute_icmp -A [-m max_hops] [-q probes] [-w timeout_ms] [-r pps] [-c targets] [-f file] [host...]
+//        (-A: all probes at once over one raw socket, JSON lines out; see trace_async.h)
 
 #define _GNU_SOURCE
 #include <arpa/inet.h>
@@ -20,22 +22,10 @@
 #include <time.h>
 #include <unistd.h>
 
-static unsigned short icmp_checksum(const void *buf, int len)
-{
-    unsigned long sum = 0;
-    const unsigned short *p = buf;
-    while (len > 1)
-    {
-        sum += *p++;
-        len -= 2;
-    }
-    if (len == 1)
-        sum += *(const unsigned char *)p;
-    // fold
-    sum = (sum >> 16) + (sum & 0xFFFF);
-    sum += (sum >> 16);
-    return (unsigned short)(~sum);
-}
+#include "inet_csum.h"
+#include "trace_async.h"
+
+static unsigned short icmp_checksum(const void *buf, int len) { return inet_csum(buf, (size_t)len); }
 
 static double elapsed_ms(struct timeval a, struct timeval b)
 {
@@ -44,7 +34,10 @@ static double elapsed_ms(struct timeval a, struct timeval b)
 
 static void usage(const char *prog)
 {
-    fprintf(stderr, "Usage: %s [-m max_hops] [-q probes] [-w timeout_ms] host\n", prog);
+    fprintf(stderr,
+            "Usage: %s [-m max_hops] [-q probes] [-w timeout_ms] host\n"
+            "       %s -A [-m max_hops] [-q probes] [-w timeout_ms] [-r pps] [-c targets] [-f file] [host...]\n",
+            prog, prog);
 }
 
 int main(int argc, char **argv)
@@ -52,9 +45,13 @@ int main(int argc, char **argv)
     int max_hops = 30;
     int probes = 3;
     int timeout_ms = 1000;
+    int async = 0;
+    double rate = 1000;
+    int concurrency = 64;
+    const char *host_file = NULL;
 
     int opt;
-    while ((opt = getopt(argc, argv, "m:q:w:")) != -1)
+    while ((opt = getopt(argc, argv, "m:q:w:Ar:c:f:")) != -1)
     {
         switch (opt)
         {
@@ -67,11 +64,47 @@ int main(int argc, char **argv)
         case 'w':
             timeout_ms = atoi(optarg);
             break;
+        case 'A':
+            async = 1;
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'c':
+            concurrency = atoi(optarg);
+            break;
+        case 'f':
+            host_file = optarg;
+            async = 1;
+            break;
         default:
             usage(argv[0]);
             return 1;
         }
     }
+    if (async || argc - optind > 1)
+    {
+        const char **hosts = NULL;
+        int n = 0;
+        if (host_file && (n = trace_read_hosts(host_file, &hosts, 0)) < 0)
+            return 1;
+        const char **h = realloc(hosts, (size_t)(n + argc - optind + 1) * sizeof(*h));
+        if (!h)
+        {
+            perror("realloc");
+            return 1;
+        }
+        hosts = h;
+        for (int i = optind; i < argc; i++)
+            hosts[n++] = argv[i];
+        if (!n)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        trace_cfg_t cfg = {TRACE_ICMP, max_hops, probes, timeout_ms, rate, concurrency, 33434};
+        return trace_async_run(&cfg, hosts, n);
+    }
     if (optind >= argc)
     {
         usage(argv[0]);
@@ -4,6 +4,8 @@
 // sudo required (raw ICMP receive socket).
 //
 // Usage: ./traceroute_udp [-m max_hops] [-q probes] [-w timeout_ms] [-p base_port] host
+//        ./traceroute_udp -A [-m max_hops] [-q probes] [-w timeout_ms] [-p base_port] [-r pps] [-c targets] [-f file] [host...]
+//        (-A: all probes at once over one raw socket, JSON lines out; see trace_async.h)
 
 #define _GNU_SOURCE
 #include <arpa/inet.h>
@@ -21,6 +23,8 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "trace_async.h"
+
 static double elapsed_ms(struct timeval a, struct timeval b)
 {
     return (b.tv_sec - a.tv_sec) * 1000.0 + (b.tv_usec - a.tv_usec) / 1000.0;
@@ -28,7 +32,10 @@ static double elapsed_ms(struct timeval a, struct timeval b)
 
 static void usage(const char *prog)
 {
-    fprintf(stderr, "Usage: %s [-m max_hops] [-q probes] [-w timeout_ms] [-p base_port] host\n", prog);
+    fprintf(stderr,
+            "Usage: %s [-m max_hops] [-q probes] [-w timeout_ms] [-p base_port] host\n"
+            "       %s -A [-m max_hops] [-q probes] [-w timeout_ms] [-p base_port] [-r pps] [-c targets] [-f file] [host...]\n",
+            prog, prog);
 }
 
 int main(int argc, char **argv)
@@ -36,10 +43,14 @@ int main(int argc, char **argv)
     int max_hops = 30;
     int probes = 3;
     int timeout_ms = 1000;
+    int async = 0;
+    double rate = 1000;
+    int concurrency = 64;
+    const char *host_file = NULL;
     int base_port = 33434;
 
     int opt;
-    while ((opt = getopt(argc, argv, "m:q:w:p:")) != -1)
+    while ((opt = getopt(argc, argv, "m:q:w:p:Ar:c:f:")) != -1)
     {
         switch (opt)
         {
@@ -55,11 +66,47 @@ int main(int argc, char **argv)
         case 'p':
             base_port = atoi(optarg);
             break;
+        case 'A':
+            async = 1;
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'c':
+            concurrency = atoi(optarg);
+            break;
+        case 'f':
+            host_file = optarg;
+            async = 1;
+            break;
         default:
             usage(argv[0]);
             return 1;
         }
     }
+    if (async || argc - optind > 1)
+    {
+        const char **hosts = NULL;
+        int n = 0;
+        if (host_file && (n = trace_read_hosts(host_file, &hosts, 0)) < 0)
+            return 1;
+        const char **h = realloc(hosts, (size_t)(n + argc - optind + 1) * sizeof(*h));
+        if (!h)
+        {
+            perror("realloc");
+            return 1;
+        }
+        hosts = h;
+        for (int i = optind; i < argc; i++)
+            hosts[n++] = argv[i];
+        if (!n)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        trace_cfg_t cfg = {TRACE_UDP, max_hops, probes, timeout_ms, rate, concurrency, base_port};
+        return trace_async_run(&cfg, hosts, n);
+    }
     if (optind >= argc)
     {
         usage(argv[0]);
@@ -5,6 +5,7 @@
  *  - Pure-C routines to build and parse UDP/IPv4 packets (no libc sockets needed)
  *  - Correct UDP checksum with IPv4 pseudo-header (RFC 768 / RFC 1071)
  *  - Minimal IPv4 header builder (no options, DF=0)
+ *  - Batch pool for sendmmsg()/recvmmsg(), with UDP_SEGMENT (GSO) / UDP_GRO (Linux)
  *  - Optional raw-socket demo (requires CAP_NET_RAW or root)
  *
  * Build (library only):
@@ -34,6 +35,12 @@ sudo ./udp_demo send 127.0.0.1 9000 "hello"
 #sniff UDP packets for a given destination port
 sudo ./udp_demo sniff 9000
 
+#traffic generator / receiver, rates printed every second(pps and IPv4 Gbps)
+sudo ./udp_demo sink 9000 10 64            # raw socket, recvmmsg, parsed in place
+sudo ./udp_demo blast 127.0.0.1 9000 1400 5 64   # IP_HDRINCL, 64 packets per sendmmsg
+./udp_demo sink 9000 10 64 1               # UDP socket with UDP_GRO
+./udp_demo blast 127.0.0.1 9000 1400 5 16 32     # UDP_SEGMENT, 32 datagrams per message
+
 #endif
 
 #define _GNU_SOURCE
@@ -51,26 +58,16 @@ sudo ./udp_demo sniff 9000
 #include <netinet/in.h>
 #include <netinet/ip.h>
 #include <netinet/udp.h>
+#include <sys/uio.h>
+#include <signal.h>
 #include <unistd.h>
 
+#include "inet_csum.h"
+
 /* =================== Helpers =================== */
 static inline uint16_t bswap16(uint16_t x) { return (uint16_t)((x << 8) | (x >> 8)); }
 
-static uint16_t checksum16(const void *data, size_t len)
-{
-    const uint16_t *w = (const uint16_t *)data;
-    uint32_t sum = 0;
-    while (len > 1)
-    {
-        sum += *w++;
-        len -= 2;
-    }
-    if (len)
-        sum += *(const uint8_t *)w;
-    while (sum >> 16)
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    return (uint16_t)~sum;
-}
+static uint16_t checksum16(const void *data, size_t len) { return inet_csum(data, len); }
 
 /* =================== UDP + IPv4 build =================== */
 #pragma pack(push, 1)
@@ -124,40 +121,24 @@ static void ipv4_build(ipv4_hdr_t *ip, uint16_t total_len, uint32_t saddr_be, ui
     ip->checksum = checksum16(ip, sizeof(*ip));
 }
 
-/* Compute UDP checksum across pseudo-header + udp header + payload */
-static uint16_t udp_checksum_ipv4(uint32_t saddr_be, uint32_t daddr_be,
-                                  const udp_hdr_t *uh, const uint8_t *payload, size_t payload_len)
+/* Compute UDP checksum across pseudo-header + udp header + payload;
+   sum_payload is the payload's partial sum if the caller already has it (csum_copy) */
+static uint16_t udp_checksum_sum(uint32_t saddr_be, uint32_t daddr_be, const udp_hdr_t *uh, uint64_t sum_payload,
+                                 size_t payload_len)
 {
-    pseudo_hdr_t ph = {saddr_be, daddr_be, 0, IPPROTO_UDP, htons((uint16_t)(sizeof(udp_hdr_t) + payload_len))};
-    uint32_t sum = 0;
-
-    // sum pseudo header
-    const uint16_t *pw = (const uint16_t *)&ph;
-    for (size_t i = 0; i < sizeof(ph) / 2; i++)
-        sum += pw[i];
-
-    // sum udp header (with checksum field as 0)
+    uint64_t sum = csum_pseudo_ipv4(saddr_be, daddr_be, IPPROTO_UDP, (uint16_t)(sizeof(udp_hdr_t) + payload_len));
+    // udp header with the checksum field as 0
     udp_hdr_t tmp = *uh;
     tmp.checksum = 0;
-    pw = (const uint16_t *)&tmp;
-    for (size_t i = 0; i < sizeof(tmp) / 2; i++)
-        sum += pw[i];
-
-    // sum payload
-    const uint8_t *p = payload;
-    size_t len = payload_len;
-    while (len > 1)
-    {
-        sum += (uint16_t)((p[0] << 8) | p[1]);
-        p += 2;
-        len -= 2;
-    }
-    if (len)
-        sum += (uint16_t)(p[0] << 8);
+    sum = csum_partial(&tmp, sizeof(tmp), sum);
+    uint16_t cs = inet_csum_finish(csum_add(sum, sum_payload));
+    return cs ? cs : 0xFFFF; // 0 would mean "no checksum" (RFC 768)
+}
 
-    while (sum >> 16)
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    return (uint16_t)~sum;
+static uint16_t udp_checksum_ipv4(uint32_t saddr_be, uint32_t daddr_be,
+                                  const udp_hdr_t *uh, const uint8_t *payload, size_t payload_len)
+{
+    return udp_checksum_sum(saddr_be, daddr_be, uh, csum_partial(payload, payload_len, 0), payload_len);
 }
 
 /*
@@ -182,14 +163,11 @@ size_t udp_build_ipv4_packet(uint8_t *buf, size_t buflen,
     uh->len = htons((uint16_t)(sizeof(udp_hdr_t) + payload_len));
     uh->checksum = 0;
 
-    // copy payload
-    if (payload_len)
-        memcpy(buf + sizeof(ipv4_hdr_t) + sizeof(udp_hdr_t), payload, payload_len);
+    // copy payload, summing it on the way
+    uint64_t psum = csum_copy(buf + sizeof(ipv4_hdr_t) + sizeof(udp_hdr_t), payload, payload_len, 0);
 
     // compute UDP checksum
-    uh->checksum = udp_checksum_ipv4(src_ip_be, dst_ip_be, uh,
-                                     buf + sizeof(ipv4_hdr_t) + sizeof(udp_hdr_t),
-                                     payload_len);
+    uh->checksum = udp_checksum_sum(src_ip_be, dst_ip_be, uh, psum, payload_len);
 
     // build IPv4 header
     ipv4_build(ip, (uint16_t)need, src_ip_be, dst_ip_be, ip_id, ttl, IPPROTO_UDP);
@@ -247,6 +225,184 @@ bool udp_parse_ipv4_packet(const uint8_t *pkt, size_t len, udp_parsed_t *out)
     return true;
 }
 
+/* =================== Batch send/receive (Linux) =================== */
+/*
+ * A udp_batch_t is one contiguous pool of `count` slots, each `stride` bytes
+ * (a multiple of 64, so every packet starts on its own cache line), with an
+ * mmsghdr/iovec pair pre-pointed at every slot. The same pool serves both
+ * directions: udp_batch_build() fills it with IPv4+UDP packets for
+ * sendmmsg() on an IP_HDRINCL socket, udp_batch_recv() lets recvmmsg() land
+ * datagrams straight into it so they can be parsed where they lie.
+ *
+ * For UDP_SEGMENT (GSO) and UDP_GRO the kernel owns the headers: a slot then
+ * holds a run of payloads that the stack splits into, or coalesced from,
+ * equal-sized datagrams on an ordinary SOCK_DGRAM socket.
+ */
+#ifdef __linux__
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+#define UDP_BATCH_CTRL CMSG_SPACE(sizeof(int))
+
+typedef struct
+{
+    uint8_t *pool;        // count * stride bytes, one allocation
+    size_t stride;        // slot size
+    size_t count;         // slots (messages per syscall)
+    struct mmsghdr *msgs; // msgs[i] -> iov[i] -> pool + i * stride
+    struct iovec *iov;
+    uint8_t *ctrl;        // UDP_BATCH_CTRL bytes per slot for the UDP_GRO cmsg
+} udp_batch_t;
+
+void udp_batch_free(udp_batch_t *b)
+{
+    free(b->pool);
+    free(b->msgs);
+    free(b->iov);
+    free(b->ctrl);
+    memset(b, 0, sizeof(*b));
+}
+
+/* Returns 0, or -1 if out of memory */
+int udp_batch_init(udp_batch_t *b, size_t count, size_t slot_len)
+{
+    memset(b, 0, sizeof(*b));
+    if (!count || !slot_len)
+        return -1;
+    b->stride = (slot_len + 63) & ~(size_t)63;
+    b->count = count;
+    b->pool = aligned_alloc(64, count * b->stride);
+    b->msgs = calloc(count, sizeof(*b->msgs));
+    b->iov = calloc(count, sizeof(*b->iov));
+    b->ctrl = calloc(count, UDP_BATCH_CTRL);
+    if (!b->pool || !b->msgs || !b->iov || !b->ctrl)
+    {
+        udp_batch_free(b);
+        return -1;
+    }
+    memset(b->pool, 0, count * b->stride);
+    for (size_t i = 0; i < count; i++)
+    {
+        b->iov[i].iov_base = b->pool + i * b->stride;
+        b->iov[i].iov_len = b->stride;
+        b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+        b->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    return 0;
+}
+
+static inline uint8_t *udp_batch_slot(const udp_batch_t *b, size_t i) { return b->pool + i * b->stride; }
+
+/* Give packets [0, n) IP ids first_id upwards, keeping the header checksums valid */
+void udp_batch_renumber(udp_batch_t *b, size_t n, uint16_t first_id)
+{
+    for (size_t i = 0; i < n && i < b->count; i++)
+    {
+        ipv4_hdr_t *ip = (ipv4_hdr_t *)udp_batch_slot(b, i);
+        csum_set16(&ip->checksum, &ip->id, htons((uint16_t)(first_id + i)));
+    }
+}
+
+/*
+ * Fill every slot with the same datagram, IP id counting up from ip_id.
+ * Slot 0 goes through udp_build_ipv4_packet(); the rest are copies with the
+ * id patched and the header checksum updated incrementally (the UDP
+ * checksum does not cover the IP header, so it carries over unchanged).
+ * Returns the packet length, or 0 if it does not fit a slot.
+ */
+size_t udp_batch_build(udp_batch_t *b, uint32_t src_ip_be, uint16_t src_port,
+                       uint32_t dst_ip_be, uint16_t dst_port,
+                       const uint8_t *payload, size_t payload_len,
+                       uint16_t ip_id, uint8_t ttl)
+{
+    if (sizeof(ipv4_hdr_t) + sizeof(udp_hdr_t) + payload_len > 0xFFFF)
+        return 0;
+    size_t n = udp_build_ipv4_packet(b->pool, b->stride, src_ip_be, src_port, dst_ip_be, dst_port,
+                                     payload, payload_len, ip_id, ttl);
+    if (!n)
+        return 0;
+    for (size_t i = 0; i < b->count; i++)
+    {
+        if (i)
+            memcpy(udp_batch_slot(b, i), b->pool, n);
+        b->iov[i].iov_len = n;
+    }
+    udp_batch_renumber(b, b->count, ip_id);
+    return n;
+}
+
+/*
+ * Send slots [0, n) with as few sendmmsg() calls as the kernel allows.
+ * dst may be NULL on a connected socket. Returns the number of messages
+ * sent (short on EINTR/EAGAIN/ENOBUFS), or -1 if nothing could be sent.
+ */
+int udp_batch_send(int fd, udp_batch_t *b, size_t n, const struct sockaddr_in *dst)
+{
+    if (n > b->count)
+        n = b->count;
+    for (size_t i = 0; i < n; i++)
+    {
+        b->msgs[i].msg_hdr.msg_name = (void *)dst;
+        b->msgs[i].msg_hdr.msg_namelen = dst ? sizeof(*dst) : 0;
+        b->msgs[i].msg_hdr.msg_control = NULL;
+        b->msgs[i].msg_hdr.msg_controllen = 0;
+    }
+    size_t done = 0;
+    while (done < n)
+    {
+        int r = sendmmsg(fd, b->msgs + done, (unsigned)(n - done), 0);
+        if (r < 0)
+        {
+            if (done)
+                break;
+            return -1;
+        }
+        done += (size_t)r;
+    }
+    return (int)done;
+}
+
+/*
+ * Receive up to count datagrams into the pool: blocks for the first, then
+ * takes whatever else is already queued (MSG_WAITFORONE). msgs[i].msg_len
+ * is each datagram's length. Returns the count, or -1 with errno set.
+ */
+int udp_batch_recv(int fd, udp_batch_t *b)
+{
+    for (size_t i = 0; i < b->count; i++)
+    {
+        b->iov[i].iov_len = b->stride;
+        b->msgs[i].msg_hdr.msg_name = NULL;
+        b->msgs[i].msg_hdr.msg_namelen = 0;
+        b->msgs[i].msg_hdr.msg_control = b->ctrl + i * UDP_BATCH_CTRL;
+        b->msgs[i].msg_hdr.msg_controllen = UDP_BATCH_CTRL;
+        b->msgs[i].msg_hdr.msg_flags = 0;
+    }
+    return recvmmsg(fd, b->msgs, (unsigned)b->count, MSG_WAITFORONE, NULL);
+}
+
+/* Segment size of a coalesced UDP_GRO datagram in slot i, 0 if it was not coalesced */
+int udp_batch_gro_size(const udp_batch_t *b, size_t i)
+{
+    struct msghdr *mh = (struct msghdr *)&b->msgs[i].msg_hdr;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(mh); c; c = CMSG_NXTHDR(mh, c))
+        if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO)
+        {
+            int sz;
+            memcpy(&sz, CMSG_DATA(c), sizeof(sz));
+            return sz;
+        }
+    return 0;
+}
+#endif
+
 /* =================== Raw send demo =================== */
 #ifdef UDP_DEMO_MAIN
 static int demo_send(const char *dst_ip_str, uint16_t dport, const char *payload)
@@ -346,11 +502,284 @@ static int demo_sniff(uint16_t listen_port)
     return 0;
 }
 
+/* =================== Batched generator / sink demo =================== */
+static volatile sig_atomic_t g_stop;
+
+static void on_sigint(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+static void demo_catch_sigint(void)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigint; // no SA_RESTART: a blocked recvmmsg() must return
+    sigaction(SIGINT, &sa, NULL);
+}
+
+static double demo_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// bytes are IPv4 bytes (headers included), i.e. the wire rate less L2 framing
+static void demo_rate(const char *tag, uint64_t pkts, uint64_t bytes, double dt)
+{
+    if (dt <= 0)
+        return;
+    printf("%s %10.0f pps %8.3f Gbps  (%llu pkts in %.2fs)\n", tag, pkts / dt, bytes * 8 / dt / 1e9,
+           (unsigned long long)pkts, dt);
+    fflush(stdout);
+}
+
+/*
+ * Send for `secs` seconds, `batch` messages per sendmmsg(). With gso_segs
+ * at 0 every message is one packet from udp_batch_build() on an IP_HDRINCL
+ * socket; otherwise every message is gso_segs payloads that the kernel cuts
+ * into datagrams (UDP_SEGMENT), on a connected UDP socket.
+ */
+static int demo_blast(const char *dst_ip_str, uint16_t dport, size_t plen, double secs, size_t batch,
+                      size_t gso_segs)
+{
+    struct sockaddr_in dst = {0};
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(dport);
+    if (inet_pton(AF_INET, dst_ip_str, &dst.sin_addr) != 1)
+    {
+        fprintf(stderr, "bad dst ip\n");
+        return 1;
+    }
+    size_t wire = sizeof(ipv4_hdr_t) + sizeof(udp_hdr_t) + plen;
+    // a GSO message is one UDP datagram until the kernel splits it, so it has the same size limit
+    if (wire > 0xFFFF || (gso_segs && (plen == 0 || gso_segs * plen > 0xFFFF - (wire - plen))))
+    {
+        fprintf(stderr, "packet too big\n");
+        return 1;
+    }
+
+    int s = gso_segs ? socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP) : socket(AF_INET, SOCK_RAW, IPPROTO_UDP);
+    if (s < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+    int one = 1, sz = (int)plen;
+    if (gso_segs)
+    {
+        if (connect(s, (struct sockaddr *)&dst, sizeof(dst)) < 0)
+        {
+            perror("connect");
+            close(s);
+            return 1;
+        }
+        if (setsockopt(s, SOL_UDP, UDP_SEGMENT, &sz, sizeof(sz)) < 0)
+        {
+            perror("UDP_SEGMENT");
+            close(s);
+            return 1;
+        }
+    }
+    else if (setsockopt(s, IPPROTO_IP, IP_HDRINCL, &one, sizeof(one)) < 0)
+    {
+        perror("IP_HDRINCL");
+        close(s);
+        return 1;
+    }
+    int sndbuf = 4 << 20;
+    setsockopt(s, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    udp_batch_t b;
+    if (udp_batch_init(&b, batch, gso_segs ? gso_segs * plen : wire) < 0)
+    {
+        fprintf(stderr, "out of memory\n");
+        close(s);
+        return 1;
+    }
+    uint8_t *payload = malloc(plen ? plen : 1);
+    if (!payload)
+    {
+        fprintf(stderr, "out of memory\n");
+        udp_batch_free(&b);
+        close(s);
+        return 1;
+    }
+    for (size_t i = 0; i < plen; i++)
+        payload[i] = (uint8_t)('a' + i % 26);
+
+    uint16_t id = (uint16_t)rand();
+    if (gso_segs)
+        for (size_t i = 0; i < batch; i++)
+        {
+            for (size_t k = 0; k < gso_segs; k++)
+                memcpy(udp_batch_slot(&b, i) + k * plen, payload, plen);
+            b.iov[i].iov_len = gso_segs * plen;
+        }
+    else
+        udp_batch_build(&b, htonl(INADDR_LOOPBACK), 55555, dst.sin_addr.s_addr, dport, payload, plen, id,
+                        64); // same source choice as demo_send
+    free(payload);
+
+    size_t per_msg = gso_segs ? gso_segs : 1;
+    printf("blasting %s:%u: %zu-byte payloads, %zu msgs/syscall%s\n", dst_ip_str, (unsigned)dport, plen, batch,
+           gso_segs ? " with UDP_SEGMENT" : "");
+    demo_catch_sigint();
+    uint64_t pkts = 0, last_pkts = 0, calls = 0, drops = 0;
+    double t0 = demo_now(), tick = t0, t = t0;
+    while (!g_stop && t - t0 < secs)
+    {
+        int r = udp_batch_send(s, &b, batch, gso_segs ? NULL : &dst);
+        calls++;
+        if (r < 0)
+        {
+            if (errno == ENOBUFS || errno == EAGAIN || errno == EINTR || errno == ECONNREFUSED)
+            {
+                drops += batch;
+                t = demo_now();
+                continue;
+            }
+            perror("sendmmsg");
+            break;
+        }
+        pkts += (uint64_t)r * per_msg;
+        if (!gso_segs)
+        {
+            id = (uint16_t)(id + r);
+            udp_batch_renumber(&b, (size_t)r, id);
+        }
+        t = demo_now();
+        if (t - tick >= 1.0)
+        {
+            demo_rate("tx", pkts - last_pkts, (pkts - last_pkts) * wire, t - tick);
+            last_pkts = pkts;
+            tick = t;
+        }
+    }
+    demo_rate("tx total", pkts, pkts * wire, t - t0);
+    printf("%llu syscalls, %llu messages not sent (ENOBUFS/EAGAIN)\n", (unsigned long long)calls,
+           (unsigned long long)drops);
+    udp_batch_free(&b);
+    close(s);
+    return 0;
+}
+
+/*
+ * Count datagrams to listen_port for `secs` seconds (0: until Ctrl+C).
+ * Without gro, a raw socket takes `batch` packets per recvmmsg() and each
+ * is checked by udp_parse_ipv4_packet() in the pool slot it arrived in.
+ * With gro, a bound UDP socket with UDP_GRO receives coalesced runs of
+ * payloads; the kernel has already verified and stripped the headers.
+ */
+static int demo_sink(uint16_t listen_port, double secs, size_t batch, int gro)
+{
+    int s = gro ? socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP) : socket(AF_INET, SOCK_RAW, IPPROTO_UDP);
+    if (s < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+    int one = 1, rcvbuf = 16 << 20;
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    // wake up regularly to print rates and notice the deadline
+    struct timeval tv = {0, 200000};
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (gro)
+    {
+        struct sockaddr_in a = {0};
+        a.sin_family = AF_INET;
+        a.sin_port = htons(listen_port);
+        a.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(s, (struct sockaddr *)&a, sizeof(a)) < 0)
+        {
+            perror("bind");
+            close(s);
+            return 1;
+        }
+        if (setsockopt(s, SOL_UDP, UDP_GRO, &one, sizeof(one)) < 0)
+        {
+            perror("UDP_GRO");
+            close(s);
+            return 1;
+        }
+    }
+    udp_batch_t b;
+    if (udp_batch_init(&b, batch, 65536) < 0)
+    {
+        fprintf(stderr, "out of memory\n");
+        close(s);
+        return 1;
+    }
+
+    printf("sinking UDP to port %u, %zu msgs/syscall%s... (Ctrl+C to quit)\n", (unsigned)listen_port, batch,
+           gro ? " with UDP_GRO" : "");
+    demo_catch_sigint();
+    const size_t hdrs = sizeof(ipv4_hdr_t) + sizeof(udp_hdr_t);
+    uint64_t pkts = 0, bytes = 0, bad = 0, calls = 0, last_pkts = 0, last_bytes = 0;
+    double t0 = 0, tick = 0, t = 0; // the clock starts at the first packet
+    while (!g_stop && (!secs || !t0 || t - t0 < secs))
+    {
+        int r = udp_batch_recv(s, &b);
+        t = demo_now();
+        if (r < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            perror("recvmmsg");
+            break;
+        }
+        if (r > 0)
+        {
+            calls++;
+            if (!t0)
+                t0 = tick = t;
+        }
+        for (int i = 0; i < r; i++)
+        {
+            const uint8_t *p = udp_batch_slot(&b, (size_t)i);
+            size_t len = b.msgs[i].msg_len;
+            if (gro)
+            {
+                size_t seg = (size_t)udp_batch_gro_size(&b, (size_t)i);
+                size_t n = seg ? (len + seg - 1) / seg : 1;
+                pkts += n;
+                bytes += len + n * hdrs;
+                continue;
+            }
+            udp_parsed_t P;
+            if (!udp_parse_ipv4_packet(p, len, &P) || P.dst_port != listen_port)
+                continue;
+            pkts++;
+            bytes += len;
+            if (!P.checksum_ok)
+                bad++;
+        }
+        if (t0 && t - tick >= 1.0)
+        {
+            demo_rate("rx", pkts - last_pkts, bytes - last_bytes, t - tick);
+            last_pkts = pkts;
+            last_bytes = bytes;
+            tick = t;
+        }
+    }
+    if (t0)
+        demo_rate("rx total", pkts, bytes, t - t0);
+    printf("%llu syscalls, %llu bad checksums\n", (unsigned long long)calls, (unsigned long long)bad);
+    udp_batch_free(&b);
+    close(s);
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     if (argc < 2)
     {
-        fprintf(stderr, "Usage: %s send <dst_ip> <dst_port> <data>\n       %s sniff <dst_port>\n", argv[0], argv[0]);
+        fprintf(stderr,
+                "Usage: %s send <dst_ip> <dst_port> <data>\n"
+                "       %s sniff <dst_port>\n"
+                "       %s blast <dst_ip> <dst_port> <payload_bytes> [secs=5] [batch=64] [gso_segs=0]\n"
+                "       %s sink <dst_port> [secs=0] [batch=64] [gro=0]\n",
+                argv[0], argv[0], argv[0], argv[0]);
         return 1;
     }
     if (!strcmp(argv[1], "send"))
@@ -373,6 +802,40 @@ int main(int argc, char **argv)
         uint16_t p = (uint16_t)atoi(argv[2]);
         return demo_sniff(p);
     }
+    else if (!strcmp(argv[1], "blast"))
+    {
+        if (argc < 5)
+        {
+            fprintf(stderr, "blast needs <dst_ip> <dst_port> <payload_bytes>\n");
+            return 1;
+        }
+        double secs = argc > 5 ? atof(argv[5]) : 5;
+        int batch = argc > 6 ? atoi(argv[6]) : 64;
+        int segs = argc > 7 ? atoi(argv[7]) : 0;
+        if (batch < 1 || batch > 1024 || segs < 0 || segs > 64)
+        {
+            fprintf(stderr, "batch must be 1..1024, gso_segs 0..64\n");
+            return 1;
+        }
+        return demo_blast(argv[2], (uint16_t)atoi(argv[3]), (size_t)atoi(argv[4]), secs, (size_t)batch,
+                          (size_t)segs);
+    }
+    else if (!strcmp(argv[1], "sink"))
+    {
+        if (argc < 3)
+        {
+            fprintf(stderr, "sink needs <dst_port>\n");
+            return 1;
+        }
+        double secs = argc > 3 ? atof(argv[3]) : 0;
+        int batch = argc > 4 ? atoi(argv[4]) : 64;
+        if (batch < 1 || batch > 1024)
+        {
+            fprintf(stderr, "batch must be 1..1024\n");
+            return 1;
+        }
+        return demo_sink((uint16_t)atoi(argv[2]), secs, (size_t)batch, argc > 5 && atoi(argv[5]));
+    }
     fprintf(stderr, "unknown command\n");
     return 1;
 }
@@ -6,6 +6,8 @@
  * - Escape: 0x7D, escaped_byte = byte ^ 0x20
  * - FCS: CRC-16/PPP (poly 0x8408 reflected, init 0xFFFF, final ones' complement)
  * - Valid frame check: if you run the CRC over payload+FCS, result is 0xF0B8.
+ * - CRC, stuffing and the stream decoder come from hdlc_frame.h (slice-by-8
+ *   CRC, SIMD flag/escape scan); hdlc_bench.c measures them.
  *
  * Build: gcc -std=c99 -O2 -Wall hdlc_demo.c -o hdlc_demo
  *
@@ -20,48 +22,7 @@
 #include <string.h>
 #include <ctype.h>
 
-#define HDLC_FLAG 0x7E
-#define HDLC_ESC 0x7D
-#define HDLC_XOR 0x20
-
-/* ---------- CRC-16/PPP (CCITT, reflected) ---------- */
-static uint16_t crc16_ppp_update(uint16_t fcs, uint8_t b)
-{
-    /* Polynomial 0x8408 (reversed 0x1021), init 0xFFFF */
-    fcs ^= b;
-    for (int i = 0; i < 8; ++i)
-    {
-        if (fcs & 1)
-            fcs = (fcs >> 1) ^ 0x8408;
-        else
-            fcs = (fcs >> 1);
-    }
-    return fcs;
-}
-
-static uint16_t crc16_ppp(const uint8_t *data, size_t len)
-{
-    uint16_t fcs = 0xFFFF;
-    for (size_t i = 0; i < len; ++i)
-        fcs = crc16_ppp_update(fcs, data[i]);
-    return (uint16_t)~fcs; /* ones' complement */
-}
-
-/* If you compute CRC over payload+FCS (little-endian), good frames end at 0xF0B8 */
-static int crc16_ppp_verify(const uint8_t *payload, size_t len, const uint8_t fcs_le[2])
-{
-    uint8_t tmp[2048];
-    if (len + 2 > sizeof(tmp))
-        return 0;
-    memcpy(tmp, payload, len);
-    tmp[len + 0] = fcs_le[0];
-    tmp[len + 1] = fcs_le[1];
-
-    uint16_t fcs = 0xFFFF;
-    for (size_t i = 0; i < len + 2; ++i)
-        fcs = crc16_ppp_update(fcs, tmp[i]);
-    return (fcs == 0xF0B8); /* PPP "good" residue */
-}
+#include "hdlc_frame.h"
 
 /* ---------- Hex utils ---------- */
 static void hexdump(const char *tag, const uint8_t *b, size_t n)
@@ -75,131 +36,28 @@ static void hexdump(const char *tag, const uint8_t *b, size_t n)
 /* ---------- Encoder: payload -> framed HDLC bytes ---------- */
 static size_t hdlc_encode(const uint8_t *in, size_t inlen, uint8_t *out, size_t outcap)
 {
-    size_t w = 0;
-    if (outcap < 1)
-        return 0;
-    out[w++] = HDLC_FLAG;
-
-    /* Write payload with escaping */
-    for (size_t i = 0; i < inlen; ++i)
-    {
-        uint8_t b = in[i];
-        if (b == HDLC_FLAG || b == HDLC_ESC)
-        {
-            if (w + 2 > outcap)
-                return 0;
-            out[w++] = HDLC_ESC;
-            out[w++] = b ^ HDLC_XOR;
-        }
-        else
-        {
-            if (w + 1 > outcap)
-                return 0;
-            out[w++] = b;
-        }
-    }
-
-    /* Append FCS (little-endian), escaped if needed */
-    uint16_t fcs = crc16_ppp(in, inlen);
-    uint8_t f0 = (uint8_t)(fcs & 0xFF);
-    uint8_t f1 = (uint8_t)(fcs >> 8);
-
-    uint8_t fcs_bytes[2] = {f0, f1};
-    for (int i = 0; i < 2; ++i)
-    {
-        uint8_t b = fcs_bytes[i];
-        if (b == HDLC_FLAG || b == HDLC_ESC)
-        {
-            if (w + 2 > outcap)
-                return 0;
-            out[w++] = HDLC_ESC;
-            out[w++] = b ^ HDLC_XOR;
-        }
-        else
-        {
-            if (w + 1 > outcap)
-                return 0;
-            out[w++] = b;
-        }
-    }
-
-    if (w + 1 > outcap)
-        return 0;
-    out[w++] = HDLC_FLAG;
-    return w;
+    /* FCS appended little-endian; payload and FCS stuffed */
+    return hdlc_encode_frame(NULL, 0, in, inlen, out, outcap);
 }
 
 /* ---------- Decoder (streaming) ---------- */
 typedef struct
 {
     uint8_t buf[2048];
-    size_t len;
-    int in_frame;
-    int esc;
+    hdlc_rx_t rx;
 } hdlc_dec_t;
 
 static void hdlc_dec_init(hdlc_dec_t *d)
 {
-    memset(d, 0, sizeof(*d));
+    hdlc_rx_init(&d->rx, d->buf, sizeof(d->buf));
 }
 
-typedef void (*frame_cb_t)(const uint8_t *payload, size_t len, int fcs_ok, void *user);
+typedef hdlc_frame_cb_t frame_cb_t;
 
 /* Feed bytes; whenever a full frame arrives, call cb() with payload (without FCS) */
 static void hdlc_decode_feed(hdlc_dec_t *d, const uint8_t *data, size_t n, frame_cb_t cb, void *user)
 {
-    for (size_t i = 0; i < n; ++i)
-    {
-        uint8_t b = data[i];
-
-        if (b == HDLC_FLAG)
-        {
-            if (d->in_frame && d->len >= 2)
-            {
-                /* End of frame: split payload/FCS */
-                if (d->len < 2)
-                {
-                    d->len = 0;
-                    d->esc = 0;
-                    continue;
-                }
-                size_t paylen = d->len - 2;
-                uint8_t *p = d->buf;
-                uint8_t fcs_le[2] = {d->buf[paylen], d->buf[paylen + 1]};
-                int ok = crc16_ppp_verify(p, paylen, fcs_le);
-                if (cb)
-                    cb(p, paylen, ok, user);
-            }
-            /* Start new frame */
-            d->in_frame = 1;
-            d->len = 0;
-            d->esc = 0;
-            continue;
-        }
-
-        if (!d->in_frame)
-            continue;
-
-        if (d->esc)
-        {
-            b ^= HDLC_XOR;
-            d->esc = 0;
-        }
-        else if (b == HDLC_ESC)
-        {
-            d->esc = 1;
-            continue;
-        }
-
-        if (d->len < sizeof(d->buf))
-            d->buf[d->len++] = b;
-        else
-        { /* overflow: drop frame */
-            d->in_frame = 0;
-            d->len = 0;
-            d->esc = 0;
-        }
-    }
+    hdlc_rx_feed(&d->rx, data, n, cb, user);
 }
 
 /* ---------- Small helper: parse hex from stdin into bytes ---------- */
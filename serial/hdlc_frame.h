@@ -0,0 +1,326 @@
+/*
+ * hdlc_frame.h — async HDLC framing (RFC 1662) shared by the serial tools
+ *
+ * What this provides
+ *  - CRC-16/PPP (FCS-16) with slice-by-8 tables: eight bytes per step, one
+ *    table lookup per byte and no per-bit loop
+ *  - hdlc_find_special(): find the next 0x7E/0x7D, 32 (AVX2) or 16 (SSE2,
+ *    NEON) bytes per compare, 8 with a SWAR word test otherwise
+ *  - A stuffing encoder and a streaming decoder built on that scan: the runs
+ *    between flag/escape bytes are copied with memcpy, only the special bytes
+ *    themselves take the byte-at-a-time path
+ *
+ * Conventions
+ *  - FCS: poly 0x8408 (reflected 0x1021), init 0xFFFF, complemented and sent
+ *    low byte first. Running the CRC over data+FCS leaves HDLC_FCS_GOOD.
+ *  - Only 0x7E and 0x7D are escaped (ACCM 0): what the demos have always sent.
+ *  - The CRC tables are filled on first use; call hdlc_crc_init() once before
+ *    starting threads that share them.
+ *
+ * Header only (static functions), so each tool stays a single-file build:
+ *   #include "hdlc_frame.h"
+ */
+
+#ifndef HDLC_FRAME_H
+#define HDLC_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HDLC_SCAN_KERNEL "avx2"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define HDLC_SCAN_KERNEL "sse2"
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HDLC_SCAN_KERNEL "neon"
+#else
+#define HDLC_SCAN_KERNEL "swar"
+#endif
+
+#define HDLC_FLAG 0x7E
+#define HDLC_ESC 0x7D
+#define HDLC_XOR 0x20
+#define HDLC_FCS_INIT 0xFFFF
+#define HDLC_FCS_GOOD 0xF0B8
+
+/* ---------- CRC-16/PPP, slice-by-8 ---------- */
+static uint16_t hdlc_crc_tab[8][256];
+static int hdlc_crc_ready;
+
+static inline void hdlc_crc_init(void)
+{
+    if (hdlc_crc_ready)
+        return;
+    for (int i = 0; i < 256; ++i)
+    {
+        uint16_t c = (uint16_t)i;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? (c >> 1) ^ 0x8408 : (c >> 1);
+        hdlc_crc_tab[0][i] = c;
+    }
+    /* tab[k][b]: byte b followed by k zero bytes */
+    for (int k = 1; k < 8; ++k)
+        for (int i = 0; i < 256; ++i)
+        {
+            uint16_t c = hdlc_crc_tab[k - 1][i];
+            hdlc_crc_tab[k][i] = (c >> 8) ^ hdlc_crc_tab[0][c & 0xFF];
+        }
+    hdlc_crc_ready = 1;
+}
+
+static inline uint64_t hdlc_load_le64(const uint8_t *p)
+{
+    uint64_t w;
+    memcpy(&w, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+/* Run the (uncomplemented) FCS over len bytes */
+static inline uint16_t hdlc_fcs_update(uint16_t fcs, const uint8_t *p, size_t len)
+{
+    const uint16_t(*t)[256] = (const uint16_t(*)[256])hdlc_crc_tab;
+    if (!hdlc_crc_ready)
+        hdlc_crc_init();
+    while (len >= 8)
+    {
+        uint64_t x = hdlc_load_le64(p) ^ fcs;
+        fcs = t[7][x & 0xFF] ^ t[6][(x >> 8) & 0xFF] ^ t[5][(x >> 16) & 0xFF] ^ t[4][(x >> 24) & 0xFF] ^
+              t[3][(x >> 32) & 0xFF] ^ t[2][(x >> 40) & 0xFF] ^ t[1][(x >> 48) & 0xFF] ^ t[0][x >> 56];
+        p += 8;
+        len -= 8;
+    }
+    while (len--)
+        fcs = (fcs >> 8) ^ t[0][(fcs ^ *p++) & 0xFF];
+    return fcs;
+}
+
+/* The FCS to send for len bytes */
+static inline uint16_t hdlc_fcs(const uint8_t *p, size_t len)
+{
+    return (uint16_t)~hdlc_fcs_update(HDLC_FCS_INIT, p, len);
+}
+
+/* Over a received frame including its two FCS bytes: nonzero if intact */
+static inline int hdlc_fcs_check(const uint8_t *frame, size_t len)
+{
+    return hdlc_fcs_update(HDLC_FCS_INIT, frame, len) == HDLC_FCS_GOOD;
+}
+
+/* ---------- Flag/escape scan ---------- */
+static inline size_t hdlc_find_special_swar(const uint8_t *p, size_t n)
+{
+    const uint64_t ones = 0x0101010101010101ULL, highs = 0x8080808080808080ULL;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t w = hdlc_load_le64(p + i);
+        uint64_t a = w ^ (ones * HDLC_FLAG), b = w ^ (ones * HDLC_ESC);
+        /* a zero byte in a or b; bits above the first hit may be false positives */
+        uint64_t hit = ((a - ones) & ~a & highs) | ((b - ones) & ~b & highs);
+        if (hit)
+            return i + ((size_t)__builtin_ctzll(hit) >> 3);
+    }
+    for (; i < n; ++i)
+        if (p[i] == HDLC_FLAG || p[i] == HDLC_ESC)
+            break;
+    return i;
+}
+
+/* Index of the first 0x7E or 0x7D in p[0..n), or n if there is none */
+static inline size_t hdlc_find_special(const uint8_t *p, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i f32 = _mm256_set1_epi8((char)HDLC_FLAG), e32 = _mm256_set1_epi8((char)HDLC_ESC);
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        uint32_t m = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, f32), _mm256_cmpeq_epi8(v, e32)));
+        if (m)
+            return i + (size_t)__builtin_ctz(m);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i f16 = _mm_set1_epi8((char)HDLC_FLAG), e16 = _mm_set1_epi8((char)HDLC_ESC);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, f16), _mm_cmpeq_epi8(v, e16)));
+        if (m)
+            return i + (size_t)__builtin_ctz(m);
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t f16 = vdupq_n_u8(HDLC_FLAG), e16 = vdupq_n_u8(HDLC_ESC);
+    for (; i + 16 <= n; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(p + i);
+        uint8x16_t hit = vorrq_u8(vceqq_u8(v, f16), vceqq_u8(v, e16));
+        /* narrow to 4 bits per byte: a 64-bit mask NEON can test and ctz */
+        uint64_t m = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if (m)
+            return i + ((size_t)__builtin_ctzll(m) >> 2);
+    }
+#endif
+    return i + hdlc_find_special_swar(p + i, n - i);
+}
+
+/* ---------- Encoder ---------- */
+/* Append in[0..n) stuffed at out[*w], within cap; 0 if it does not fit */
+static inline int hdlc_stuff(const uint8_t *in, size_t n, uint8_t *out, size_t cap, size_t *w)
+{
+    size_t o = *w;
+    while (n)
+    {
+        size_t k = hdlc_find_special(in, n);
+        if (k > cap - o)
+            return 0;
+        memcpy(out + o, in, k);
+        o += k;
+        in += k;
+        n -= k;
+        if (!n)
+            break;
+        if (cap - o < 2)
+            return 0;
+        out[o++] = HDLC_ESC;
+        out[o++] = (uint8_t)(*in++ ^ HDLC_XOR);
+        --n;
+    }
+    *w = o;
+    return 1;
+}
+
+/* flag, stuffed hdr+payload, stuffed FCS over both, flag; returns the length or
+   0 if it does not fit. hdr may be NULL (hlen 0). */
+static inline size_t hdlc_encode_frame(const uint8_t *hdr, size_t hlen, const uint8_t *in, size_t inlen,
+                                       uint8_t *out, size_t outcap)
+{
+    size_t w = 0;
+    if (outcap < 2)
+        return 0;
+    out[w++] = HDLC_FLAG;
+    uint16_t fcs = hdlc_fcs_update(HDLC_FCS_INIT, hdr, hlen);
+    fcs = (uint16_t)~hdlc_fcs_update(fcs, in, inlen);
+    uint8_t fcs_le[2] = {(uint8_t)(fcs & 0xFF), (uint8_t)(fcs >> 8)};
+    if (!hdlc_stuff(hdr, hlen, out, outcap - 1, &w) || !hdlc_stuff(in, inlen, out, outcap - 1, &w) ||
+        !hdlc_stuff(fcs_le, 2, out, outcap - 1, &w))
+        return 0;
+    out[w++] = HDLC_FLAG;
+    return w;
+}
+
+/* ---------- Decoder (streaming) ---------- */
+typedef struct
+{
+    uint8_t *buf; /* unstuffed frame, FCS included */
+    size_t cap;
+    size_t len;
+    int in_frame;
+    int esc;
+    unsigned long overruns; /* frames dropped for not fitting in buf */
+} hdlc_rx_t;
+
+static inline void hdlc_rx_init(hdlc_rx_t *d, uint8_t *buf, size_t cap)
+{
+    memset(d, 0, sizeof(*d));
+    d->buf = buf;
+    d->cap = cap;
+}
+
+/*
+ * Consume bytes from *data (*n of them) until a frame closes. Returns the frame length
+ * (FCS included, always >= 2) with the frame in d->buf, advancing *data and *n just
+ * past its closing flag; or 0 once the input is used up. The frame stays put
+ * until the next call, and the caller may point d->buf somewhere else before
+ * it (same cap or larger).
+ */
+static inline size_t hdlc_rx_next(hdlc_rx_t *d, const uint8_t **data, size_t *n)
+{
+    const uint8_t *p = *data, *end = p + *n;
+    size_t flen = 0;
+    while (p < end)
+    {
+        if (!d->in_frame)
+        {
+            const uint8_t *f = memchr(p, HDLC_FLAG, (size_t)(end - p));
+            if (!f)
+            {
+                p = end;
+                break;
+            }
+            p = f + 1;
+            d->in_frame = 1;
+            d->len = 0;
+            d->esc = 0;
+            continue;
+        }
+        uint8_t b;
+        if (d->esc)
+            b = *p++; /* escaped byte, or a flag that aborts the escape */
+        else
+        {
+            size_t k = hdlc_find_special(p, (size_t)(end - p));
+            if (k > d->cap - d->len)
+            { /* overflow: drop frame, resync on the next flag */
+                d->in_frame = 0;
+                d->overruns++;
+                p += k;
+                continue;
+            }
+            memcpy(d->buf + d->len, p, k);
+            d->len += k;
+            p += k;
+            if (p == end)
+                break;
+            b = *p++;
+            if (b == HDLC_ESC)
+            {
+                d->esc = 1;
+                continue;
+            }
+        }
+        if (b == HDLC_FLAG)
+        {
+            size_t len = d->len;
+            d->len = 0;
+            d->esc = 0;
+            if (len >= 2)
+            {
+                flen = len;
+                break;
+            }
+            continue; /* back-to-back flags */
+        }
+        d->esc = 0;
+        if (d->len < d->cap)
+            d->buf[d->len++] = (uint8_t)(b ^ HDLC_XOR);
+        else
+        {
+            d->in_frame = 0;
+            d->overruns++;
+        }
+    }
+    *n = (size_t)(end - p);
+    *data = p;
+    return flen;
+}
+
+typedef void (*hdlc_frame_cb_t)(const uint8_t *frame, size_t len, int fcs_ok, void *user);
+
+/* Feed bytes; for every closed frame call cb() with it, FCS stripped */
+static inline void hdlc_rx_feed(hdlc_rx_t *d, const uint8_t *data, size_t n, hdlc_frame_cb_t cb, void *user)
+{
+    size_t flen;
+    while ((flen = hdlc_rx_next(d, &data, &n)) != 0)
+        if (cb)
+            cb(d->buf, flen - 2, hdlc_fcs_check(d->buf, flen), user);
+}
+
+#endif /* HDLC_FRAME_H */
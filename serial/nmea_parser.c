@@ -1,12 +1,28 @@
 // nmea_parser.c — NMEA-0183 parser for GGA & RMC with checksum
-// Build: gcc -std=c99 -O2 -Wall nmea_parser.c -o nmea_parser
+// Build: gcc -std=c99 -O2 -Wall -pthread nmea_parser.c -o nmea_parser
 // Run:   ./nmea_parser and ctrl-d      (uses built-in test lines)
 //        cat gps.log | ./nmea_parser   (parses live or recorded GPS data)
+//
+// Bulk ingest: records instead of text, one pass per sentence, no libc
+// number parsing (locale-free fixed point), files mmap'd and split across threads:
+//        ./nmea_parser -c [-t threads] fleet1.log fleet2.log > fixes.csv
+//        ./nmea_parser -b [-t threads] fleet.log > fixes.bin   (nmea_rec_t array)
+//        zcat fleet.log.gz | ./nmea_parser -c -                (chunked stdin)
+//        ./nmea_parser --bench [sentences] [threads]           (sentences/sec)
 
+#define _GNU_SOURCE /* MAP_POPULATE, madvise */
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 static int hex2(const char *p)
 {
@@ -159,8 +175,635 @@ static void process_line(char *line)
     }
 }
 
-int main(void)
+// ---------------------------------------------------------------------------
+// Bulk ingest
+//
+// nmea_scan() walks a sentence once: it XORs the checksum, records where every
+// field starts and stops at the '*', so a sentence costs O(length) however
+// many fields are used. Numbers go through the integer parsers below, which
+// ignore the locale and never round through double. Output is an nmea_rec_t
+// per GGA/RMC sentence, either raw (-b) or as CSV (-c).
+// ---------------------------------------------------------------------------
+
+#define NMEA_MAX_FIELDS 32
+#define NMEA_MAX_LINE 128 // the standard says 82; some receivers run longer
+
+typedef struct
+{
+    const char *f[NMEA_MAX_FIELDS]; // f[0] is the address ("GPGGA")
+    uint8_t len[NMEA_MAX_FIELDS];
+    int n;
+} nmea_tok_t;
+
+enum
+{
+    NMEA_OK = 1,
+    NMEA_BAD_CS = 0,
+    NMEA_MALFORMED = -1
+};
+
+// p at '$', end = end of input. Splits the sentence into t and sets *next to the
+// start of the following line.
+static int nmea_scan(const char *p, const char *end, nmea_tok_t *t, const char **next)
+{
+    const char *s = ++p, *lim = end - p > NMEA_MAX_LINE ? p + NMEA_MAX_LINE : end;
+    unsigned char cs = 0;
+    int n = 0;
+    for (; p < lim; ++p)
+    {
+        unsigned char c = (unsigned char)*p;
+        if (c == ',' || c == '*')
+        {
+            if (n == NMEA_MAX_FIELDS)
+                break;
+            t->f[n] = s;
+            t->len[n++] = (uint8_t)(p - s);
+            s = p + 1;
+            if (c == '*')
+                break;
+        }
+        else if (c == '\n' || c == '\r')
+            break;
+        cs ^= c;
+    }
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    *next = nl ? nl + 1 : end;
+    t->n = n;
+    if (p + 3 > end || *p != '*' || n < 2)
+        return NMEA_MALFORMED;
+    int want = hex2(p + 1);
+    if (want < 0)
+        return NMEA_MALFORMED;
+    return cs == (unsigned)want ? NMEA_OK : NMEA_BAD_CS;
+}
+
+// "[-]123.4567" -> value * 10^digits, extra fraction digits truncated; 0 for an
+// empty field, -1 if it is not a number
+static int nmea_fixed(const char *s, size_t n, int digits, int64_t *out)
+{
+    size_t i = 0;
+    int neg = 0, fd = 0;
+    int64_t v = 0;
+    if (i < n && (s[i] == '-' || s[i] == '+'))
+        neg = s[i++] == '-';
+    size_t d0 = i, seen;
+    while (i < n && s[i] >= '0' && s[i] <= '9' && i - d0 < 10)
+        v = v * 10 + (s[i++] - '0');
+    seen = i - d0;
+    if (i < n && s[i] == '.')
+        for (++i; i < n && s[i] >= '0' && s[i] <= '9'; ++i, ++seen)
+            if (fd < digits)
+            {
+                v = v * 10 + (s[i] - '0');
+                fd++;
+            }
+    if (i != n || (n && !seen))
+        return -1;
+    for (; fd < digits; ++fd)
+        v *= 10;
+    *out = neg ? -v : v;
+    return 0;
+}
+
+// "ddmm.mmmm" / "dddmm.mmmm" -> degrees * 1e7, rounded; hem is 'S'/'W' to negate
+static int nmea_coord_e7(const char *s, size_t n, char hem, int32_t *out)
+{
+    int64_t v; // ddmm * 1e7 + minute fraction * 1e7
+    if (nmea_fixed(s, n, 7, &v) != 0 || v < 0)
+        return -1;
+    int64_t deg = v / 1000000000, min_e7 = v % 1000000000;
+    if (min_e7 >= 600000000 || deg > 180)
+        return -1;
+    int32_t e7 = (int32_t)(deg * 10000000 + (min_e7 + 30) / 60);
+    *out = (hem == 'S' || hem == 's' || hem == 'W' || hem == 'w') ? -e7 : e7;
+    return 0;
+}
+
+// "hhmmss.sss" -> milliseconds since midnight
+static int nmea_time_ms(const char *s, size_t n, uint32_t *out)
+{
+    int64_t v;
+    if (nmea_fixed(s, n, 3, &v) != 0 || v < 0)
+        return -1;
+    int64_t hh = v / 10000000, mm = v / 100000 % 100, ss = v / 1000 % 100;
+    if (hh > 23 || mm > 59 || ss > 60)
+        return -1;
+    *out = (uint32_t)(((hh * 60 + mm) * 60 + ss) * 1000 + v % 1000);
+    return 0;
+}
+
+// One fix; written as-is by -b (host byte order, 36 bytes, no padding inside)
+typedef struct
+{
+    uint32_t time_ms;   // UTC time of day
+    uint32_t date;      // RMC ddmmyy as a number, 0 for GGA
+    int32_t lat_e7;     // degrees * 1e7, south negative
+    int32_t lon_e7;     // degrees * 1e7, west negative
+    int32_t alt_mm;     // GGA altitude above MSL
+    uint32_t sog_mkn;   // RMC speed over ground, 1/1000 knot
+    uint32_t cog_mdeg;  // RMC course over ground, 1/1000 degree
+    uint16_t hdop_c;    // GGA HDOP * 100
+    char type;          // 'G' GGA, 'R' RMC
+    uint8_t fix;        // GGA fix quality; RMC 1 = A(ctive), 0 = V(oid)
+    uint8_t sats;       // GGA satellites in use
+    char talker[2];     // "GP", "GN", ...
+    uint8_t pad;
+} nmea_rec_t;
+
+typedef struct
+{
+    unsigned long lines, sentences, bad_cs, malformed, gga, rmc, other;
+} nmea_stats_t;
+
+#define NMEA_F(t, i) (t)->f[i], (t)->len[i]
+#define NMEA_C(t, i) ((t)->n > (i) && (t)->len[i] ? (t)->f[i][0] : 0)
+
+// fill r from a checksummed sentence: 1 if it is GGA/RMC, 0 other, -1 bad field
+static int nmea_record(const nmea_tok_t *t, nmea_rec_t *r)
+{
+    int64_t v;
+    if (t->len[0] != 5)
+        return 0;
+    memset(r, 0, sizeof(*r));
+    r->talker[0] = t->f[0][0];
+    r->talker[1] = t->f[0][1];
+    if (!memcmp(t->f[0] + 2, "GGA", 3))
+    {
+        if (t->n < 10)
+            return -1;
+        r->type = 'G';
+        if (nmea_time_ms(NMEA_F(t, 1), &r->time_ms) || nmea_coord_e7(NMEA_F(t, 2), NMEA_C(t, 3), &r->lat_e7) ||
+            nmea_coord_e7(NMEA_F(t, 4), NMEA_C(t, 5), &r->lon_e7))
+            return -1;
+        if (nmea_fixed(NMEA_F(t, 6), 0, &v) || v < 0 || v > 255)
+            return -1;
+        r->fix = (uint8_t)v;
+        if (nmea_fixed(NMEA_F(t, 7), 0, &v) || v < 0 || v > 255)
+            return -1;
+        r->sats = (uint8_t)v;
+        if (nmea_fixed(NMEA_F(t, 8), 2, &v) || v < 0 || v > 65535)
+            return -1;
+        r->hdop_c = (uint16_t)v;
+        if (nmea_fixed(NMEA_F(t, 9), 3, &v) || v < INT32_MIN || v > INT32_MAX)
+            return -1;
+        r->alt_mm = (int32_t)v;
+        return 1;
+    }
+    if (!memcmp(t->f[0] + 2, "RMC", 3))
+    {
+        if (t->n < 10)
+            return -1;
+        r->type = 'R';
+        r->fix = NMEA_C(t, 2) == 'A' || NMEA_C(t, 2) == 'a';
+        if (nmea_time_ms(NMEA_F(t, 1), &r->time_ms) || nmea_coord_e7(NMEA_F(t, 3), NMEA_C(t, 4), &r->lat_e7) ||
+            nmea_coord_e7(NMEA_F(t, 5), NMEA_C(t, 6), &r->lon_e7))
+            return -1;
+        if (nmea_fixed(NMEA_F(t, 7), 3, &v) || v < 0 || v > UINT32_MAX)
+            return -1;
+        r->sog_mkn = (uint32_t)v;
+        if (nmea_fixed(NMEA_F(t, 8), 3, &v) || v < 0 || v > 360000)
+            return -1;
+        r->cog_mdeg = (uint32_t)v;
+        if (nmea_fixed(NMEA_F(t, 9), 0, &v) || v < 0 || v > 311299)
+            return -1;
+        r->date = (uint32_t)v;
+        return 1;
+    }
+    return 0;
+}
+
+// ---- Output buffers (CSV without printf) ----
+typedef struct
 {
+    char *p;
+    size_t len, cap;
+} nmea_out_t;
+
+static char *nmea_out_reserve(nmea_out_t *o, size_t n)
+{
+    if (o->len + n > o->cap)
+    {
+        size_t cap = o->cap ? o->cap * 2 : 1 << 20;
+        while (cap < o->len + n)
+            cap *= 2;
+        char *p = realloc(o->p, cap);
+        if (!p)
+            return NULL;
+        o->p = p;
+        o->cap = cap;
+    }
+    return o->p + o->len;
+}
+
+// v / 10^digits with exactly digits decimals, then a separator
+static char *put_fixed(char *w, int64_t v, int digits, char sep)
+{
+    char tmp[24];
+    int n = 0;
+    uint64_t u = v < 0 ? (uint64_t)-v : (uint64_t)v;
+    do
+    {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+        if (n == digits)
+            tmp[n++] = '.';
+    } while (u || n <= digits + (digits > 0));
+    if (v < 0)
+        *w++ = '-';
+    while (n)
+        *w++ = tmp[--n];
+    *w++ = sep;
+    return w;
+}
+
+#define NMEA_CSV_HEADER "type,talker,date,time_ms,lat,lon,fix,sats,hdop,alt_m,sog_kn,cog_deg\n"
+
+static int nmea_emit(nmea_out_t *o, const nmea_rec_t *r, int csv)
+{
+    char *w = nmea_out_reserve(o, csv ? 160 : sizeof(*r));
+    if (!w)
+        return -1;
+    if (!csv)
+    {
+        memcpy(w, r, sizeof(*r));
+        o->len += sizeof(*r);
+        return 0;
+    }
+    char *s = w;
+    *w++ = r->type == 'G' ? 'G' : 'R';
+    *w++ = ',';
+    *w++ = r->talker[0];
+    *w++ = r->talker[1];
+    *w++ = ',';
+    w = put_fixed(w, r->date, 0, ',');
+    w = put_fixed(w, r->time_ms, 0, ',');
+    w = put_fixed(w, r->lat_e7, 7, ',');
+    w = put_fixed(w, r->lon_e7, 7, ',');
+    w = put_fixed(w, r->fix, 0, ',');
+    w = put_fixed(w, r->sats, 0, ',');
+    w = put_fixed(w, r->hdop_c, 2, ',');
+    w = put_fixed(w, r->alt_mm, 3, ',');
+    w = put_fixed(w, r->sog_mkn, 3, ',');
+    w = put_fixed(w, r->cog_mdeg, 3, '\n');
+    o->len += (size_t)(w - s);
+    return 0;
+}
+
+// Parse every line in [p, end), appending records to o
+static int nmea_ingest(const char *p, const char *end, int csv, nmea_out_t *o, nmea_stats_t *st)
+{
+    nmea_tok_t t;
+    nmea_rec_t r;
+    while (p < end)
+    {
+        st->lines++;
+        if (*p != '$')
+        {
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            p = nl ? nl + 1 : end;
+            continue;
+        }
+        st->sentences++;
+        int rc = nmea_scan(p, end, &t, &p);
+        if (rc != NMEA_OK)
+        {
+            if (rc == NMEA_BAD_CS)
+                st->bad_cs++;
+            else
+                st->malformed++;
+            continue;
+        }
+        rc = nmea_record(&t, &r);
+        if (rc < 0)
+            st->malformed++;
+        else if (rc == 0)
+            st->other++;
+        else
+        {
+            if (r.type == 'G')
+                st->gga++;
+            else
+                st->rmc++;
+            if (nmea_emit(o, &r, csv) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+// ---- Threads: a window of the mapping split at line boundaries ----
+#define NMEA_SLICE (16u << 20) // input bytes per thread per window
+
+typedef struct
+{
+    pthread_t th;
+    const char *p, *end;
+    int csv, rc;
+    nmea_out_t out;
+    nmea_stats_t st;
+} nmea_job_t;
+
+static void *nmea_job_main(void *arg)
+{
+    nmea_job_t *j = arg;
+    j->rc = nmea_ingest(j->p, j->end, j->csv, &j->out, &j->st);
+    return NULL;
+}
+
+static void nmea_stats_add(nmea_stats_t *a, const nmea_stats_t *b)
+{
+    a->lines += b->lines;
+    a->sentences += b->sentences;
+    a->bad_cs += b->bad_cs;
+    a->malformed += b->malformed;
+    a->gga += b->gga;
+    a->rmc += b->rmc;
+    a->other += b->other;
+}
+
+static int write_all(int fd, const char *p, size_t n)
+{
+    while (n)
+    {
+        ssize_t w = write(fd, p, n);
+        if (w < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("write");
+            return -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+// Parse [p, end) on nthreads threads, writing the output in input order to fd
+// (-1: discard). Returns 0, or -1 on error.
+static int nmea_run(const char *p, const char *end, int nthreads, int csv, int fd, nmea_stats_t *st)
+{
+    nmea_job_t *jobs = calloc((size_t)nthreads, sizeof(*jobs));
+    if (!jobs)
+        return -1;
+    int rc = 0;
+    while (p < end && rc == 0)
+    {
+        int nj = 0;
+        for (; nj < nthreads && p < end; ++nj)
+        {
+            nmea_job_t *j = &jobs[nj];
+            const char *e = (size_t)(end - p) > NMEA_SLICE ? p + NMEA_SLICE : end;
+            if (e < end)
+            {
+                const char *nl = memchr(e, '\n', (size_t)(end - e));
+                e = nl ? nl + 1 : end;
+            }
+            j->p = p;
+            j->end = e;
+            j->csv = csv;
+            j->out.len = 0;
+            memset(&j->st, 0, sizeof(j->st));
+            p = e;
+        }
+        if (nj == 1)
+            nmea_job_main(&jobs[0]);
+        else
+            for (int i = 0; i < nj; ++i)
+                if (pthread_create(&jobs[i].th, NULL, nmea_job_main, &jobs[i]) != 0)
+                {
+                    perror("pthread_create");
+                    nmea_job_main(&jobs[i]); // run it here instead
+                    jobs[i].th = 0;
+                }
+        for (int i = 0; i < nj; ++i)
+        {
+            nmea_job_t *j = &jobs[i];
+            if (nj > 1 && j->th)
+                pthread_join(j->th, NULL);
+            if (j->rc != 0)
+            {
+                fprintf(stderr, "out of memory for records\n");
+                rc = -1;
+            }
+            nmea_stats_add(st, &j->st);
+            if (rc == 0 && fd >= 0 && write_all(fd, j->out.p, j->out.len) != 0)
+                rc = -1;
+        }
+    }
+    for (int i = 0; i < nthreads; ++i)
+        free(jobs[i].out.p);
+    free(jobs);
+    return rc;
+}
+
+static int nmea_ingest_file(const char *path, int nthreads, int csv, nmea_stats_t *st)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror(path);
+        return -1;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) < 0)
+    {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    if (sb.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+    const char *map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap");
+        return -1;
+    }
+    madvise((void *)map, (size_t)sb.st_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+    int rc = nmea_run(map, map + sb.st_size, nthreads, csv, STDOUT_FILENO, st);
+    munmap((void *)map, (size_t)sb.st_size);
+    return rc;
+}
+
+// Pipes: read big chunks, parse the whole lines, carry the tail over
+static int nmea_ingest_stdin(int csv, nmea_stats_t *st)
+{
+    enum
+    {
+        CHUNK = 4 << 20
+    };
+    char *buf = malloc(CHUNK);
+    if (!buf)
+        return -1;
+    size_t have = 0;
+    int rc = 0;
+    for (;;)
+    {
+        ssize_t r = read(STDIN_FILENO, buf + have, CHUNK - have);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+        {
+            perror("read");
+            rc = -1;
+            break;
+        }
+        have += (size_t)r;
+        const char *nl = r ? memrchr(buf, '\n', have) : NULL;
+        size_t use = r == 0 ? have : nl ? (size_t)(nl + 1 - buf) : have == CHUNK ? have : 0;
+        if (use && nmea_run(buf, buf + use, 1, csv, STDOUT_FILENO, st) != 0)
+        {
+            rc = -1;
+            break;
+        }
+        memmove(buf, buf + use, have - use);
+        have -= use;
+        if (r == 0)
+            break;
+    }
+    free(buf);
+    return rc;
+}
+
+static double nmea_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void nmea_print_stats(const nmea_stats_t *st, double dt)
+{
+    fprintf(stderr,
+            "%lu lines, %lu sentences (%lu GGA, %lu RMC, %lu other), %lu bad checksum, %lu malformed; "
+            "%.2f s, %.2f M sentences/s\n",
+            st->lines, st->sentences, st->gga, st->rmc, st->other, st->bad_cs, st->malformed, dt,
+            dt > 0 ? st->sentences / dt / 1e6 : 0.0);
+}
+
+// --bench: a synthetic log, parsed by process_line() (stdout to /dev/null) and
+// by the bulk path with 1 and N threads
+static int nmea_bench(unsigned long count, int nthreads)
+{
+    char *log = malloc(count * 100 + 1);
+    if (!log)
+    {
+        perror("malloc");
+        return 1;
+    }
+    size_t len = 0;
+    srand(1);
+    for (unsigned long i = 0; i < count; ++i)
+    {
+        char body[96];
+        unsigned s = (unsigned)(i % 86400);
+        int lat = rand() % 90 * 100 + rand() % 60, lon = rand() % 180 * 100 + rand() % 60; // ddmm, dddmm
+        int n = i & 1 ? snprintf(body, sizeof(body), "GNRMC,%02u%02u%02u.%03u,A,%04d.%05d,N,%05d.%05d,W,%d.%03d,%d.%02d,%06d,,,A",
+                                 s / 3600, s / 60 % 60, s % 60, (unsigned)(i % 1000), lat, rand() % 100000, lon,
+                                 rand() % 100000, rand() % 60, rand() % 1000, rand() % 360, rand() % 100, 10126)
+                      : snprintf(body, sizeof(body), "GPGGA,%02u%02u%02u.%03u,%04d.%05d,S,%05d.%05d,E,1,%02d,%d.%d,%d.%d,M,46.9,M,,",
+                                 s / 3600, s / 60 % 60, s % 60, (unsigned)(i % 1000), lat, rand() % 100000, lon,
+                                 rand() % 100000, rand() % 13, rand() % 5, rand() % 10, rand() % 3000, rand() % 10);
+        unsigned char cs = 0;
+        for (int k = 0; k < n; ++k)
+            cs ^= (unsigned char)body[k];
+        len += (size_t)sprintf(log + len, "$%s*%02X\r\n", body, cs);
+    }
+    fprintf(stderr, "%lu sentences, %.1f MB\n", count, len / 1e6);
+
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO), devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    double t0 = nmea_now();
+    char line[512];
+    for (const char *p = log, *end = log + len; p < end;)
+    {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t n = (size_t)(nl - p + 1);
+        memcpy(line, p, n);
+        line[n] = 0;
+        process_line(line);
+        p = nl + 1;
+    }
+    fflush(stdout);
+    double legacy = nmea_now() - t0;
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(devnull);
+    fprintf(stderr, "%-22s %8.2f M sentences/s\n", "process_line+printf", count / legacy / 1e6);
+
+    for (int csv = 1; csv >= 0; --csv)
+        for (int th = 1; th <= nthreads; th = th == nthreads ? th + 1 : nthreads)
+        {
+            nmea_stats_t st = {0};
+            t0 = nmea_now();
+            if (nmea_run(log, log + len, th, csv, -1, &st) != 0)
+                return 1;
+            double dt = nmea_now() - t0;
+            if (st.gga + st.rmc != count)
+            {
+                fprintf(stderr, "bench: parsed %lu of %lu sentences\n", st.gga + st.rmc, count);
+                return 1;
+            }
+            char name[32];
+            snprintf(name, sizeof(name), "bulk %s, %d thread%s", csv ? "CSV" : "binary", th, th > 1 ? "s" : "");
+            fprintf(stderr, "%-22s %8.2f M sentences/s  %6.0f MB/s\n", name, count / dt / 1e6, len / dt / 1e6);
+        }
+    free(log);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s                           parse stdin (or built-in lines), print fixes\n"
+            "       %s -c|-b [-t threads] file...  records as CSV / binary nmea_rec_t to stdout\n"
+            "       %s -c|-b -                    the same from stdin\n"
+            "       %s --bench [sentences] [threads]\n",
+            prog, prog, prog, prog);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && !strcmp(argv[1], "--bench"))
+    {
+        unsigned long count = argc > 2 ? strtoul(argv[2], NULL, 0) : 2000000;
+        int nthreads = argc > 3 ? atoi(argv[3]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        return nmea_bench(count ? count : 1, nthreads > 0 ? nthreads : 1);
+    }
+    if (argc > 1)
+    {
+        int csv = -1, nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN), i = 1;
+        for (; i < argc && argv[i][0] == '-' && argv[i][1]; ++i)
+        {
+            if (!strcmp(argv[i], "-c") || !strcmp(argv[i], "-b"))
+                csv = argv[i][1] == 'c';
+            else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+                nthreads = atoi(argv[++i]);
+            else
+                break;
+        }
+        if (csv < 0 || i == argc || nthreads < 1)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        nmea_stats_t st = {0};
+        double t0 = nmea_now();
+        if (csv && write_all(STDOUT_FILENO, NMEA_CSV_HEADER, sizeof(NMEA_CSV_HEADER) - 1) != 0)
+            return 1;
+        int rc = 0;
+        for (; i < argc && rc == 0; ++i)
+            rc = !strcmp(argv[i], "-") ? nmea_ingest_stdin(csv, &st) : nmea_ingest_file(argv[i], nthreads, csv, &st);
+        nmea_print_stats(&st, nmea_now() - t0);
+        return rc ? 1 : 0;
+    }
+
     static const char *test_lines[] = {
         "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47",
         "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,,*6A",
@@ -7,55 +7,46 @@
  * - FCS: CRC-16/PPP (poly 0x8408, init 0xFFFF, final ones' complement), sent little-endian.
  * - Byte-stuffing: 0x7E and 0x7D are escaped as 0x7D, (byte ^ 0x20).
  *   (PPP can escape more bytes via ACCM; we keep it minimal for clarity.)
+ * - Framing, FCS and stuffing come from hdlc_frame.h, shared with hdlc_demo.c.
  *
  * Build: gcc -std=c99 -O2 -Wall ppp_demo.c -o ppp_demo
  * Run:   ./ppp_demo
  *        echo "DE AD BE EF" | ./ppp_demo --proto 0x8021
  * Or
  * ./ppp_demo and then ctrl-d
+ *
+ * Many links at once (Linux): one epoll thread, a decoder per link, frames in
+ * refcounted pool buffers delivered per protocol in batches.
+ *        ./ppp_demo --mux /dev/ttyUSB0 /dev/ttyUSB1 ...   (ports already set up)
+ *        ./ppp_demo --mux-bench [links] [rounds]          (pty pairs, no hardware)
  */
 
+#define _GNU_SOURCE /* posix_openpt, cfmakeraw */
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <stddef.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "hdlc_frame.h"
 
 /* ---- PPP constants ---- */
-#define PPP_FLAG 0x7E
-#define PPP_ESC 0x7D
-#define PPP_XOR 0x20
+#define PPP_FLAG HDLC_FLAG
 #define PPP_ADDR 0xFF
 #define PPP_CTRL 0x03
 
-/* ---- CRC-16/PPP ---- */
-static uint16_t crc16_ppp_update(uint16_t fcs, uint8_t b)
-{
-    fcs ^= b;
-    for (int i = 0; i < 8; ++i)
-    {
-        fcs = (fcs & 1) ? (fcs >> 1) ^ 0x8408 : (fcs >> 1);
-    }
-    return fcs;
-}
-static uint16_t crc16_ppp(const uint8_t *data, size_t len)
-{
-    uint16_t fcs = 0xFFFF;
-    for (size_t i = 0; i < len; ++i)
-        fcs = crc16_ppp_update(fcs, data[i]);
-    return (uint16_t)~fcs; /* ones' complement */
-}
-/* PPP "good residue" when CRC run over (header+info+FCS) */
-static int ppp_crc_verify(const uint8_t *hdr_info, size_t len, const uint8_t fcs_le[2])
-{
-    uint16_t fcs = 0xFFFF;
-    for (size_t i = 0; i < len; ++i)
-        fcs = crc16_ppp_update(fcs, hdr_info[i]);
-    fcs = crc16_ppp_update(fcs, fcs_le[0]);
-    fcs = crc16_ppp_update(fcs, fcs_le[1]);
-    return (fcs == 0xF0B8);
-}
-
 /* ---- Utils ---- */
 static void hexdump(const char *tag, const uint8_t *b, size_t n)
 {
@@ -89,174 +80,357 @@ static size_t read_hex_line(uint8_t *out, size_t cap)
     }
     return w;
 }
-static int should_escape(uint8_t b)
-{
-    return (b == PPP_FLAG || b == PPP_ESC);
-}
-
 /* ---- Encoder: payload -> PPP frame bytes (stuffed) ---- */
 static size_t ppp_encode(uint16_t protocol, const uint8_t *payload, size_t plen,
                          uint8_t *out, size_t outcap)
 {
-    size_t w = 0;
-    if (outcap < 1)
-        return 0;
-    out[w++] = PPP_FLAG;
-
-    /* Build header+info for FCS calc (no flags, no escapes yet) */
-    uint8_t hdr[2 + 2]; /* [FF 03] + Protocol */
+    /* [FF 03] + Protocol; FCS over header+payload, everything stuffed */
+    uint8_t hdr[2 + 2];
     hdr[0] = PPP_ADDR;
     hdr[1] = PPP_CTRL;
     hdr[2] = (uint8_t)((protocol >> 8) & 0xFF);
     hdr[3] = (uint8_t)(protocol & 0xFF);
-
-    /* Compute FCS on header+payload */
-    uint16_t fcs = 0xFFFF;
-    for (size_t i = 0; i < sizeof(hdr); ++i)
-        fcs = crc16_ppp_update(fcs, hdr[i]);
-    for (size_t i = 0; i < plen; ++i)
-        fcs = crc16_ppp_update(fcs, payload[i]);
-    fcs = (uint16_t)~fcs;
-    uint8_t fcs_lo = (uint8_t)(fcs & 0xFF), fcs_hi = (uint8_t)(fcs >> 8);
-
-    /* Write header with stuffing */
-    for (size_t i = 0; i < sizeof(hdr); ++i)
-    {
-        uint8_t b = hdr[i];
-        if (should_escape(b))
-        {
-            if (w + 2 > outcap)
-                return 0;
-            out[w++] = PPP_ESC;
-            out[w++] = (uint8_t)(b ^ PPP_XOR);
-        }
-        else
-        {
-            if (w + 1 > outcap)
-                return 0;
-            out[w++] = b;
-        }
-    }
-    /* Write payload with stuffing */
-    for (size_t i = 0; i < plen; ++i)
-    {
-        uint8_t b = payload[i];
-        if (should_escape(b))
-        {
-            if (w + 2 > outcap)
-                return 0;
-            out[w++] = PPP_ESC;
-            out[w++] = (uint8_t)(b ^ PPP_XOR);
-        }
-        else
-        {
-            if (w + 1 > outcap)
-                return 0;
-            out[w++] = b;
-        }
-    }
-    /* Write FCS (LE) with stuffing */
-    uint8_t fcs_bytes[2] = {fcs_lo, fcs_hi};
-    for (int i = 0; i < 2; ++i)
-    {
-        uint8_t b = fcs_bytes[i];
-        if (should_escape(b))
-        {
-            if (w + 2 > outcap)
-                return 0;
-            out[w++] = PPP_ESC;
-            out[w++] = (uint8_t)(b ^ PPP_XOR);
-        }
-        else
-        {
-            if (w + 1 > outcap)
-                return 0;
-            out[w++] = b;
-        }
-    }
-
-    if (w + 1 > outcap)
-        return 0;
-    out[w++] = PPP_FLAG;
-    return w;
+    return hdlc_encode_frame(hdr, sizeof(hdr), payload, plen, out, outcap);
 }
 
 /* ---- Decoder (streaming) ---- */
 typedef struct
 {
     uint8_t buf[4096];
-    size_t len;
-    int in_frame;
-    int esc;
+    hdlc_rx_t rx;
 } ppp_dec_t;
 
-static void ppp_dec_init(ppp_dec_t *d) { memset(d, 0, sizeof(*d)); }
+static void ppp_dec_init(ppp_dec_t *d) { hdlc_rx_init(&d->rx, d->buf, sizeof(d->buf)); }
 
 typedef void (*ppp_frame_cb)(uint16_t proto, const uint8_t *payload, size_t plen, int fcs_ok, void *user);
 
 /* Feed stuffed bytes; on full frame, callback with parsed Protocol + payload */
 static void ppp_decode_feed(ppp_dec_t *d, const uint8_t *data, size_t n, ppp_frame_cb cb, void *user)
 {
-    for (size_t i = 0; i < n; ++i)
+    size_t L;
+    while ((L = hdlc_rx_next(&d->rx, &data, &n)) != 0)
+    {
+        /* We have: [FF 03] [Proto_hi Proto_lo] [payload...] [FCS lo hi] */
+        uint8_t *f = d->buf;
+        if (L < 2 + 2 + 2 || f[0] != PPP_ADDR || f[1] != PPP_CTRL)
+            continue;
+        uint16_t proto = (uint16_t)(f[2] << 8 | f[3]);
+        size_t info_len = L - 4 - 2; /* minus header 4 and FCS 2 */
+        int ok = hdlc_fcs_check(f, L);
+        if (cb)
+            cb(proto, &f[4], info_len, ok, user);
+    }
+}
+
+/* ---- Multi-channel demultiplexer (Linux) ----
+ * One thread, one epoll set, many links. Each channel runs its own hdlc_rx_t
+ * straight into a buffer from a preallocated pool; when a frame closes, that
+ * buffer is handed on as-is and the channel continues in a fresh one, so a frame
+ * is never copied after unstuffing. Frames are queued by protocol and handed to
+ * the protocol's handler in batches once each epoll round has read every ready
+ * link. Buffers are refcounted: a handler that keeps a frame takes a reference
+ * (ppp_buf_ref) and drops it later (ppp_buf_put).
+ */
+#ifdef __linux__
+#define PPP_FRAME_MAX 4096 /* unstuffed frame with header and FCS, as ppp_dec_t */
+#define PPP_MUX_PROTOS 16
+#define PPP_MUX_BATCH 64
+
+typedef struct ppp_buf
+{
+    struct ppp_buf *next; /* free list / protocol queue */
+    unsigned refs;
+    uint16_t chan;
+    uint16_t proto;
+    uint16_t off; /* information field offset: 4, less with ACFC/PFC */
+    uint16_t len; /* information field length */
+    uint8_t frame[PPP_FRAME_MAX];
+} ppp_buf_t;
+
+#define ppp_buf_info(b) ((b)->frame + (b)->off)
+
+typedef struct
+{
+    ppp_buf_t *bufs;
+    ppp_buf_t *free;
+    size_t count, avail;
+} ppp_pool_t;
+
+static int ppp_pool_init(ppp_pool_t *p, size_t count)
+{
+    memset(p, 0, sizeof(*p));
+    p->bufs = calloc(count, sizeof(*p->bufs));
+    if (!p->bufs)
+        return -1;
+    for (size_t i = count; i-- > 0;)
     {
-        uint8_t b = data[i];
+        p->bufs[i].next = p->free;
+        p->free = &p->bufs[i];
+    }
+    p->count = p->avail = count;
+    return 0;
+}
+
+/* A buffer with one reference, or NULL when the pool is empty */
+static ppp_buf_t *ppp_buf_get(ppp_pool_t *p)
+{
+    ppp_buf_t *b = p->free;
+    if (!b)
+        return NULL;
+    p->free = b->next;
+    p->avail--;
+    b->next = NULL;
+    b->refs = 1;
+    return b;
+}
+
+static void ppp_buf_ref(ppp_buf_t *b) { b->refs++; }
+
+static void ppp_buf_put(ppp_pool_t *p, ppp_buf_t *b)
+{
+    if (--b->refs)
+        return;
+    b->next = p->free;
+    p->free = b;
+    p->avail++;
+}
+
+/* Called with up to PPP_MUX_BATCH frames of one protocol, oldest first */
+typedef void (*ppp_batch_cb)(uint16_t proto, ppp_buf_t *const *frames, size_t n, void *user);
+
+typedef struct
+{
+    uint16_t proto; /* unused for q[0], which takes every unregistered protocol */
+    ppp_batch_cb cb;
+    void *user;
+    ppp_buf_t *head, *tail;
+    unsigned long frames, batches;
+} ppp_queue_t;
+
+typedef struct
+{
+    int fd;
+    uint16_t id;
+    hdlc_rx_t rx;
+    ppp_buf_t *cur; /* the buffer rx decodes into */
+    unsigned long frames, bytes, bad_fcs, bad_hdr, no_buf;
+} ppp_chan_t;
+
+typedef struct
+{
+    int ep;
+    ppp_pool_t pool;
+    ppp_chan_t *chans;
+    size_t nchan, maxchan, live;
+    ppp_queue_t q[1 + PPP_MUX_PROTOS];
+    size_t nq;
+    uint8_t rbuf[65536]; /* read() lands here, then is unstuffed into pool buffers */
+} ppp_mux_t;
 
-        if (b == PPP_FLAG)
+static int ppp_mux_init(ppp_mux_t *m, size_t maxchan, size_t bufs, ppp_batch_cb other, void *user)
+{
+    memset(m, 0, offsetof(ppp_mux_t, rbuf));
+    m->ep = epoll_create1(EPOLL_CLOEXEC);
+    if (m->ep < 0)
+    {
+        perror("epoll_create1");
+        return -1;
+    }
+    m->chans = calloc(maxchan, sizeof(*m->chans));
+    if (!m->chans || bufs < maxchan + 1 || ppp_pool_init(&m->pool, bufs) != 0)
+    {
+        fprintf(stderr, "ppp_mux_init: out of memory or pool smaller than the channel count\n");
+        free(m->chans);
+        close(m->ep);
+        return -1;
+    }
+    m->maxchan = maxchan;
+    m->q[0].cb = other;
+    m->q[0].user = user;
+    m->nq = 1;
+    return 0;
+}
+
+static int ppp_mux_register(ppp_mux_t *m, uint16_t proto, ppp_batch_cb cb, void *user)
+{
+    if (m->nq >= 1 + PPP_MUX_PROTOS)
+        return -1;
+    ppp_queue_t *q = &m->q[m->nq++];
+    q->proto = proto;
+    q->cb = cb;
+    q->user = user;
+    return 0;
+}
+
+/* Start reading fd as the next channel; the mux owns fd from here on */
+static int ppp_mux_add_fd(ppp_mux_t *m, int fd)
+{
+    if (m->nchan >= m->maxchan)
+    {
+        fprintf(stderr, "ppp_mux_add_fd: all %zu channels in use\n", m->maxchan);
+        return -1;
+    }
+    ppp_chan_t *c = &m->chans[m->nchan];
+    memset(c, 0, sizeof(*c));
+    c->fd = fd;
+    c->id = (uint16_t)m->nchan;
+    c->cur = ppp_buf_get(&m->pool);
+    hdlc_rx_init(&c->rx, c->cur->frame, sizeof(c->cur->frame));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+    if (epoll_ctl(m->ep, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        perror("epoll_ctl(ADD)");
+        ppp_buf_put(&m->pool, c->cur);
+        return -1;
+    }
+    m->nchan++;
+    m->live++;
+    return 0;
+}
+
+static void ppp_chan_close(ppp_mux_t *m, ppp_chan_t *c)
+{
+    epoll_ctl(m->ep, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    ppp_buf_put(&m->pool, c->cur);
+    c->cur = NULL;
+    m->live--;
+}
+
+/* Hand every queued frame to its handler, PPP_MUX_BATCH at a time */
+static void ppp_mux_flush(ppp_mux_t *m)
+{
+    ppp_buf_t *batch[PPP_MUX_BATCH];
+    for (size_t i = 0; i < m->nq; ++i)
+    {
+        ppp_queue_t *q = &m->q[i];
+        while (q->head)
         {
-            if (d->in_frame && d->len >= (2 + 2 + 2))
+            size_t n = 0;
+            while (q->head && n < PPP_MUX_BATCH)
             {
-                /* We have: [FF 03] [Proto_hi Proto_lo] [payload...] [FCS lo hi] */
-                size_t L = d->len;
-                uint8_t *f = d->buf;
-
-                /* Basic checks */
-                if (f[0] == PPP_ADDR && f[1] == PPP_CTRL)
-                {
-                    if (L >= 6)
-                    {
-                        uint16_t proto = (uint16_t)(f[2] << 8 | f[3]);
-                        size_t info_len = L - 4 - 2; /* minus header 4 and FCS 2 */
-                        uint8_t *info = &f[4];
-                        uint8_t fcs_le[2] = {f[4 + info_len], f[5 + info_len]};
-
-                        int ok = ppp_crc_verify(f, 4 + info_len, fcs_le);
-                        if (cb)
-                            cb(proto, info, info_len, ok, user);
-                    }
-                }
+                batch[n++] = q->head;
+                q->head = q->head->next;
+            }
+            if (!q->head)
+                q->tail = NULL;
+            q->frames += n;
+            q->batches++;
+            if (q->cb)
+                q->cb(i ? q->proto : 0, batch, n, q->user);
+            for (size_t k = 0; k < n; ++k)
+            {
+                batch[k]->next = NULL;
+                ppp_buf_put(&m->pool, batch[k]);
             }
-            /* Reset/start */
-            d->in_frame = 1;
-            d->len = 0;
-            d->esc = 0;
-            continue;
         }
+    }
+}
 
-        if (!d->in_frame)
-            continue;
+/* A frame of L bytes closed in c->cur: check it and queue it by protocol */
+static void ppp_chan_frame(ppp_mux_t *m, ppp_chan_t *c, size_t L)
+{
+    const uint8_t *f = c->cur->frame;
+    if (!hdlc_fcs_check(f, L))
+    {
+        c->bad_fcs++; /* RFC 1662: silently discard */
+        return;
+    }
+    size_t off = 0, end = L - 2;
+    if (end >= 2 && f[0] == PPP_ADDR && f[1] == PPP_CTRL)
+        off = 2; /* else Address-and-Control-Field-Compression */
+    uint16_t proto;
+    if (off < end && (f[off] & 1))
+        proto = f[off++]; /* Protocol-Field-Compression */
+    else if (off + 2 <= end && (f[off + 1] & 1))
+    {
+        proto = (uint16_t)(f[off] << 8 | f[off + 1]);
+        off += 2;
+    }
+    else
+    {
+        c->bad_hdr++;
+        return;
+    }
+    ppp_buf_t *nb = ppp_buf_get(&m->pool);
+    if (!nb)
+    {
+        ppp_mux_flush(m); /* the queues hold the pool: deliver early rather than drop */
+        nb = ppp_buf_get(&m->pool);
+    }
+    if (!nb)
+    {
+        c->no_buf++; /* handlers hold every buffer: drop, keep decoding into cur */
+        return;
+    }
+    ppp_buf_t *b = c->cur;
+    c->cur = nb;
+    c->rx.buf = nb->frame;
+    b->chan = c->id;
+    b->proto = proto;
+    b->off = (uint16_t)off;
+    b->len = (uint16_t)(end - off);
+    c->frames++;
 
-        if (d->esc)
-        {
-            b ^= PPP_XOR;
-            d->esc = 0;
-        }
-        else if (b == PPP_ESC)
+    ppp_queue_t *q = &m->q[0];
+    for (size_t i = 1; i < m->nq; ++i)
+        if (m->q[i].proto == proto)
         {
-            d->esc = 1;
-            continue;
+            q = &m->q[i];
+            break;
         }
+    if (q->tail)
+        q->tail->next = b;
+    else
+        q->head = b;
+    q->tail = b;
+}
 
-        if (d->len < sizeof(d->buf))
-            d->buf[d->len++] = b;
-        else
+/* One epoll round: read every ready link, then deliver. Returns the number of
+   ready links, 0 on timeout, -1 on error. */
+static int ppp_mux_poll(ppp_mux_t *m, int timeout_ms)
+{
+    struct epoll_event ev[64];
+    int n = epoll_wait(m->ep, ev, 64, timeout_ms);
+    if (n < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+        perror("epoll_wait");
+        return -1;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        ppp_chan_t *c = ev[i].data.ptr;
+        ssize_t r = read(c->fd, m->rbuf, sizeof(m->rbuf));
+        if (r > 0)
         {
-            d->in_frame = 0;
-            d->len = 0;
-            d->esc = 0;
-        } /* overflow: drop */
+            const uint8_t *p = m->rbuf;
+            size_t left = (size_t)r, L;
+            c->bytes += (size_t)r;
+            while ((L = hdlc_rx_next(&c->rx, &p, &left)) != 0)
+                ppp_chan_frame(m, c, L);
+        }
+        else if (r == 0 || (errno != EAGAIN && errno != EINTR))
+            ppp_chan_close(m, c); /* EOF, or EIO from a pty whose other side closed */
     }
+    ppp_mux_flush(m);
+    return n;
 }
 
+static void ppp_mux_free(ppp_mux_t *m)
+{
+    for (size_t i = 0; i < m->nchan; ++i)
+        if (m->chans[i].fd >= 0)
+            ppp_chan_close(m, &m->chans[i]);
+    close(m->ep);
+    free(m->chans);
+    free(m->pool.bufs);
+}
+#endif /* __linux__ */
+
 /* ---- Demo ---- */
 static void on_ppp_frame(uint16_t proto, const uint8_t *payload, size_t plen, int fcs_ok, void *user)
 {
@@ -271,8 +445,260 @@ static uint8_t demo_ipv4[] = {
     0x45, 0x00, 0x00, 0x18, 0x12, 0x34, 0x00, 0x00, 0x40, 0x11, 0x00, 0x00,
     0x0A, 0x00, 0x00, 0x01, 0x0A, 0x00, 0x00, 0x02, 0xDE, 0xAD, 0xBE, 0xEF};
 
+#ifdef __linux__
+/* ---- Multi-channel demo: --mux tty... / --mux-bench ---- */
+static volatile sig_atomic_t g_stop = 0;
+static void on_sigint(int signo)
+{
+    (void)signo;
+    g_stop = 1;
+}
+
+static double mux_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct
+{
+    ppp_pool_t *pool;
+    ppp_buf_t *last; /* held across batches: the newest frame seen */
+    unsigned long bytes;
+} mux_sink_t;
+
+static void on_mux_batch(uint16_t proto, ppp_buf_t *const *frames, size_t n, void *user)
+{
+    mux_sink_t *s = user;
+    (void)proto;
+    for (size_t i = 0; i < n; ++i)
+        s->bytes += frames[i]->len;
+    ppp_buf_ref(frames[n - 1]);
+    if (s->last)
+        ppp_buf_put(s->pool, s->last);
+    s->last = frames[n - 1];
+}
+
+static const char *mux_proto_name(uint16_t proto)
+{
+    switch (proto)
+    {
+    case 0x0021: return "IPv4";
+    case 0x0057: return "IPv6";
+    case 0xC021: return "LCP";
+    case 0x8021: return "IPCP";
+    default: return "other";
+    }
+}
+
+static void mux_report(ppp_mux_t *m, mux_sink_t *sinks, double dt, int final)
+{
+    unsigned long frames = 0, bytes = 0, bad_fcs = 0, bad_hdr = 0, no_buf = 0, overruns = 0;
+    for (size_t i = 0; i < m->nchan; ++i)
+    {
+        ppp_chan_t *c = &m->chans[i];
+        frames += c->frames;
+        bytes += c->bytes;
+        bad_fcs += c->bad_fcs;
+        bad_hdr += c->bad_hdr;
+        no_buf += c->no_buf;
+        overruns += c->rx.overruns;
+    }
+    printf("%s %zu/%zu links  %lu frames (%.0f/s)  %.2f MB/s on the wire  pool %zu/%zu free  "
+           "drops: fcs %lu hdr %lu nobuf %lu overrun %lu\n",
+           final ? "[total]" : "[stats]", m->live, m->nchan, frames, frames / dt, bytes / dt / 1e6, m->pool.avail,
+           m->pool.count, bad_fcs, bad_hdr, no_buf, overruns);
+    if (!final)
+        return;
+    for (size_t i = 0; i < m->nq; ++i)
+    {
+        ppp_queue_t *q = &m->q[i];
+        ppp_buf_t *b = sinks[i].last;
+        printf("  %-5s %8lu frames in %6lu batches (avg %.1f), %lu info bytes", i ? mux_proto_name(q->proto) : "other",
+               q->frames, q->batches, q->batches ? (double)q->frames / q->batches : 0.0, sinks[i].bytes);
+        if (b)
+            printf(", last: chan %u proto 0x%04X len %u", b->chan, b->proto, b->len);
+        puts("");
+    }
+}
+
+static int mux_setup(ppp_mux_t *m, size_t nchan, mux_sink_t *sinks)
+{
+    static const uint16_t protos[] = {0x0021, 0x0057, 0xC021, 0x8021};
+    if (ppp_mux_init(m, nchan, 2 * nchan + 4 * PPP_MUX_BATCH, on_mux_batch, &sinks[0]) != 0)
+        return -1;
+    sinks[0].pool = &m->pool;
+    for (size_t i = 0; i < sizeof(protos) / sizeof(protos[0]); ++i)
+    {
+        sinks[i + 1].pool = &m->pool;
+        ppp_mux_register(m, protos[i], on_mux_batch, &sinks[i + 1]);
+    }
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigint; /* no SA_RESTART: epoll_wait returns */
+    sigaction(SIGINT, &sa, NULL);
+    return 0;
+}
+
+static void mux_loop(ppp_mux_t *m, mux_sink_t *sinks)
+{
+    double t0 = mux_now(), last = t0;
+    while (!g_stop && m->live && ppp_mux_poll(m, 200) >= 0)
+    {
+        double t = mux_now();
+        if (t - last >= 1.0)
+        {
+            mux_report(m, sinks, t - t0, 0);
+            last = t;
+        }
+    }
+    mux_report(m, sinks, mux_now() - t0, 1);
+    for (size_t i = 0; i < m->nq; ++i)
+        if (sinks[i].last)
+            ppp_buf_put(&m->pool, sinks[i].last);
+}
+
+static int set_raw(int fd)
+{
+    struct termios tio;
+    if (!isatty(fd))
+        return 0;
+    if (tcgetattr(fd, &tio) < 0)
+        return -1;
+    cfmakeraw(&tio);
+    return tcsetattr(fd, TCSANOW, &tio);
+}
+
+/* --mux dev...: demultiplex already-configured serial ports until Ctrl+C */
+static int mux_ttys(int n, char **paths)
+{
+    static ppp_mux_t m;
+    mux_sink_t sinks[1 + PPP_MUX_PROTOS];
+    memset(sinks, 0, sizeof(sinks));
+    if (mux_setup(&m, (size_t)n, sinks) != 0)
+        return 1;
+    for (int i = 0; i < n; ++i)
+    {
+        int fd = open(paths[i], O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0 || set_raw(fd) < 0)
+        {
+            perror(paths[i]);
+            if (fd >= 0)
+                close(fd);
+            continue;
+        }
+        if (ppp_mux_add_fd(&m, fd) != 0)
+            close(fd);
+    }
+    if (!m.live)
+    {
+        fprintf(stderr, "no usable links\n");
+        ppp_mux_free(&m);
+        return 1;
+    }
+    printf("Demultiplexing %zu link(s). Press Ctrl+C to stop.\n", m.live);
+    mux_loop(&m, sinks);
+    ppp_mux_free(&m);
+    return 0;
+}
+
+/* --mux-bench N rounds: N pty pairs, a child writes rounds bursts of mixed
+   frames into every slave, the parent demultiplexes all the masters */
+static int mux_bench(size_t n, unsigned long rounds)
+{
+    static ppp_mux_t m;
+    mux_sink_t sinks[1 + PPP_MUX_PROTOS];
+    memset(sinks, 0, sizeof(sinks));
+    int *slaves = calloc(n, sizeof(*slaves));
+    if (!slaves || mux_setup(&m, n, sinks) != 0)
+        return 1;
+    for (size_t i = 0; i < n; ++i)
+    {
+        int mfd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (mfd < 0 || grantpt(mfd) < 0 || unlockpt(mfd) < 0)
+        {
+            perror("posix_openpt");
+            return 1;
+        }
+        slaves[i] = open(ptsname(mfd), O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (slaves[i] < 0 || set_raw(slaves[i]) < 0)
+        {
+            perror("open pty slave");
+            return 1;
+        }
+        if (ppp_mux_add_fd(&m, mfd) != 0)
+            return 1;
+    }
+
+    /* one burst per write: 12 IPv4, 2 IPv6, an LCP and an IPCP frame, random sizes */
+    static const uint16_t mix[16] = {0x0021, 0x0021, 0x0021, 0x0057, 0x0021, 0x0021, 0x0021, 0xC021,
+                                     0x0021, 0x0021, 0x0021, 0x0057, 0x0021, 0x0021, 0x0021, 0x8021};
+    static uint8_t burst[16 * 3100];
+    size_t blen = 0;
+    uint8_t payload[1500];
+    srand(1);
+    for (int f = 0; f < 16; ++f)
+    {
+        size_t plen = 40 + (size_t)rand() % (sizeof(payload) - 40);
+        for (size_t i = 0; i < plen; ++i)
+            payload[i] = (uint8_t)rand();
+        blen += ppp_encode(mix[f], payload, plen, burst + blen, sizeof(burst) - blen);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0)
+    {
+        for (size_t i = 0; i < m.nchan; ++i)
+            close(m.chans[i].fd);
+        for (unsigned long r = 0; r < rounds; ++r)
+            for (size_t i = 0; i < n; ++i)
+                for (size_t w = 0; w < blen;)
+                {
+                    ssize_t k = write(slaves[i], burst + w, blen - w);
+                    if (k < 0 && errno != EINTR)
+                        _exit(1);
+                    w += k > 0 ? (size_t)k : 0;
+                }
+        _exit(0); /* closing the slaves hangs up every master */
+    }
+    for (size_t i = 0; i < n; ++i)
+        close(slaves[i]);
+    free(slaves);
+    printf("%zu pty links, %lu x %d frames (%zu bytes) each. Press Ctrl+C to stop.\n", n, rounds, 16, blen);
+    mux_loop(&m, sinks);
+    printf("expected %lu frames, pool %zu/%zu free after handlers let go\n", (unsigned long)n * rounds * 16,
+           m.pool.avail + m.live, m.pool.count);
+    if (g_stop)
+        kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    ppp_mux_free(&m);
+    return 0;
+}
+#endif /* __linux__ */
+
 int main(int argc, char **argv)
 {
+#ifdef __linux__
+    if (argc >= 3 && strcmp(argv[1], "--mux") == 0)
+        return mux_ttys(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "--mux-bench") == 0)
+    {
+        size_t n = argc > 2 ? strtoul(argv[2], NULL, 0) : 64;
+        unsigned long rounds = argc > 3 ? strtoul(argv[3], NULL, 0) : 200;
+        if (!n || n > 4096)
+        {
+            fprintf(stderr, "usage: %s --mux-bench [links (1-4096)] [rounds]\n", argv[0]);
+            return 1;
+        }
+        return mux_bench(n, rounds);
+    }
+#endif
     /* Parse optional --proto 0xNNNN; default IPv4 (0x0021) */
     uint16_t proto = 0x0021;
     for (int i = 1; i < argc; ++i)
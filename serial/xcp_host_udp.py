@@ -1,11 +1,18 @@
 # xcp_host_udp.py
 # Runs a tiny sequence: CONNECT, GET_STATUS, GET_ID,
 # SHORT_UPLOAD from an absolute address, SET_MTA + DOWNLOAD + UPLOAD.
+#
+# --daq N: instead, measure N u32 signals of the target's simulated ECU through
+# DAQ lists (packed into ODTs, timestamped, streamed on the 1 ms event) and
+# decode the DTO stream the target sends from port+1:
+#   python3 xcp_host_udp.py --daq 200 --seconds 5
 
 import argparse
 import socket
 import struct
 import sys
+import time
+from collections import deque
 from time import sleep
 
 XCP_CMD_CONNECT       = 0xFF
@@ -17,6 +24,24 @@ XCP_CMD_UPLOAD        = 0xF5
 XCP_CMD_SHORT_UPLOAD  = 0xF4
 XCP_CMD_DOWNLOAD      = 0xF0
 
+XCP_CMD_SET_DAQ_PTR             = 0xE2
+XCP_CMD_WRITE_DAQ               = 0xE1
+XCP_CMD_SET_DAQ_LIST_MODE       = 0xE0
+XCP_CMD_START_STOP_DAQ_LIST     = 0xDE
+XCP_CMD_START_STOP_SYNCH        = 0xDD
+XCP_CMD_GET_DAQ_CLOCK           = 0xDC
+XCP_CMD_GET_DAQ_PROCESSOR_INFO  = 0xDA
+XCP_CMD_GET_DAQ_RESOLUTION_INFO = 0xD9
+XCP_CMD_FREE_DAQ                = 0xD6
+XCP_CMD_ALLOC_DAQ               = 0xD5
+XCP_CMD_ALLOC_ODT               = 0xD4
+XCP_CMD_ALLOC_ODT_ENTRY         = 0xD3
+
+DAQ_MODE_TIMESTAMP = 0x10
+TS_SIZE = 4
+SIM_BASE = 0x4000     # target's simulated ECU: counter, then signal[i] = counter * (i + 1)
+SIM_SIGNALS = 256
+
 def hexdump(prefix, b):
     print(f"{prefix} ({len(b)}): " + " ".join(f"{x:02X}" for x in b))
 
@@ -26,10 +51,34 @@ class XcpUdp:
         self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
         self.sock.settimeout(timeout)
 
+        self.daq_port = port + 1
+        self.daq_queue = deque()  # DAQ datagrams that arrived while waiting for a response
+        self.max_dto = 32
+
     def xfer(self, payload: bytes) -> bytes:
         self.sock.sendto(payload, self.addr)
-        data, _ = self.sock.recvfrom(2048)
-        return data
+        while True:
+            data, src = self.sock.recvfrom(2048)
+            if src[1] == self.daq_port:
+                self.daq_queue.append(data)
+                continue
+            return data
+
+    def recv_daq(self):
+        if self.daq_queue:
+            return self.daq_queue.popleft()
+        while True:
+            data, src = self.sock.recvfrom(2048)
+            if src[1] == self.daq_port:
+                return data
+
+    def cmd(self, name, payload: bytes, quiet=False) -> bytes:
+        res = self.xfer(payload)
+        if not quiet or not res or res[0] != 0xFF:
+            hexdump(name + ".res", res)
+        if not res or res[0] != 0xFF:
+            raise RuntimeError(f"{name} failed: error 0x{res[1] if len(res) > 1 else 0:02X}")
+        return res
 
     def connect(self, mode=0):
         req = bytes([XCP_CMD_CONNECT, mode & 0xFF])
@@ -42,6 +91,7 @@ class XcpUdp:
             max_dto   = res[4] | (res[5] << 8)
             print(f"  resources=0x{resources:02X} comm_mode=0x{comm_mode:02X} "
                   f"MAX_CTO={max_cto} MAX_DTO={max_dto} PLver={res[6]} TLver={res[7]}")
+            self.max_dto = max_dto
         return res
 
     def get_status(self):
@@ -95,18 +145,177 @@ class XcpUdp:
         hexdump("DOWNLOAD.res", res)
         return res
 
+    # ---- DAQ ----
+    def free_daq(self):
+        self.cmd("FREE_DAQ", bytes([XCP_CMD_FREE_DAQ]), True)
+
+    def alloc_daq(self, count):
+        self.cmd("ALLOC_DAQ", struct.pack("<BBH", XCP_CMD_ALLOC_DAQ, 0, count), True)
+
+    def alloc_odt(self, daq, count):
+        self.cmd("ALLOC_ODT", struct.pack("<BBHB", XCP_CMD_ALLOC_ODT, 0, daq, count), True)
+
+    def alloc_odt_entry(self, daq, odt, count):
+        self.cmd("ALLOC_ODT_ENTRY", struct.pack("<BBHBB", XCP_CMD_ALLOC_ODT_ENTRY, 0, daq, odt, count), True)
+
+    def set_daq_ptr(self, daq, odt, entry):
+        self.cmd("SET_DAQ_PTR", struct.pack("<BBHBB", XCP_CMD_SET_DAQ_PTR, 0, daq, odt, entry), True)
+
+    def write_daq(self, addr, size, ext=0):
+        self.cmd("WRITE_DAQ", struct.pack("<BBBBI", XCP_CMD_WRITE_DAQ, 0xFF, size, ext, addr), True)
+
+    def set_daq_list_mode(self, daq, event, mode=DAQ_MODE_TIMESTAMP, prescaler=1, priority=0):
+        self.cmd("SET_DAQ_LIST_MODE",
+                 struct.pack("<BBHHBB", XCP_CMD_SET_DAQ_LIST_MODE, mode, daq, event, prescaler, priority), True)
+
+    def start_stop_daq_list(self, daq, mode):
+        """mode 0 stop, 1 start, 2 select; returns FIRST_PID"""
+        return self.cmd("START_STOP_DAQ_LIST", struct.pack("<BBH", XCP_CMD_START_STOP_DAQ_LIST, mode, daq), True)[1]
+
+    def start_stop_synch(self, mode):
+        """mode 0 stop all, 1 start selected, 2 stop selected"""
+        self.cmd("START_STOP_SYNCH", bytes([XCP_CMD_START_STOP_SYNCH, mode]), True)
+
+    def get_daq_clock(self):
+        return struct.unpack_from("<I", self.cmd("GET_DAQ_CLOCK", bytes([XCP_CMD_GET_DAQ_CLOCK]), True), 4)[0]
+
+    def get_daq_processor_info(self):
+        res = self.cmd("GET_DAQ_PROCESSOR_INFO", bytes([XCP_CMD_GET_DAQ_PROCESSOR_INFO]))
+        props, max_daq, max_ev, min_daq, key = struct.unpack_from("<BHHBB", res, 1)
+        print(f"  properties=0x{props:02X} MAX_DAQ={max_daq} MAX_EVENT={max_ev} MIN_DAQ={min_daq} key=0x{key:02X}")
+        return max_daq, max_ev
+
+    def configure_daq(self, signals, event, lists=1):
+        """Pack (addr, size) signals into ODTs that fit MAX_DTO, split over `lists`
+        DAQ lists on one event, all timestamped. Returns the layouts for DaqDecoder."""
+        per_list = [signals[i::lists] for i in range(lists)]
+        layouts = []
+        self.free_daq()
+        self.alloc_daq(lists)
+        for d, sigs in enumerate(per_list):
+            odts, cur, room = [], [], self.max_dto - 1 - TS_SIZE
+            for sig in sigs:
+                if sig[1] > room:
+                    odts.append(cur)
+                    cur, room = [], self.max_dto - 1
+                cur.append(sig)
+                room -= sig[1]
+            odts.append(cur)
+            self.alloc_odt(d, len(odts))
+            layouts.append(odts)
+        for d, odts in enumerate(layouts):
+            for o, entries in enumerate(odts):
+                self.alloc_odt_entry(d, o, len(entries))
+        for d, odts in enumerate(layouts):
+            for o, entries in enumerate(odts):
+                self.set_daq_ptr(d, o, 0)
+                for addr, size in entries:
+                    self.write_daq(addr, size)
+            self.set_daq_list_mode(d, event)
+        return layouts
+
     def disconnect(self):
         res = self.xfer(bytes([XCP_CMD_DISCONNECT]))
         hexdump("DISCONNECT.res", res)
         return res
 
+class DaqDecoder:
+    """Splits DAQ datagrams into DTOs ([LEN][CTR] each), maps PIDs to (list, ODT)
+    and yields one (list, timestamp_us, values) sample once all ODTs of a cycle
+    have arrived."""
+
+    def __init__(self, layouts, first_pids):
+        self.pid_map = {}
+        for d, (odts, first) in enumerate(zip(layouts, first_pids)):
+            for o, entries in enumerate(odts):
+                fmt = "<" + "".join({1: "B", 2: "H", 4: "I", 8: "Q"}[size] for _, size in entries)
+                self.pid_map[first + o] = (d, o, len(odts), struct.Struct(fmt))
+        self.partial = {}
+        self.ctr = None
+        self.lost = 0
+        self.dtos = 0
+        self.bad = 0
+
+    def feed(self, dgram):
+        pos = 0
+        while pos + 4 <= len(dgram):
+            ln, ctr = struct.unpack_from("<HH", dgram, pos)
+            dto = dgram[pos + 4:pos + 4 + ln]
+            pos += 4 + ln
+            if self.ctr is not None and ctr != (self.ctr + 1) & 0xFFFF:
+                self.lost += (ctr - self.ctr - 1) & 0xFFFF
+            self.ctr = ctr
+            self.dtos += 1
+            info = self.pid_map.get(dto[0]) if dto else None
+            if info is None:
+                self.bad += 1
+                continue
+            d, o, n_odts, st = info
+            off = 1
+            if o == 0:
+                self.partial[d] = (struct.unpack_from("<I", dto, 1)[0], [])
+                off += TS_SIZE
+            elif d not in self.partial:
+                continue  # joined mid-cycle
+            ts, vals = self.partial[d]
+            vals.extend(st.unpack_from(dto, off))
+            if o == n_odts - 1:
+                del self.partial[d]
+                yield d, ts, vals
+
+
+def run_daq(x, nsig, seconds, event, lists):
+    x.connect()
+    x.get_daq_processor_info()
+    nsig = min(nsig, SIM_SIGNALS)
+    # the counter first, so each sample can be checked against it
+    signals = [(SIM_BASE, 4)] + [(SIM_BASE + 4 + 4 * i, 4) for i in range(nsig)]
+    t0 = time.time()
+    layouts = x.configure_daq(signals, event, lists)
+    print(f"configured {len(signals)} signals in {sum(len(o) for o in layouts)} ODTs over {lists} list(s) "
+          f"with {3 + 2 * lists + sum(len(o) for o in layouts) * 2 + len(signals)} commands "
+          f"in {time.time() - t0:.3f} s")
+    first = [x.start_stop_daq_list(d, 2) for d in range(lists)]
+    x.start_stop_synch(1)
+    dec = DaqDecoder(layouts, first)
+    samples, dgrams, wrong, last_ts = 0, 0, 0, {}
+    t0 = time.time()
+    end = t0 + seconds
+    x.sock.settimeout(1.0)
+    while time.time() < end:
+        dgram = x.recv_daq()
+        dgrams += 1
+        for d, ts, vals in dec.feed(dgram):
+            samples += 1
+            if d in last_ts and ts <= last_ts[d]:
+                wrong += 1
+            last_ts[d] = ts
+            if d == 0 and lists == 1:
+                c = vals[0]
+                if any(v != (c * (i + 1)) & 0xFFFFFFFF for i, v in enumerate(vals[1:])):
+                    wrong += 1
+    dt = time.time() - t0
+    x.start_stop_synch(0)
+    print(f"{samples / dt:.0f} samples/s of {len(signals)} signals, {dec.dtos / dt:.0f} DTO/s in "
+          f"{dgrams / dt:.0f} datagrams/s; lost DTOs {dec.lost}, unknown PIDs {dec.bad}, "
+          f"inconsistent samples {wrong}")
+    x.disconnect()
+
+
 def main():
     ap = argparse.ArgumentParser()
     ap.add_argument("--host", default="127.0.0.1")
     ap.add_argument("--port", type=int, default=5555)
+    ap.add_argument("--daq", type=int, metavar="N", help="measure N signals via DAQ instead of the demo")
+    ap.add_argument("--seconds", type=float, default=3.0)
+    ap.add_argument("--event", type=int, default=0, help="0=1ms, 1=10ms, 2=100ms")
+    ap.add_argument("--lists", type=int, default=1)
     args = ap.parse_args()
 
     x = XcpUdp(args.host, args.port)
+    if args.daq:
+        run_daq(x, args.daq, args.seconds, args.event, args.lists)
+        return
 
     print("== CONNECT ==")
     x.connect()
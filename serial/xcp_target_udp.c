@@ -2,19 +2,25 @@
 // Spec-inspired XCP demo over UDP (NOT production XCP).
 // Implements: CONNECT(0xFF), DISCONNECT(0xFE), GET_STATUS(0xFD),
 // GET_ID(0xFA), SET_MTA(0xF6), UPLOAD(0xF5), SHORT_UPLOAD(0xF4), DOWNLOAD(0xF0)
+// DAQ: FREE_DAQ, ALLOC_DAQ/ODT/ODT_ENTRY, SET_DAQ_PTR, WRITE_DAQ, SET_DAQ_LIST_MODE,
+//      START_STOP_DAQ_LIST, START_STOP_SYNCH, GET_DAQ_CLOCK, GET_DAQ_*_INFO;
+//      events 0/1/2 = 1/10/100 ms, timestamped DTOs streamed from port+1.
 // Byte order: little-endian for addresses/sizes, like typical XCP examples.
 //
 // Build: gcc -std=c99 -O2 -Wall xcp_host_udp.c -o xcp_host
 // Run:   ./xcp_host [port]
+#define _GNU_SOURCE /* ppoll */
 #include <arpa/inet.h>
 #include <errno.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 
 #define XCP_CMD_CONNECT 0xFF
@@ -26,10 +32,31 @@
 #define XCP_CMD_UPLOAD 0xF5
 #define XCP_CMD_SHORT_UPLOAD 0xF4
 #define XCP_CMD_DOWNLOAD 0xF0
+#define XCP_CMD_SET_DAQ_PTR 0xE2
+#define XCP_CMD_WRITE_DAQ 0xE1
+#define XCP_CMD_SET_DAQ_LIST_MODE 0xE0
+#define XCP_CMD_START_STOP_DAQ_LIST 0xDE
+#define XCP_CMD_START_STOP_SYNCH 0xDD
+#define XCP_CMD_GET_DAQ_CLOCK 0xDC
+#define XCP_CMD_GET_DAQ_PROCESSOR_INFO 0xDA
+#define XCP_CMD_GET_DAQ_RESOLUTION_INFO 0xD9
+#define XCP_CMD_GET_DAQ_EVENT_INFO 0xD7
+#define XCP_CMD_FREE_DAQ 0xD6
+#define XCP_CMD_ALLOC_DAQ 0xD5
+#define XCP_CMD_ALLOC_ODT 0xD4
+#define XCP_CMD_ALLOC_ODT_ENTRY 0xD3
 
 #define XCP_PID_RES 0xFF // Positive response PID (common in examples)
 #define XCP_PID_ERR 0xFE // Error response PID
 
+#define XCP_ERR_DAQ_ACTIVE 0x11
+#define XCP_ERR_CMD_SYNTAX 0x21
+#define XCP_ERR_OUT_OF_RANGE 0x22
+#define XCP_ERR_MODE_NOT_VALID 0x27
+#define XCP_ERR_SEQUENCE 0x29
+#define XCP_ERR_DAQ_CONFIG 0x2A
+#define XCP_ERR_MEMORY_OVERFLOW 0x30
+
 #define MEM_SIZE (64 * 1024)
 static uint8_t mem_space[MEM_SIZE];
 
@@ -63,6 +90,443 @@ static void log_hex(const char *tag, const uint8_t *buf, size_t n)
     fprintf(stderr, "\n");
 }
 
+// ---------------- DAQ (data acquisition) ----------------
+// Dynamic DAQ configuration from fixed pools: FREE_DAQ, ALLOC_DAQ, ALLOC_ODT and
+// ALLOC_ODT_ENTRY carve lists, ODTs and entries; SET_DAQ_PTR + WRITE_DAQ fill
+// the entries; SET_DAQ_LIST_MODE binds a list to an event channel. When an
+// event fires, every running list on it is sampled in one go: each ODT is
+// gathered (adjacent entries merged into one memcpy at start) into a DTO
+// [PID][timestamp on the first ODT][data], and DTOs are packed back to back
+// into datagrams with the XCP-on-Ethernet [LEN][CTR] header in front of each.
+// DAQ datagrams go out from port+1 to the master that sent CONNECT, so they
+// never mix with command responses.
+#define XCP_DAQ_MAX_LISTS 16
+#define XCP_DAQ_MAX_ODTS 252 // absolute ODT numbers are the PIDs: 0x00..0xFB
+#define XCP_DAQ_MAX_ENTRIES 2048
+#define XCP_MAX_DTO 256
+#define XCP_DAQ_DGRAM 1472 // one Ethernet MTU of UDP payload
+#define XCP_TS_SIZE 4      // 32-bit timestamps, 1 us per tick
+
+#define XCP_SESSION_DAQ_RUNNING 0x40
+#define XCP_DAQ_MODE_TIMESTAMP 0x10
+#define XCP_DAQ_RUNNING 0x02 // daq_list_t.state bits
+#define XCP_DAQ_SELECTED 0x01
+
+enum
+{
+    XCP_EV_1MS,
+    XCP_EV_10MS,
+    XCP_EV_100MS,
+    XCP_EVENTS
+};
+static const uint16_t xcp_event_ms[XCP_EVENTS] = {1, 10, 100};
+
+typedef struct
+{
+    uint32_t addr;
+    uint8_t size;
+} odt_entry_t;
+
+typedef struct
+{
+    uint16_t first_entry, n_entries;
+    uint16_t first_run, n_runs; // merged copy list, built at start
+    uint16_t bytes;
+} odt_t;
+
+typedef struct
+{
+    uint16_t first_odt;
+    uint8_t n_odts;
+    uint8_t mode, state;
+    uint16_t event;
+    uint8_t prescaler, presc_cnt;
+} daq_list_t;
+
+static daq_list_t daq_lists[XCP_DAQ_MAX_LISTS];
+static odt_t daq_odts[XCP_DAQ_MAX_ODTS];
+static odt_entry_t daq_entries[XCP_DAQ_MAX_ENTRIES];
+static odt_entry_t daq_runs[XCP_DAQ_MAX_ENTRIES];
+static uint16_t daq_n_lists, daq_n_odts, daq_n_entries;
+static uint16_t daq_ptr_list;
+static uint8_t daq_ptr_odt, daq_ptr_entry;
+static bool daq_ptr_valid;
+
+static int daq_fd = -1;               // DAQ datagrams leave from port+1
+static struct sockaddr_in daq_master; // where they go: the CONNECTing master
+static bool daq_master_known;
+static uint8_t daq_tx[XCP_DAQ_DGRAM];
+static size_t daq_tx_len;
+static uint16_t daq_ctr;
+static uint64_t daq_t0_us;
+static unsigned long daq_dtos, daq_dgrams, daq_overruns, daq_send_errs;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static inline uint16_t get_le16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+    put_le16(p, (uint16_t)v);
+    put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+static size_t xcp_err(uint8_t *res, size_t res_cap, uint8_t code)
+{
+    if (res_cap < 2)
+        return 0;
+    res[0] = XCP_PID_ERR;
+    res[1] = code;
+    return 2;
+}
+
+static bool daq_any_running(void)
+{
+    for (uint16_t i = 0; i < daq_n_lists; ++i)
+        if (daq_lists[i].state & XCP_DAQ_RUNNING)
+            return true;
+    return false;
+}
+
+static void daq_update_status(void)
+{
+    if (daq_any_running())
+        session_status |= XCP_SESSION_DAQ_RUNNING;
+    else
+        session_status &= (uint8_t)~XCP_SESSION_DAQ_RUNNING;
+}
+
+static void daq_free(void)
+{
+    memset(daq_lists, 0, sizeof(daq_lists));
+    memset(daq_odts, 0, sizeof(daq_odts));
+    daq_n_lists = daq_n_odts = daq_n_entries = 0;
+    daq_ptr_valid = false;
+    daq_update_status();
+}
+
+// Validate a list and build its merged copy runs; 0 or an XCP error code
+static uint8_t daq_prepare(daq_list_t *l)
+{
+    uint16_t run = 0;
+    if (!l->n_odts)
+        return XCP_ERR_DAQ_CONFIG;
+    for (uint8_t o = 0; o < l->n_odts; ++o)
+    {
+        odt_t *odt = &daq_odts[l->first_odt + o];
+        size_t room = XCP_MAX_DTO - 1 - ((o == 0 && (l->mode & XCP_DAQ_MODE_TIMESTAMP)) ? XCP_TS_SIZE : 0);
+        // runs are rebuilt from scratch into the slots of this ODT's entries
+        odt->first_run = odt->first_entry;
+        odt->n_runs = 0;
+        odt->bytes = 0;
+        for (uint16_t e = 0; e < odt->n_entries; ++e)
+        {
+            const odt_entry_t *en = &daq_entries[odt->first_entry + e];
+            if (!en->size)
+                continue; // never written
+            odt_entry_t *last = odt->n_runs ? &daq_runs[odt->first_run + odt->n_runs - 1] : NULL;
+            if (last && last->addr + last->size == en->addr && last->size + en->size <= 255)
+                last->size = (uint8_t)(last->size + en->size);
+            else
+                daq_runs[odt->first_run + odt->n_runs++] = *en;
+            odt->bytes = (uint16_t)(odt->bytes + en->size);
+            run++;
+        }
+        if (odt->bytes > room)
+            return XCP_ERR_DAQ_CONFIG;
+    }
+    return run ? 0 : XCP_ERR_DAQ_CONFIG;
+}
+
+static void daq_flush(void)
+{
+    if (!daq_tx_len)
+        return;
+    if (sendto(daq_fd, daq_tx, daq_tx_len, 0, (struct sockaddr *)&daq_master, sizeof(daq_master)) < 0)
+        daq_send_errs++;
+    else
+        daq_dgrams++;
+    daq_tx_len = 0;
+}
+
+// Sample every ODT of list l into the datagram being packed
+static void daq_sample(const daq_list_t *l, uint32_t ts)
+{
+    for (uint8_t o = 0; o < l->n_odts; ++o)
+    {
+        const odt_t *odt = &daq_odts[l->first_odt + o];
+        size_t dto = 1 + odt->bytes + ((o == 0 && (l->mode & XCP_DAQ_MODE_TIMESTAMP)) ? XCP_TS_SIZE : 0);
+        if (daq_tx_len + 4 + dto > sizeof(daq_tx))
+            daq_flush();
+        uint8_t *w = daq_tx + daq_tx_len;
+        put_le16(w, (uint16_t)dto);
+        put_le16(w + 2, daq_ctr++);
+        w += 4;
+        *w++ = (uint8_t)(l->first_odt + o); // PID: absolute ODT number
+        if (o == 0 && (l->mode & XCP_DAQ_MODE_TIMESTAMP))
+        {
+            put_le32(w, ts);
+            w += XCP_TS_SIZE;
+        }
+        for (uint16_t r = 0; r < odt->n_runs; ++r)
+        {
+            const odt_entry_t *run = &daq_runs[odt->first_run + r];
+            memcpy(w, &mem_space[run->addr], run->size);
+            w += run->size;
+        }
+        daq_tx_len += 4 + dto;
+        daq_dtos++;
+    }
+}
+
+static void daq_event(uint16_t event, uint32_t ts)
+{
+    for (uint16_t i = 0; i < daq_n_lists; ++i)
+    {
+        daq_list_t *l = &daq_lists[i];
+        if (!(l->state & XCP_DAQ_RUNNING) || l->event != event)
+            continue;
+        if (++l->presc_cnt < l->prescaler)
+            continue;
+        l->presc_cnt = 0;
+        daq_sample(l, ts);
+    }
+}
+
+static void daq_start(daq_list_t *l)
+{
+    l->state = (uint8_t)((l->state & ~XCP_DAQ_SELECTED) | XCP_DAQ_RUNNING);
+    l->presc_cnt = (uint8_t)(l->prescaler - 1); // sample on the first event
+}
+
+// DAQ commands; 0 if cmd is not one of them (res untouched)
+static size_t handle_daq(const uint8_t *req, size_t req_len, uint8_t *res, size_t res_cap)
+{
+    if (res_cap < 8)
+        return 0;
+    res[0] = XCP_PID_RES;
+    switch (req[0])
+    {
+    case XCP_CMD_FREE_DAQ:
+        daq_free();
+        return 1;
+    case XCP_CMD_ALLOC_DAQ:
+    {
+        // [2..3]=DAQ_COUNT
+        if (req_len < 4)
+            return xcp_err(res, res_cap, XCP_ERR_CMD_SYNTAX);
+        uint16_t n = get_le16(&req[2]);
+        if (daq_n_lists || daq_any_running())
+            return xcp_err(res, res_cap, XCP_ERR_SEQUENCE);
+        if (n > XCP_DAQ_MAX_LISTS)
+            return xcp_err(res, res_cap, XCP_ERR_MEMORY_OVERFLOW);
+        daq_n_lists = n;
+        return 1;
+    }
+    case XCP_CMD_ALLOC_ODT:
+    {
+        // [2..3]=DAQ_LIST_NUMBER, [4]=ODT_COUNT
+        if (req_len < 5)
+            return xcp_err(res, res_cap, XCP_ERR_CMD_SYNTAX);
+        uint16_t d = get_le16(&req[2]);
+        if (d >= daq_n_lists || daq_n_entries)
+            return xcp_err(res, res_cap, d >= daq_n_lists ? XCP_ERR_OUT_OF_RANGE : XCP_ERR_SEQUENCE);
+        if (daq_lists[d].n_odts)
+            return xcp_err(res, res_cap, XCP_ERR_SEQUENCE);
+        if (daq_n_odts + req[4] > XCP_DAQ_MAX_ODTS)
+            return xcp_err(res, res_cap, XCP_ERR_MEMORY_OVERFLOW);
+        daq_lists[d].first_odt = daq_n_odts;
+        daq_lists[d].n_odts = req[4];
+        daq_lists[d].prescaler = 1;
+        daq_n_odts = (uint16_t)(daq_n_odts + req[4]);
+        return 1;
+    }
+    case XCP_CMD_ALLOC_ODT_ENTRY:
+    {
+        // [2..3]=DAQ_LIST_NUMBER, [4]=ODT_NUMBER, [5]=ODT_ENTRIES_COUNT
+        if (req_len < 6)
+            return xcp_err(res, res_cap, XCP_ERR_CMD_SYNTAX);
+        uint16_t d = get_le16(&req[2]);
+        if (d >= daq_n_lists || req[4] >= daq_lists[d].n_odts)
+            return xcp_err(res, res_cap, XCP_ERR_OUT_OF_RANGE);
+        odt_t *odt = &daq_odts[daq_lists[d].first_odt + req[4]];
+        if (odt->n_entries)
+            return xcp_err(res, res_cap, XCP_ERR_SEQUENCE);
+        if (daq_n_entries + req[5] > XCP_DAQ_MAX_ENTRIES)
+            return xcp_err(res, res_cap, XCP_ERR_MEMORY_OVERFLOW);
+        odt->first_entry = daq_n_entries;
+        odt->n_entries = req[5];
+        memset(&daq_entries[daq_n_entries], 0, req[5] * sizeof(daq_entries[0]));
+        daq_n_entries = (uint16_t)(daq_n_entries + req[5]);
+        return 1;
+    }
+    case XCP_CMD_SET_DAQ_PTR:
+    {
+        // [2..3]=DAQ_LIST_NUMBER, [4]=ODT_NUMBER, [5]=ODT_ENTRY_NUMBER
+        if (req_len < 6)
+            return xcp_err(res, res_cap, XCP_ERR_CMD_SYNTAX);
+        uint16_t d = get_le16(&req[2]);
+        if (d >= daq_n_lists || req[4] >= daq_lists[d].n_odts ||
+            req[5] >= daq_odts[daq_lists[d].first_odt + req[4]].n_entries)
+            return xcp_err(res, res_cap, XCP_ERR_OUT_OF_RANGE);
+        if (daq_lists[d].state & XCP_DAQ_RUNNING)
+            return xcp_err(res, res_cap, XCP_ERR_DAQ_ACTIVE);
+        daq_ptr_list = d;
+        daq_ptr_odt = req[4];
+        daq_ptr_entry = req[5];
+        daq_ptr_valid = true;
+        return 1;
+    }
+    case XCP_CMD_WRITE_DAQ:
+    {
+        // [1]=BIT_OFFSET (0xFF: whole bytes), [2]=size, [3]=addr_ext, [4..7]=address (LE)
+        if (req_len < 8)
+            return xcp_err(res, res_cap, XCP_ERR_CMD_SYNTAX);
+        if (!daq_ptr_valid)
+            return xcp_err(res, res_cap, XCP_ERR_SEQUENCE);
+        const odt_t *odt = &daq_odts[daq_lists[daq_ptr_list].first_odt + daq_ptr_odt];
+        uint32_t addr = get_le32(&req[4]);
+        if (req[1] != 0xFF || !req[2] || addr >= MEM_SIZE || addr + req[2] > MEM_SIZE)
+            return xcp_err(res, res_cap, XCP_ERR_OUT_OF_RANGE);
+        daq_entries[odt->first_entry + daq_ptr_entry].addr = addr;
+        daq_entries[odt->first_entry + daq_ptr_entry].size = req[2];
+        if (++daq_ptr_entry >= odt->n_entries)
+            daq_ptr_valid = false; // the pointer does not wrap into the next ODT
+        return 1;
+    }
+    case XCP_CMD_SET_DAQ_LIST_MODE:
+    {
+        // [1]=mode, [2..3]=DAQ_LIST_NUMBER, [4..5]=EVENT_CHANNEL, [6]=PRESCALER, [7]=priority
+        if (req_len < 8)
+            return xcp_err(res, res_cap, XCP_ERR_CMD_SYNTAX);
+        uint16_t d = get_le16(&req[2]), ev = get_le16(&req[4]);
+        if (d >= daq_n_lists || ev >= XCP_EVENTS || !req[6])
+            return xcp_err(res, res_cap, XCP_ERR_OUT_OF_RANGE);
+        if (daq_lists[d].state & XCP_DAQ_RUNNING)
+            return xcp_err(res, res_cap, XCP_ERR_DAQ_ACTIVE);
+        if (req[1] & ~XCP_DAQ_MODE_TIMESTAMP) // direction, alternating, PID_OFF: not here
+            return xcp_err(res, res_cap, XCP_ERR_MODE_NOT_VALID);
+        daq_lists[d].mode = req[1];
+        daq_lists[d].event = ev;
+        daq_lists[d].prescaler = req[6];
+        return 1;
+    }
+    case XCP_CMD_START_STOP_DAQ_LIST:
+    {
+        // [1]=0 stop, 1 start, 2 select; [2..3]=DAQ_LIST_NUMBER. Response [1]=FIRST_PID
+        if (req_len < 4)
+            return xcp_err(res, res_cap, XCP_ERR_CMD_SYNTAX);
+        uint16_t d = get_le16(&req[2]);
+        if (d >= daq_n_lists || req[1] > 2)
+            return xcp_err(res, res_cap, XCP_ERR_OUT_OF_RANGE);
+        daq_list_t *l = &daq_lists[d];
+        if (req[1] == 0)
+            l->state = 0;
+        else
+        {
+            uint8_t e = daq_prepare(l);
+            if (e)
+                return xcp_err(res, res_cap, e);
+            if (!daq_master_known)
+                return xcp_err(res, res_cap, XCP_ERR_SEQUENCE);
+            if (req[1] == 1)
+                daq_start(l);
+            else
+                l->state |= XCP_DAQ_SELECTED;
+        }
+        daq_update_status();
+        res[1] = (uint8_t)l->first_odt;
+        return 2;
+    }
+    case XCP_CMD_START_STOP_SYNCH:
+    {
+        // [1]=0 stop all, 1 start selected, 2 stop selected
+        if (req_len < 2 || req[1] > 2)
+            return xcp_err(res, res_cap, XCP_ERR_OUT_OF_RANGE);
+        for (uint16_t i = 0; i < daq_n_lists; ++i)
+        {
+            daq_list_t *l = &daq_lists[i];
+            if (req[1] == 0)
+                l->state = 0;
+            else if (l->state & XCP_DAQ_SELECTED)
+            {
+                if (req[1] == 1)
+                    daq_start(l);
+                else
+                    l->state = 0;
+            }
+        }
+        daq_update_status();
+        return 1;
+    }
+    case XCP_CMD_GET_DAQ_CLOCK:
+    {
+        // [4..7]=current timestamp
+        memset(&res[1], 0, 3);
+        put_le32(&res[4], (uint32_t)(now_us() - daq_t0_us));
+        return 8;
+    }
+    case XCP_CMD_GET_DAQ_PROCESSOR_INFO:
+    {
+        // [1]=properties, [2..3]=MAX_DAQ, [4..5]=MAX_EVENT_CHANNEL, [6]=MIN_DAQ, [7]=DAQ_KEY_BYTE
+        res[1] = 0x13; // dynamic config, prescaler, timestamps
+        put_le16(&res[2], XCP_DAQ_MAX_LISTS);
+        put_le16(&res[4], XCP_EVENTS);
+        res[6] = 0;
+        res[7] = 0x00; // absolute ODT number as PID, no address extension
+        return 8;
+    }
+    case XCP_CMD_GET_DAQ_RESOLUTION_INFO:
+    {
+        // [1]/[2]=granularity/max ODT entry size (DAQ), [3]/[4] for STIM,
+        // [5]=timestamp mode (size | unit << 4), [6..7]=timestamp ticks
+        res[1] = 1;
+        res[2] = XCP_MAX_DTO - 1;
+        res[3] = 1;
+        res[4] = 0;
+        res[5] = XCP_TS_SIZE | (3 << 4); // 4 bytes, 1 us units
+        put_le16(&res[6], 1);
+        return 8;
+    }
+    case XCP_CMD_GET_DAQ_EVENT_INFO:
+    {
+        // [2..3]=EVENT_CHANNEL. Response: [1]=properties, [2]=max lists, [3]=name length,
+        // [4]=time cycle, [5]=time unit (6: 1 ms), [6]=priority
+        if (req_len < 4)
+            return xcp_err(res, res_cap, XCP_ERR_CMD_SYNTAX);
+        uint16_t ev = get_le16(&req[2]);
+        if (ev >= XCP_EVENTS)
+            return xcp_err(res, res_cap, XCP_ERR_OUT_OF_RANGE);
+        res[1] = 0x04; // DAQ
+        res[2] = 0xFF;
+        res[3] = 0;
+        res[4] = (uint8_t)xcp_event_ms[ev];
+        res[5] = 6;
+        res[6] = (uint8_t)(XCP_EVENTS - ev);
+        return 7;
+    }
+    default:
+        return 0;
+    }
+}
+
+// The "ECU": a tick counter at SIM_BASE, then SIM_SIGNALS u32 signals with
+// signal[i] == counter * (i + 1), all updated together every millisecond of
+// measurement
+#define SIM_BASE 0x4000
+#define SIM_SIGNALS 256
+static void sim_step(void)
+{
+    uint32_t c = get_le32(&mem_space[SIM_BASE]) + 1;
+    put_le32(&mem_space[SIM_BASE], c);
+    for (uint32_t i = 0; i < SIM_SIGNALS; ++i)
+        put_le32(&mem_space[SIM_BASE + 4 + 4 * i], c * (i + 1));
+}
+
 static size_t handle_xcp(const uint8_t *req, size_t req_len, uint8_t *res, size_t res_cap)
 {
     if (req_len == 0)
@@ -82,9 +546,8 @@ static size_t handle_xcp(const uint8_t *req, size_t req_len, uint8_t *res, size_
         res[0] = XCP_PID_RES;
         res[1] = 0x04; // DAQ available
         res[2] = 0x80; // Intel (little-endian)
-        res[3] = 32;   // MAX_CTO
-        res[4] = 32;
-        res[5] = 0x00; // MAX_DTO = 32
+        res[3] = 32; // MAX_CTO
+        put_le16(&res[4], XCP_MAX_DTO);
         res[6] = 0x01; // Protocol layer version
         res[7] = 0x01; // Transport layer version (demo)
         return 8;
@@ -187,6 +650,10 @@ static size_t handle_xcp(const uint8_t *req, size_t req_len, uint8_t *res, size_
         return 1;
     }
     case XCP_CMD_DISCONNECT:
+        for (uint16_t i = 0; i < daq_n_lists; ++i)
+            daq_lists[i].state = 0; // disconnecting stops measurement
+        daq_update_status();
+        /* fall through */
     case XCP_CMD_SYNCH:
     {
         if (res_cap < 1)
@@ -195,8 +662,13 @@ static size_t handle_xcp(const uint8_t *req, size_t req_len, uint8_t *res, size_
         return 1;
     }
     default:
+    {
+        size_t n = handle_daq(req, req_len, res, res_cap);
+        if (n)
+            return n;
         break;
     }
+    }
 
 err_format:
     if (res_cap < 2)
@@ -220,7 +692,8 @@ int main(int argc, char **argv)
     mem_space[0x1003] = 0x44;
 
     int fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd < 0)
+    daq_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0 || daq_fd < 0)
     {
         perror("socket");
         return 1;
@@ -237,24 +710,97 @@ int main(int argc, char **argv)
         close(fd);
         return 1;
     }
-    fprintf(stderr, "XCP UDP slave listening on 0.0.0.0:%d\n", port);
+    addr.sin_port = htons((uint16_t)(port + 1));
+    if (bind(daq_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind (DAQ port)");
+        close(fd);
+        return 1;
+    }
+    int sndbuf = 1 << 20;
+    setsockopt(daq_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    fprintf(stderr, "XCP UDP slave listening on 0.0.0.0:%d (DAQ from :%d)\n", port, port + 1);
 
     uint8_t inbuf[2048], outbuf[2048];
+    daq_t0_us = now_us();
+    uint64_t next_tick = daq_t0_us + 1000, last_report = daq_t0_us;
+    uint32_t tick = 0;
+    unsigned long last_dtos = 0, last_dgrams = 0;
     for (;;)
     {
-        struct sockaddr_in peer;
-        socklen_t plen = sizeof(peer);
-        ssize_t n = recvfrom(fd, inbuf, sizeof(inbuf), 0, (struct sockaddr *)&peer, &plen);
-        if (n <= 0)
-            continue;
-        log_hex("REQ", inbuf, (size_t)n);
+        // sleep until a datagram arrives or, while measuring, the next 1 ms tick
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        struct timespec ts, *tmo = NULL;
+        if (session_status & XCP_SESSION_DAQ_RUNNING)
+        {
+            uint64_t t = now_us(), wait = next_tick > t ? next_tick - t : 0;
+            ts.tv_sec = (time_t)(wait / 1000000u);
+            ts.tv_nsec = (long)(wait % 1000000u) * 1000;
+            tmo = &ts;
+        }
+        int pr = ppoll(&pfd, 1, tmo, NULL);
+        if (pr < 0 && errno != EINTR)
+        {
+            perror("ppoll");
+            break;
+        }
+        if (pr > 0 && (pfd.revents & POLLIN))
+        {
+            struct sockaddr_in peer;
+            socklen_t plen = sizeof(peer);
+            ssize_t n = recvfrom(fd, inbuf, sizeof(inbuf), 0, (struct sockaddr *)&peer, &plen);
+            if (n > 0)
+            {
+                log_hex("REQ", inbuf, (size_t)n);
+                if (inbuf[0] == XCP_CMD_CONNECT)
+                {
+                    daq_master = peer; // DTOs go to whoever connected last
+                    daq_master_known = true;
+                }
+                bool was_running = session_status & XCP_SESSION_DAQ_RUNNING;
+                size_t outn = handle_xcp(inbuf, (size_t)n, outbuf, sizeof(outbuf));
+                if (outn > 0)
+                {
+                    log_hex("RES", outbuf, outn);
+                    sendto(fd, outbuf, outn, 0, (struct sockaddr *)&peer, plen);
+                }
+                if (!was_running && (session_status & XCP_SESSION_DAQ_RUNNING))
+                    next_tick = now_us() + 1000;
+            }
+        }
 
-        size_t outn = handle_xcp(inbuf, (size_t)n, outbuf, sizeof(outbuf));
-        if (outn > 0)
+        uint64_t t = now_us();
+        if (!(session_status & XCP_SESSION_DAQ_RUNNING) || t < next_tick)
+            continue;
+        if (t - next_tick > 100000)
+        {
+            daq_overruns += (unsigned long)((t - next_tick) / 1000); // stalled: skip, don't burst
+            next_tick = t;
+        }
+        while (t >= next_tick)
+        {
+            uint32_t stamp = (uint32_t)(next_tick - daq_t0_us);
+            sim_step();
+            ++tick;
+            daq_event(XCP_EV_1MS, stamp);
+            if (tick % 10 == 0)
+                daq_event(XCP_EV_10MS, stamp);
+            if (tick % 100 == 0)
+                daq_event(XCP_EV_100MS, stamp);
+            daq_flush();
+            next_tick += 1000;
+        }
+        if (t - last_report >= 1000000)
         {
-            log_hex("RES", outbuf, outn);
-            sendto(fd, outbuf, outn, 0, (struct sockaddr *)&peer, plen);
+            double dt = (double)(t - last_report) / 1e6;
+            fprintf(stderr, "DAQ: %.0f DTO/s in %.0f datagrams/s, overruns %lu, send errors %lu\n",
+                    (daq_dtos - last_dtos) / dt, (daq_dgrams - last_dgrams) / dt, daq_overruns, daq_send_errs);
+            last_dtos = daq_dtos;
+            last_dgrams = daq_dgrams;
+            last_report = t;
         }
     }
+    close(daq_fd);
+    close(fd);
     return 0;
 }